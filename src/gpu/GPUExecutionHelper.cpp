@@ -37,7 +37,7 @@ int32_t GPUInferenceRunner::initializeGpuLut() {
   auto numberOfTileShapes = mlir::decisionforest::TileShapeToTileIDMap::NumberOfTileShapes(m_tileSize);
   // auto lutMemrefType = MemRefType::get({numberOfTileShapes, numberOfTileOutcomes}, rewriter.getI8Type());
   std::vector<int8_t> lutValues(numberOfTileShapes * numberOfTileOutcomes);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeLookUpTable(lutValues.data(), m_tileSize, 8);
+  mlir::decisionforest::ForestJSONReader::InitializeLookUpTable(lutValues.data(), m_tileSize, 8);
 
   typedef LUTMemrefType (*InitLUTFunc_t)(LUTEntryType*, LUTEntryType*, int64_t, int64_t, int64_t, int64_t, int64_t);
   auto initLUTPtr = reinterpret_cast<InitLUTFunc_t>(GetFunctionAddress("Init_LUT"));
@@ -14,6 +14,28 @@ namespace mlir
 namespace decisionforest
 {
 
+namespace
+{
+
+// Returns a memref that points directly into the mapped model globals when they were read from a
+// binary file, or a memref with a null buffer otherwise. Binary files store each buffer in the
+// element type used by the generated code, so no conversion is needed.
+template<typename T>
+Memref<T, 1> GetMappedModelGlobalsSection(ForestJSONReader& forestJSONReader, InferenceRunnerBase* inferenceRunner, 
+                                          BinaryModelGlobalsSectionKind kind) {
+  auto* mappedGlobals = forestJSONReader.GetMappedModelGlobals();
+  if (!mappedGlobals)
+    return Memref<T, 1>{nullptr, nullptr, 0, {0}, {1}};
+  auto* entry = mappedGlobals->FindEntry(inferenceRunner->GetTileSize(),
+                                         inferenceRunner->GetThresholdWidth(),
+                                         inferenceRunner->GetFeatureIndexWidth());
+  assert (entry && "Model globals must have an entry for the tile size and bit widths of the inference runner");
+  auto* elements = mappedGlobals->GetSection<T>(*entry, kind);
+  return Memref<T, 1>{elements, elements, 0, {MappedBinaryModelGlobals::GetNumberOfElements(*entry, kind)}, {1}};
+}
+
+}
+
 // ===---------------------------------------------------=== //
 // GPUArraySparseSerializerBase Methods
 // ===---------------------------------------------------=== //
@@ -24,12 +46,16 @@ int32_t GPUArraySparseSerializerBase::InitializeLengthsArray() {
   auto tileSize = m_inferenceRunner->GetTileSize();
   auto thresholdSize = m_inferenceRunner->GetThresholdWidth();
   auto featureIndexSize = m_inferenceRunner->GetFeatureIndexWidth();
-  std::vector<int64_t> lengths(mlir::decisionforest::ForestJSONReader::GetInstance().GetNumberOfTrees(), -1);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeLengthBuffer(lengths.data(), 
-                                                                               tileSize,
-                                                                               thresholdSize,
-                                                                               featureIndexSize);
-  LengthMemrefType lengthsMemref{lengths.data(), lengths.data(), 0, {static_cast<int64_t>(lengths.size())}, {1}};
+  std::vector<int64_t> lengths;
+  auto lengthsMemref = GetMappedModelGlobalsSection<int64_t>(m_forestJSONReader, m_inferenceRunner, BinaryModelGlobalsSectionKind::kTreeLengths);
+  if (!lengthsMemref.bufferPtr) {
+    lengths.resize(m_forestJSONReader.GetNumberOfTrees(), -1);
+    m_forestJSONReader.InitializeLengthBuffer(lengths.data(), 
+                                              tileSize,
+                                              thresholdSize,
+                                              featureIndexSize);
+    lengthsMemref = LengthMemrefType{lengths.data(), lengths.data(), 0, {static_cast<int64_t>(lengths.size())}, {1}};
+  }
   m_lengthsMemref = initLengthPtr(lengthsMemref.bufferPtr, lengthsMemref.alignedPtr, lengthsMemref.offset, lengthsMemref.lengths[0], lengthsMemref.strides[0]);
 
   return 0;
@@ -44,12 +70,16 @@ int32_t GPUArraySparseSerializerBase::InitializeOffsetsArray() {
   auto thresholdSize = m_inferenceRunner->GetThresholdWidth();
   auto featureIndexSize = m_inferenceRunner->GetFeatureIndexWidth();
   
-  std::vector<int64_t> offsets(mlir::decisionforest::ForestJSONReader::GetInstance().GetNumberOfTrees(), -1);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeOffsetBuffer(offsets.data(),
-                                                                               tileSize,
-                                                                               thresholdSize,
-                                                                               featureIndexSize);
-  LengthMemrefType offsetsMemref{offsets.data(), offsets.data(), 0, {static_cast<int64_t>(offsets.size())}, {1}};
+  std::vector<int64_t> offsets;
+  auto offsetsMemref = GetMappedModelGlobalsSection<int64_t>(m_forestJSONReader, m_inferenceRunner, BinaryModelGlobalsSectionKind::kTreeOffsets);
+  if (!offsetsMemref.bufferPtr) {
+    offsets.resize(m_forestJSONReader.GetNumberOfTrees(), -1);
+    m_forestJSONReader.InitializeOffsetBuffer(offsets.data(),
+                                              tileSize,
+                                              thresholdSize,
+                                              featureIndexSize);
+    offsetsMemref = LengthMemrefType{offsets.data(), offsets.data(), 0, {static_cast<int64_t>(offsets.size())}, {1}};
+  }
   m_offsetsMemref = initOffsetPtr(offsetsMemref.bufferPtr,
                                   offsetsMemref.alignedPtr,
                                   offsetsMemref.offset,
@@ -64,7 +94,7 @@ int32_t GPUArraySparseSerializerBase::ResolveChildIndexType() {
   if (!m_sparseRepresentation)
     return CallInitMethod<ThresholdType, FeatureIndexType, TileShapeType, int32_t>();
   else {
-    auto childIndexBitWidth = mlir::decisionforest::ForestJSONReader::GetInstance().GetChildIndexBitWidth();
+    auto childIndexBitWidth = m_forestJSONReader.GetChildIndexBitWidth();
     assert (childIndexBitWidth > 0);
     if (childIndexBitWidth == 8)
       return CallInitMethod<ThresholdType, FeatureIndexType, TileShapeType, int8_t>();
@@ -80,7 +110,7 @@ int32_t GPUArraySparseSerializerBase::ResolveChildIndexType() {
 
 template<typename ThresholdType, typename FeatureIndexType>
 int32_t GPUArraySparseSerializerBase::ResolveTileShapeType() {
-  auto tileShapeBitWidth = mlir::decisionforest::ForestJSONReader::GetInstance().GetTileShapeBitWidth();
+  auto tileShapeBitWidth = m_forestJSONReader.GetTileShapeBitWidth();
   if (tileShapeBitWidth == 8)
     return ResolveChildIndexType<ThresholdType, FeatureIndexType, int8_t>();
   else if (tileShapeBitWidth == 16)
@@ -94,6 +124,9 @@ int32_t GPUArraySparseSerializerBase::ResolveTileShapeType() {
 
 template<typename ThresholdType, typename FeatureIndexType, typename TileShapeType, typename ChildIndexType>
 int32_t GPUArraySparseSerializerBase::CallInitMethod() {
+  if (m_forestJSONReader.GetMappedModelGlobals())
+    return CallInitMethodWithMappedModelGlobals<ThresholdType, FeatureIndexType, TileShapeType, ChildIndexType>();
+
   auto tileSize = m_inferenceRunner->GetTileSize();
   auto thresholdSize = m_inferenceRunner->GetThresholdWidth();
   auto featureIndexSize = m_inferenceRunner->GetFeatureIndexWidth();
@@ -103,27 +136,47 @@ int32_t GPUArraySparseSerializerBase::CallInitMethod() {
   std::vector<ChildIndexType> childIndices;
 
   if (!m_sparseRepresentation)
-    mlir::decisionforest::ForestJSONReader::GetInstance().GetModelValues(tileSize,
-                                                                         thresholdSize,
-                                                                         featureIndexSize,
-                                                                         thresholds,
-                                                                         featureIndices,
-                                                                         tileShapeIDs);
+    m_forestJSONReader.GetModelValues(tileSize,
+                                      thresholdSize,
+                                      featureIndexSize,
+                                      thresholds,
+                                      featureIndices,
+                                      tileShapeIDs);
   else {
     assert (m_sparseRepresentation);
-    mlir::decisionforest::ForestJSONReader::GetInstance().GetModelValues(tileSize, 
-                                                                         thresholdSize, 
-                                                                         featureIndexSize, 
-                                                                         thresholds,
-                                                                         featureIndices,
-                                                                         tileShapeIDs,
-                                                                         childIndices);
+    m_forestJSONReader.GetModelValues(tileSize, 
+                                      thresholdSize, 
+                                      featureIndexSize, 
+                                      thresholds,
+                                      featureIndices,
+                                      tileShapeIDs,
+                                      childIndices);
   }
 
   Memref<ThresholdType, 1> thresholdsMemref{thresholds.data(), thresholds.data(), 0, {(int64_t)thresholds.size()}, 1};
   Memref<FeatureIndexType, 1> featureIndexMemref{featureIndices.data(), featureIndices.data(), 0, {(int64_t)featureIndices.size()}, 1};
   Memref<TileShapeType, 1> tileShapeIDMemref{tileShapeIDs.data(), tileShapeIDs.data(), 0, {(int64_t)tileShapeIDs.size()}, 1};
-  
+  Memref<ChildIndexType, 1> childIndexMemref{childIndices.data(), childIndices.data(), 0, {(int64_t)childIndices.size()}, 1};
+  return CallInitModelFunction(thresholdsMemref, featureIndexMemref, tileShapeIDMemref, childIndexMemref);
+}
+
+// Model values are passed to Init_Model straight out of the mapped file
+template<typename ThresholdType, typename FeatureIndexType, typename TileShapeType, typename ChildIndexType>
+int32_t GPUArraySparseSerializerBase::CallInitMethodWithMappedModelGlobals() {
+  auto thresholdsMemref = GetMappedModelGlobalsSection<ThresholdType>(m_forestJSONReader, m_inferenceRunner, BinaryModelGlobalsSectionKind::kThresholds);
+  auto featureIndexMemref = GetMappedModelGlobalsSection<FeatureIndexType>(m_forestJSONReader, m_inferenceRunner, BinaryModelGlobalsSectionKind::kFeatureIndices);
+  auto tileShapeIDMemref = GetMappedModelGlobalsSection<TileShapeType>(m_forestJSONReader, m_inferenceRunner, BinaryModelGlobalsSectionKind::kTileShapeIDs);
+  Memref<ChildIndexType, 1> childIndexMemref{nullptr, nullptr, 0, {0}, {1}};
+  if (m_sparseRepresentation)
+    childIndexMemref = GetMappedModelGlobalsSection<ChildIndexType>(m_forestJSONReader, m_inferenceRunner, BinaryModelGlobalsSectionKind::kChildIndices);
+  return CallInitModelFunction(thresholdsMemref, featureIndexMemref, tileShapeIDMemref, childIndexMemref);
+}
+
+template<typename ThresholdType, typename FeatureIndexType, typename TileShapeType, typename ChildIndexType>
+int32_t GPUArraySparseSerializerBase::CallInitModelFunction(Memref<ThresholdType, 1> thresholdsMemref,
+                                                            Memref<FeatureIndexType, 1> featureIndexMemref,
+                                                            Memref<TileShapeType, 1> tileShapeIDMemref,
+                                                            Memref<ChildIndexType, 1> childIndexMemref) {
   if (!m_sparseRepresentation) {
     using InitModelPtr_t = ModelMemrefType (*)(ThresholdType *, ThresholdType *, int64_t, int64_t, int64_t, FeatureIndexType *, FeatureIndexType *, int64_t, int64_t, int64_t, TileShapeType *, TileShapeType *, int64_t, int64_t, int64_t);
     auto initModelPtr = GetFunctionAddress<InitModelPtr_t>("Init_Model");
@@ -134,7 +187,6 @@ int32_t GPUArraySparseSerializerBase::CallInitMethod() {
   }
   else {
     assert (m_sparseRepresentation);
-    Memref<ChildIndexType, 1> childIndexMemref{childIndices.data(), childIndices.data(), 0, {(int64_t)childIndices.size()}, 1};
     using InitModelPtr_t = ModelMemrefType (*)(ThresholdType *, ThresholdType *, int64_t, int64_t, int64_t, FeatureIndexType *, FeatureIndexType *, int64_t, int64_t, int64_t, TileShapeType *, TileShapeType *, int64_t, int64_t, int64_t, ChildIndexType *, ChildIndexType *, int64_t, int64_t, int64_t);
     auto initModelPtr = GetFunctionAddress<InitModelPtr_t>("Init_Model");
 
@@ -191,20 +243,25 @@ int32_t GPUArraySparseSerializerBase::InitializeModelArray() {
 }
 
 void GPUArraySparseSerializerBase::InitializeClassInformation() {
-  if (mlir::decisionforest::ForestJSONReader::GetInstance().GetNumberOfClasses() == 0) return;
+  if (m_forestJSONReader.GetNumberOfClasses() == 0) return;
 
-  std::vector<int8_t> classIds(mlir::decisionforest::ForestJSONReader::GetInstance().GetNumberOfTrees(), -1);
-  auto tileSize = m_inferenceRunner->GetTileSize();
-  auto thresholdSize = m_inferenceRunner->GetThresholdWidth();
-  auto featureIndexSize = m_inferenceRunner->GetFeatureIndexWidth();
-  mlir::decisionforest::ForestJSONReader::GetInstance()
-      .InitializeClassInformation((void *)classIds.data(), tileSize,
-                                  thresholdSize, featureIndexSize);
+  std::vector<int8_t> classIds;
+  auto classIdsMemref = GetMappedModelGlobalsSection<int8_t>(m_forestJSONReader, m_inferenceRunner, BinaryModelGlobalsSectionKind::kClassIDs);
+  if (!classIdsMemref.bufferPtr) {
+    classIds.resize(m_forestJSONReader.GetNumberOfTrees(), -1);
+    auto tileSize = m_inferenceRunner->GetTileSize();
+    auto thresholdSize = m_inferenceRunner->GetThresholdWidth();
+    auto featureIndexSize = m_inferenceRunner->GetFeatureIndexWidth();
+    m_forestJSONReader.InitializeClassInformation((void *)classIds.data(), tileSize,
+                                                  thresholdSize, featureIndexSize);
+    classIdsMemref = Memref<int8_t, 1>{classIds.data(), classIds.data(), 0, {(int64_t)classIds.size()}, {1}};
+  }
 
   using InitClassIdsFunc_t = ClassMemrefType (*)(int8_t *, int8_t *, int64_t, int64_t, int64_t);
 
   auto initClassInfoFuncPtr = GetFunctionAddress<InitClassIdsFunc_t>("Init_ClassIds");
-  m_classIDMemref = initClassInfoFuncPtr(classIds.data(), classIds.data(), (int64_t)0, (int64_t)classIds.size(), (int64_t)1);
+  m_classIDMemref = initClassInfoFuncPtr(classIdsMemref.bufferPtr, classIdsMemref.alignedPtr, classIdsMemref.offset,
+                                         classIdsMemref.lengths[0], classIdsMemref.strides[0]);
 }
 
 void GPUArraySparseSerializerBase::CallPredictionMethod(void* predictFuncPtr,
@@ -230,7 +287,7 @@ void GPUArraySparseSerializerBase::CallPredictionMethod(void* predictFuncPtr,
 
 void GPUArraySparseSerializerBase::CleanupBuffers() {
 
-  if (mlir::decisionforest::ForestJSONReader::GetInstance().GetNumberOfClasses() > 0) {
+  if (m_forestJSONReader.GetNumberOfClasses() > 0) {
     using CleanupFunc_t = int32_t (*)(
         Tile *, Tile *, int64_t, int64_t, int64_t, int64_t *, int64_t *, int64_t,
         int64_t, int64_t, int64_t *, int64_t *, int64_t, int64_t, int64_t,
@@ -262,40 +319,47 @@ void GPUArraySparseSerializerBase::CleanupBuffers() {
 }
 
 void GPUArraySparseSerializerBase::ReadData() {
-    decisionforest::ForestJSONReader::GetInstance().SetFilePath(m_filepath);
-    decisionforest::ForestJSONReader::GetInstance().ParseJSONFile();
+    m_forestJSONReader.SetFilePath(m_filepath);
+    m_forestJSONReader.ParseJSONFile();
 }
 
 // ===---------------------------------------------------=== //
 // Persistence Helper Methods
 // ===---------------------------------------------------=== //
 
-void PersistDecisionForestArrayBased(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType);
-void PersistDecisionForestSparse(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType);
+void PersistDecisionForestArrayBased(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType,
+                                     mlir::decisionforest::ForestJSONReader& forestJSONReader);
+void PersistDecisionForestSparse(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType,
+                                 mlir::decisionforest::ForestJSONReader& forestJSONReader);
 
 // ===---------------------------------------------------=== //
 // GPUSparseRepresentationSerializer Methods
 // ===---------------------------------------------------=== //
 
 void GPUSparseRepresentationSerializer::Persist(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType) {
-    mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath(m_filepath);
-    PersistDecisionForestSparse(forest, forestType);
+    m_forestJSONReader.SetFilePath(m_filepath);
+    PersistDecisionForestSparse(forest, forestType, m_forestJSONReader);
 }
 
 template<typename ThresholdType>
 LeafValueMemref GPUSparseRepresentationSerializer::InitLeafValues(int32_t tileSize, int32_t thresholdBitWidth, int32_t featureIndexBitWidth) {
-  int32_t numLeaves = mlir::decisionforest::ForestJSONReader::GetInstance().GetTotalNumberOfLeaves();
-  std::vector<ThresholdType> leafVals(numLeaves);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeLeaves(reinterpret_cast<void*>(leafVals.data()), 
-                                                                         tileSize,
-                                                                         thresholdBitWidth,
-                                                                         featureIndexBitWidth);
+  std::vector<ThresholdType> leafVals;
+  auto leafValsMemref = GetMappedModelGlobalsSection<ThresholdType>(m_forestJSONReader, m_inferenceRunner, BinaryModelGlobalsSectionKind::kLeaves);
+  if (!leafValsMemref.bufferPtr) {
+    int32_t numLeaves = m_forestJSONReader.GetTotalNumberOfLeaves();
+    leafVals.resize(numLeaves);
+    m_forestJSONReader.InitializeLeaves(reinterpret_cast<void*>(leafVals.data()), 
+                                        tileSize,
+                                        thresholdBitWidth,
+                                        featureIndexBitWidth);
+    leafValsMemref = Memref<ThresholdType, 1>{leafVals.data(), leafVals.data(), 0, {(int64_t)leafVals.size()}, {1}};
+  }
   
   using InitLeafValuesFunc_t = LeafValueMemref (*)(ThresholdType*, ThresholdType*, int64_t, int64_t, int64_t);
 
   auto initLeafValsFuncPtr = GetFunctionAddress<InitLeafValuesFunc_t>("Init_Leaves");
-  auto leafValsMemref = initLeafValsFuncPtr(leafVals.data(), leafVals.data(), (int64_t)0, (int64_t)leafVals.size(), (int64_t)1);
-  return leafValsMemref;
+  return initLeafValsFuncPtr(leafValsMemref.bufferPtr, leafValsMemref.alignedPtr, leafValsMemref.offset,
+                             leafValsMemref.lengths[0], leafValsMemref.strides[0]);
 }
 
 int32_t GPUSparseRepresentationSerializer::InitializeLeafValues(){
@@ -312,34 +376,42 @@ int32_t GPUSparseRepresentationSerializer::InitializeLeafValues(){
 }
 
 int32_t GPUSparseRepresentationSerializer::InitializeLeafLengths(){
-  std::vector<int64_t> leafLengths(mlir::decisionforest::ForestJSONReader::GetInstance().GetNumberOfTrees(), -1);
-  auto tileSize = m_inferenceRunner->GetTileSize();
-  auto thresholdSize = m_inferenceRunner->GetThresholdWidth();
-  auto featureIndexSize = m_inferenceRunner->GetFeatureIndexWidth();
-  mlir::decisionforest::ForestJSONReader::GetInstance()
-      .InitializeLeavesLengthBuffer((void *)leafLengths.data(), tileSize,
-                                    thresholdSize, featureIndexSize);
+  std::vector<int64_t> leafLengths;
+  auto leafLengthsMemref = GetMappedModelGlobalsSection<int64_t>(m_forestJSONReader, m_inferenceRunner, BinaryModelGlobalsSectionKind::kLeavesLengths);
+  if (!leafLengthsMemref.bufferPtr) {
+    leafLengths.resize(m_forestJSONReader.GetNumberOfTrees(), -1);
+    auto tileSize = m_inferenceRunner->GetTileSize();
+    auto thresholdSize = m_inferenceRunner->GetThresholdWidth();
+    auto featureIndexSize = m_inferenceRunner->GetFeatureIndexWidth();
+    m_forestJSONReader.InitializeLeavesLengthBuffer((void *)leafLengths.data(), tileSize,
+                                                    thresholdSize, featureIndexSize);
+    leafLengthsMemref = OffsetMemrefType{leafLengths.data(), leafLengths.data(), 0, {(int64_t)leafLengths.size()}, {1}};
+  }
 
   using InitLeafLengthsFunc_t = OffsetMemrefType (*)(int64_t *, int64_t *, int64_t, int64_t, int64_t);
 
   auto initLeafLengthFuncPtr = GetFunctionAddress<InitLeafLengthsFunc_t>("Init_LeafLengths");
-  m_leafLengthsMemref = initLeafLengthFuncPtr(leafLengths.data(), leafLengths.data(), (int64_t)0, (int64_t)leafLengths.size(), (int64_t)1);
+  m_leafLengthsMemref = initLeafLengthFuncPtr(leafLengthsMemref.bufferPtr, leafLengthsMemref.alignedPtr, leafLengthsMemref.offset, leafLengthsMemref.lengths[0], leafLengthsMemref.strides[0]);
   return 0;
 }
 
 int32_t GPUSparseRepresentationSerializer::InitializeLeafOffsets(){
-  std::vector<int64_t> leafOffsets(mlir::decisionforest::ForestJSONReader::GetInstance().GetNumberOfTrees(), -1);
-  auto tileSize = m_inferenceRunner->GetTileSize();
-  auto thresholdSize = m_inferenceRunner->GetThresholdWidth();
-  auto featureIndexSize = m_inferenceRunner->GetFeatureIndexWidth();
-  mlir::decisionforest::ForestJSONReader::GetInstance()
-      .InitializeLeavesOffsetBuffer((void *)leafOffsets.data(), tileSize,
-                                    thresholdSize, featureIndexSize);
+  std::vector<int64_t> leafOffsets;
+  auto leafOffsetsMemref = GetMappedModelGlobalsSection<int64_t>(m_forestJSONReader, m_inferenceRunner, BinaryModelGlobalsSectionKind::kLeavesOffsets);
+  if (!leafOffsetsMemref.bufferPtr) {
+    leafOffsets.resize(m_forestJSONReader.GetNumberOfTrees(), -1);
+    auto tileSize = m_inferenceRunner->GetTileSize();
+    auto thresholdSize = m_inferenceRunner->GetThresholdWidth();
+    auto featureIndexSize = m_inferenceRunner->GetFeatureIndexWidth();
+    m_forestJSONReader.InitializeLeavesOffsetBuffer((void *)leafOffsets.data(), tileSize,
+                                                    thresholdSize, featureIndexSize);
+    leafOffsetsMemref = OffsetMemrefType{leafOffsets.data(), leafOffsets.data(), 0, {(int64_t)leafOffsets.size()}, {1}};
+  }
 
   using InitLeafOffsetsFunc_t = OffsetMemrefType (*)(int64_t *, int64_t *, int64_t, int64_t, int64_t);
 
   auto initLeafOffsetsFuncPtr = GetFunctionAddress<InitLeafOffsetsFunc_t>("Init_LeafOffsets");
-  m_leafOffsetsMemref = initLeafOffsetsFuncPtr(leafOffsets.data(), leafOffsets.data(), (int64_t)0, (int64_t)leafOffsets.size(), (int64_t)1);
+  m_leafOffsetsMemref = initLeafOffsetsFuncPtr(leafOffsetsMemref.bufferPtr, leafOffsetsMemref.alignedPtr, leafOffsetsMemref.offset, leafOffsetsMemref.lengths[0], leafOffsetsMemref.strides[0]);
   return 0;
 }
 
@@ -410,7 +482,7 @@ void GPUSparseRepresentationSerializer::CleanupBuffers() {
     return;
   }
 
-  if (mlir::decisionforest::ForestJSONReader::GetInstance().GetNumberOfClasses() > 0) {
+  if (m_forestJSONReader.GetNumberOfClasses() > 0) {
     using CleanupFunc_t = int32_t (*)(
         Tile *, Tile *, int64_t, int64_t, int64_t, // Model
         int64_t *, int64_t *, int64_t, int64_t, int64_t, // Offsets
@@ -462,8 +534,8 @@ REGISTER_SERIALIZER(gpu_sparse, ConstructGPUSparseRepresentation)
 // ===---------------------------------------------------=== //
 
 void GPUArrayRepresentationSerializer::Persist(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType) {
-    mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath(m_filepath);
-    PersistDecisionForestArrayBased(forest, forestType);
+    m_forestJSONReader.SetFilePath(m_filepath);
+    PersistDecisionForestArrayBased(forest, forestType, m_forestJSONReader);
 }
 
 void GPUArrayRepresentationSerializer::InitializeBuffersImpl() {
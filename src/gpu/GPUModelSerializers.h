@@ -25,7 +25,12 @@ protected:
   bool m_sparseRepresentation;
   template<typename ThresholdType, typename FeatureIndexType, typename TileShapeType, typename ChildIndexType>
   int32_t CallInitMethod();
-  
+  template<typename ThresholdType, typename FeatureIndexType, typename TileShapeType, typename ChildIndexType>
+  int32_t CallInitMethodWithMappedModelGlobals();
+  template<typename ThresholdType, typename FeatureIndexType, typename TileShapeType, typename ChildIndexType>
+  int32_t CallInitModelFunction(Memref<ThresholdType, 1> thresholdsMemref, Memref<FeatureIndexType, 1> featureIndexMemref,
+                                Memref<TileShapeType, 1> tileShapeIDMemref, Memref<ChildIndexType, 1> childIndexMemref);
+
   template<typename ThresholdType, typename FeatureIndexType>
   int32_t ResolveTileShapeType();
 
@@ -39,7 +44,9 @@ protected:
 public:
   GPUArraySparseSerializerBase(const std::string& modelGlobalsJSONPath, bool sparseRep)
     :IModelSerializer(modelGlobalsJSONPath), m_sparseRepresentation(sparseRep)
-  { }
+  { 
+    m_forestJSONReader.SetSparseRepresentation(sparseRep);
+  }
   ~GPUArraySparseSerializerBase() { }
   void ReadData() override;
 
@@ -354,6 +354,8 @@ mlir::LogicalResult GPUArrayBasedRepresentation::GenerateModelGlobals(Operation
 
   mlir::decisionforest::DecisionForestAttribute forestAttribute = ensembleConstOp.getForest();
   mlir::decisionforest::DecisionForest& forest = forestAttribute.GetDecisionForest();
+  assert (!forest.HasCategoricalSplits() && "Categorical splits are not supported on GPUs");
+  assert (!forest.ProfileLeafHits() && "Leaf hit profiling is not supported on GPUs");
   auto forestType = ensembleConstOp.getResult().getType().cast<decisionforest::TreeEnsembleType>();
   assert (forestType.doAllTreesHaveSameTileSize()); // There is still an assumption here that all trees have the same tile size
   auto treeType = forestType.getTreeType(0).cast<decisionforest::TreeType>();
@@ -374,7 +376,7 @@ mlir::LogicalResult GPUArrayBasedRepresentation::GenerateModelGlobals(Operation
 
   m_serializer->Persist(forest, forestType);
   
-  auto modelMemrefSize = decisionforest::GetTotalNumberOfTiles();
+  auto modelMemrefSize = m_serializer->GetForestJSONReader().GetTotalNumberOfTiles();
   auto modelMemrefType = MemRefType::get({modelMemrefSize}, modelMemrefElementType);
   func.insertArgument(func.getNumArguments(), modelMemrefType, mlir::DictionaryAttr(), location);
   m_modelMemrefArgIndex = func.getNumArguments() - 1;
@@ -455,13 +457,14 @@ void GPUArrayBasedRepresentation::LowerCacheTreeOp(ConversionPatternRewriter &re
   auto& ensembleInfo = ensembleConstantToMemrefsMap[ensembleConst.getOperation()];
 
   // Compute the size of the shared mem buffer (max tree size * step)
-  std::vector<int32_t> lengths(decisionforest::ForestJSONReader::GetInstance().GetNumberOfTrees(), -1);
+  auto& forestJSONReader = m_serializer->GetForestJSONReader();
+  std::vector<int32_t> lengths(forestJSONReader.GetNumberOfTrees(), -1);
   auto tileSize = ensembleConst.getForest().GetDecisionForest().GetTree(0).TilingDescriptor().MaxTileSize();
   
-  decisionforest::ForestJSONReader::GetInstance().InitializeLengthBuffer(lengths.data(), 
-                                                                         tileSize,
-                                                                         treeType.getThresholdType().getIntOrFloatBitWidth(),
-                                                                         treeType.getFeatureIndexType().getIntOrFloatBitWidth());
+  forestJSONReader.InitializeLengthBuffer(lengths.data(), 
+                                          tileSize,
+                                          treeType.getThresholdType().getIntOrFloatBitWidth(),
+                                          treeType.getFeatureIndexType().getIntOrFloatBitWidth());
   auto maxLen = *std::max_element(lengths.begin(), lengths.end());
 
   auto owningForLoop = cacheTreesOp->getParentOfType<scf::ForOp>();
@@ -672,7 +675,8 @@ Type GPUSparseRepresentation::GenerateLeafBuffers(ConversionPatternRewriter &rew
                                                   Location location, 
                                                   ModuleOp module,
                                                   Operation* op,
-                                                  std::vector<Type>& cleanupArgs) {
+                                                  std::vector<Type>& cleanupArgs,
+                                                  decisionforest::IModelSerializer& serializer) {
 
   // Generate a new function with the extra arguments that are needed
   auto ensembleConstOp = AssertOpIsOfType<decisionforest::EnsembleConstantOp>(op);
@@ -683,7 +687,7 @@ Type GPUSparseRepresentation::GenerateLeafBuffers(ConversionPatternRewriter &rew
   mlir::decisionforest::DecisionForest& forest = forestAttribute.GetDecisionForest();
 
   // Add the leaves memref
-  auto leavesMemrefSize = decisionforest::GetTotalNumberOfLeaves();
+  auto leavesMemrefSize = serializer.GetForestJSONReader().GetTotalNumberOfLeaves();
   auto leavesMemrefType = MemRefType::get({leavesMemrefSize}, m_thresholdType);
   func.insertArgument(func.getNumArguments(), leavesMemrefType, mlir::DictionaryAttr(), location);
   m_leavesMemrefArgIndex = func.getNumArguments() - 1;
@@ -721,6 +725,8 @@ mlir::LogicalResult GPUSparseRepresentation::GenerateModelGlobals(Operation *op,
 
   mlir::decisionforest::DecisionForestAttribute forestAttribute = ensembleConstOp.getForest();
   mlir::decisionforest::DecisionForest& forest = forestAttribute.GetDecisionForest();
+  assert (!forest.HasCategoricalSplits() && "Categorical splits are not supported on GPUs");
+  assert (!forest.ProfileLeafHits() && "Leaf hit profiling is not supported on GPUs");
   auto forestType = ensembleConstOp.getResult().getType().cast<decisionforest::TreeEnsembleType>();
   assert (forestType.doAllTreesHaveSameTileSize()); // There is still an assumption here that all trees have the same tile size
   auto treeType = forestType.getTreeType(0).cast<decisionforest::TreeType>();
@@ -741,7 +747,7 @@ mlir::LogicalResult GPUSparseRepresentation::GenerateModelGlobals(Operation *op,
 
   m_serializer->Persist(forest, forestType);
   
-  auto modelMemrefSize = decisionforest::GetTotalNumberOfTiles();
+  auto modelMemrefSize = m_serializer->GetForestJSONReader().GetTotalNumberOfTiles();
   auto modelMemrefType = MemRefType::get({modelMemrefSize}, modelMemrefElementType);
   func.insertArgument(func.getNumArguments(), modelMemrefType, mlir::DictionaryAttr(), location);
   m_modelMemrefArgIndex = func.getNumArguments() - 1;
@@ -776,7 +782,7 @@ mlir::LogicalResult GPUSparseRepresentation::GenerateModelGlobals(Operation *op,
   Value leavesMemref, leavesOffsetMemref, leavesLengthsMemref;
   Type leavesMemrefType;
   if (tileSize > 1) {
-    this->GenerateLeafBuffers(rewriter, location, module, op, cleanupArgs);
+    this->GenerateLeafBuffers(rewriter, location, module, op, cleanupArgs, *m_serializer);
     leavesMemref = func.getArgument(m_leavesMemrefArgIndex);
     leavesOffsetMemref = func.getArgument(m_leavesOffsetMemrefArgIndex);
     leavesLengthsMemref = func.getArgument(m_leavesLengthsMemrefArgIndex);
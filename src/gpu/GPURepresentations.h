@@ -67,7 +67,8 @@ protected:
                            Location location, 
                            ModuleOp module,
                            Operation* op,
-                           std::vector<Type>& cleanupArgs);
+                           std::vector<Type>& cleanupArgs,
+                           decisionforest::IModelSerializer& serializer);
 public:
   virtual ~GPUSparseRepresentation() { }
   void InitRepresentation() override { }
@@ -282,7 +282,7 @@ bool ReorgForestSerializer::HasCustomPredictionMethod() {
 }
 
 void ReorgForestSerializer::CleanupBuffers() {
-  if (mlir::decisionforest::ForestJSONReader::GetInstance().GetNumberOfClasses() > 0) {
+  if (m_numberOfClasses > 1) {
     using CleanupFunc_t = int32_t (*)(
         double *, double *, int64_t, int64_t, int64_t,
         int32_t *, int32_t *, int64_t, int64_t, int64_t,
@@ -339,6 +339,8 @@ mlir::LogicalResult ReorgForestRepresentation::GenerateModelGlobals(Operation *o
 
   mlir::decisionforest::DecisionForestAttribute forestAttribute = ensembleConstOp.getForest();
   mlir::decisionforest::DecisionForest& forest = forestAttribute.GetDecisionForest();
+  assert (!forest.HasCategoricalSplits() && "Categorical splits are not supported on GPUs");
+  assert (!forest.ProfileLeafHits() && "Leaf hit profiling is not supported on GPUs");
   auto forestType = ensembleConstOp.getResult().getType().cast<decisionforest::TreeEnsembleType>();
   assert (forestType.doAllTreesHaveSameTileSize()); // There is still an assumption here that all trees have the same tile size
   auto treeType = forestType.getTreeType(0).cast<decisionforest::TreeType>();
@@ -0,0 +1,155 @@
+#ifndef _BINARYMODELGLOBALS_H_
+#define _BINARYMODELGLOBALS_H_
+
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// A binary alternative to the model globals JSON written by ForestJSONReader. The file is laid out as
+//   BinaryModelGlobalsHeader
+//   BinaryModelGlobalsEntry x header.numberOfEntries (one per (tile size, threshold width, index width))
+//   Sections, each starting at a multiple of header.alignment bytes from the start of the file
+// Values are stored in host byte order and in the element types that the generated code expects
+// (for example, float thresholds when the threshold width is 32), so a mapped file can be handed to
+// the buffer initialization functions without any parsing or copying.
+
+namespace mlir
+{
+namespace decisionforest
+{
+
+constexpr char BinaryModelGlobalsMagic[8] = {'T', 'B', 'G', 'L', 'O', 'B', 'A', 'L'};
+// Increment whenever the layout of the header, the entries or any section changes
+constexpr uint32_t BinaryModelGlobalsVersion = 1;
+constexpr uint32_t BinaryModelGlobalsAlignment = 64;
+// Model globals files with this extension are written in the binary format
+const std::string BinaryModelGlobalsFileExtension = ".bin";
+
+enum class BinaryModelGlobalsSectionKind : int32_t {
+  kTreeIndices = 0,   // int32, one per tree in the entry (in serialization order)
+  kNumberOfTiles,     // int32, one per tree in the entry
+  kTreeElementCounts, // int32 x 4 per tree in the entry : #thresholds, #tile shape IDs, #child indices, #leaves
+  kThresholds,        // Floats of the entry's threshold width
+  kFeatureIndices,    // Integers of the entry's index width
+  kTileShapeIDs,      // Integers of the header's tile shape width
+  kChildIndices,      // Integers of the header's child index width
+  kLeaves,            // Floats of the entry's threshold width
+  kTreeOffsets,       // int64, one per tree in the model (indexed by tree index, -1 if absent)
+  kTreeLengths,       // int64, one per tree in the model (indexed by tree index, 0 if absent)
+  kLeavesOffsets,     // int64, one per tree in the model (indexed by tree index, -1 if absent)
+  kLeavesLengths,     // int64, one per tree in the model (indexed by tree index, 0 if absent)
+  kClassIDs,          // int8, one per tree in the entry
+  kNumberOfSections
+};
+
+struct BinaryModelGlobalsSection {
+  uint64_t offset; // In bytes from the start of the file
+  uint64_t numberOfElements;
+  int32_t elementBitWidth;
+  int32_t isFloat;
+};
+
+struct BinaryModelGlobalsEntry {
+  int32_t tileSize;
+  int32_t thresholdBitWidth;
+  int32_t indexBitWidth;
+  int32_t numberOfTrees;
+  BinaryModelGlobalsSection sections[static_cast<int32_t>(BinaryModelGlobalsSectionKind::kNumberOfSections)];
+
+  const BinaryModelGlobalsSection& GetSection(BinaryModelGlobalsSectionKind kind) const {
+    return sections[static_cast<int32_t>(kind)];
+  }
+};
+
+struct BinaryModelGlobalsHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t alignment;
+  uint64_t fileSize;
+  int32_t inputElementBitWidth;
+  int32_t returnTypeBitWidth;
+  int32_t rowSize;
+  int32_t batchSize;
+  int32_t numberOfTrees;
+  int32_t childIndexBitWidth;
+  int32_t tileShapeBitWidth;
+  int32_t numberOfClasses;
+  int32_t sparseRepresentation;
+  int32_t numberOfEntries;
+};
+
+// Accumulates the sections of a binary model globals file in memory and writes them out
+// with the header and entry table.
+class BinaryModelGlobalsWriter {
+  BinaryModelGlobalsHeader m_header;
+  std::vector<BinaryModelGlobalsEntry> m_entries;
+  // Offsets of sections are relative to the start of this buffer until Write is called
+  std::vector<char> m_sectionData;
+
+  void AddSectionImpl(int32_t entryIndex, BinaryModelGlobalsSectionKind kind, const void* data,
+                      uint64_t numberOfElements, int32_t elementBitWidth, bool isFloat);
+public:
+  // Only the model configuration fields of header are used. The magic, version,
+  // alignment and size are filled in by the writer.
+  BinaryModelGlobalsWriter(const BinaryModelGlobalsHeader& header);
+
+  BinaryModelGlobalsEntry& GetEntry(int32_t entryIndex) { return m_entries.at(entryIndex); }
+
+  template<typename T>
+  void AddSection(int32_t entryIndex, BinaryModelGlobalsSectionKind kind, const std::vector<T>& values) {
+    static_assert(std::is_arithmetic<T>::value, "Sections can only hold numbers");
+    AddSectionImpl(entryIndex, kind, values.data(), values.size(), sizeof(T)*8, std::is_floating_point<T>::value);
+  }
+
+  void Write(const std::string& filename);
+};
+
+// A memory mapped binary model globals file. The mapping is private, so buffers handed out by
+// GetSection can be passed to functions that take non-const pointers without modifying the file.
+// Pointers remain valid as long as this object is alive.
+class MappedBinaryModelGlobals {
+  char* m_base = nullptr;
+  size_t m_size = 0;
+  // Entries indexed by (tile size, threshold width, index width)
+  std::map<std::tuple<int32_t, int32_t, int32_t>, const BinaryModelGlobalsEntry*> m_entryIndex;
+
+  void Validate(const std::string& filename);
+public:
+  // Throws std::runtime_error if the file can't be mapped or isn't a well formed binary model globals file
+  MappedBinaryModelGlobals(const std::string& filename);
+  ~MappedBinaryModelGlobals();
+
+  MappedBinaryModelGlobals(const MappedBinaryModelGlobals&) = delete;
+  MappedBinaryModelGlobals& operator=(const MappedBinaryModelGlobals&) = delete;
+
+  const BinaryModelGlobalsHeader& GetHeader() const { return *reinterpret_cast<const BinaryModelGlobalsHeader*>(m_base); }
+  const BinaryModelGlobalsEntry& GetEntry(int32_t entryIndex) const;
+  // Returns nullptr if there is no entry with the given tile size and widths
+  const BinaryModelGlobalsEntry* FindEntry(int32_t tileSize, int32_t thresholdBitWidth, int32_t indexBitWidth) const;
+
+  template<typename T>
+  T* GetSection(const BinaryModelGlobalsEntry& entry, BinaryModelGlobalsSectionKind kind) const {
+    auto& section = entry.GetSection(kind);
+    assert (section.elementBitWidth == static_cast<int32_t>(sizeof(T)*8) && "Section element type mismatch");
+    assert (section.isFloat == std::is_floating_point<T>::value && "Section element type mismatch");
+    assert (section.offset + section.numberOfElements*sizeof(T) <= m_size);
+    return reinterpret_cast<T*>(m_base + section.offset);
+  }
+
+  static int64_t GetNumberOfElements(const BinaryModelGlobalsEntry& entry, BinaryModelGlobalsSectionKind kind) {
+    return static_cast<int64_t>(entry.GetSection(kind).numberOfElements);
+  }
+
+  // Checks the magic number at the start of the file
+  static bool IsBinaryModelGlobalsFile(const std::string& filename);
+  static bool IsBinaryModelGlobalsFilePath(const std::string& filename);
+};
+
+} // decisionforest
+} // mlir
+
+#endif // _BINARYMODELGLOBALS_H_
@@ -12,10 +12,12 @@
 #include <queue>
 #include <map>
 #include <iostream>
+#include <limits>
 #include <fstream>
 #include "TreeTilingDescriptor.h"
 #include <numeric>
 #include <algorithm>
+#include <functional>
 #include <memory>
 
 namespace mlir
@@ -25,9 +27,14 @@ namespace decisionforest
 
 class TiledTree;
 
-enum class PredictionTransformation { kIdentity, kSigmoid, kSoftMax, kUnknown };
-enum class ReductionType { kAdd, kVoting };
+enum class PredictionTransformation { kIdentity, kSigmoid, kSoftMax, kExponential, kUnknown };
+// kAdd sums the predictions of the trees of each class. kAverage divides these sums by the number of trees 
+// that are summed. The leaves of kVoting forests are class indices and their output for a class is the fraction 
+// of trees that predict it.
+enum class ReductionType { kAdd, kVoting, kAverage };
 enum class FeatureType { kNumerical, kCategorical };
+// Which way the non-leaf nodes of a forest send rows whose feature value is missing (NaN)
+enum class MissingValueRouting { kAllRight, kAllLeft, kPerNode };
 
 class DecisionTree
 {
@@ -40,13 +47,17 @@ public:
         int64_t parent;
         int64_t leftChild;
         int64_t rightChild;
-        FeatureType featureType; // TODO For now assuming everything is numerical
+        // For categorical nodes, threshold holds the offset of the node's category set in the
+        // forest's categorical bitset table (see DecisionForest::AddCategoricalBitset)
+        FeatureType featureType;
+        bool defaultLeft = false; // Direction taken when the feature value is missing (NaN)
         int32_t hitCount = 0;
         int32_t depth = -1;
         bool operator==(const Node& that) const
         {
             return threshold==that.threshold && featureIndex==that.featureIndex && parent==that.parent &&
-                   leftChild==that.leftChild && rightChild==that.rightChild && featureType==that.featureType;
+                   leftChild==that.leftChild && rightChild==that.rightChild && featureType==that.featureType &&
+                   defaultLeft==that.defaultLeft;
         }
 
         bool IsLeaf() const
@@ -78,6 +89,21 @@ public:
     void SetNodeRightChild(int64_t node, int64_t child) { m_nodes[node].rightChild = child; }
     // Set left child of a node
     void SetNodeLeftChild(int64_t node, int64_t child) { m_nodes[node].leftChild = child; }
+    // Set the direction a node sends missing feature values in
+    void SetNodeDefaultLeft(int64_t node, bool defaultLeft) {
+        m_nodes[node].defaultLeft = defaultLeft;
+        m_hasMissingValueDirections = true;
+    }
+    // False for trees whose creator never set the direction of a node. These send missing values
+    // the way the forest's comparison predicate does (see DecisionForest::SetUnsetMissingValueDirections)
+    bool HasMissingValueDirections() const { return m_hasMissingValueDirections; }
+    // Make a node send rows whose feature value is in the category set at bitsetOffset right
+    void SetNodeCategoricalSplit(int64_t node, int32_t bitsetOffset)
+    {
+        m_nodes[node].featureType = FeatureType::kCategorical;
+        m_nodes[node].threshold = bitsetOffset;
+    }
+    void SetNodeThreshold(int64_t node, double threshold) { m_nodes.at(node).threshold = threshold; }
 
     std::string Serialize() const;
     std::string PrintToString() const;
@@ -88,8 +114,10 @@ public:
                && m_scale==that.m_scale && m_tilingDescriptor==that.m_tilingDescriptor;
     }
 
-    double PredictTree(std::vector<double>& data) const;
-    float PredictTree_Float(std::vector<float>& data) const;
+    // categoricalBitsets is the bitset table of the forest the tree belongs to. It is only
+    // needed if the tree has categorical splits.
+    double PredictTree(std::vector<double>& data, const std::vector<uint32_t>* categoricalBitsets=nullptr) const;
+    float PredictTree_Float(std::vector<float>& data, const std::vector<uint32_t>* categoricalBitsets=nullptr) const;
 
     TreeTilingDescriptor& TilingDescriptor() { return m_tilingDescriptor; }
     const TreeTilingDescriptor& TilingDescriptor() const { return m_tilingDescriptor; }
@@ -107,12 +135,27 @@ public:
         return numNodes;
     }
 
+    // The smallest and largest values the tree can predict
+    std::pair<double, double> GetLeafValueRange() const {
+        double minValue = std::numeric_limits<double>::infinity();
+        double maxValue = -std::numeric_limits<double>::infinity();
+        for (auto& node : m_nodes) {
+            if (!node.IsLeaf())
+                continue;
+            minValue = std::min(minValue, node.threshold);
+            maxValue = std::max(maxValue, node.threshold);
+        }
+        return std::make_pair(minValue, maxValue);
+    }
+
     std::vector<double> GetThresholdArray();
-    std::vector<int32_t> GetFeatureIndexArray();
+    // If encodeDefaultLeft is set, the feature indices of nodes that send missing values left are encoded
+    // (see EncodeDefaultLeftFeatureIndex)
+    std::vector<int32_t> GetFeatureIndexArray(bool encodeDefaultLeft=false);
     
     // Helpers for sparse representation
     std::vector<double> GetSparseThresholdArray();
-    std::vector<int32_t> GetSparseFeatureIndexArray();
+    std::vector<int32_t> GetSparseFeatureIndexArray(bool encodeDefaultLeft=false);
     std::vector<int32_t> GetChildIndexArray();
     
     int32_t GetNumberOfTiles();
@@ -137,6 +180,7 @@ private:
     // TODO It looks like some tests aren't setting this property at all! 
     // Adding an initialization to make sure we aren't accessing unitialized memory
     int32_t m_classId = 0;
+    bool m_hasMissingValueDirections = false;
     
     std::shared_ptr<TiledTree> m_tiledTree = nullptr;
 
@@ -159,6 +203,7 @@ public:
     };
 
     void SetReductionType(ReductionType reductionType) { m_reductionType = reductionType; }
+    ReductionType GetReductionType() const { return m_reductionType; }
     void AddFeature(const std::string& featureName, const std::string& type)
     {
         Feature f{featureName, type};
@@ -179,6 +224,16 @@ public:
     std::string PrintToString() const;
     double Predict(std::vector<double>& data) const;
     float Predict_Float(std::vector<float>& data) const;
+    // One value per class (or target) of multi-class and multi-target models, and a single value otherwise. 
+    // Softmax models return the probability of each class rather than the most likely class.
+    std::vector<double> PredictAllOutputs(std::vector<double>& data) const;
+    // The output of each class (or the only output) before it is transformed (see ReductionType)
+    template<typename T>
+    std::vector<T> ReduceTreePredictions(const std::vector<T>& treePredictions) const;
+    template<typename T>
+    T TransformPrediction(T prediction) const { return TransformPrediction(prediction, m_predictionTransform); }
+    template<typename T>
+    static T TransformPrediction(T prediction, PredictionTransformation predictionTransform);
     
     bool operator==(const DecisionForest& that) const {
         if (m_reductionType!=that.m_reductionType)
@@ -188,26 +243,109 @@ public:
         for (size_t i=0 ; i<m_trees.size() ; ++i)
             if (!(*m_trees[i] == *(that.m_trees[i])))
                 return false;
-        return true;
+        return m_categoricalBitsets==that.m_categoricalBitsets;
     }
     
     void SetPredictionTransformation(PredictionTransformation val) { m_predictionTransform = val; }
     PredictionTransformation GetPredictionTransformation() const { return m_predictionTransform; }
 
+    // Forests that combine several single output models have one output per model and give each output the
+    // initial offset and transformation of its model. These are empty for other forests, whose outputs all 
+    // share the forest's initial offset and transformation.
+    void SetOutputInitialOffsets(const std::vector<double>& offsets) { m_outputInitialValues = offsets; }
+    const std::vector<double>& GetOutputInitialOffsets() const { return m_outputInitialValues; }
+    void SetOutputPredictionTransformations(const std::vector<PredictionTransformation>& transforms) { m_outputPredictionTransforms = transforms; }
+    const std::vector<PredictionTransformation>& GetOutputPredictionTransformations() const { return m_outputPredictionTransforms; }
+    double GetOutputInitialOffset(int32_t output) const { 
+        return m_outputInitialValues.empty() ? m_initialValue : m_outputInitialValues.at(output);
+    }
+    PredictionTransformation GetOutputPredictionTransformation(int32_t output) const {
+        return m_outputPredictionTransforms.empty() ? m_predictionTransform : m_outputPredictionTransforms.at(output);
+    }
+
     void SetNumClasses(int32_t numClasses) { m_numClasses = numClasses; }
     int32_t GetNumClasses() { return m_numClasses; }
     bool IsMultiClassClassifier() { return m_numClasses > 0; }
+    // Multi-target models have one class per target
+    int32_t GetNumOutputs() const { return std::max(m_numClasses, 1); }
 
     std::vector<std::shared_ptr<DecisionTree>>& GetTrees() { return m_trees; }
+    MissingValueRouting GetMissingValueRouting() const;
+    // Make the nodes of trees without missing value directions send missing values left if 
+    // defaultLeft is set and right otherwise
+    void SetUnsetMissingValueDirections(bool defaultLeft);
+    // The largest feature index used by a split, or -1 if the forest has no splits
+    int32_t GetMaxSplitFeatureIndex() const;
+
+    // Add a set of categories to the bitset table and return its offset. Each set is stored as
+    // the number of 32 bit words in the set followed by the words, with category c in bit c%32 of
+    // word c/32. Identical sets share storage.
+    int32_t AddCategoricalBitset(const std::vector<int32_t>& categories);
+    const std::vector<uint32_t>& GetCategoricalBitsets() const { return m_categoricalBitsets; }
+    bool HasCategoricalSplits() const { return !m_categoricalBitsets.empty(); }
+    // One entry per feature (up to the largest feature index used by the forest), 1 if the
+    // feature is split on categorically. A feature can't be used by both kinds of splits.
+    std::vector<int8_t> GetCategoricalFeatureMask() const;
+
+    // Replace the threshold of every numerical split with the index of its bin among the distinct thresholds 
+    // of its feature. Comparing quantized feature values (see QuantizeFeatureValue) with the quantized thresholds 
+    // has the same outcome as comparing the original values with the thresholds rounded by roundThreshold. 
+    // binsIncludeBoundaries must be set for less than and greater or equal predicates and cleared for less or 
+    // equal and greater than predicates.
+    void QuantizeThresholds(bool binsIncludeBoundaries, const std::function<double(double)>& roundThreshold);
+    bool IsQuantized() const { return m_isQuantized; }
+    bool QuantizedBinsIncludeBoundaries() const { return m_quantizedBinsIncludeBoundaries; }
+    // Sorted distinct (rounded) thresholds of each feature. Empty for features no numerical split uses.
+    const std::vector<std::vector<double>>& GetQuantizationBoundaries() const { return m_quantizationBoundaries; }
+    // The number of boundaries of the feature that are less than value (or less than or equal to it if bins 
+    // include their boundaries). NaNs and values of features with no boundaries are returned as is.
+    double QuantizeFeatureValue(int32_t featureIndex, double value) const;
+
+    // Count the walks that end at each leaf in the generated code (see CompilerOptions::profileLeafHits)
+    void SetProfileLeafHits(bool value) { m_profileLeafHits = value; }
+    bool ProfileLeafHits() const { return m_profileLeafHits; }
 private:
     std::vector<Feature> m_features;
     std::vector<std::shared_ptr<DecisionTree>> m_trees;
+    std::vector<uint32_t> m_categoricalBitsets;
+    std::map<std::vector<uint32_t>, int32_t> m_categoricalBitsetOffsets;
+    std::vector<std::vector<double>> m_quantizationBoundaries;
+    bool m_isQuantized = false;
+    bool m_quantizedBinsIncludeBoundaries = false;
+    bool m_profileLeafHits = false;
     ReductionType m_reductionType = ReductionType::kAdd;
     double m_initialValue;
     PredictionTransformation m_predictionTransform;
     int32_t m_numClasses;
+    std::vector<double> m_outputInitialValues;
+    std::vector<PredictionTransformation> m_outputPredictionTransforms;
 };
 
+// When nodes in a forest disagree on the direction of missing values, the feature index of
+// nodes that send them left is stored as -(featureIndex + 2) so that -1 still marks leaves.
+inline int32_t EncodeDefaultLeftFeatureIndex(int32_t featureIndex) { return -featureIndex - 2; }
+
+inline int32_t GetSerializedFeatureIndex(const DecisionTree::Node& node, bool encodeDefaultLeft)
+{
+    if (node.IsLeaf())
+        return -1;
+    if (encodeDefaultLeft && node.defaultLeft)
+        return EncodeDefaultLeftFeatureIndex(node.featureIndex);
+    return node.featureIndex;
+}
+
+// Returns true if value is one of the categories in the set stored at bitsetOffset. Fractional values are
+// truncated (2.7 is category 2), as XGBoost and LightGBM do and as the generated code does. Negative, NaN
+// and out of range values are never in the set.
+inline bool IsInCategoricalBitset(const std::vector<uint32_t>& bitsets, int32_t bitsetOffset, double value)
+{
+    auto numWords = bitsets.at(bitsetOffset);
+    if (!(value >= 0 && value < numWords*32.0))
+        return false;
+    auto category = static_cast<uint32_t>(value);
+    return (bitsets.at(bitsetOffset + 1 + category/32) >> (category%32)) & 1;
+}
+
 inline int32_t DecisionTree::GetTreeDepthHelper(size_t node) const
 {
     const Node& n = this->m_nodes[node];
@@ -222,8 +360,6 @@ void DecisionTree::GetNodeAttributeArray(std::vector<AttribType>& attributeVec,
 {
     Node& node = m_nodes[nodeIndex];
     assert(vecIndex < attributeVec.size());
-    // TODO What is the type we set on leaf nodes?
-    assert(node.featureType == FeatureType::kNumerical || node.IsLeaf());
     attributeVec[vecIndex] = get(node);
 
     if (node.IsLeaf())
@@ -243,14 +379,14 @@ inline std::vector<double> DecisionTree::GetThresholdArray()
     return thresholdVec;
 }
 
-inline std::vector<int32_t> DecisionTree::GetFeatureIndexArray()
+inline std::vector<int32_t> DecisionTree::GetFeatureIndexArray(bool encodeDefaultLeft)
 {
     int32_t depth = GetTreeDepth();
     size_t vectorLength = static_cast<size_t>(std::pow(2, depth)) - 1;
     std::vector<int32_t> featureIndexVec(vectorLength, -1);
     assert (m_tilingDescriptor.MaxTileSize() == 1 && "Only size 1 tiles currently supported");
 
-    GetNodeAttributeArray(featureIndexVec, 0, 0, [](Node& n) { return n.IsLeaf() ? -1 : n.featureIndex; });
+    GetNodeAttributeArray(featureIndexVec, 0, 0, [=](Node& n) { return GetSerializedFeatureIndex(n, encodeDefaultLeft); });
     return featureIndexVec;
 }
 
@@ -275,6 +411,7 @@ inline std::string DecisionTree::Serialize() const
         strStream << node.leftChild;
         strStream << node.rightChild;
         strStream << (int32_t)node.featureType; 
+        strStream << node.defaultLeft;
     }
     return strStream.str();
 }
@@ -286,7 +423,7 @@ inline std::string DecisionTree::PrintToString() const
     return strStream.str();
 }
 
-inline double DecisionTree::PredictTree(std::vector<double>& data) const
+inline double DecisionTree::PredictTree(std::vector<double>& data, const std::vector<uint32_t>* categoricalBitsets) const
 {
     // go over the features
     assert(m_nodes.size() > 0);
@@ -295,7 +432,15 @@ inline double DecisionTree::PredictTree(std::vector<double>& data) const
     while (!node->IsLeaf())
     {
       // std::cout << "\tf" << node->featureIndex << "(" << data[node->featureIndex] << ")" << " < " << node->threshold << std::endl;
-      if (data[node->featureIndex] < node->threshold)
+      auto feature = data[node->featureIndex];
+      bool goLeft;
+      if (std::isnan(feature))
+        goLeft = node->defaultLeft;
+      else if (node->featureType == FeatureType::kCategorical)
+        goLeft = !IsInCategoricalBitset(*categoricalBitsets, static_cast<int32_t>(node->threshold), feature);
+      else
+        goLeft = feature < node->threshold;
+      if (goLeft)
         node = &m_nodes[node->leftChild];
       else
         node = &m_nodes[node->rightChild];
@@ -306,7 +451,7 @@ inline double DecisionTree::PredictTree(std::vector<double>& data) const
     return node->threshold;
 }
 
-inline float DecisionTree::PredictTree_Float(std::vector<float>& data) const
+inline float DecisionTree::PredictTree_Float(std::vector<float>& data, const std::vector<uint32_t>* categoricalBitsets) const
 {
     // go over the features
     assert(m_nodes.size() > 0);
@@ -314,7 +459,15 @@ inline float DecisionTree::PredictTree_Float(std::vector<float>& data) const
     while (!node->IsLeaf())
     {
       // std::cout << "\tf" << node->featureIndex << "(" << data[node->featureIndex] << ")" << " < " << node->threshold << std::endl;
-      if (data[node->featureIndex] < (float)node->threshold)
+      auto feature = data[node->featureIndex];
+      bool goLeft;
+      if (std::isnan(feature))
+        goLeft = node->defaultLeft;
+      else if (node->featureType == FeatureType::kCategorical)
+        goLeft = !IsInCategoricalBitset(*categoricalBitsets, static_cast<int32_t>(node->threshold), feature);
+      else
+        goLeft = feature < (float)node->threshold;
+      if (goLeft)
         node = &m_nodes[node->leftChild];
       else
         node = &m_nodes[node->rightChild];
@@ -365,12 +518,145 @@ inline int32_t DecisionTree::GetSubtreeHitCount(int32_t nodeIndex) {
     return node.hitCount;
 }
 
+inline MissingValueRouting DecisionForest::GetMissingValueRouting() const
+{
+    bool anyDefaultLeft = false, anyDefaultRight = false;
+    for (auto& tree : m_trees) {
+        for (auto& node : tree->GetNodes()) {
+            if (node.IsLeaf())
+                continue;
+            anyDefaultLeft |= node.defaultLeft;
+            anyDefaultRight |= !node.defaultLeft;
+        }
+    }
+    if (anyDefaultLeft && anyDefaultRight)
+        return MissingValueRouting::kPerNode;
+    return anyDefaultLeft ? MissingValueRouting::kAllLeft : MissingValueRouting::kAllRight;
+}
+
+inline void DecisionForest::SetUnsetMissingValueDirections(bool defaultLeft)
+{
+    for (auto& tree : m_trees) {
+        if (tree->HasMissingValueDirections())
+            continue;
+        auto numNodes = static_cast<int64_t>(tree->GetNodes().size());
+        for (int64_t i=0 ; i<numNodes ; ++i)
+            if (!tree->GetNodes()[i].IsLeaf())
+                tree->SetNodeDefaultLeft(i, defaultLeft);
+    }
+}
+
+inline int32_t DecisionForest::GetMaxSplitFeatureIndex() const
+{
+    int32_t maxFeatureIndex = -1;
+    for (auto& tree : m_trees)
+        for (auto& node : tree->GetNodes())
+            if (!node.IsLeaf())
+                maxFeatureIndex = std::max(maxFeatureIndex, node.featureIndex);
+    return maxFeatureIndex;
+}
+
+inline int32_t DecisionForest::AddCategoricalBitset(const std::vector<int32_t>& categories)
+{
+    int32_t maxCategory = -1;
+    for (auto category : categories) {
+        assert (category >= 0 && "Categories must be non-negative");
+        maxCategory = std::max(maxCategory, category);
+    }
+    // Even an empty set has one word so that membership tests never read past the table
+    std::vector<uint32_t> words(maxCategory/32 + 1, 0);
+    for (auto category : categories)
+        words[category/32] |= 1u << (category%32);
+
+    auto iter = m_categoricalBitsetOffsets.find(words);
+    if (iter != m_categoricalBitsetOffsets.end())
+        return iter->second;
+    int32_t offset = m_categoricalBitsets.size();
+    m_categoricalBitsets.push_back(words.size());
+    m_categoricalBitsets.insert(m_categoricalBitsets.end(), words.begin(), words.end());
+    m_categoricalBitsetOffsets[words] = offset;
+    return offset;
+}
+
+inline std::vector<int8_t> DecisionForest::GetCategoricalFeatureMask() const
+{
+    std::map<int32_t, FeatureType> featureTypes;
+    int32_t maxFeatureIndex = -1;
+    for (auto& tree : m_trees) {
+        for (auto& node : tree->GetNodes()) {
+            if (node.IsLeaf())
+                continue;
+            auto iter = featureTypes.find(node.featureIndex);
+            assert ((iter == featureTypes.end() || iter->second == node.featureType) &&
+                    "A feature can't be used in both numerical and categorical splits");
+            featureTypes[node.featureIndex] = node.featureType;
+            maxFeatureIndex = std::max(maxFeatureIndex, node.featureIndex);
+        }
+    }
+    std::vector<int8_t> mask(maxFeatureIndex + 1, 0);
+    for (auto& featureAndType : featureTypes)
+        mask[featureAndType.first] = featureAndType.second == FeatureType::kCategorical ? 1 : 0;
+    return mask;
+}
+
+inline void DecisionForest::QuantizeThresholds(bool binsIncludeBoundaries, const std::function<double(double)>& roundThreshold)
+{
+    assert (!m_isQuantized && "Forest is already quantized");
+    for (auto& tree : m_trees) {
+        for (auto& node : tree->GetNodes()) {
+            if (node.IsLeaf() || node.featureType == FeatureType::kCategorical)
+                continue;
+            if (static_cast<size_t>(node.featureIndex) >= m_quantizationBoundaries.size())
+                m_quantizationBoundaries.resize(node.featureIndex + 1);
+            m_quantizationBoundaries[node.featureIndex].push_back(roundThreshold(node.threshold));
+        }
+    }
+    for (auto& boundaries : m_quantizationBoundaries) {
+        std::sort(boundaries.begin(), boundaries.end());
+        boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+    }
+
+    // x < b[i] iff #{b[j] <= x} < i + 1 and x <= b[i] iff #{b[j] < x} <= i (and similarly for the negations)
+    for (auto& tree : m_trees) {
+        auto& nodes = tree->GetNodes();
+        for (size_t i=0 ; i<nodes.size() ; ++i) {
+            auto& node = nodes[i];
+            if (node.IsLeaf() || node.featureType == FeatureType::kCategorical)
+                continue;
+            auto& boundaries = m_quantizationBoundaries[node.featureIndex];
+            auto bin = std::lower_bound(boundaries.begin(), boundaries.end(), roundThreshold(node.threshold)) - boundaries.begin();
+            tree->SetNodeThreshold(i, binsIncludeBoundaries ? bin + 1 : bin);
+        }
+    }
+    m_isQuantized = true;
+    m_quantizedBinsIncludeBoundaries = binsIncludeBoundaries;
+}
+
+inline double DecisionForest::QuantizeFeatureValue(int32_t featureIndex, double value) const
+{
+    assert (m_isQuantized);
+    if (std::isnan(value) || static_cast<size_t>(featureIndex) >= m_quantizationBoundaries.size())
+        return value;
+    auto& boundaries = m_quantizationBoundaries[featureIndex];
+    if (boundaries.empty())
+        return value;
+    auto binEnd = m_quantizedBinsIncludeBoundaries ? std::upper_bound(boundaries.begin(), boundaries.end(), value)
+                                                   : std::lower_bound(boundaries.begin(), boundaries.end(), value);
+    return static_cast<double>(binEnd - boundaries.begin());
+}
+
 inline std::string DecisionForest::Serialize() const
 {
     std::stringstream strStream;
     strStream << (int32_t)m_reductionType << m_trees.size() << m_initialValue;
     for (auto& tree : m_trees)
         strStream << tree->Serialize();
+    for (auto word : m_categoricalBitsets)
+        strStream << word;
+    for (auto initialValue : m_outputInitialValues)
+        strStream << initialValue;
+    for (auto predictionTransform : m_outputPredictionTransforms)
+        strStream << (int32_t)predictionTransform;
     return strStream.str();
 }
 
@@ -407,74 +693,97 @@ ReturnType argmax(std::vector<FPType>& classProbabilities) {
     return std::distance(classProbabilities.begin(), std::max_element(classProbabilities.begin(), classProbabilities.end()));
 }
 
-inline double DecisionForest::Predict(std::vector<double>& data) const
+template<typename T>
+inline std::vector<T> DecisionForest::ReduceTreePredictions(const std::vector<T>& treePredictions) const
 {
-    std::map<int32_t, std::vector<double>> predictions;
-    for (auto& tree: m_trees) {
-        auto prediction = tree->PredictTree(data);
-        // std::cout << "Tree " << predictions.size() << " prediction : " << prediction << std::endl;
-        predictions[tree->GetClassId()].push_back(prediction);
-    }
-    
-    assert(m_reductionType == ReductionType::kAdd);
-
-    if (m_numClasses == 0) {
-        auto rawPrediction = std::accumulate(predictions[0].begin(), predictions[0].end(), m_initialValue);
-        // std::cout << "Raw prediction : " << rawPrediction << std::endl;
-        if (m_predictionTransform == PredictionTransformation::kIdentity)
-            return rawPrediction;
-        else if (m_predictionTransform == PredictionTransformation::kSigmoid)
-            return sigmoid(rawPrediction);
-        else
-            assert(false);
-        return -1;
+    assert (treePredictions.size() == m_trees.size());
+    std::vector<T> outputs;
+    for (int32_t i=0 ; i<GetNumOutputs() ; ++i)
+        outputs.push_back(GetOutputInitialOffset(i));
+    std::vector<int64_t> numClassTrees(GetNumOutputs(), 0);
+    for (size_t i=0 ; i<m_trees.size() ; ++i) {
+        if (m_reductionType == ReductionType::kVoting) {
+            outputs.at(static_cast<int32_t>(treePredictions[i])) += 1;
+            for (auto& numTrees : numClassTrees)
+                ++numTrees;
+        }
+        else {
+            outputs.at(m_trees[i]->GetClassId()) += treePredictions[i];
+            ++numClassTrees.at(m_trees[i]->GetClassId());
+        }
     }
-    else {
-        std::vector<double> classProbabilities(m_numClasses, 0);
-        std::for_each(
-            predictions.begin(),
-            predictions.end(),
-            [&](std::pair<const int32_t, std::vector<double>>& pair) {
-                classProbabilities[pair.first] = std::accumulate(pair.second.begin(), pair.second.end(), m_initialValue);
-            });
-        
-        return argmax<double, double>(classProbabilities);
+    if (m_reductionType != ReductionType::kAdd) {
+        for (size_t i=0 ; i<outputs.size() ; ++i)
+            if (numClassTrees[i] != 0)
+                outputs[i] /= static_cast<T>(numClassTrees[i]);
     }
+    return outputs;
 }
 
-inline float DecisionForest::Predict_Float(std::vector<float>& data) const
+template<typename T>
+inline T DecisionForest::TransformPrediction(T prediction, PredictionTransformation predictionTransform)
+{
+    if (predictionTransform == PredictionTransformation::kIdentity)
+        return prediction;
+    else if (predictionTransform == PredictionTransformation::kSigmoid)
+        return sigmoid(prediction);
+    else if (predictionTransform == PredictionTransformation::kExponential)
+        return std::exp(prediction);
+    else
+        assert(false);
+    return -1;
+}
+
+inline double DecisionForest::Predict(std::vector<double>& data) const
 {
-    std::map<int32_t, std::vector<float>> predictions;
+    std::vector<double> treePredictions;
     for (auto& tree: m_trees) {
-        auto prediction = tree->PredictTree_Float(data);
-        // std::cout << "Tree " << predictions.size() << " prediction : " << prediction << std::endl;
-        predictions[tree->GetClassId()].push_back(prediction);
+        treePredictions.push_back(tree->PredictTree(data, &m_categoricalBitsets));
+        // std::cout << "Tree " << treePredictions.size() << " prediction : " << treePredictions.back() << std::endl;
     }
+    auto outputs = ReduceTreePredictions(treePredictions);
     
-    assert(m_reductionType == ReductionType::kAdd);
-
-    if (m_numClasses == 0) {
-        auto rawPrediction = std::accumulate(predictions[0].begin(), predictions[0].end(), m_initialValue);
-        if (m_predictionTransform == PredictionTransformation::kIdentity)
-        return rawPrediction;
-        else if (m_predictionTransform == PredictionTransformation::kSigmoid)
-        return sigmoid(rawPrediction);
-        else
-        assert(false);
-        return -1;
+    if (m_numClasses == 0)
+        return TransformPrediction(outputs.front());
+    // The transformations are monotonic, so the most likely class has the largest output
+    return argmax<double, double>(outputs);
+}
+
+inline float DecisionForest::Predict_Float(std::vector<float>& data) const
+{
+    std::vector<float> treePredictions;
+    for (auto& tree: m_trees)
+        treePredictions.push_back(tree->PredictTree_Float(data, &m_categoricalBitsets));
+    auto outputs = ReduceTreePredictions(treePredictions);
+
+    if (m_numClasses == 0)
+        return TransformPrediction(outputs.front());
+    return argmax<float, float>(outputs);
+}
+
+inline std::vector<double> DecisionForest::PredictAllOutputs(std::vector<double>& data) const
+{
+    std::vector<double> treePredictions;
+    for (auto& tree: m_trees)
+        treePredictions.push_back(tree->PredictTree(data, &m_categoricalBitsets));
+    auto outputs = ReduceTreePredictions(treePredictions);
+
+    if (m_predictionTransform == PredictionTransformation::kSoftMax) {
+        // Subtract the largest value so that exp can't overflow
+        auto maxOutput = *std::max_element(outputs.begin(), outputs.end());
+        double sum = 0.0;
+        for (auto& output : outputs) {
+            output = std::exp(output - maxOutput);
+            sum += output;
+        }
+        for (auto& output : outputs)
+            output /= sum;
     }
     else {
-        assert(m_predictionTransform == PredictionTransformation::kSoftMax);
-        std::vector<float> classProbabilities(m_numClasses, 0);
-        std::for_each(
-            predictions.begin(),
-            predictions.end(),
-            [&](std::pair<const int32_t, std::vector<float>>& pair) {
-                classProbabilities[pair.first] = std::accumulate(pair.second.begin(), pair.second.end(), m_initialValue);
-            });
-        
-        return argmax<float, float>(classProbabilities);
+        for (size_t i=0 ; i<outputs.size() ; ++i)
+            outputs[i] = TransformPrediction(outputs[i], GetOutputPredictionTransformation(i));
     }
+    return outputs;
 }
 
 // Level Order Sorter
@@ -542,13 +851,13 @@ inline std::vector<double> DecisionTree::GetSparseThresholdArray() {
     return thresholdVec;
 }
 
-inline std::vector<int32_t> DecisionTree::GetSparseFeatureIndexArray() {
+inline std::vector<int32_t> DecisionTree::GetSparseFeatureIndexArray(bool encodeDefaultLeft) {
     LevelOrderTraversal levelOrder(GetNodes());
     auto& sortedNodes = levelOrder.LevelOrderNodes();
     std::vector<int32_t> featureIndexVec(sortedNodes.size());
     size_t i=0;
     for (auto& node : sortedNodes) {
-        featureIndexVec.at(i) = node.IsLeaf() ? -1 : node.featureIndex;
+        featureIndexVec.at(i) = GetSerializedFeatureIndex(node, encodeDefaultLeft);
         ++i;
     }
     return featureIndexVec;
@@ -1,6 +1,7 @@
 #ifndef _LOGGER_H_
 #define _LOGGER_H_
 
+#include <chrono>
 #include <iostream>
 #include <string>
 
@@ -12,6 +13,7 @@ namespace Logging
 struct LoggingOptions {
   bool logGenCodeStats;
   bool logTreeStats;
+  bool logCompileTimes;
 
   LoggingOptions();
   bool ShouldEnableLogging();
@@ -25,6 +27,24 @@ inline void Log(const std::string& message) {
     std::cout << message << std::endl;
 }
 
+// Logs the wall clock time spent in a compilation phase when it goes out of scope
+// (if loggingOptions.logCompileTimes is set).
+class PhaseTimer {
+  std::string m_phaseName;
+  std::chrono::steady_clock::time_point m_start;
+public:
+  PhaseTimer(const std::string& phaseName)
+    : m_phaseName(phaseName), m_start(std::chrono::steady_clock::now())
+  { }
+  ~PhaseTimer() {
+    if (!loggingOptions.logCompileTimes)
+      return;
+    auto end = std::chrono::steady_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - m_start).count();
+    Log("Compile phase " + m_phaseName + " : " + std::to_string(duration/1000.0) + " ms");
+  }
+};
+
 } // Logging
 } // TreeBeard
 
@@ -51,7 +51,7 @@ private:
     void WriteDOTSubGraph(std::ofstream& fout);
     
     void GetThresholds(std::vector<double>::iterator beginIter);
-    void GetFeatureIndices(std::vector<int32_t>::iterator beginIter);
+    void GetFeatureIndices(std::vector<int32_t>::iterator beginIter, bool encodeDefaultLeft=false);
     void ComputeTileShapeString(std::string& str, int32_t tileNodeIndex, int32_t stringIndex);
 
     int32_t GetTileDepth(std::vector<TiledTreeNode>& tiles) const;
@@ -199,14 +199,16 @@ public:
     }
     void WriteDOTFile(const std::string& filename);
     std::vector<double> SerializeThresholds();
-    std::vector<int32_t> SerializeFeatureIndices();
+    // See DecisionTree::GetFeatureIndexArray for encodeDefaultLeft
+    std::vector<int32_t> SerializeFeatureIndices(bool encodeDefaultLeft=false);
     std::vector<int32_t> SerializeTileShapeIDs();
 
     void GetSparseSerialization(std::vector<double>& thresholds, std::vector<int32_t>& featureIndices, 
-                                std::vector<int32_t>& tileShapeIDs, std::vector<int32_t>& childIndices, std::vector<double>& leaves);
+                                std::vector<int32_t>& tileShapeIDs, std::vector<int32_t>& childIndices, std::vector<double>& leaves,
+                                bool encodeDefaultLeft=false);
     void GetSparseSerializationPeeled(std::vector<double>& thresholds, std::vector<int32_t>& featureIndices, 
                                       std::vector<int32_t>& tileShapeIDs, std::vector<int32_t>& childIndices,
-                                      std::vector<double>& leaves);
+                                      std::vector<double>& leaves, bool encodeDefaultLeft=false);
     int32_t GetTreeDepth() { 
         // The root of the tiled tree should be the first node
         assert (m_tiles[0].GetParent() == DecisionTree::INVALID_NODE_INDEX);
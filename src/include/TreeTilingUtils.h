@@ -4,12 +4,14 @@
 #include <string>
 #include <fstream>
 #include <list>
+#include <memory>
 #include <vector>
 
 #include "DecisionTreeTypes.h"
 
 #include "json.hpp"
 #include "DecisionForest.h"
+#include "BinaryModelGlobals.h"
 
 using json = nlohmann::json;
 
@@ -46,7 +48,8 @@ public:
 
 // For now, we're making the compiler directly populate the value of the forest into the 
 // ForestJSON reader. It will (at some point in the future), read this value from 
-// the JSON that is written as part of compilation.
+// the JSON that is written as part of compilation. Each model serializer owns a reader 
+// (see IModelSerializer::GetForestJSONReader) so that models can be compiled concurrently.
 class ForestJSONReader
 {
     struct SingleTileSizeEntry {
@@ -73,26 +76,31 @@ class ForestJSONReader
                    serializedLeaves==that.serializedLeaves && classIDs==that.classIDs;
         };
     };
-    int32_t m_inputElementBitwidth;
-    int32_t m_returnTypeBitWidth;
-    int32_t m_rowSize;
-    int32_t m_batchSize;
-    int32_t m_tileShapeBitWidth;
-    int32_t m_childIndexBitWidth;
+    int32_t m_inputElementBitwidth = 0;
+    int32_t m_returnTypeBitWidth = 0;
+    int32_t m_rowSize = 0;
+    int32_t m_batchSize = 0;
+    int32_t m_tileShapeBitWidth = 0;
+    int32_t m_childIndexBitWidth = -1;
     std::list<SingleTileSizeEntry> m_tileSizeEntries;
     json m_json;
-    int32_t m_numberOfTrees;
-    int32_t m_numberOfClasses;
-    int32_t m_tileSize;
+    int32_t m_numberOfTrees = 0;
+    int32_t m_numberOfClasses = 0;
+    int32_t m_tileSize = 0;
+    bool m_sparseRepresentation = false;
 
     std::string m_jsonFilePath;
+    // Set when the model globals were read from a binary file. Tile size entries are only
+    // materialized from the mapping when a routine that needs them is called.
+    std::shared_ptr<MappedBinaryModelGlobals> m_mappedGlobals;
 
     std::list<SingleTileSizeEntry>::iterator FindEntry(int32_t tileSize, int32_t thresholdBitWidth, int32_t indexBitWidth);
-    static ForestJSONReader m_instance;
-    ForestJSONReader() { }
     
     void WriteSingleTileSizeEntryToJSON(json& tileSizeEntryJSON, ForestJSONReader::SingleTileSizeEntry& tileSizeEntry);
     void ParseSingleTileSizeEntry(json& tileSizeEntryJSON, ForestJSONReader::SingleTileSizeEntry& tileSizeEntry);
+    void WriteSingleTileSizeEntryToBinary(BinaryModelGlobalsWriter& writer, int32_t entryIndex, ForestJSONReader::SingleTileSizeEntry& tileSizeEntry);
+    void ParseSingleTileSizeEntryFromBinary(const BinaryModelGlobalsEntry& binaryEntry, ForestJSONReader::SingleTileSizeEntry& tileSizeEntry);
+    void MaterializeMappedEntries();
 
     void AddSingleTileSizeEntry(std::list<int32_t>& treeIndices, std::list<int32_t>& numTilesList, std::list<std::vector<ThresholdType>>& serializedThresholds, 
                             std::list<std::vector<FeatureIndexType>>& serializedFetureIndices, std::list<std::vector<int32_t>>& serializedTileShapeIDs,
@@ -105,6 +113,7 @@ class ForestJSONReader
     void InitializeLeavesImpl(LeafType *bufPtr, std::list<ForestJSONReader::SingleTileSizeEntry>::iterator listIter);
 
 public:
+    ForestJSONReader() { }
 
     //===----------------------------------------===/
     // Persist routines
@@ -121,16 +130,26 @@ public:
     // JSON routines
     //===----------------------------------------===/
     void SetFilePath(const std::string& jsonFilePath) { m_jsonFilePath = jsonFilePath; }
+    // Both routines switch to the binary format for binary model globals files (see BinaryModelGlobals.h)
     void ParseJSONFile();
     void WriteJSONFile();
 
+    //===----------------------------------------===/
+    // Binary routines
+    //===----------------------------------------===/
+    void ParseBinaryFile();
+    void WriteBinaryFile();
+    // Returns nullptr unless the model globals were read from a binary file
+    MappedBinaryModelGlobals* GetMappedModelGlobals() { return m_mappedGlobals.get(); }
+
     //===----------------------------------------===/
     // Initialization routines
     //===----------------------------------------===/
     void InitializeBuffer(void* bufPtr, int32_t tileSize, int32_t thresholdBitWidth, int32_t indexBitWidth, std::vector<int32_t>& treeOffsets);
     void InitializeOffsetBuffer(void* bufPtr, int32_t tileSize, int32_t thresholdBitWidth, int32_t indexBitWidth);
     void InitializeLengthBuffer(void* bufPtr, int32_t tileSize, int32_t thresholdBitWidth, int32_t indexBitWidth);
-    void InitializeLookUpTable(void* bufPtr, int32_t tileSize, int32_t entryBitWidth);
+    // The look up table only depends on the tile size, not on the model
+    static void InitializeLookUpTable(void* bufPtr, int32_t tileSize, int32_t entryBitWidth);
     void InitializeClassInformation(void *classInfoBuf, int32_t tileSize, int32_t thresholdBitWidth, int32_t indexBitWidth);
     
     void InitializeLeaves(void* bufPtr, int32_t tileSize, int32_t thresholdBitWidth, int32_t indexBitWidth);
@@ -167,9 +186,9 @@ public:
     void SetBatchSize(int32_t val) { m_batchSize = val; }
     int32_t GetBatchSize() { return m_batchSize; }
     
-    static ForestJSONReader& GetInstance() {
-        return m_instance;
-    }
+    void SetSparseRepresentation(bool val) { m_sparseRepresentation = val; }
+    bool IsSparseRepresentation() { return m_sparseRepresentation; }
+
     static int32_t GetLengthOfTree(std::vector<int32_t>& offsets, int32_t treeIndex);
     
     template<typename ThresholdType, typename FeatureIndexType, typename TileShapeType>
@@ -224,9 +243,6 @@ void ForestJSONReader::GetModelValues(int32_t tileSize, int32_t thresholdSize, i
 // void PersistDecisionForest(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType);
 // void ClearPersistedForest();
 
-int32_t GetTotalNumberOfTiles();
-int32_t GetTotalNumberOfLeaves();
-
 } // decisionforest
 } // mlir
 
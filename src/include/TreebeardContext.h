@@ -23,6 +23,8 @@ class IModelSerializer {
 protected:
   std::string m_filepath;
   InferenceRunnerBase *m_inferenceRunner=nullptr;
+  // Serialized model values of this serializer's model. Not shared with other serializers.
+  ForestJSONReader m_forestJSONReader;
 
   template<typename FuncType>
   FuncType GetFunctionAddress(const std::string& funcName) {
@@ -51,6 +53,7 @@ public:
   }
   
   const std::string& GetFilePath() const { return m_filepath; }
+  ForestJSONReader& GetForestJSONReader() { return m_forestJSONReader; }
 };
 
 } // decisionforest
@@ -88,6 +91,48 @@ struct CompilerOptions {
   mlir::decisionforest::ScheduleManipulator *scheduleManipulator=nullptr;
   std::string statsProfileCSVPath = "";
   int32_t numberOfCores = -1;
+  // Compile the prediction function with a dynamic batch dimension so that
+  // partial batches can be run without padding them out to batchSize.
+  bool dynamicBatch = false;
+  // Layout of the input rows. Strided and column major inputs are read in place (without copying them 
+  // into a dense row major buffer), with the strides that are not fixed by the layout passed at runtime.
+  mlir::decisionforest::InputLayout inputLayout = mlir::decisionforest::InputLayout::kRowMajor;
+  // Probability above which rows of a binary classifier (with a sigmoid transformation) are labeled positive.
+  // If set (to a value in (0, 1)), trees are walked in decreasing order of their contribution and each row 
+  // stops once no remaining trees can change its label. The label is exact but the probability is not. 
+  // A negative value disables early exit.
+  double earlyExitThreshold = -1.0;
+  // Replace the thresholds of numerical splits with the index of their bin among the distinct thresholds of 
+  // their feature and bin each batch of inputs once before walking the trees. Predictions are unchanged, but 
+  // the thresholds only need to hold small integers, so they can be narrower than the inputs (for example, 
+  // 32 bit thresholds with 64 bit inputs). CPU only.
+  bool quantizeInputs = false;
+  // Peel the levels of probabilistically tiled trees that most inputs reach. Defaults to the process 
+  // wide default (mlir::decisionforest::PeeledCodeGenForProbabiltyBasedTiling) when the options are constructed.
+  bool peeledCodeGenForProbabilityBasedTiling = mlir::decisionforest::PeeledCodeGenForProbabiltyBasedTiling;
+  // Use the sparse tree representation instead of the array representation. Defaults to the process wide 
+  // default (mlir::decisionforest::UseSparseTreeRepresentation) when the options are constructed.
+  bool sparseRepresentation = mlir::decisionforest::UseSparseTreeRepresentation;
+  // Return every output of multi-class and multi-target models in a [batchSize, numOutputs] result rather than 
+  // the most likely class of each row. Classifiers with a softmax transformation return the class probabilities, 
+  // other models return the (transformed) sum of each output's trees. CPU only.
+  bool returnAllOutputs = false;
+  // Count the walks that end at each leaf in the generated code so that the counts can be written out as a 
+  // probability profile (see TreeBeard::Profile::ComputeForestProbabilityProfileCompiled). Needs untiled 
+  // trees (a tile size of 1 with uniform tiling) in the array representation, walked in model order. CPU only.
+  bool profileLeafHits = false;
+  // Group trees that split on features in overlapping sets of cache lines and walk the groups one after another
+  // on a tile of this many rows, so that the tile's values of a group's features stay in L1 across its trees. Helps
+  // wide models (thousands of features) whose trees each read a few features. Disabled if not positive.
+  int32_t featureGroupBatchTileSize = -1;
+
+  // LLVM code generation parameters (see mlir::decisionforest::LLVMCodeGenOptions)
+  int32_t optimizationLevel = 0;
+  std::string targetCPU = "";
+  std::string targetFeatures = "";
+
+  // Directory in which compiled models are cached across processes. Caching is disabled if empty.
+  std::string compilationCacheDirectory = "";
 
   CompilerOptions() { }
   CompilerOptions(int32_t thresholdWidth, int32_t returnWidth, bool isReturnTypeFloat, int32_t featureIndexWidth, 
@@ -102,6 +147,9 @@ struct CompilerOptions {
   CompilerOptions(const std::string& configJSONFilePath);
 
   void SetPipelineSize(int32_t pipelineSize) { this->pipelineSize = pipelineSize; }
+  mlir::decisionforest::LLVMCodeGenOptions GetLLVMCodeGenOptions() const {
+    return mlir::decisionforest::LLVMCodeGenOptions{optimizationLevel, targetCPU, targetFeatures};
+  }
 };
 
 void InitializeMLIRContext(mlir::MLIRContext& context);
@@ -114,6 +162,9 @@ struct TreebeardContext {
   std::shared_ptr<mlir::decisionforest::IRepresentation>  representation = nullptr;
   std::shared_ptr<mlir::decisionforest::IModelSerializer> serializer = nullptr;
   std::shared_ptr<ForestCreator> forestConstructor = nullptr;
+  // Names the forest creator and representation were set by (SetForestCreatorType and SetRepresentationAndSerializer)
+  std::string forestCreatorType;
+  std::string representationName;
 
   TreebeardContext(const std::string& modelFilePath, 
                    const std::string& globalsJSONPath,
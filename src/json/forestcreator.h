@@ -1,7 +1,11 @@
 #ifndef _MODEL_JSON_PARSER_H_
 #define _MODEL_JSON_PARSER_H_
 
+#include <cmath>
 #include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include "json.hpp"
@@ -119,6 +123,12 @@ protected:
     mlir::ModuleOp m_module;
     mlir::OpBuilder m_builder;
     int32_t m_batchSize;
+    bool m_dynamicBatch;
+    mlir::decisionforest::InputLayout m_inputLayout;
+    double m_earlyExitThreshold;
+    bool m_quantizeInputs;
+    bool m_returnAllOutputs;
+    bool m_profileLeafHits;
     int32_t m_childIndexBitWidth;
     mlir::Type m_thresholdType;
     mlir::Type m_featureIndexType;
@@ -152,25 +162,104 @@ protected:
     void SetNodeRightChild(int64_t node, int64_t child) { m_currentTree->SetNodeRightChild(node, child); }
     // Set left child of a node
     void SetNodeLeftChild(int64_t node, int64_t child) { m_currentTree->SetNodeLeftChild(node, child); }
+    // Set the direction a node sends missing feature values in
+    void SetNodeDefaultLeft(int64_t node, bool defaultLeft) { m_currentTree->SetNodeDefaultLeft(node, defaultLeft); }
+    // Make a node send rows whose feature value is one of the given categories right and all others left
+    void SetNodeCategoricalSplit(int64_t node, const std::vector<int32_t>& categories) {
+        m_currentTree->SetNodeCategoricalSplit(node, m_forest->AddCategoricalBitset(categories));
+    }
     void SetPredicateType(mlir::arith::CmpFPredicate value) { m_cmpPredicate = value; }
     mlir::Type GetInputRowType() {
         const auto& features = m_forest->GetFeatures();
         int64_t shape[] = { static_cast<int64_t>(features.size()) };
         return mlir::MemRefType::get(shape, m_inputElementType);
     }
+    // With a dynamic batch, the number of rows is only known at runtime. The lowering 
+    // then runs the scheduled loop nest for full batches and a remainder loop otherwise.
+    int64_t GetFunctionBatchDimension() {
+        return m_dynamicBatch ? mlir::ShapedType::kDynamic : static_cast<int64_t>(m_batchSize);
+    }
+    // Strides that aren't fixed by the input layout are read from the memref descriptor at runtime.
+    mlir::MemRefLayoutAttrInterface GetFunctionArgumentLayout() {
+        auto dynamic = mlir::ShapedType::kDynamic;
+        switch (m_inputLayout) {
+            case mlir::decisionforest::InputLayout::kRowMajor:
+                return mlir::MemRefLayoutAttrInterface();
+            case mlir::decisionforest::InputLayout::kStrided:
+                return mlir::StridedLayoutAttr::get(&m_context, 0, {dynamic, dynamic});
+            case mlir::decisionforest::InputLayout::kColumnMajor:
+                return mlir::StridedLayoutAttr::get(&m_context, 0, {1, dynamic});
+            default:
+                assert(false && "Unknown input layout");
+                return mlir::MemRefLayoutAttrInterface();
+        }
+    }
     mlir::Type GetFunctionArgumentType() {
         const auto& features = m_forest->GetFeatures();
-        int64_t shape[] = { m_batchSize, static_cast<int64_t>(features.size())};
-        return mlir::MemRefType::get(shape, m_inputElementType);
+        int64_t shape[] = { GetFunctionBatchDimension(), static_cast<int64_t>(features.size())};
+        return mlir::MemRefType::get(shape, m_inputElementType, GetFunctionArgumentLayout());
     }
+    // A [batch, numOutputs] memref if all outputs of a multi-class (or multi-target) model are returned
     mlir::Type GetFunctionResultType() {
-        return mlir::MemRefType::get(m_batchSize, m_returnType);
+        if (m_returnAllOutputs) {
+            int64_t shape[] = { GetFunctionBatchDimension(), static_cast<int64_t>(m_forest->GetNumOutputs()) };
+            return mlir::MemRefType::get(shape, m_returnType);
+        }
+        return mlir::MemRefType::get(GetFunctionBatchDimension(), m_returnType);
     }
     mlir::FunctionType GetFunctionType() {
         auto argType = GetFunctionArgumentType();
         auto resultType = GetFunctionResultType();
         return m_builder.getFunctionType({argType, resultType}, resultType);
     }
+    bool IsEarlyExitEnabled() { return m_earlyExitThreshold >= 0.0; }
+    // Rows are labeled positive if sigmoid(prediction) > m_earlyExitThreshold, i.e. if the untransformed
+    // prediction is greater than the logit of the threshold
+    void AddEarlyExitToSchedule() {
+        if (!(m_earlyExitThreshold > 0.0 && m_earlyExitThreshold < 1.0))
+            throw std::runtime_error("Early exit threshold must be a probability in (0, 1)");
+        if (m_forest->GetPredictionTransformation() != mlir::decisionforest::PredictionTransformation::kSigmoid || 
+            m_forest->IsMultiClassClassifier() || m_forest->GetNumOutputs() != 1)
+            throw std::runtime_error("Early exit is only supported for binary classifiers with a sigmoid transformation");
+        if (m_forest->GetReductionType() != mlir::decisionforest::ReductionType::kAdd)
+            throw std::runtime_error("Early exit compares partial sums of the predictions and needs an additive reduction");
+        auto predictionThreshold = std::log(m_earlyExitThreshold / (1.0 - m_earlyExitThreshold));
+        m_schedule->EarlyExit(m_schedule->GetTreeIndex(), predictionThreshold);
+    }
+    // Inputs are compared with thresholds in the input element type, so the bin boundaries are the thresholds 
+    // rounded to it. Bin indices are stored in the threshold type and must be exact in it.
+    void QuantizeThresholds() {
+        bool binsIncludeBoundaries;
+        switch (m_cmpPredicate) {
+            case mlir::arith::CmpFPredicate::OLT:
+            case mlir::arith::CmpFPredicate::ULT:
+            case mlir::arith::CmpFPredicate::OGE:
+            case mlir::arith::CmpFPredicate::UGE:
+                binsIncludeBoundaries = true;
+                break;
+            case mlir::arith::CmpFPredicate::OLE:
+            case mlir::arith::CmpFPredicate::ULE:
+            case mlir::arith::CmpFPredicate::OGT:
+            case mlir::arith::CmpFPredicate::UGT:
+                binsIncludeBoundaries = false;
+                break;
+            default:
+                assert(false && "Unsupported comparison predicate");
+                return;
+        }
+        std::function<double(double)> roundThreshold = [](double threshold) { return threshold; };
+        if (m_inputElementType.isF32())
+            roundThreshold = [](double threshold) { return static_cast<double>(static_cast<float>(threshold)); };
+        m_forest->QuantizeThresholds(binsIncludeBoundaries, roundThreshold);
+
+        // A feature with n boundaries has bins [0, n]
+        auto thresholdPrecision = m_thresholdType.cast<mlir::FloatType>().getFPMantissaWidth();
+        for (auto& boundaries : m_forest->GetQuantizationBoundaries())
+            if (boundaries.size() > (1ull << thresholdPrecision))
+                throw std::runtime_error("A feature has too many distinct thresholds (" + std::to_string(boundaries.size()) + 
+                                         ") for its bin indices to be exact in " + std::to_string(m_thresholdType.getIntOrFloatBitWidth()) + 
+                                         " bit thresholds. Use a wider threshold type.");
+    }
     mlir::func::FuncOp GetFunctionPrototype() {
         auto location = m_builder.getUnknownLoc();
         auto functionType = GetFunctionType();
@@ -200,6 +289,75 @@ protected:
         m_module.push_back(func);
     }
 
+    static bool IsUnorderedPredicate(mlir::arith::CmpFPredicate predicate) {
+        switch (predicate) {
+            case mlir::arith::CmpFPredicate::ULT:
+            case mlir::arith::CmpFPredicate::ULE:
+            case mlir::arith::CmpFPredicate::UGT:
+            case mlir::arith::CmpFPredicate::UGE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Comparisons with a missing (NaN) feature value are false for ordered predicates and true for unordered 
+    // ones. If all nodes send missing values the same way, pick the variant of the predicate that does this so 
+    // that the generated code needs no extra checks. Otherwise, the traversal code handles missing values per node.
+    mlir::arith::CmpFPredicate GetPredicateForMissingValues() {
+        // Trees whose creator didn't give directions keep sending missing values where the declared predicate 
+        // does (left for unordered predicates). Record that in their nodes so that the routing below and the 
+        // per node encoding agree with it.
+        m_forest->SetUnsetMissingValueDirections(IsUnorderedPredicate(m_cmpPredicate));
+        auto routing = m_forest->GetMissingValueRouting();
+        if (routing == mlir::decisionforest::MissingValueRouting::kPerNode || m_forest->HasCategoricalSplits()) {
+            CheckDefaultLeftFeatureIndicesFit();
+            return m_cmpPredicate;
+        }
+        bool missingGoesLeft = routing == mlir::decisionforest::MissingValueRouting::kAllLeft;
+        switch (m_cmpPredicate) {
+            case mlir::arith::CmpFPredicate::OLT:
+            case mlir::arith::CmpFPredicate::ULT:
+                return missingGoesLeft ? mlir::arith::CmpFPredicate::ULT : mlir::arith::CmpFPredicate::OLT;
+            case mlir::arith::CmpFPredicate::OLE:
+            case mlir::arith::CmpFPredicate::ULE:
+                return missingGoesLeft ? mlir::arith::CmpFPredicate::ULE : mlir::arith::CmpFPredicate::OLE;
+            case mlir::arith::CmpFPredicate::OGT:
+            case mlir::arith::CmpFPredicate::UGT:
+                return missingGoesLeft ? mlir::arith::CmpFPredicate::UGT : mlir::arith::CmpFPredicate::OGT;
+            case mlir::arith::CmpFPredicate::OGE:
+            case mlir::arith::CmpFPredicate::UGE:
+                return missingGoesLeft ? mlir::arith::CmpFPredicate::UGE : mlir::arith::CmpFPredicate::OGE;
+            default:
+                assert(false && "Unsupported comparison predicate");
+                return m_cmpPredicate;
+        }
+    }
+
+    // Nodes that send missing values left store their feature index as -(featureIndex+2) when the traversal 
+    // code routes missing values per node (see EncodeDefaultLeftFeatureIndex). This must fit in the feature index type.
+    void CheckDefaultLeftFeatureIndicesFit() {
+        auto featureIndexBitWidth = m_featureIndexType.getIntOrFloatBitWidth();
+        if (featureIndexBitWidth >= 32)
+            return;
+        int64_t maxEncodableFeatureIndex = (int64_t(1) << (featureIndexBitWidth - 1)) - 2;
+        auto maxFeatureIndex = m_forest->GetMaxSplitFeatureIndex();
+        if (maxFeatureIndex > maxEncodableFeatureIndex)
+            throw std::runtime_error("Feature index " + std::to_string(maxFeatureIndex) + " can't be encoded in a " + 
+                                     std::to_string(featureIndexBitWidth) + " bit feature index when missing values are routed per node. " +
+                                     "Use a wider feature index type.");
+    }
+
+    // Categorical nodes store the offset of their category set in their threshold, so every offset into the 
+    // bitset table must be exactly representable in the threshold type
+    void CheckCategoricalBitsetOffsetsFit() {
+        auto bitsetTableSize = m_forest->GetCategoricalBitsets().size();
+        auto thresholdPrecision = m_thresholdType.cast<mlir::FloatType>().getFPMantissaWidth();
+        if (bitsetTableSize > (1ull << thresholdPrecision))
+            throw std::runtime_error("The categorical bitset table (" + std::to_string(bitsetTableSize) + " words) is too large for " + 
+                                     std::to_string(m_thresholdType.getIntOrFloatBitWidth()) + " bit thresholds. Use a wider threshold type.");
+    }
+
     virtual mlir::decisionforest::TreeEnsembleType GetEnsembleType() {
         // All trees have the default tiling to start with.
         int32_t tileSize = 1;
@@ -211,7 +369,7 @@ protected:
 
         auto forestType = mlir::decisionforest::TreeEnsembleType::get(m_returnType,
                                                                       m_forest->NumTrees(), GetInputRowType(),
-                                                                      mlir::decisionforest::ReductionType::kAdd, treeType);
+                                                                      m_forest->GetReductionType(), treeType);
         return forestType;
     }
 public:
@@ -236,6 +394,12 @@ public:
         m_context(context),
         m_builder(&context),
         m_batchSize(batchSize),
+        m_dynamicBatch(false),
+        m_inputLayout(mlir::decisionforest::InputLayout::kRowMajor),
+        m_earlyExitThreshold(-1.0),
+        m_quantizeInputs(false),
+        m_returnAllOutputs(false),
+        m_profileLeafHits(false),
         m_childIndexBitWidth(1),
         m_thresholdType(thresholdType),
         m_featureIndexType(featureIndexType),
@@ -283,16 +447,36 @@ public:
 
     // Get the forest pointer
     DecisionForestType* GetForest() { return m_forest; }
+    mlir::arith::CmpFPredicate GetPredicateType() const { return m_cmpPredicate; }
 
     mlir::ModuleOp GetEvaluationFunction() {
         if (m_statsProfileCSV != "")
             TreeBeard::Profile::ReadProbabilityProfile(*m_forest, m_statsProfileCSV);
+        if (m_quantizeInputs)
+            QuantizeThresholds();
+        if (m_returnAllOutputs) {
+            if (!m_forest->IsMultiClassClassifier())
+                throw std::runtime_error("Only multi-class and multi-target models can return all outputs");
+            if (!m_returnType.isa<mlir::FloatType>())
+                throw std::runtime_error("All outputs can only be returned as floating point values");
+        }
+        if (!m_forest->GetOutputPredictionTransformations().empty() && !m_returnAllOutputs)
+            throw std::runtime_error("Forests that combine several models must return all outputs");
+        m_forest->SetProfileLeafHits(m_profileLeafHits);
+        if (m_forest->HasCategoricalSplits())
+            CheckCategoricalBitsetOffsetsFit();
 
         // Add getters for some constants we rely on at runtime
         AddConstIntegerGetFunction("GetBatchSize", m_batchSize);
         AddConstIntegerGetFunction("GetRowSize", m_forest->GetFeatures().size());
         AddConstIntegerGetFunction("GetInputTypeBitWidth", m_inputElementType.getIntOrFloatBitWidth());
         AddConstIntegerGetFunction("GetReturnTypeBitWidth", m_returnType.getIntOrFloatBitWidth());
+        AddConstIntegerGetFunction("GetDynamicBatch", m_dynamicBatch ? 1 : 0);
+        AddConstIntegerGetFunction("GetInputLayout", static_cast<int32_t>(m_inputLayout));
+        AddConstIntegerGetFunction("GetEarlyExit", IsEarlyExitEnabled() ? 1 : 0);
+        AddConstIntegerGetFunction("GetNumberOfOutputs", m_returnAllOutputs ? m_forest->GetNumOutputs() : 1);
+        AddConstIntegerGetFunction("GetNumberOfTrees", m_forest->NumTrees());
+        AddConstIntegerGetFunction("GetProfileLeafHits", m_profileLeafHits ? 1 : 0);
 
         mlir::func::FuncOp function(GetFunctionPrototype());
         if (!function)
@@ -303,13 +487,17 @@ public:
 
         m_builder.setInsertionPointToStart(&entryBlock);
 
+        // Fills in missing value directions, so it must run before the forest attribute copies the forest
+        auto predicate = GetPredicateForMissingValues();
         auto forestType = GetEnsembleType();
         auto forestAttribute = mlir::decisionforest::DecisionForestAttribute::get(forestType, *m_forest);
 
         auto scheduleType = mlir::decisionforest::ScheduleType::get(&m_context);
         m_schedule = new mlir::decisionforest::Schedule(m_batchSize, m_forest->NumTrees());
+        if (IsEarlyExitEnabled())
+            AddEarlyExitToSchedule();
         auto scheduleAttribute = mlir::decisionforest::ScheduleAttribute::get(scheduleType, m_schedule);
-        auto predicateAttribute = mlir::arith::CmpFPredicateAttr::get(&m_context, m_cmpPredicate);
+        auto predicateAttribute = mlir::arith::CmpFPredicateAttr::get(&m_context, predicate);
         auto predictOp = m_builder.create<mlir::decisionforest::PredictForestOp>(
             m_builder.getUnknownLoc(),
             GetFunctionResultType(),
@@ -329,6 +517,13 @@ public:
     }
 
     void SetChildIndexBitWidth(int32_t value) { m_childIndexBitWidth = value; }
+    void SetDynamicBatch(bool value) { m_dynamicBatch = value; }
+    void SetInputLayout(mlir::decisionforest::InputLayout value) { m_inputLayout = value; }
+    // A negative value disables early exit
+    void SetEarlyExitThreshold(double value) { m_earlyExitThreshold = value; }
+    void SetQuantizeInputs(bool value) { m_quantizeInputs = value; }
+    void SetReturnAllOutputs(bool value) { m_returnAllOutputs = value; }
+    void SetProfileLeafHits(bool value) { m_profileLeafHits = value; }
 
     mlir::MLIRContext& GetContext() { return m_context; }
     mlir::ModuleOp GetModule() { return m_module; }
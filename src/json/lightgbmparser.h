@@ -0,0 +1,309 @@
+#ifndef _LIGHTGBM_PARSER_H_
+#define _LIGHTGBM_PARSER_H_
+
+#include "forestcreator.h"
+#include "ForestCreatorFactory.h"
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <cmath>
+#include <stdexcept>
+
+namespace TreeBeard
+{
+
+/*
+Parses models in the text format written by lightgbm.Booster.save_model. The file starts with a header of
+key=value lines, which is followed by one block per tree :
+  Tree=0
+  num_leaves=3
+  num_cat=0
+  split_feature=2 0
+  threshold=0.5 1.25
+  decision_type=2 10
+  left_child=1 -1
+  right_child=-2 -3
+  leaf_value=0.1 -0.2 0.3
+  ...
+Internal nodes are numbered from 0 (the root) and leaves are referred to as ~leafIndex in left_child and
+right_child. The trees end at "end of trees".
+*/
+template<typename ThresholdType=double, typename ReturnType=double, typename FeatureIndexType=int32_t,
+         typename NodeIndexType=int32_t, typename InputElementType=double>
+class LightGBMTextParser : public ForestCreator
+{
+    typedef std::map<std::string, std::string> KeyValueMap;
+    // Bits of decision_type
+    static constexpr int32_t kCategoricalMask = 1;
+    static constexpr int32_t kDefaultLeftMask = 2;
+    enum MissingType { kNone = 0, kZero = 1, kNaN = 2 };
+    static constexpr double_t INITIAL_VALUE = 0;
+
+    KeyValueMap m_header;
+    std::vector<KeyValueMap> m_trees;
+    // All leaf values are multiplied by this (the sigmoid parameter of classifiers and 1/numIterations
+    // for random forests that average their trees)
+    double m_leafScale = 1.0;
+
+    void ReadModel(const std::string& filename);
+    void SetObjective();
+    void ConstructSingleTree(KeyValueMap& treeMap, int32_t numFeatures);
+
+    template<typename T>
+    static std::vector<T> ParseArray(const KeyValueMap& map, const std::string& key) {
+        std::vector<T> values;
+        auto iter = map.find(key);
+        if (iter == map.end())
+            return values;
+        std::istringstream valueStream(iter->second);
+        T value;
+        while (valueStream >> value)
+            values.push_back(value);
+        return values;
+    }
+    static std::string GetValue(const KeyValueMap& map, const std::string& key, const std::string& defaultValue="") {
+        auto iter = map.find(key);
+        return iter == map.end() ? defaultValue : iter->second;
+    }
+    // LightGBM sends x left if x <= threshold. Round thresholds down so that this holds for inputs of the
+    // threshold type when it is narrower than the double thresholds in the model.
+    static double RoundThreshold(double threshold) {
+        auto rounded = static_cast<ThresholdType>(threshold);
+        if (static_cast<double>(rounded) > threshold)
+            rounded = std::nextafter(rounded, -std::numeric_limits<ThresholdType>::infinity());
+        return static_cast<double>(rounded);
+    }
+public:
+    LightGBMTextParser(mlir::MLIRContext& context,
+                       const std::string& filename,
+                       std::shared_ptr<mlir::decisionforest::IModelSerializer> serializer,
+                       int32_t batchSize)
+        :ForestCreator(
+          serializer,
+          context,
+          batchSize,
+          INITIAL_VALUE,
+          GetMLIRType(ThresholdType(), context),
+          GetMLIRType(FeatureIndexType(), context),
+          GetMLIRType(NodeIndexType(), context),
+          GetMLIRType(ReturnType(), context),
+          GetMLIRType(InputElementType(), context))
+    {
+        ReadModel(filename);
+    }
+
+    LightGBMTextParser(mlir::MLIRContext& context,
+                       const std::string& filename,
+                       std::shared_ptr<mlir::decisionforest::IModelSerializer> serializer,
+                       const std::string& statsProfileCSV,
+                       int32_t batchSize)
+        :ForestCreator(
+          serializer,
+          context,
+          batchSize,
+          INITIAL_VALUE,
+          statsProfileCSV,
+          GetMLIRType(ThresholdType(), context),
+          GetMLIRType(FeatureIndexType(), context),
+          GetMLIRType(NodeIndexType(), context),
+          GetMLIRType(ReturnType(), context),
+          GetMLIRType(InputElementType(), context))
+    {
+        ReadModel(filename);
+    }
+
+    void ConstructForest() override;
+};
+
+template<typename ThresholdType, typename ReturnType, typename FeatureIndexType, typename NodeIndexType, typename InputElementType>
+void LightGBMTextParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexType, InputElementType>::ReadModel(const std::string& filename)
+{
+    std::ifstream fin(filename);
+    if (!fin)
+        throw std::runtime_error("Could not open LightGBM model file " + filename);
+    KeyValueMap* currentMap = &m_header;
+    std::string line;
+    while (std::getline(fin, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line == "end of trees")
+            break;
+        if (line.empty())
+            continue;
+        auto separator = line.find('=');
+        if (separator == std::string::npos) {
+            // Flags such as average_output are written without a value
+            (*currentMap)[line] = "";
+            continue;
+        }
+        auto key = line.substr(0, separator);
+        if (key == "Tree") {
+            m_trees.push_back(KeyValueMap());
+            currentMap = &m_trees.back();
+        }
+        (*currentMap)[key] = line.substr(separator + 1);
+    }
+    if (GetValue(m_header, "version") == "")
+        throw std::runtime_error(filename + " is not a LightGBM text model");
+}
+
+// The objective line is the objective's name followed by its parameters (for example "binary sigmoid:1" or
+// "multiclass num_class:3"). Models trained with a custom objective have no objective and output raw scores.
+template<typename ThresholdType, typename ReturnType, typename FeatureIndexType, typename NodeIndexType, typename InputElementType>
+void LightGBMTextParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexType, InputElementType>::SetObjective()
+{
+    std::istringstream objectiveStream(GetValue(m_header, "objective", "custom"));
+    std::string objectiveName, parameter;
+    objectiveStream >> objectiveName;
+    double sigmoidScale = 1.0;
+    while (objectiveStream >> parameter) {
+        if (parameter == "sqrt")
+            throw std::runtime_error("LightGBM regression models trained on the square root of the label are not supported");
+        if (parameter.rfind("sigmoid:", 0) == 0)
+            sigmoidScale = std::stod(parameter.substr(std::string("sigmoid:").size()));
+    }
+
+    using mlir::decisionforest::PredictionTransformation;
+    PredictionTransformation predTransform;
+    if (objectiveName == "binary" || objectiveName == "multiclassova" || objectiveName == "cross_entropy") {
+        // sigmoid(sigmoidScale * x)
+        predTransform = PredictionTransformation::kSigmoid;
+        m_leafScale *= sigmoidScale;
+    }
+    else if (objectiveName == "multiclass")
+        predTransform = PredictionTransformation::kSoftMax;
+    else if (objectiveName == "poisson" || objectiveName == "gamma" || objectiveName == "tweedie")
+        predTransform = PredictionTransformation::kExponential;
+    else if (objectiveName == "regression" || objectiveName == "regression_l1" || objectiveName == "huber" ||
+             objectiveName == "fair" || objectiveName == "quantile" || objectiveName == "mape" ||
+             objectiveName == "lambdarank" || objectiveName == "rank_xendcg" || objectiveName == "custom")
+        predTransform = PredictionTransformation::kIdentity;
+    else
+        throw std::runtime_error("Unsupported LightGBM objective " + objectiveName);
+    this->m_forest->SetPredictionTransformation(predTransform);
+}
+
+template<typename ThresholdType, typename ReturnType, typename FeatureIndexType, typename NodeIndexType, typename InputElementType>
+void LightGBMTextParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexType, InputElementType>::ConstructForest()
+{
+    auto numClasses = std::stoi(GetValue(m_header, "num_class", "1"));
+    auto numTreesPerIteration = std::stoi(GetValue(m_header, "num_tree_per_iteration", "1"));
+    // Each iteration adds one tree per class. Tree i predicts class i % numTreesPerIteration.
+    if (numTreesPerIteration != numClasses)
+        throw std::runtime_error("LightGBM models must have one tree per class in each iteration");
+    if (m_trees.size() % numTreesPerIteration != 0)
+        throw std::runtime_error("The number of trees in the LightGBM model is not a multiple of the number of trees per iteration");
+    this->SetNumberOfClasses(numClasses > 1 ? numClasses : 0);
+    this->SetReductionType(mlir::decisionforest::ReductionType::kAdd);
+    // LightGBM sends x left if x <= threshold
+    this->SetPredicateType(mlir::arith::CmpFPredicate::ULE);
+    SetObjective();
+    // Random forests average the predictions of their iterations
+    if (m_header.find("average_output") != m_header.end())
+        m_leafScale /= static_cast<double>(m_trees.size() / numTreesPerIteration);
+
+    auto numFeatures = std::stoi(GetValue(m_header, "max_feature_idx")) + 1;
+    auto featureNames = ParseArray<std::string>(m_header, "feature_names");
+    auto featureInfos = ParseArray<std::string>(m_header, "feature_infos");
+    if (!featureNames.empty() && static_cast<int32_t>(featureNames.size()) != numFeatures)
+        throw std::runtime_error("The number of LightGBM feature names doesn't match max_feature_idx");
+    for (int32_t i=0 ; i<numFeatures ; ++i) {
+        auto name = featureNames.empty() ? std::to_string(i) : featureNames[i];
+        // Numerical features are described by their range ("[min:max]") and categorical ones by their categories
+        // ("0:3:5"). Unused features are "none".
+        bool isCategorical = static_cast<size_t>(i) < featureInfos.size() && featureInfos[i] != "none" && featureInfos[i][0] != '[';
+        this->AddFeature(name, isCategorical ? "c" : "float");
+    }
+
+    int32_t treeIndex = 0;
+    for (auto& treeMap : m_trees) {
+        this->NewTree();
+        ConstructSingleTree(treeMap, numFeatures);
+        if (numClasses > 1)
+            this->SetTreeClassId(treeIndex % numTreesPerIteration);
+        this->EndTree();
+        ++treeIndex;
+    }
+}
+
+template<typename ThresholdType, typename ReturnType, typename FeatureIndexType, typename NodeIndexType, typename InputElementType>
+void LightGBMTextParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexType, InputElementType>::ConstructSingleTree(KeyValueMap& treeMap, int32_t numFeatures)
+{
+    if (std::stoi(GetValue(treeMap, "is_linear", "0")) != 0)
+        throw std::runtime_error("LightGBM linear trees are not supported");
+    auto numLeaves = std::stoi(GetValue(treeMap, "num_leaves", "0"));
+    auto splitFeatures = ParseArray<int32_t>(treeMap, "split_feature");
+    auto thresholds = ParseArray<double>(treeMap, "threshold");
+    auto decisionTypes = ParseArray<int32_t>(treeMap, "decision_type");
+    auto leftChildren = ParseArray<int32_t>(treeMap, "left_child");
+    auto rightChildren = ParseArray<int32_t>(treeMap, "right_child");
+    auto leafValues = ParseArray<double>(treeMap, "leaf_value");
+    // The categories of a categorical node with threshold k are the bits set in
+    // catThresholds[catBoundaries[k], catBoundaries[k+1])
+    auto catBoundaries = ParseArray<int32_t>(treeMap, "cat_boundaries");
+    auto catThresholds = ParseArray<uint32_t>(treeMap, "cat_threshold");
+    if (numLeaves < 1 || static_cast<int32_t>(leafValues.size()) != numLeaves)
+        throw std::runtime_error("LightGBM tree " + GetValue(treeMap, "Tree") + " doesn't have num_leaves leaf values");
+    size_t numInternalNodes = numLeaves - 1;
+    if (splitFeatures.size() != numInternalNodes || thresholds.size() != numInternalNodes || decisionTypes.size() != numInternalNodes ||
+        leftChildren.size() != numInternalNodes || rightChildren.size() != numInternalNodes)
+        throw std::runtime_error("LightGBM tree " + GetValue(treeMap, "Tree") + " doesn't have num_leaves-1 internal nodes");
+    this->SetTreeNumberOfFeatures(numFeatures);
+
+    // Internal nodes are created first so that the root is node 0
+    std::vector<int64_t> internalNodes, leaves;
+    for (size_t i=0 ; i<numInternalNodes ; ++i) {
+        auto decisionType = decisionTypes[i];
+        auto missingType = static_cast<MissingType>((decisionType >> 2) & 3);
+        bool defaultLeft = (decisionType & kDefaultLeftMask) != 0;
+        if (decisionType & kCategoricalMask) {
+            auto bitsetIndex = static_cast<int32_t>(thresholds[i]);
+            std::vector<int32_t> categories;
+            for (int32_t word=catBoundaries.at(bitsetIndex) ; word<catBoundaries.at(bitsetIndex+1) ; ++word)
+                for (int32_t bit=0 ; bit<32 ; ++bit)
+                    if ((catThresholds.at(word) >> bit) & 1)
+                        categories.push_back((word - catBoundaries[bitsetIndex])*32 + bit);
+            // LightGBM sends the categories in the set left and missing values right while Treebeard sends the
+            // set right, so the children are swapped below and missing values go left
+            auto node = this->NewNode(0.0, splitFeatures[i]);
+            this->SetNodeCategoricalSplit(node, categories);
+            this->SetNodeDefaultLeft(node, true);
+            internalNodes.push_back(node);
+            continue;
+        }
+        auto threshold = thresholds[i];
+        // Missing values are replaced with zero unless the node has a default direction for them. If zeros are
+        // treated as missing too, they must go the same way as they are compared.
+        if (missingType == kNone)
+            defaultLeft = 0.0 <= threshold;
+        else if (missingType == kZero && defaultLeft != (0.0 <= threshold))
+            throw std::runtime_error("LightGBM splits that send zero (as a missing value) against the threshold are not supported");
+        auto node = this->NewNode(RoundThreshold(threshold), splitFeatures[i]);
+        this->SetNodeDefaultLeft(node, defaultLeft);
+        internalNodes.push_back(node);
+    }
+    for (int32_t i=0 ; i<numLeaves ; ++i)
+        leaves.push_back(this->NewNode(leafValues[i] * m_leafScale, 0));
+
+    auto getChild = [&](int32_t child) { return child < 0 ? leaves.at(~child) : internalNodes.at(child); };
+    if (numInternalNodes == 0)
+        this->SetNodeParent(leaves[0], -1);
+    else
+        this->SetNodeParent(internalNodes[0], -1);
+    for (size_t i=0 ; i<numInternalNodes ; ++i) {
+        auto leftChild = getChild(leftChildren[i]);
+        auto rightChild = getChild(rightChildren[i]);
+        if (decisionTypes[i] & kCategoricalMask)
+            std::swap(leftChild, rightChild);
+        this->SetNodeLeftChild(internalNodes[i], leftChild);
+        this->SetNodeRightChild(internalNodes[i], rightChild);
+        this->SetNodeParent(leftChild, internalNodes[i]);
+        this->SetNodeParent(rightChild, internalNodes[i]);
+    }
+}
+
+std::shared_ptr<ForestCreator> ConstructLightGBMTextParser(TreebeardContext& tbContext);
+
+} // namespace TreeBeard
+
+#endif //_LIGHTGBM_PARSER_H_
@@ -15,6 +15,8 @@
 #include <memory>
 #include <vector>
 #include <fstream>
+#include <limits>
+#include <stdexcept>
 
 #include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/IR/MLIRContext.h"
@@ -26,6 +28,10 @@
 
 namespace TreeBeard
 {
+    // How a non-leaf node compares its feature value. Numerical nodes all use the ensemble's
+    // BRANCH_{LT, GEQ, GT, LEQ} mode. BRANCH_EQ and BRANCH_NEQ nodes compare against a single category.
+    enum class ONNXNodeMode : int8_t { kNumerical, kEqual, kNotEqual };
+
     using ONNXModelParseResult = struct OnnxModelParseResult {
     float baseValue;
     mlir::decisionforest::PredictionTransformation predTransform;
@@ -38,6 +44,8 @@ namespace TreeBeard
     const int64_t *falseNodeIds;
     const int64_t *trueNodeIds;
     mlir::arith::CmpFPredicate nodeMode;
+    std::vector<ONNXNodeMode> nodeModes;
+    mlir::decisionforest::ReductionType reductionType = mlir::decisionforest::ReductionType::kAdd;
     int64_t numberOfClasses;
     const int64_t *targetClassTreeId;
     const int64_t *targetClassNodeId;
@@ -107,6 +115,11 @@ namespace TreeBeard
             } else {
             assert(false && "Unknown post_transform");
             }
+        } else if (attribute.name() == "aggregate_function") {
+            if (attribute.s() == "AVERAGE")
+                reductionType = mlir::decisionforest::ReductionType::kAverage;
+            else if (attribute.s() != "SUM")
+                throw std::runtime_error("Unsupported ONNX aggregate_function " + attribute.s());
         } else if (attribute.name() == "nodes_falsenodeids") {
             falseNodeIds = attribute.ints().data();
         } else if (attribute.name() == "nodes_truenodeids") {
@@ -123,11 +136,19 @@ namespace TreeBeard
             auto size = attribute.strings_size();
             auto data = attribute.strings().data();
             if (size > 0) {
-                auto first = *data[0];
-                assert((first == "BRANCH_LT" || first == "BRANCH_GEQ" || first == "BRANCH_GT" || first == "BRANCH_LEQ") && "Only BRANCH_{LT, GEQ, GT, LEQ} is supported");
-                for (int i = 1; i < size; i++) {
-                    assert((*data[i] == first || *data[i] == "LEAF") &&
-                        "Only BRANCH_{LT, GEQ, GT, LEQ} is supported");
+                std::string first;
+                nodeModes.resize(size, ONNXNodeMode::kNumerical);
+                for (int i = 0; i < size; i++) {
+                    if (*data[i] == "BRANCH_EQ")
+                        nodeModes[i] = ONNXNodeMode::kEqual;
+                    else if (*data[i] == "BRANCH_NEQ")
+                        nodeModes[i] = ONNXNodeMode::kNotEqual;
+                    else if (*data[i] != "LEAF") {
+                        assert((*data[i] == "BRANCH_LT" || *data[i] == "BRANCH_GEQ" || *data[i] == "BRANCH_GT" || *data[i] == "BRANCH_LEQ") &&
+                               "Only BRANCH_{LT, GEQ, GT, LEQ, EQ, NEQ} is supported");
+                        assert((first.empty() || first == *data[i]) && "All numerical nodes must use the same mode");
+                        first = *data[i];
+                    }
                 }
                 if (first == "BRANCH_LT") {
                     nodeMode = mlir::arith::CmpFPredicate::ULT;
@@ -196,6 +217,7 @@ namespace TreeBeard
         ThresholdType threshold;
         std::shared_ptr<struct _ONNXTreeNode> leftChild = nullptr;
         std::shared_ptr<struct _ONNXTreeNode> rightChild = nullptr;
+        ONNXNodeMode mode = ONNXNodeMode::kNumerical;
     };
 
     template<typename ThresholdType>
@@ -231,7 +253,9 @@ namespace TreeBeard
                             const int64_t *targetClassIds,
                             const float *targetWeights,
                             int64_t numWeights,
-                            int64_t batchSize
+                            int64_t batchSize,
+                            const ONNXNodeMode *nodeModes = nullptr,
+                            mlir::decisionforest::ReductionType reductionType = mlir::decisionforest::ReductionType::kAdd
                             ) : ForestCreator(serializer,
                                                 context,
                                                 batchSize,
@@ -253,6 +277,8 @@ namespace TreeBeard
                     auto onnxTreeNode = std::make_shared<ONNXTreeNode<ValueType>>();
                     onnxTreeNode->featureId = featureIds[i];
                     onnxTreeNode->threshold = thresholds[i];
+                    if (nodeModes)
+                        onnxTreeNode->mode = nodeModes[i];
 
                     nodeMap[key] = onnxTreeNode;
                 }
@@ -289,13 +315,10 @@ namespace TreeBeard
 
                 if (numberOfClasess > 0) _isClassifier = true;
 
-                this->SetInitialOffset(baseValue);
                 this->SetNumberOfClasses(numberOfClasess);
                 this->m_forest->SetPredictionTransformation(predTransform);
                 this->SetPredicateType(nodeMode);
-
-                // #TODOSampath - Revisit this hardcoding.
-                this->SetReductionType(mlir::decisionforest::ReductionType::kAdd);
+                this->SetReductionType(reductionType);
 
                 int64_t currTreeId = -1;
                 for (int64_t i = 0; i < numNodes; i++) {
@@ -305,6 +328,19 @@ namespace TreeBeard
                     currTreeId = treeIds[i];
                 }
 
+                // ONNX adds the base value to the average of the trees while Treebeard averages the initial offset
+                // with the trees, so the offset is scaled up by the number of trees. Classifiers are averaged over all
+                // trees by ONNX but over the trees of each class by Treebeard.
+                if (reductionType == mlir::decisionforest::ReductionType::kAverage) {
+                    if (_isClassifier)
+                        throw std::runtime_error("ONNX classifiers with the AVERAGE aggregate function are not supported");
+                    this->SetInitialOffset(baseValue * static_cast<double>(_trees.size()));
+                }
+                else if (reductionType == mlir::decisionforest::ReductionType::kAdd)
+                    this->SetInitialOffset(baseValue);
+                else
+                    throw std::runtime_error("ONNX tree ensembles can only add or average their trees");
+
                 // ONNX uses weights instead of threshould of leaves to compute final prediction. Treebeard uses leaf threshold value.
                 // setting threshld value of leaves to weights to compute final prediction.
                 // ONNX also uses different class IDs for each leaf node which treebeard currently doesn't support. We are just storing the data for now.
@@ -331,11 +367,27 @@ namespace TreeBeard
                 if (parent) {
                     auto rootIndex = this->NewNode(parent->threshold, parent->featureId);
                     auto leftChildIndex = constructSingleTree(parent->leftChild);
+                    auto rightChildIndex = constructSingleTree(parent->rightChild);
+                    bool isLeaf = leftChildIndex == -1 && rightChildIndex == -1;
+                    // Missing values follow the true branch (the unordered predicates are used for numerical nodes).
+                    // Categorical nodes send rows in their category set right, so the children of an
+                    // equality node are swapped.
+                    if (!isLeaf && parent->mode != ONNXNodeMode::kNumerical) {
+                        auto category = parent->threshold;
+                        if (!(category >= 0 && category == std::floor(category) && category <= std::numeric_limits<int32_t>::max()))
+                            throw std::runtime_error("BRANCH_EQ and BRANCH_NEQ nodes must compare with a non-negative integer category");
+                        this->SetNodeCategoricalSplit(rootIndex, {static_cast<int32_t>(category)});
+                        if (parent->mode == ONNXNodeMode::kEqual)
+                            std::swap(leftChildIndex, rightChildIndex);
+                        this->SetNodeDefaultLeft(rootIndex, parent->mode == ONNXNodeMode::kNotEqual);
+                    }
+                    else if (!isLeaf) {
+                        this->SetNodeDefaultLeft(rootIndex, true);
+                    }
                     if (leftChildIndex != -1) {
                         this->SetNodeLeftChild(rootIndex, leftChildIndex);
                         this->SetNodeParent(leftChildIndex, rootIndex);
                     }
-                    auto rightChildIndex = constructSingleTree(parent->rightChild);
                     if (rightChildIndex != -1) {
                         this->SetNodeRightChild(rootIndex, rightChildIndex);
                         this->SetNodeParent(rightChildIndex, rootIndex);
@@ -398,7 +450,8 @@ namespace TreeBeard
                     parsedModel.trueNodeIds, parsedModel.falseNodeIds,
                     parsedModel.numberOfClasses, parsedModel.targetClassTreeId,
                     parsedModel.targetClassNodeId, parsedModel.targetClassIds,
-                    parsedModel.targetWeights, parsedModel.numWeights, tbContext.options.batchSize);
+                    parsedModel.targetWeights, parsedModel.numWeights, tbContext.options.batchSize,
+                    parsedModel.nodeModes.empty() ? nullptr : parsedModel.nodeModes.data(), parsedModel.reductionType);
                 
                 m_modelConvertor->ConstructForest();
             }
@@ -406,6 +459,8 @@ namespace TreeBeard
             void ConstructForest() override
             {
                 *this->m_forest = *m_modelConvertor->GetForest();
+                // The comparison predicate is set on the converter from the model's node modes
+                this->SetPredicateType(m_modelConvertor->GetPredicateType());
             }
     };
 
@@ -418,8 +473,8 @@ namespace TreeBeard
       TreeBeard::TreebeardContext tbContext(modelPath, 
                                             modelGlobalsJSONPath,
                                             *optionsPtr,
-                                            mlir::decisionforest::ConstructRepresentation(),
-                                            mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath),
+                                            mlir::decisionforest::ConstructRepresentation(optionsPtr->sparseRepresentation),
+                                            mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath, optionsPtr->sparseRepresentation),
                                             nullptr /*TODO_ForestCreator*/ );
       // Hardcoding to float because ONNX doesn't support double. Revisit this
       // #TODOSampath
@@ -428,7 +483,8 @@ namespace TreeBeard
 
       auto *inferenceRunner = new mlir::decisionforest::InferenceRunner(
           tbContext.serializer, module, optionsPtr->tileSize,
-          optionsPtr->thresholdTypeWidth, optionsPtr->featureIndexTypeWidth);
+          optionsPtr->thresholdTypeWidth, optionsPtr->featureIndexTypeWidth,
+          optionsPtr->GetLLVMCodeGenOptions());
       return inferenceRunner;
     }
 
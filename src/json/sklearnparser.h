@@ -0,0 +1,182 @@
+#ifndef _SKLEARN_PARSER_H_
+#define _SKLEARN_PARSER_H_
+
+#include "forestcreator.h"
+#include "ForestCreatorFactory.h"
+#include <fstream>
+#include <limits>
+#include <cmath>
+#include <stdexcept>
+
+namespace TreeBeard
+{
+
+/*
+Parses the JSON that treebeard.ExportSKLearnModel writes for scikit-learn random forests and extra trees :
+  {
+    "n_features" : 4,
+    "n_classes" : 3,              (0 for regressors)
+    "reduction" : "average",      (or "voting")
+    "trees" : [
+      {
+        "class_id" : 0,
+        "children_left" : [1, -1, -1],
+        "children_right" : [2, -1, -1],
+        "feature" : [2, -2, -2],
+        "threshold" : [0.5, -2.0, -2.0],
+        "value" : [0.0, 0.1, 0.9],
+        "missing_go_to_left" : [1, 0, 0]
+      },
+      ...
+    ]
+  }
+The arrays are scikit-learn's tree_ arrays. Node 0 is the root and leaves have no children (-1). Averaged
+classifiers have one tree per class for each estimator whose leaves are the probabilities of the class. The
+leaves of voting classifiers are the class each estimator predicts.
+*/
+template<typename ThresholdType=double, typename ReturnType=double, typename FeatureIndexType=int32_t,
+         typename NodeIndexType=int32_t, typename InputElementType=double>
+class SKLearnJSONParser : public ForestCreator
+{
+    static constexpr double_t INITIAL_VALUE = 0;
+    static constexpr int32_t kLeaf = -1;
+    json m_modelJSON;
+
+    void ConstructSingleTree(json& treeJSON, int32_t numFeatures);
+    // scikit-learn sends x left if x <= threshold. Round thresholds down so that this holds for inputs of the
+    // threshold type when it is narrower than the double thresholds in the model.
+    static double RoundThreshold(double threshold) {
+        auto rounded = static_cast<ThresholdType>(threshold);
+        if (static_cast<double>(rounded) > threshold)
+            rounded = std::nextafter(rounded, -std::numeric_limits<ThresholdType>::infinity());
+        return static_cast<double>(rounded);
+    }
+    void ReadModel(const std::string& filename) {
+        std::ifstream fin(filename);
+        if (!fin)
+            throw std::runtime_error("Could not open scikit-learn model file " + filename);
+        fin >> m_modelJSON;
+    }
+public:
+    SKLearnJSONParser(mlir::MLIRContext& context,
+                      const std::string& filename,
+                      std::shared_ptr<mlir::decisionforest::IModelSerializer> serializer,
+                      int32_t batchSize)
+        :ForestCreator(
+          serializer,
+          context,
+          batchSize,
+          INITIAL_VALUE,
+          GetMLIRType(ThresholdType(), context),
+          GetMLIRType(FeatureIndexType(), context),
+          GetMLIRType(NodeIndexType(), context),
+          GetMLIRType(ReturnType(), context),
+          GetMLIRType(InputElementType(), context))
+    {
+        ReadModel(filename);
+    }
+
+    SKLearnJSONParser(mlir::MLIRContext& context,
+                      const std::string& filename,
+                      std::shared_ptr<mlir::decisionforest::IModelSerializer> serializer,
+                      const std::string& statsProfileCSV,
+                      int32_t batchSize)
+        :ForestCreator(
+          serializer,
+          context,
+          batchSize,
+          INITIAL_VALUE,
+          statsProfileCSV,
+          GetMLIRType(ThresholdType(), context),
+          GetMLIRType(FeatureIndexType(), context),
+          GetMLIRType(NodeIndexType(), context),
+          GetMLIRType(ReturnType(), context),
+          GetMLIRType(InputElementType(), context))
+    {
+        ReadModel(filename);
+    }
+
+    void ConstructForest() override;
+};
+
+template<typename ThresholdType, typename ReturnType, typename FeatureIndexType, typename NodeIndexType, typename InputElementType>
+void SKLearnJSONParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexType, InputElementType>::ConstructForest()
+{
+    auto numFeatures = m_modelJSON["n_features"].get<int32_t>();
+    auto numClasses = m_modelJSON["n_classes"].get<int32_t>();
+    auto reduction = m_modelJSON["reduction"].get<std::string>();
+    this->SetNumberOfClasses(numClasses);
+    if (reduction == "voting") {
+        if (numClasses <= 0)
+            throw std::runtime_error("Only scikit-learn classifiers can vote");
+        this->SetReductionType(mlir::decisionforest::ReductionType::kVoting);
+    }
+    else {
+        if (reduction != "average")
+            throw std::runtime_error("Unknown scikit-learn reduction " + reduction);
+        this->SetReductionType(mlir::decisionforest::ReductionType::kAverage);
+    }
+    // The averaged class probabilities and the vote fractions are the outputs
+    this->m_forest->SetPredictionTransformation(mlir::decisionforest::PredictionTransformation::kIdentity);
+    this->SetPredicateType(mlir::arith::CmpFPredicate::ULE);
+    for (int32_t i=0 ; i<numFeatures ; ++i)
+        this->AddFeature(std::to_string(i), "float");
+
+    for (auto& treeJSON : m_modelJSON["trees"]) {
+        this->NewTree();
+        ConstructSingleTree(treeJSON, numFeatures);
+        if (numClasses > 0)
+            this->SetTreeClassId(treeJSON["class_id"].get<int32_t>());
+        this->EndTree();
+    }
+    // Release the model since the forest now holds all of it
+    m_modelJSON = json();
+}
+
+template<typename ThresholdType, typename ReturnType, typename FeatureIndexType, typename NodeIndexType, typename InputElementType>
+void SKLearnJSONParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexType, InputElementType>::ConstructSingleTree(json& treeJSON, int32_t numFeatures)
+{
+    auto& childrenLeft = treeJSON["children_left"];
+    auto& childrenRight = treeJSON["children_right"];
+    auto& features = treeJSON["feature"];
+    auto& thresholds = treeJSON["threshold"];
+    auto& values = treeJSON["value"];
+    // Models saved by versions of scikit-learn without missing value support don't have missing_go_to_left.
+    // Their trees compare NaN with the threshold, which sends it right.
+    auto& missingGoToLeft = treeJSON["missing_go_to_left"];
+    auto numNodes = childrenLeft.size();
+    if (numNodes == 0 || childrenRight.size() != numNodes || features.size() != numNodes ||
+        thresholds.size() != numNodes || values.size() != numNodes)
+        throw std::runtime_error("The node arrays of a scikit-learn tree must be non-empty and the same size");
+    if (!missingGoToLeft.is_null() && missingGoToLeft.size() != numNodes)
+        throw std::runtime_error("missing_go_to_left must have an entry for each node of the scikit-learn tree");
+    this->SetTreeNumberOfFeatures(numFeatures);
+
+    // Nodes are created in the order of scikit-learn's node IDs so that the root is node 0
+    std::vector<int64_t> nodes;
+    for (size_t i=0 ; i<numNodes ; ++i) {
+        bool isLeaf = childrenLeft[i].get<int32_t>() == kLeaf;
+        auto node = isLeaf ? this->NewNode(values[i].get<double>(), 0) :
+                             this->NewNode(RoundThreshold(thresholds[i].get<double>()), features[i].get<int32_t>());
+        if (!isLeaf)
+            this->SetNodeDefaultLeft(node, !missingGoToLeft.is_null() && missingGoToLeft[i].get<int32_t>() != 0);
+        nodes.push_back(node);
+    }
+    this->SetNodeParent(nodes[0], -1);
+    for (size_t i=0 ; i<numNodes ; ++i) {
+        auto leftChild = childrenLeft[i].get<int32_t>();
+        if (leftChild == kLeaf)
+            continue;
+        auto rightChild = childrenRight[i].get<int32_t>();
+        this->SetNodeLeftChild(nodes[i], nodes.at(leftChild));
+        this->SetNodeRightChild(nodes[i], nodes.at(rightChild));
+        this->SetNodeParent(nodes.at(leftChild), nodes[i]);
+        this->SetNodeParent(nodes.at(rightChild), nodes[i]);
+    }
+}
+
+std::shared_ptr<ForestCreator> ConstructSKLearnJSONParser(TreebeardContext& tbContext);
+
+} // namespace TreeBeard
+
+#endif //_SKLEARN_PARSER_H_
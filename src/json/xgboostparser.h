@@ -4,17 +4,164 @@
 #include "forestcreator.h"
 #include "ForestCreatorFactory.h"
 #include <fstream>
+#include <filesystem>
+#include <stdexcept>
 
 namespace TreeBeard
 {
 
+// XGBoost models are saved as JSON or, if the file name ends in ".ubj", as UBJSON
+inline bool IsUBJSONModelPath(const std::string& modelPath) {
+    const std::string extension = ".ubj";
+    return modelPath.size() >= extension.size() && 
+           modelPath.compare(modelPath.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// A SAX handler that builds the DOM of an XGBoost model except for its trees. Each tree is passed to a 
+// callback as soon as it is parsed and then replaced with null, so only one tree is in memory at a time.
+class XGBoostModelSAXReader
+{
+    json& m_root;
+    std::function<void(json&)> m_treeCallback;
+    // The open objects and arrays and, for objects, the key of the value being parsed
+    std::vector<json*> m_containers;
+    std::vector<std::string> m_keys;
+    json* m_objectElement = nullptr;
+    int32_t m_treesArrayDepth = -1;
+
+    json* AddValue(json&& value) {
+        if (m_containers.empty()) {
+            m_root = std::move(value);
+            return &m_root;
+        }
+        auto& container = *m_containers.back();
+        if (container.is_array()) {
+            container.push_back(std::move(value));
+            return &container.back();
+        }
+        *m_objectElement = std::move(value);
+        return m_objectElement;
+    }
+    bool StartContainer(json&& container) {
+        m_containers.push_back(AddValue(std::move(container)));
+        m_keys.push_back("");
+        return true;
+    }
+    bool IsTreesArrayPath() const {
+        static const std::vector<std::string> treesPath = { "learner", "gradient_booster", "model", "trees" };
+        return m_keys == treesPath;
+    }
+public:
+    XGBoostModelSAXReader(json& root, std::function<void(json&)> treeCallback)
+        : m_root(root), m_treeCallback(treeCallback)
+    { }
+
+    bool null() { AddValue(nullptr); return true; }
+    bool boolean(bool val) { AddValue(val); return true; }
+    bool number_integer(json::number_integer_t val) { AddValue(val); return true; }
+    bool number_unsigned(json::number_unsigned_t val) { AddValue(val); return true; }
+    bool number_float(json::number_float_t val, const json::string_t&) { AddValue(val); return true; }
+    bool string(json::string_t& val) { AddValue(val); return true; }
+    bool binary(json::binary_t& val) { AddValue(json::binary(val)); return true; }
+    bool start_object(std::size_t) { return StartContainer(json::object()); }
+    bool key(json::string_t& val) {
+        m_keys.back() = val;
+        m_objectElement = &(*m_containers.back())[val];
+        return true;
+    }
+    bool end_object() {
+        m_containers.pop_back();
+        m_keys.pop_back();
+        if (static_cast<int32_t>(m_containers.size()) == m_treesArrayDepth) {
+            auto& tree = m_containers.back()->back();
+            m_treeCallback(tree);
+            tree = nullptr;
+        }
+        return true;
+    }
+    bool start_array(std::size_t) {
+        if (IsTreesArrayPath())
+            m_treesArrayDepth = m_containers.size() + 1;
+        return StartContainer(json::array());
+    }
+    bool end_array() {
+        if (static_cast<int32_t>(m_containers.size()) == m_treesArrayDepth)
+            m_treesArrayDepth = -1;
+        m_containers.pop_back();
+        m_keys.pop_back();
+        return true;
+    }
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& ex) {
+        throw std::runtime_error("Failed to parse XGBoost model at byte " + std::to_string(position) + " : " + ex.what());
+    }
+};
+
+// Parses the model at modelPath, passing each tree to treeCallback, and returns the rest of the model
+inline json ReadXGBoostModel(const std::string& modelPath, std::function<void(json&)> treeCallback) {
+    json model;
+    XGBoostModelSAXReader reader(model, treeCallback);
+    std::ifstream fin(modelPath, std::ios::binary);
+    if (!fin)
+        throw std::runtime_error("Could not open XGBoost model file " + modelPath);
+    auto format = IsUBJSONModelPath(modelPath) ? json::input_format_t::ubjson : json::input_format_t::json;
+    if (!json::sax_parse(fin, &reader, format))
+        throw std::runtime_error("Failed to parse XGBoost model " + modelPath);
+    return model;
+}
+
+// Several XGBoost models with a single output each can be compiled together from a manifest that lists them :
+//   { "models" : [ "model1.json", "/path/to/model2.ubj", ... ] }
+// Relative paths are relative to the directory of the manifest. The models become one forest with an output
+// per model (the trees of a model add up to its output), so the generated code reads each row once for all 
+// the models and writes a [batch, numModels] result (see CompilerOptions::returnAllOutputs). Rows hold the
+// features of the model with the most features, so the features of every model must be a prefix of those of the
+// widest model. Manifests are recognized by their ".models.json" extension.
+inline bool IsXGBoostMultiModelManifestPath(const std::string& modelPath) {
+    const std::string extension = ".models.json";
+    return modelPath.size() >= extension.size() && 
+           modelPath.compare(modelPath.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// The paths of the models listed in a manifest
+inline std::vector<std::string> ReadXGBoostMultiModelManifest(const std::string& manifestPath) {
+    std::ifstream fin(manifestPath);
+    if (!fin)
+        throw std::runtime_error("Could not open model manifest " + manifestPath);
+    json manifestJSON = json::parse(fin, nullptr, false);
+    if (manifestJSON.is_discarded() || !manifestJSON.is_object() || !manifestJSON.contains("models") || !manifestJSON["models"].is_array())
+        throw std::runtime_error("The model manifest " + manifestPath + " must be a JSON object with a \"models\" array");
+    auto manifestDirectory = std::filesystem::path(manifestPath).parent_path();
+    std::vector<std::string> modelPaths;
+    for (auto& modelPathJSON : manifestJSON["models"]) {
+        if (!modelPathJSON.is_string())
+            throw std::runtime_error("The models listed in the manifest " + manifestPath + " must be paths");
+        std::filesystem::path modelPath(modelPathJSON.get<std::string>());
+        if (modelPath.is_relative())
+            modelPath = manifestDirectory / modelPath;
+        modelPaths.push_back(modelPath.string());
+    }
+    if (modelPaths.empty())
+        throw std::runtime_error("The model manifest " + manifestPath + " must list at least one model");
+    return modelPaths;
+}
+
 template<typename ThresholdType=double, typename ReturnType=double, typename FeatureIndexType=int32_t, 
          typename NodeIndexType=int32_t, typename InputElementType=double>
 class XGBoostJSONParser : public ForestCreator
 {
-    json m_json;
+    std::string m_modelPath;
     void ConstructSingleTree(json& treeJSON);
-    void ConstructTreesFromBooster(json& boosterJSON);
+    void SetTreeClassIds(json& boosterJSON);
+    void AddFeatures(json& learnerJSON);
+    void ConstructMultiModelForest();
+    // Constructs the trees of the model as they are read and returns the rest of the model
+    json ReadModelAndConstructTrees(const std::string& modelPath) {
+        return ReadXGBoostModel(modelPath, [this](json& treeJSON) {
+            this->NewTree();
+            ConstructSingleTree(treeJSON);
+            this->EndTree();
+        });
+    }
     static constexpr double_t INITIAL_VALUE = 0;
 
 public:
@@ -31,11 +178,11 @@ public:
           GetMLIRType(FeatureIndexType(), context),
           GetMLIRType(NodeIndexType(), context),
           GetMLIRType(ReturnType(), context),
-          GetMLIRType(InputElementType(), context))
+          GetMLIRType(InputElementType(), context)),
+        m_modelPath(filename)
     {
-        std::ifstream fin(filename);
-        assert (fin);
-        fin >> m_json;
+        if (!std::ifstream(filename))
+            throw std::runtime_error("Could not open XGBoost model file " + filename);
     }
     
     XGBoostJSONParser(mlir::MLIRContext& context,
@@ -53,11 +200,11 @@ public:
           GetMLIRType(FeatureIndexType(), context),
           GetMLIRType(NodeIndexType(), context),
           GetMLIRType(ReturnType(), context),
-          GetMLIRType(InputElementType(), context))
+          GetMLIRType(InputElementType(), context)),
+        m_modelPath(filename)
     {
-        std::ifstream fin(filename);
-        assert (fin);
-        fin >> m_json;
+        if (!std::ifstream(filename))
+            throw std::runtime_error("Could not open XGBoost model file " + filename);
     }
 
     void ConstructForest() override;
@@ -91,43 +238,76 @@ LEARNER (Also includes an objective that is ignored here)
         }
     }
 */
+// The base score is saved as a prediction. Map it to the margin the tree predictions are added to (the 
+// inverse of the objective's output transformation). binary:logitraw outputs margins, but its base 
+// score is still a probability.
 inline double TransformBaseScore(const std::string& objectiveName, double val) {
-  if (objectiveName == "binary:logistic")
+  if (objectiveName == "binary:logistic" || objectiveName == "reg:logistic" || objectiveName == "binary:logitraw")
     return -log(1.0/val - 1.0);
-  else if (objectiveName == "reg:squarederror" || objectiveName=="multi:softmax")
+  else if (objectiveName == "count:poisson" || objectiveName == "reg:gamma" || objectiveName == "reg:tweedie" || 
+           objectiveName == "survival:cox")
+    return log(val);
+  else if (objectiveName == "reg:squarederror" || objectiveName=="multi:softmax" || objectiveName=="multi:softprob" ||
+           objectiveName == "rank:pairwise" || objectiveName == "rank:ndcg")
     return val;
-  else
-    assert(false && "Unknown objective type");
-  return val;
+  throw std::runtime_error("Unsupported XGBoost objective " + objectiveName);
 }
 
+// multi:softprob models predict the most likely class unless they are compiled to return all outputs 
+// (see CompilerOptions::returnAllOutputs), in which case they return the class probabilities.
 inline mlir::decisionforest::PredictionTransformation GetPredictionTransformType(const std::string& objectiveName) {
-  if (objectiveName == "binary:logistic")
+  if (objectiveName == "binary:logistic" || objectiveName == "reg:logistic")
     return mlir::decisionforest::PredictionTransformation::kSigmoid;
-  else if (objectiveName == "reg:squarederror")
+  else if (objectiveName == "reg:squarederror" || objectiveName == "binary:logitraw" || 
+           objectiveName == "rank:pairwise" || objectiveName == "rank:ndcg")
     return mlir::decisionforest::PredictionTransformation::kIdentity;
-  else if (objectiveName=="multi:softmax")
+  else if (objectiveName=="multi:softmax" || objectiveName=="multi:softprob")
     return mlir::decisionforest::PredictionTransformation::kSoftMax;
-  else
-    assert(false && "Unknown objective type");
-  return mlir::decisionforest::PredictionTransformation::kUnknown;
+  else if (objectiveName == "count:poisson" || objectiveName == "reg:gamma" || objectiveName == "reg:tweedie" || 
+           objectiveName == "survival:cox")
+    return mlir::decisionforest::PredictionTransformation::kExponential;
+  throw std::runtime_error("Unsupported XGBoost objective " + objectiveName);
 }
 
 template<typename ThresholdType, typename ReturnType, typename FeatureIndexType, typename NodeIndexType, typename InputElementType>
 void XGBoostJSONParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexType, InputElementType>::ConstructForest()
 {
-    auto& learnerJSON = m_json["learner"];
-    auto& featureNamesJSON = learnerJSON["feature_names"];
-    auto& featureTypesJSON = learnerJSON["feature_types"];
+    if (IsXGBoostMultiModelManifestPath(m_modelPath)) {
+        ConstructMultiModelForest();
+        return;
+    }
+    // Trees are constructed as they are read. Everything else is read once the whole model is parsed.
+    auto modelJSON = ReadModelAndConstructTrees(m_modelPath);
+    auto& learnerJSON = modelJSON["learner"];
     
     // Set the base score for current objective type
     auto baseScoreStr = learnerJSON["learner_model_param"]["base_score"].get<std::string>();
     auto baseScore = std::stod(baseScoreStr);
     auto objectiveName = learnerJSON["objective"]["name"].get<std::string>();
     this->SetInitialOffset(TransformBaseScore(objectiveName, baseScore));
-    this->SetNumberOfClasses(std::stoi(learnerJSON["learner_model_param"]["num_class"].get<std::string>()));
+    auto& learnerModelParamJSON = learnerJSON["learner_model_param"];
+    auto numClasses = std::stoi(learnerModelParamJSON["num_class"].get<std::string>());
+    // Models with several targets (and one output per tree) record the target of each tree in tree_info 
+    // just like classes are, so the targets are treated as classes. Older models don't write num_target.
+    if (learnerModelParamJSON.contains("num_target")) {
+        auto numTargets = std::stoi(learnerModelParamJSON["num_target"].get<std::string>());
+        if (numTargets > 1) {
+            if (numClasses != 0)
+                throw std::runtime_error("XGBoost models with several targets and classes are not supported");
+            numClasses = numTargets;
+        }
+    }
+    this->SetNumberOfClasses(numClasses);
     this->m_forest->SetPredictionTransformation(GetPredictionTransformType(objectiveName));
-    
+    AddFeatures(learnerJSON);
+    SetTreeClassIds(learnerJSON["gradient_booster"]);
+}
+
+template<typename ThresholdType, typename ReturnType, typename FeatureIndexType, typename NodeIndexType, typename InputElementType>
+void XGBoostJSONParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexType, InputElementType>::AddFeatures(json& learnerJSON)
+{
+    auto& featureNamesJSON = learnerJSON["feature_names"];
+    auto& featureTypesJSON = learnerJSON["feature_types"];
     // Assert is not valid since feature_names is not required. 
     // assert(featureNamesJSON.size() == featureTypesJSON.size());
     for (size_t i = 0; i<featureTypesJSON.size() ; ++i)
@@ -140,8 +320,58 @@ void XGBoostJSONParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexTyp
         auto featureType = featureTypesJSON[i].get<std::string>();
         this->AddFeature(name, featureType); //TODO hardcoded feature type
     }
+}
+
+template<typename ThresholdType, typename ReturnType, typename FeatureIndexType, typename NodeIndexType, typename InputElementType>
+void XGBoostJSONParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexType, InputElementType>::ConstructMultiModelForest()
+{
+    auto modelPaths = ReadXGBoostMultiModelManifest(m_modelPath);
+    std::vector<double> initialOffsets;
+    std::vector<mlir::decisionforest::PredictionTransformation> predictionTransforms;
+    json widestLearnerJSON;
+    std::vector<json> modelFeaturesJSON;
+    for (size_t modelIndex=0 ; modelIndex<modelPaths.size() ; ++modelIndex) {
+        auto firstTreeIndex = this->m_forest->NumTrees();
+        auto modelJSON = ReadModelAndConstructTrees(modelPaths[modelIndex]);
+        auto& learnerJSON = modelJSON["learner"];
+        auto& learnerModelParamJSON = learnerJSON["learner_model_param"];
+        auto numClasses = std::stoi(learnerModelParamJSON["num_class"].get<std::string>());
+        auto numTargets = learnerModelParamJSON.contains("num_target") ? std::stoi(learnerModelParamJSON["num_target"].get<std::string>()) : 1;
+        if (numClasses != 0 || numTargets > 1)
+            throw std::runtime_error("Only models with a single output can be compiled together (" + modelPaths[modelIndex] + 
+                                     " has several)");
 
-    ConstructTreesFromBooster(learnerJSON["gradient_booster"]);
+        auto baseScore = std::stod(learnerModelParamJSON["base_score"].get<std::string>());
+        auto objectiveName = learnerJSON["objective"]["name"].get<std::string>();
+        initialOffsets.push_back(TransformBaseScore(objectiveName, baseScore));
+        predictionTransforms.push_back(GetPredictionTransformType(objectiveName));
+        for (size_t treeIndex=firstTreeIndex ; treeIndex<this->m_forest->NumTrees() ; ++treeIndex)
+            this->m_forest->GetTree(treeIndex).SetClassId(static_cast<int32_t>(modelIndex));
+
+        json featuresJSON = json::object();
+        featuresJSON["feature_names"] = learnerJSON["feature_names"];
+        featuresJSON["feature_types"] = learnerJSON["feature_types"];
+        if (widestLearnerJSON.is_null() || featuresJSON["feature_types"].size() > widestLearnerJSON["feature_types"].size())
+            widestLearnerJSON = featuresJSON;
+        modelFeaturesJSON.push_back(featuresJSON);
+    }
+    // Every model reads its features from the start of the shared row. Names are only compared when both models have them.
+    auto& widestTypesJSON = widestLearnerJSON["feature_types"];
+    auto& widestNamesJSON = widestLearnerJSON["feature_names"];
+    for (size_t modelIndex=0 ; modelIndex<modelPaths.size() ; ++modelIndex) {
+        auto& typesJSON = modelFeaturesJSON[modelIndex]["feature_types"];
+        auto& namesJSON = modelFeaturesJSON[modelIndex]["feature_names"];
+        bool namesCompared = namesJSON.size() != 0 && widestNamesJSON.size() != 0;
+        for (size_t i=0 ; i<typesJSON.size() ; ++i) {
+            if (typesJSON[i] != widestTypesJSON[i] || (namesCompared && namesJSON[i] != widestNamesJSON[i]))
+                throw std::runtime_error("The features of " + modelPaths[modelIndex] + " must be a prefix of those of the model with the most features");
+        }
+    }
+    this->SetNumberOfClasses(static_cast<int32_t>(modelPaths.size()));
+    this->m_forest->SetPredictionTransformation(mlir::decisionforest::PredictionTransformation::kIdentity);
+    this->m_forest->SetOutputInitialOffsets(initialOffsets);
+    this->m_forest->SetOutputPredictionTransformations(predictionTransforms);
+    AddFeatures(widestLearnerJSON);
 }
 // We asumme the gradient booster is a gbtree
 /*
@@ -153,33 +383,31 @@ void XGBoostJSONParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexTyp
 // Name is a const string string "gbtree"
 
 template<typename ThresholdType, typename ReturnType, typename FeatureIndexType, typename NodeIndexType, typename InputElementType>
-void XGBoostJSONParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexType, InputElementType>::ConstructTreesFromBooster(json& boosterJSON)
+void XGBoostJSONParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexType, InputElementType>::SetTreeClassIds(json& boosterJSON)
 {
     auto& modelJSON = boosterJSON["model"];
     size_t numTrees = static_cast<size_t>(std::stoi(modelJSON["gbtree_model_param"]["num_trees"].get<std::string>()));
-    auto& treesJSON = modelJSON["trees"];
     auto& treeInfoJSON = modelJSON["tree_info"];
 
-    assert (numTrees == treesJSON.size());
+    // The trees themselves were dropped as they were constructed
+    assert (numTrees == modelJSON["trees"].size());
     assert (numTrees == treeInfoJSON.size());
+    assert (numTrees == this->m_forest->NumTrees());
 
-    int32_t treeIndex = 0;
-    for (auto& treeJSON : treesJSON)
+    for (size_t treeIndex = 0 ; treeIndex < numTrees ; ++treeIndex)
     {
-        this->NewTree();
-        ConstructSingleTree(treeJSON);
-        this->SetTreeClassId(treeInfoJSON[treeIndex++]);
-        this->EndTree();
+        auto classId = treeInfoJSON[treeIndex].get<int32_t>();
+        if (this->m_forest->IsMultiClassClassifier())
+            assert(classId < this->m_forest->GetNumClasses() && "ClassId should be lesser than number of classes for multi-class classifiers.");
+        this->m_forest->GetTree(treeIndex).SetClassId(classId);
     }
 }
 
 template<typename ThresholdType, typename ReturnType, typename FeatureIndexType, typename NodeIndexType, typename InputElementType>
 void XGBoostJSONParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexType, InputElementType>::ConstructSingleTree(json& treeJSON)
 {
-    // TODO what is "base_weights", "categories", "categories_nodes", 
-    // "categories_segments", "categories_sizes"?
+    // TODO what is "base_weights"?
     size_t numNodes = treeJSON["base_weights"].size();
-    // TODO ignoring "default_left"
     // auto treeID = treeJSON["id"].get<int>();
     
     auto& left_children = treeJSON["left_children"];
@@ -187,9 +415,21 @@ void XGBoostJSONParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexTyp
     auto& parents = treeJSON["parents"];
     auto& split_conditions = treeJSON["split_conditions"];
     auto& split_indices = treeJSON["split_indices"];
-    // auto& split_type = treeJSON["split_type"]; // 0 is Numerical and 1 is Categorical
+    // Older models write default_left as 0/1 rather than as booleans
+    auto& default_left = treeJSON["default_left"];
+    // 0 is Numerical and 1 is Categorical. Older models have no categorical splits and don't write these.
+    auto& split_type = treeJSON["split_type"];
+    // The categories of the k'th node in categories_nodes are categories[segments[k], segments[k]+sizes[k])
+    auto& categories = treeJSON["categories"];
+    auto& categories_nodes = treeJSON["categories_nodes"];
+    auto& categories_segments = treeJSON["categories_segments"];
+    auto& categories_sizes = treeJSON["categories_sizes"];
     auto num_features = std::stoi(treeJSON["tree_param"]["num_feature"].get<std::string>());
     auto num_nodes = static_cast<size_t>(std::stoi(treeJSON["tree_param"]["num_nodes"].get<std::string>()));
+    // Trees with a vector of values in each leaf (multi_strategy="multi_output_tree") are not supported
+    if (treeJSON["tree_param"].contains("size_leaf_vector") && 
+        std::stoi(treeJSON["tree_param"]["size_leaf_vector"].get<std::string>()) > 1)
+        throw std::runtime_error("XGBoost trees with vector leaves (multi_strategy=\"multi_output_tree\") are not supported");
     assert (numNodes == num_nodes);
     assert (left_children.size() == num_nodes);
     assert (left_children.size() == right_childen.size() && 
@@ -199,10 +439,46 @@ void XGBoostJSONParser<ThresholdType, ReturnType, FeatureIndexType, NodeIndexTyp
     std::vector<NodeIndexType> nodes;
     for (size_t i=0 ; i< num_nodes ; ++i)
     {
-        // assert (split_type[i].get<int>() == 0); // only numerical splits for now
         auto node = this->NewNode(split_conditions[i].get<ThresholdType>(), split_indices[i].get<FeatureIndexType>());
+        if (!default_left.is_null()) {
+            auto& defaultLeft = default_left[i];
+            this->SetNodeDefaultLeft(node, defaultLeft.is_boolean() ? defaultLeft.get<bool>() : defaultLeft.get<int>() != 0);
+        }
         nodes.push_back(node);
     }
+    if (!split_type.is_null() && split_type.size() != num_nodes)
+        throw std::runtime_error("XGBoost tree has " + std::to_string(split_type.size()) + " split types for " + 
+                                 std::to_string(num_nodes) + " nodes");
+    std::vector<bool> hasCategories(num_nodes, false);
+    if (!categories_nodes.is_null()) {
+        if (categories_nodes.size() != categories_segments.size() || categories_nodes.size() != categories_sizes.size())
+            throw std::runtime_error("XGBoost tree has mismatched categories_nodes, categories_segments and categories_sizes");
+        for (size_t k=0 ; k<categories_nodes.size() ; ++k) {
+            auto nodeIndex = categories_nodes[k].get<int64_t>();
+            if (nodeIndex < 0 || static_cast<size_t>(nodeIndex) >= num_nodes)
+                throw std::runtime_error("XGBoost tree lists categories for node " + std::to_string(nodeIndex) + " which doesn't exist");
+            if (!split_type.is_null() && split_type[nodeIndex].get<int>() != 1)
+                throw std::runtime_error("XGBoost tree lists categories for node " + std::to_string(nodeIndex) + " which isn't a categorical split");
+            auto segmentStart = categories_segments[k].get<int64_t>();
+            auto segmentSize = categories_sizes[k].get<int64_t>();
+            if (segmentStart < 0 || segmentSize < 0 || static_cast<size_t>(segmentStart + segmentSize) > categories.size())
+                throw std::runtime_error("XGBoost tree has categories of node " + std::to_string(nodeIndex) + " outside the categories array");
+            std::vector<int32_t> nodeCategories;
+            for (int64_t j=segmentStart ; j<segmentStart+segmentSize ; ++j)
+                nodeCategories.push_back(categories[j].get<int32_t>());
+            this->SetNodeCategoricalSplit(nodes[nodeIndex], nodeCategories);
+            hasCategories[nodeIndex] = true;
+        }
+    }
+    if (!split_type.is_null()) {
+        for (size_t i=0 ; i<num_nodes ; ++i) {
+            auto splitType = split_type[i].get<int>();
+            if (splitType != 0 && splitType != 1)
+                throw std::runtime_error("Unknown split type " + std::to_string(splitType) + " in XGBoost tree");
+            if (splitType == 1 && !hasCategories[i])
+                throw std::runtime_error("Categorical split at node " + std::to_string(i) + " of XGBoost tree has no categories");
+        }
+    }
     for (size_t i=0 ; i< num_nodes ; ++i)
     {
         auto leftChildIndex = left_children[i].get<int>();
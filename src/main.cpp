@@ -69,6 +69,24 @@ bool RunXGBoostParallelBenchmarksIfNeeded(int argc, char *argv[]) {
   return false;
 }
 
+bool RunXGBoostOptimizationLevelBenchmarksIfNeeded(int argc, char *argv[]) {
+  for (int32_t i=0 ; i<argc ; ++i)
+    if (std::string(argv[i]).find(std::string("--xgboostOptLevelBench")) != std::string::npos) {
+      TreeBeard::test::RunXGBoostOptimizationLevelBenchmarks();
+      return true;
+    }
+  return false;
+}
+
+bool RunXGBoostFeatureLocalityBenchmarksIfNeeded(int argc, char *argv[]) {
+  for (int32_t i=0 ; i<argc ; ++i)
+    if (std::string(argv[i]).find(std::string("--xgboostFeatureLocalityBench")) != std::string::npos) {
+      TreeBeard::test::RunXGBoostFeatureLocalityBenchmarks();
+      return true;
+    }
+  return false;
+}
+
 bool RunSanityTestsIfNeeded(int argc, char *argv[]) {
   for (int32_t i=0 ; i<argc ; ++i)
     if (std::string(argv[i]).find(std::string("--sanityTests")) != std::string::npos) {
@@ -181,8 +199,8 @@ bool DumpLLVMIfNeeded(int argc, char *argv[]) {
   if (!compilerConfigJSONFile.empty()) {
     TreeBeard::CompilerOptions options(compilerConfigJSONFile);
     tbContext.options = options;
-    tbContext.representation = mlir::decisionforest::ConstructRepresentation();
-    tbContext.serializer = mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONFile);
+    tbContext.representation = mlir::decisionforest::ConstructRepresentation(options.sparseRepresentation);
+    tbContext.serializer = mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONFile, options.sparseRepresentation);
     tbContext.modelGlobalsJSONPath = modelGlobalsJSONFile;
     tbContext.forestConstructor = nullptr;  /*TODO_ForestCreator*/ 
   }
@@ -195,8 +213,8 @@ bool DumpLLVMIfNeeded(int argc, char *argv[]) {
         invertLoops ? &scheduleManipulator : nullptr);
 
     tbContext.options = options;
-    tbContext.representation = mlir::decisionforest::ConstructRepresentation();
-    tbContext.serializer = mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONFile);
+    tbContext.representation = mlir::decisionforest::ConstructRepresentation(options.sparseRepresentation);
+    tbContext.serializer = mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONFile, options.sparseRepresentation);
     tbContext.modelGlobalsJSONPath = modelGlobalsJSONFile;
     tbContext.forestConstructor = nullptr;  /*TODO_ForestCreator*/ 
   }
@@ -347,8 +365,14 @@ bool ComputeProbabilityProfileIfNeeded(int argc, char *argv[]) {
 
   std::string modelName, csvPath, outputCSVPath;
   int32_t numRows = -1;
+  bool compiled = false;
   for (int32_t i=0 ; i<argc ; ) {
-    if (ContainsString(argv[i], "-model")) {
+    if (ContainsString(argv[i], "--compiled")) {
+      // Count leaf hits in a JIT compiled model rather than in the interpreter
+      compiled = true;
+      ++i;
+    }
+    else if (ContainsString(argv[i], "-model")) {
       assert (modelName.empty());
       assert (i+1 < argc);
       modelName = argv[i+1];
@@ -373,7 +397,12 @@ bool ComputeProbabilityProfileIfNeeded(int argc, char *argv[]) {
       ++i;
   }
   assert(!modelName.empty() && !csvPath.empty() && !outputCSVPath.empty());
-  TreeBeard::Profile::ComputeForestProbabilityProfileForXGBoostModel(modelName, csvPath, outputCSVPath, numRows);
+  if (compiled) {
+    auto modelJSONPath = TreeBeard::test::GetTreeBeardRepoPath() + "/xgb_models/" + modelName + "_xgb_model_save.json";
+    TreeBeard::Profile::ComputeForestProbabilityProfileCompiled(modelJSONPath, csvPath, outputCSVPath, numRows);
+  }
+  else
+    TreeBeard::Profile::ComputeForestProbabilityProfileForXGBoostModel(modelName, csvPath, outputCSVPath, numRows);
   return true;
 }
 
@@ -387,6 +416,10 @@ int main(int argc, char *argv[]) {
     return 0;
   else if (RunXGBoostParallelBenchmarksIfNeeded(argc, argv))
     return 0;
+  else if (RunXGBoostOptimizationLevelBenchmarksIfNeeded(argc, argv))
+    return 0;
+  else if (RunXGBoostFeatureLocalityBenchmarksIfNeeded(argc, argv))
+    return 0;
   else if (DumpLLVMIfNeeded(argc, argv))
     return 0;
   else if (RunInferenceFromSO(argc, argv))
@@ -51,17 +51,26 @@ namespace decisionforest
       return index;
     }
 
+    // Returns the predicate that is true exactly when the given one is false (including for NaNs)
     mlir::arith::CmpFPredicate negateComparisonPredicate(mlir::arith::CmpFPredicateAttr cmpPredAttr) {
       auto cmpPred = cmpPredAttr.getValue();
       switch (cmpPred)
       {
         case arith::CmpFPredicate::ULT:
-          return arith::CmpFPredicate::UGE;
+          return arith::CmpFPredicate::OGE;
         case arith::CmpFPredicate::UGE:
-          return arith::CmpFPredicate::ULT;
+          return arith::CmpFPredicate::OLT;
         case arith::CmpFPredicate::UGT:
-          return arith::CmpFPredicate::ULE;
+          return arith::CmpFPredicate::OLE;
         case arith::CmpFPredicate::ULE:
+          return arith::CmpFPredicate::OGT;
+        case arith::CmpFPredicate::OLT:
+          return arith::CmpFPredicate::UGE;
+        case arith::CmpFPredicate::OGE:
+          return arith::CmpFPredicate::ULT;
+        case arith::CmpFPredicate::OGT:
+          return arith::CmpFPredicate::ULE;
+        case arith::CmpFPredicate::OLE:
           return arith::CmpFPredicate::UGT;
         default:
           assert(false && "Unknown comparison predicate");
@@ -69,6 +78,125 @@ namespace decisionforest
       }
     }
 
+    // Creates a constant of an integer or integer vector type
+    Value CreateIntegerConstant(int64_t value, Type type, ConversionPatternRewriter &rewriter, Location location) {
+      auto vectorType = type.dyn_cast<VectorType>();
+      auto elementType = vectorType ? vectorType.getElementType() : type;
+      Value constant = rewriter.create<arith::ConstantIntOp>(location, value, elementType);
+      if (vectorType)
+        constant = rewriter.create<vector::BroadcastOp>(location, vectorType, constant);
+      return constant;
+    }
+
+    // Undo EncodeDefaultLeftFeatureIndex. Nodes that send missing values left store -(featureIndex+2)
+    // and all other values are stored as is, so the feature index is max(storedIndex, -2-storedIndex).
+    Value DecodeDefaultLeftFeatureIndex(Value storedIndex, ConversionPatternRewriter &rewriter, Location location) {
+      auto minusTwo = CreateIntegerConstant(-2, storedIndex.getType(), rewriter, location);
+      auto negatedIndex = rewriter.create<arith::SubIOp>(location, minusTwo, storedIndex);
+      return rewriter.create<arith::MaxSIOp>(location, storedIndex, static_cast<Value>(negatedIndex));
+    }
+
+    // Creates a constant of a floating point or floating point vector type
+    Value CreateFloatConstant(double value, Type type, ConversionPatternRewriter &rewriter, Location location) {
+      auto vectorType = type.dyn_cast<VectorType>();
+      auto elementType = (vectorType ? vectorType.getElementType() : type).cast<FloatType>();
+      Value constant;
+      if (elementType.isF64())
+        constant = rewriter.create<arith::ConstantFloatOp>(location, llvm::APFloat(value), elementType);
+      else if (elementType.isF32())
+        constant = rewriter.create<arith::ConstantFloatOp>(location, llvm::APFloat((float)value), elementType);
+      else
+        assert(false && "Unsupported floating point type");
+      if (vectorType)
+        constant = rewriter.create<vector::BroadcastOp>(location, vectorType, constant);
+      return constant;
+    }
+
+    // Loads memref[indices] from a 1D memref. If indices is a vector, the elements are gathered into a vector.
+    Value LoadElements(Value memref, Value indices, ConversionPatternRewriter &rewriter, Location location) {
+      auto elementType = memref.getType().cast<MemRefType>().getElementType();
+      auto indicesVectorType = indices.getType().dyn_cast<VectorType>();
+      if (!indicesVectorType)
+        return rewriter.create<memref::LoadOp>(location, memref, ValueRange{indices});
+      auto resultType = VectorType::get(indicesVectorType.getShape(), elementType);
+      auto maskType = VectorType::get(indicesVectorType.getShape(), rewriter.getI1Type());
+      auto mask = CreateIntegerConstant(1, maskType, rewriter, location);
+      auto passThru = CreateIntegerConstant(0, resultType, rewriter, location);
+      auto zeroIndex = rewriter.create<arith::ConstantIndexOp>(location, 0);
+      return rewriter.create<vector::GatherOp>(location, resultType, memref, ValueRange{zeroIndex}, indices, mask, passThru);
+    }
+
+    // Gathers row[0, indices[i]] into a vector. vector.gather needs the innermost dimension of the row
+    // to have a unit stride, so rows of strided and column major inputs are read one element at a time.
+    Value GatherFeatures(Value rowMemref, Value indices, Value mask, Value passThru, ConversionPatternRewriter &rewriter, Location location) {
+      auto rowMemrefType = rowMemref.getType().cast<MemRefType>();
+      auto featuresVectorType = passThru.getType().cast<VectorType>();
+      auto zeroIndex = rewriter.create<arith::ConstantIndexOp>(location, 0);
+      if (isLastMemrefDimUnitStride(rowMemrefType))
+        return rewriter.create<vector::GatherOp>(location, featuresVectorType, rowMemref, ValueRange{zeroIndex, zeroIndex},
+                                                 indices, mask, passThru);
+      Value features = passThru;
+      for (int64_t i=0 ; i<featuresVectorType.getNumElements() ; ++i) {
+        auto position = rewriter.create<arith::ConstantIndexOp>(location, i);
+        auto featureIndex = rewriter.create<vector::ExtractElementOp>(location, indices, position);
+        auto feature = rewriter.create<memref::LoadOp>(location, rowMemref, ValueRange{zeroIndex, featureIndex});
+        features = rewriter.create<vector::InsertElementOp>(location, feature, features, position);
+      }
+      return features;
+    }
+
+    // Returns true if the feature value is one of the categories in the set that starts at offset threshold in the 
+    // categorical bitset table (see DecisionForest::AddCategoricalBitset). Works element wise on vectors. The threshold
+    // of non categorical nodes isn't an offset, so they test the first set and their result must be ignored.
+    Value GenerateCategoryMembershipTest(Value bitsetsMemref, Value isCategorical, Value threshold, Value feature,
+                                         ConversionPatternRewriter &rewriter, Location location) {
+      auto vectorType = threshold.getType().dyn_cast<VectorType>();
+      auto getType = [&](Type elementType) -> Type {
+        return vectorType ? VectorType::get(vectorType.getShape(), elementType) : elementType;
+      };
+      auto i32Type = getType(rewriter.getI32Type());
+      auto indexType = getType(rewriter.getIndexType());
+      auto featureType = feature.getType();
+
+      Value thresholdAsInt = rewriter.create<arith::FPToSIOp>(location, i32Type, threshold);
+      Value offset = rewriter.create<arith::SelectOp>(location, isCategorical, thresholdAsInt,
+                                                      CreateIntegerConstant(0, i32Type, rewriter, location));
+      Value offsetIndex = rewriter.create<arith::IndexCastOp>(location, indexType, offset);
+      Value numWords = LoadElements(bitsetsMemref, offsetIndex, rewriter, location);
+
+      // Negative, NaN and values past the end of the set aren't in it. Other values are truncated to their
+      // category, which must match IsInCategoricalBitset.
+      auto zeroFeature = CreateFloatConstant(0.0, featureType, rewriter, location);
+      Value numCategories = rewriter.create<arith::ShLIOp>(location, numWords, CreateIntegerConstant(5, i32Type, rewriter, location));
+      Value numCategoriesFP = rewriter.create<arith::SIToFPOp>(location, featureType, numCategories);
+      Value isNonNegative = rewriter.create<arith::CmpFOp>(location, arith::CmpFPredicate::OGE, feature, zeroFeature);
+      Value isBelowEnd = rewriter.create<arith::CmpFOp>(location, arith::CmpFPredicate::OLT, feature, numCategoriesFP);
+      Value inRange = rewriter.create<arith::AndIOp>(location, isNonNegative, isBelowEnd);
+
+      Value safeFeature = rewriter.create<arith::SelectOp>(location, inRange, feature, zeroFeature);
+      Value category = rewriter.create<arith::FPToSIOp>(location, i32Type, safeFeature);
+      Value wordNumber = rewriter.create<arith::ShRUIOp>(location, category, CreateIntegerConstant(5, i32Type, rewriter, location));
+      Value wordOffset = rewriter.create<arith::AddIOp>(location, offset, CreateIntegerConstant(1, i32Type, rewriter, location));
+      wordOffset = rewriter.create<arith::AddIOp>(location, wordOffset, wordNumber);
+      Value wordIndex = rewriter.create<arith::IndexCastOp>(location, indexType, wordOffset);
+      Value word = LoadElements(bitsetsMemref, wordIndex, rewriter, location);
+
+      Value bitNumber = rewriter.create<arith::AndIOp>(location, category, CreateIntegerConstant(31, i32Type, rewriter, location));
+      Value shiftedWord = rewriter.create<arith::ShRUIOp>(location, word, bitNumber);
+      Value bit = rewriter.create<arith::AndIOp>(location, shiftedWord, CreateIntegerConstant(1, i32Type, rewriter, location));
+      Value isBitSet = rewriter.create<arith::CmpIOp>(location, arith::CmpIPredicate::ne, bit, 
+                                                      CreateIntegerConstant(0, i32Type, rewriter, location));
+      return rewriter.create<arith::AndIOp>(location, inRange, isBitSet);
+    }
+
+    // Returns true for nodes (or lanes) that split on a categorical feature
+    Value GenerateIsCategoricalFeature(Value categoricalFeaturesMemref, Value featureIndex, 
+                                       ConversionPatternRewriter &rewriter, Location location) {
+      Value isCategorical = LoadElements(categoricalFeaturesMemref, featureIndex, rewriter, location);
+      return rewriter.create<arith::CmpIOp>(location, arith::CmpIPredicate::ne, isCategorical,
+                                            CreateIntegerConstant(0, isCategorical.getType(), rewriter, location));
+    }
+
 // ===---------------------------------------------------=== //
 // ScalarTraverseTileCodeGenerator Methods
 // ===---------------------------------------------------=== //
@@ -130,7 +258,15 @@ namespace decisionforest
         case kLoadFeature:
           {
             auto rowMemrefType = m_rowMemref.getType().cast<MemRefType>();
-            auto rowIndex = rewriter.create<arith::IndexCastOp>(location, rewriter.getIndexType(), static_cast<Value>(m_loadFeatureIndexOp));
+            Value featureIndex = m_loadFeatureIndexOp;
+            if (m_representation->RouteMissingValuesPerNode()) {
+              auto zeroConst = CreateIntegerConstant(0, featureIndex.getType(), rewriter, location);
+              m_isDefaultRight = rewriter.create<arith::CmpIOp>(location, arith::CmpIPredicate::sge, featureIndex, zeroConst);
+              featureIndex = DecodeDefaultLeftFeatureIndex(featureIndex, rewriter, location);
+            }
+            auto rowIndex = rewriter.create<arith::IndexCastOp>(location, rewriter.getIndexType(), featureIndex);
+            if (m_representation->HasCategoricalSplits())
+              m_isCategorical = GenerateIsCategoricalFeature(m_representation->GetCategoricalFeaturesMemref(m_tree), rowIndex, rewriter, location);
             auto zeroIndex = rewriter.create<arith::ConstantIndexOp>(location, 0);
             m_loadFeatureOp = rewriter.create<memref::LoadOp>(
                                                               location,
@@ -146,11 +282,23 @@ namespace decisionforest
         case kCompare:
           {
             // TODO we need a cast here to make sure the threshold and the row element are the same type. The op expects both operands to be the same type.
-            auto comparison = rewriter.create<arith::CmpFOp>(
+            Value comparison = rewriter.create<arith::CmpFOp>(
                 location,
                 negateComparisonPredicate(m_cmpPredicateAttr),
                 static_cast<Value>(m_loadFeatureOp),
                 static_cast<Value>(m_loadThresholdOp));
+            if (m_isCategorical) {
+              // Rows whose feature value is in the node's category set go right
+              auto isInSet = GenerateCategoryMembershipTest(m_representation->GetCategoricalBitsetsMemref(m_tree), m_isCategorical,
+                                                            m_loadThresholdOp, m_loadFeatureOp, rewriter, location);
+              comparison = rewriter.create<arith::SelectOp>(location, m_isCategorical, isInSet, comparison);
+            }
+            if (m_isDefaultRight) {
+              // Missing values go in the node's default direction rather than where the comparison sends them
+              auto isMissing = rewriter.create<arith::CmpFOp>(location, arith::CmpFPredicate::UNO,
+                                                              static_cast<Value>(m_loadFeatureOp), static_cast<Value>(m_loadFeatureOp));
+              comparison = rewriter.create<arith::SelectOp>(location, isMissing, m_isDefaultRight, comparison);
+            }
             
             // auto threadIdx = GetThreadID(traverseTileOpPtr);
             // rewriter.create<gpu::PrintfOp>(location, 
@@ -300,9 +448,15 @@ namespace decisionforest
           {
             auto rowMemrefType = m_rowMemref.getType().cast<MemRefType>();
             auto vectorIndexType = VectorType::get({ m_tileSize }, rewriter.getIndexType());
-            auto rowIndex = rewriter.create<arith::IndexCastOp>(location, vectorIndexType, static_cast<Value>(m_loadFeatureIndexOp));
-            auto zeroIndex = rewriter.create<arith::ConstantIndexOp>(location, 0);
-            // auto zeroIndexVector = rewriter.create<vector::BroadcastOp>(location, vectorIndexType, zeroIndex);
+            Value featureIndices = m_loadFeatureIndexOp;
+            if (m_representation->RouteMissingValuesPerNode()) {
+              auto zeroVector = CreateIntegerConstant(0, featureIndices.getType(), rewriter, location);
+              m_isDefaultLeft = rewriter.create<arith::CmpIOp>(location, arith::CmpIPredicate::slt, featureIndices, zeroVector);
+              featureIndices = DecodeDefaultLeftFeatureIndex(featureIndices, rewriter, location);
+            }
+            auto rowIndex = rewriter.create<arith::IndexCastOp>(location, vectorIndexType, featureIndices);
+            if (m_representation->HasCategoricalSplits())
+              m_isCategorical = GenerateIsCategoricalFeature(m_representation->GetCategoricalFeaturesMemref(m_tree), rowIndex, rewriter, location);
 
             auto featuresVectorType = VectorType::get({ m_tileSize }, rowMemrefType.getElementType());
             auto oneI1Const = rewriter.create<arith::ConstantIntOp>(location, 1, rewriter.getI1Type());
@@ -318,14 +472,7 @@ namespace decisionforest
               assert(false && "Unsupported floating point type");
             auto zeroPassThruVector = rewriter.create<vector::BroadcastOp>(location, featuresVectorType, zeroPassThruConst);
             
-            m_features = rewriter.create<vector::GatherOp>(
-              location,
-              featuresVectorType,
-              m_rowMemref,
-              ValueRange({static_cast<Value>(zeroIndex), static_cast<Value>(zeroIndex)}),
-              rowIndex,
-              mask,
-              zeroPassThruVector);
+            m_features = GatherFeatures(m_rowMemref, rowIndex, mask, zeroPassThruVector, rewriter, location);
 
               if (decisionforest::InsertDebugHelpers) {
                 Value vectorVal = m_features;
@@ -347,11 +494,25 @@ namespace decisionforest
           break;  
         case kCompare:
           {
-            auto comparison = rewriter.create<
+            Value comparison = rewriter.create<
                                         arith::CmpFOp>(location,
                                                        m_cmpPredicateAttr.getValue(),
                                                        static_cast<Value>(m_features),
                                                        static_cast<Value>(m_loadThresholdOp));
+            if (m_isCategorical) {
+              // Lanes whose feature value is in their node's category set go right
+              auto isInSet = GenerateCategoryMembershipTest(m_representation->GetCategoricalBitsetsMemref(m_tree), m_isCategorical,
+                                                            m_loadThresholdOp, m_features, rewriter, location);
+              auto allTrue = CreateIntegerConstant(1, isInSet.getType(), rewriter, location);
+              auto isNotInSet = rewriter.create<arith::XOrIOp>(location, isInSet, allTrue);
+              comparison = rewriter.create<arith::SelectOp>(location, m_isCategorical, isNotInSet, comparison);
+            }
+            if (m_isDefaultLeft) {
+              // Lanes with missing values go in their node's default direction
+              auto isMissing = rewriter.create<arith::CmpFOp>(location, arith::CmpFPredicate::UNO,
+                                                              static_cast<Value>(m_features), static_cast<Value>(m_features));
+              comparison = rewriter.create<arith::SelectOp>(location, isMissing, m_isDefaultLeft, comparison);
+            }
             if (decisionforest::UseBitcastForComparisonOutcome)
               m_comparisonIndex = ReduceComparisonResultVectorToInt_Bitcast(comparison, m_tileSize, rewriter, location);
             else
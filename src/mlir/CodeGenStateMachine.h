@@ -90,6 +90,10 @@ class ScalarTraverseTileCodeGenerator : public ICodeGeneratorStateMachine {
     decisionforest::LoadTileFeatureIndicesOp m_loadFeatureIndexOp;
     memref::LoadOp m_loadFeatureOp;
     arith::ExtUIOp m_comparisonUnsigned;
+    // Only set when missing values are routed per node
+    Value m_isDefaultRight;
+    // Only set when the forest has categorical splits
+    Value m_isCategorical;
     Value m_result;
     std::vector<mlir::Value> m_extraLoads;
     Value m_tree;
@@ -123,7 +127,11 @@ class VectorTraverseTileCodeGenerator : public ICodeGeneratorStateMachine {
     decisionforest::LoadTileFeatureIndicesOp m_loadFeatureIndexOp;
     arith::IndexCastOp m_loadTileShapeIndexOp;
     arith::IndexCastOp m_leafBitMask;
-    vector::GatherOp m_features;
+    Value m_features;
+    // Only set when missing values are routed per node
+    Value m_isDefaultLeft;
+    // Only set when the forest has categorical splits
+    Value m_isCategorical;
     Value m_comparisonIndex;
     Value m_result;
     std::vector<mlir::Value> m_extraLoads;
@@ -125,9 +125,6 @@ public:
     void print(mlir::DialectAsmPrinter &printer) override;
 };
 
-// struct CategoricalNodeTypeStorage : public TypeStorage, IDecisionForestTypePrintInterface {
-// };
-
 class NodeType : public Type::TypeBase<NodeType, mlir::Type, TypeStorage>
 {
 public:
@@ -168,10 +165,8 @@ public:
     void print(mlir::DialectAsmPrinter &printer) override { getImpl()->print(printer); }
 };
 
-
-// class CategoricalNodeType : public mlir::Type::TypeBase<CategoricalNodeType, NodeType,
-//                                                         CategoricalNodeTypeStorage> {
-// };                
+// There is no separate type for categorical nodes. They have the same layout as numerical nodes with the
+// threshold holding the offset of the node's category set in the forest's categorical bitset table.
 
 //===----------------------------------------------------------------------===//
 // Tree Type
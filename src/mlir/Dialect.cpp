@@ -17,8 +17,8 @@ bool mlir::decisionforest::PrintVectors = false;
 bool mlir::decisionforest::EnablePerfNotificationListener = false;
 
 bool mlir::decisionforest::UseBitcastForComparisonOutcome = true;
-bool mlir::decisionforest::UseSparseTreeRepresentation = false;
-bool mlir::decisionforest::PeeledCodeGenForProbabiltyBasedTiling = false;
+std::atomic<bool> mlir::decisionforest::UseSparseTreeRepresentation(false);
+std::atomic<bool> mlir::decisionforest::PeeledCodeGenForProbabiltyBasedTiling(false);
 
 void TreeTypeStorage::print(mlir::DialectAsmPrinter &printer) {
     printer << "TreeType(returnType:" << m_resultType 
@@ -1,6 +1,9 @@
 #ifndef _DIALECT_H_
 #define _DIALECT_H_
+#include <atomic>
 #include <optional>
+#include <functional>
+#include <string>
 
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/BuiltinTypes.h"
@@ -10,6 +13,7 @@
 #include "mlir/Interfaces/CastInterfaces.h"
 #include "mlir/Interfaces/SideEffectInterfaces.h"
 #include "mlir/IR/DialectImplementation.h"
+#include "llvm/Support/Error.h"
 #include "DecisionTreeAttributes.h"
 #include "DecisionTreeTypes.h"
 #include "MemrefTypes.h"
@@ -22,6 +26,11 @@
 
 #define OMP_SUPPORT
 
+namespace llvm
+{
+class Module;
+}
+
 namespace mlir
 {
 
@@ -41,8 +50,12 @@ extern bool EnablePerfNotificationListener;
 
 // Compiler configuration
 extern bool UseBitcastForComparisonOutcome;
-extern bool UseSparseTreeRepresentation;
-extern bool PeeledCodeGenForProbabiltyBasedTiling;
+// Process wide defaults of CompilerOptions::sparseRepresentation and 
+// CompilerOptions::peeledCodeGenForProbabilityBasedTiling. They are only read when CompilerOptions are 
+// constructed (and by the overloads of ConstructRepresentation and ConstructModelSerializer that don't take 
+// the flag), so changing them doesn't affect compilations that are already in progress.
+extern std::atomic<bool> UseSparseTreeRepresentation;
+extern std::atomic<bool> PeeledCodeGenForProbabiltyBasedTiling;
 
 void populateDebugOpLoweringPatterns(RewritePatternSet& patterns, LLVMTypeConverter& typeConverter);
 
@@ -51,13 +64,36 @@ void LowerEnsembleToMemrefs(mlir::MLIRContext& context, mlir::ModuleOp module, s
 void ConvertNodeTypeToIndexType(mlir::MLIRContext& context, mlir::ModuleOp module);
 void LowerToLLVM(mlir::MLIRContext& context, mlir::ModuleOp module, std::shared_ptr<IRepresentation> representation);
 int dumpLLVMIR(mlir::ModuleOp module, bool dumpAsm = false);
-int dumpLLVMIRToFile(mlir::ModuleOp module, const std::string& filename);
+
+// Options used when the lowered LLVM module is optimized and compiled to machine code.
+struct LLVMCodeGenOptions {
+  // LLVM optimization level (0-3). At level 0, the LLVM IR is not optimized.
+  int32_t optLevel = 0;
+  // Target CPU and feature string (e.g. "skylake-avx512", "+avx2,+fma"). "host" uses
+  // the CPU (or features) of the machine we're compiling on. Empty strings leave 
+  // the default target unchanged.
+  std::string targetCPU = "";
+  std::string targetFeatures = "";
+
+  // True if the module should be compiled as is, without running any LLVM passes
+  bool IsDefault() const { return optLevel == 0 && targetCPU.empty() && targetFeatures.empty(); }
+};
+
+std::function<llvm::Error(llvm::Module*)> MakeLLVMOptimizingTransformer(const LLVMCodeGenOptions& codeGenOptions);
+int dumpLLVMIRToFile(mlir::ModuleOp module, const std::string& filename, 
+                     const LLVMCodeGenOptions& codeGenOptions = LLVMCodeGenOptions());
 
 // Optimizing passes
 void DoUniformTiling(mlir::MLIRContext& context, mlir::ModuleOp module, int32_t tileSize, int32_t tileShapeBitWidth, bool makeAllLeavesSameDepth);
-void DoProbabilityBasedTiling(mlir::MLIRContext& context, mlir::ModuleOp module, int32_t tileSize, int32_t tileShapeBitWidth);
-void DoHybridTiling(mlir::MLIRContext& context, mlir::ModuleOp module, int32_t tileSize, int32_t tileShapeBitWidth);
+void DoProbabilityBasedTiling(mlir::MLIRContext& context, mlir::ModuleOp module, int32_t tileSize, int32_t tileShapeBitWidth,
+                              bool peeledCodeGen=PeeledCodeGenForProbabiltyBasedTiling);
+void DoHybridTiling(mlir::MLIRContext& context, mlir::ModuleOp module, int32_t tileSize, int32_t tileShapeBitWidth,
+                    bool peeledCodeGen=PeeledCodeGenForProbabiltyBasedTiling);
 void DoReorderTreesByDepth(mlir::MLIRContext& context, mlir::ModuleOp module, int32_t pipelineSize=-1, int32_t numCores=-1);
+void DoReorderTreesByContribution(mlir::MLIRContext& context, mlir::ModuleOp module);
+void DoGroupTreesByFeatures(mlir::MLIRContext& context, mlir::ModuleOp module, int32_t batchTileSize, int32_t inputElementBitWidth);
+// The groups DoGroupTreesByFeatures walks, as lists of tree indices in the order they are walked
+std::vector<std::vector<int64_t>> GroupTreesByFeatures(DecisionForest& forest, int32_t batchTileSize, int32_t inputElementBitWidth);
 
 #ifdef TREEBEARD_GPU_SUPPORT
 
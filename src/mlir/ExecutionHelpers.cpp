@@ -4,11 +4,17 @@
 #include <climits>
 #include <dlfcn.h>
 #include <set>
+#include <vector>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
 #include "ExecutionHelpers.h"
 #include "Dialect.h"
 #include "Logger.h"
 #include "TreebeardContext.h"
 #include "TiledTree.h"
+#include "PerfCounters.h"
 
 namespace 
 {
@@ -30,6 +36,23 @@ bool FileExists(const std::string& filename) {
   return fin.good();
 }
 
+// Shared libraries that JIT compiled code may call into
+std::vector<std::string> GetJITSharedLibraryPaths() {
+  std::vector<std::string> libraryPaths;
+  if (mlir::decisionforest::InsertDebugHelpers) {
+    // std::cout << "Calculated debug SO path : " << debugSOPath << std::endl;
+    libraryPaths.push_back(GetDebugSOPath());
+  }
+#ifdef OMP_SUPPORT
+  std::string libompPath = std::string(LLVM_LIB_DIR) + std::string("lib/libomp.so");
+  if (!FileExists(libompPath)) {
+    libompPath = "/usr/lib/llvm-10/lib/libomp.so";
+  }
+  libraryPaths.push_back(libompPath);
+#endif
+  return libraryPaths;
+}
+
 }
 
 namespace mlir
@@ -51,16 +74,222 @@ InferenceRunnerBase::InferenceRunnerBase(std::shared_ptr<IModelSerializer> seria
 void InferenceRunnerBase::InitIntegerField(const std::string& functionName, int32_t& field) {
   using GetFunc_t = int32_t(*)();
   auto get = reinterpret_cast<GetFunc_t>(GetFunctionAddress(functionName));
+  if (!get)
+    throw std::runtime_error("The model doesn't define " + functionName + " (it wasn't compiled by Treebeard)");
   field = get();
 }
 
+void InferenceRunnerBase::InitIntegerField(const std::string& functionName, int32_t& field, int32_t defaultValue) {
+  using GetFunc_t = int32_t(*)();
+  auto get = reinterpret_cast<GetFunc_t>(GetFunctionAddress(functionName));
+  field = get ? get() : defaultValue;
+}
+
 void InferenceRunnerBase::Init() {
   m_serializer->InitializeBuffers(this);
   m_inferenceFuncPtr = GetFunctionAddress("Prediction_Function");
+  if (!m_inferenceFuncPtr)
+    throw std::runtime_error("The model doesn't define Prediction_Function (it wasn't compiled by Treebeard)");
   InitIntegerField("GetBatchSize", m_batchSize);
   InitIntegerField("GetRowSize", m_rowSize);
   InitIntegerField("GetInputTypeBitWidth", m_inputElementBitWidth);
   InitIntegerField("GetReturnTypeBitWidth", m_returnTypeBitWidth);
+  // Models compiled by an older Treebeard don't have these getters. They run full batches of dense rows
+  // through every tree and write one value per row.
+  InitIntegerField("GetDynamicBatch", m_dynamicBatch, 0);
+  InitIntegerField("GetInputLayout", m_inputLayout, static_cast<int32_t>(InputLayout::kRowMajor));
+  InitIntegerField("GetEarlyExit", m_earlyExit, 0);
+  InitIntegerField("GetNumberOfOutputs", m_numOutputs, 1);
+  InitIntegerField("GetNumberOfTrees", m_numTrees, -1);
+  InitIntegerField("GetProfileLeafHits", m_profileLeafHits, 0);
+  assert ((m_numOutputs == 1 || !SerializerHasCustomPredictionMethod()) && "Custom prediction methods return one value per row");
+  if (IsEarlyExitEnabled()) {
+    using GetStatisticsFunc_t = Memref<int64_t, 1>(*)();
+    auto getStatistics = reinterpret_cast<GetStatisticsFunc_t>(GetFunctionAddress("Get_earlyExitStatistics"));
+    if (!getStatistics)
+      throw std::runtime_error("The model is compiled with early exit but doesn't define Get_earlyExitStatistics");
+    m_earlyExitStatistics = getStatistics().alignedPtr;
+  }
+  if (IsLeafHitProfilingEnabled()) {
+    using GetLeafHitCountsFunc_t = Memref<int64_t, 1>(*)();
+    auto getLeafHitCounts = reinterpret_cast<GetLeafHitCountsFunc_t>(GetFunctionAddress("Get_leafHitCounts"));
+    if (!getLeafHitCounts)
+      throw std::runtime_error("The model is compiled to count leaf hits but doesn't define Get_leafHitCounts");
+    m_leafHitCounts = getLeafHitCounts();
+  }
+}
+
+void InferenceRunnerBase::ResetEarlyExitStatistics() {
+  if (m_earlyExitStatistics)
+    m_earlyExitStatistics[0] = m_earlyExitStatistics[1] = 0;
+}
+
+void InferenceRunnerBase::ResetLeafHitCounts() {
+  if (m_leafHitCounts.alignedPtr)
+    std::fill_n(m_leafHitCounts.alignedPtr + m_leafHitCounts.offset, m_leafHitCounts.lengths[0], int64_t(0));
+}
+
+int32_t InferenceRunnerBase::RunInferenceOnPartialBatch(void *input, void *returnValue, int32_t numRows) {
+  // The generated code's per batch buffers only have room for a batch
+  if (numRows <= 0 || numRows > m_batchSize)
+    throw std::runtime_error("A partial batch must have between 1 and " + std::to_string(m_batchSize) + " rows (got " + 
+                             std::to_string(numRows) + ")");
+  if (GetInputLayout() != InputLayout::kRowMajor) {
+    auto strides = GetDenseInputStrides(numRows);
+    return RunInferenceOnStridedInput(input, returnValue, numRows, strides.first, strides.second);
+  }
+  // The template arguments of RunInference only cast the pointers (see the TODO on RunInference in runtime.cpp)
+  if (numRows == m_batchSize)
+    return RunInference<double, double>(reinterpret_cast<double*>(input), reinterpret_cast<double*>(returnValue));
+  
+  if (m_dynamicBatch && !SerializerHasCustomPredictionMethod())
+    return RunInference_Default(reinterpret_cast<double*>(input), reinterpret_cast<double*>(returnValue), numRows);
+
+  auto inputElementSize = m_inputElementBitWidth/8;
+  auto resultRowBytes = GetResultRowBytes();
+  std::vector<char> paddedInput(static_cast<size_t>(m_batchSize) * m_rowSize * inputElementSize, 0);
+  std::vector<char> paddedResult(static_cast<size_t>(m_batchSize) * resultRowBytes, 0);
+  std::memcpy(paddedInput.data(), input, static_cast<size_t>(numRows) * m_rowSize * inputElementSize);
+  RunInference<double, double>(reinterpret_cast<double*>(paddedInput.data()), reinterpret_cast<double*>(paddedResult.data()));
+  std::memcpy(returnValue, paddedResult.data(), static_cast<size_t>(numRows) * resultRowBytes);
+  return 0;
+}
+
+int32_t InferenceRunnerBase::RunInferenceOnMultipleBatches(void *input, void *returnValue, int32_t numRows) {
+  return RunMultipleBatches(input, returnValue, numRows, false);
+}
+
+int32_t InferenceRunnerBase::RunMultipleBatches(void *input, void *returnValue, int32_t numRows, bool runOnCallingThread) {
+  if (GetInputLayout() != InputLayout::kRowMajor) {
+    auto strides = GetDenseInputStrides(numRows);
+    return RunStridedBatches(input, returnValue, numRows, strides.first, strides.second, runOnCallingThread);
+  }
+  auto inputBatchBytes = static_cast<int64_t>(m_batchSize) * m_rowSize * (m_inputElementBitWidth/8);
+  auto resultBatchBytes = static_cast<int64_t>(m_batchSize) * GetResultRowBytes();
+  auto runBatches = [&](int64_t beginBatch, int64_t endBatch) {
+    for (int64_t batch=beginBatch ; batch<endBatch ; ++batch) {
+      auto batchPtr = reinterpret_cast<char*>(input) + batch*inputBatchBytes;
+      auto resultsPtr = reinterpret_cast<char*>(returnValue) + batch*resultBatchBytes;
+      RunInference<double, double>(reinterpret_cast<double*>(batchPtr), reinterpret_cast<double*>(resultsPtr));
+    }
+  };
+
+  int32_t numFullBatches = numRows/m_batchSize;
+  // Custom prediction methods (e.g. GPU) manage their own buffers and aren't safe to call concurrently
+  if (m_threadPool && !runOnCallingThread && !SerializerHasCustomPredictionMethod())
+    m_threadPool->ParallelFor(numFullBatches, runBatches);
+  else
+    runBatches(0, numFullBatches);
+
+  // Handle the rows that don't make up a full batch
+  int32_t remainder = numRows % m_batchSize;
+  if (remainder != 0) {
+    auto batchPtr = reinterpret_cast<char*>(input) + numFullBatches*inputBatchBytes;
+    auto resultsPtr = reinterpret_cast<char*>(returnValue) + numFullBatches*resultBatchBytes;
+    RunInferenceOnPartialBatch(batchPtr, resultsPtr, remainder);
+  }
+  return 0;
+}
+
+bool InferenceRunnerBase::ProfileInference(void *input, void *returnValue, int32_t numRows, int32_t numRepeats, 
+                                           InferenceProfile& profile) {
+  assert (numRows > 0 && numRepeats > 0);
+  TreeBeard::PerfCounterGroup counters;
+  if (!counters.IsAnyCounterAvailable())
+    return false;
+
+  // Run everything on this thread since the counters only follow the calling thread. The thread pool is 
+  // left alone so that other threads can keep running inference with the runner.
+  // Warm up the caches and fault in the model and the buffers before measuring
+  RunMultipleBatches(input, returnValue, numRows, true);
+  counters.Start();
+  for (int32_t i=0 ; i<numRepeats ; ++i)
+    RunMultipleBatches(input, returnValue, numRows, true);
+  counters.Stop();
+
+  auto totalRows = static_cast<int64_t>(numRows) * numRepeats;
+  auto perRow = [&](TreeBeard::PerfCounter counter) {
+    auto value = counters.GetValue(counter);
+    return value < 0 ? std::numeric_limits<double>::quiet_NaN() : static_cast<double>(value) / totalRows;
+  };
+  profile.numRows = totalRows;
+  profile.cyclesPerRow = perRow(TreeBeard::PerfCounter::kCycles);
+  profile.instructionsPerCycle = perRow(TreeBeard::PerfCounter::kInstructions) / profile.cyclesPerRow;
+  profile.l1DataMissesPerRow = perRow(TreeBeard::PerfCounter::kL1DataReadMisses);
+  profile.llcMissesPerRow = perRow(TreeBeard::PerfCounter::kLLCMisses);
+  profile.branchMissesPerTreePerRow = perRow(TreeBeard::PerfCounter::kBranchMisses) / std::max(m_numTrees, 1);
+  return true;
+}
+
+int32_t InferenceRunnerBase::RunInferenceOnStridedInput(void *input, void *returnValue, int32_t numRows, 
+                                                        int64_t rowStride, int64_t columnStride) {
+  return RunStridedBatches(input, returnValue, numRows, rowStride, columnStride, false);
+}
+
+int32_t InferenceRunnerBase::RunStridedBatches(void *input, void *returnValue, int32_t numRows, int64_t rowStride, 
+                                               int64_t columnStride, bool runOnCallingThread) {
+  if (SerializerHasCustomPredictionMethod())
+    throw std::runtime_error("Strided inputs are not supported by custom prediction methods");
+  if (numRows <= 0)
+    throw std::runtime_error("The number of rows must be positive");
+  if (rowStride <= 0 || columnStride <= 0)
+    throw std::runtime_error("Input strides must be positive");
+  if (GetInputLayout() == InputLayout::kRowMajor && (rowStride != m_rowSize || columnStride != 1))
+    throw std::runtime_error("Model was compiled for dense row major inputs");
+  if (GetInputLayout() == InputLayout::kColumnMajor && (rowStride != 1 || columnStride < numRows))
+    throw std::runtime_error("Model was compiled for column major inputs, whose leading dimension can't be less than the number of rows");
+
+  auto inputElementSize = m_inputElementBitWidth/8;
+  auto resultRowBytes = GetResultRowBytes();
+  auto inputBatchBytes = static_cast<int64_t>(m_batchSize) * rowStride * inputElementSize;
+  auto resultBatchBytes = static_cast<int64_t>(m_batchSize) * resultRowBytes;
+  auto runBatches = [&](int64_t beginBatch, int64_t endBatch) {
+    for (int64_t batch=beginBatch ; batch<endBatch ; ++batch) {
+      auto batchPtr = reinterpret_cast<char*>(input) + batch*inputBatchBytes;
+      auto resultsPtr = reinterpret_cast<char*>(returnValue) + batch*resultBatchBytes;
+      RunInference_Default(reinterpret_cast<double*>(batchPtr), reinterpret_cast<double*>(resultsPtr), m_batchSize, rowStride, columnStride);
+    }
+  };
+
+  int32_t numFullBatches = numRows/m_batchSize;
+  if (m_threadPool && !runOnCallingThread)
+    m_threadPool->ParallelFor(numFullBatches, runBatches);
+  else
+    runBatches(0, numFullBatches);
+
+  int32_t remainder = numRows % m_batchSize;
+  if (remainder == 0)
+    return 0;
+  auto batchPtr = reinterpret_cast<char*>(input) + numFullBatches*inputBatchBytes;
+  auto resultsPtr = reinterpret_cast<char*>(returnValue) + numFullBatches*resultBatchBytes;
+  if (m_dynamicBatch)
+    return RunInference_Default(reinterpret_cast<double*>(batchPtr), reinterpret_cast<double*>(resultsPtr), remainder, rowStride, columnStride);
+
+  // Copy the remaining rows into a zero padded dense batch
+  auto paddedStrides = GetDenseInputStrides(m_batchSize);
+  std::vector<char> paddedInput(static_cast<size_t>(m_batchSize) * m_rowSize * inputElementSize, 0);
+  std::vector<char> paddedResult(static_cast<size_t>(m_batchSize) * resultRowBytes, 0);
+  for (int64_t i=0 ; i<remainder ; ++i) {
+    for (int64_t j=0 ; j<m_rowSize ; ++j) {
+      auto paddedElementPtr = paddedInput.data() + (i*paddedStrides.first + j*paddedStrides.second)*inputElementSize;
+      auto elementPtr = batchPtr + (i*rowStride + j*columnStride)*inputElementSize;
+      std::memcpy(paddedElementPtr, elementPtr, inputElementSize);
+    }
+  }
+  RunInference_Default(reinterpret_cast<double*>(paddedInput.data()), reinterpret_cast<double*>(paddedResult.data()), 
+                       m_batchSize, paddedStrides.first, paddedStrides.second);
+  std::memcpy(resultsPtr, paddedResult.data(), static_cast<size_t>(remainder) * resultRowBytes);
+  return 0;
+}
+
+void InferenceRunnerBase::SetNumberOfThreads(int32_t numThreads, bool pinToCores) {
+  if (numThreads == GetNumberOfThreads() && pinToCores == m_pinThreadsToCores)
+    return;
+  m_pinThreadsToCores = pinToCores;
+  if (numThreads <= 1)
+    m_threadPool.reset();
+  else
+    m_threadPool = std::make_unique<TreeBeard::ThreadPool>(numThreads, pinToCores);
 }
 
 int32_t InferenceRunnerBase::RunInference_CustomImpl(double *input, double *returnValue) {
@@ -103,45 +332,43 @@ SharedObjectInferenceRunner::~SharedObjectInferenceRunner() {
 }
 
 void* SharedObjectInferenceRunner::GetFunctionAddress(const std::string& functionName) {
-  auto fptr = dlsym(m_so, functionName.c_str());
-  assert (fptr);
-  return fptr;
+  // Null if the model doesn't define the function
+  return dlsym(m_so, functionName.c_str());
 }
 
 // ===------------------------------------------------------=== //
 // JIT inference runner 
 // ===------------------------------------------------------=== //
 
-llvm::Expected<std::unique_ptr<mlir::ExecutionEngine>> InferenceRunner::CreateExecutionEngine(mlir::ModuleOp module) {
+llvm::Expected<std::unique_ptr<mlir::ExecutionEngine>> InferenceRunner::CreateExecutionEngine(mlir::ModuleOp module, 
+                                                                                              const LLVMCodeGenOptions& codeGenOptions,
+                                                                                              bool enableObjectDump) {
   llvm::InitializeNativeTarget();
   llvm::InitializeNativeTargetAsmPrinter();
 
   mlir::registerLLVMDialectTranslation(*module->getContext());
   mlir::registerOpenMPDialectTranslation(*module->getContext());
   
-  // An optimization pipeline to use within the execution engine.
-  auto optPipeline = mlir::makeOptimizingTransformer(/*optLevel=*/ 0, /*sizeLevel=*/0, /*targetMachine=*/nullptr);
+  // An optimization pipeline to use within the execution engine. By default, the
+  // module is JIT compiled without running any LLVM passes.
+  std::function<llvm::Error(llvm::Module*)> optPipeline;
+  if (!codeGenOptions.IsDefault())
+    optPipeline = MakeLLVMOptimizingTransformer(codeGenOptions);
 
   // Libraries that we'll pass to the ExecutionEngine for loading.
-  SmallVector<StringRef, 4> executionEngineLibs;
+  auto libraryPaths = GetJITSharedLibraryPaths();
+  SmallVector<StringRef, 4> executionEngineLibs(libraryPaths.begin(), libraryPaths.end());
 
-  std::string debugSOPath;
-  if (decisionforest::InsertDebugHelpers) {
-    debugSOPath = GetDebugSOPath();
-    // std::cout << "Calculated debug SO path : " << debugSOPath << std::endl;
-    executionEngineLibs.push_back(debugSOPath.data());
-  }
-#ifdef OMP_SUPPORT
-  std::string libompPath = std::string(LLVM_LIB_DIR) + std::string("lib/libomp.so");
-  if (!FileExists(libompPath)) {
-    libompPath = "/usr/lib/llvm-10/lib/libomp.so";
-  }
-  executionEngineLibs.push_back(libompPath);
-#endif
   // Create an MLIR execution engine. The execution engine eagerly JIT-compiles
   // the module.
-  mlir::ExecutionEngineOptions options{nullptr, {}, std::nullopt, executionEngineLibs};
+  mlir::ExecutionEngineOptions options{nullptr, optPipeline, std::nullopt, executionEngineLibs};
   options.enablePerfNotificationListener = EnablePerfNotificationListener;
+  // Keep the generated object code around so that it can be written out with DumpObjectFile
+  options.enableObjectDump = enableObjectDump;
+  // Leave the JIT's default code generation level unchanged at optLevel 0
+  if (codeGenOptions.optLevel > 0)
+    options.jitCodeGenOptLevel = static_cast<llvm::CodeGenOpt::Level>(codeGenOptions.optLevel);
+  TreeBeard::Logging::PhaseTimer timer("JIT compile");
   auto maybeEngine = mlir::ExecutionEngine::create(module, options);
   assert(maybeEngine && "failed to construct an execution engine");
   return maybeEngine;
@@ -151,13 +378,19 @@ InferenceRunner::InferenceRunner(std::shared_ptr<IModelSerializer> serializer,
                                  mlir::ModuleOp module,
                                  int32_t tileSize,
                                  int32_t thresholdSize,
-                                 int32_t featureIndexSize) 
+                                 int32_t featureIndexSize,
+                                 const LLVMCodeGenOptions& codeGenOptions,
+                                 bool enableObjectDump) 
   :InferenceRunnerBase(serializer, tileSize, thresholdSize, featureIndexSize),
-   m_maybeEngine(CreateExecutionEngine(module)), m_engine(m_maybeEngine.get()), m_module(module)
+   m_maybeEngine(CreateExecutionEngine(module, codeGenOptions, enableObjectDump)), m_engine(m_maybeEngine.get()), m_module(module)
 {
   Init();
 }
 
+void InferenceRunner::DumpObjectFile(const std::string& filename) {
+  m_engine->dumpToObjectFile(filename);
+}
+
 void *InferenceRunner::GetFunctionAddress(const std::string& functionName) {
   auto expectedFptr = m_engine->lookup(functionName);
   if (!expectedFptr)
@@ -166,5 +399,79 @@ void *InferenceRunner::GetFunctionAddress(const std::string& functionName) {
   return fptr;
 }
 
+// ===------------------------------------------------------=== //
+// Object file inference runner 
+// ===------------------------------------------------------=== //
+
+ObjectFileInferenceRunner::ObjectFileInferenceRunner(std::shared_ptr<IModelSerializer> serializer,
+                                                     std::unique_ptr<llvm::orc::LLJIT> jit,
+                                                     int32_t tileSize,
+                                                     int32_t thresholdSize,
+                                                     int32_t featureIndexSize)
+  :InferenceRunnerBase(serializer, tileSize, thresholdSize, featureIndexSize), m_jit(std::move(jit))
+{
+  Init();
+}
+
+ObjectFileInferenceRunner* ObjectFileInferenceRunner::Load(std::shared_ptr<IModelSerializer> serializer,
+                                                           const std::string& objectFilePath,
+                                                           int32_t tileSize,
+                                                           int32_t thresholdSize,
+                                                           int32_t featureIndexSize) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  auto maybeJIT = llvm::orc::LLJITBuilder().create();
+  if (!maybeJIT) {
+    llvm::consumeError(maybeJIT.takeError());
+    return nullptr;
+  }
+  auto jit = std::move(*maybeJIT);
+
+  // Resolve external symbols against the process and the libraries the JIT'ed code needs
+  auto globalPrefix = jit->getDataLayout().getGlobalPrefix();
+  auto& mainDylib = jit->getMainJITDylib();
+  auto maybeProcessGenerator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(globalPrefix);
+  if (!maybeProcessGenerator) {
+    llvm::consumeError(maybeProcessGenerator.takeError());
+    return nullptr;
+  }
+  mainDylib.addGenerator(std::move(*maybeProcessGenerator));
+  for (auto& libraryPath : GetJITSharedLibraryPaths()) {
+    auto maybeGenerator = llvm::orc::DynamicLibrarySearchGenerator::Load(libraryPath.c_str(), globalPrefix);
+    if (!maybeGenerator) {
+      llvm::consumeError(maybeGenerator.takeError());
+      continue;
+    }
+    mainDylib.addGenerator(std::move(*maybeGenerator));
+  }
+
+  auto maybeBuffer = llvm::MemoryBuffer::getFile(objectFilePath);
+  if (!maybeBuffer)
+    return nullptr;
+  if (auto error = jit->addObjectFile(std::move(*maybeBuffer))) {
+    llvm::consumeError(std::move(error));
+    return nullptr;
+  }
+  // Init needs these. Looking them up also links the object, which fails on truncated or corrupt files.
+  for (auto functionName : { "Prediction_Function", "Init_model", "GetBatchSize", "GetRowSize", "GetNumberOfOutputs" }) {
+    auto maybeAddress = jit->lookup(functionName);
+    if (!maybeAddress) {
+      llvm::consumeError(maybeAddress.takeError());
+      return nullptr;
+    }
+  }
+  return new ObjectFileInferenceRunner(serializer, std::move(jit), tileSize, thresholdSize, featureIndexSize);
+}
+
+void* ObjectFileInferenceRunner::GetFunctionAddress(const std::string& functionName) {
+  auto maybeAddress = m_jit->lookup(functionName);
+  if (!maybeAddress) {
+    llvm::consumeError(maybeAddress.takeError());
+    return nullptr;
+  }
+  return maybeAddress->toPtr<void*>();
+}
+
 } // decisionforest
 } // mlir
@@ -10,10 +10,14 @@
 #include "mlir/Target/LLVMIR/Dialect/OpenMP/OpenMPToLLVMIRTranslation.h"
 #include "mlir/Target/LLVMIR/Export.h"
 
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
 #include "llvm/Support/TargetSelect.h"
 
+#include "Dialect.h"
 #include "TreeTilingUtils.h"
 #include "TypeDefinitions.h"
+#include "ThreadPool.h"
 
 namespace mlir
 {
@@ -34,6 +38,17 @@ using OffsetMemrefType = Memref<int64_t, 1>;
 using ClassMemrefType = Memref<int8_t, 1>;
 using ModelMemrefType = Memref<Tile, 1>;
 
+// Hardware counters measured by InferenceRunnerBase::ProfileInference. Counts are normalized by the number
+// of rows run (and branch misses also by the number of trees). Counters that couldn't be read are NaN.
+struct InferenceProfile {
+  int64_t numRows = 0;
+  double cyclesPerRow = 0.0;
+  double instructionsPerCycle = 0.0;
+  double l1DataMissesPerRow = 0.0;
+  double llcMissesPerRow = 0.0;
+  double branchMissesPerTreePerRow = 0.0;
+};
+
 using LUTEntryType = int8_t;
 using LUTMemrefType = Memref<LUTEntryType, 2>;
 
@@ -50,29 +65,88 @@ protected:
   int32_t m_featureIndexSize;
   int32_t m_batchSize;
   int32_t m_rowSize;
+  int32_t m_dynamicBatch;
+  int32_t m_inputLayout;
+  int32_t m_earlyExit;
+  // Number of values written per row. Models that return all outputs of a multi-class (or multi-target) 
+  // model have a [batchSize, numOutputs] result.
+  int32_t m_numOutputs;
+  // -1 for models compiled by a Treebeard that didn't record it
+  int32_t m_numTrees;
+  // Number of rows and trees walked by the generated code (see Get_earlyExitStatistics). Null if the 
+  // model wasn't compiled with early exit.
+  int64_t *m_earlyExitStatistics = nullptr;
+  int32_t m_profileLeafHits = 0;
+  // Leaf hit counters of models compiled with CompilerOptions::profileLeafHits (see Get_leafHitCounts). 
+  // Null otherwise.
+  Memref<int64_t, 1> m_leafHitCounts{nullptr, nullptr, 0, {0}, {1}};
   void *m_inferenceFuncPtr;
   LUTMemrefType m_lutMemref;
+  // Workers used to run the batches of a multi-batch call concurrently. 
+  // Null when the runner is single threaded.
+  std::unique_ptr<TreeBeard::ThreadPool> m_threadPool;
+  bool m_pinThreadsToCores = false;
 
   virtual void* GetFunctionAddress(const std::string& functionName) = 0;
+  // Set the field to the value returned by the model's getter. Getters that every model has are required, and the
+  // getters added later fall back to the value that models compiled without them behave as.
   void InitIntegerField(const std::string& functionName, int32_t& field);
+  void InitIntegerField(const std::string& functionName, int32_t& field, int32_t defaultValue);
   
   virtual void Init();
   
+  // Implement RunInferenceOnMultipleBatches and RunInferenceOnStridedInput. If runOnCallingThread is set, all 
+  // batches are run on the calling thread even if more threads have been set.
+  int32_t RunMultipleBatches(void *input, void *returnValue, int32_t numRows, bool runOnCallingThread);
+  int32_t RunStridedBatches(void *input, void *returnValue, int32_t numRows, int64_t rowStride, int64_t columnStride,
+                            bool runOnCallingThread);
+
+  // Strides (in elements) of a dense input with numRows rows in the layout the model was compiled for
+  std::pair<int64_t, int64_t> GetDenseInputStrides(int64_t numRows) {
+    if (GetInputLayout() == InputLayout::kColumnMajor)
+      return std::make_pair(int64_t(1), numRows);
+    return std::make_pair(static_cast<int64_t>(m_rowSize), int64_t(1));
+  }
+
+  // Models compiled with a row major input layout ignore the strides (the generated code assumes dense rows)
   template<typename InputElementType, typename ReturnType>
-  int32_t RunInference_Default(InputElementType *input, ReturnType *returnValue) {
-    
-    typedef Memref<ReturnType, 1> (*InferenceFunc_t)(InputElementType*, InputElementType*, int64_t, int64_t, int64_t, int64_t, int64_t, 
-                                                     ReturnType*, ReturnType*, int64_t, int64_t, int64_t);
-    auto inferenceFuncPtr = reinterpret_cast<InferenceFunc_t>(m_inferenceFuncPtr);
+  int32_t RunInference_Default(InputElementType *input, ReturnType *returnValue, int64_t numRows, int64_t rowStride, int64_t columnStride) {
     InputElementType *ptr = input, *alignedPtr = input;
     int64_t rowSize = m_rowSize, offset = 0, stride = 1;
     ReturnType *resultPtr = returnValue, *resultAlignedPtr = returnValue;
-    int64_t resultLen = m_batchSize;
-    inferenceFuncPtr(ptr, alignedPtr, offset, m_batchSize, rowSize, rowSize /*stride by rowSize to move from one row to the next*/, stride, 
+    int64_t resultLen = numRows;
+    if (m_numOutputs > 1) {
+      // The result is a dense row major [numRows, numOutputs] memref
+      typedef Memref<ReturnType, 2> (*InferenceFunc_t)(InputElementType*, InputElementType*, int64_t, int64_t, int64_t, int64_t, int64_t, 
+                                                       ReturnType*, ReturnType*, int64_t, int64_t, int64_t, int64_t, int64_t);
+      auto inferenceFuncPtr = reinterpret_cast<InferenceFunc_t>(m_inferenceFuncPtr);
+      int64_t numOutputs = m_numOutputs;
+      inferenceFuncPtr(ptr, alignedPtr, offset, numRows, rowSize, rowStride, columnStride, 
+                       resultPtr, resultAlignedPtr, offset, resultLen, numOutputs, numOutputs, stride);
+      return 0;
+    }
+    typedef Memref<ReturnType, 1> (*InferenceFunc_t)(InputElementType*, InputElementType*, int64_t, int64_t, int64_t, int64_t, int64_t, 
+                                                     ReturnType*, ReturnType*, int64_t, int64_t, int64_t);
+    auto inferenceFuncPtr = reinterpret_cast<InferenceFunc_t>(m_inferenceFuncPtr);
+    inferenceFuncPtr(ptr, alignedPtr, offset, numRows, rowSize, rowStride, columnStride, 
                      resultPtr, resultAlignedPtr, offset, resultLen, stride);
     return 0;
   }
 
+  // Bytes of results written per row
+  int64_t GetResultRowBytes() { return static_cast<int64_t>(m_numOutputs) * (m_returnTypeBitWidth/8); }
+
+  template<typename InputElementType, typename ReturnType>
+  int32_t RunInference_Default(InputElementType *input, ReturnType *returnValue, int64_t numRows) {
+    auto strides = GetDenseInputStrides(numRows);
+    return RunInference_Default(input, returnValue, numRows, strides.first, strides.second);
+  }
+
+  template<typename InputElementType, typename ReturnType>
+  int32_t RunInference_Default(InputElementType *input, ReturnType *returnValue) {
+    return RunInference_Default(input, returnValue, m_batchSize);
+  }
+
   bool SerializerHasCustomPredictionMethod();
   int32_t RunInference_CustomImpl(double *input, double* returnValue);
 
@@ -97,6 +171,32 @@ public:
   int32_t GetFeatureIndexWidth() { return m_featureIndexSize; }
   int32_t GetInputElementBitWidth() { return m_inputElementBitWidth; }
   int32_t GetReturnTypeBitWidth() { return m_returnTypeBitWidth; }
+  bool IsDynamicBatch() { return m_dynamicBatch != 0; }
+  InputLayout GetInputLayout() { return static_cast<InputLayout>(m_inputLayout); }
+  bool IsEarlyExitEnabled() { return m_earlyExit != 0; }
+  // Results hold numRows*GetNumberOfOutputs() values, the outputs of each row stored contiguously
+  int32_t GetNumberOfOutputs() { return m_numOutputs; }
+  int32_t GetNumberOfTrees() { return m_numTrees; }
+  // Rows run through a model compiled with early exit and the trees walked for them, counted from 
+  // when the model was loaded or the statistics were last reset. Rows that pad out partial batches 
+  // are included.
+  int64_t GetEarlyExitRowCount() { return m_earlyExitStatistics ? m_earlyExitStatistics[0] : 0; }
+  int64_t GetEarlyExitTreeCount() { return m_earlyExitStatistics ? m_earlyExitStatistics[1] : 0; }
+  double GetAverageTreesWalkedPerRow() {
+    auto rowCount = GetEarlyExitRowCount();
+    return rowCount == 0 ? 0.0 : static_cast<double>(GetEarlyExitTreeCount()) / rowCount;
+  }
+  // Must not be called while inference is running on the model
+  void ResetEarlyExitStatistics();
+  // Models compiled with CompilerOptions::profileLeafHits count the rows (including the rows that pad out
+  // partial batches) that reach each leaf. The counters are laid out like the array representation's model 
+  // buffer: the trees one after the other, each stored as a complete binary tree (children of node i at 
+  // 2i+1 and 2i+2). Counts accumulate over all calls until they are reset.
+  bool IsLeafHitProfilingEnabled() { return m_profileLeafHits != 0; }
+  const int64_t* GetLeafHitCounts() { return m_leafHitCounts.alignedPtr + m_leafHitCounts.offset; }
+  int64_t GetNumberOfLeafHitCounters() { return m_leafHitCounts.alignedPtr ? m_leafHitCounts.lengths[0] : 0; }
+  // Must not be called while inference is running on the model
+  void ResetLeafHitCounts();
   LUTMemrefType GetLUTMemref() { return m_lutMemref; }
   template<typename InputElementType, typename ReturnType>
   int32_t RunInference(InputElementType *input, ReturnType *returnValue) {
@@ -108,6 +208,36 @@ public:
     }
     return 0;
   }
+
+  // Run inference on fewer than batch size rows. Models compiled with a dynamic 
+  // batch run the compiled remainder path. Others have the rows padded out to a 
+  // full batch and only the first numRows results are copied back.
+  int32_t RunInferenceOnPartialBatch(void *input, void *returnValue, int32_t numRows);
+
+  // Run inference on an arbitrary number of rows. Full batches are split into disjoint
+  // ranges that are run concurrently on the runner's threads (if more than one thread 
+  // has been set). The remaining rows are run through RunInferenceOnPartialBatch.
+  int32_t RunInferenceOnMultipleBatches(void *input, void *returnValue, int32_t numRows);
+
+  // Run inference on numRows rows where element (i, j) of the input is at input[i*rowStride + j*columnStride].
+  // The input is read in place. Models compiled with a column major input layout need rowStride to be 1 
+  // and models compiled with a row major layout need dense rows. Rows that don't make up a full batch are 
+  // copied into a padded batch unless the model has a dynamic batch. The other entry points take dense 
+  // inputs in the layout the model was compiled for.
+  int32_t RunInferenceOnStridedInput(void *input, void *returnValue, int32_t numRows, int64_t rowStride, int64_t columnStride);
+
+  // Use numThreads threads (including the calling thread) to run multi-batch calls. 
+  // Meant for models compiled without a parallel schedule. Workers are only pinned to cores if 
+  // pinToCores is set since the runners of a process would otherwise all pin to the same cores.
+  void SetNumberOfThreads(int32_t numThreads, bool pinToCores=false);
+  int32_t GetNumberOfThreads() { return m_threadPool ? m_threadPool->GetNumberOfThreads() : 1; }
+
+  // Run inference on numRows rows numRepeats times (as RunInferenceOnMultipleBatches does) while reading the 
+  // hardware performance counters of the calling thread. The batches are run on the calling thread even if 
+  // more threads have been set so that the counters see all the work. Threads started by the generated 
+  // code (parallel schedules) aren't counted. Other threads may run inference with the runner meanwhile.
+  // Returns false if no counter could be opened.
+  bool ProfileInference(void *input, void *returnValue, int32_t numRows, int32_t numRepeats, InferenceProfile& profile);
 };
 
 class InferenceRunner : public InferenceRunnerBase {
@@ -118,12 +248,18 @@ protected:
 
   void* GetFunctionAddress(const std::string& functionName) override;
 public:
-  static llvm::Expected<std::unique_ptr<mlir::ExecutionEngine>> CreateExecutionEngine(mlir::ModuleOp module);
+  static llvm::Expected<std::unique_ptr<mlir::ExecutionEngine>> CreateExecutionEngine(mlir::ModuleOp module,
+                                                                                      const LLVMCodeGenOptions& codeGenOptions=LLVMCodeGenOptions(),
+                                                                                      bool enableObjectDump=false);
   InferenceRunner(std::shared_ptr<IModelSerializer> serializer, 
                   mlir::ModuleOp module,
                   int32_t tileSize, 
                   int32_t thresholdSize,
-                  int32_t featureIndexSize);
+                  int32_t featureIndexSize,
+                  const LLVMCodeGenOptions& codeGenOptions=LLVMCodeGenOptions(),
+                  bool enableObjectDump=false);
+  // Write the JIT compiled object code to a file. The runner must be constructed with enableObjectDump.
+  void DumpObjectFile(const std::string& filename);
 };
 
 class SharedObjectInferenceRunner : public InferenceRunnerBase{
@@ -139,6 +275,25 @@ public:
   ~SharedObjectInferenceRunner();
 };
 
+// Runs code loaded from an object file written by InferenceRunner::DumpObjectFile
+class ObjectFileInferenceRunner : public InferenceRunnerBase {
+  std::unique_ptr<llvm::orc::LLJIT> m_jit;
+  ObjectFileInferenceRunner(std::shared_ptr<IModelSerializer> serializer,
+                            std::unique_ptr<llvm::orc::LLJIT> jit,
+                            int32_t tileSize,
+                            int32_t thresholdSize,
+                            int32_t featureIndexSize);
+protected:
+  void* GetFunctionAddress(const std::string& functionName) override;
+public:
+  // Returns nullptr if the object file can't be read or linked or doesn't define the model's functions
+  static ObjectFileInferenceRunner* Load(std::shared_ptr<IModelSerializer> serializer,
+                                         const std::string& objectFilePath,
+                                         int32_t tileSize,
+                                         int32_t thresholdSize,
+                                         int32_t featureIndexSize);
+};
+
 } // decision forest
 } // mlir
 
@@ -162,7 +162,7 @@ struct EnsembleConstantOpLowering: public ConversionPattern {
     // in a single int64 for tile size 4 for example (each entry needs 3 bits and there are 16 entries -- one for each outcome). 
     auto lutMemrefType = MemRefType::get({numberOfTileShapes, numberOfTileOutcomes}, rewriter.getI8Type());
     std::vector<int8_t> lutData(numberOfTileShapes * numberOfTileOutcomes);
-    mlir::decisionforest::ForestJSONReader::GetInstance().InitializeLookUpTable(lutData.data(), tileSize, /*entryBitWidth*/8);
+    mlir::decisionforest::ForestJSONReader::InitializeLookUpTable(lutData.data(), tileSize, /*entryBitWidth*/8);
     mlir::decisionforest::createConstantGlobalOp(rewriter, location, lookupTableMemrefName, lutMemrefType, lutData);
 
     return lutMemrefType;
@@ -190,7 +190,14 @@ struct EnsembleConstantOpGPULowering: public ConversionPattern {
     auto location = op->getLoc();
     auto owningModule = op->getParentOfType<mlir::ModuleOp>();
     assert (owningModule);
-    
+
+    // GPU traversal code compares with the forest's predicate and can't decode per node missing value directions
+    auto& forest = ensembleConstOp.getForest().GetDecisionForest();
+    if (forest.GetMissingValueRouting() == decisionforest::MissingValueRouting::kPerNode || forest.HasCategoricalSplits()) {
+      op->emitError("GPU code generation doesn't support forests with categorical splits or whose nodes send missing values in different directions");
+      return mlir::failure();
+    }
+
     auto ret = m_representation->GenerateModelGlobals(op, operands, rewriter, m_serializer);
     if (ret.failed()) {
       return ret;
@@ -433,6 +440,8 @@ struct GetLeafValueOpLowering : public ConversionPattern {
     if (decisionforest::InsertDebugHelpers) {
       rewriter.create<decisionforest::PrintTreeNodeOp>(location, nodeIndex);
     }
+    if (m_representation->ProfileLeafHits())
+      m_representation->GenerateLeafHitCountIncrement(rewriter, location, operands[0], nodeIndex);
 
     auto leafValue = m_representation->GenerateGetLeafValueOp(rewriter, op, operands[0], nodeIndex);
     // TODO cast the loaded value to the correct result type of the tree. 
@@ -466,6 +475,8 @@ struct GetLeafTileValueOpLowering : public ConversionPattern {
     if (decisionforest::InsertDebugHelpers) {
       rewriter.create<decisionforest::PrintTreeNodeOp>(location, nodeIndex);
     }
+    if (m_representation->ProfileLeafHits())
+      m_representation->GenerateLeafHitCountIncrement(rewriter, location, tree, nodeIndex);
 
     // Load threshold
     // TODO Ideally, this should be a different op for when we deal with tile sizes != 1. We will then need to load 
@@ -56,8 +56,14 @@
 #include "llvm/MC/TargetRegistry.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/Target/TargetMachine.h"
+#include "llvm/MC/MCSubtargetInfo.h"
 #include "llvm/Support/MemoryBufferRef.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
 
 using namespace mlir;
 
@@ -264,7 +270,82 @@ int dumpLLVMIR(mlir::ModuleOp module, bool dumpAsm) {
   return 0;
 }
 
-int dumpLLVMIRToFile(mlir::ModuleOp module, const std::string& filename) {
+// ===---------------------------------------------------=== //
+// LLVM optimization and target selection
+// ===---------------------------------------------------=== //
+
+// Throws if the CPU or a feature isn't known to LLVM for the host's target, since LLVM would otherwise 
+// ignore it (with a warning) and silently generate code for the default target.
+std::unique_ptr<llvm::TargetMachine> CreateTargetMachine(const LLVMCodeGenOptions& codeGenOptions) {
+  auto maybeMachineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!maybeMachineBuilder)
+    throw std::runtime_error("Failed to detect the host target : " + llvm::toString(maybeMachineBuilder.takeError()));
+  auto& machineBuilder = *maybeMachineBuilder;
+  // detectHost sets the CPU and features to those of the host
+  if (!codeGenOptions.targetCPU.empty() && codeGenOptions.targetCPU != "host") {
+    machineBuilder.setCPU(codeGenOptions.targetCPU);
+    // Host features don't apply to a different CPU
+    machineBuilder.getFeatures() = llvm::SubtargetFeatures();
+  }
+  if (!codeGenOptions.targetFeatures.empty() && codeGenOptions.targetFeatures != "host") {
+    machineBuilder.getFeatures() = llvm::SubtargetFeatures();
+    machineBuilder.addFeatures(llvm::SubtargetFeatures(codeGenOptions.targetFeatures).getFeatures());
+  }
+  auto maybeTargetMachine = machineBuilder.createTargetMachine();
+  if (!maybeTargetMachine)
+    throw std::runtime_error("Failed to create the target machine : " + llvm::toString(maybeTargetMachine.takeError()));
+  auto targetMachine = std::move(*maybeTargetMachine);
+
+  // Only the CPU and features that were asked for are checked. Those of the host are known.
+  auto subtargetInfo = targetMachine->getMCSubtargetInfo();
+  auto targetTriple = machineBuilder.getTargetTriple().str();
+  if (!codeGenOptions.targetCPU.empty() && codeGenOptions.targetCPU != "host" && 
+      !subtargetInfo->isCPUStringValid(codeGenOptions.targetCPU))
+    throw std::runtime_error("Unknown target CPU " + codeGenOptions.targetCPU + " for " + targetTriple);
+  if (!codeGenOptions.targetFeatures.empty() && codeGenOptions.targetFeatures != "host") {
+    auto knownFeatures = subtargetInfo->getAllProcessorFeatures();
+    for (auto& feature : llvm::SubtargetFeatures(codeGenOptions.targetFeatures).getFeatures()) {
+      auto featureName = llvm::SubtargetFeatures::StripFlag(feature);
+      auto isKnown = std::any_of(knownFeatures.begin(), knownFeatures.end(), 
+                                 [&](const llvm::SubtargetFeatureKV& knownFeature) { return featureName == knownFeature.Key; });
+      if (!isKnown)
+        throw std::runtime_error("Unknown target feature " + feature + " for " + targetTriple);
+    }
+  }
+  return targetMachine;
+}
+
+// Record the target CPU and features on every function so that they're honored
+// by whoever generates code for the module (the JIT or an external llc/clang).
+void SetTargetCPUAndFeatures(llvm::Module* llvmModule, llvm::TargetMachine* targetMachine) {
+  auto cpu = targetMachine->getTargetCPU();
+  auto features = targetMachine->getTargetFeatureString();
+  for (auto& function : *llvmModule) {
+    if (function.isDeclaration())
+      continue;
+    if (!cpu.empty())
+      function.addFnAttr("target-cpu", cpu);
+    if (!features.empty())
+      function.addFnAttr("target-features", features);
+  }
+}
+
+std::function<llvm::Error(llvm::Module*)> MakeLLVMOptimizingTransformer(const LLVMCodeGenOptions& codeGenOptions) {
+  assert (codeGenOptions.optLevel >= 0 && codeGenOptions.optLevel <= 3 && "Invalid LLVM optimization level");
+  bool setTarget = !codeGenOptions.targetCPU.empty() || !codeGenOptions.targetFeatures.empty();
+  std::shared_ptr<llvm::TargetMachine> targetMachine;
+  // The target machine is only needed to tell the optimizer about the target (e.g. vector widths)
+  if (setTarget || codeGenOptions.optLevel > 0)
+    targetMachine = CreateTargetMachine(codeGenOptions);
+  auto optimizer = mlir::makeOptimizingTransformer(codeGenOptions.optLevel, /*sizeLevel=*/0, targetMachine.get());
+  return [targetMachine, optimizer, setTarget](llvm::Module* llvmModule) -> llvm::Error {
+    if (setTarget)
+      SetTargetCPUAndFeatures(llvmModule, targetMachine.get());
+    return optimizer(llvmModule);
+  };
+}
+
+int dumpLLVMIRToFile(mlir::ModuleOp module, const std::string& filename, const LLVMCodeGenOptions& codeGenOptions) {
   // Init LLVM targets
   llvm::InitializeNativeTarget();
   llvm::InitializeNativeTargetAsmPrinter();
@@ -280,6 +361,13 @@ int dumpLLVMIRToFile(mlir::ModuleOp module, const std::string& filename) {
     return -1;
   }
   ExecutionEngine::setupTargetTriple(llvmModule.get());
+  if (!codeGenOptions.IsDefault()) {
+    auto optimizer = MakeLLVMOptimizingTransformer(codeGenOptions);
+    if (auto error = optimizer(llvmModule.get())) {
+      llvm::errs() << "Failed to optimize LLVM IR : " << llvm::toString(std::move(error)) << "\n";
+      return -1;
+    }
+  }
   std::error_code ec;
   llvm::raw_fd_ostream filestream(filename, ec);
   filestream << *llvmModule;
@@ -1,6 +1,14 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <set>
 #include "Dialect.h"
 // #include "Passes.h"
 #include "OpLoweringUtils.h"
+#include "LIRLoweringHelpers.h"
+#include "Representations.h"
 
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
@@ -8,6 +16,7 @@
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Transforms/DialectConversion.h"
+#include "mlir/IR/TypeUtilities.h"
 #include "mlir/Dialect/Math/IR/Math.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Pass/PassManager.h"
@@ -76,6 +85,20 @@ void InsertPrintElementOp(
 
 typedef struct {
   bool isMultiClass;
+  // The result is a [batch, numClasses] memref that all class outputs are written to
+  bool returnAllOutputs;
+  decisionforest::PredictionTransformation predTransform;
+  // The transformation of each output of forests that combine several models. Empty otherwise.
+  std::vector<decisionforest::PredictionTransformation> outputTransforms;
+  // Set if the transformation is applied as each row's prediction is stored rather than in a 
+  // separate loop over the results (see CanFuseTransformation)
+  bool fuseTransformation;
+  // Voting forests count the votes of the trees for each class (the leaf values are class indices). 
+  // Averaging forests divide the sum of each class by the number of trees that predict it.
+  decisionforest::ReductionType reductionType;
+  // What the sum of each class (or the only sum) is multiplied by to average it. For voting forests, 
+  // this turns the counts into the fractions of trees voting for each class.
+  std::vector<double> averagingScales;
 
   // Memrefs and Types
   Value treeClassesMemref;
@@ -92,13 +115,26 @@ typedef struct {
   arith::ConstantIndexOp numClassesConst;
   arith::ConstantIndexOp oneIndexConst;
   arith::ConstantIndexOp zeroIndexConst;
-  arith::ConstantIndexOp batchSizeConst;
+  // Number of rows the loops run over. A constant unless we are generating the 
+  // remainder loop for a dynamic batch.
+  Value batchSizeConst;
   Value initialValueConst;
+  // A vector with the initial value of each class if the forest's outputs have different initial 
+  // values (see DecisionForest::GetOutputInitialOffsets). Null otherwise.
+  Value classInitialValuesConst;
   
   // Decision Forest and Tree Stuff.
   mlir::decisionforest::TreeType treeType;
   mlir::Value forestConst;
   mlir::arith::CmpFPredicateAttr cmpPredicate;
+
+  // Early exit (only set if the tree loop exits early). The bounds are indexed by the index of the next 
+  // tree to walk. The counts hold the number of rows and trees walked by this call and are added to the 
+  // statistics global at the end.
+  Value earlyExitPositiveBounds;
+  Value earlyExitNegativeBounds;
+  Value earlyExitCounts;
+  Value earlyExitStatistics;
 } PredictOpLoweringState;
 
 Value SumOfValues(ConversionPatternRewriter &rewriter, Location location, std::list<Value>& values) {
@@ -349,6 +385,32 @@ struct LoopConstructor {
   LoopType GetInnerLoop() { return m_innerLoop; }
 };
 
+static bool IsColumnMajor(MemRefType dataMemrefType) {
+  SmallVector<int64_t, 2> strides;
+  int64_t offset;
+  if (failed(getStridesAndOffset(dataMemrefType, strides, offset)))
+    return false;
+  return strides[0] == 1 && strides[1] != 1;
+}
+
+// Each feature of a column major input is stored contiguously. Walking one tree over all rows of 
+// the batch (i.e. making the batch loop the innermost loop) makes consecutive iterations read adjacent 
+// elements of the feature columns rather than elements a column apart. Schedules that have already 
+// been modified are left as they are, as are the schedules of quantized forests, which are walked on a 
+// row major buffer of quantized inputs. This runs before the conversion since rewrite patterns must 
+// not modify the schedule attribute.
+static void ScheduleLoopsForColumnMajorInput(mlir::decisionforest::PredictForestOp forestOp) {
+  auto dataMemrefType = forestOp.getData().getType().dyn_cast<MemRefType>();
+  if (!dataMemrefType || dataMemrefType.getShape().size() != 2 || !IsColumnMajor(dataMemrefType))
+    return;
+  if (forestOp.getEnsemble().GetDecisionForest().IsQuantized())
+    return;
+  auto schedule = forestOp.getSchedule().GetSchedule();
+  if (!schedule->IsDefaultSchedule())
+    return;
+  schedule->Reorder({&schedule->GetTreeIndex(), &schedule->GetBatchIndex()});
+}
+
 struct PredictForestOpLowering: public ConversionPattern {
   PredictForestOpLowering(MLIRContext *ctx) : ConversionPattern(mlir::decisionforest::PredictForestOp::getOperationName(), 1 /*benefit*/, ctx) {}
 
@@ -367,8 +429,28 @@ struct PredictForestOpLowering: public ConversionPattern {
         auto memrefType = inputArgument.getType().cast<mlir::MemRefType>();
         if (memrefType.getShape().size() != 2) // We can currently only deal with 2D memrefs as inputs
             return mlir::failure();
-        batchSize = memrefType.getShape()[0]; // The number of rows in our input memref is the batchsize
-        return LowerPredictForestOp_Schedule(op, forestOp, operands, rewriter, memrefType, batchSize);  
+        SmallVector<Value, 2> loweredOperands(operands.begin(), operands.end());
+        Value quantizedData;
+        if (forestOp.getEnsemble().GetDecisionForest().IsQuantized()) {
+          // The trees are walked on a dense row major buffer of quantized inputs
+          quantizedData = GenerateQuantizedInput(rewriter, op->getLoc(), forestOp, operands[0], memrefType);
+          loweredOperands[0] = quantizedData;
+          memrefType = quantizedData.getType().cast<mlir::MemRefType>();
+        }
+        LogicalResult result = mlir::failure();
+        if (memrefType.isDynamicDim(0)) {
+          result = LowerPredictForestOp_DynamicBatch(op, forestOp, loweredOperands, rewriter, memrefType);
+        }
+        else {
+          batchSize = memrefType.getShape()[0]; // The number of rows in our input memref is the batchsize
+          result = LowerPredictForestOp_Schedule(op, forestOp, loweredOperands, rewriter, memrefType, batchSize);  
+        }
+        // All trees have been walked once the lowered op's loops are done
+        if (quantizedData && succeeded(result)) {
+          rewriter.setInsertionPointAfter(op);
+          rewriter.create<memref::DeallocOp>(op->getLoc(), quantizedData);
+        }
+        return result;
     }
     else
     {
@@ -376,6 +458,116 @@ struct PredictForestOpLowering: public ConversionPattern {
         return mlir::failure();
     }
   }
+  // Replaces each input value with the index of its bin among the boundaries of its feature (see 
+  // DecisionForest::QuantizeThresholds) and returns a row major buffer of the bins in the threshold type.
+  // The binary search takes the same number of steps for every value and has no branches, so that the 
+  // loop over the values can be vectorized. NaNs are kept so that missing values are routed as before. 
+  // Values of features with no boundaries (unused or categorical features) are copied.
+  Value GenerateQuantizedInput(ConversionPatternRewriter &rewriter, Location location, mlir::decisionforest::PredictForestOp forestOp,
+                               Value data, MemRefType dataMemrefType) const {
+    auto& forest = forestOp.getEnsemble().GetDecisionForest();
+    auto forestType = forestOp.getEnsemble().getType().cast<decisionforest::TreeEnsembleType>();
+    auto thresholdType = forestType.getTreeType(0).cast<decisionforest::TreeType>().getThresholdType();
+    auto inputType = dataMemrefType.getElementType();
+    auto i32Type = rewriter.getI32Type();
+    int64_t numFeatures = dataMemrefType.getShape()[1];
+
+    std::vector<double> boundaries;
+    std::vector<int32_t> offsets(numFeatures, 0), counts(numFeatures, 0);
+    int32_t maxCount = 0;
+    auto& featureBoundaries = forest.GetQuantizationBoundaries();
+    for (int64_t i=0 ; i<numFeatures && i<(int64_t)featureBoundaries.size() ; ++i) {
+      if (featureBoundaries[i].empty())
+        continue;
+      offsets[i] = boundaries.size();
+      counts[i] = featureBoundaries[i].size();
+      maxCount = std::max(maxCount, counts[i]);
+      boundaries.insert(boundaries.end(), featureBoundaries[i].begin(), featureBoundaries[i].end());
+    }
+    // Features with no boundaries read (and ignore) the first boundary
+    if (boundaries.empty())
+      boundaries.push_back(0.0);
+
+    auto boundariesMemrefType = MemRefType::get({(int64_t)boundaries.size()}, inputType);
+    auto featureTableMemrefType = MemRefType::get({numFeatures}, i32Type);
+    {
+      auto module = forestOp->getParentOfType<mlir::ModuleOp>();
+      helpers::SaveAndRestoreInsertionPoint saveAndRestoreInsertPoint(rewriter);
+      rewriter.setInsertionPoint(&module.front());
+      decisionforest::createConstantGlobalOp(rewriter, location, "quantizationBoundaries", boundariesMemrefType, boundaries);
+      decisionforest::createConstantGlobalOp(rewriter, location, "quantizationOffsets", featureTableMemrefType, offsets);
+      decisionforest::createConstantGlobalOp(rewriter, location, "quantizationCounts", featureTableMemrefType, counts);
+    }
+    auto boundariesMemref = rewriter.create<memref::GetGlobalOp>(location, boundariesMemrefType, "quantizationBoundaries");
+    auto offsetsMemref = rewriter.create<memref::GetGlobalOp>(location, featureTableMemrefType, "quantizationOffsets");
+    auto countsMemref = rewriter.create<memref::GetGlobalOp>(location, featureTableMemrefType, "quantizationCounts");
+
+    Value numRows = rewriter.create<memref::DimOp>(location, data, static_cast<int64_t>(0));
+    auto quantizedMemrefType = MemRefType::get({dataMemrefType.getShape()[0], numFeatures}, thresholdType);
+    // The buffer holds a whole batch (which can be large or dynamic), so it is allocated on the heap and 
+    // freed once the trees have been walked (see matchAndRewrite)
+    Value quantizedData;
+    if (dataMemrefType.isDynamicDim(0))
+      quantizedData = rewriter.create<memref::AllocOp>(location, quantizedMemrefType, ValueRange{numRows});
+    else
+      quantizedData = rewriter.create<memref::AllocOp>(location, quantizedMemrefType);
+
+    // Column major inputs are read a feature at a time
+    bool columnMajor = IsColumnMajor(dataMemrefType);
+    auto zeroIndexConst = rewriter.create<arith::ConstantIndexOp>(location, 0);
+    auto oneIndexConst = rewriter.create<arith::ConstantIndexOp>(location, 1);
+    Value numFeaturesConst = rewriter.create<arith::ConstantIndexOp>(location, numFeatures);
+    auto outerLoop = rewriter.create<scf::ForOp>(location, zeroIndexConst, columnMajor ? numFeaturesConst : numRows, oneIndexConst);
+    rewriter.setInsertionPointToStart(outerLoop.getBody());
+    auto innerLoop = rewriter.create<scf::ForOp>(location, zeroIndexConst, columnMajor ? numRows : numFeaturesConst, oneIndexConst);
+    rewriter.setInsertionPointToStart(innerLoop.getBody());
+    {
+      Value rowIndex = columnMajor ? innerLoop.getInductionVar() : outerLoop.getInductionVar();
+      Value featureIndex = columnMajor ? outerLoop.getInductionVar() : innerLoop.getInductionVar();
+      Value value = rewriter.create<memref::LoadOp>(location, data, ValueRange{rowIndex, featureIndex});
+      Value offset = rewriter.create<memref::LoadOp>(location, offsetsMemref, ValueRange{featureIndex});
+      Value count = rewriter.create<memref::LoadOp>(location, countsMemref, ValueRange{featureIndex});
+
+      // bin is the number of boundaries below value. Each step adds step to it if the boundary at 
+      // bin + step - 1 is below value.
+      auto zeroConst = rewriter.create<arith::ConstantIntOp>(location, 0, i32Type);
+      auto oneConst = rewriter.create<arith::ConstantIntOp>(location, 1, i32Type);
+      Value searchEnd = rewriter.create<arith::MaxSIOp>(location, count, oneConst);
+      auto boundaryPredicate = forest.QuantizedBinsIncludeBoundaries() ? arith::CmpFPredicate::OLE : arith::CmpFPredicate::OLT;
+      Value bin = zeroConst;
+      int64_t step = 1;
+      while (2*step <= maxCount)
+        step *= 2;
+      for ( ; maxCount > 0 && step >= 1 ; step /= 2) {
+        auto stepConst = rewriter.create<arith::ConstantIntOp>(location, step, i32Type);
+        Value candidate = rewriter.create<arith::AddIOp>(location, bin, stepConst);
+        Value inRange = rewriter.create<arith::CmpIOp>(location, arith::CmpIPredicate::sle, candidate, count);
+        Value boundaryIndex = rewriter.create<arith::MinSIOp>(location, candidate, searchEnd);
+        boundaryIndex = rewriter.create<arith::AddIOp>(location, offset, boundaryIndex);
+        boundaryIndex = rewriter.create<arith::SubIOp>(location, boundaryIndex, oneConst);
+        boundaryIndex = rewriter.create<arith::IndexCastOp>(location, rewriter.getIndexType(), boundaryIndex);
+        Value boundary = rewriter.create<memref::LoadOp>(location, boundariesMemref, ValueRange{boundaryIndex});
+        Value isBelow = rewriter.create<arith::CmpFOp>(location, boundaryPredicate, boundary, value);
+        Value advance = rewriter.create<arith::AndIOp>(location, inRange, isBelow);
+        bin = rewriter.create<arith::SelectOp>(location, advance, candidate, bin);
+      }
+      Value quantizedValue = rewriter.create<arith::SIToFPOp>(location, thresholdType, bin);
+
+      Value convertedValue = value;
+      if (thresholdType.getIntOrFloatBitWidth() < inputType.getIntOrFloatBitWidth())
+        convertedValue = rewriter.create<arith::TruncFOp>(location, thresholdType, value);
+      else if (thresholdType.getIntOrFloatBitWidth() > inputType.getIntOrFloatBitWidth())
+        convertedValue = rewriter.create<arith::ExtFOp>(location, thresholdType, value);
+      Value isMissing = rewriter.create<arith::CmpFOp>(location, arith::CmpFPredicate::UNO, value, value);
+      Value hasNoBoundaries = rewriter.create<arith::CmpIOp>(location, arith::CmpIPredicate::eq, count, zeroConst);
+      Value keepValue = rewriter.create<arith::OrIOp>(location, isMissing, hasNoBoundaries);
+      Value result = rewriter.create<arith::SelectOp>(location, keepValue, convertedValue, quantizedValue);
+      rewriter.create<memref::StoreOp>(location, result, quantizedData, ValueRange{rowIndex, featureIndex});
+    }
+    rewriter.setInsertionPointAfter(outerLoop);
+    return quantizedData;
+  }
+
   Value GetRow(ConversionPatternRewriter &rewriter, Location location, Value data, Value rowIndex, MemRefType dataMemrefType) const {
     auto rowType = getRowTypeFromArgumentType(dataMemrefType);
     auto zeroIndexAttr = rewriter.getIndexAttr(0);
@@ -399,6 +591,32 @@ struct PredictForestOpLowering: public ConversionPattern {
     return row;
   }
 
+  void InitReductionState(PredictOpLoweringState& state, decisionforest::DecisionForest& forest, 
+                          decisionforest::ReductionType reductionType) const {
+    state.reductionType = reductionType;
+    state.averagingScales.clear();
+    if (reductionType == decisionforest::ReductionType::kAdd)
+      return;
+    auto numTrees = static_cast<double>(forest.NumTrees());
+    if (reductionType == decisionforest::ReductionType::kVoting) {
+      assert (state.isMultiClass && "Voting forests must have classes to vote for");
+      state.averagingScales.assign(forest.GetNumClasses(), 1.0/numTrees);
+      return;
+    }
+    assert (reductionType == decisionforest::ReductionType::kAverage);
+    std::vector<int64_t> treesPerClass(forest.GetNumOutputs(), 0);
+    for (auto& tree : forest.GetTrees())
+      ++treesPerClass.at(state.isMultiClass ? tree->GetClassId() : 0);
+    for (auto numClassTrees : treesPerClass)
+      state.averagingScales.push_back(numClassTrees == 0 ? 0.0 : 1.0/static_cast<double>(numClassTrees));
+  }
+
+  // The largest class sum is the largest class average if all classes are averaged over as many trees
+  bool ArgMaxNeedsAveraging(PredictOpLoweringState& state) const {
+    auto& scales = state.averagingScales;
+    return std::adjacent_find(scales.begin(), scales.end(), std::not_equal_to<double>()) != scales.end();
+  }
+
   void InitPredictOpLoweringState(
     ConversionPatternRewriter &rewriter,
     Location location,
@@ -419,6 +637,14 @@ struct PredictForestOpLowering: public ConversionPattern {
     state.forestConst = rewriter.create<mlir::decisionforest::EnsembleConstantOp>(location, forestType, forestAttribute);
 
     state.isMultiClass = forestAttribute.GetDecisionForest().IsMultiClassClassifier();
+    state.returnAllOutputs = state.resultMemrefType.getRank() == 2;
+    assert (!state.returnAllOutputs || state.isMultiClass);
+    state.predTransform = forestAttribute.GetDecisionForest().GetPredictionTransformation();
+    state.outputTransforms = forestAttribute.GetDecisionForest().GetOutputPredictionTransformations();
+    assert ((state.outputTransforms.empty() && forestAttribute.GetDecisionForest().GetOutputInitialOffsets().empty()) || 
+            state.returnAllOutputs);
+    state.fuseTransformation = false;
+    InitReductionState(state, forestAttribute.GetDecisionForest(), forestType.getReductionType());
     state.treeType = forestType.getTreeType(0).cast<mlir::decisionforest::TreeType>();
 
     // Initialize constants
@@ -436,31 +662,223 @@ struct PredictForestOpLowering: public ConversionPattern {
           dataMemrefType.getElementType());
 
       state.treeClassesMemref = rewriter.create<memref::AllocaOp>(location, state.treeClassesMemrefType);
+
+      auto& classInitialValues = forestAttribute.GetDecisionForest().GetOutputInitialOffsets();
+      if (!classInitialValues.empty())
+        state.classInitialValuesConst = CreateFPVectorConstant(rewriter, location, GetClassAccumulatorsVectorType(state), classInitialValues);
     }
 
     state.data = operands[0];
     state.dataMemrefType = dataMemrefType;
     state.cmpPredicate = forestOp.getPredicateAttr();
+
+    InitEarlyExitState(rewriter, location, state, forestOp);
+  }
+
+  template<typename T>
+  static T RoundEarlyExitBound(T value, bool up) {
+    return std::nextafter(value, up ? std::numeric_limits<T>::infinity() : -std::numeric_limits<T>::infinity());
+  }
+
+  // Let s be the sum of the predictions of trees [0, t). The label of the row is decided if
+  //   initialOffset + s + (sum of the smallest leaf values of trees [t, N)) > threshold (positive), or
+  //   initialOffset + s + (sum of the largest leaf values of trees [t, N)) <= threshold (negative).
+  // Entry t of the positive and negative bounds holds what s is compared to in these conditions. The bounds are 
+  // computed in the accumulator type T, rounding every step away from the threshold, and are then widened by one 
+  // ulp (at the largest magnitude the sum can reach) per remaining addition so that the rounding of the generated
+  // code's own additions, done in a different order, can't move a row across the threshold after it exits. Entry N
+  // is the same in both so that the loop always stops there.
+  template<typename T>
+  static void AddEarlyExitBoundsGlobals(ConversionPatternRewriter &rewriter, Location location, MemRefType boundsMemrefType,
+                                        const decisionforest::DecisionForest& forest, double predictionThreshold) {
+    auto numTrees = static_cast<int64_t>(forest.NumTrees());
+    std::vector<T> positiveBounds(numTrees + 1), negativeBounds(numTrees + 1);
+    auto threshold = static_cast<T>(predictionThreshold - forest.GetInitialOffset());
+    T remainingMin = 0, remainingMax = 0, remainingMagnitude = 0;
+    positiveBounds[numTrees] = negativeBounds[numTrees] = threshold;
+    for (int64_t t=numTrees-1 ; t>=0 ; --t) {
+      auto leafValueRange = forest.GetTree(t).GetLeafValueRange();
+      remainingMin = RoundEarlyExitBound<T>(remainingMin + static_cast<T>(leafValueRange.first), false);
+      remainingMax = RoundEarlyExitBound<T>(remainingMax + static_cast<T>(leafValueRange.second), true);
+      auto treeMagnitude = std::max(std::abs(leafValueRange.first), std::abs(leafValueRange.second));
+      remainingMagnitude = RoundEarlyExitBound<T>(remainingMagnitude + static_cast<T>(treeMagnitude), true);
+
+      auto maxMagnitude = RoundEarlyExitBound<T>(std::abs(threshold) + 2*remainingMagnitude, true);
+      auto slack = static_cast<T>(numTrees - t + 1) * (RoundEarlyExitBound<T>(maxMagnitude, true) - maxMagnitude);
+      positiveBounds[t] = RoundEarlyExitBound<T>(RoundEarlyExitBound<T>(threshold - remainingMin, true) + slack, true);
+      negativeBounds[t] = RoundEarlyExitBound<T>(RoundEarlyExitBound<T>(threshold - remainingMax, false) - slack, false);
+    }
+    decisionforest::createConstantGlobalOp(rewriter, location, "earlyExitPositiveBounds", boundsMemrefType, positiveBounds);
+    decisionforest::createConstantGlobalOp(rewriter, location, "earlyExitNegativeBounds", boundsMemrefType, negativeBounds);
+  }
+
+  void InitEarlyExitState(ConversionPatternRewriter &rewriter, Location location, PredictOpLoweringState& state,
+                          mlir::decisionforest::PredictForestOp forestOp) const {
+    auto& treeIndex = forestOp.getSchedule().GetSchedule()->GetTreeIndex();
+    if (!treeIndex.EarlyExit())
+      return;
+    auto& forest = forestOp.getEnsemble().GetDecisionForest();
+    assert (!state.isMultiClass && "Early exit is not supported for multi-class classifiers");
+    assert (forest.GetPredictionTransformation() == decisionforest::PredictionTransformation::kSigmoid);
+
+    auto numTrees = static_cast<int64_t>(forest.NumTrees());
+    auto accumulatorType = state.resultMemrefType.getElementType();
+    auto boundsMemrefType = MemRefType::get({numTrees + 1}, accumulatorType);
+    auto statisticsMemrefType = MemRefType::get({2}, rewriter.getI64Type());
+    {
+      auto module = forestOp->getParentOfType<mlir::ModuleOp>();
+      helpers::SaveAndRestoreInsertionPoint saveAndRestoreInsertPoint(rewriter);
+      rewriter.setInsertionPoint(&module.front());
+      if (accumulatorType.isF64())
+        AddEarlyExitBoundsGlobals<double>(rewriter, location, boundsMemrefType, forest, treeIndex.EarlyExitThreshold());
+      else if (accumulatorType.isF32())
+        AddEarlyExitBoundsGlobals<float>(rewriter, location, boundsMemrefType, forest, treeIndex.EarlyExitThreshold());
+      else
+        assert (false && "Unsupported prediction type for early exit");
+      
+      // Number of rows and trees walked over all calls. Read through Get_earlyExitStatistics at runtime.
+      auto zeroCounts = DenseElementsAttr::get(memref::getTensorTypeFromMemRefType(statisticsMemrefType), ArrayRef<int64_t>({0, 0}));
+      rewriter.create<memref::GlobalOp>(location, "earlyExitStatistics",
+                                        /*sym_visibility=*/rewriter.getStringAttr("private"),
+                                        /*type=*/statisticsMemrefType,
+                                        /*initial_value=*/zeroCounts,
+                                        /*constant=*/false, IntegerAttr());
+      helpers::AddGlobalMemrefGetter(module, "earlyExitStatistics", statisticsMemrefType, rewriter, location);
+    }
+    state.earlyExitPositiveBounds = rewriter.create<memref::GetGlobalOp>(location, boundsMemrefType, "earlyExitPositiveBounds");
+    state.earlyExitNegativeBounds = rewriter.create<memref::GetGlobalOp>(location, boundsMemrefType, "earlyExitNegativeBounds");
+    state.earlyExitStatistics = rewriter.create<memref::GetGlobalOp>(location, statisticsMemrefType, "earlyExitStatistics");
+
+    state.earlyExitCounts = rewriter.create<memref::AllocaOp>(location, statisticsMemrefType);
+    auto zeroCount = rewriter.create<arith::ConstantIntOp>(location, 0, rewriter.getI64Type());
+    for (int64_t i=0 ; i<2 ; ++i) {
+      auto index = rewriter.create<arith::ConstantIndexOp>(location, i);
+      rewriter.create<memref::StoreOp>(location, zeroCount, state.earlyExitCounts, ValueRange{index});
+    }
+  }
+
+  void AddToEarlyExitCount(ConversionPatternRewriter &rewriter, Location location, PredictOpLoweringState& state,
+                           int64_t countIndex, Value increment) const {
+    auto index = rewriter.create<arith::ConstantIndexOp>(location, countIndex);
+    auto currentCount = rewriter.create<memref::LoadOp>(location, state.earlyExitCounts, ValueRange{index});
+    auto newCount = rewriter.create<arith::AddIOp>(location, currentCount, increment);
+    rewriter.create<memref::StoreOp>(location, newCount, state.earlyExitCounts, ValueRange{index});
+  }
+
+  // Calls may run concurrently, so the counts of this call are added to the statistics atomically
+  void FlushEarlyExitCounts(ConversionPatternRewriter &rewriter, Location location, PredictOpLoweringState& state) const {
+    if (!state.earlyExitCounts)
+      return;
+    for (int64_t i=0 ; i<2 ; ++i) {
+      auto index = rewriter.create<arith::ConstantIndexOp>(location, i);
+      auto count = rewriter.create<memref::LoadOp>(location, state.earlyExitCounts, ValueRange{index});
+      rewriter.create<memref::AtomicRMWOp>(location, rewriter.getI64Type(), arith::AtomicRMWKind::addi, 
+                                           count, state.earlyExitStatistics, ValueRange{index});
+    }
   }
 
+  // The operand can be a scalar or a vector of floating point values
   Value GenSigmoid(ConversionPatternRewriter& rewriter, Value operand, Location location) const {
-    assert (operand.getType().isIntOrFloat());
+    auto elementType = getElementTypeOrSelf(operand.getType());
+    assert (elementType.isIntOrFloat());
     auto negate = rewriter.create<mlir::arith::NegFOp>(location, operand.getType(), operand);
     auto exponential = rewriter.create<mlir::math::ExpOp>(location, operand.getType(), static_cast<Value>(negate));
     
     Value oneConst;
-    if (operand.getType().isa<mlir::Float64Type>())
-      oneConst = rewriter.create<arith::ConstantFloatOp>(location, llvm::APFloat(1.0), operand.getType().cast<FloatType>());
-    else if(operand.getType().isa<mlir::Float32Type>())
-      oneConst = rewriter.create<arith::ConstantFloatOp>(location, llvm::APFloat((float)1.0), operand.getType().cast<FloatType>());
+    if (elementType.isa<mlir::Float64Type>())
+      oneConst = rewriter.create<arith::ConstantFloatOp>(location, llvm::APFloat(1.0), elementType.cast<FloatType>());
+    else if(elementType.isa<mlir::Float32Type>())
+      oneConst = rewriter.create<arith::ConstantFloatOp>(location, llvm::APFloat((float)1.0), elementType.cast<FloatType>());
     else
       assert(false && "Unsupported floating point type");
+    if (operand.getType().isa<VectorType>())
+      oneConst = rewriter.create<vector::BroadcastOp>(location, operand.getType(), oneConst);
 
     auto onePlusExp = rewriter.create<arith::AddFOp>(location, operand.getType(), oneConst, exponential);
     auto result = rewriter.create<arith::DivFOp>(location, operand.getType(), oneConst, onePlusExp);
     return result;
   }
 
+  // Applies an element-wise transformation to a scalar or a vector of predictions
+  Value GenTransformation(ConversionPatternRewriter& rewriter, Location location, Value prediction, 
+                          decisionforest::PredictionTransformation predTransform) const {
+    switch (predTransform) {
+      case decisionforest::PredictionTransformation::kIdentity:
+        return prediction;
+      case decisionforest::PredictionTransformation::kSigmoid:
+        return GenSigmoid(rewriter, prediction, location);
+      case decisionforest::PredictionTransformation::kExponential:
+        return rewriter.create<math::ExpOp>(location, prediction);
+      default:
+        assert(false && "Unsupported prediction transformation.");
+        return prediction;
+    }
+  }
+
+  // Applies the transformation of each output (see DecisionForest::GetOutputPredictionTransformations) to a vector 
+  // of outputs. Each distinct transformation is applied to the whole vector and its lanes are picked with a constant mask.
+  Value GenOutputTransformations(ConversionPatternRewriter& rewriter, Location location, Value outputs, PredictOpLoweringState& state) const {
+    auto vectorType = outputs.getType().cast<VectorType>();
+    auto maskType = VectorType::get(vectorType.getShape(), rewriter.getI1Type());
+    std::set<decisionforest::PredictionTransformation> transforms(state.outputTransforms.begin(), state.outputTransforms.end());
+    Value transformedOutputs = outputs;
+    for (auto transform : transforms) {
+      if (transform == decisionforest::PredictionTransformation::kIdentity)
+        continue;
+      SmallVector<bool> mask;
+      for (auto outputTransform : state.outputTransforms)
+        mask.push_back(outputTransform == transform);
+      auto maskConst = rewriter.create<arith::ConstantOp>(location, DenseElementsAttr::get(maskType, llvm::ArrayRef<bool>(mask)));
+      auto transformed = GenTransformation(rewriter, location, outputs, transform);
+      transformedOutputs = rewriter.create<arith::SelectOp>(location, maskConst, transformed, transformedOutputs);
+    }
+    return transformedOutputs;
+  }
+
+  // A single loop over all trees computes the whole prediction of a row if the tree index isn't tiled, split 
+  // or pipelined and is the innermost loop. The transformation can then be applied to the prediction before 
+  // it is stored instead of in another loop over the results once all trees are walked.
+  bool CanFuseTransformation(decisionforest::Schedule& schedule, PredictOpLoweringState& state) const {
+    if (state.isMultiClass || 
+        (state.predTransform == decisionforest::PredictionTransformation::kIdentity && state.reductionType == decisionforest::ReductionType::kAdd))
+      return false;
+    auto& treeIndex = schedule.GetTreeIndex();
+    return treeIndex.GetIndexModifier() == nullptr && treeIndex.GetContainedLoops().empty() && 
+           !treeIndex.Pipelined() && !treeIndex.Parallel() && 
+           treeIndex.GetGPUDimension().construct == decisionforest::IndexVariable::GPUConstruct::None;
+  }
+
+  Value GenAverage(ConversionPatternRewriter& rewriter, Location location, Value sum, PredictOpLoweringState& state) const {
+    if (state.reductionType != decisionforest::ReductionType::kAverage)
+      return sum;
+    auto scale = CreateFPConstant(rewriter, location, sum.getType(), state.averagingScales.front());
+    return rewriter.create<arith::MulFOp>(location, sum, scale);
+  }
+
+  // Multiplies a vector of class sums by the averaging scale of each class
+  Value GenClassAverages(ConversionPatternRewriter& rewriter, Location location, Value sums, PredictOpLoweringState& state) const {
+    if (state.reductionType == decisionforest::ReductionType::kAdd)
+      return sums;
+    auto vectorType = sums.getType().cast<VectorType>();
+    DenseElementsAttr scalesAttr;
+    if (vectorType.getElementType().isF64())
+      scalesAttr = DenseElementsAttr::get(vectorType, llvm::ArrayRef<double>(state.averagingScales));
+    else {
+      std::vector<float> scales(state.averagingScales.begin(), state.averagingScales.end());
+      scalesAttr = DenseElementsAttr::get(vectorType, llvm::ArrayRef<float>(scales));
+    }
+    auto scales = rewriter.create<arith::ConstantOp>(location, scalesAttr);
+    return rewriter.create<arith::MulFOp>(location, sums, scales);
+  }
+
+  // Computes the value stored for a row given its untransformed prediction
+  Value FinalizeRowPrediction(ConversionPatternRewriter& rewriter, Location location, Value prediction, PredictOpLoweringState& state) const {
+    if (!state.fuseTransformation)
+      return prediction;
+    prediction = GenAverage(rewriter, location, prediction, state);
+    return GenTransformation(rewriter, location, prediction, state.predTransform);
+  }
+
   Value GenArgMax(ConversionPatternRewriter& rewriter, Location location, PredictOpLoweringState& state, Value index) const {
       auto treeClassesMemref = GetRow(rewriter, location, state.treeClassesMemref, index, state.treeClassesMemrefType);
       auto treeClassElementType = treeClassesMemref.getType().cast<MemRefType>().getElementType();
@@ -551,8 +969,28 @@ struct PredictForestOpLowering: public ConversionPattern {
     return constValue;
   }
 
+  Value CreateFPVectorConstant(ConversionPatternRewriter &rewriter, Location location, VectorType vectorType, 
+                               const std::vector<double>& values) const {
+    DenseElementsAttr valuesAttr;
+    if (vectorType.getElementType().isF64())
+      valuesAttr = DenseElementsAttr::get(vectorType, llvm::ArrayRef<double>(values));
+    else {
+      std::vector<float> floatValues(values.begin(), values.end());
+      valuesAttr = DenseElementsAttr::get(vectorType, llvm::ArrayRef<float>(floatValues));
+    }
+    return rewriter.create<arith::ConstantOp>(location, valuesAttr);
+  }
+
   void InitializeTreeClassWeightsMemref(ConversionPatternRewriter &rewriter, Location location, PredictOpLoweringState& state) const {
-    if (state.isMultiClass) {
+    if (state.isMultiClass && state.classInitialValuesConst) {
+      // Store the initial values of all classes of a row at once
+      auto batchLoop = rewriter.create<scf::ForOp>(location, state.zeroIndexConst, state.batchSizeConst, state.oneIndexConst);
+      rewriter.setInsertionPointToStart(batchLoop.getBody());
+      SmallVector<Value, 2> indices{ batchLoop.getInductionVar(), state.zeroIndexConst };
+      rewriter.create<vector::StoreOp>(location, state.classInitialValuesConst, state.treeClassesMemref, indices);
+      rewriter.setInsertionPointAfter(batchLoop);
+    }
+    else if (state.isMultiClass) {
       auto outerLoop = rewriter.create<scf::ForOp>(location, state.zeroIndexConst, state.batchSizeConst, state.oneIndexConst);
       rewriter.setInsertionPointToStart(outerLoop.getBody());
       {
@@ -589,10 +1027,59 @@ struct PredictForestOpLowering: public ConversionPattern {
     rewriter.setInsertionPointAfter(batchLoop);
   }
 
+  // Writes the class accumulators of each row, transformed, to the [batch, numClasses] result. The classes 
+  // of a row are transformed as one vector. Softmax is computed as exp(x - max(x)) / sum(exp(x - max(x))) 
+  // so that exp can't overflow.
+  void WriteAllOutputsToResultMemref(ConversionPatternRewriter &rewriter, Location location, 
+                                     decisionforest::PredictionTransformation predTransform, PredictOpLoweringState& state) const {
+    auto numClasses = state.treeClassesMemrefType.getShape()[1];
+    auto accumulatorsType = VectorType::get({numClasses}, state.treeClassesMemrefType.getElementType());
+    auto outputsType = VectorType::get({numClasses}, state.resultMemrefType.getElementType());
+
+    auto batchLoop = rewriter.create<scf::ForOp>(location, state.zeroIndexConst, state.batchSizeConst, state.oneIndexConst);
+    rewriter.setInsertionPointToStart(batchLoop.getBody());
+    SmallVector<Value, 2> indices{ batchLoop.getInductionVar(), state.zeroIndexConst };
+    Value outputs = rewriter.create<vector::LoadOp>(location, accumulatorsType, state.treeClassesMemref, indices);
+    outputs = GenClassAverages(rewriter, location, outputs, state);
+    if (predTransform == decisionforest::PredictionTransformation::kSoftMax) {
+      auto maxOutput = rewriter.create<vector::ReductionOp>(location, vector::CombiningKind::MAXF, outputs);
+      auto maxOutputs = rewriter.create<vector::BroadcastOp>(location, accumulatorsType, static_cast<Value>(maxOutput));
+      auto shiftedOutputs = rewriter.create<arith::SubFOp>(location, outputs, maxOutputs);
+      auto exponentials = rewriter.create<math::ExpOp>(location, static_cast<Value>(shiftedOutputs));
+      auto sum = rewriter.create<vector::ReductionOp>(location, vector::CombiningKind::ADD, static_cast<Value>(exponentials));
+      auto sums = rewriter.create<vector::BroadcastOp>(location, accumulatorsType, static_cast<Value>(sum));
+      outputs = rewriter.create<arith::DivFOp>(location, exponentials, sums);
+    }
+    else if (!state.outputTransforms.empty()) {
+      outputs = GenOutputTransformations(rewriter, location, outputs, state);
+    }
+    else {
+      outputs = GenTransformation(rewriter, location, outputs, predTransform);
+    }
+
+    // The classes are accumulated in the input element type
+    auto accumulatorWidth = accumulatorsType.getElementTypeBitWidth(), outputWidth = outputsType.getElementTypeBitWidth();
+    if (accumulatorWidth > outputWidth)
+      outputs = rewriter.create<arith::TruncFOp>(location, outputsType, outputs);
+    else if (accumulatorWidth < outputWidth)
+      outputs = rewriter.create<arith::ExtFOp>(location, outputsType, outputs);
+    rewriter.create<vector::StoreOp>(location, outputs, state.resultMemref, indices);
+    rewriter.setInsertionPointAfter(batchLoop);
+  }
+
   void TransformResultMemref(
     ConversionPatternRewriter &rewriter, Location location, decisionforest::PredictionTransformation predTransform, PredictOpLoweringState& state) const {
     
-    if (predTransform == decisionforest::PredictionTransformation::kIdentity)
+    if (state.returnAllOutputs) {
+      WriteAllOutputsToResultMemref(rewriter, location, predTransform, state);
+      return;
+    }
+    // The transformations are monotonic, so multi-class models predict the class with the largest sum whatever 
+    // their transformation is
+    if (!state.isMultiClass && state.fuseTransformation)
+      return;
+    if (!state.isMultiClass && predTransform == decisionforest::PredictionTransformation::kIdentity && 
+        state.reductionType == decisionforest::ReductionType::kAdd)
       return;
 
     // assert (resultMemrefType.getElementType().isa<mlir::FloatType>());
@@ -605,19 +1092,58 @@ struct PredictForestOpLowering: public ConversionPattern {
     
     auto memrefElem = rewriter.create<memref::LoadOp>(location, state.resultMemref, i);
     Value transformedValue;
-    if (predTransform == decisionforest::PredictionTransformation::kSigmoid)
-      transformedValue = GenSigmoid(rewriter, static_cast<Value>(memrefElem), location);
-    else if (predTransform == decisionforest::PredictionTransformation::kSoftMax)
+    if (state.isMultiClass) {
+      if (ArgMaxNeedsAveraging(state))
+        AverageClassAccumulators(rewriter, location, state, i);
       transformedValue = GenArgMax(rewriter, location, state, i);
-    else
-      assert(false && "Unsupported prediction transformation.");
+    }
+    else {
+      auto average = GenAverage(rewriter, location, static_cast<Value>(memrefElem), state);
+      transformedValue = GenTransformation(rewriter, location, average, predTransform);
+    }
 
     rewriter.create<memref::StoreOp>(location, transformedValue, state.resultMemref, i);
     rewriter.setInsertionPointAfter(batchLoop);
   }
 
+  VectorType GetClassAccumulatorsVectorType(PredictOpLoweringState& state) const {
+    return VectorType::get({state.treeClassesMemrefType.getShape()[1]}, state.treeClassesMemrefType.getElementType());
+  }
+
+  void AverageClassAccumulators(ConversionPatternRewriter& rewriter, Location location, PredictOpLoweringState& state, Value rowIndex) const {
+    SmallVector<Value, 2> indices{ rowIndex, state.zeroIndexConst };
+    Value sums = rewriter.create<vector::LoadOp>(location, GetClassAccumulatorsVectorType(state), state.treeClassesMemref, indices);
+    auto averages = GenClassAverages(rewriter, location, sums, state);
+    rewriter.create<vector::StoreOp>(location, averages, state.treeClassesMemref, indices);
+  }
+
+  // Adds the vote of a tree (the class index in its leaf) to the vote counts of the row. The counts are updated 
+  // with a single vector add of the one-hot encoding of the vote rather than with a load and store at a 
+  // data dependent index.
+  void GenerateVoteCount(ConversionPatternRewriter& rewriter, Location location, Value vote, Value rowIndex, PredictOpLoweringState& state) const {
+    auto countsType = GetClassAccumulatorsVectorType(state);
+    auto numClasses = countsType.getShape()[0];
+    auto classIndicesType = VectorType::get({numClasses}, rewriter.getI32Type());
+    std::vector<int32_t> classIndices(numClasses);
+    std::iota(classIndices.begin(), classIndices.end(), 0);
+    auto classIndicesConst = rewriter.create<arith::ConstantOp>(location, DenseElementsAttr::get(classIndicesType, llvm::ArrayRef<int32_t>(classIndices)));
+
+    auto voteIndex = rewriter.create<arith::FPToSIOp>(location, rewriter.getI32Type(), vote);
+    auto voteIndices = rewriter.create<vector::BroadcastOp>(location, classIndicesType, static_cast<Value>(voteIndex));
+    auto isVote = rewriter.create<arith::CmpIOp>(location, arith::CmpIPredicate::eq, classIndicesConst, voteIndices);
+    auto oneHotVote = rewriter.create<arith::UIToFPOp>(location, countsType, static_cast<Value>(isVote));
+
+    SmallVector<Value, 2> indices{ rowIndex, state.zeroIndexConst };
+    auto counts = rewriter.create<vector::LoadOp>(location, countsType, state.treeClassesMemref, indices);
+    auto newCounts = rewriter.create<arith::AddFOp>(location, counts, oneHotVote);
+    rewriter.create<vector::StoreOp>(location, newCounts, state.treeClassesMemref, indices);
+  }
+
   void GenerateMultiClassAccumulate(ConversionPatternRewriter& rewriter, Location location, Value result, Value rowIndex, Value index, PredictOpLoweringState& state) const {
-    if (state.isMultiClass) {
+    if (state.isMultiClass && state.reductionType == decisionforest::ReductionType::kVoting) {
+      GenerateVoteCount(rewriter, location, result, rowIndex, state);
+    }
+    else if (state.isMultiClass) {
       auto batchTreeClassMemref = GetRow(rewriter, location, state.treeClassesMemref, rowIndex, state.treeClassesMemrefType);
       auto classId = rewriter.create<decisionforest::GetTreeClassIdOp>(location, state.treeType.getResultType(), state.forestConst, index);
       auto classIdIndex = rewriter.create<arith::IndexCastOp>(location, rewriter.getIndexType(), static_cast<Value>(classId));
@@ -675,7 +1201,7 @@ struct PredictForestOpLowering: public ConversionPattern {
     if (state.isMultiClass) return prevAccumulatorValue;
 
     // Accumulate the tree prediction
-    assert(forestType.getReductionType() == decisionforest::ReductionType::kAdd);
+    assert(forestType.getReductionType() != decisionforest::ReductionType::kVoting || state.isMultiClass);
     auto accumulatedValue = rewriter.create<arith::AddFOp>(location, state.resultMemrefType.getElementType(), prevAccumulatorValue, walkOp);
 
     if (mlir::decisionforest::InsertDebugHelpers) {
@@ -688,6 +1214,49 @@ struct PredictForestOpLowering: public ConversionPattern {
     return accumulatedValue;
   }
 
+  // Walks trees [startIndex, N) on one row while its label isn't decided and returns the sum of their predictions. 
+  // Ordered comparisons are false for NaN, so the loop also stops if the sum is NaN. At t=N the positive and negative 
+  // bounds are equal, so the loop never reads past the end of the bounds.
+  Value GenerateEarlyExitTreeLoop(ConversionPatternRewriter &rewriter,
+                                  Location location,
+                                  const decisionforest::IndexVariable& indexVar,
+                                  std::list<Value> treeIndices,
+                                  PredictOpLoweringState& state,
+                                  Value row,
+                                  Value rowIndex,
+                                  Value startIndex) const {
+    auto indexType = rewriter.getIndexType();
+    auto accumulatorType = state.resultMemrefType.getElementType();
+    auto zeroConst = CreateFPConstant(rewriter, location, accumulatorType, 0.0);
+    auto whileLoop = rewriter.create<scf::WhileOp>(location, TypeRange{indexType, accumulatorType}, ValueRange{startIndex, zeroConst});
+    {
+      auto before = rewriter.createBlock(&whileLoop.getBefore(), {}, TypeRange{indexType, accumulatorType}, {location, location});
+      auto treeIndex = before->getArgument(0);
+      auto accumulatedValue = before->getArgument(1);
+      auto positiveBound = rewriter.create<memref::LoadOp>(location, state.earlyExitPositiveBounds, ValueRange{treeIndex});
+      auto negativeBound = rewriter.create<memref::LoadOp>(location, state.earlyExitNegativeBounds, ValueRange{treeIndex});
+      auto notPositive = rewriter.create<arith::CmpFOp>(location, arith::CmpFPredicate::OLE, accumulatedValue, positiveBound);
+      auto notNegative = rewriter.create<arith::CmpFOp>(location, arith::CmpFPredicate::OGT, accumulatedValue, negativeBound);
+      auto undecided = rewriter.create<arith::AndIOp>(location, notPositive, notNegative);
+      rewriter.create<scf::ConditionOp>(location, undecided, before->getArguments());
+    }
+    {
+      auto after = rewriter.createBlock(&whileLoop.getAfter(), {}, TypeRange{indexType, accumulatorType}, {location, location});
+      auto treeIndex = after->getArgument(0);
+      treeIndices.push_back(treeIndex);
+      auto accumulatedValue = GenerateTreeIndexLeafLoopBody(rewriter, location, indexVar, treeIndices, state, row, rowIndex, after->getArgument(1));
+      auto nextTreeIndex = rewriter.create<arith::AddIOp>(location, treeIndex, state.oneIndexConst);
+      rewriter.create<scf::YieldOp>(location, ValueRange{static_cast<Value>(nextTreeIndex), accumulatedValue});
+    }
+    rewriter.setInsertionPointAfter(whileLoop);
+
+    auto treesWalked = rewriter.create<arith::SubIOp>(location, whileLoop.getResult(0), startIndex);
+    auto oneCount = rewriter.create<arith::ConstantIntOp>(location, 1, rewriter.getI64Type());
+    AddToEarlyExitCount(rewriter, location, state, 0, oneCount);
+    AddToEarlyExitCount(rewriter, location, state, 1, rewriter.create<arith::IndexCastOp>(location, rewriter.getI64Type(), treesWalked));
+    return whileLoop.getResult(1);
+  }
+
   Value GeneratePipelinedTreeIndexLeafLoopBody(
     ConversionPatternRewriter &rewriter,
     Location location,
@@ -736,7 +1305,7 @@ struct PredictForestOpLowering: public ConversionPattern {
       }
       else {
           // Accumulate the tree prediction
-        assert(forestType.getReductionType() == decisionforest::ReductionType::kAdd);
+        assert(forestType.getReductionType() != decisionforest::ReductionType::kVoting || state.isMultiClass);
         prevAccumulatorValue = rewriter.create<arith::AddFOp>(location, state.resultMemrefType.getElementType(), prevAccumulatorValue, walkOp.getResult(i));
       }
 
@@ -762,7 +1331,20 @@ struct PredictForestOpLowering: public ConversionPattern {
     // Get the current row
     Value row = GetRow(rewriter, location, state.data, rowIndexForRowRead, state.dataMemrefType);
 
-    if(indexVar.Unroll()) {
+    if (indexVar.EarlyExit()) {
+      auto range = indexVar.GetRange();
+      assert (!indexVar.Unroll() && !indexVar.Pipelined() && range.m_step == 1);
+      assert (range.m_stop == state.forestConst.getType().cast<decisionforest::TreeEnsembleType>().getNumberOfTrees() && 
+              "Early exit needs the tree loop to run till the last tree");
+      auto startConst = rewriter.create<arith::ConstantIndexOp>(location, range.m_start);
+      auto rowPrediction = GenerateEarlyExitTreeLoop(rewriter, location, indexVar, treeIndices, state, row, rowIndex, startConst);
+
+      auto currentMemrefElem = rewriter.create<memref::LoadOp>(location, state.resultMemref, ValueRange{rowIndex});
+      Value newMemrefElem = rewriter.create<arith::AddFOp>(location, state.resultMemrefType.getElementType(), rowPrediction, currentMemrefElem);
+      newMemrefElem = FinalizeRowPrediction(rewriter, location, newMemrefElem, state);
+      rewriter.create<memref::StoreOp>(location, newMemrefElem, state.resultMemref, ValueRange{rowIndex});
+    }
+    else if(indexVar.Unroll()) {
       auto range = indexVar.GetRange();
       auto zeroConst = CreateFPConstant(rewriter, location, state.dataMemrefType.getElementType(), 0.0);      
       Value accumulatedValue = zeroConst;
@@ -777,7 +1359,8 @@ struct PredictForestOpLowering: public ConversionPattern {
 
       // Generate the store back in to the result memref
       auto currentMemrefElem = rewriter.create<memref::LoadOp>(location, state.resultMemref, ValueRange{rowIndex});
-      auto newMemrefElem = rewriter.create<arith::AddFOp>(location, state.resultMemrefType.getElementType(), accumulatedValue, currentMemrefElem);
+      Value newMemrefElem = rewriter.create<arith::AddFOp>(location, state.resultMemrefType.getElementType(), accumulatedValue, currentMemrefElem);
+      newMemrefElem = FinalizeRowPrediction(rewriter, location, newMemrefElem, state);
       rewriter.create<memref::StoreOp>(location, newMemrefElem, state.resultMemref, ValueRange{rowIndex});
     }
     else if (indexVar.Pipelined()) {
@@ -890,7 +1473,8 @@ struct PredictForestOpLowering: public ConversionPattern {
       
       // Generate the store back in to the result memref
       auto currentMemrefElem = rewriter.create<memref::LoadOp>(location, state.resultMemref, ValueRange{rowIndex});
-      auto newMemrefElem = rewriter.create<arith::AddFOp>(location, state.resultMemrefType.getElementType(), loopResult, currentMemrefElem);
+      Value newMemrefElem = rewriter.create<arith::AddFOp>(location, state.resultMemrefType.getElementType(), loopResult, currentMemrefElem);
+      newMemrefElem = FinalizeRowPrediction(rewriter, location, newMemrefElem, state);
       rewriter.create<memref::StoreOp>(location, newMemrefElem, state.resultMemref, ValueRange{rowIndex});
 
       // rewriter.create<gpu::PrintfOp>(location, "Writing result[%d] = %lf + %lf: %lf\n", ValueRange{rowIndex, currentMemrefElem, loop.getResults()[0], newMemrefElem});
@@ -1014,7 +1598,7 @@ struct PredictForestOpLowering: public ConversionPattern {
     // Get the current tree
     auto forestType = state.forestConst.getType().cast<decisionforest::TreeEnsembleType>();
     assert (forestType.doAllTreesHaveSameTileSize()); // TODO how do we check which type of tree we'll get here?
-    assert(forestType.getReductionType() == decisionforest::ReductionType::kAdd);
+    assert(forestType.getReductionType() != decisionforest::ReductionType::kVoting || state.isMultiClass);
     auto treeType = forestType.getTreeType(0).cast<mlir::decisionforest::TreeType>();
     auto tree = rewriter.create<decisionforest::GetTreeFromEnsembleOp>(location, treeType, state.forestConst, treeIndex);
 
@@ -1270,22 +1854,15 @@ struct PredictForestOpLowering: public ConversionPattern {
     }
   }
 
-  LogicalResult
-  LowerPredictForestOp_Schedule(Operation *op, mlir::decisionforest::PredictForestOp forestOp, ArrayRef<Value> operands, ConversionPatternRewriter &rewriter, 
-                            mlir::MemRefType dataMemrefType, int64_t batchSize) const
-  {
-    PredictOpLoweringState state;
-
-    auto location = op->getLoc();
-    assert (dataMemrefType.getElementType().isa<mlir::FloatType>());
-
+  void GenerateScheduledLoopNest(ConversionPatternRewriter &rewriter, Location location, mlir::decisionforest::PredictForestOp forestOp,
+                                 PredictOpLoweringState& state) const {
     // First initialize the result memref to zeros (This is not always needed, for example for the default schedule, but leaving that optimization out for now)
-    InitPredictOpLoweringState(rewriter, location, state, forestOp, operands, dataMemrefType, batchSize);
     InitializeResultMemref(rewriter, location, state);
     InitializeTreeClassWeightsMemref(rewriter, location, state);
 
     auto scheduleAttribute = forestOp.getSchedule();
     auto& schedule = *scheduleAttribute.GetSchedule();
+    state.fuseTransformation = CanFuseTransformation(schedule, state);
 
     // Generate the loop nest
     auto rootIndex = schedule.GetRootIndex();
@@ -1295,6 +1872,125 @@ struct PredictForestOpLowering: public ConversionPattern {
 
     // Generate the transformations to compute final prediction (sigmoid etc)
     TransformResultMemref(rewriter, location, forestOp.getEnsemble().GetDecisionForest().GetPredictionTransformation(), state);
+    FlushEarlyExitCounts(rewriter, location, state);
+  }
+
+  // Walks all trees for one row at a time over the first state.batchSizeConst rows. The schedule 
+  // is ignored here since it assumes a full batch (rows still exit early if the tree loop does).
+  void GenerateRemainderLoopNest(ConversionPatternRewriter &rewriter, Location location, mlir::decisionforest::PredictForestOp forestOp,
+                                 PredictOpLoweringState& state) const {
+    InitializeResultMemref(rewriter, location, state);
+    InitializeTreeClassWeightsMemref(rewriter, location, state);
+    // Each row's prediction is computed by a single loop over all trees
+    state.fuseTransformation = !state.isMultiClass;
+
+    auto forestType = state.forestConst.getType().cast<decisionforest::TreeEnsembleType>();
+    assert (forestType.doAllTreesHaveSameTileSize());
+    assert(forestType.getReductionType() != decisionforest::ReductionType::kVoting || state.isMultiClass);
+    auto treeType = forestType.getTreeType(0).cast<mlir::decisionforest::TreeType>();
+    auto numTreesConst = rewriter.create<arith::ConstantIndexOp>(location, forestType.getNumberOfTrees());
+    auto zeroConst = CreateFPConstant(rewriter, location, state.dataMemrefType.getElementType(), 0.0);
+
+    auto batchLoop = rewriter.create<scf::ForOp>(location, state.zeroIndexConst, state.batchSizeConst, state.oneIndexConst);
+    rewriter.setInsertionPointToStart(batchLoop.getBody());
+    {
+      auto rowIndex = batchLoop.getInductionVar();
+      auto row = GetRow(rewriter, location, state.data, rowIndex, state.dataMemrefType);
+
+      Value rowPrediction;
+      if (state.earlyExitCounts) {
+        auto& treeIndexVar = forestOp.getSchedule().GetSchedule()->GetTreeIndex();
+        rowPrediction = GenerateEarlyExitTreeLoop(rewriter, location, treeIndexVar, std::list<Value>{}, state, row, rowIndex, state.zeroIndexConst);
+      }
+      else {
+        auto treeLoop = rewriter.create<scf::ForOp>(location, state.zeroIndexConst, numTreesConst, state.oneIndexConst, ValueRange{ zeroConst });
+        rewriter.setInsertionPointToStart(treeLoop.getBody());
+        {
+          auto treeIndex = treeLoop.getInductionVar();
+          auto tree = rewriter.create<decisionforest::GetTreeFromEnsembleOp>(location, treeType, state.forestConst, treeIndex);
+          Value walkOp = rewriter.create<decisionforest::WalkDecisionTreeOp>(location, 
+                                                                             treeType.getThresholdType(),
+                                                                             state.cmpPredicate,
+                                                                             tree,
+                                                                             row);
+          GenerateMultiClassAccumulate(rewriter, location, walkOp, rowIndex, treeIndex, state);
+          Value accumulatedValue = treeLoop.getBody()->getArguments()[1];
+          if (!state.isMultiClass)
+            accumulatedValue = rewriter.create<arith::AddFOp>(location, state.resultMemrefType.getElementType(), accumulatedValue, walkOp);
+          rewriter.create<scf::YieldOp>(location, accumulatedValue);
+        }
+        rewriter.setInsertionPointAfter(treeLoop);
+        rowPrediction = treeLoop.getResult(0);
+      }
+
+      if (!state.isMultiClass) {
+        auto currentMemrefElem = rewriter.create<memref::LoadOp>(location, state.resultMemref, ValueRange{rowIndex});
+        Value newMemrefElem = rewriter.create<arith::AddFOp>(location, state.resultMemrefType.getElementType(), rowPrediction, currentMemrefElem);
+        newMemrefElem = FinalizeRowPrediction(rewriter, location, newMemrefElem, state);
+        rewriter.create<memref::StoreOp>(location, newMemrefElem, state.resultMemref, ValueRange{rowIndex});
+      }
+    }
+    rewriter.setInsertionPointAfter(batchLoop);
+
+    TransformResultMemref(rewriter, location, forestOp.getEnsemble().GetDecisionForest().GetPredictionTransformation(), state);
+    FlushEarlyExitCounts(rewriter, location, state);
+  }
+
+  LogicalResult
+  LowerPredictForestOp_Schedule(Operation *op, mlir::decisionforest::PredictForestOp forestOp, ArrayRef<Value> operands, ConversionPatternRewriter &rewriter, 
+                            mlir::MemRefType dataMemrefType, int64_t batchSize) const
+  {
+    PredictOpLoweringState state;
+
+    auto location = op->getLoc();
+    assert (dataMemrefType.getElementType().isa<mlir::FloatType>());
+
+    InitPredictOpLoweringState(rewriter, location, state, forestOp, operands, dataMemrefType, batchSize);
+    GenerateScheduledLoopNest(rewriter, location, forestOp, state);
+    rewriter.replaceOp(op, static_cast<Value>(state.resultMemref));
+    return mlir::success();
+  }
+
+  // The input has a dynamic number of rows. If we get exactly a full batch, the scheduled loop nest 
+  // runs on statically shaped casts of the arguments. Fewer rows are handled by the remainder loop nest.
+  LogicalResult
+  LowerPredictForestOp_DynamicBatch(Operation *op, mlir::decisionforest::PredictForestOp forestOp, ArrayRef<Value> operands, 
+                                    ConversionPatternRewriter &rewriter, mlir::MemRefType dataMemrefType) const
+  {
+    PredictOpLoweringState state;
+
+    auto location = op->getLoc();
+    assert (dataMemrefType.getElementType().isa<mlir::FloatType>());
+
+    auto& schedule = *forestOp.getSchedule().GetSchedule();
+    int64_t batchSize = schedule.GetBatchSize();
+    InitPredictOpLoweringState(rewriter, location, state, forestOp, operands, dataMemrefType, batchSize);
+
+    auto numRows = rewriter.create<memref::DimOp>(location, state.data, static_cast<int64_t>(0));
+    auto isFullBatch = rewriter.create<arith::CmpIOp>(location, arith::CmpIPredicate::eq, static_cast<Value>(numRows), state.batchSizeConst);
+    auto ifFullBatch = rewriter.create<scf::IfOp>(location, TypeRange{}, static_cast<Value>(isFullBatch), true);
+    {
+      rewriter.setInsertionPointToStart(ifFullBatch.thenBlock());
+      auto staticDataMemrefType = MemRefType::get({batchSize, dataMemrefType.getShape()[1]}, dataMemrefType.getElementType(),
+                                                  dataMemrefType.getLayout());
+      auto staticResultShape = llvm::to_vector(state.resultMemrefType.getShape());
+      staticResultShape[0] = batchSize;
+      auto staticResultMemrefType = MemRefType::get(staticResultShape, state.resultMemrefType.getElementType());
+      
+      PredictOpLoweringState fullBatchState = state;
+      fullBatchState.data = rewriter.create<memref::CastOp>(location, staticDataMemrefType, state.data);
+      fullBatchState.dataMemrefType = staticDataMemrefType;
+      fullBatchState.resultMemref = rewriter.create<memref::CastOp>(location, staticResultMemrefType, state.resultMemref);
+      fullBatchState.resultMemrefType = staticResultMemrefType;
+      GenerateScheduledLoopNest(rewriter, location, forestOp, fullBatchState);
+    }
+    {
+      rewriter.setInsertionPointToStart(ifFullBatch.elseBlock());
+      PredictOpLoweringState remainderState = state;
+      remainderState.batchSizeConst = numRows;
+      GenerateRemainderLoopNest(rewriter, location, forestOp, remainderState);
+    }
+    rewriter.setInsertionPointAfter(ifFullBatch);
     rewriter.replaceOp(op, static_cast<Value>(state.resultMemref));
     return mlir::success();
   }
@@ -1303,17 +1999,20 @@ struct PredictForestOpLowering: public ConversionPattern {
 
 struct HighLevelIRToMidLevelIRLoweringPass: public PassWrapper<HighLevelIRToMidLevelIRLoweringPass, OperationPass<mlir::ModuleOp>> {
   void getDependentDialects(DialectRegistry &registry) const override {
-    registry.insert<AffineDialect, memref::MemRefDialect, scf::SCFDialect>();
+    registry.insert<AffineDialect, memref::MemRefDialect, scf::SCFDialect, vector::VectorDialect>();
   }
   void runOnOperation() final {
     ConversionTarget target(getContext());
 
     target.addLegalDialect<memref::MemRefDialect, scf::SCFDialect, 
                            decisionforest::DecisionForestDialect, math::MathDialect,
-                           arith::ArithDialect, func::FuncDialect, gpu::GPUDialect>();
+                           arith::ArithDialect, func::FuncDialect, gpu::GPUDialect,
+                           vector::VectorDialect>();
 
     target.addIllegalOp<decisionforest::PredictForestOp>();
 
+    getOperation().walk([](decisionforest::PredictForestOp forestOp) { ScheduleLoopsForColumnMajorInput(forestOp); });
+
     RewritePatternSet patterns(&getContext());
     patterns.add<PredictForestOpLowering>(&getContext());
 
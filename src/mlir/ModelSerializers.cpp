@@ -5,6 +5,7 @@
 #include "ModelSerializers.h"
 #include "../gpu/GPUModelSerializers.h"
 #include "TreebeardContext.h"
+#include "ThreadPool.h"
 
 namespace 
 {
@@ -119,56 +120,74 @@ void ArraySparseSerializerBase::ReadData() {
 // Persistence Helper Methods
 // ===---------------------------------------------------=== //
 
-template<typename PersistTreeScalarType, typename PersistTreeTiledType>
+// Serialized values of a single tree. Trees are serialized in parallel and then added to the reader 
+// in tree order so that the persisted model doesn't depend on the number of threads.
+struct SerializedTree {
+    std::vector<ThresholdType> thresholds, leaves;
+    std::vector<FeatureIndexType> featureIndices;
+    std::vector<int32_t> tileShapeIDs, childIndices;
+    int32_t numTiles = 0;
+    int32_t tileSize = 0;
+    int32_t classId = 0;
+};
+
+template<typename SerializeTreeScalarType, typename SerializeTreeTiledType, typename AddTreeType>
 void PersistDecisionForestImpl(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType,
-                               PersistTreeScalarType persistTreeScalar, PersistTreeTiledType persistTreeTiled) {
+                               mlir::decisionforest::ForestJSONReader& forestJSONReader,
+                               SerializeTreeScalarType serializeTreeScalar, SerializeTreeTiledType serializeTreeTiled,
+                               AddTreeType addTree) {
     
-    mlir::decisionforest::ForestJSONReader::GetInstance().ClearAllData();
+    forestJSONReader.ClearAllData();
 
     auto numTrees = forest.NumTrees();
-    mlir::decisionforest::ForestJSONReader::GetInstance().SetNumberOfTrees(numTrees);
-    mlir::decisionforest::ForestJSONReader::GetInstance().SetNumberOfClasses(forest.GetNumClasses());
+    forestJSONReader.SetNumberOfTrees(numTrees);
+    forestJSONReader.SetNumberOfClasses(forest.GetNumClasses());
+
+    // TODO We're assuming that the threshold type is a float type and index type 
+    // is an integer. This is just to get the size. Can we get the size differently?
+    // auto thresholdType = treeType.getThresholdType().cast<FloatType>();
+    // auto featureIndexType = treeType.getFeatureIndexType().cast<IntegerType>(); 
+    auto treeType = forestType.getTreeType(0).cast<decisionforest::TreeType>();
+    uint tileShapeBitWidth = treeType.getTileShapeType().getIntOrFloatBitWidth();
+    assert (tileShapeBitWidth != 0);
+
+    std::vector<SerializedTree> serializedTrees(numTrees);
+    {
+        TreeBeard::Logging::PhaseTimer timer("Serialize trees");
+        TreeBeard::GetCompilerThreadPool().ParallelFor(numTrees, [&](int64_t begin, int64_t end) {
+            for (int64_t i=begin ; i<end ; ++i) {
+                auto& tree = forest.GetTree(i);
+                if (tree.TilingDescriptor().MaxTileSize() == 1)
+                    serializedTrees[i] = serializeTreeScalar(tree);
+                else
+                    serializedTrees[i] = serializeTreeTiled(*tree.GetTiledTree());
+            }
+        });
+    }
 
     std::vector<TiledTreeStats> treeStats;
     std::vector<int32_t> numberOfTileShapes, numberOfOriginalTileShapes, numberOfNonSubsetTiles;
     std::vector<double> expectedNumberOfHops, idealExpectedNumberOfHops;
-    uint tileShapeBitWidth = 0;
     for (size_t i=0; i<numTrees ; ++i) {
-        auto treeType = forestType.getTreeType(0).cast<decisionforest::TreeType>();
-        
-        auto currentTreeTileShapeBitWidth = treeType.getTileShapeType().getIntOrFloatBitWidth();
-        assert (tileShapeBitWidth==0 || currentTreeTileShapeBitWidth==tileShapeBitWidth);
-        tileShapeBitWidth=currentTreeTileShapeBitWidth;
-
-        // TODO We're assuming that the threshold type is a float type and index type 
-        // is an integer. This is just to get the size. Can we get the size differently?
-        // auto thresholdType = treeType.getThresholdType().cast<FloatType>();
-        // auto featureIndexType = treeType.getFeatureIndexType().cast<IntegerType>(); 
+        addTree(serializedTrees[i], i, treeType);
 
         auto& tree = forest.GetTree(static_cast<int64_t>(i));
-        if (tree.TilingDescriptor().MaxTileSize() == 1) {
-            persistTreeScalar(tree, i, treeType);
-        }
-        else {
+        if (tree.TilingDescriptor().MaxTileSize() != 1 && TreeBeard::Logging::loggingOptions.logTreeStats) {
             TiledTree& tiledTree = *tree.GetTiledTree();
             // std::string dotFile = "/home/ashwin/mlir-build/llvm-project/mlir/examples/tree-heavy/debug/temp/tiledTree_" + std::to_string(i) + ".dot";
             // tiledTree.WriteDOTFile(dotFile);
-            persistTreeTiled(tiledTree, i, treeType);
-            if (TreeBeard::Logging::loggingOptions.logTreeStats) {
-                auto tiledTreeStats=tiledTree.GetTreeStats();
-                treeStats.push_back(tiledTreeStats);
-                numberOfTileShapes.push_back(tiledTree.GetNumberOfTileShapes());
-                numberOfOriginalTileShapes.push_back(tiledTree.GetNumberOfOriginalTileShapes());
-                auto expectedHops = tiledTree.ComputeExpectedNumberOfTileEvaluations();
-                expectedNumberOfHops.push_back(std::get<0>(expectedHops));
-                // std::cout << std::get<1>(expectedHops) << " ";
-                idealExpectedNumberOfHops.push_back(std::get<1>(expectedHops));
-                numberOfNonSubsetTiles.push_back(tiledTree.GetNumberOfTilesThatAreNotSubsets());
-            }
+            auto tiledTreeStats=tiledTree.GetTreeStats();
+            treeStats.push_back(tiledTreeStats);
+            numberOfTileShapes.push_back(tiledTree.GetNumberOfTileShapes());
+            numberOfOriginalTileShapes.push_back(tiledTree.GetNumberOfOriginalTileShapes());
+            auto expectedHops = tiledTree.ComputeExpectedNumberOfTileEvaluations();
+            expectedNumberOfHops.push_back(std::get<0>(expectedHops));
+            // std::cout << std::get<1>(expectedHops) << " ";
+            idealExpectedNumberOfHops.push_back(std::get<1>(expectedHops));
+            numberOfNonSubsetTiles.push_back(tiledTree.GetNumberOfTilesThatAreNotSubsets());
         }
     }
-    assert (tileShapeBitWidth != 0);
-    mlir::decisionforest::ForestJSONReader::GetInstance().SetTileShapeBitWidth(tileShapeBitWidth);
+    forestJSONReader.SetTileShapeBitWidth(tileShapeBitWidth);
     
     if (TreeBeard::Logging::loggingOptions.logTreeStats) {
         LogTreeStats(treeStats);
@@ -179,85 +198,83 @@ void PersistDecisionForestImpl(mlir::decisionforest::DecisionForest& forest, mli
         LogTileShapeStats(numberOfNonSubsetTiles, "Non subset tiles");
     }
 
-    mlir::decisionforest::ForestJSONReader::GetInstance().WriteJSONFile();
+    forestJSONReader.WriteJSONFile();
     
     // The below lines clear the model globals json file path that is currently persisted. This is to test that 
     // all state is correctly being read back from the model globals json file.
-    mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath("");
+    forestJSONReader.SetFilePath("");
 }
 
 // Ultimately, this will write a JSON file. For now, we're just 
 // storing it in memory assuming the compiler and inference 
 // will run in the same process. 
-void PersistDecisionForestArrayBased(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType) {
-    PersistDecisionForestImpl(forest, forestType,
-            [](DecisionTree& tree, int32_t treeNumber, decisionforest::TreeType treeType) {
-                std::vector<ThresholdType> thresholds = tree.GetThresholdArray();
-                std::vector<FeatureIndexType> featureIndices = tree.GetFeatureIndexArray();
-                std::vector<int32_t> tileShapeIDs = { };
-                int32_t numTiles = tree.GetNumberOfTiles();
-                int32_t tileSize = tree.TilingDescriptor().MaxTileSize();
-                mlir::decisionforest::ForestJSONReader::GetInstance().AddSingleTree(
-                    treeNumber,
-                    numTiles,
-                    thresholds,
-                    featureIndices,
-                    tileShapeIDs,
-                    tileSize,
-                    treeType.getThresholdType().getIntOrFloatBitWidth(),
-                    treeType.getFeatureIndexType().getIntOrFloatBitWidth(),
-                    (int8_t)tree.GetClassId());
+void PersistDecisionForestArrayBased(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType,
+                                     mlir::decisionforest::ForestJSONReader& forestJSONReader) {
+    PersistDecisionForestImpl(forest, forestType, forestJSONReader,
+            [](DecisionTree& tree) {
+                SerializedTree serializedTree;
+                serializedTree.thresholds = tree.GetThresholdArray();
+                serializedTree.featureIndices = tree.GetFeatureIndexArray();
+                serializedTree.numTiles = tree.GetNumberOfTiles();
+                serializedTree.tileSize = tree.TilingDescriptor().MaxTileSize();
+                serializedTree.classId = tree.GetClassId();
+                return serializedTree;
             },
-            [](TiledTree& tiledTree, int32_t treeNumber, decisionforest::TreeType treeType) {
-                std::vector<ThresholdType> thresholds = tiledTree.SerializeThresholds();
-                std::vector<FeatureIndexType> featureIndices = tiledTree.SerializeFeatureIndices();
-                std::vector<int32_t> tileShapeIDs = tiledTree.SerializeTileShapeIDs();
-                int32_t numTiles = tiledTree.GetNumberOfTiles();
-                int32_t tileSize = tiledTree.TileSize();
-                mlir::decisionforest::ForestJSONReader::GetInstance().AddSingleTree(
+            [](TiledTree& tiledTree) {
+                SerializedTree serializedTree;
+                serializedTree.thresholds = tiledTree.SerializeThresholds();
+                serializedTree.featureIndices = tiledTree.SerializeFeatureIndices();
+                serializedTree.tileShapeIDs = tiledTree.SerializeTileShapeIDs();
+                serializedTree.numTiles = tiledTree.GetNumberOfTiles();
+                serializedTree.tileSize = tiledTree.TileSize();
+                serializedTree.classId = tiledTree.GetClassId();
+                return serializedTree;
+            },
+            [&forestJSONReader](SerializedTree& serializedTree, int32_t treeNumber, decisionforest::TreeType treeType) {
+                forestJSONReader.AddSingleTree(
                     treeNumber,
-                    numTiles,
-                    thresholds,
-                    featureIndices,tileShapeIDs, tileSize,
+                    serializedTree.numTiles,
+                    serializedTree.thresholds,
+                    serializedTree.featureIndices,
+                    serializedTree.tileShapeIDs,
+                    serializedTree.tileSize,
                     treeType.getThresholdType().getIntOrFloatBitWidth(),
                     treeType.getFeatureIndexType().getIntOrFloatBitWidth(),
-                    (int8_t)tiledTree.GetClassId()); // TODO - Support tiled trees.
+                    (int8_t)serializedTree.classId);
             }
     );
 }
 
-void PersistDecisionForestSparse(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType) {
-    PersistDecisionForestImpl(forest, forestType,
-            [](DecisionTree& tree, int32_t treeNumber, decisionforest::TreeType treeType) {
-                std::vector<ThresholdType> thresholds = tree.GetSparseThresholdArray(), leaves;
-                std::vector<FeatureIndexType> featureIndices = tree.GetSparseFeatureIndexArray();
-                std::vector<int32_t> childIndices = tree.GetChildIndexArray();
-                std::vector<int32_t> tileShapeIDs = { };
-                int32_t numTiles = childIndices.size();
-                int32_t tileSize = tree.TilingDescriptor().MaxTileSize();
-                int32_t classId = tree.GetClassId();
-                mlir::decisionforest::ForestJSONReader::GetInstance().AddSingleSparseTree(treeNumber, numTiles, thresholds, featureIndices, tileShapeIDs, childIndices, 
-                                                                                    leaves, tileSize, treeType.getThresholdType().getIntOrFloatBitWidth(), 
-                                                                                    treeType.getFeatureIndexType().getIntOrFloatBitWidth(), classId);
-                auto childIndexBitWidth = treeType.getChildIndexType().getIntOrFloatBitWidth();
-                mlir::decisionforest::ForestJSONReader::GetInstance().SetChildIndexBitWidth(childIndexBitWidth);
+void PersistDecisionForestSparse(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType,
+                                 mlir::decisionforest::ForestJSONReader& forestJSONReader) {
+    PersistDecisionForestImpl(forest, forestType, forestJSONReader,
+            [](DecisionTree& tree) {
+                SerializedTree serializedTree;
+                serializedTree.thresholds = tree.GetSparseThresholdArray();
+                serializedTree.featureIndices = tree.GetSparseFeatureIndexArray();
+                serializedTree.childIndices = tree.GetChildIndexArray();
+                serializedTree.numTiles = serializedTree.childIndices.size();
+                serializedTree.tileSize = tree.TilingDescriptor().MaxTileSize();
+                serializedTree.classId = tree.GetClassId();
+                return serializedTree;
             },
-            [](TiledTree& tiledTree, int32_t treeNumber, decisionforest::TreeType treeType) {
-                std::vector<ThresholdType> thresholds;
-                std::vector<FeatureIndexType> featureIndices;
-                std::vector<int32_t> tileShapeIDs, leafBitMasks;
-                std::vector<int32_t> childIndices, leafIndices;
-                std::vector<double> leaves;
-                tiledTree.GetSparseSerialization(thresholds, featureIndices, tileShapeIDs, childIndices, leaves);
-                int32_t numTiles = tileShapeIDs.size();
-                int32_t tileSize = tiledTree.TileSize();
-                int32_t classId = tiledTree.GetClassId();
-                mlir::decisionforest::ForestJSONReader::GetInstance().AddSingleSparseTree(treeNumber, numTiles, thresholds, featureIndices, tileShapeIDs, childIndices,
-                                                                                    leaves, tileSize, treeType.getThresholdType().getIntOrFloatBitWidth(), 
-                                                                                    treeType.getFeatureIndexType().getIntOrFloatBitWidth(), classId);
-                
+            [](TiledTree& tiledTree) {
+                SerializedTree serializedTree;
+                tiledTree.GetSparseSerialization(serializedTree.thresholds, serializedTree.featureIndices, serializedTree.tileShapeIDs,
+                                                 serializedTree.childIndices, serializedTree.leaves);
+                serializedTree.numTiles = serializedTree.tileShapeIDs.size();
+                serializedTree.tileSize = tiledTree.TileSize();
+                serializedTree.classId = tiledTree.GetClassId();
+                return serializedTree;
+            },
+            [&forestJSONReader](SerializedTree& serializedTree, int32_t treeNumber, decisionforest::TreeType treeType) {
+                forestJSONReader.AddSingleSparseTree(treeNumber, serializedTree.numTiles, serializedTree.thresholds, 
+                                                     serializedTree.featureIndices, serializedTree.tileShapeIDs, 
+                                                     serializedTree.childIndices, serializedTree.leaves, serializedTree.tileSize, 
+                                                     treeType.getThresholdType().getIntOrFloatBitWidth(), 
+                                                     treeType.getFeatureIndexType().getIntOrFloatBitWidth(), serializedTree.classId);
                 auto childIndexBitWidth = treeType.getChildIndexType().getIntOrFloatBitWidth();
-                mlir::decisionforest::ForestJSONReader::GetInstance().SetChildIndexBitWidth(childIndexBitWidth);
+                forestJSONReader.SetChildIndexBitWidth(childIndexBitWidth);
             }
     );
 }
@@ -268,8 +285,8 @@ void PersistDecisionForestSparse(mlir::decisionforest::DecisionForest& forest, m
 
 void SparseRepresentationSerializer::Persist(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType) {
     assert (false && "We should no longer be persisting into a JSON on CPU!");
-    mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath(m_filepath);
-    PersistDecisionForestSparse(forest, forestType);
+    m_forestJSONReader.SetFilePath(m_filepath);
+    PersistDecisionForestSparse(forest, forestType, m_forestJSONReader);
 }
 
 void SparseRepresentationSerializer::InitializeBuffersImpl() {
@@ -282,14 +299,33 @@ std::shared_ptr<IModelSerializer> ConstructSparseRepresentation(const std::strin
 
 REGISTER_SERIALIZER(sparse, ConstructSparseRepresentation)
 
+// ===---------------------------------------------------=== //
+// HybridRepresentationSerializer Methods
+// ===---------------------------------------------------=== //
+
+void HybridRepresentationSerializer::Persist(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType) {
+    // The hybrid layout is only generated into the model globals of the compiled module
+    assert (false && "We should no longer be persisting into a JSON on CPU!");
+}
+
+void HybridRepresentationSerializer::InitializeBuffersImpl() {
+    InitializeModelArray();
+}
+
+std::shared_ptr<IModelSerializer> ConstructHybridRepresentation(const std::string& jsonFilename) {
+  return std::make_shared<HybridRepresentationSerializer>(jsonFilename);
+}
+
+REGISTER_SERIALIZER(hybrid, ConstructHybridRepresentation)
+
 // ===---------------------------------------------------=== //
 // ArrayRepresentationSerializer Methods
 // ===---------------------------------------------------=== //
 
 void ArrayRepresentationSerializer::Persist(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType) {
     assert (false && "We should no longer be persisting into a JSON on CPU!");
-    mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath(m_filepath);
-    PersistDecisionForestArrayBased(forest, forestType);
+    m_forestJSONReader.SetFilePath(m_filepath);
+    PersistDecisionForestArrayBased(forest, forestType, m_forestJSONReader);
 }
 
 void ArrayRepresentationSerializer::InitializeBuffersImpl() {
@@ -327,19 +363,27 @@ bool ModelSerializerFactory::RegisterSerializer(const std::string& name,
   return true;
 }
 
-std::shared_ptr<IModelSerializer> ConstructModelSerializer(const std::string& modelGlobalsJSONPath) {
-  if (decisionforest::UseSparseTreeRepresentation)
+std::shared_ptr<IModelSerializer> ConstructModelSerializer(const std::string& modelGlobalsJSONPath, bool sparseRepresentation) {
+  if (sparseRepresentation)
     return ModelSerializerFactory::Get().GetModelSerializer("sparse", modelGlobalsJSONPath);
   else
     return ModelSerializerFactory::Get().GetModelSerializer("array", modelGlobalsJSONPath);
 }
 
-std::shared_ptr<IModelSerializer> ConstructGPUModelSerializer(const std::string& modelGlobalsJSONPath) {
-  if (decisionforest::UseSparseTreeRepresentation)
+std::shared_ptr<IModelSerializer> ConstructGPUModelSerializer(const std::string& modelGlobalsJSONPath, bool sparseRepresentation) {
+  if (sparseRepresentation)
     return ModelSerializerFactory::Get().GetModelSerializer("gpu_sparse", modelGlobalsJSONPath);
   else
     return ModelSerializerFactory::Get().GetModelSerializer("gpu_array", modelGlobalsJSONPath);
 }
 
+std::shared_ptr<IModelSerializer> ConstructModelSerializer(const std::string& modelGlobalsJSONPath) {
+  return ConstructModelSerializer(modelGlobalsJSONPath, decisionforest::UseSparseTreeRepresentation);
+}
+
+std::shared_ptr<IModelSerializer> ConstructGPUModelSerializer(const std::string& modelGlobalsJSONPath) {
+  return ConstructGPUModelSerializer(modelGlobalsJSONPath, decisionforest::UseSparseTreeRepresentation);
+}
+
 }
 }
\ No newline at end of file
@@ -18,7 +18,9 @@ protected:
 public:
   ArraySparseSerializerBase(const std::string& modelGlobalsJSONPath, bool sparseRep)
     :IModelSerializer(modelGlobalsJSONPath), m_sparseRepresentation(sparseRep)
-  { }
+  { 
+    m_forestJSONReader.SetSparseRepresentation(sparseRep);
+  }
   ~ArraySparseSerializerBase() { }
 
   void ReadData() override;
@@ -46,6 +48,17 @@ public:
   void Persist(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType) override;
 };
 
+class HybridRepresentationSerializer : public ArraySparseSerializerBase {
+protected:
+  void InitializeBuffersImpl() override;
+public:
+  HybridRepresentationSerializer(const std::string& modelGlobalsJSONPath)
+    :ArraySparseSerializerBase(modelGlobalsJSONPath, true)
+  { }
+  ~HybridRepresentationSerializer() {}
+  void Persist(mlir::decisionforest::DecisionForest& forest, mlir::decisionforest::TreeEnsembleType forestType) override;
+};
+
 class ModelSerializerFactory {
 public:
   typedef std::shared_ptr<IModelSerializer> 
@@ -62,9 +75,10 @@ public:
 
 #define REGISTER_SERIALIZER(name, func) __attribute__((unused)) static bool UNIQUE_NAME(register_serializer_) = ModelSerializerFactory::Get().RegisterSerializer(#name, func);
 
-// TODO This function needs to be removed
-// Helper to construct the right serializer to work around the 
-// global "UseSparseRepresentation"
+// Construct the serializer of the array or sparse representation. The overloads without the flag use the 
+// process wide default (UseSparseTreeRepresentation). Compilations should pass CompilerOptions::sparseRepresentation.
+std::shared_ptr<IModelSerializer> ConstructModelSerializer(const std::string& modelGlobalsJSONPath, bool sparseRepresentation);
+std::shared_ptr<IModelSerializer> ConstructGPUModelSerializer(const std::string& modelGlobalsJSONPath, bool sparseRepresentation);
 std::shared_ptr<IModelSerializer> ConstructModelSerializer(const std::string& modelGlobalsJSONPath);
 std::shared_ptr<IModelSerializer> ConstructGPUModelSerializer(const std::string& modelGlobalsJSONPath);
 
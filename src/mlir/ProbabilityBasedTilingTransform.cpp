@@ -15,11 +15,13 @@
 #include "mlir/Pass/Pass.h"
 #include "mlir/Pass/PassManager.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include <atomic>
 #include <set>
 #include <cassert>
 #include "Logger.h"
 #include "OpLoweringUtils.h"
 #include "TiledTree.h"
+#include "ThreadPool.h"
 
 namespace mlir {
 namespace decisionforest {
@@ -29,15 +31,17 @@ struct TileEnsembleAttribute : public RewritePattern {
   Type m_tileShapeType;
   bool m_hybrid;
   double m_tilingThreshold;
+  bool m_peeledCodeGen;
 
-  TileEnsembleAttribute(MLIRContext *ctx, int32_t tileSize, Type tileShapeType) 
+  TileEnsembleAttribute(MLIRContext *ctx, int32_t tileSize, Type tileShapeType, bool peeledCodeGen) 
     : RewritePattern(mlir::decisionforest::PredictForestOp::getOperationName(), 1 /*benefit*/, ctx),
-      m_tileSize(tileSize), m_tileShapeType(tileShapeType), m_hybrid(false), m_tilingThreshold(0.0)
+      m_tileSize(tileSize), m_tileShapeType(tileShapeType), m_hybrid(false), m_tilingThreshold(0.0), m_peeledCodeGen(peeledCodeGen)
   {}
 
-  TileEnsembleAttribute(MLIRContext *ctx, int32_t tileSize, Type tileShapeType, bool hybrid, double tilingThreshold) 
+  TileEnsembleAttribute(MLIRContext *ctx, int32_t tileSize, Type tileShapeType, bool hybrid, double tilingThreshold, bool peeledCodeGen) 
     : RewritePattern(mlir::decisionforest::PredictForestOp::getOperationName(), 1 /*benefit*/, ctx),
-      m_tileSize(tileSize), m_tileShapeType(tileShapeType), m_hybrid(hybrid), m_tilingThreshold(tilingThreshold)
+      m_tileSize(tileSize), m_tileShapeType(tileShapeType), m_hybrid(hybrid), m_tilingThreshold(tilingThreshold), 
+      m_peeledCodeGen(peeledCodeGen)
   {}
 
   LogicalResult matchAndRewrite(Operation *op, PatternRewriter &rewriter) const final {
@@ -55,24 +59,27 @@ struct TileEnsembleAttribute : public RewritePattern {
       return mlir::failure();
 
     assert (tilingDescriptor.MaxTileSize() == 1 && "Forest shouldn't already be tiled!");
-    std::vector<Type> treeTypes;
-    int32_t numTreesTiledProbabilistically = 0;
-    for (int64_t i=0 ; i<(int64_t)forest.NumTrees() ; ++i) {
-      forest.GetTree(i).InitializeInternalNodeHitCounts();
-      
-      auto tiledProbabilistically = TileSingleDecisionTree(forest.GetTree(i));
-      numTreesTiledProbabilistically += tiledProbabilistically ? 1 : 0;
-      if (mlir::decisionforest::PeeledCodeGenForProbabiltyBasedTiling && tiledProbabilistically) {
-        auto tiledTree = forest.GetTree(i).GetTiledTree();
-        tiledTree->SetProbabilisticallyTiled(tiledProbabilistically);
-        // Set the number of levels that need to be peeled.
-        const double inputFractionToCover = 0.9;
-        auto levelsToPeel = tiledTree->NumberOfLevelsNeededToCoverInputs(inputFractionToCover);
-        tiledTree->SetLevelsToUnroll(levelsToPeel);
+    // Trees are tiled independently, so tile them in parallel. Types are created on this thread.
+    std::atomic<int32_t> numTreesTiledProbabilistically(0);
+    TreeBeard::GetCompilerThreadPool().ParallelFor(forest.NumTrees(), [&](int64_t begin, int64_t end) {
+      for (int64_t i=begin ; i<end ; ++i) {
+        forest.GetTree(i).InitializeInternalNodeHitCounts();
+        
+        auto tiledProbabilistically = TileSingleDecisionTree(forest.GetTree(i));
+        numTreesTiledProbabilistically += tiledProbabilistically ? 1 : 0;
+        if (m_peeledCodeGen && tiledProbabilistically) {
+          auto tiledTree = forest.GetTree(i).GetTiledTree();
+          tiledTree->SetProbabilisticallyTiled(tiledProbabilistically);
+          // Set the number of levels that need to be peeled.
+          const double inputFractionToCover = 0.9;
+          auto levelsToPeel = tiledTree->NumberOfLevelsNeededToCoverInputs(inputFractionToCover);
+          tiledTree->SetLevelsToUnroll(levelsToPeel);
+        }
       }
-      // if (tiledProbabilistically) 
-      //   std::cout << i << " ";
+    });
 
+    std::vector<Type> treeTypes;
+    for (int64_t i=0 ; i<(int64_t)forest.NumTrees() ; ++i) {
       auto treeType = forestType.getTreeType(i).cast<decisionforest::TreeType>();
       auto newTreeType = decisionforest::TreeType::get(treeType.getResultType(), forest.GetTree(i).TilingDescriptor().MaxTileSize(), 
                                                        treeType.getThresholdType(), treeType.getFeatureIndexType(), m_tileShapeType, 
@@ -83,7 +90,7 @@ struct TileEnsembleAttribute : public RewritePattern {
     }
     // std::cout << std::endl;
 
-    TreeBeard::Logging::Log("Number of trees tiled probabilistically : " + std::to_string(numTreesTiledProbabilistically));
+    TreeBeard::Logging::Log("Number of trees tiled probabilistically : " + std::to_string(numTreesTiledProbabilistically.load()));
     // Tile this forest uniformly
     auto newForestType = decisionforest::TreeEnsembleType::get(forestType.getResultType(), forestType.getNumberOfTrees(),
                                                                forestType.getRowType(), forestType.getReductionType(), treeTypes.at(0));
@@ -214,11 +221,13 @@ struct ProbabilityBasedTilingPass : public PassWrapper<ProbabilityBasedTilingPas
   int32_t m_tileShapeBitWidth;
   bool m_hybrid;
   double m_tilingThreshold;
-  ProbabilityBasedTilingPass(int32_t tileSize, int32_t tileShapeBitWidth) 
-    : m_tileSize(tileSize), m_tileShapeBitWidth(tileShapeBitWidth), m_hybrid(false), m_tilingThreshold(0.0)
+  bool m_peeledCodeGen;
+  ProbabilityBasedTilingPass(int32_t tileSize, int32_t tileShapeBitWidth, bool peeledCodeGen) 
+    : m_tileSize(tileSize), m_tileShapeBitWidth(tileShapeBitWidth), m_hybrid(false), m_tilingThreshold(0.0), m_peeledCodeGen(peeledCodeGen)
   { }
-  ProbabilityBasedTilingPass(int32_t tileSize, int32_t tileShapeBitWidth, bool hybrid, double tilingThreshold) 
-    : m_tileSize(tileSize), m_tileShapeBitWidth(tileShapeBitWidth), m_hybrid(hybrid), m_tilingThreshold(tilingThreshold)
+  ProbabilityBasedTilingPass(int32_t tileSize, int32_t tileShapeBitWidth, bool hybrid, double tilingThreshold, bool peeledCodeGen) 
+    : m_tileSize(tileSize), m_tileShapeBitWidth(tileShapeBitWidth), m_hybrid(hybrid), m_tilingThreshold(tilingThreshold),
+      m_peeledCodeGen(peeledCodeGen)
   { }
   void getDependentDialects(DialectRegistry &registry) const override {
     registry.insert<AffineDialect, memref::MemRefDialect, scf::SCFDialect, math::MathDialect>();
@@ -226,7 +235,7 @@ struct ProbabilityBasedTilingPass : public PassWrapper<ProbabilityBasedTilingPas
   void runOnOperation() final {
     RewritePatternSet patterns(&getContext());
     auto tileShapeType = IntegerType::get(&getContext(), m_tileShapeBitWidth);
-    patterns.add<TileEnsembleAttribute>(&getContext(), m_tileSize, tileShapeType, m_hybrid, m_tilingThreshold);
+    patterns.add<TileEnsembleAttribute>(&getContext(), m_tileSize, tileShapeType, m_hybrid, m_tilingThreshold, m_peeledCodeGen);
 
     if (failed(applyPatternsAndFoldGreedily(getOperation(), std::move(patterns))))
         signalPassFailure();
@@ -239,18 +248,20 @@ namespace mlir
 {
 namespace decisionforest
 {
-void DoProbabilityBasedTiling(mlir::MLIRContext& context, mlir::ModuleOp module, int32_t tileSize, int32_t tileShapeBitWidth) {
+void DoProbabilityBasedTiling(mlir::MLIRContext& context, mlir::ModuleOp module, int32_t tileSize, int32_t tileShapeBitWidth,
+                              bool peeledCodeGen) {
   mlir::PassManager pm(&context);
-  pm.addPass(std::make_unique<ProbabilityBasedTilingPass>(tileSize, tileShapeBitWidth));
+  pm.addPass(std::make_unique<ProbabilityBasedTilingPass>(tileSize, tileShapeBitWidth, peeledCodeGen));
 
   if (mlir::failed(pm.run(module))) {
     llvm::errs() << "Lowering to mid level IR failed.\n";
   }
 }
 
-void DoHybridTiling(mlir::MLIRContext& context, mlir::ModuleOp module, int32_t tileSize, int32_t tileShapeBitWidth) {
+void DoHybridTiling(mlir::MLIRContext& context, mlir::ModuleOp module, int32_t tileSize, int32_t tileShapeBitWidth,
+                    bool peeledCodeGen) {
   mlir::PassManager pm(&context);
-  pm.addPass(std::make_unique<ProbabilityBasedTilingPass>(tileSize, tileShapeBitWidth, true, 0.20));
+  pm.addPass(std::make_unique<ProbabilityBasedTilingPass>(tileSize, tileShapeBitWidth, true, 0.20, peeledCodeGen));
 
   if (mlir::failed(pm.run(module))) {
     llvm::errs() << "Lowering to mid level IR failed.\n";
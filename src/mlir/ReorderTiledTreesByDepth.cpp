@@ -17,7 +17,10 @@
 #include "mlir/Pass/PassManager.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include <queue>
+#include <algorithm>
 #include <cassert>
+#include <limits>
+#include <set>
 #include "TiledTree.h"
 
 using namespace mlir;
@@ -354,6 +357,243 @@ struct SplitTreeLoopByDepth : public PassWrapper<SplitTreeLoopByDepth, Operation
   }
 };
 
+// Orders the trees of forests whose tree loop exits early by decreasing range of leaf values. 
+// The bounds on the prediction of the trees that haven't been walked yet then tighten as fast 
+// as possible, so rows can stop after fewer trees.
+struct ReorderTreesByContributionPattern : public RewritePattern {
+
+  ReorderTreesByContributionPattern(MLIRContext *ctx) 
+    : RewritePattern(mlir::decisionforest::PredictForestOp::getOperationName(), 1 /*benefit*/, ctx)
+  {}
+
+  static double GetContribution(decisionforest::DecisionTree& tree) {
+    auto leafValueRange = tree.GetLeafValueRange();
+    return leafValueRange.second - leafValueRange.first;
+  }
+
+  static bool CompareContributions(const std::shared_ptr<decisionforest::DecisionTree>& tree1,
+                                   const std::shared_ptr<decisionforest::DecisionTree>& tree2) {
+    return GetContribution(*tree1) > GetContribution(*tree2);
+  }
+
+  LogicalResult matchAndRewrite(Operation *op, PatternRewriter &rewriter) const final {
+    mlir::decisionforest::PredictForestOp predictOp = llvm::dyn_cast<mlir::decisionforest::PredictForestOp>(op);
+    assert(predictOp);
+    if (!predictOp)
+         return mlir::failure();
+
+    auto schedule = predictOp.getSchedule().GetSchedule();
+    if (!schedule->GetTreeIndex().EarlyExit())
+      return mlir::failure();
+
+    auto forestAttribute = predictOp.getEnsemble();
+    auto forest = forestAttribute.GetDecisionForest();
+    auto forestType = forestAttribute.getType().cast<decisionforest::TreeEnsembleType>();
+    auto& trees = forest.GetTrees();
+    if (std::is_sorted(trees.begin(), trees.end(), CompareContributions))
+      return mlir::failure();
+
+    std::stable_sort(trees.begin(), trees.end(), CompareContributions);
+
+    auto newForestAttribute = decisionforest::DecisionForestAttribute::get(forestType, forest);
+    auto reorderedPredictForestOp = rewriter.create<decisionforest::PredictForestOp>(op->getLoc(), 
+                                                                                     predictOp.getResult().getType(), 
+                                                                                     newForestAttribute,
+                                                                                     predictOp.getPredicateAttr(), 
+                                                                                     predictOp.getData(),
+                                                                                     predictOp.getResult(),
+                                                                                     predictOp.getSchedule());
+    rewriter.replaceOp(op, static_cast<Value>(reorderedPredictForestOp));
+    return mlir::success();
+  }
+};
+
+struct ReorderTreesByContributionPass : public PassWrapper<ReorderTreesByContributionPass, OperationPass<mlir::ModuleOp>> {
+  ReorderTreesByContributionPass() 
+  { }
+  void getDependentDialects(DialectRegistry &registry) const override {
+    registry.insert<AffineDialect, memref::MemRefDialect, scf::SCFDialect, math::MathDialect>();
+  }
+  void runOnOperation() final {
+    RewritePatternSet patterns(&getContext());
+    patterns.add<ReorderTreesByContributionPattern>(&getContext());
+
+    if (failed(applyPatternsAndFoldGreedily(getOperation(), std::move(patterns))))
+        signalPassFailure();
+  }
+};
+
+// Groups are built greedily : a group starts with the first tree that isn't in a group yet and then takes
+// the remaining tree whose cache lines (those of the features it splits on, counted from the start of a row) 
+// are most similar (by the Jaccard index, estimated with MinHash signatures) to those of the group, until the 
+// tile's copies of the group's cache lines no longer fit in the L1 budget. Lines rather than features are 
+// counted since adjacent features are loaded together.
+namespace
+{
+const int32_t NumHashFunctions = 32;
+// Bytes of L1 that the lines of a group may take for a tile of rows
+const int64_t L1FeatureBudgetInBytes = 16 * 1024;
+const int64_t CacheLineBytes = 64;
+
+typedef std::vector<uint64_t> Signature;
+
+std::set<int64_t> GetCacheLines(decisionforest::DecisionTree& tree, int64_t inputElementBytes) {
+  std::set<int64_t> cacheLines;
+  for (auto& node : tree.GetNodes())
+    if (!node.IsLeaf())
+      cacheLines.insert(static_cast<int64_t>(node.featureIndex) * inputElementBytes / CacheLineBytes);
+  return cacheLines;
+}
+
+// Min over the lines of hash functions (a*l + b) mod p with fixed coefficients so that groups are deterministic
+Signature ComputeSignature(const std::set<int64_t>& cacheLines) {
+  const uint64_t prime = (1ULL << 61) - 1;
+  Signature signature(NumHashFunctions, std::numeric_limits<uint64_t>::max());
+  for (int32_t i=0 ; i<NumHashFunctions ; ++i) {
+    uint64_t a = 0x9E3779B97F4A7C15ULL * (i + 1) % prime;
+    uint64_t b = 0xC2B2AE3D27D4EB4FULL * (i + 7) % prime;
+    for (auto cacheLine : cacheLines) {
+      auto hash = static_cast<uint64_t>((static_cast<__uint128_t>(a) * static_cast<uint64_t>(cacheLine) + b) % prime);
+      signature[i] = std::min(signature[i], hash);
+    }
+  }
+  return signature;
+}
+
+double EstimateSimilarity(const Signature& signature1, const Signature& signature2) {
+  int32_t matches = 0;
+  for (int32_t i=0 ; i<NumHashFunctions ; ++i)
+    matches += signature1[i] == signature2[i] ? 1 : 0;
+  return static_cast<double>(matches) / NumHashFunctions;
+}
+} // anonymous namespace
+
+std::vector<std::vector<int64_t>> GroupTreesByFeatures(decisionforest::DecisionForest& forest, int32_t batchTileSize, int32_t inputElementBitWidth) {
+  int64_t inputElementBytes = inputElementBitWidth/8;
+  auto maxGroupCacheLines = std::max<int64_t>(1, L1FeatureBudgetInBytes / (int64_t(batchTileSize) * CacheLineBytes));
+  std::vector<std::set<int64_t>> treeCacheLines;
+  std::vector<Signature> signatures;
+  for (size_t i=0 ; i<forest.NumTrees() ; ++i) {
+    treeCacheLines.push_back(GetCacheLines(forest.GetTree(i), inputElementBytes));
+    signatures.push_back(ComputeSignature(treeCacheLines.back()));
+  }
+
+  std::vector<std::vector<int64_t>> groups;
+  std::vector<bool> grouped(forest.NumTrees(), false);
+  for (int64_t first=0 ; first<(int64_t)forest.NumTrees() ; ++first) {
+    if (grouped[first])
+      continue;
+    std::vector<int64_t> group{ first };
+    grouped[first] = true;
+    auto groupCacheLines = treeCacheLines[first];
+    auto groupSignature = signatures[first];
+    while (true) {
+      int64_t bestTree = -1;
+      double bestSimilarity = -1.0;
+      for (int64_t i=first+1 ; i<(int64_t)forest.NumTrees() ; ++i) {
+        if (grouped[i])
+          continue;
+        auto similarity = EstimateSimilarity(groupSignature, signatures[i]);
+        if (similarity > bestSimilarity) {
+          bestSimilarity = similarity;
+          bestTree = i;
+        }
+      }
+      if (bestTree == -1)
+        break;
+      auto newGroupCacheLines = groupCacheLines;
+      newGroupCacheLines.insert(treeCacheLines[bestTree].begin(), treeCacheLines[bestTree].end());
+      if ((int64_t)newGroupCacheLines.size() > maxGroupCacheLines)
+        break;
+      group.push_back(bestTree);
+      grouped[bestTree] = true;
+      groupCacheLines = newGroupCacheLines;
+      // The signature of a union is the element wise min of the signatures
+      for (int32_t i=0 ; i<NumHashFunctions ; ++i)
+        groupSignature[i] = std::min(groupSignature[i], signatures[bestTree][i]);
+    }
+    groups.push_back(group);
+  }
+  return groups;
+}
+
+// Walks the trees grouped by GroupTreesByFeatures for a tile of rows before moving on to the next tile. The 
+// rows' values of the features a group reads then stay in L1 across its trees. Meant for wide models (thousands
+// of features) whose trees each read a few features, which are otherwise walked in model order with a row's 
+// features spread over many cache lines.
+struct GroupTreesByFeaturesPattern : public RewritePattern {
+  int32_t m_batchTileSize;
+  int32_t m_inputElementBitWidth;
+  GroupTreesByFeaturesPattern(MLIRContext *ctx, int32_t batchTileSize, int32_t inputElementBitWidth) 
+    : RewritePattern(mlir::decisionforest::PredictForestOp::getOperationName(), 1 /*benefit*/, ctx),
+      m_batchTileSize(batchTileSize), m_inputElementBitWidth(inputElementBitWidth)
+  {}
+
+  LogicalResult matchAndRewrite(Operation *op, PatternRewriter &rewriter) const final {
+    mlir::decisionforest::PredictForestOp predictOp = llvm::dyn_cast<mlir::decisionforest::PredictForestOp>(op);
+    assert(predictOp);
+    if (!predictOp)
+         return mlir::failure();
+
+    // Don't match if we've already modified the schedule on this op. Prevents
+    // infinite loops
+    auto schedule = predictOp.getSchedule().GetSchedule();
+    if (!schedule->IsDefaultSchedule())
+      return mlir::failure();
+
+    auto forestAttribute = predictOp.getEnsemble();
+    auto forest = forestAttribute.GetDecisionForest();
+    auto forestType = forestAttribute.getType().cast<decisionforest::TreeEnsembleType>();
+    auto groups = GroupTreesByFeatures(forest, m_batchTileSize, m_inputElementBitWidth);
+    std::vector<std::shared_ptr<decisionforest::DecisionTree>> reorderedTrees;
+    for (auto& group : groups)
+      for (auto treeIndex : group)
+        reorderedTrees.push_back(forest.GetTrees().at(treeIndex));
+    forest.GetTrees() = reorderedTrees;
+
+    auto batchTileSize = std::min(m_batchTileSize, schedule->GetBatchSize());
+    assert (schedule->GetBatchSize() % batchTileSize == 0 && "The batch size must be a multiple of the batch tile size");
+    auto& batchIndex = schedule->GetBatchIndex();
+    auto& treeIndex = schedule->GetTreeIndex();
+    auto& b0 = schedule->NewIndexVariable("b0");
+    auto& b1 = schedule->NewIndexVariable("b1");
+    schedule->Tile(batchIndex, b0, b1, batchTileSize);
+    // The tree loop is inside the tile loop, so the trees of a group (which are now contiguous) are walked
+    // back to back on the same tile of rows. The tree loop isn't split at group boundaries because that 
+    // wouldn't change the order of the walks and would emit a copy of the loop body for each group.
+    schedule->Reorder({ &b0, &treeIndex, &b1 });
+
+    auto newForestAttribute = decisionforest::DecisionForestAttribute::get(forestType, forest);
+    auto reorderedPredictForestOp = rewriter.create<decisionforest::PredictForestOp>(op->getLoc(), 
+                                                                                     predictOp.getResult().getType(), 
+                                                                                     newForestAttribute,
+                                                                                     predictOp.getPredicateAttr(), 
+                                                                                     predictOp.getData(),
+                                                                                     predictOp.getResult(),
+                                                                                     predictOp.getSchedule());
+    rewriter.replaceOp(op, static_cast<Value>(reorderedPredictForestOp));
+    return mlir::success();
+  }
+};
+
+struct GroupTreesByFeaturesPass : public PassWrapper<GroupTreesByFeaturesPass, OperationPass<mlir::ModuleOp>> {
+  int32_t m_batchTileSize;
+  int32_t m_inputElementBitWidth;
+  GroupTreesByFeaturesPass(int32_t batchTileSize, int32_t inputElementBitWidth) 
+    :m_batchTileSize(batchTileSize), m_inputElementBitWidth(inputElementBitWidth)
+  { }
+  void getDependentDialects(DialectRegistry &registry) const override {
+    registry.insert<AffineDialect, memref::MemRefDialect, scf::SCFDialect, math::MathDialect>();
+  }
+  void runOnOperation() final {
+    RewritePatternSet patterns(&getContext());
+    patterns.add<GroupTreesByFeaturesPattern>(&getContext(), m_batchTileSize, m_inputElementBitWidth);
+
+    if (failed(applyPatternsAndFoldGreedily(getOperation(), std::move(patterns))))
+        signalPassFailure();
+  }
+};
+
 } // namespace decisionforest
 } // namespace mlir
 
@@ -372,5 +612,23 @@ void DoReorderTreesByDepth(mlir::MLIRContext& context, mlir::ModuleOp module, in
   }
 }
 
+void DoReorderTreesByContribution(mlir::MLIRContext& context, mlir::ModuleOp module) {
+  mlir::PassManager pm(&context);
+  pm.addPass(std::make_unique<ReorderTreesByContributionPass>());
+
+  if (mlir::failed(pm.run(module))) {
+    llvm::errs() << "Reordering trees by contribution failed.\n";
+  }
+}
+
+void DoGroupTreesByFeatures(mlir::MLIRContext& context, mlir::ModuleOp module, int32_t batchTileSize, int32_t inputElementBitWidth) {
+  mlir::PassManager pm(&context);
+  pm.addPass(std::make_unique<GroupTreesByFeaturesPass>(batchTileSize, inputElementBitWidth));
+
+  if (mlir::failed(pm.run(module))) {
+    llvm::errs() << "Grouping trees by features failed.\n";
+  }
+}
+
 } // decisionforest
 } // mlir
@@ -19,9 +19,13 @@
 #include "mlir/IR/Attributes.h"
 #include "mlir/IR/BuiltinAttributes.h"
 #include "TiledTree.h"
+#include "ThreadPool.h"
 #include "mlir/IR/BuiltinTypes.h"
 #include "mlir/IR/Types.h"
 #include <cstdint>
+#include <queue>
+#include <limits>
+#include <algorithm>
 
 using namespace mlir;
 using namespace mlir::decisionforest::helpers;
@@ -35,6 +39,28 @@ const int32_t kFeatureIndexElementNumberInTile = 1;
 const int32_t kTileShapeElementNumberInTile = 2;
 const int32_t kChildIndexElementNumberInTile = 3;
 
+// Serialized values of a single tree. Trees are serialized in parallel and then
+// concatenated in tree order.
+struct SerializedTreeValues {
+  std::vector<double> thresholds, leaves;
+  std::vector<int32_t> indices, tileShapeIDs, childIndices;
+  int64_t numberOfTiles = 0;
+  int32_t classID = 0;
+  // Only used by the hybrid representation (see HybridRepresentation)
+  int64_t arrayLength = 0;
+};
+
+template<typename SerializeTreeType>
+std::vector<SerializedTreeValues> SerializeTreesInParallel(mlir::decisionforest::DecisionForest& forest, SerializeTreeType serializeTree) {
+  TreeBeard::Logging::PhaseTimer timer("Serialize trees");
+  std::vector<SerializedTreeValues> serializedTrees(forest.NumTrees());
+  TreeBeard::GetCompilerThreadPool().ParallelFor(forest.NumTrees(), [&](int64_t begin, int64_t end) {
+    for (int64_t i=begin ; i<end ; ++i)
+      serializeTree(forest.GetTree(i), serializedTrees[i]);
+  });
+  return serializedTrees;
+}
+
 Type generateGetElementPtr(Operation *op, ArrayRef<Value> operands,
                            ConversionPatternRewriter &rewriter,
                            Type elementMLIRType, int64_t elementNumber,
@@ -274,10 +300,139 @@ void LowerCacheRowsOpToCPU(ConversionPatternRewriter &rewriter,
   //         (uint32_t)3, // locality hint
   //         true); // data cache
   auto allocCache = rewriter.create<memref::AllocaOp>(location, resultMemrefType);
-  rewriter.create<memref::CopyOp>(location, cacheSubview.getResult(), allocCache.getResult());
+  auto inputMemrefType = cacheInputOpAdaptor.getData().getType().cast<MemRefType>();
+  if (inputMemrefType.getLayout().isIdentity()) {
+    rewriter.create<memref::CopyOp>(location, cacheSubview.getResult(), allocCache.getResult());
+    rewriter.replaceOp(op, allocCache.getResult());
+    return;
+  }
+  // Rows of strided inputs aren't contiguous, so copy them element by element. The row loop is the inner 
+  // loop so that column major inputs are read with a unit stride.
+  auto zeroIndex = rewriter.create<arith::ConstantIndexOp>(location, 0);
+  auto oneIndex = rewriter.create<arith::ConstantIndexOp>(location, 1);
+  auto numRowsIndex = rewriter.create<arith::ConstantIndexOp>(location, resultMemrefType.getShape()[0]);
+  auto numColsIndex = rewriter.create<arith::ConstantIndexOp>(location, resultMemrefType.getShape()[1]);
+  auto colLoop = rewriter.create<scf::ForOp>(location, zeroIndex, numColsIndex, oneIndex);
+  rewriter.setInsertionPointToStart(colLoop.getBody());
+  auto rowLoop = rewriter.create<scf::ForOp>(location, zeroIndex, numRowsIndex, oneIndex);
+  rewriter.setInsertionPointToStart(rowLoop.getBody());
+  SmallVector<Value, 2> indices{rowLoop.getInductionVar(), colLoop.getInductionVar()};
+  auto element = rewriter.create<memref::LoadOp>(location, cacheSubview.getResult(), indices);
+  rewriter.create<memref::StoreOp>(location, element, allocCache.getResult(), indices);
+  rewriter.setInsertionPointAfter(colLoop);
   rewriter.replaceOp(op, allocCache.getResult());
 }
 
+// Add the categorical bitset table and the per feature categorical mask of the forest as globals
+std::pair<MemRefType, MemRefType> AddCategoricalGlobalMemrefs(ConversionPatternRewriter &rewriter, Location location,
+                                                              decisionforest::DecisionForest& forest, Type thresholdType,
+                                                              const std::string& bitsetsMemrefName,
+                                                              const std::string& featuresMemrefName) {
+  // Categorical nodes store the offset of their category set in the threshold, so it must be exactly representable
+  auto& forestBitsets = forest.GetCategoricalBitsets();
+  auto thresholdPrecision = thresholdType.cast<FloatType>().getFPMantissaWidth();
+  assert (forestBitsets.size() <= (1ull << thresholdPrecision) && "Categorical bitset table is too large for the threshold type");
+
+  std::vector<int32_t> bitsets(forestBitsets.begin(), forestBitsets.end());
+  auto bitsetsMemrefType = MemRefType::get({(int64_t)bitsets.size()}, rewriter.getI32Type());
+  decisionforest::createConstantGlobalOp(rewriter, location, bitsetsMemrefName, bitsetsMemrefType, bitsets);
+
+  auto categoricalFeatures = forest.GetCategoricalFeatureMask();
+  // Dummy nodes added during tiling use feature 0, so make sure it has an entry
+  if (categoricalFeatures.empty())
+    categoricalFeatures.push_back(0);
+  auto featuresMemrefType = MemRefType::get({(int64_t)categoricalFeatures.size()}, rewriter.getI8Type());
+  decisionforest::createConstantGlobalOp(rewriter, location, featuresMemrefName, featuresMemrefType, categoricalFeatures);
+  return std::make_pair(bitsetsMemrefType, featuresMemrefType);
+}
+
+// Leaves that are stored inline in the tree memref are tiles whose first feature index is -1. The leaf value is
+// the first threshold of the tile.
+Value GenerateLoadInlineLeafValue(ConversionPatternRewriter &rewriter, Location location, Value treeMemref,
+                                  Value nodeIndex, Value treeIndex) {
+  auto treeMemrefType = treeMemref.getType().cast<MemRefType>();
+  assert (treeMemrefType);
+
+  auto treeTileType = treeMemrefType.getElementType().cast<decisionforest::TiledNumericalNodeType>();
+  auto thresholdType = treeTileType.getThresholdFieldType();
+
+  // Load threshold
+  // TODO Ideally, this should be a different op for when we deal with tile sizes != 1. We will then need to load
+  // a single threshold value and cast it the trees return type
+  auto loadThresholdOp = rewriter.create<decisionforest::LoadTileThresholdsOp>(location,
+                                                                               thresholdType,
+                                                                               treeMemref,
+                                                                               static_cast<Value>(nodeIndex),
+                                                                               treeIndex);
+  Value leafValue = loadThresholdOp;
+
+  if (treeTileType.getTileSize() != 1) {
+    if (decisionforest::InsertDebugHelpers) {
+      InsertPrintVectorOp(rewriter, location, 0, treeTileType.getThresholdElementType().getIntOrFloatBitWidth(), treeTileType.getTileSize(), loadThresholdOp);
+    }
+    auto zeroConst = rewriter.create<arith::ConstantIntOp>(location, int64_t(0), rewriter.getI32Type());
+    auto extractElement = rewriter.create<vector::ExtractElementOp>(location, static_cast<Value>(loadThresholdOp), zeroConst);
+    leafValue = extractElement;
+  }
+  return leafValue;
+}
+
+Value GenerateIsInlineLeaf(ConversionPatternRewriter &rewriter, Location location, Value treeMemref,
+                           Value nodeIndex, Value treeIndex) {
+  auto treeMemrefType = treeMemref.getType().cast<MemRefType>();
+  assert (treeMemrefType);
+
+  auto treeTileType = treeMemrefType.getElementType().cast<decisionforest::TiledNumericalNodeType>();
+  auto featureIndexType = treeTileType.getIndexFieldType();
+  auto loadFeatureIndexOp = rewriter.create<decisionforest::LoadTileFeatureIndicesOp>(location,
+                                                                                      featureIndexType,
+                                                                                      treeMemref,
+                                                                                      static_cast<Value>(nodeIndex),
+                                                                                      treeIndex);
+
+  Value featureIndexValue;
+  if (treeTileType.getTileSize() == 1) {
+    featureIndexValue = loadFeatureIndexOp;
+  }
+  else {
+    auto indexVectorType = featureIndexType.cast<mlir::VectorType>();
+    assert (indexVectorType);
+    auto zeroConst = rewriter.create<arith::ConstantIntOp>(location, int64_t(0), rewriter.getI32Type());
+    auto extractFirstElement = rewriter.create<vector::ExtractElementOp>(location, static_cast<Value>(loadFeatureIndexOp), zeroConst);
+    featureIndexValue = extractFirstElement;
+  }
+  auto minusOneConstant = rewriter.create<arith::ConstantIntOp>(location, int64_t(-1), treeTileType.getIndexElementType());
+  auto comparison = rewriter.create<arith::CmpIOp>(location, mlir::arith::CmpIPredicate::eq, featureIndexValue, static_cast<Value>(minusOneConstant));
+
+  if (decisionforest::InsertDebugHelpers) {
+    Value outcome = rewriter.create<mlir::arith::ExtUIOp>(location, rewriter.getI32Type(), static_cast<Value>(comparison));
+    rewriter.create<decisionforest::PrintIsLeafOp>(location, nodeIndex, featureIndexValue, outcome);
+  }
+  return static_cast<Value>(comparison);
+}
+
+// Serializes the tree with its first arrayLevels tile levels stored as a perfect tree.
+void SerializeHybridTree(const std::vector<decisionforest::HybridLayoutTile>& tiles, int32_t tileSize, int32_t arrayLevels, SerializedTreeValues& values) {
+  auto layout = decisionforest::LayOutHybridTree(tiles, tileSize, arrayLevels);
+  int64_t numberOfSlots = layout.tileInSlot.size();
+  values.numberOfTiles = numberOfSlots;
+  values.arrayLength = layout.arrayLength;
+  for (int64_t slot=0 ; slot<numberOfSlots ; ++slot) {
+    auto tileIndex = layout.tileInSlot.at(slot);
+    if (tileIndex == -1) {
+      values.thresholds.insert(values.thresholds.end(), tileSize, 0.0);
+      values.indices.insert(values.indices.end(), tileSize, -1);
+      values.tileShapeIDs.push_back(0);
+    }
+    else {
+      auto& tile = tiles.at(tileIndex);
+      values.thresholds.insert(values.thresholds.end(), tile.thresholds.begin(), tile.thresholds.end());
+      values.indices.insert(values.indices.end(), tile.indices.begin(), tile.indices.end());
+      values.tileShapeIDs.push_back(tile.tileShapeID);
+    }
+    values.childIndices.push_back(static_cast<int32_t>(layout.childIndices.at(slot)));
+  }
+}
 
 } // anonymous namespace
 
@@ -321,6 +476,15 @@ mlir::LogicalResult ArrayBasedRepresentation::GenerateModelGlobals(Operation *op
     auto classInfoGlobal = ensembleConstOp.getForest().GetDecisionForest().IsMultiClassClassifier()
                           ? rewriter.create<memref::GetGlobalOp>(location, memrefTypes.classInfo, kClassInfoMemrefName)
                           : Value();
+    auto categoricalBitsetsGlobal = m_hasCategoricalSplits
+                          ? rewriter.create<memref::GetGlobalOp>(location, memrefTypes.categoricalBitsets, kCategoricalBitsetsMemrefName)
+                          : Value();
+    auto categoricalFeaturesGlobal = m_hasCategoricalSplits
+                          ? rewriter.create<memref::GetGlobalOp>(location, memrefTypes.categoricalFeatures, kCategoricalFeaturesMemrefName)
+                          : Value();
+    auto leafHitCountsGlobal = m_profileLeafHits
+                          ? rewriter.create<memref::GetGlobalOp>(location, memrefTypes.leafHitCounts, kLeafHitCountsMemrefName)
+                          : Value();
 
     EnsembleConstantLoweringInfo info 
     {
@@ -332,6 +496,9 @@ mlir::LogicalResult ArrayBasedRepresentation::GenerateModelGlobals(Operation *op
       memrefTypes.offset,
       memrefTypes.offset,
       memrefTypes.classInfo,
+      categoricalBitsetsGlobal,
+      categoricalFeaturesGlobal,
+      leafHitCountsGlobal,
     };
     ensembleConstantToMemrefsMap[op] = info;
     return mlir::success();
@@ -359,48 +526,45 @@ ArrayBasedRepresentation::GlobalMemrefTypes ArrayBasedRepresentation::AddGlobalM
   Type memrefElementType = decisionforest::TiledNumericalNodeType::get(m_thresholdType, m_featureIndexType, m_tileShapeType, tileSize);
   
   m_tileSize = tileSize;
+  m_profileLeafHits = forest.ProfileLeafHits();
+  assert ((!m_profileLeafHits || tileSize == 1) && "Leaf hits can only be profiled on untiled trees");
+  m_hasCategoricalSplits = forest.HasCategoricalSplits();
+  // Missing values are checked for explicitly on categorical nodes, so always route them per node
+  m_routeMissingValuesPerNode = forest.GetMissingValueRouting() == MissingValueRouting::kPerNode || m_hasCategoricalSplits;
   
   std::vector<double> thresholds;
   std::vector<int32_t> indices, tileShapeIDs, classIDs;
   std::vector<int64_t> offsets, lengths;
   int64_t currentOffset = 0;
 
-  if (tileSize > 1) {
-    for (size_t i = 0; i < forest.NumTrees(); i++) {
-      auto* tiledTree = forest.GetTree(i).GetTiledTree();
-      auto tiledTreeThresholds = tiledTree->SerializeThresholds();
-      auto tiledTreeIndices = tiledTree->SerializeFeatureIndices();
-      auto tiledTreeTileShapeIDs = tiledTree->SerializeTileShapeIDs();
-
-      thresholds.insert(thresholds.end(), tiledTreeThresholds.begin(), tiledTreeThresholds.end());
-      indices.insert(indices.end(), tiledTreeIndices.begin(), tiledTreeIndices.end());
-      tileShapeIDs.insert(tileShapeIDs.end(), tiledTreeTileShapeIDs.begin(), tiledTreeTileShapeIDs.end());
-
-      offsets.push_back(currentOffset);
-      lengths.push_back(tiledTree->GetNumberOfTiles());
-      currentOffset += tiledTree->GetNumberOfTiles();
-
-      if (forest.IsMultiClassClassifier()) {
-        classIDs.push_back(tiledTree->GetClassId());
-      }
+  auto routeMissingValuesPerNode = m_routeMissingValuesPerNode;
+  auto serializedTrees = SerializeTreesInParallel(forest, [tileSize, routeMissingValuesPerNode](DecisionTree& tree, SerializedTreeValues& values) {
+    if (tileSize > 1) {
+      auto* tiledTree = tree.GetTiledTree();
+      values.thresholds = tiledTree->SerializeThresholds();
+      values.indices = tiledTree->SerializeFeatureIndices(routeMissingValuesPerNode);
+      values.tileShapeIDs = tiledTree->SerializeTileShapeIDs();
+      values.numberOfTiles = tiledTree->GetNumberOfTiles();
+      values.classID = tiledTree->GetClassId();
     }
-  }
-  else {
-    for (size_t i = 0; i < forest.NumTrees(); i++) {
-      auto& tree = forest.GetTree(i);
-      auto treeThresholds = tree.GetThresholdArray();
-      auto treeIndices = tree.GetFeatureIndexArray();
-
-      thresholds.insert(thresholds.end(), treeThresholds.begin(), treeThresholds.end());
-      indices.insert(indices.end(), treeIndices.begin(), treeIndices.end());
-
-      offsets.push_back(currentOffset);
-      lengths.push_back(tree.GetNumberOfTiles());
-      currentOffset += tree.GetNumberOfTiles();
-
-      if (forest.IsMultiClassClassifier()) {
-        classIDs.push_back(tree.GetClassId());
-      }
+    else {
+      values.thresholds = tree.GetThresholdArray();
+      values.indices = tree.GetFeatureIndexArray(routeMissingValuesPerNode);
+      values.numberOfTiles = tree.GetNumberOfTiles();
+      values.classID = tree.GetClassId();
+    }
+  });
+  for (auto& values : serializedTrees) {
+    thresholds.insert(thresholds.end(), values.thresholds.begin(), values.thresholds.end());
+    indices.insert(indices.end(), values.indices.begin(), values.indices.end());
+    tileShapeIDs.insert(tileShapeIDs.end(), values.tileShapeIDs.begin(), values.tileShapeIDs.end());
+
+    offsets.push_back(currentOffset);
+    lengths.push_back(values.numberOfTiles);
+    currentOffset += values.numberOfTiles;
+
+    if (forest.IsMultiClassClassifier()) {
+      classIDs.push_back(values.classID);
     }
   }
 
@@ -432,8 +596,31 @@ ArrayBasedRepresentation::GlobalMemrefTypes ArrayBasedRepresentation::AddGlobalM
   if (forest.IsMultiClassClassifier()) {
     createConstantGlobalOp(rewriter, location, kClassInfoMemrefName, classInfoMemrefType, classIDs);
   }
+
+  MemRefType categoricalBitsetsMemrefType, categoricalFeaturesMemrefType;
+  if (m_hasCategoricalSplits) {
+    std::tie(categoricalBitsetsMemrefType, categoricalFeaturesMemrefType) = 
+      AddCategoricalGlobalMemrefs(rewriter, location, forest, m_thresholdType, kCategoricalBitsetsMemrefName, kCategoricalFeaturesMemrefName);
+  }
+
+  MemRefType leafHitCountsMemrefType;
+  if (m_profileLeafHits) {
+    // Counts of all calls, read and reset through Get_leafHitCounts at runtime
+    leafHitCountsMemrefType = MemRefType::get({modelMemrefSize}, rewriter.getI64Type());
+    std::vector<int64_t> zeroCounts(modelMemrefSize, 0);
+    auto zeroCountsAttribute = DenseElementsAttr::get(memref::getTensorTypeFromMemRefType(leafHitCountsMemrefType), 
+                                                      ArrayRef<int64_t>(zeroCounts));
+    rewriter.create<memref::GlobalOp>(location, kLeafHitCountsMemrefName,
+                                      /*sym_visibility=*/rewriter.getStringAttr("private"),
+                                      /*type=*/leafHitCountsMemrefType,
+                                      /*initial_value=*/zeroCountsAttribute,
+                                      /*constant=*/false, IntegerAttr());
+    AddGlobalMemrefGetter(module, kLeafHitCountsMemrefName, leafHitCountsMemrefType, rewriter, location);
+  }
   
-  return GlobalMemrefTypes { modelMemrefType, offsetMemrefType, classInfoMemrefType };
+  return GlobalMemrefTypes { modelMemrefType, offsetMemrefType, classInfoMemrefType,
+                             categoricalBitsetsMemrefType, categoricalFeaturesMemrefType,
+                             leafHitCountsMemrefType };
 }
 
 void ArrayBasedRepresentation::GenModelMemrefInitFunctionBody(MemRefType memrefType, Value getGlobalMemref,
@@ -524,6 +711,15 @@ mlir::Value ArrayBasedRepresentation::GetTreeMemref(mlir::Value treeValue) {
   return treeMemref;
 }
 
+ArrayBasedRepresentation::EnsembleConstantLoweringInfo& ArrayBasedRepresentation::GetEnsembleLoweringInfo(mlir::Value treeValue) {
+  auto getTreeOp = AssertOpIsOfType<mlir::decisionforest::GetTreeFromEnsembleOp>(treeValue.getDefiningOp());
+  Operation* ensembleConstOp = getTreeOp.getForest().getDefiningOp();
+  AssertOpIsOfType<mlir::decisionforest::EnsembleConstantOp>(ensembleConstOp);
+  auto mapIter = ensembleConstantToMemrefsMap.find(ensembleConstOp);
+  assert (mapIter != ensembleConstantToMemrefsMap.end());
+  return mapIter->second;
+}
+
 mlir::Value ArrayBasedRepresentation::GenerateMoveToChild(mlir::Location location, ConversionPatternRewriter &rewriter, mlir::Value nodeIndex,
                                                           mlir::Value childNumber, int32_t tileSize, std::vector<mlir::Value>& extraLoads) {
   auto oneConstant = rewriter.create<arith::ConstantIndexOp>(location, 1);
@@ -573,71 +769,24 @@ mlir::Value ArrayBasedRepresentation::GenerateGetTreeClassId(mlir::ConversionPat
 
 mlir::Value ArrayBasedRepresentation::GenerateGetLeafValueOp(ConversionPatternRewriter &rewriter, mlir::Operation *op, mlir::Value treeValue, 
                                                              mlir::Value nodeIndex) {
-  auto location = op->getLoc();
-
-  auto treeMemref = this->GetTreeMemref(treeValue);
-  auto treeMemrefType = treeMemref.getType().cast<MemRefType>();
-  assert (treeMemrefType);
-
-  auto treeTileType = treeMemrefType.getElementType().cast<decisionforest::TiledNumericalNodeType>();
-  auto thresholdType = treeTileType.getThresholdFieldType();
+  return GenerateLoadInlineLeafValue(rewriter, op->getLoc(), this->GetTreeMemref(treeValue), nodeIndex, GetTreeIndex(treeValue));
+}
 
-  // Load threshold
-  // TODO Ideally, this should be a different op for when we deal with tile sizes != 1. We will then need to load 
-  // a single threshold value and cast it the trees return type
-  Value treeIndex = GetTreeIndex(treeValue);
-  auto loadThresholdOp = rewriter.create<decisionforest::LoadTileThresholdsOp>(location, 
-                                                                               thresholdType,
-                                                                               treeMemref,
-                                                                               static_cast<Value>(nodeIndex),
-                                                                               treeIndex);
-  Value leafValue = loadThresholdOp;
-  
-  if (treeTileType.getTileSize() != 1) {
-    if (decisionforest::InsertDebugHelpers) {
-      InsertPrintVectorOp(rewriter, location, 0, treeTileType.getThresholdElementType().getIntOrFloatBitWidth(), treeTileType.getTileSize(), loadThresholdOp);
-    }
-    auto zeroConst = rewriter.create<arith::ConstantIntOp>(location, int64_t(0), rewriter.getI32Type());
-    auto extractElement = rewriter.create<vector::ExtractElementOp>(location, static_cast<Value>(loadThresholdOp), zeroConst);
-    leafValue = extractElement;
-  }
-  return leafValue;
+// Counters are laid out like the model memref, so the counter of a leaf is at the tree's offset plus 
+// the leaf's index. Calls may run concurrently, so counters are incremented atomically.
+void ArrayBasedRepresentation::GenerateLeafHitCountIncrement(ConversionPatternRewriter &rewriter, mlir::Location location, 
+                                                             mlir::Value treeValue, mlir::Value nodeIndex) {
+  auto& ensembleInfo = GetEnsembleLoweringInfo(treeValue);
+  assert (ensembleInfo.leafHitCountsGlobal);
+  auto treeOffset = rewriter.create<memref::LoadOp>(location, ensembleInfo.offsetGlobal, GetTreeIndex(treeValue));
+  auto counterIndex = rewriter.create<arith::AddIOp>(location, static_cast<Value>(treeOffset), nodeIndex);
+  auto one = rewriter.create<arith::ConstantIntOp>(location, 1, rewriter.getI64Type());
+  rewriter.create<memref::AtomicRMWOp>(location, rewriter.getI64Type(), arith::AtomicRMWKind::addi, 
+                                       static_cast<Value>(one), ensembleInfo.leafHitCountsGlobal, ValueRange{counterIndex});
 }
 
 mlir::Value ArrayBasedRepresentation::GenerateIsLeafOp(ConversionPatternRewriter &rewriter, mlir::Operation *op, mlir::Value treeValue, mlir::Value nodeIndex) {
-  auto location = op->getLoc();
-  auto treeMemref = this->GetTreeMemref(treeValue);
-  auto treeMemrefType = treeMemref.getType().cast<MemRefType>();
-  assert (treeMemrefType);
-
-  auto treeTileType = treeMemrefType.getElementType().cast<decisionforest::TiledNumericalNodeType>();
-  auto featureIndexType = treeTileType.getIndexFieldType();
-  auto treeIndex = GetTreeIndex(treeValue);
-  auto loadFeatureIndexOp = rewriter.create<decisionforest::LoadTileFeatureIndicesOp>(location, 
-                                                                                      featureIndexType,
-                                                                                      treeMemref,
-                                                                                      static_cast<Value>(nodeIndex),
-                                                                                      treeIndex);    
-  
-  Value featureIndexValue;
-  if (treeTileType.getTileSize() == 1) {
-    featureIndexValue = loadFeatureIndexOp;
-  }
-  else {
-    auto indexVectorType = featureIndexType.cast<mlir::VectorType>();
-    assert (indexVectorType);
-    auto zeroConst = rewriter.create<arith::ConstantIntOp>(location, int64_t(0), rewriter.getI32Type());
-    auto extractFirstElement = rewriter.create<vector::ExtractElementOp>(location, static_cast<Value>(loadFeatureIndexOp), zeroConst);
-    featureIndexValue = extractFirstElement;
-  }
-  auto minusOneConstant = rewriter.create<arith::ConstantIntOp>(location, int64_t(-1), treeTileType.getIndexElementType());
-  auto comparison = rewriter.create<arith::CmpIOp>(location, mlir::arith::CmpIPredicate::eq, featureIndexValue, static_cast<Value>(minusOneConstant));
-  
-  if (decisionforest::InsertDebugHelpers) {
-    Value outcome = rewriter.create<mlir::arith::ExtUIOp>(location, rewriter.getI32Type(), static_cast<Value>(comparison));
-    rewriter.create<decisionforest::PrintIsLeafOp>(location, nodeIndex, featureIndexValue, outcome);
-  }
-  return static_cast<Value>(comparison);
+  return GenerateIsInlineLeaf(rewriter, op->getLoc(), this->GetTreeMemref(treeValue), nodeIndex, GetTreeIndex(treeValue));
 }
 
 mlir::Value ArrayBasedRepresentation::GenerateIsLeafTileOp(ConversionPatternRewriter &rewriter, mlir::Operation *op, mlir::Value treeValue, mlir::Value nodeIndex) {
@@ -716,6 +865,12 @@ mlir::LogicalResult SparseRepresentation::GenerateModelGlobals(Operation *op, Ar
     auto classInfoGlobal = ensembleConstOp.getForest().GetDecisionForest().IsMultiClassClassifier() 
                           ? rewriter.create<memref::GetGlobalOp>(location, std::get<3>(memrefTypes), kClassInfoMemrefName)
                           : Value();
+    auto categoricalBitsetsGlobal = m_hasCategoricalSplits
+                          ? rewriter.create<memref::GetGlobalOp>(location, m_categoricalBitsetsMemrefType, kCategoricalBitsetsMemrefName)
+                          : Value();
+    auto categoricalFeaturesGlobal = m_hasCategoricalSplits
+                          ? rewriter.create<memref::GetGlobalOp>(location, m_categoricalFeaturesMemrefType, kCategoricalFeaturesMemrefName)
+                          : Value();
     
     Type lookUpTableMemrefType;
     Value getLUT;
@@ -724,7 +879,8 @@ mlir::LogicalResult SparseRepresentation::GenerateModelGlobals(Operation *op, Ar
                                        static_cast<Value>(getLengthGlobal), getLUT,
                                        getLeavesGlobal, getLeavesOffsetGlobal, getLeavesLengthGlobal, classInfoGlobal,
                                        std::get<0>(memrefTypes), std::get<1>(memrefTypes), std::get<1>(memrefTypes), 
-                                       lookUpTableMemrefType, std::get<2>(memrefTypes), std::get<3>(memrefTypes)};
+                                       lookUpTableMemrefType, std::get<2>(memrefTypes), std::get<3>(memrefTypes),
+                                       categoricalBitsetsGlobal, categoricalFeaturesGlobal};
     sparseEnsembleConstantToMemrefsMap[op] = info;
     return mlir::success();
 }
@@ -748,6 +904,10 @@ std::tuple<Type, Type, Type, Type> SparseRepresentation::AddGlobalMemrefs(mlir::
   auto childIndexType = treeType.getChildIndexType();
   Type memrefElementType = decisionforest::TiledNumericalNodeType::get(m_thresholdType, m_featureIndexType, m_tileShapeType, 
                                                                        m_tileSize, childIndexType);
+  m_hasCategoricalSplits = forest.HasCategoricalSplits();
+  // Missing values are checked for explicitly on categorical nodes, so always route them per node
+  m_routeMissingValuesPerNode = forest.GetMissingValueRouting() == MissingValueRouting::kPerNode || m_hasCategoricalSplits;
+  assert (!forest.ProfileLeafHits() && "Leaf hit profiling is only supported by the array representation");
 
   std::vector<double> thresholds, leaves;
   std::vector<int32_t> indices, tileShapeIDs, childIndices;
@@ -755,51 +915,44 @@ std::tuple<Type, Type, Type, Type> SparseRepresentation::AddGlobalMemrefs(mlir::
   int64_t currentOffset = 0, currentLeafOffset = 0;
   std::vector<int32_t> classIds;
 
-  if (m_tileSize > 1) {
-    for (size_t i = 0; i < forest.NumTrees(); i++) {
-      std::vector<double> tiledThresholds, tiledLeaves;
-      std::vector<int32_t> tiledFeatureIndices, tiledTreeShapeIDs, tiledTreechildIndices;
-      
-      auto* tiledTree = forest.GetTree(i).GetTiledTree();
-      tiledTree->GetSparseSerialization(tiledThresholds, tiledFeatureIndices, tiledTreeShapeIDs, tiledTreechildIndices, tiledLeaves);
-      
-      thresholds.insert(thresholds.end(), tiledThresholds.begin(), tiledThresholds.end());
-      indices.insert(indices.end(), tiledFeatureIndices.begin(), tiledFeatureIndices.end());
-      tileShapeIDs.insert(tileShapeIDs.end(), tiledTreeShapeIDs.begin(), tiledTreeShapeIDs.end());
-      childIndices.insert(childIndices.end(), tiledTreechildIndices.begin(), tiledTreechildIndices.end());
-      leaves.insert(leaves.end(), tiledLeaves.begin(), tiledLeaves.end());
-
-      offsets.push_back(currentOffset);
-      lengths.push_back(tiledTreeShapeIDs.size());
-      currentOffset += tiledTreeShapeIDs.size();
-
+  auto tileSize = m_tileSize;
+  auto routeMissingValuesPerNode = m_routeMissingValuesPerNode;
+  auto serializedTrees = SerializeTreesInParallel(forest, [tileSize, routeMissingValuesPerNode](DecisionTree& tree, SerializedTreeValues& values) {
+    if (tileSize > 1) {
+      auto* tiledTree = tree.GetTiledTree();
+      tiledTree->GetSparseSerialization(values.thresholds, values.indices, values.tileShapeIDs, values.childIndices, values.leaves,
+                                        routeMissingValuesPerNode);
+      values.numberOfTiles = values.tileShapeIDs.size();
+      values.classID = tiledTree->GetClassId();
+    }
+    else {
+      values.thresholds = tree.GetSparseThresholdArray();
+      values.indices = tree.GetSparseFeatureIndexArray(routeMissingValuesPerNode);
+      values.childIndices = tree.GetChildIndexArray();
+      values.numberOfTiles = values.childIndices.size();
+      values.classID = tree.GetClassId();
+    }
+  });
+  for (auto& values : serializedTrees) {
+    thresholds.insert(thresholds.end(), values.thresholds.begin(), values.thresholds.end());
+    indices.insert(indices.end(), values.indices.begin(), values.indices.end());
+    tileShapeIDs.insert(tileShapeIDs.end(), values.tileShapeIDs.begin(), values.tileShapeIDs.end());
+    childIndices.insert(childIndices.end(), values.childIndices.begin(), values.childIndices.end());
+
+    offsets.push_back(currentOffset);
+    lengths.push_back(values.numberOfTiles);
+    currentOffset += values.numberOfTiles;
+
+    // Only tiled trees store their leaves separately
+    if (tileSize > 1) {
+      leaves.insert(leaves.end(), values.leaves.begin(), values.leaves.end());
       leafOffsets.push_back(currentLeafOffset);
-      leafLengths.push_back(tiledLeaves.size());
-      currentLeafOffset += tiledLeaves.size();
-
-      if (forest.IsMultiClassClassifier()) {
-        classIds.push_back(tiledTree->GetClassId());
-      }
+      leafLengths.push_back(values.leaves.size());
+      currentLeafOffset += values.leaves.size();
     }
-  }
-  else {
-    for (size_t i = 0; i < forest.NumTrees(); i++) {
-      auto& tree = forest.GetTree(i);
-      auto treeThresholds = tree.GetSparseThresholdArray();
-      auto treeIndices = tree.GetSparseFeatureIndexArray();
-      auto treeChildIndices = tree.GetChildIndexArray();
-
-      thresholds.insert(thresholds.end(), treeThresholds.begin(), treeThresholds.end());
-      indices.insert(indices.end(), treeIndices.begin(), treeIndices.end());
-      childIndices.insert(childIndices.end(), treeChildIndices.begin(), treeChildIndices.end());
-
-      offsets.push_back(currentOffset);
-      lengths.push_back(treeChildIndices.size());
-      currentOffset += treeChildIndices.size();
-      
-      if (forest.IsMultiClassClassifier()) {
-        classIds.push_back(tree.GetClassId());
-      }
+
+    if (forest.IsMultiClassClassifier()) {
+      classIds.push_back(values.classID);
     }
   }
 
@@ -847,6 +1000,11 @@ std::tuple<Type, Type, Type, Type> SparseRepresentation::AddGlobalMemrefs(mlir::
       createConstantGlobalOp(rewriter, location, kClassInfoMemrefName, classInfoMemrefType, classIds);
   }
 
+  if (m_hasCategoricalSplits) {
+    std::tie(m_categoricalBitsetsMemrefType, m_categoricalFeaturesMemrefType) =
+      AddCategoricalGlobalMemrefs(rewriter, location, forest, m_thresholdType, kCategoricalBitsetsMemrefName, kCategoricalFeaturesMemrefName);
+  }
+
   return std::make_tuple(modelMemrefType, offsetMemrefType, leavesMemrefType, classInfoMemrefType);
 }
 
@@ -946,6 +1104,15 @@ mlir::Value SparseRepresentation::GetTreeMemref(mlir::Value treeValue) {
   return treeMemref;
 }
 
+SparseRepresentation::SparseEnsembleConstantLoweringInfo& SparseRepresentation::GetEnsembleLoweringInfo(mlir::Value treeValue) {
+  auto getTreeOp = AssertOpIsOfType<mlir::decisionforest::GetTreeFromEnsembleOp>(treeValue.getDefiningOp());
+  Operation* ensembleConstOp = getTreeOp.getForest().getDefiningOp();
+  AssertOpIsOfType<mlir::decisionforest::EnsembleConstantOp>(ensembleConstOp);
+  auto mapIter = sparseEnsembleConstantToMemrefsMap.find(ensembleConstOp);
+  assert (mapIter != sparseEnsembleConstantToMemrefsMap.end());
+  return mapIter->second;
+}
+
 mlir::Value SparseRepresentation::GetLeafMemref(mlir::Value treeValue) {
   auto getTreeOp = treeValue.getDefiningOp();
   AssertOpIsOfType<mlir::decisionforest::GetTreeFromEnsembleOp>(getTreeOp);
@@ -1180,6 +1347,395 @@ std::shared_ptr<IRepresentation> constructSparseRepresentation() {
 
 REGISTER_REPRESENTATION(sparse, constructSparseRepresentation)
 
+// ===---------------------------------------------------=== //
+// Hybrid representation
+// ===---------------------------------------------------=== //
+
+// Collects the tiles of the tree in level order. The root is the first tile and the children of a tile are
+// indices into the returned vector.
+std::vector<HybridLayoutTile> GetHybridLayoutTiles(DecisionTree& tree, int32_t tileSize, bool encodeDefaultLeft) {
+  std::vector<HybridLayoutTile> layoutTiles;
+  // (index of the tile or node in the tree, depth)
+  std::queue<std::pair<int32_t, int32_t>> worklist;
+  worklist.push({0, 0});
+  while (!worklist.empty()) {
+    auto [treeIndex, depth] = worklist.front();
+    worklist.pop();
+    HybridLayoutTile layoutTile;
+    layoutTile.depth = depth;
+    std::vector<int32_t> treeChildren;
+    if (tileSize > 1) {
+      auto& tile = tree.GetTiledTree()->GetTile(treeIndex);
+      auto& entryNode = tile.GetNode(tile.GetEntryNode());
+      if (tile.IsLeafTile()) {
+        layoutTile.thresholds.assign(tileSize, entryNode.threshold);
+        layoutTile.indices.assign(tileSize, -1);
+        layoutTile.hitCount = entryNode.hitCount;
+      }
+      else {
+        assert (static_cast<int32_t>(tile.GetNodeIndices().size()) == tileSize);
+        for (auto nodeIndex : tile.GetNodeIndices()) {
+          auto& node = tile.GetNode(nodeIndex);
+          layoutTile.thresholds.push_back(node.threshold);
+          layoutTile.indices.push_back(decisionforest::GetSerializedFeatureIndex(node, encodeDefaultLeft));
+        }
+        layoutTile.tileShapeID = tile.GetTileShapeID();
+        treeChildren = tile.GetChildren();
+        assert (static_cast<int32_t>(treeChildren.size()) == tileSize + 1);
+      }
+    }
+    else {
+      auto& node = tree.GetNodes().at(treeIndex);
+      layoutTile.thresholds.push_back(node.threshold);
+      layoutTile.indices.push_back(decisionforest::GetSerializedFeatureIndex(node, encodeDefaultLeft));
+      layoutTile.hitCount = node.hitCount;
+      if (!node.IsLeaf())
+        treeChildren = { static_cast<int32_t>(node.leftChild), static_cast<int32_t>(node.rightChild) };
+    }
+    // Children are visited in order after all tiles that are already in the worklist
+    int32_t nextLayoutIndex = static_cast<int32_t>(layoutTiles.size() + worklist.size()) + 1;
+    for (auto child : treeChildren) {
+      layoutTile.children.push_back(nextLayoutIndex++);
+      worklist.push({child, depth+1});
+    }
+    layoutTiles.push_back(std::move(layoutTile));
+  }
+  return layoutTiles;
+}
+
+// Relative cost of the empty slots of the perfect tree. An empty slot per tile of the tree costs as much as
+// loading one child index per walk.
+const double kHybridWastedSlotCost = 1.0;
+
+// Returns the number of tile levels to store as a perfect tree. The cost of storing K levels is the expected
+// number of child index loads per walk plus kHybridWastedSlotCost times the number of empty slots per tile.
+// Leaves are weighted by their hit counts if the tree has been profiled (the leaf hit counts of the stats 
+// profile passed to the forest creator). Otherwise every leaf is assumed to be reached equally often, 
+// which weights the deep leaves of unbalanced trees more than a walk would reach them and so favours 
+// storing more levels as a perfect tree. The empty slot cost still bounds the number of levels.
+int32_t ChooseHybridArrayLevels(const std::vector<HybridLayoutTile>& tiles, int32_t tileSize, int64_t maxTreeLength) {
+  int32_t treeDepth = 0;
+  for (auto& tile : tiles)
+    treeDepth = std::max(treeDepth, tile.depth + 1);
+
+  bool profiled = std::any_of(tiles.begin(), tiles.end(), [](const HybridLayoutTile& tile) { return tile.children.empty() && tile.hitCount > 0; });
+  std::vector<int64_t> tilesAtDepth(treeDepth, 0), nonLeafTilesAtDepth(treeDepth, 0);
+  std::vector<double> leafWeightAtDepth(treeDepth, 0.0);
+  double totalLeafWeight = 0.0;
+  for (auto& tile : tiles) {
+    tilesAtDepth.at(tile.depth) += 1;
+    if (!tile.children.empty()) {
+      nonLeafTilesAtDepth.at(tile.depth) += 1;
+      continue;
+    }
+    double weight = profiled ? static_cast<double>(tile.hitCount) : 1.0;
+    leafWeightAtDepth.at(tile.depth) += weight;
+    totalLeafWeight += weight;
+  }
+  // Non-leaf tiles at or below each depth. These load their child index if the depth is not in the first K-1 levels.
+  std::vector<int64_t> deepNonLeafTiles(treeDepth + 1, 0);
+  for (int32_t depth = treeDepth - 1 ; depth >= 0 ; --depth)
+    deepNonLeafTiles.at(depth) = deepNonLeafTiles.at(depth + 1) + nonLeafTilesAtDepth.at(depth);
+
+  int32_t bestLevels = 1;
+  double bestCost = std::numeric_limits<double>::max();
+  int64_t levelSlots = 1, arraySlots = 0, tilesInArray = 0;
+  for (int32_t levels = 1 ; levels <= treeDepth ; ++levels) {
+    arraySlots += levelSlots;
+    levelSlots *= (tileSize + 1);
+    tilesInArray += tilesAtDepth.at(levels - 1);
+    if (arraySlots > maxTreeLength)
+      break;
+
+    // Tiles in the last level of the perfect tree and below load their child index
+    double childIndexLoads = 0.0;
+    for (int32_t depth = levels ; depth < treeDepth ; ++depth)
+      childIndexLoads += leafWeightAtDepth.at(depth) * (depth - levels + 1);
+    childIndexLoads /= totalLeafWeight;
+    double wastedSlotCost = kHybridWastedSlotCost * static_cast<double>(arraySlots - tilesInArray) / tiles.size();
+    // Adding levels never removes empty slots
+    if (wastedSlotCost >= bestCost)
+      break;
+
+    int64_t treeLength = arraySlots + (tileSize + 1) * deepNonLeafTiles.at(levels - 1);
+    double cost = childIndexLoads + wastedSlotCost;
+    if (treeLength <= maxTreeLength && cost < bestCost) {
+      bestCost = cost;
+      bestLevels = levels;
+    }
+  }
+  return bestLevels;
+}
+
+// Assigns a slot to every tile with the first arrayLevels tile levels stored as a perfect tree.
+HybridTreeLayout LayOutHybridTree(const std::vector<HybridLayoutTile>& tiles, int32_t tileSize, int32_t arrayLevels) {
+  HybridTreeLayout layout;
+  int64_t levelSlots = 1, arraySlots = 0;
+  for (int32_t level = 0 ; level < arrayLevels ; ++level) {
+    layout.arrayLength = arraySlots;
+    arraySlots += levelSlots;
+    levelSlots *= (tileSize + 1);
+  }
+
+  // Slots that no tile is placed in are never reached by a walk
+  std::vector<int64_t> slots(tiles.size(), -1);
+  layout.tileInSlot.assign(arraySlots, -1);
+  layout.childIndices.assign(arraySlots, -1);
+  int64_t nextFreeSlot = arraySlots;
+  slots.at(0) = 0;
+  layout.tileInSlot.at(0) = 0;
+  // Tiles are in level order, so a tile's slot is known before the tile is visited
+  for (size_t i=0 ; i<tiles.size() ; ++i) {
+    auto& tile = tiles.at(i);
+    if (tile.children.empty())
+      continue;
+    auto slot = slots.at(i);
+    int64_t firstChildSlot;
+    if (slot < layout.arrayLength) {
+      firstChildSlot = (tileSize + 1) * slot + 1;
+    }
+    else {
+      firstChildSlot = nextFreeSlot;
+      nextFreeSlot += tileSize + 1;
+      layout.tileInSlot.resize(nextFreeSlot, -1);
+      layout.childIndices.resize(nextFreeSlot, -1);
+    }
+    layout.childIndices.at(slot) = firstChildSlot;
+    for (size_t j=0 ; j<tile.children.size() ; ++j) {
+      slots.at(tile.children.at(j)) = firstChildSlot + j;
+      layout.tileInSlot.at(firstChildSlot + j) = tile.children.at(j);
+    }
+  }
+  return layout;
+}
+
+void HybridRepresentation::InitRepresentation() {
+  SparseRepresentation::InitRepresentation();
+  ensembleConstantToArrayLengthsMap.clear();
+  getTreeOperationToArrayLengthMap.clear();
+}
+
+mlir::LogicalResult HybridRepresentation::GenerateModelGlobals(Operation *op, ArrayRef<Value> operands, ConversionPatternRewriter &rewriter,
+                                                               std::shared_ptr<decisionforest::IModelSerializer> serializer) {
+    mlir::decisionforest::EnsembleConstantOp ensembleConstOp = llvm::dyn_cast<mlir::decisionforest::EnsembleConstantOp>(op);
+    assert(ensembleConstOp);
+    assert(operands.empty());
+    if (!ensembleConstOp)
+        return mlir::failure();
+
+    auto location = op->getLoc();
+    auto owningModule = op->getParentOfType<mlir::ModuleOp>();
+    assert (owningModule);
+
+    auto memrefTypes = AddGlobalMemrefs(owningModule, ensembleConstOp, rewriter, location);
+    // The model memref is initialized from the same globals as the sparse representation
+    AddModelMemrefInitFunction(owningModule, kModelMemrefName, std::get<0>(memrefTypes).cast<MemRefType>(), rewriter, location);
+
+    auto getModelGlobal = rewriter.create<memref::GetGlobalOp>(location, std::get<0>(memrefTypes), kModelMemrefName);
+    auto getOffsetGlobal = rewriter.create<memref::GetGlobalOp>(location, std::get<1>(memrefTypes), kOffsetMemrefName);
+    auto getLengthGlobal = rewriter.create<memref::GetGlobalOp>(location, std::get<1>(memrefTypes), kLengthMemrefName);
+    auto getArrayLengthGlobal = rewriter.create<memref::GetGlobalOp>(location, std::get<1>(memrefTypes), kArrayLengthMemrefName);
+    auto classInfoGlobal = ensembleConstOp.getForest().GetDecisionForest().IsMultiClassClassifier()
+                          ? rewriter.create<memref::GetGlobalOp>(location, std::get<2>(memrefTypes), kClassInfoMemrefName)
+                          : Value();
+    auto categoricalBitsetsGlobal = m_hasCategoricalSplits
+                          ? rewriter.create<memref::GetGlobalOp>(location, m_categoricalBitsetsMemrefType, kCategoricalBitsetsMemrefName)
+                          : Value();
+    auto categoricalFeaturesGlobal = m_hasCategoricalSplits
+                          ? rewriter.create<memref::GetGlobalOp>(location, m_categoricalFeaturesMemrefType, kCategoricalFeaturesMemrefName)
+                          : Value();
+
+    // Leaves are stored in the model memref, so there are no leaf globals
+    SparseEnsembleConstantLoweringInfo info {static_cast<Value>(getModelGlobal), static_cast<Value>(getOffsetGlobal),
+                                             static_cast<Value>(getLengthGlobal), Value(),
+                                             Value(), Value(), Value(), classInfoGlobal,
+                                             std::get<0>(memrefTypes), std::get<1>(memrefTypes), std::get<1>(memrefTypes),
+                                             Type(), Type(), std::get<2>(memrefTypes),
+                                             categoricalBitsetsGlobal, categoricalFeaturesGlobal};
+    sparseEnsembleConstantToMemrefsMap[op] = info;
+    ensembleConstantToArrayLengthsMap[op] = getArrayLengthGlobal;
+    return mlir::success();
+}
+
+std::tuple<Type, Type, Type> HybridRepresentation::AddGlobalMemrefs(mlir::ModuleOp module, mlir::decisionforest::EnsembleConstantOp& ensembleConstOp,
+                                                                    ConversionPatternRewriter &rewriter, Location location) {
+  mlir::decisionforest::DecisionForestAttribute forestAttribute = ensembleConstOp.getForest();
+  mlir::decisionforest::DecisionForest& forest = forestAttribute.GetDecisionForest();
+
+  SaveAndRestoreInsertionPoint saveAndRestoreInsertPoint(rewriter);
+  rewriter.setInsertionPoint(&module.front());
+
+  auto forestType = ensembleConstOp.getResult().getType().cast<decisionforest::TreeEnsembleType>();
+  assert (forestType.doAllTreesHaveSameTileSize()); // There is still an assumption here that all trees have the same tile size
+  auto treeType = forestType.getTreeType(0).cast<decisionforest::TreeType>();
+
+  m_thresholdType = treeType.getThresholdType();
+  m_featureIndexType = treeType.getFeatureIndexType();
+  m_tileSize = treeType.getTileSize();
+  m_tileShapeType = treeType.getTileShapeType();
+  auto childIndexType = treeType.getChildIndexType();
+  Type memrefElementType = decisionforest::TiledNumericalNodeType::get(m_thresholdType, m_featureIndexType, m_tileShapeType,
+                                                                       m_tileSize, childIndexType);
+  m_hasCategoricalSplits = forest.HasCategoricalSplits();
+  // Missing values are checked for explicitly on categorical nodes, so always route them per node
+  m_routeMissingValuesPerNode = forest.GetMissingValueRouting() == MissingValueRouting::kPerNode || m_hasCategoricalSplits;
+  assert (!forest.ProfileLeafHits() && "Leaf hit profiling is only supported by the array representation");
+
+  // Child indices are signed and -1 marks leaves
+  int64_t maxTreeLength = int64_t(1) << (childIndexType.getIntOrFloatBitWidth() - 1);
+
+  std::vector<double> thresholds;
+  std::vector<int32_t> indices, tileShapeIDs, childIndices;
+  std::vector<int64_t> offsets, lengths, arrayLengths;
+  int64_t currentOffset = 0, arraySlots = 0;
+  std::vector<int32_t> classIds;
+
+  auto tileSize = m_tileSize;
+  auto routeMissingValuesPerNode = m_routeMissingValuesPerNode;
+  auto serializedTrees = SerializeTreesInParallel(forest, [tileSize, routeMissingValuesPerNode, maxTreeLength](DecisionTree& tree, SerializedTreeValues& values) {
+    auto layoutTiles = GetHybridLayoutTiles(tree, tileSize, routeMissingValuesPerNode);
+    auto arrayLevels = ChooseHybridArrayLevels(layoutTiles, tileSize, maxTreeLength);
+    SerializeHybridTree(layoutTiles, tileSize, arrayLevels, values);
+    assert (values.numberOfTiles <= maxTreeLength && "Child index type is too narrow for the hybrid representation");
+    values.classID = tree.GetClassId();
+  });
+  for (auto& values : serializedTrees) {
+    thresholds.insert(thresholds.end(), values.thresholds.begin(), values.thresholds.end());
+    indices.insert(indices.end(), values.indices.begin(), values.indices.end());
+    tileShapeIDs.insert(tileShapeIDs.end(), values.tileShapeIDs.begin(), values.tileShapeIDs.end());
+    childIndices.insert(childIndices.end(), values.childIndices.begin(), values.childIndices.end());
+
+    offsets.push_back(currentOffset);
+    lengths.push_back(values.numberOfTiles);
+    arrayLengths.push_back(values.arrayLength);
+    currentOffset += values.numberOfTiles;
+    arraySlots += values.arrayLength;
+
+    if (forest.IsMultiClassClassifier()) {
+      classIds.push_back(values.classID);
+    }
+  }
+
+  int64_t modelMemrefSize = currentOffset;
+  auto modelMemrefType = MemRefType::get({modelMemrefSize}, memrefElementType);
+  rewriter.create<memref::GlobalOp>(location, kModelMemrefName,
+                                    /*sym_visibility=*/rewriter.getStringAttr("private"),
+                                    /*type=*/modelMemrefType,
+                                    /*initial_value=*/rewriter.getUnitAttr(),
+                                    /*constant=*/false, IntegerAttr());
+
+  auto thresholdArgType = MemRefType::get({ modelMemrefSize * m_tileSize }, m_thresholdType);
+  auto indexArgType = MemRefType::get({ modelMemrefSize * m_tileSize }, m_featureIndexType);
+  auto tileShapeIDArgType = MemRefType::get({modelMemrefSize}, m_tileShapeType);
+  auto childrenIndexArgType = MemRefType::get({modelMemrefSize}, childIndexType);
+
+  createConstantGlobalOp(rewriter, location, kThresholdsMemrefName, thresholdArgType, thresholds);
+  createConstantGlobalOp(rewriter, location, kFeatureIndexMemrefName, indexArgType, indices);
+  createConstantGlobalOp(rewriter, location, kChildIndexMemrefName, childrenIndexArgType, childIndices);
+  if (m_tileSize > 1) {
+    createConstantGlobalOp(rewriter, location, kTileShapeMemrefName, tileShapeIDArgType, tileShapeIDs);
+  }
+
+  auto offsetSize = (int32_t)forest.NumTrees();
+  auto offsetMemrefType = MemRefType::get({offsetSize}, rewriter.getIndexType());
+  createConstantGlobalOp(rewriter, location, kOffsetMemrefName, offsetMemrefType, offsets);
+  createConstantGlobalOp(rewriter, location, kLengthMemrefName, offsetMemrefType, lengths);
+  createConstantGlobalOp(rewriter, location, kArrayLengthMemrefName, offsetMemrefType, arrayLengths);
+
+  if (TreeBeard::Logging::loggingOptions.logGenCodeStats) {
+    TreeBeard::Logging::Log("Hybrid model memref size : " + std::to_string(modelMemrefSize));
+    TreeBeard::Logging::Log("Hybrid slots with implicit children : " + std::to_string(arraySlots));
+  }
+
+  auto classInfoMemrefType = MemRefType::get({offsetSize}, treeType.getResultType());
+  if (forest.IsMultiClassClassifier())
+  {
+      createConstantGlobalOp(rewriter, location, kClassInfoMemrefName, classInfoMemrefType, classIds);
+  }
+
+  if (m_hasCategoricalSplits) {
+    std::tie(m_categoricalBitsetsMemrefType, m_categoricalFeaturesMemrefType) =
+      AddCategoricalGlobalMemrefs(rewriter, location, forest, m_thresholdType, kCategoricalBitsetsMemrefName, kCategoricalFeaturesMemrefName);
+  }
+
+  return std::make_tuple(modelMemrefType, offsetMemrefType, classInfoMemrefType);
+}
+
+mlir::Value HybridRepresentation::GetArrayLength(mlir::Value treeValue) {
+  auto getTreeOp = treeValue.getDefiningOp();
+  AssertOpIsOfType<mlir::decisionforest::GetTreeFromEnsembleOp>(getTreeOp);
+  auto mapIter = getTreeOperationToArrayLengthMap.find(getTreeOp);
+  assert(mapIter != getTreeOperationToArrayLengthMap.end());
+  return mapIter->second;
+}
+
+std::vector<mlir::Value> HybridRepresentation::GenerateExtraLoads(mlir::Location location,
+                                                                  ConversionPatternRewriter &rewriter,
+                                                                  mlir::Value tree,
+                                                                  mlir::Value nodeIndex) {
+  auto treeMemRef = GetTreeMemref(tree);
+  auto memrefType = treeMemRef.getType().cast<MemRefType>();
+  auto treeTileType = memrefType.getElementType().cast<decisionforest::TiledNumericalNodeType>();
+
+  // Tiles in the first levels of the tree find their children like the array based representation.
+  // The rest load their child index.
+  auto isInArray = rewriter.create<arith::CmpIOp>(location, arith::CmpIPredicate::ult, nodeIndex, GetArrayLength(tree));
+  auto ifElse = rewriter.create<scf::IfOp>(location, TypeRange{ rewriter.getIndexType() }, static_cast<Value>(isInArray), true);
+  {
+    SaveAndRestoreInsertionPoint saveAndRestoreInsertPoint(rewriter);
+    rewriter.setInsertionPointToStart(ifElse.thenBlock());
+    auto oneConstant = rewriter.create<arith::ConstantIndexOp>(location, 1);
+    auto tileSizeConstant = rewriter.create<arith::ConstantIndexOp>(location, treeTileType.getTileSize()+1);
+    auto tileSizeTimesIndex = rewriter.create<arith::MulIOp>(location, rewriter.getIndexType(), nodeIndex, static_cast<Value>(tileSizeConstant));
+    auto firstChildIndex = rewriter.create<arith::AddIOp>(location, rewriter.getIndexType(), static_cast<Value>(tileSizeTimesIndex), static_cast<Value>(oneConstant));
+    rewriter.create<scf::YieldOp>(location, static_cast<Value>(firstChildIndex));
+
+    rewriter.setInsertionPointToStart(ifElse.elseBlock());
+    auto loadChildIndexOp = rewriter.create<decisionforest::LoadChildIndexOp>(location, treeTileType.getChildIndexType(), treeMemRef, nodeIndex);
+    auto childIndex = rewriter.create<arith::IndexCastOp>(location, rewriter.getIndexType(), static_cast<Value>(loadChildIndexOp));
+    rewriter.create<scf::YieldOp>(location, static_cast<Value>(childIndex));
+  }
+  return std::vector<mlir::Value>{ ifElse.getResult(0) };
+}
+
+void HybridRepresentation::GenerateTreeMemref(mlir::ConversionPatternRewriter &rewriter, mlir::Operation *op, Value ensemble, Value treeIndex) {
+  auto location = op->getLoc();
+  Operation* ensembleConstOp = ensemble.getDefiningOp();
+  AssertOpIsOfType<mlir::decisionforest::EnsembleConstantOp>(ensembleConstOp);
+
+  auto mapIter = sparseEnsembleConstantToMemrefsMap.find(ensembleConstOp);
+  assert (mapIter != sparseEnsembleConstantToMemrefsMap.end());
+  auto& ensembleInfo = mapIter->second;
+
+  auto modelMemrefIndex = rewriter.create<memref::LoadOp>(location, ensembleInfo.offsetGlobal, treeIndex);
+  auto treeLength = rewriter.create<memref::LoadOp>(location, ensembleInfo.lengthGlobal, treeIndex);
+  auto treeMemref = rewriter.create<memref::SubViewOp>(location, ensembleInfo.modelGlobal, ArrayRef<OpFoldResult>({static_cast<Value>(modelMemrefIndex)}),
+                                                        ArrayRef<OpFoldResult>({static_cast<Value>(treeLength)}), ArrayRef<OpFoldResult>({rewriter.getIndexAttr(1)}));
+  auto arrayLength = rewriter.create<memref::LoadOp>(location, ensembleConstantToArrayLengthsMap.at(ensembleConstOp), treeIndex);
+
+  sparseGetTreeOperationMap[op] = { static_cast<Value>(treeMemref), Value() };
+  getTreeOperationToArrayLengthMap[op] = static_cast<Value>(arrayLength);
+}
+
+mlir::Value HybridRepresentation::GenerateGetLeafValueOp(ConversionPatternRewriter &rewriter, mlir::Operation *op, mlir::Value treeValue,
+                                                         mlir::Value nodeIndex) {
+  return GenerateLoadInlineLeafValue(rewriter, op->getLoc(), this->GetTreeMemref(treeValue), nodeIndex, GetTreeIndex(treeValue));
+}
+
+mlir::Value HybridRepresentation::GenerateIsLeafOp(ConversionPatternRewriter &rewriter, mlir::Operation *op, mlir::Value treeValue, mlir::Value nodeIndex) {
+  return GenerateIsInlineLeaf(rewriter, op->getLoc(), this->GetTreeMemref(treeValue), nodeIndex, GetTreeIndex(treeValue));
+}
+
+mlir::Value HybridRepresentation::GenerateIsLeafTileOp(ConversionPatternRewriter &rewriter, mlir::Operation *op, mlir::Value treeValue, mlir::Value nodeIndex) {
+  return this->GenerateIsLeafOp(rewriter, op, treeValue, nodeIndex);
+}
+
+std::shared_ptr<IRepresentation> constructHybridRepresentation() {
+  return std::make_shared<HybridRepresentation>();
+}
+
+REGISTER_REPRESENTATION(hybrid, constructHybridRepresentation)
+
 // ===---------------------------------------------------=== //
 // ModelSerializerFactory Methods
 // ===---------------------------------------------------=== //
@@ -1204,19 +1760,27 @@ bool RepresentationFactory::RegisterRepresentation(const std::string& name,
   return true;
 }
 
-std::shared_ptr<IRepresentation> ConstructRepresentation() {
-  if (decisionforest::UseSparseTreeRepresentation)
+std::shared_ptr<IRepresentation> ConstructRepresentation(bool sparseRepresentation) {
+  if (sparseRepresentation)
     return RepresentationFactory::Get().GetRepresentation("sparse");
   else
     return RepresentationFactory::Get().GetRepresentation("array");
 }
 
-std::shared_ptr<IRepresentation> ConstructGPURepresentation() {
-  if (decisionforest::UseSparseTreeRepresentation)
+std::shared_ptr<IRepresentation> ConstructGPURepresentation(bool sparseRepresentation) {
+  if (sparseRepresentation)
     return RepresentationFactory::Get().GetRepresentation("gpu_sparse");
   else
     return RepresentationFactory::Get().GetRepresentation("gpu_array");
 }
 
+std::shared_ptr<IRepresentation> ConstructRepresentation() {
+  return ConstructRepresentation(decisionforest::UseSparseTreeRepresentation);
+}
+
+std::shared_ptr<IRepresentation> ConstructGPURepresentation() {
+  return ConstructGPURepresentation(decisionforest::UseSparseTreeRepresentation);
+}
+
 } // namespace decisionforest
 } // namespace mlir
@@ -48,6 +48,22 @@ public:
           return mlir::VectorType::get({ GetTileSize() }, GetThresholdElementType());
   }
   virtual mlir::Value GetTreeIndex(Value tree) = 0;
+  // True if the serialized feature indices of nodes that send missing values left are 
+  // encoded (see EncodeDefaultLeftFeatureIndex) and need to be decoded during traversal
+  virtual bool RouteMissingValuesPerNode() { return false; }
+  // Categorical nodes hold the offset of their category set in the bitset memref (see 
+  // DecisionForest::AddCategoricalBitset). The features memref has an i8 per feature that is
+  // non-zero if the feature is categorical. Both are only valid if HasCategoricalSplits is true.
+  virtual bool HasCategoricalSplits() { return false; }
+  virtual mlir::Value GetCategoricalBitsetsMemref(mlir::Value treeValue) { return mlir::Value(); }
+  virtual mlir::Value GetCategoricalFeaturesMemref(mlir::Value treeValue) { return mlir::Value(); }
+  // True if the forest is compiled to count the walks that end at each leaf (see DecisionForest::ProfileLeafHits). 
+  // GenerateLeafHitCountIncrement is then called for every leaf a walk reaches.
+  virtual bool ProfileLeafHits() { return false; }
+  virtual void GenerateLeafHitCountIncrement(ConversionPatternRewriter &rewriter, mlir::Location location, 
+                                             mlir::Value treeValue, mlir::Value nodeIndex) { 
+    assert (false && "Leaf hit profiling is not supported by this representation");
+  }
 
   virtual mlir::Type GetIndexFieldType() { 
       if (GetTileSize() == 1)
@@ -81,11 +97,17 @@ protected:
   const std::string kThresholdsMemrefName = "thresholdValues";
   const std::string kFeatureIndexMemrefName = "featureIndexValues";
   const std::string kTileShapeMemrefName = "tileShapeValues";
+  const std::string kCategoricalBitsetsMemrefName = "categoricalBitsets";
+  const std::string kCategoricalFeaturesMemrefName = "categoricalFeatures";
+  const std::string kLeafHitCountsMemrefName = "leafHitCounts";
 
   typedef struct Memrefs {
     mlir::Type model;
     mlir::Type offset;
     mlir::Type classInfo;
+    mlir::Type categoricalBitsets;
+    mlir::Type categoricalFeatures;
+    mlir::Type leafHitCounts;
   } GlobalMemrefTypes;
 
   struct EnsembleConstantLoweringInfo {
@@ -98,6 +120,12 @@ protected:
     mlir::Type offsetGlobaltype;
     mlir::Type lengthGlobalType;
     mlir::Type classInfoType;
+
+    // Only set if the forest has categorical splits
+    mlir::Value categoricalBitsetsGlobal;
+    mlir::Value categoricalFeaturesGlobal;
+    // Only set if leaf hits are profiled. One counter per model memref element.
+    mlir::Value leafHitCountsGlobal;
   };
 
   // Maps an ensemble constant operation to a model memref and an offsets memref
@@ -109,6 +137,9 @@ protected:
   mlir::Type m_thresholdType;
   mlir::Type m_featureIndexType;
   mlir::Type m_tileShapeType;
+  bool m_routeMissingValuesPerNode=false;
+  bool m_hasCategoricalSplits=false;
+  bool m_profileLeafHits=false;
 
   void GenModelMemrefInitFunctionBody(MemRefType memrefType,
                                       Value getGlobalMemref,
@@ -126,6 +157,7 @@ protected:
                                   ConversionPatternRewriter &rewriter, Location location);
 
   mlir::Value GetTreeMemref(mlir::Value treeValue);
+  EnsembleConstantLoweringInfo& GetEnsembleLoweringInfo(mlir::Value treeValue);
 public:
   virtual ~ArrayBasedRepresentation() { }
   void InitRepresentation() override;
@@ -163,6 +195,17 @@ public:
     return m_tileShapeType;
   }
   mlir::Value GetTreeIndex(Value tree) override;
+  bool RouteMissingValuesPerNode() override { return m_routeMissingValuesPerNode; }
+  bool HasCategoricalSplits() override { return m_hasCategoricalSplits; }
+  mlir::Value GetCategoricalBitsetsMemref(mlir::Value treeValue) override {
+    return GetEnsembleLoweringInfo(treeValue).categoricalBitsetsGlobal;
+  }
+  mlir::Value GetCategoricalFeaturesMemref(mlir::Value treeValue) override {
+    return GetEnsembleLoweringInfo(treeValue).categoricalFeaturesGlobal;
+  }
+  bool ProfileLeafHits() override { return m_profileLeafHits; }
+  void GenerateLeafHitCountIncrement(ConversionPatternRewriter &rewriter, mlir::Location location, 
+                                     mlir::Value treeValue, mlir::Value nodeIndex) override;
 
   void AddTypeConversions(mlir::MLIRContext& context, LLVMTypeConverter& typeConverter) override;
   void AddLLVMConversionPatterns(LLVMTypeConverter &converter, RewritePatternSet &patterns) override;
@@ -193,6 +236,8 @@ protected:
   const std::string kFeatureIndexMemrefName = "featureIndexValues";
   const std::string kChildIndexMemrefName = "childIndexValues";
   const std::string kTileShapeMemrefName = "tileShapeValues";
+  const std::string kCategoricalBitsetsMemrefName = "categoricalBitsets";
+  const std::string kCategoricalFeaturesMemrefName = "categoricalFeatures";
 
   struct SparseEnsembleConstantLoweringInfo {
     mlir::Value modelGlobal;
@@ -210,6 +255,10 @@ protected:
     mlir::Type lutGlobalType;
     mlir::Type leavesGlobalType;
     mlir::Type classInfoType;
+
+    // Only set if the forest has categorical splits
+    mlir::Value categoricalBitsetsGlobal;
+    mlir::Value categoricalFeaturesGlobal;
   };
 
   struct GetTreeLoweringInfo {
@@ -226,6 +275,10 @@ protected:
   mlir::Type m_thresholdType;
   mlir::Type m_featureIndexType;
   mlir::Type m_tileShapeType;
+  bool m_routeMissingValuesPerNode=false;
+  bool m_hasCategoricalSplits=false;
+  mlir::MemRefType m_categoricalBitsetsMemrefType;
+  mlir::MemRefType m_categoricalFeaturesMemrefType;
 
   void GenModelMemrefInitFunctionBody(MemRefType memrefType, Value getGlobalMemref,
                                       mlir::OpBuilder &builder, Location location, Value tileIndex,
@@ -233,6 +286,7 @@ protected:
                                       Value tileShapeIdMemref, Value childIndexMemref);
   
   mlir::Value GetTreeMemref(mlir::Value treeValue);
+  SparseEnsembleConstantLoweringInfo& GetEnsembleLoweringInfo(mlir::Value treeValue);
 
 public:
   virtual ~SparseRepresentation() { }
@@ -278,6 +332,14 @@ public:
     return m_tileShapeType;
   }
   mlir::Value GetTreeIndex(Value tree) override;
+  bool RouteMissingValuesPerNode() override { return m_routeMissingValuesPerNode; }
+  bool HasCategoricalSplits() override { return m_hasCategoricalSplits; }
+  mlir::Value GetCategoricalBitsetsMemref(mlir::Value treeValue) override {
+    return GetEnsembleLoweringInfo(treeValue).categoricalBitsetsGlobal;
+  }
+  mlir::Value GetCategoricalFeaturesMemref(mlir::Value treeValue) override {
+    return GetEnsembleLoweringInfo(treeValue).categoricalFeaturesGlobal;
+  }
   
   void AddTypeConversions(mlir::MLIRContext& context, LLVMTypeConverter& typeConverter) override;
   void AddLLVMConversionPatterns(LLVMTypeConverter &converter, RewritePatternSet &patterns) override;
@@ -292,6 +354,67 @@ public:
                         ArrayRef<Value> operands) override;                       
 };
 
+class DecisionTree;
+
+// A tile of a tree (or a node of an untiled tree) as laid out by the hybrid representation
+struct HybridLayoutTile {
+  std::vector<double> thresholds;
+  std::vector<int32_t> indices;
+  int32_t tileShapeID = 0;
+  std::vector<int32_t> children;
+  int64_t hitCount = 0;
+  int32_t depth = 0;
+};
+
+// The slots of a tree in the hybrid representation
+struct HybridTreeLayout {
+  // Number of slots whose children are at (tileSize+1)*slot+1
+  int64_t arrayLength = 0;
+  // Index of the tile in each slot (-1 for empty slots)
+  std::vector<int32_t> tileInSlot;
+  // Slot of the first child of the tile in each slot (-1 for leaves and empty slots)
+  std::vector<int64_t> childIndices;
+};
+
+std::vector<HybridLayoutTile> GetHybridLayoutTiles(DecisionTree& tree, int32_t tileSize, bool encodeDefaultLeft);
+int32_t ChooseHybridArrayLevels(const std::vector<HybridLayoutTile>& tiles, int32_t tileSize, int64_t maxTreeLength);
+HybridTreeLayout LayOutHybridTree(const std::vector<HybridLayoutTile>& tiles, int32_t tileSize, int32_t arrayLevels);
+
+// Stores the top K tile levels of each tree as an implicit perfect tree (like the array based representation)
+// and the rest of the tree sparsely. The children of a tile in the first K-1 levels are at (tileSize+1)*i+1,
+// so walks only load child indices once they are past these levels. All other non-leaf tiles get a block of
+// tileSize+1 consecutive slots for their children at the end of the tree. K is picked separately for each
+// tree by trading the child index loads saved (weighted by the profiled hit counts of the leaves if available)
+// against the empty slots in the perfect tree. Leaves are stored inline as in the array based representation.
+class HybridRepresentation : public SparseRepresentation {
+protected:
+  const std::string kArrayLengthMemrefName = "arrayLengths";
+
+  // Maps an ensemble constant operation to the memref that has, for each tree, the number of slots
+  // whose children are found without loading a child index
+  std::map<mlir::Operation*, mlir::Value> ensembleConstantToArrayLengthsMap;
+  // Maps a GetTree operation to the array length of the tree
+  std::map<mlir::Operation*, mlir::Value> getTreeOperationToArrayLengthMap;
+
+  std::tuple<Type, Type, Type> AddGlobalMemrefs(mlir::ModuleOp module, mlir::decisionforest::EnsembleConstantOp& ensembleConstOp,
+                                                ConversionPatternRewriter &rewriter, Location location);
+  mlir::Value GetArrayLength(mlir::Value treeValue);
+public:
+  virtual ~HybridRepresentation() { }
+  void InitRepresentation() override;
+  mlir::LogicalResult GenerateModelGlobals(Operation *op, ArrayRef<Value> operands, ConversionPatternRewriter &rewriter,
+                                           std::shared_ptr<decisionforest::IModelSerializer> m_serializer) override;
+  std::vector<mlir::Value> GenerateExtraLoads(mlir::Location location,
+                                              ConversionPatternRewriter &rewriter,
+                                              mlir::Value tree,
+                                              mlir::Value nodeIndex) override;
+  void GenerateTreeMemref(mlir::ConversionPatternRewriter &rewriter, mlir::Operation *op, Value ensemble, Value treeIndex) override;
+  mlir::Value GenerateGetLeafValueOp(ConversionPatternRewriter &rewriter, mlir::Operation *op, mlir::Value treeValue,
+                                     mlir::Value nodeIndex) override;
+  mlir::Value GenerateIsLeafOp(ConversionPatternRewriter &rewriter, mlir::Operation *op, mlir::Value treeValue, mlir::Value nodeIndex) override;
+  mlir::Value GenerateIsLeafTileOp(ConversionPatternRewriter &rewriter, mlir::Operation *op, mlir::Value treeValue, mlir::Value nodeIndex) override;
+};
+
 class RepresentationFactory {
   typedef std::shared_ptr<IRepresentation> (*RepresentationConstructor_t)();
 private:
@@ -306,9 +429,10 @@ public:
 
 #define REGISTER_REPRESENTATION(name, func) __attribute__((unused)) static bool UNIQUE_NAME(register_rep_) = RepresentationFactory::Get().RegisterRepresentation(#name, func);
 
-// TODO This function needs to be removed
-// Helper to construct the right representation to work around the 
-// global "UseSparseRepresentation"
+// Construct the array or sparse representation. The overloads without arguments use the process wide 
+// default (UseSparseTreeRepresentation). Compilations should pass CompilerOptions::sparseRepresentation.
+std::shared_ptr<IRepresentation> ConstructRepresentation(bool sparseRepresentation);
+std::shared_ptr<IRepresentation> ConstructGPURepresentation(bool sparseRepresentation);
 std::shared_ptr<IRepresentation> ConstructRepresentation();
 std::shared_ptr<IRepresentation> ConstructGPURepresentation();
 
@@ -16,6 +16,13 @@ struct Memref {
   int64_t strides[Rank];
 };
 
+// How the rows of the input to the prediction function are laid out in memory
+enum class InputLayout : int32_t {
+  kRowMajor = 0,  // Dense rows, one after the other
+  kStrided,       // Arbitrary row and column strides that are passed at runtime
+  kColumnMajor    // Each feature is stored contiguously (unit row stride). The column stride is passed at runtime.
+};
+
 }
 }
 #endif // _TYPEDEFINITIONS_H_
\ No newline at end of file
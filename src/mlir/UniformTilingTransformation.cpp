@@ -20,6 +20,7 @@
 #include "TiledTree.h"
 #include "OpLoweringUtils.h"
 #include "Dialect.h"
+#include "ThreadPool.h"
 
 namespace mlir {
 namespace decisionforest {
@@ -49,10 +50,18 @@ struct TileEnsembleAttribute : public RewritePattern {
       return mlir::failure();
 
     assert (tilingDescriptor.MaxTileSize() == 1 && "Forest shouldn't already be tiled!");
+    // Trees are tiled independently, so tile them in parallel. Types are created on this thread.
+    TreeBeard::GetCompilerThreadPool().ParallelFor(forest.NumTrees(), [&](int64_t begin, int64_t end) {
+      for (int64_t i=begin ; i<end ; ++i) {
+        forest.GetTree(i).InitializeInternalNodeHitCounts();
+        TileSingleDecisionTree(forest.GetTree(i));
+        if (m_makeAllLeavesSameDepth) {
+          forest.GetTree(i).GetTiledTree()->MakeAllLeavesSameDepth();
+        }
+      }
+    });
     std::vector<Type> treeTypes;
     for (int64_t i=0 ; i<(int64_t)forest.NumTrees() ; ++i) {
-      forest.GetTree(i).InitializeInternalNodeHitCounts();
-      TileSingleDecisionTree(forest.GetTree(i));
       auto treeType = forestType.getTreeType(i).cast<decisionforest::TreeType>();
       auto newTreeType = decisionforest::TreeType::get(treeType.getResultType(), forest.GetTree(i).TilingDescriptor().MaxTileSize(), 
                                                        treeType.getThresholdType(), treeType.getFeatureIndexType(), m_tileShapeType, 
@@ -60,11 +69,6 @@ struct TileEnsembleAttribute : public RewritePattern {
       treeTypes.push_back(newTreeType);
       if (i != 0)
         assert (treeTypes.at(0) == newTreeType);
-
-      if (m_makeAllLeavesSameDepth) {
-        forest.GetTree(i).GetTiledTree()->MakeAllLeavesSameDepth();
-      }
-
     }
     // Tile this forest uniformly
     auto newForestType = decisionforest::TreeEnsembleType::get(forestType.getResultType(), forestType.getNumberOfTrees(),
@@ -9,11 +9,23 @@ treebeardAPI = TreebeardAPI()
 #### Compiler options
 #### ---------------------------------------------------------------- ####
 class CompilerOptions:
+  # Input layouts (see SetInputLayout)
+  RowMajorInput = 0
+  StridedInput = 1
+  ColumnMajorInput = 2
+
   def __init__(self, batchSize, tileSize) -> None:
     self.optionsPtr = treebeardAPI.runtime_lib.CreateCompilerOptions()
     treebeardAPI.runtime_lib.Set_batchSize(self.optionsPtr, batchSize)
     treebeardAPI.runtime_lib.Set_tileSize(self.optionsPtr, tileSize)
 
+  # Options read from a compiler config JSON (for example, one written by treebeard_autotuner)
+  @classmethod
+  def FromConfigJSON(cls, configJSONPath : str):
+    options = cls.__new__(cls)
+    options.optionsPtr = treebeardAPI.CheckHandle(treebeardAPI.runtime_lib.CreateCompilerOptionsFromConfigJSON(configJSONPath.encode('ascii')))
+    return options
+
   def __del__(self):
     treebeardAPI.runtime_lib.DeleteCompilerOptions(self.optionsPtr)
   
@@ -58,6 +70,64 @@ class CompilerOptions:
 
   def SetNumberOfCores(self, val : int) :
     treebeardAPI.runtime_lib.Set_numberOfCores(self.optionsPtr, val)
+
+  def SetDynamicBatch(self, val) :
+    treebeardAPI.runtime_lib.Set_dynamicBatch(self.optionsPtr, 1 if val else 0)
+
+  # Walk the trees on inputs binned by the distinct thresholds of each feature. Predictions are unchanged.
+  def SetQuantizeInputs(self, val) :
+    treebeardAPI.runtime_lib.Set_quantizeInputs(self.optionsPtr, 1 if val else 0)
+
+  def SetPeeledCodeGenForProbabilityBasedTiling(self, val) :
+    treebeardAPI.runtime_lib.Set_peeledCodeGenForProbabilityBasedTiling(self.optionsPtr, 1 if val else 0)
+
+  # Use the sparse tree representation. Defaults to the process wide default (SetEnableSparseRepresentation)
+  # when the options are constructed.
+  def SetSparseRepresentation(self, val) :
+    treebeardAPI.runtime_lib.Set_sparseRepresentation(self.optionsPtr, 1 if val else 0)
+
+  # Multi-class and multi-target models return a (rows, outputs) matrix (class probabilities for softmax 
+  # classifiers) instead of the most likely class of each row.
+  def SetReturnAllOutputs(self, val) :
+    treebeardAPI.runtime_lib.Set_returnAllOutputs(self.optionsPtr, 1 if val else 0)
+
+  # Count the rows that reach each leaf in the generated code. Needs a tile size of 1 and trees walked 
+  # in model order. See ComputeProbabilityProfile.
+  def SetProfileLeafHits(self, val) :
+    treebeardAPI.runtime_lib.Set_profileLeafHits(self.optionsPtr, 1 if val else 0)
+
+  # Walk groups of trees that read overlapping features for a tile of this many rows at a time (for wide models).
+  def SetFeatureGroupBatchTileSize(self, val : int) :
+    treebeardAPI.runtime_lib.Set_featureGroupBatchTileSize(self.optionsPtr, val)
+
+  # Models compiled for StridedInput read arbitrary numpy views in place. Models compiled for 
+  # ColumnMajorInput read Fortran ordered arrays (and views with a unit row stride) in place.
+  def SetInputLayout(self, val : int) :
+    treebeardAPI.runtime_lib.Set_inputLayout(self.optionsPtr, val)
+    treebeardAPI.CheckForError()
+
+  # Binary classifiers with a sigmoid transformation stop walking trees for a row once no remaining
+  # tree can move its probability across val. Predicted labels (probability > val) are unchanged,
+  # but the returned probabilities are only accurate on the correct side of val.
+  def SetEarlyExitThreshold(self, val : float) :
+    treebeardAPI.runtime_lib.Set_earlyExitThreshold(self.optionsPtr, val)
+    treebeardAPI.CheckForError()
+
+  # LLVM optimization level (0-3) used for the JIT and for generated LLVM IR
+  def SetOptimizationLevel(self, val : int) :
+    treebeardAPI.runtime_lib.Set_optimizationLevel(self.optionsPtr, val)
+
+  # Target CPU (e.g. "skylake-avx512" or "host")
+  def SetTargetCPU(self, val : str) :
+    treebeardAPI.runtime_lib.Set_targetCPU(self.optionsPtr, val.encode('ascii'))
+
+  # LLVM target feature string (e.g. "+avx2,+fma" or "host")
+  def SetTargetFeatures(self, val : str) :
+    treebeardAPI.runtime_lib.Set_targetFeatures(self.optionsPtr, val.encode('ascii'))
+
+  # Reuse compiled models stored in this directory (and store newly compiled ones there)
+  def SetCompilationCacheDirectory(self, val : str) :
+    treebeardAPI.runtime_lib.Set_compilationCacheDirectory(self.optionsPtr, val.encode('ascii'))
   
   def SetStatsProfileCSVPath(self, val : str) :
     valStr = val.encode('ascii')
@@ -153,6 +223,7 @@ class TreebeardContext:
   def SetInputFiletype(self, file_type:str) -> None:
     # print("TBContext_SetType: ", self.tbcontextPtr, type(self.tbcontextPtr))
     treebeardAPI.SetForestCreatorType(self.tbcontextPtr, file_type)
+    treebeardAPI.CheckForError()
 
   def SetRepresentationType(self, rep_type:str) -> None:
     treebeardAPI.SetRepresentationAndSerializer(self.tbcontextPtr, rep_type)
@@ -163,6 +234,18 @@ class TreebeardContext:
 
   def BuildHIRRepresentation(self):
     treebeardAPI.runtime_lib.BuildHIRRepresentation(self.tbcontextPtr)
+    treebeardAPI.CheckForError()
+
+  # Shape of the model. Must be called after BuildHIRRepresentation.
+  def GetForestStatistics(self):
+    stats = numpy.zeros(6, numpy.float64)
+    treebeardAPI.runtime_lib.GetForestStatistics(self.tbcontextPtr, stats.ctypes.data_as(ctypes.c_void_p))
+    return { "numTrees" : int(stats[0]),
+             "numFeatures" : int(stats[1]),
+             "numClasses" : int(stats[2]),
+             "maxDepth" : int(stats[3]),
+             "averageDepth" : stats[4],
+             "averageNodesPerTree" : stats[5] }
 
   def DumpLLVMIR(self, path: str):
     self.BuildHIRRepresentation()
@@ -170,7 +253,7 @@ class TreebeardContext:
 
   def ConstructInferenceRunnerFromHIR(self):
     inferenceRunner = TreebeardInferenceRunner()
-    inferenceRunner.inferenceRunner = int(treebeardAPI.runtime_lib.ConstructInferenceRunnerFromHIR(self.tbcontextPtr))
+    inferenceRunner.inferenceRunner = treebeardAPI.CheckHandle(treebeardAPI.runtime_lib.ConstructInferenceRunnerFromHIR(self.tbcontextPtr))
     inferenceRunner.rowSize = treebeardAPI.GetRowSize(inferenceRunner.inferenceRunner)
     inferenceRunner.batchSize = treebeardAPI.GetBatchSize(inferenceRunner.inferenceRunner)
     return inferenceRunner
@@ -199,7 +282,7 @@ class TreebeardInferenceRunner:
     modelJSONPath = modelJSONPathStr.encode('ascii')
     profileCSVPath = profileCSVPathStr.encode('ascii')
   
-    inferenceRunner.inferenceRunner = treebeardAPI.runtime_lib.CreateInferenceRunner(modelJSONPath, profileCSVPath, options.optionsPtr)
+    inferenceRunner.inferenceRunner = treebeardAPI.CheckHandle(treebeardAPI.runtime_lib.CreateInferenceRunner(modelJSONPath, profileCSVPath, options.optionsPtr))
     inferenceRunner.rowSize = treebeardAPI.GetRowSize(inferenceRunner.inferenceRunner)
     inferenceRunner.batchSize = treebeardAPI.GetBatchSize(inferenceRunner.inferenceRunner)
     return inferenceRunner
@@ -207,29 +290,288 @@ class TreebeardInferenceRunner:
   @classmethod
   def FromTBContext(self, tbContext):
     inferenceRunner = TreebeardInferenceRunner()
-    treebeardAPI.runtime_lib.BuildHIRRepresentation(tbContext.tbcontextPtr)
-    inferenceRunner.inferenceRunner = int(treebeardAPI.runtime_lib.ConstructInferenceRunnerFromHIR(tbContext.tbcontextPtr))
+    tbContext.BuildHIRRepresentation()
+    inferenceRunner.inferenceRunner = treebeardAPI.CheckHandle(treebeardAPI.runtime_lib.ConstructInferenceRunnerFromHIR(tbContext.tbcontextPtr))
     inferenceRunner.rowSize = treebeardAPI.GetRowSize(inferenceRunner.inferenceRunner)
     inferenceRunner.batchSize = treebeardAPI.GetBatchSize(inferenceRunner.inferenceRunner)
     return inferenceRunner
 
   def __del__(self):
     self.treebeardAPI.DeleteInferenceRunner(self.inferenceRunner)
+
+  # Hands the native runner over to the caller (for example, a VersionedInferenceRunner). This object can't be used afterwards.
+  def Release(self):
+    inferenceRunner = self.inferenceRunner
+    self.inferenceRunner = 0
+    return inferenceRunner
   
+  # Returns the inputs, copied into the layout the model was compiled for if they can't be read in place,
+  # along with their row and column strides in elements.
+  def GetInputsAndStrides(self, inputs):
+    inputLayout = self.GetInputLayout()
+    if inputLayout == CompilerOptions.RowMajorInput:
+      inputs = numpy.ascontiguousarray(inputs)
+    elif inputLayout == CompilerOptions.ColumnMajorInput and inputs.strides[0] != inputs.itemsize:
+      inputs = numpy.asfortranarray(inputs)
+    rowStride, columnStride = [stride // inputs.itemsize for stride in inputs.strides]
+    return inputs, rowStride, columnStride
+
+  def RunInferenceOnStridedInput(self, inputs, results, numRows):
+    inputs, rowStride, columnStride = self.GetInputsAndStrides(inputs)
+    self.treebeardAPI.RunInferenceOnStridedInput(self.inferenceRunner, inputs.ctypes.data_as(ctypes.c_void_p), results.ctypes.data_as(ctypes.c_void_p),
+                                                 numRows, rowStride, columnStride)
+
+  # A (numRows, outputs) matrix for models that return all outputs (CompilerOptions.SetReturnAllOutputs), 
+  # for example the class probabilities of a softmax classifier. A vector of numRows predictions otherwise.
+  def AllocateResults(self, numRows, resultType):
+    numOutputs = self.GetNumberOfOutputs()
+    if numOutputs == 1:
+      return numpy.zeros((numRows), resultType)
+    return numpy.zeros((numRows, numOutputs), resultType)
+
   def RunInference(self, inputs, resultType=numpy.float32):
     assert type(inputs) is numpy.ndarray
-    inputs_np = inputs
-    results = numpy.zeros((self.batchSize), resultType)
+    results = self.AllocateResults(self.batchSize, resultType)
+    if self.GetInputLayout() != CompilerOptions.RowMajorInput:
+      self.RunInferenceOnStridedInput(inputs, results, self.batchSize)
+      return results
+    inputs_np = numpy.ascontiguousarray(inputs)
     self.treebeardAPI.RunInference(self.inferenceRunner, inputs_np.ctypes.data_as(ctypes.c_void_p), results.ctypes.data_as(ctypes.c_void_p))
     return results
 
+  # numRows need not be a multiple of the batch size. The rows of the last partial 
+  # batch go through the compiled remainder path if the model was compiled with 
+  # dynamic batch enabled (CompilerOptions.SetDynamicBatch) and are padded otherwise.
   def RunInferenceOnMultipleBatches(self, inputs, resultType=numpy.float32):
     assert type(inputs) is numpy.ndarray
     numRows = inputs.shape[0]
-    results = numpy.zeros((numRows), resultType)
+    results = self.AllocateResults(numRows, resultType)
+    if self.GetInputLayout() != CompilerOptions.RowMajorInput:
+      self.RunInferenceOnStridedInput(inputs, results, numRows)
+      return results
+    inputs = numpy.ascontiguousarray(inputs)
     self.treebeardAPI.RunInferenceOnMultipleBatches(self.inferenceRunner, inputs.ctypes.data_as(ctypes.c_void_p), results.ctypes.data_as(ctypes.c_void_p), numRows)
     return results
 
+  def RunInferenceOnPartialBatch(self, inputs, resultType=numpy.float32):
+    assert type(inputs) is numpy.ndarray
+    numRows = inputs.shape[0]
+    assert numRows <= self.batchSize
+    results = self.AllocateResults(numRows, resultType)
+    if self.GetInputLayout() != CompilerOptions.RowMajorInput:
+      self.RunInferenceOnStridedInput(inputs, results, numRows)
+      return results
+    inputs = numpy.ascontiguousarray(inputs)
+    self.treebeardAPI.RunInferenceOnPartialBatch(self.inferenceRunner, inputs.ctypes.data_as(ctypes.c_void_p), results.ctypes.data_as(ctypes.c_void_p), numRows)
+    return results
+
+  def IsDynamicBatch(self):
+    return self.treebeardAPI.IsDynamicBatch(self.inferenceRunner)
+
+  def GetInputLayout(self):
+    return self.treebeardAPI.GetInputLayout(self.inferenceRunner)
+
+  def IsEarlyExitEnabled(self):
+    return self.treebeardAPI.IsEarlyExitEnabled(self.inferenceRunner)
+
+  def GetNumberOfOutputs(self):
+    return self.treebeardAPI.GetNumberOfOutputs(self.inferenceRunner)
+
+  def GetNumberOfTrees(self):
+    return self.treebeardAPI.GetNumberOfTrees(self.inferenceRunner)
+
+  # The predictions of one of the models of a multi-model manifest (see WriteMultiModelManifest) from the results of the combined model
+  def GetModelResults(self, results, modelIndex):
+    assert type(results) is numpy.ndarray and results.flags['C_CONTIGUOUS']
+    numRows = results.shape[0]
+    modelResults = numpy.zeros((numRows), results.dtype)
+    self.treebeardAPI.GetModelResults(self.inferenceRunner, results.ctypes.data_as(ctypes.c_void_p), numRows, modelIndex,
+                                      modelResults.ctypes.data_as(ctypes.c_void_p))
+    return modelResults
+
+  # Runs the rows through the model numRepeats times on the calling thread and returns hardware counters 
+  # normalized per row (or None if perf_event_open isn't available, for example because of perf_event_paranoid). 
+  # Counters the CPU doesn't support are NaN.
+  def ProfileInference(self, inputs, numRepeats=10, resultType=numpy.float32):
+    assert type(inputs) is numpy.ndarray
+    numRows = inputs.shape[0]
+    results = self.AllocateResults(numRows, resultType)
+    if self.GetInputLayout() == CompilerOptions.ColumnMajorInput:
+      inputs = numpy.asfortranarray(inputs)
+    else:
+      inputs = numpy.ascontiguousarray(inputs)
+    profile = numpy.zeros(6, numpy.float64)
+    if not self.treebeardAPI.ProfileInference(self.inferenceRunner, inputs.ctypes.data_as(ctypes.c_void_p), results.ctypes.data_as(ctypes.c_void_p),
+                                              numRows, numRepeats, profile.ctypes.data_as(ctypes.c_void_p)):
+      return None
+    return { "rows" : int(profile[0]),
+             "cycles_per_row" : profile[1],
+             "instructions_per_cycle" : profile[2],
+             "l1d_misses_per_row" : profile[3],
+             "llc_misses_per_row" : profile[4],
+             "branch_misses_per_tree_per_row" : profile[5] }
+
+  # Average number of trees walked per row since the model was loaded or ResetEarlyExitStatistics was called
+  def GetAverageTreesWalkedPerRow(self):
+    return self.treebeardAPI.GetAverageTreesWalkedPerRow(self.inferenceRunner)
+
+  def ResetEarlyExitStatistics(self):
+    self.treebeardAPI.ResetEarlyExitStatistics(self.inferenceRunner)
+
+  # Full batches of a RunInferenceOnMultipleBatches call are split across numThreads threads. Workers 
+  # are pinned to cores only if pinToCores is set (pinned runners in a process all use the same cores).
+  def SetNumberOfThreads(self, numThreads, pinToCores=False):
+    self.treebeardAPI.SetNumberOfRuntimeThreads(self.inferenceRunner, numThreads, pinToCores)
+
+  def GetNumberOfThreads(self):
+    return self.treebeardAPI.GetNumberOfRuntimeThreads(self.inferenceRunner)
+
+# A model handle whose runner can be replaced (SwapModel) while other threads run inference on it. The old runner 
+# is freed once the calls running on it return. Takes ownership of the runners it is given.
+class VersionedInferenceRunner:
+  def __init__(self, inferenceRunner : TreebeardInferenceRunner) -> None:
+    self.treebeardAPI = treebeardAPI
+    self.versionedRunner = treebeardAPI.runtime_lib.CreateVersionedInferenceRunner(inferenceRunner.Release())
+    # SwapModel rejects models with a different number of outputs or input layout, so these are read once
+    self.numOutputs = treebeardAPI.runtime_lib.VersionedInferenceRunner_GetNumberOfOutputs(self.versionedRunner)
+    self.columnMajorInput = treebeardAPI.runtime_lib.VersionedInferenceRunner_GetInputLayout(self.versionedRunner) == CompilerOptions.ColumnMajorInput
+
+  def __del__(self):
+    self.treebeardAPI.runtime_lib.DeleteVersionedInferenceRunner(self.versionedRunner)
+
+  def RunInferenceOnMultipleBatches(self, inputs, resultType=numpy.float32):
+    assert type(inputs) is numpy.ndarray
+    numRows = inputs.shape[0]
+    results = numpy.zeros((numRows), resultType) if self.numOutputs == 1 else numpy.zeros((numRows, self.numOutputs), resultType)
+    if self.columnMajorInput:
+      inputs = numpy.asfortranarray(inputs)
+    else:
+      inputs = numpy.ascontiguousarray(inputs)
+    self.treebeardAPI.runtime_lib.VersionedInferenceRunner_RunInferenceOnMultipleBatches(self.versionedRunner, inputs.ctypes.data_as(ctypes.c_void_p), 
+                                                                                         results.ctypes.data_as(ctypes.c_void_p), numRows)
+    return results
+
+  # Returns the version of the new model. Blocks until the calls running on the old model return. Raises (and frees
+  # the new model) if its row size, input element type, input layout, number of outputs or return type differ.
+  def SwapModel(self, inferenceRunner : TreebeardInferenceRunner):
+    version = self.treebeardAPI.runtime_lib.SwapModel(self.versionedRunner, inferenceRunner.Release())
+    self.treebeardAPI.CheckForError()
+    return version
+
+  def GetVersion(self):
+    return self.treebeardAPI.runtime_lib.GetModelVersion(self.versionedRunner)
+
+# Runs a probabilistically tiled model and re-tiles it (on a background thread) when the leaf distribution of a sample
+# of the rows it sees drifts from that of the profile it was tiled with. samplingFraction of the calls are sampled and 
+# drift is checked every minSampledRows sampled rows. See TreeBeard::OnlineRetilingRunner.
+class OnlineRetilingInferenceRunner:
+  def __init__(self, modelJSONPath : str, profileCSVPath : str, options : CompilerOptions, 
+               samplingFraction : float = 0.01, driftThreshold : float = 0.1, minSampledRows : int = 10000) -> None:
+    self.treebeardAPI = treebeardAPI
+    self.onlineRunner = 0
+    self.onlineRunner = treebeardAPI.CheckHandle(treebeardAPI.runtime_lib.CreateOnlineRetilingRunner(modelJSONPath.encode('ascii'), profileCSVPath.encode('ascii'), 
+                                                                                                    options.optionsPtr, samplingFraction, driftThreshold, minSampledRows))
+
+  def __del__(self):
+    self.treebeardAPI.runtime_lib.DeleteOnlineRetilingRunner(self.onlineRunner)
+
+  def RunInferenceOnMultipleBatches(self, inputs, resultType=numpy.float32):
+    assert type(inputs) is numpy.ndarray
+    numRows = inputs.shape[0]
+    numOutputs = self.treebeardAPI.runtime_lib.OnlineRetilingRunner_GetNumberOfOutputs(self.onlineRunner)
+    results = numpy.zeros((numRows), resultType) if numOutputs == 1 else numpy.zeros((numRows, numOutputs), resultType)
+    if self.treebeardAPI.runtime_lib.OnlineRetilingRunner_GetInputLayout(self.onlineRunner) == CompilerOptions.ColumnMajorInput:
+      inputs = numpy.asfortranarray(inputs)
+    else:
+      inputs = numpy.ascontiguousarray(inputs)
+    self.treebeardAPI.runtime_lib.OnlineRetilingRunner_RunInferenceOnMultipleBatches(self.onlineRunner, inputs.ctypes.data_as(ctypes.c_void_p), 
+                                                                                     results.ctypes.data_as(ctypes.c_void_p), numRows)
+    return results
+
+  # Mean total variation distance between the sampled and profiled leaf distributions at the last drift check
+  def GetDrift(self):
+    return self.treebeardAPI.runtime_lib.OnlineRetilingRunner_GetDrift(self.onlineRunner)
+
+  def GetRecompileCount(self):
+    return self.treebeardAPI.runtime_lib.OnlineRetilingRunner_GetRecompileCount(self.onlineRunner)
+
+  def GetSampledRowCount(self):
+    return self.treebeardAPI.runtime_lib.OnlineRetilingRunner_GetSampledRowCount(self.onlineRunner)
+
+  # Message of the last drift check or recompilation that failed (the current model keeps serving). Empty if none has.
+  def GetRetilingError(self):
+    return self.treebeardAPI.runtime_lib.OnlineRetilingRunner_GetRetilingError(self.onlineRunner).decode('utf-8')
+
+  def WaitForRecompilation(self):
+    self.treebeardAPI.runtime_lib.OnlineRetilingRunner_WaitForRecompilation(self.onlineRunner)
+
+#### ---------------------------------------------------------------- ####
+#### Model importers
+#### ---------------------------------------------------------------- ####
+
+# Writes a scikit-learn RandomForest/ExtraTrees classifier or regressor as JSON that Treebeard reads with the
+# "sklearn_json" input file type. Classifiers predict the index of the class in model.classes_.
+#   voting="soft" : each estimator adds one tree per class whose leaves are the class probabilities and the
+#                   forest averages them (like predict_proba). All outputs are the probabilities.
+#   voting="hard" : each estimator adds one tree whose leaves are the class it predicts and the forest predicts
+#                   the class with the most votes. All outputs are the fractions of votes.
+def ExportSKLearnModel(model, modelJSONPath : str, voting : str = "soft") -> None:
+  import json
+  assert voting in ["soft", "hard"]
+  isClassifier = hasattr(model, "classes_")
+  assert not isClassifier or len(model.classes_.shape) == 1, "Multi-output models are not supported"
+  numClasses = len(model.classes_) if isClassifier else 0
+  trees = []
+  for estimator in model.estimators_:
+    tree = estimator.tree_
+    assert tree.n_outputs == 1, "Multi-output models are not supported"
+    treeArrays = {
+      "children_left" : tree.children_left.tolist(),
+      "children_right" : tree.children_right.tolist(),
+      "feature" : tree.feature.tolist(),
+      "threshold" : tree.threshold.tolist(),
+    }
+    if hasattr(tree, "missing_go_to_left"):
+      treeArrays["missing_go_to_left"] = tree.missing_go_to_left.astype(int).tolist()
+    if not isClassifier:
+      trees.append(dict(treeArrays, class_id=0, value=tree.value[:, 0, 0].tolist()))
+      continue
+    # Older versions of scikit-learn store the number of samples of each class rather than the fractions
+    classCounts = tree.value[:, 0, :]
+    probabilities = classCounts / classCounts.sum(axis=1, keepdims=True)
+    if voting == "hard":
+      trees.append(dict(treeArrays, class_id=0, value=numpy.argmax(probabilities, axis=1).astype(float).tolist()))
+      continue
+    for classId in range(numClasses):
+      trees.append(dict(treeArrays, class_id=classId, value=probabilities[:, classId].tolist()))
+  modelJSON = {
+    "n_features" : int(model.n_features_in_),
+    "n_classes" : numClasses,
+    "reduction" : "voting" if isClassifier and voting == "hard" else "average",
+    "trees" : trees
+  }
+  with open(modelJSONPath, "w") as modelFile:
+    json.dump(modelJSON, modelFile)
+
+# Write a manifest that compiles several single output XGBoost models (JSON or UBJSON) into one model. The path 
+# must end with ".models.json". The combined model reads each row once for all the models and, when compiled with 
+# CompilerOptions.SetReturnAllOutputs, returns a (numRows, numModels) matrix whose columns are the models' predictions 
+# (see TreebeardInferenceRunner.GetModelResults). Rows hold the features of the model with the most features.
+def WriteMultiModelManifest(manifestPath : str, modelPaths : List[str]) -> None:
+  import json
+  import os
+  assert manifestPath.endswith(".models.json")
+  with open(manifestPath, "w") as manifestFile:
+    json.dump({ "models" : [os.path.abspath(modelPath) for modelPath in modelPaths] }, manifestFile)
+
+# Write the leaf hit profile that probability based tiling reads (CompilerOptions.SetStatsProfileCSVPath) for 
+# the rows of a CSV (with the expected prediction in the last column). The leaf hits are counted by a compiled 
+# model, so this is much faster than the interpreter based profiling. Only the first numRows rows are used if 
+# numRows is not negative.
+def ComputeProbabilityProfile(modelJSONPath : str, csvPath : str, profileCSVPath : str, numRows : int = -1, batchSize : int = 200):
+  treebeardAPI.runtime_lib.ComputeProbabilityProfile(modelJSONPath.encode('ascii'), csvPath.encode('ascii'), 
+                                                     profileCSVPath.encode('ascii'), numRows, batchSize)
+
 #### ---------------------------------------------------------------- ####
 #### Treebeard API -- Do not use these!
 #### ---------------------------------------------------------------- ####
@@ -238,6 +580,7 @@ def GenerateLLVMIRForXGBoostModel(modelJSONPathStr, llvmIRPathStr, modelGlobalsJ
   llvmIRPath = llvmIRPathStr.encode('ascii')
   modelGlobalsJSONPath = modelGlobalsJSONPathStr.encode('ascii')
   treebeardAPI.runtime_lib.GenerateLLVMIRForXGBoostModel(ctypes.c_char_p(modelJSONPath), ctypes.c_char_p(llvmIRPath), ctypes.c_char_p(modelGlobalsJSONPath), options.optionsPtr)
+  treebeardAPI.CheckForError()
 
 def SetEnableSparseRepresentation(val):
   treebeardAPI.runtime_lib.SetEnableSparseRepresentation(1 if val else 0)
@@ -250,3 +593,14 @@ def SetPeeledCodeGenForProbabilityBasedTiling(val):
 
 def IsPeeledCodeGenForProbabilityBasedTilingEnabled():
   return treebeardAPI.runtime_lib.IsPeeledCodeGenForProbabilityBasedTilingEnabled()
+
+# Print the time spent in each compilation phase
+def SetEnableCompileTimeLogging(val):
+  treebeardAPI.runtime_lib.SetEnableCompileTimeLogging(1 if val else 0)
+
+# Returns (hits, misses) for the compilation caches used in this process
+def GetCompilationCacheStatistics():
+  return (treebeardAPI.runtime_lib.GetCompilationCacheHits(), treebeardAPI.runtime_lib.GetCompilationCacheMisses())
+
+def ResetCompilationCacheStatistics():
+  treebeardAPI.runtime_lib.ResetCompilationCacheStatistics()
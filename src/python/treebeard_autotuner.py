@@ -0,0 +1,377 @@
+import os
+import sys
+import json
+import math
+import time
+import argparse
+import platform
+import subprocess
+import tempfile
+import numpy
+import pandas
+import treebeard
+
+#### ---------------------------------------------------------------- ####
+#### Autotuner
+####
+#### Searches batch sizes, tile sizes, tiling types, representations and
+#### the schedule options (pipelining trees reordered by depth and
+#### parallelizing across cores) for a model and an input CSV. Candidates
+#### are compiled with the JIT and timed on the inputs. A cost model
+#### computed from the shape of the model prunes candidates that aren't
+#### worth compiling. The best configuration is written as a compiler
+#### config JSON that CompilerOptions(configJSONFilePath) (and
+#### treebeard.CompilerOptions.FromConfigJSON) can load. The
+#### "representation" key of this JSON is not a compiler option. Pass
+#### it to TreebeardContext.SetRepresentationType (see LoadConfiguration).
+#### ---------------------------------------------------------------- ####
+
+DefaultConfiguration = {
+  "batchSize" : 256,
+  "tileSize" : 8,
+  "tilingType" : "Uniform",
+  # The default representation of the compiler (also assumed for config JSONs without one)
+  "representation" : "array",
+  "makeAllLeavesSameDepth" : False,
+  "reorderTreesByDepth" : False,
+  "pipelineSize" : -1,
+  # -1 leaves the generated code serial
+  "numberOfCores" : -1
+}
+
+ReturnTypeConfigurations = {
+  "float32" : { "returnTypeWidth" : 32, "returnTypeFloatType" : True },
+  "float64" : { "returnTypeWidth" : 64, "returnTypeFloatType" : True },
+  "int8" : { "returnTypeWidth" : 8, "returnTypeFloatType" : False }
+}
+
+def WriteConfigJSON(config : dict, configJSONPath : str) -> None:
+  with open(configJSONPath, "w") as configFile:
+    json.dump(config, configFile, indent=2)
+
+# Returns the compiler options and the representation stored in a config JSON written by the autotuner
+def LoadConfiguration(configJSONPath : str):
+  with open(configJSONPath) as configFile:
+    config = json.load(configFile)
+  return treebeard.CompilerOptions.FromConfigJSON(configJSONPath), config.get("representation", DefaultConfiguration["representation"])
+
+def ReadInputs(csvPath : str, numFeatures : int, minRows : int) -> numpy.ndarray:
+  data = numpy.array(pandas.read_csv(csvPath, header=None), order='C')
+  # Test inputs have the expected prediction in the last column
+  inputs = numpy.array(data[:, :numFeatures], numpy.float32, order='C')
+  if inputs.shape[0] < minRows:
+    inputs = numpy.tile(inputs, (math.ceil(minRows/inputs.shape[0]), 1))
+  return inputs
+
+def ConstructTreebeardContext(modelPath, inputType, config, workDir, name):
+  configJSONPath = os.path.join(workDir, name + ".config.json")
+  WriteConfigJSON(config, configJSONPath)
+  options = treebeard.CompilerOptions.FromConfigJSON(configJSONPath)
+  tbContext = treebeard.TreebeardContext(modelPath, os.path.join(workDir, name + ".globals.json"), options)
+  tbContext.SetRepresentationType(config["representation"])
+  tbContext.SetInputFiletype(inputType)
+  # The context keeps a copy of the options
+  return tbContext
+
+# Compiles the model with config and times it. Runs in a separate process unless isolation is
+# turned off so that configurations the compiler can't handle don't end the search.
+def MeasureConfiguration(request : dict) -> dict:
+  tbContext = ConstructTreebeardContext(request["modelPath"], request["inputType"], request["config"], request["workDir"], request["name"])
+  start = time.time()
+  inferenceRunner = treebeard.TreebeardInferenceRunner.FromTBContext(tbContext)
+  compileTime = time.time() - start
+
+  returnType = numpy.dtype(request["returnType"]).type
+  inputs = ReadInputs(request["csvPath"], inferenceRunner.rowSize, request["minRows"])
+  results = inferenceRunner.RunInferenceOnMultipleBatches(inputs, returnType)
+  times = []
+  for i in range(request["numRepeats"]):
+    start = time.perf_counter()
+    inferenceRunner.RunInferenceOnMultipleBatches(inputs, returnType)
+    times.append(time.perf_counter() - start)
+  measurement = { "rowsPerSecond" : inputs.shape[0] / float(numpy.median(times)), "compileTime" : compileTime }
+  if request["profile"]:
+    measurement["counters"] = inferenceRunner.ProfileInference(inputs, 1, returnType)
+  numpy.save(request["resultsPath"], results)
+  return measurement
+
+class TuningDatabase:
+  Version = 1
+
+  def __init__(self, databasePath : str) -> None:
+    self.databasePath = databasePath
+    self.entries = {}
+    if databasePath != "" and os.path.exists(databasePath):
+      with open(databasePath) as databaseFile:
+        database = json.load(databaseFile)
+      if database.get("version") == TuningDatabase.Version:
+        self.entries = database["entries"]
+
+  # Models of the same shape, compiled with the same fixed options, share tuned configurations on a host
+  @staticmethod
+  def Key(statistics : dict, fixedConfig : dict, maxCores : int) -> str:
+    cpuName = platform.processor()
+    if os.path.exists("/proc/cpuinfo"):
+      with open("/proc/cpuinfo") as cpuInfo:
+        for line in cpuInfo:
+          if line.startswith("model name"):
+            cpuName = line.split(":", 1)[1].strip()
+            break
+    key = {
+      "host" : cpuName,
+      "maxCores" : maxCores,
+      "numTrees" : statistics["numTrees"],
+      "numFeatures" : statistics["numFeatures"],
+      "numClasses" : statistics["numClasses"],
+      "maxDepth" : statistics["maxDepth"],
+      "averageDepth" : round(statistics["averageDepth"], 1),
+      "averageNodesPerTree" : round(statistics["averageNodesPerTree"]),
+      "fixedConfig" : fixedConfig
+    }
+    return json.dumps(key, sort_keys=True)
+
+  def Lookup(self, key : str):
+    return self.entries.get(key)
+
+  def Store(self, key : str, entry : dict) -> None:
+    self.entries[key] = entry
+    if self.databasePath == "":
+      return
+    tempPath = self.databasePath + ".tmp"
+    with open(tempPath, "w") as databaseFile:
+      json.dump({ "version" : TuningDatabase.Version, "entries" : self.entries }, databaseFile, indent=2)
+    os.replace(tempPath, self.databasePath)
+
+class Autotuner:
+  def __init__(self, modelPath : str, inputType : str, csvPath : str, returnType=numpy.float32,
+               baseConfig : dict = {}, databasePath : str = "", maxCores : int = 1) -> None:
+    self.modelPath = os.path.abspath(modelPath)
+    self.inputType = inputType
+    self.csvPath = os.path.abspath(csvPath)
+    self.returnType = numpy.dtype(returnType).name
+    assert self.returnType in ReturnTypeConfigurations
+    # Options that aren't tuned (type widths, input layout etc.)
+    self.fixedConfig = dict(ReturnTypeConfigurations[self.returnType])
+    self.fixedConfig.update({ key : value for key, value in baseConfig.items() if key not in DefaultConfiguration })
+    self.database = TuningDatabase(databasePath)
+    self.maxCores = maxCores
+
+    # Search space
+    self.representations = ["array", "sparse", "hybrid"]
+    self.tileSizes = [1, 4, 8, 16]
+    self.batchSizes = [64, 128, 256, 512, 1024]
+    self.pipelineSizes = [-1, 4, 8]
+    self.tilingTypes = ["Uniform", "Probability"] if "statsProfileCSVPath" in self.fixedConfig else ["Uniform"]
+
+    # Measurement and pruning parameters
+    self.numRepeats = 5
+    self.minRows = 4096
+    self.isolate = True
+    self.timeout = 600
+    self.profile = False
+    # Candidates whose estimated cost is more than pruneFactor times the cheapest candidate of the stage
+    # aren't measured. At most maxCandidatesPerStage candidates of a stage are measured.
+    self.pruneFactor = 2.0
+    self.maxCandidatesPerStage = 8
+    # Size of the cache the model should fit in and the largest model the array representation may use
+    self.cacheBytes = 4 << 20
+    self.maxArrayModelBytes = 1 << 28
+    self.verbose = True
+
+    self.measurements = []
+    self.referenceResults = None
+    self.statistics = None
+
+  def Log(self, *args) -> None:
+    if self.verbose:
+      print("[autotuner]", *args, flush=True)
+
+  def GetStatistics(self) -> dict:
+    if self.statistics is None:
+      with tempfile.TemporaryDirectory() as workDir:
+        config = dict(DefaultConfiguration, **self.fixedConfig)
+        tbContext = ConstructTreebeardContext(self.modelPath, self.inputType, config, workDir, "statistics")
+        tbContext.BuildHIRRepresentation()
+        self.statistics = tbContext.GetForestStatistics()
+    return self.statistics
+
+  def EstimateModelBytes(self, config : dict) -> float:
+    stats = self.GetStatistics()
+    tileSize = config["tileSize"]
+    thresholdBytes = self.fixedConfig.get("thresholdTypeWidth", 32) / 8
+    featureIndexBytes = self.fixedConfig.get("featureIndexTypeWidth", 16) / 8
+    tileShapeBytes = self.fixedConfig.get("tileShapeBitWidth", 16) / 8 if tileSize > 1 else 0
+    childIndexBytes = self.fixedConfig.get("childIndexBitWidth", 16) / 8
+    tileBytes = tileSize * (thresholdBytes + featureIndexBytes) + tileShapeBytes
+    if config["representation"] == "array":
+      # Trees are stored as complete tile trees
+      tileTreeDepth = math.ceil((stats["maxDepth"] + 1) / math.log2(tileSize + 1))
+      tilesPerTree = sum(min((tileSize + 1) ** level, 1 << 40) for level in range(tileTreeDepth))
+      return stats["numTrees"] * tilesPerTree * tileBytes
+    # About half the nodes are leaves and they are stored separately
+    internalNodes = stats["averageNodesPerTree"] / 2
+    tilesPerTree = math.ceil(internalNodes / tileSize) + 1
+    return stats["numTrees"] * (tilesPerTree * (tileBytes + childIndexBytes) + (internalNodes + 1) * thresholdBytes)
+
+  # Relative cost of a row. Tiles on a walk are compared with vector instructions, so their cost grows
+  # slowly with the tile size. Models that don't fit in the cache pay for the misses and small batches
+  # pay the per batch overheads more often.
+  def EstimateCost(self, config : dict) -> float:
+    stats = self.GetStatistics()
+    tileSize = config["tileSize"]
+    tilesWalked = math.ceil(max(stats["averageDepth"], 1.0) / math.log2(tileSize + 1))
+    tileCost = 1.0 + 0.125 * (tileSize - 1)
+    modelBytes = self.EstimateModelBytes(config)
+    memoryFactor = 1.0 if modelBytes <= self.cacheBytes else 1.0 + math.log2(modelBytes / self.cacheBytes)
+    batchFactor = 1.0 + 16.0 / config["batchSize"]
+    pipelineFactor = 0.85 if config["pipelineSize"] > 1 else 1.0
+    return stats["numTrees"] * tilesWalked * tileCost * memoryFactor * batchFactor * pipelineFactor / max(config["numberOfCores"], 1)
+
+  def IsFeasible(self, config : dict) -> bool:
+    if config["representation"] == "array" and self.EstimateModelBytes(config) > self.maxArrayModelBytes:
+      return False
+    if config["tilingType"] == "Probability" and config["tileSize"] == 1:
+      return False
+    return True
+
+  def ResultsMatch(self, results) -> bool:
+    if self.referenceResults is None:
+      self.referenceResults = results
+      return True
+    if results.shape != self.referenceResults.shape:
+      return False
+    if numpy.issubdtype(results.dtype, numpy.floating):
+      return numpy.allclose(results, self.referenceResults, rtol=1e-4, atol=1e-5)
+    return numpy.array_equal(results, self.referenceResults)
+
+  def Measure(self, config : dict, workDir : str):
+    name = "candidate" + str(len(self.measurements))
+    request = { "modelPath" : self.modelPath, "inputType" : self.inputType, "csvPath" : self.csvPath,
+                "returnType" : self.returnType, "config" : config, "workDir" : workDir, "name" : name,
+                "numRepeats" : self.numRepeats, "minRows" : self.minRows, "profile" : self.profile,
+                "resultsPath" : os.path.join(workDir, name + ".results.npy") }
+    measurement = None
+    if self.isolate:
+      requestPath = os.path.join(workDir, name + ".request.json")
+      measurementPath = os.path.join(workDir, name + ".measurement.json")
+      with open(requestPath, "w") as requestFile:
+        json.dump(request, requestFile)
+      try:
+        process = subprocess.run([sys.executable, os.path.abspath(__file__), "--measure", requestPath, measurementPath],
+                                 stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, timeout=self.timeout)
+        if process.returncode == 0:
+          with open(measurementPath) as measurementFile:
+            measurement = json.load(measurementFile)
+      except subprocess.TimeoutExpired:
+        pass
+    else:
+      measurement = MeasureConfiguration(request)
+
+    if measurement is None:
+      self.Log("Failed to compile or run", config)
+    elif not self.ResultsMatch(numpy.load(request["resultsPath"])):
+      self.Log("Predictions differ from the first configuration measured", config)
+      measurement = None
+    else:
+      self.Log(round(measurement["rowsPerSecond"]), "rows/s", config)
+    self.measurements.append({ "config" : config, "measurement" : measurement })
+    return measurement
+
+  # Measures the candidates the cost model doesn't prune and returns the fastest (and its measurement)
+  def RunStage(self, stageName : str, candidates, workDir : str):
+    candidates = [candidate for candidate in candidates if self.IsFeasible(candidate)]
+    costs = [self.EstimateCost(candidate) for candidate in candidates]
+    minCost = min(costs)
+    ranked = sorted(zip(costs, range(len(candidates))))
+    selected = [candidates[i] for cost, i in ranked if cost <= self.pruneFactor * minCost][:self.maxCandidatesPerStage]
+    self.Log(stageName, ":", len(selected), "of", len(candidates), "candidates left after pruning")
+    best, bestMeasurement = None, None
+    for candidate in selected:
+      measurement = self.Measure(candidate, workDir)
+      if measurement is not None and (bestMeasurement is None or measurement["rowsPerSecond"] > bestMeasurement["rowsPerSecond"]):
+        best, bestMeasurement = candidate, measurement
+    return best, bestMeasurement
+
+  # Returns the best configuration found (or stored in the database) and its throughput in rows per second
+  def Tune(self, force : bool = False):
+    key = TuningDatabase.Key(self.GetStatistics(), self.fixedConfig, self.maxCores)
+    entry = self.database.Lookup(key)
+    if entry is not None and not force:
+      self.Log("Using the configuration stored in the tuning database")
+      return entry["config"], entry["rowsPerSecond"]
+
+    numRows = ReadInputs(self.csvPath, self.GetStatistics()["numFeatures"], self.minRows).shape[0]
+    batchSizes = [batchSize for batchSize in self.batchSizes if batchSize <= numRows] or [min(self.batchSizes)]
+    initialBatchSize = batchSizes[len(batchSizes)//2]
+    with tempfile.TemporaryDirectory() as workDir:
+      # Layout of the model at a fixed batch size and the default schedule
+      layouts = []
+      for representation in self.representations:
+        for tilingType in self.tilingTypes:
+          for tileSize in self.tileSizes:
+            layouts.append(dict(DefaultConfiguration, **self.fixedConfig, representation=representation,
+                                tilingType=tilingType, tileSize=tileSize, batchSize=initialBatchSize))
+      best, bestMeasurement = self.RunStage("layout", layouts, workDir)
+      assert best is not None, "No configuration could be compiled"
+
+      # Batch size and pipelining of the trees (reordered by depth) for the best layout
+      schedules = []
+      for batchSize in batchSizes:
+        for pipelineSize in self.pipelineSizes:
+          pipelined = pipelineSize > 1
+          schedules.append(dict(best, batchSize=batchSize, pipelineSize=pipelineSize,
+                                reorderTreesByDepth=pipelined, makeAllLeavesSameDepth=pipelined))
+      stageBest, stageMeasurement = self.RunStage("schedule", schedules, workDir)
+      if stageMeasurement is not None and stageMeasurement["rowsPerSecond"] > bestMeasurement["rowsPerSecond"]:
+        best, bestMeasurement = stageBest, stageMeasurement
+
+      # Parallelize across cores (the generated code is parallel if trees are reordered, otherwise
+      # batches are run on runtime threads)
+      if self.maxCores > 1:
+        parallelMeasurement = self.Measure(dict(best, numberOfCores=self.maxCores), workDir)
+        if parallelMeasurement is not None and parallelMeasurement["rowsPerSecond"] > bestMeasurement["rowsPerSecond"]:
+          best, bestMeasurement = dict(best, numberOfCores=self.maxCores), parallelMeasurement
+
+    self.database.Store(key, { "statistics" : self.GetStatistics(), "config" : best, "rowsPerSecond" : bestMeasurement["rowsPerSecond"],
+                               "modelPath" : self.modelPath })
+    return best, bestMeasurement["rowsPerSecond"]
+
+def Tune(modelPath : str, inputType : str, csvPath : str, configJSONPath : str, returnType=numpy.float32,
+         baseConfig : dict = {}, databasePath : str = "", maxCores : int = 1) -> dict:
+  autotuner = Autotuner(modelPath, inputType, csvPath, returnType, baseConfig, databasePath, maxCores)
+  config, rowsPerSecond = autotuner.Tune()
+  WriteConfigJSON(config, configJSONPath)
+  return config
+
+if __name__ == "__main__":
+  if len(sys.argv) == 4 and sys.argv[1] == "--measure":
+    with open(sys.argv[2]) as requestFile:
+      measurement = MeasureConfiguration(json.load(requestFile))
+    with open(sys.argv[3], "w") as measurementFile:
+      json.dump(measurement, measurementFile)
+    sys.exit(0)
+
+  parser = argparse.ArgumentParser(description="Search for the fastest compiler configuration of a model")
+  parser.add_argument("--model", required=True, help="Model file")
+  parser.add_argument("--inputType", default="xgboost_json", help="Model file type (xgboost_json, lightgbm_text, sklearn_json, onnx_file)")
+  parser.add_argument("--csv", required=True, help="Representative inputs. Columns after the model's features are ignored")
+  parser.add_argument("--output", required=True, help="Path of the compiler config JSON to write")
+  parser.add_argument("--returnType", default="float32", choices=list(ReturnTypeConfigurations.keys()))
+  parser.add_argument("--baseConfig", default="", help="Compiler config JSON with options that aren't tuned")
+  parser.add_argument("--database", default="", help="Tuning database to read and update")
+  parser.add_argument("--maxCores", type=int, default=1)
+  parser.add_argument("--repeats", type=int, default=5)
+  parser.add_argument("--profile", action="store_true", help="Record hardware counters for each configuration")
+  parser.add_argument("--force", action="store_true", help="Tune even if the database has a configuration")
+  args = parser.parse_args()
+
+  baseConfig = {}
+  if args.baseConfig != "":
+    with open(args.baseConfig) as baseConfigFile:
+      baseConfig = json.load(baseConfigFile)
+  autotuner = Autotuner(args.model, args.inputType, args.csv, numpy.dtype(args.returnType).type, baseConfig, args.database, args.maxCores)
+  autotuner.numRepeats = args.repeats
+  autotuner.profile = args.profile
+  config, rowsPerSecond = autotuner.Tune(args.force)
+  WriteConfigJSON(config, args.output)
+  print("Best configuration (", round(rowsPerSecond), "rows/s ) written to", args.output)
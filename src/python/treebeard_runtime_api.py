@@ -14,6 +14,9 @@ class TreebeardAPI:
     try:
       self.runtime_lib = ctypes.CDLL(treebeard_runtime_path)
 
+      self.runtime_lib.GetLastErrorMessage.argtypes = None
+      self.runtime_lib.GetLastErrorMessage.restype = ctypes.c_char_p
+
       self.runtime_lib.CreateInferenceRunner.argtypes = (ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int64)
       self.runtime_lib.CreateInferenceRunner.restype = ctypes.c_int64
 
@@ -25,6 +28,45 @@ class TreebeardAPI:
 
       self.runtime_lib.RunInferenceOnMultipleBatches.argtypes = (ctypes.c_int64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int32)
       self.runtime_lib.RunInferenceOnMultipleBatches.restype = None
+
+      self.runtime_lib.RunInferenceOnPartialBatch.argtypes = (ctypes.c_int64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int32)
+      self.runtime_lib.RunInferenceOnPartialBatch.restype = None
+
+      self.runtime_lib.RunInferenceOnStridedInput.argtypes = (ctypes.c_int64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int32, ctypes.c_int64, ctypes.c_int64)
+      self.runtime_lib.RunInferenceOnStridedInput.restype = None
+
+      self.runtime_lib.IsDynamicBatch.argtypes = [ctypes.c_int64]
+      self.runtime_lib.IsDynamicBatch.restype = ctypes.c_int32
+
+      self.runtime_lib.GetInputLayout.argtypes = [ctypes.c_int64]
+      self.runtime_lib.GetInputLayout.restype = ctypes.c_int32
+
+      self.runtime_lib.IsEarlyExitEnabled.argtypes = [ctypes.c_int64]
+      self.runtime_lib.IsEarlyExitEnabled.restype = ctypes.c_int32
+
+      self.runtime_lib.GetNumberOfOutputs.argtypes = [ctypes.c_int64]
+      self.runtime_lib.GetNumberOfOutputs.restype = ctypes.c_int32
+
+      self.runtime_lib.GetModelResults.argtypes = [ctypes.c_int64, ctypes.c_void_p, ctypes.c_int32, ctypes.c_int32, ctypes.c_void_p]
+      self.runtime_lib.GetModelResults.restype = None
+
+      self.runtime_lib.GetNumberOfTrees.argtypes = [ctypes.c_int64]
+      self.runtime_lib.GetNumberOfTrees.restype = ctypes.c_int32
+
+      self.runtime_lib.GetAverageTreesWalkedPerRow.argtypes = [ctypes.c_int64]
+      self.runtime_lib.GetAverageTreesWalkedPerRow.restype = ctypes.c_double
+
+      self.runtime_lib.ResetEarlyExitStatistics.argtypes = [ctypes.c_int64]
+      self.runtime_lib.ResetEarlyExitStatistics.restype = None
+
+      self.runtime_lib.SetNumberOfRuntimeThreads.argtypes = (ctypes.c_int64, ctypes.c_int32, ctypes.c_int32)
+      self.runtime_lib.SetNumberOfRuntimeThreads.restype = None
+
+      self.runtime_lib.GetNumberOfRuntimeThreads.argtypes = [ctypes.c_int64]
+      self.runtime_lib.GetNumberOfRuntimeThreads.restype = ctypes.c_int32
+
+      self.runtime_lib.ProfileInference.argtypes = (ctypes.c_int64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int32, ctypes.c_int32, ctypes.c_void_p)
+      self.runtime_lib.ProfileInference.restype = ctypes.c_int32
       
       self.runtime_lib.GetBatchSize.argtypes = [ctypes.c_int64]
       self.runtime_lib.GetBatchSize.restype = ctypes.c_int32
@@ -35,9 +77,36 @@ class TreebeardAPI:
       self.runtime_lib.DeleteInferenceRunner.argtypes = [ctypes.c_int64]
       self.runtime_lib.DeleteInferenceRunner.restype = None
 
+      self.runtime_lib.CreateVersionedInferenceRunner.argtypes = [ctypes.c_int64]
+      self.runtime_lib.CreateVersionedInferenceRunner.restype = ctypes.c_int64
+
+      self.runtime_lib.VersionedInferenceRunner_RunInferenceOnMultipleBatches.argtypes = (ctypes.c_int64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int32)
+      self.runtime_lib.VersionedInferenceRunner_RunInferenceOnMultipleBatches.restype = None
+
+      self.runtime_lib.VersionedInferenceRunner_RunInferenceOnStridedInput.argtypes = (ctypes.c_int64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int32, ctypes.c_int64, ctypes.c_int64)
+      self.runtime_lib.VersionedInferenceRunner_RunInferenceOnStridedInput.restype = None
+
+      self.runtime_lib.VersionedInferenceRunner_GetNumberOfOutputs.argtypes = [ctypes.c_int64]
+      self.runtime_lib.VersionedInferenceRunner_GetNumberOfOutputs.restype = ctypes.c_int32
+
+      self.runtime_lib.VersionedInferenceRunner_GetInputLayout.argtypes = [ctypes.c_int64]
+      self.runtime_lib.VersionedInferenceRunner_GetInputLayout.restype = ctypes.c_int32
+
+      self.runtime_lib.SwapModel.argtypes = (ctypes.c_int64, ctypes.c_int64)
+      self.runtime_lib.SwapModel.restype = ctypes.c_int64
+
+      self.runtime_lib.GetModelVersion.argtypes = [ctypes.c_int64]
+      self.runtime_lib.GetModelVersion.restype = ctypes.c_int64
+
+      self.runtime_lib.DeleteVersionedInferenceRunner.argtypes = [ctypes.c_int64]
+      self.runtime_lib.DeleteVersionedInferenceRunner.restype = None
+
       self.runtime_lib.CreateCompilerOptions.argtypes = None
       self.runtime_lib.CreateCompilerOptions.restype = ctypes.c_int64
 
+      self.runtime_lib.CreateCompilerOptionsFromConfigJSON.argtypes = [ctypes.c_char_p]
+      self.runtime_lib.CreateCompilerOptionsFromConfigJSON.restype = ctypes.c_int64
+
       self.runtime_lib.DeleteCompilerOptions.argtypes = [ctypes.c_int64]
       self.runtime_lib.DeleteCompilerOptions.restype = None
 
@@ -80,6 +149,12 @@ class TreebeardAPI:
       self.runtime_lib.Set_tilingType.argtypes = [ctypes.c_int64, ctypes.c_int32]
       self.runtime_lib.Set_tilingType.restype = None
 
+      self.runtime_lib.Set_inputLayout.argtypes = [ctypes.c_int64, ctypes.c_int32]
+      self.runtime_lib.Set_inputLayout.restype = None
+
+      self.runtime_lib.Set_earlyExitThreshold.argtypes = [ctypes.c_int64, ctypes.c_double]
+      self.runtime_lib.Set_earlyExitThreshold.restype = None
+
       self.runtime_lib.Set_pipelineSize.argtypes = [ctypes.c_int64, ctypes.c_int32]
       self.runtime_lib.Set_pipelineSize.restype = None
 
@@ -89,6 +164,48 @@ class TreebeardAPI:
       self.runtime_lib.Set_numberOfCores.argtypes = [ctypes.c_int64, ctypes.c_int32]
       self.runtime_lib.Set_numberOfCores.restype = None
 
+      self.runtime_lib.Set_dynamicBatch.argtypes = [ctypes.c_int64, ctypes.c_int32]
+      self.runtime_lib.Set_dynamicBatch.restype = None
+
+      self.runtime_lib.Set_quantizeInputs.argtypes = [ctypes.c_int64, ctypes.c_int32]
+      self.runtime_lib.Set_quantizeInputs.restype = None
+
+      self.runtime_lib.Set_peeledCodeGenForProbabilityBasedTiling.argtypes = [ctypes.c_int64, ctypes.c_int32]
+      self.runtime_lib.Set_peeledCodeGenForProbabilityBasedTiling.restype = None
+
+      self.runtime_lib.Set_sparseRepresentation.argtypes = [ctypes.c_int64, ctypes.c_int32]
+      self.runtime_lib.Set_sparseRepresentation.restype = None
+
+      self.runtime_lib.Set_returnAllOutputs.argtypes = [ctypes.c_int64, ctypes.c_int32]
+      self.runtime_lib.Set_returnAllOutputs.restype = None
+
+      self.runtime_lib.Set_profileLeafHits.argtypes = [ctypes.c_int64, ctypes.c_int32]
+      self.runtime_lib.Set_profileLeafHits.restype = None
+
+      self.runtime_lib.Set_featureGroupBatchTileSize.argtypes = [ctypes.c_int64, ctypes.c_int32]
+      self.runtime_lib.Set_featureGroupBatchTileSize.restype = None
+
+      self.runtime_lib.Set_optimizationLevel.argtypes = [ctypes.c_int64, ctypes.c_int32]
+      self.runtime_lib.Set_optimizationLevel.restype = None
+
+      self.runtime_lib.Set_targetCPU.argtypes = [ctypes.c_int64, ctypes.c_char_p]
+      self.runtime_lib.Set_targetCPU.restype = None
+
+      self.runtime_lib.Set_targetFeatures.argtypes = [ctypes.c_int64, ctypes.c_char_p]
+      self.runtime_lib.Set_targetFeatures.restype = None
+
+      self.runtime_lib.Set_compilationCacheDirectory.argtypes = [ctypes.c_int64, ctypes.c_char_p]
+      self.runtime_lib.Set_compilationCacheDirectory.restype = None
+
+      self.runtime_lib.GetCompilationCacheHits.argtypes = None
+      self.runtime_lib.GetCompilationCacheHits.restype = ctypes.c_int64
+
+      self.runtime_lib.GetCompilationCacheMisses.argtypes = None
+      self.runtime_lib.GetCompilationCacheMisses.restype = ctypes.c_int64
+
+      self.runtime_lib.ResetCompilationCacheStatistics.argtypes = None
+      self.runtime_lib.ResetCompilationCacheStatistics.restype = None
+
       self.runtime_lib.Set_statsProfileCSVPath.argtypes = [ctypes.c_int64, ctypes.c_char_p]
       self.runtime_lib.Set_statsProfileCSVPath.restype = None
 
@@ -98,6 +215,39 @@ class TreebeardAPI:
       self.runtime_lib.GenerateLLVMIRForXGBoostModel.argtypes = (ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int64)
       self.runtime_lib.GenerateLLVMIRForXGBoostModel.restype = None
 
+      self.runtime_lib.ComputeProbabilityProfile.argtypes = (ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int32, ctypes.c_int32)
+      self.runtime_lib.ComputeProbabilityProfile.restype = None
+
+      self.runtime_lib.CreateOnlineRetilingRunner.argtypes = (ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int64, ctypes.c_double, ctypes.c_double, ctypes.c_int64)
+      self.runtime_lib.CreateOnlineRetilingRunner.restype = ctypes.c_int64
+
+      self.runtime_lib.OnlineRetilingRunner_RunInferenceOnMultipleBatches.argtypes = (ctypes.c_int64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int32)
+      self.runtime_lib.OnlineRetilingRunner_RunInferenceOnMultipleBatches.restype = None
+
+      self.runtime_lib.OnlineRetilingRunner_GetNumberOfOutputs.argtypes = [ctypes.c_int64]
+      self.runtime_lib.OnlineRetilingRunner_GetNumberOfOutputs.restype = ctypes.c_int32
+
+      self.runtime_lib.OnlineRetilingRunner_GetInputLayout.argtypes = [ctypes.c_int64]
+      self.runtime_lib.OnlineRetilingRunner_GetInputLayout.restype = ctypes.c_int32
+
+      self.runtime_lib.OnlineRetilingRunner_GetDrift.argtypes = [ctypes.c_int64]
+      self.runtime_lib.OnlineRetilingRunner_GetDrift.restype = ctypes.c_double
+
+      self.runtime_lib.OnlineRetilingRunner_GetRecompileCount.argtypes = [ctypes.c_int64]
+      self.runtime_lib.OnlineRetilingRunner_GetRecompileCount.restype = ctypes.c_int64
+
+      self.runtime_lib.OnlineRetilingRunner_GetSampledRowCount.argtypes = [ctypes.c_int64]
+      self.runtime_lib.OnlineRetilingRunner_GetSampledRowCount.restype = ctypes.c_int64
+
+      self.runtime_lib.OnlineRetilingRunner_GetRetilingError.argtypes = [ctypes.c_int64]
+      self.runtime_lib.OnlineRetilingRunner_GetRetilingError.restype = ctypes.c_char_p
+
+      self.runtime_lib.OnlineRetilingRunner_WaitForRecompilation.argtypes = [ctypes.c_int64]
+      self.runtime_lib.OnlineRetilingRunner_WaitForRecompilation.restype = None
+
+      self.runtime_lib.DeleteOnlineRetilingRunner.argtypes = [ctypes.c_int64]
+      self.runtime_lib.DeleteOnlineRetilingRunner.restype = None
+
       self.runtime_lib.SetEnableSparseRepresentation.argtypes = [ctypes.c_int32]
       self.runtime_lib.SetEnableSparseRepresentation.restype = None
 
@@ -110,6 +260,9 @@ class TreebeardAPI:
       self.runtime_lib.IsPeeledCodeGenForProbabilityBasedTilingEnabled.argtypes = None
       self.runtime_lib.IsPeeledCodeGenForProbabilityBasedTilingEnabled.restype = ctypes.c_int32
 
+      self.runtime_lib.SetEnableCompileTimeLogging.argtypes = [ctypes.c_int32]
+      self.runtime_lib.SetEnableCompileTimeLogging.restype = None
+
       self.runtime_lib.Schedule_NewIndexVariable.argtypes = [ctypes.c_int64, ctypes.c_char_p]
       self.runtime_lib.Schedule_NewIndexVariable.restype = ctypes.c_int64
 
@@ -181,6 +334,9 @@ class TreebeardAPI:
 
       self.runtime_lib.BuildHIRRepresentation.argtypes = [ctypes.c_int64]
 
+      self.runtime_lib.GetForestStatistics.argtypes = [ctypes.c_int64, ctypes.c_void_p]
+      self.runtime_lib.GetForestStatistics.restype = None
+
       self.runtime_lib.LowerToLLVMAndDumpIR.restype = ctypes.c_bool
       self.runtime_lib.LowerToLLVMAndDumpIR.argtypes = [ctypes.c_int64, ctypes.c_char_p]
 
@@ -190,10 +346,23 @@ class TreebeardAPI:
     except Exception as e:
       print("Loading the TreeBeard runtime failed with exception :", e)
   
+  # Raises the error recorded by the last runtime call (on this thread), if it failed
+  def CheckForError(self) -> None:
+    errorMessage = self.runtime_lib.GetLastErrorMessage().decode('utf-8')
+    if errorMessage:
+      raise RuntimeError(errorMessage)
+
+  # Returns the handle returned by a runtime call that constructs an object, raising if the call failed
+  def CheckHandle(self, handle) -> int:
+    if not handle:
+      self.CheckForError()
+      raise RuntimeError("TreeBeard runtime call failed")
+    return int(handle)
+
   def InitializeInferenceRunner(self, modelSOPath : str, modelGlobalsJSONPath : str) -> int:
     soPath = modelSOPath.encode('ascii')
     globalsJSONPath = modelGlobalsJSONPath.encode('ascii')
-    return int(self.runtime_lib.InitializeInferenceRunner(ctypes.c_char_p(soPath), ctypes.c_char_p(globalsJSONPath)))
+    return self.CheckHandle(self.runtime_lib.InitializeInferenceRunner(ctypes.c_char_p(soPath), ctypes.c_char_p(globalsJSONPath)))
   
   def GetRowSize(self, inferenceRunner : int) -> int:
     return int(self.runtime_lib.GetRowSize(inferenceRunner))
@@ -207,6 +376,49 @@ class TreebeardAPI:
   def RunInferenceOnMultipleBatches(self, inferenceRunner : int, inputs : ctypes.c_void_p, results : ctypes.c_void_p, numRows : int) -> None:
     self.runtime_lib.RunInferenceOnMultipleBatches(inferenceRunner, inputs, results, numRows)
 
+  def RunInferenceOnPartialBatch(self, inferenceRunner : int, inputs : ctypes.c_void_p, results : ctypes.c_void_p, numRows : int) -> None:
+    self.runtime_lib.RunInferenceOnPartialBatch(inferenceRunner, inputs, results, numRows)
+    self.CheckForError()
+
+  def RunInferenceOnStridedInput(self, inferenceRunner : int, inputs : ctypes.c_void_p, results : ctypes.c_void_p, numRows : int,
+                                 rowStride : int, columnStride : int) -> None:
+    self.runtime_lib.RunInferenceOnStridedInput(inferenceRunner, inputs, results, numRows, rowStride, columnStride)
+    self.CheckForError()
+
+  def GetInputLayout(self, inferenceRunner : int) -> int:
+    return self.runtime_lib.GetInputLayout(inferenceRunner)
+
+  def IsEarlyExitEnabled(self, inferenceRunner : int) -> bool:
+    return self.runtime_lib.IsEarlyExitEnabled(inferenceRunner) != 0
+
+  def GetNumberOfOutputs(self, inferenceRunner : int) -> int:
+    return self.runtime_lib.GetNumberOfOutputs(inferenceRunner)
+
+  def GetModelResults(self, inferenceRunner : int, results : ctypes.c_void_p, numRows : int, modelIndex : int, modelResults : ctypes.c_void_p) -> None:
+    self.runtime_lib.GetModelResults(inferenceRunner, results, numRows, modelIndex, modelResults)
+
+  def GetNumberOfTrees(self, inferenceRunner : int) -> int:
+    return self.runtime_lib.GetNumberOfTrees(inferenceRunner)
+
+  def ProfileInference(self, inferenceRunner : int, inputs : ctypes.c_void_p, results : ctypes.c_void_p, numRows : int, 
+                       numRepeats : int, profile : ctypes.c_void_p) -> int:
+    return self.runtime_lib.ProfileInference(inferenceRunner, inputs, results, numRows, numRepeats, profile)
+
+  def GetAverageTreesWalkedPerRow(self, inferenceRunner : int) -> float:
+    return self.runtime_lib.GetAverageTreesWalkedPerRow(inferenceRunner)
+
+  def ResetEarlyExitStatistics(self, inferenceRunner : int) -> None:
+    self.runtime_lib.ResetEarlyExitStatistics(inferenceRunner)
+
+  def IsDynamicBatch(self, inferenceRunner : int) -> bool:
+    return self.runtime_lib.IsDynamicBatch(inferenceRunner) != 0
+
+  def SetNumberOfRuntimeThreads(self, inferenceRunner : int, numThreads : int, pinToCores : bool = False) -> None:
+    self.runtime_lib.SetNumberOfRuntimeThreads(inferenceRunner, numThreads, 1 if pinToCores else 0)
+
+  def GetNumberOfRuntimeThreads(self, inferenceRunner : int) -> int:
+    return self.runtime_lib.GetNumberOfRuntimeThreads(inferenceRunner)
+
   def DeleteInferenceRunner(self, inferenceRunner : int) -> None:
     self.runtime_lib.DeleteInferenceRunner(inferenceRunner)
 
@@ -281,10 +493,12 @@ class TreebeardAPI:
     file_type_ascii = file_type.encode('ascii')
     # print("TBContext_SetTypeAPI: ", treebeard_context_ptr, type(treebeard_context_ptr))
     self.runtime_lib.SetForestCreatorType(ctypes.c_int64(treebeard_context_ptr), file_type_ascii)
+    self.CheckForError()
 
   def LowerToLLVMAndDumpIR(self, treebeard_context_ptr, output_path):
     output_path_utf8 = output_path.encode('utf-8')
     self.runtime_lib.LowerToLLVMAndDumpIR(treebeard_context_ptr, output_path_utf8)
+    self.CheckForError()
 
   def SetRepresentationAndSerializer(self, treebeard_context_ptr, rep_type):
     rep_type_ascii = rep_type.encode('ascii')
@@ -1,15 +1,23 @@
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <json.hpp>
 #include <string>
+#include <algorithm>
+#include <stdexcept>
+#include "BinaryModelGlobals.h"
 #include "DecisionForest.h"
 #include "Dialect.h"
 #include "mlir/Dialect/Arith/IR/Arith.h"
 #include "tbruntime.h"
 #include "ExecutionHelpers.h"
 #include "CompileUtils.h"
+#include "CompilationCache.h"
+#include "StatsUtils.h"
+#include "OnlineRetilingRunner.h"
+#include "VersionedInferenceRunner.h"
 #include "mlir/IR/BuiltinOps.h"
 #include "xgboostparser.h"
 #include "schedule.h"
@@ -17,27 +25,84 @@
 #include "Representations.h"
 #include "onnxmodelparser.h"
 
+// ===-------------------------------------------------------------=== //
+// Error reporting
+// ===-------------------------------------------------------------=== //
+
+namespace
+{
+thread_local std::string lastErrorMessage;
+}
+
+// Runs the body of a C API call. Exceptions (for example, an invalid model or an unreadable file) can't cross the C 
+// boundary, so they are turned into a default result (0 for handles) and a message that GetLastErrorMessage returns.
+template<typename ResultType, typename CallType>
+ResultType CallAndRecordError(CallType call) {
+  lastErrorMessage.clear();
+  try {
+    return call();
+  }
+  catch (const std::exception& e) {
+    lastErrorMessage = e.what();
+    return ResultType();
+  }
+}
+
+// Message of the last error raised by a C API call on this thread. Empty if the last such call succeeded.
+extern "C" const char* GetLastErrorMessage() {
+  return lastErrorMessage.c_str();
+}
+
 // ===-------------------------------------------------------------=== //
 // Execution API
 // ===-------------------------------------------------------------=== //
 
+// numberOfCores is only used to parallelize the generated code when trees are reordered 
+// by depth. Otherwise, use that many runtime threads to run the batches concurrently.
+void SetRuntimeThreadsFromOptions(mlir::decisionforest::InferenceRunnerBase *inferenceRunner, 
+                                  const TreeBeard::CompilerOptions& options) {
+  if (options.numberOfCores > 1 && !options.reorderTreesByDepth)
+    inferenceRunner->SetNumberOfThreads(options.numberOfCores);
+}
+
 // Create a shared object inference runner and return an ID (Init)
 //    -- SO name, globals JSON path 
 extern "C" intptr_t InitializeInferenceRunner(const char* soPath, const char* modelGlobalsJSONPath) {
-  using json = nlohmann::json;
-  json globalsJSON;
-  std::ifstream fin(modelGlobalsJSONPath);
-  fin >> globalsJSON;
-
-  auto tileSizeEntries = globalsJSON["TileSizeEntries"];
-  assert (tileSizeEntries.size() == 1);
-  int32_t tileSize = tileSizeEntries.front()["TileSize"];
-  int32_t thresholdBitwidth = tileSizeEntries.front()["ThresholdBitWidth"];
-  int32_t featureIndexBitwidth = tileSizeEntries.front()["FeatureIndexBitWidth"];
-  auto serializer = mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath);
-  auto inferenceRunner = new mlir::decisionforest::SharedObjectInferenceRunner(serializer, soPath, tileSize, 
-                                                                               thresholdBitwidth, featureIndexBitwidth);
-  return reinterpret_cast<intptr_t>(inferenceRunner);
+  return CallAndRecordError<intptr_t>([&]() -> intptr_t {
+    int32_t tileSize, thresholdBitwidth, featureIndexBitwidth;
+    // The representation the model was compiled for is recorded in its globals
+    bool sparseRepresentation;
+    if (mlir::decisionforest::MappedBinaryModelGlobals::IsBinaryModelGlobalsFile(modelGlobalsJSONPath)) {
+      mlir::decisionforest::MappedBinaryModelGlobals mappedGlobals(modelGlobalsJSONPath);
+      if (mappedGlobals.GetHeader().numberOfEntries != 1)
+        throw std::runtime_error("Model globals file must have exactly one tile size entry");
+      auto& entry = mappedGlobals.GetEntry(0);
+      tileSize = entry.tileSize;
+      thresholdBitwidth = entry.thresholdBitWidth;
+      featureIndexBitwidth = entry.indexBitWidth;
+      sparseRepresentation = mappedGlobals.GetHeader().sparseRepresentation != 0;
+    }
+    else {
+      using json = nlohmann::json;
+      json globalsJSON;
+      std::ifstream fin(modelGlobalsJSONPath);
+      if (!fin)
+        throw std::runtime_error("Failed to open model globals file " + std::string(modelGlobalsJSONPath));
+      fin >> globalsJSON;
+
+      auto tileSizeEntries = globalsJSON["TileSizeEntries"];
+      if (tileSizeEntries.size() != 1)
+        throw std::runtime_error("Model globals file must have exactly one tile size entry");
+      tileSize = tileSizeEntries.front()["TileSize"];
+      thresholdBitwidth = tileSizeEntries.front()["ThresholdBitWidth"];
+      featureIndexBitwidth = tileSizeEntries.front()["FeatureIndexBitWidth"];
+      sparseRepresentation = globalsJSON.value("SparseRepresentation", false);
+    }
+    auto serializer = mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath, sparseRepresentation);
+    auto inferenceRunner = new mlir::decisionforest::SharedObjectInferenceRunner(serializer, soPath, tileSize, 
+                                                                                 thresholdBitwidth, featureIndexBitwidth);
+    return reinterpret_cast<intptr_t>(inferenceRunner);
+  });
 }
 
 // Run inference
@@ -50,18 +115,111 @@ extern "C" void RunInference(intptr_t inferenceRunnerInt, void *inputs, void *re
 
 extern "C" void RunInferenceOnMultipleBatches(intptr_t inferenceRunnerInt, void *inputs, void *results, int32_t numRows) {
   auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
-  auto batchSize = inferenceRunner->GetBatchSize();
-  auto rowSize = inferenceRunner->GetRowSize();
-
-  assert (numRows % batchSize == 0);
-  int32_t inputElementSize = inferenceRunner->GetInputElementBitWidth()/8;
-  int32_t returnTypeSize = inferenceRunner->GetReturnTypeBitWidth()/8;
-  for (int32_t batch=0 ; batch<numRows/batchSize ; ++batch) {
-    auto batchPtr = reinterpret_cast<char*>(inputs) + (batch * (rowSize*batchSize) * inputElementSize);
-    auto resultsPtr = reinterpret_cast<char*>(results) + (batch * batchSize * returnTypeSize);
-    // TODO The types in this template don't really matter. Maybe we should get rid of them? 
-    inferenceRunner->RunInference<double, double>(reinterpret_cast<double*>(batchPtr), reinterpret_cast<double*>(resultsPtr));
-  }
+  inferenceRunner->RunInferenceOnMultipleBatches(inputs, results, numRows);
+}
+
+// Element (i, j) of the input is read from inputs[i*rowStride + j*columnStride]
+extern "C" void RunInferenceOnStridedInput(intptr_t inferenceRunnerInt, void *inputs, void *results, int32_t numRows, 
+                                           int64_t rowStride, int64_t columnStride) {
+  CallAndRecordError<void>([&]() -> void {
+    auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+    inferenceRunner->RunInferenceOnStridedInput(inputs, results, numRows, rowStride, columnStride);
+  });
+}
+
+extern "C" void SetNumberOfRuntimeThreads(intptr_t inferenceRunnerInt, int32_t numThreads, int32_t pinToCores) {
+  auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+  inferenceRunner->SetNumberOfThreads(numThreads, pinToCores != 0);
+}
+
+extern "C" int32_t GetNumberOfRuntimeThreads(intptr_t inferenceRunnerInt) {
+  auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+  return inferenceRunner->GetNumberOfThreads();
+}
+
+// Fills profile with the number of rows measured, cycles per row, instructions per cycle, L1 data cache 
+// misses per row, last level cache misses per row and branch misses per tree per row (in that order). 
+// Returns 0 if the performance counters aren't available.
+extern "C" int32_t ProfileInference(intptr_t inferenceRunnerInt, void *inputs, void *results, int32_t numRows,
+                                    int32_t numRepeats, double *profile) {
+  auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+  mlir::decisionforest::InferenceProfile inferenceProfile;
+  if (!inferenceRunner->ProfileInference(inputs, results, numRows, numRepeats, inferenceProfile))
+    return 0;
+  profile[0] = static_cast<double>(inferenceProfile.numRows);
+  profile[1] = inferenceProfile.cyclesPerRow;
+  profile[2] = inferenceProfile.instructionsPerCycle;
+  profile[3] = inferenceProfile.l1DataMissesPerRow;
+  profile[4] = inferenceProfile.llcMissesPerRow;
+  profile[5] = inferenceProfile.branchMissesPerTreePerRow;
+  return 1;
+}
+
+// Records an error (and doesn't run) if numRows isn't between 1 and the batch size
+extern "C" void RunInferenceOnPartialBatch(intptr_t inferenceRunnerInt, void *inputs, void *results, int32_t numRows) {
+  CallAndRecordError<void>([&]() -> void {
+    auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+    inferenceRunner->RunInferenceOnPartialBatch(inputs, results, numRows);
+  });
+}
+
+extern "C" int32_t IsDynamicBatch(intptr_t inferenceRunnerInt) {
+  auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+  return inferenceRunner->IsDynamicBatch() ? 1 : 0;
+}
+
+extern "C" int32_t GetInputLayout(intptr_t inferenceRunnerInt) {
+  auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+  return static_cast<int32_t>(inferenceRunner->GetInputLayout());
+}
+
+extern "C" int32_t IsEarlyExitEnabled(intptr_t inferenceRunnerInt) {
+  auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+  return inferenceRunner->IsEarlyExitEnabled() ? 1 : 0;
+}
+
+extern "C" int32_t GetNumberOfOutputs(intptr_t inferenceRunnerInt) {
+  auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+  return inferenceRunner->GetNumberOfOutputs();
+}
+
+// Copies the results of one of the models of a multi-model manifest (the column modelIndex of results) to modelResults
+extern "C" void GetModelResults(intptr_t inferenceRunnerInt, void *results, int32_t numRows, int32_t modelIndex, void *modelResults) {
+  auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+  auto numOutputs = inferenceRunner->GetNumberOfOutputs();
+  assert (modelIndex >= 0 && modelIndex < numOutputs);
+  auto elementSize = inferenceRunner->GetReturnTypeBitWidth()/8;
+  auto resultBytes = reinterpret_cast<int8_t*>(results);
+  auto modelResultBytes = reinterpret_cast<int8_t*>(modelResults);
+  for (int64_t i=0 ; i<numRows ; ++i)
+    std::memcpy(modelResultBytes + i*elementSize, resultBytes + (i*numOutputs + modelIndex)*elementSize, elementSize);
+}
+
+extern "C" int32_t GetNumberOfTrees(intptr_t inferenceRunnerInt) {
+  auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+  return inferenceRunner->GetNumberOfTrees();
+}
+
+extern "C" double GetAverageTreesWalkedPerRow(intptr_t inferenceRunnerInt) {
+  auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+  return inferenceRunner->GetAverageTreesWalkedPerRow();
+}
+
+extern "C" void ResetEarlyExitStatistics(intptr_t inferenceRunnerInt) {
+  auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+  inferenceRunner->ResetEarlyExitStatistics();
+}
+
+extern "C" int64_t GetCompilationCacheHits() {
+  return TreeBeard::CompilationCache::GetStatistics().hits;
+}
+
+extern "C" int64_t GetCompilationCacheMisses() {
+  return TreeBeard::CompilationCache::GetStatistics().misses;
+}
+
+extern "C" void ResetCompilationCacheStatistics() {
+  TreeBeard::CompilationCache::ResetStatistics();
 }
 
 extern "C" int32_t GetBatchSize(intptr_t inferenceRunnerInt) {
@@ -81,6 +239,61 @@ extern "C" void DeleteInferenceRunner(intptr_t inferenceRunnerInt) {
   delete inferenceRunner;
 }
 
+// ===-------------------------------------------------------------=== //
+// Versioned runner API
+// ===-------------------------------------------------------------=== //
+
+// Takes ownership of the inference runner
+extern "C" intptr_t CreateVersionedInferenceRunner(intptr_t inferenceRunnerInt) {
+  auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+  return reinterpret_cast<intptr_t>(new TreeBeard::VersionedInferenceRunner(inferenceRunner));
+}
+
+extern "C" void VersionedInferenceRunner_RunInferenceOnMultipleBatches(intptr_t versionedRunnerInt, void *inputs, void *results, int32_t numRows) {
+  auto versionedRunner = reinterpret_cast<TreeBeard::VersionedInferenceRunner*>(versionedRunnerInt);
+  versionedRunner->RunInferenceOnMultipleBatches(inputs, results, numRows);
+}
+
+extern "C" void VersionedInferenceRunner_RunInferenceOnStridedInput(intptr_t versionedRunnerInt, void *inputs, void *results, int32_t numRows, 
+                                                                    int64_t rowStride, int64_t columnStride) {
+  CallAndRecordError<void>([&]() -> void {
+    auto versionedRunner = reinterpret_cast<TreeBeard::VersionedInferenceRunner*>(versionedRunnerInt);
+    versionedRunner->RunInferenceOnStridedInput(inputs, results, numRows, rowStride, columnStride);
+  });
+}
+
+extern "C" int32_t VersionedInferenceRunner_GetNumberOfOutputs(intptr_t versionedRunnerInt) {
+  auto versionedRunner = reinterpret_cast<TreeBeard::VersionedInferenceRunner*>(versionedRunnerInt);
+  TreeBeard::VersionedInferenceRunner::ReadGuard inferenceRunner(*versionedRunner);
+  return inferenceRunner->GetNumberOfOutputs();
+}
+
+extern "C" int32_t VersionedInferenceRunner_GetInputLayout(intptr_t versionedRunnerInt) {
+  auto versionedRunner = reinterpret_cast<TreeBeard::VersionedInferenceRunner*>(versionedRunnerInt);
+  TreeBeard::VersionedInferenceRunner::ReadGuard inferenceRunner(*versionedRunner);
+  return static_cast<int32_t>(inferenceRunner->GetInputLayout());
+}
+
+// Takes ownership of the new inference runner. The old one is deleted once the calls running on it return.
+// Returns 0 (and records an error) if the new runner reads its inputs or writes its results differently.
+extern "C" int64_t SwapModel(intptr_t versionedRunnerInt, intptr_t inferenceRunnerInt) {
+  return CallAndRecordError<int64_t>([&]() -> int64_t {
+    auto versionedRunner = reinterpret_cast<TreeBeard::VersionedInferenceRunner*>(versionedRunnerInt);
+    auto inferenceRunner = reinterpret_cast<mlir::decisionforest::InferenceRunnerBase*>(inferenceRunnerInt);
+    return versionedRunner->SwapModel(inferenceRunner);
+  });
+}
+
+extern "C" int64_t GetModelVersion(intptr_t versionedRunnerInt) {
+  auto versionedRunner = reinterpret_cast<TreeBeard::VersionedInferenceRunner*>(versionedRunnerInt);
+  return versionedRunner->GetVersion();
+}
+
+extern "C" void DeleteVersionedInferenceRunner(intptr_t versionedRunnerInt) {
+  auto versionedRunner = reinterpret_cast<TreeBeard::VersionedInferenceRunner*>(versionedRunnerInt);
+  delete versionedRunner;
+}
+
 // ===-------------------------------------------------------------=== //
 // CompilerOptions API
 // ===-------------------------------------------------------------=== //
@@ -89,6 +302,13 @@ extern "C" intptr_t CreateCompilerOptions() {
   return reinterpret_cast<intptr_t>(new TreeBeard::CompilerOptions);
 }
 
+// Options read from a compiler config JSON (see TreeBeard::CompilerOptions(const std::string&))
+extern "C" intptr_t CreateCompilerOptionsFromConfigJSON(const char *configJSONPath) {
+  return CallAndRecordError<intptr_t>([&]() -> intptr_t {
+    return reinterpret_cast<intptr_t>(new TreeBeard::CompilerOptions(configJSONPath));
+  });
+}
+
 extern "C" void DeleteCompilerOptions(intptr_t options) {
   TreeBeard::CompilerOptions *optionsPtr = reinterpret_cast<TreeBeard::CompilerOptions*>(options);
   delete optionsPtr->scheduleManipulator;
@@ -119,6 +339,17 @@ COMPILER_OPTION_SETTER(reorderTreesByDepth, int32_t)
 COMPILER_OPTION_SETTER(statsProfileCSVPath,  const char*)
 COMPILER_OPTION_SETTER(pipelineSize, int32_t)
 COMPILER_OPTION_SETTER(numberOfCores, int32_t)
+COMPILER_OPTION_SETTER(dynamicBatch, int32_t)
+COMPILER_OPTION_SETTER(quantizeInputs, int32_t)
+COMPILER_OPTION_SETTER(peeledCodeGenForProbabilityBasedTiling, int32_t)
+COMPILER_OPTION_SETTER(sparseRepresentation, int32_t)
+COMPILER_OPTION_SETTER(returnAllOutputs, int32_t)
+COMPILER_OPTION_SETTER(profileLeafHits, int32_t)
+COMPILER_OPTION_SETTER(featureGroupBatchTileSize, int32_t)
+COMPILER_OPTION_SETTER(optimizationLevel, int32_t)
+COMPILER_OPTION_SETTER(targetCPU, const char*)
+COMPILER_OPTION_SETTER(targetFeatures, const char*)
+COMPILER_OPTION_SETTER(compilationCacheDirectory, const char*)
 
 extern "C" void Set_tilingType(intptr_t options, int32_t val) {
   TreeBeard::CompilerOptions *optionsPtr = reinterpret_cast<TreeBeard::CompilerOptions*>(options);
@@ -134,37 +365,115 @@ extern "C" void Set_tilingType(intptr_t options, int32_t val) {
   optionsPtr->tilingType = tilingType;
 }
 
+extern "C" void Set_inputLayout(intptr_t options, int32_t val) {
+  CallAndRecordError<void>([&]() -> void {
+    TreeBeard::CompilerOptions *optionsPtr = reinterpret_cast<TreeBeard::CompilerOptions*>(options);
+    if (val < static_cast<int32_t>(mlir::decisionforest::InputLayout::kRowMajor) || 
+        val > static_cast<int32_t>(mlir::decisionforest::InputLayout::kColumnMajor))
+      throw std::runtime_error("Invalid input layout value " + std::to_string(val));
+    optionsPtr->inputLayout = static_cast<mlir::decisionforest::InputLayout>(val);
+  });
+}
+
+// A probability in (0, 1). Negative values disable early exit.
+extern "C" void Set_earlyExitThreshold(intptr_t options, double val) {
+  return CallAndRecordError<void>([&]() -> void {
+    TreeBeard::CompilerOptions *optionsPtr = reinterpret_cast<TreeBeard::CompilerOptions*>(options);
+    if (!(val < 0.0 || (val > 0.0 && val < 1.0)))
+      throw std::runtime_error("Invalid early exit threshold " + std::to_string(val));
+    optionsPtr->earlyExitThreshold = val;
+  });
+}
+
 // ===-------------------------------------------------------------=== //
 // Compilation API
 // ===-------------------------------------------------------------=== //
 
 extern "C" void GenerateLLVMIRForXGBoostModel(const char* modelJSONPath, const char* llvmIRFilePath,
                                               const char* modelGlobalsJSONPath, intptr_t options) {
-  TreeBeard::CompilerOptions *optionsPtr = reinterpret_cast<TreeBeard::CompilerOptions*>(options);
-  TreeBeard::TreebeardContext tbContext(modelJSONPath,
-                                        modelGlobalsJSONPath,
-                                        *optionsPtr, 
-                                        mlir::decisionforest::ConstructRepresentation(),
-                                        mlir::decisionforest::ConstructModelSerializer(std::string(modelGlobalsJSONPath)),
-                                        nullptr  /*TODO_ForestCreator*/);
-  TreeBeard::ConvertXGBoostJSONToLLVMIR(tbContext, llvmIRFilePath);
+  return CallAndRecordError<void>([&]() -> void {
+    TreeBeard::CompilerOptions *optionsPtr = reinterpret_cast<TreeBeard::CompilerOptions*>(options);
+    TreeBeard::TreebeardContext tbContext(modelJSONPath,
+                                          modelGlobalsJSONPath,
+                                          *optionsPtr, 
+                                          mlir::decisionforest::ConstructRepresentation(optionsPtr->sparseRepresentation),
+                                          mlir::decisionforest::ConstructModelSerializer(std::string(modelGlobalsJSONPath), optionsPtr->sparseRepresentation),
+                                          nullptr  /*TODO_ForestCreator*/);
+    TreeBeard::ConvertXGBoostJSONToLLVMIR(tbContext, llvmIRFilePath);
+  });
+}
+
+extern "C" void ComputeProbabilityProfile(const char* modelJSONPath, const char* csvPath, const char* profileCSVPath,
+                                          int32_t numRows, int32_t batchSize) {
+  TreeBeard::Profile::ComputeForestProbabilityProfileCompiled(modelJSONPath, csvPath, profileCSVPath, numRows, batchSize);
 }
 
 extern "C" intptr_t CreateInferenceRunner(const char* modelJSONPath, const char* profileCSVPath,
                                           intptr_t options) {
-  TreeBeard::CompilerOptions *optionsPtr = reinterpret_cast<TreeBeard::CompilerOptions*>(options);
-  auto modelGlobalsJSONPath = TreeBeard::XGBoostJSONParser<>::ModelGlobalJSONFilePathFromJSONFilePath(modelJSONPath);
-  TreeBeard::TreebeardContext tbContext(modelJSONPath,
-                                        modelGlobalsJSONPath,
-                                        *optionsPtr, 
-                                        mlir::decisionforest::ConstructRepresentation(),
-                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath),
-                                        nullptr  /*TODO_ForestCreator*/);
-  auto module = TreeBeard::ConstructLLVMDialectModuleFromXGBoostJSON(tbContext);
-  auto inferenceRunner = new mlir::decisionforest::InferenceRunner(tbContext.serializer, module, 
-                                                                   optionsPtr->tileSize, optionsPtr->thresholdTypeWidth,
-                                                                   optionsPtr->featureIndexTypeWidth);
-  return reinterpret_cast<intptr_t>(inferenceRunner);
+  return CallAndRecordError<intptr_t>([&]() -> intptr_t {
+    TreeBeard::CompilerOptions *optionsPtr = reinterpret_cast<TreeBeard::CompilerOptions*>(options);
+    auto inferenceRunner = TreeBeard::ConstructInferenceRunnerForXGBoostJSON(modelJSONPath, *optionsPtr);
+    SetRuntimeThreadsFromOptions(inferenceRunner, *optionsPtr);
+    return reinterpret_cast<intptr_t>(inferenceRunner);
+  });
+}
+
+extern "C" intptr_t CreateOnlineRetilingRunner(const char* modelJSONPath, const char* profileCSVPath, intptr_t options,
+                                               double samplingFraction, double driftThreshold, int64_t minSampledRows) {
+  return CallAndRecordError<intptr_t>([&]() -> intptr_t {
+    TreeBeard::CompilerOptions *optionsPtr = reinterpret_cast<TreeBeard::CompilerOptions*>(options);
+    TreeBeard::OnlineRetilingOptions retilingOptions{samplingFraction, driftThreshold, minSampledRows};
+    auto onlineRunner = new TreeBeard::OnlineRetilingRunner(modelJSONPath, profileCSVPath, *optionsPtr, retilingOptions);
+    return reinterpret_cast<intptr_t>(onlineRunner);
+  });
+}
+
+extern "C" void OnlineRetilingRunner_RunInferenceOnMultipleBatches(intptr_t onlineRunnerInt, void *inputs, void *results, int32_t numRows) {
+  auto onlineRunner = reinterpret_cast<TreeBeard::OnlineRetilingRunner*>(onlineRunnerInt);
+  onlineRunner->RunInferenceOnMultipleBatches(inputs, results, numRows);
+}
+
+extern "C" int32_t OnlineRetilingRunner_GetNumberOfOutputs(intptr_t onlineRunnerInt) {
+  auto onlineRunner = reinterpret_cast<TreeBeard::OnlineRetilingRunner*>(onlineRunnerInt);
+  return onlineRunner->GetInferenceRunner()->GetNumberOfOutputs();
+}
+
+extern "C" int32_t OnlineRetilingRunner_GetInputLayout(intptr_t onlineRunnerInt) {
+  auto onlineRunner = reinterpret_cast<TreeBeard::OnlineRetilingRunner*>(onlineRunnerInt);
+  return static_cast<int32_t>(onlineRunner->GetInferenceRunner()->GetInputLayout());
+}
+
+extern "C" double OnlineRetilingRunner_GetDrift(intptr_t onlineRunnerInt) {
+  auto onlineRunner = reinterpret_cast<TreeBeard::OnlineRetilingRunner*>(onlineRunnerInt);
+  return onlineRunner->GetDrift();
+}
+
+extern "C" int64_t OnlineRetilingRunner_GetRecompileCount(intptr_t onlineRunnerInt) {
+  auto onlineRunner = reinterpret_cast<TreeBeard::OnlineRetilingRunner*>(onlineRunnerInt);
+  return onlineRunner->GetRecompileCount();
+}
+
+extern "C" int64_t OnlineRetilingRunner_GetSampledRowCount(intptr_t onlineRunnerInt) {
+  auto onlineRunner = reinterpret_cast<TreeBeard::OnlineRetilingRunner*>(onlineRunnerInt);
+  return onlineRunner->GetSampledRowCount();
+}
+
+// The message is copied since the sampling thread may replace it. It stays valid until the next call on this thread.
+extern "C" const char* OnlineRetilingRunner_GetRetilingError(intptr_t onlineRunnerInt) {
+  thread_local std::string retilingError;
+  auto onlineRunner = reinterpret_cast<TreeBeard::OnlineRetilingRunner*>(onlineRunnerInt);
+  retilingError = onlineRunner->GetRetilingError();
+  return retilingError.c_str();
+}
+
+extern "C" void OnlineRetilingRunner_WaitForRecompilation(intptr_t onlineRunnerInt) {
+  auto onlineRunner = reinterpret_cast<TreeBeard::OnlineRetilingRunner*>(onlineRunnerInt);
+  onlineRunner->WaitForRecompilation();
+}
+
+extern "C" void DeleteOnlineRetilingRunner(intptr_t onlineRunnerInt) {
+  auto onlineRunner = reinterpret_cast<TreeBeard::OnlineRetilingRunner*>(onlineRunnerInt);
+  delete onlineRunner;
 }
 
 mlir::decisionforest::PredictionTransformation GetPredictionTransformation(const std::string& s)
@@ -172,22 +481,25 @@ mlir::decisionforest::PredictionTransformation GetPredictionTransformation(const
   if (s == "softmax") return mlir::decisionforest::PredictionTransformation::kSoftMax;
   if(s == "id") return mlir::decisionforest::PredictionTransformation::kIdentity;
   if(s == "logistic") return mlir::decisionforest::PredictionTransformation::kSigmoid;
+  if(s == "exp") return mlir::decisionforest::PredictionTransformation::kExponential;
   
   assert(false && "Invalid prediction transformation");
 }
 
 extern "C" void CreateLLVMIRForONNXModel(const char *modelPath, const char* llvmIrPath, const char* modelGlobalsJSONPath, intptr_t options)
 {
-  TreeBeard::CompilerOptions *optionsPtr = reinterpret_cast<TreeBeard::CompilerOptions *>(options);
+  return CallAndRecordError<void>([&]() -> void {
+    TreeBeard::CompilerOptions *optionsPtr = reinterpret_cast<TreeBeard::CompilerOptions *>(options);
 
-  TreeBeard::TreebeardContext tbContext(modelPath,
-                                        modelGlobalsJSONPath,
-                                        *optionsPtr,
-                                        mlir::decisionforest::ConstructRepresentation(),
-                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath),
-                                        nullptr /*TODO_ForestCreator*/ );
+    TreeBeard::TreebeardContext tbContext(modelPath,
+                                          modelGlobalsJSONPath,
+                                          *optionsPtr,
+                                          mlir::decisionforest::ConstructRepresentation(optionsPtr->sparseRepresentation),
+                                          mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath, optionsPtr->sparseRepresentation),
+                                          nullptr /*TODO_ForestCreator*/ );
 
-  TreeBeard::ConvertONNXModelToLLVMIR(tbContext, llvmIrPath);
+    TreeBeard::ConvertONNXModelToLLVMIR(tbContext, llvmIrPath);
+  });
 }
 
 extern "C" intptr_t CreateInferenceRunnerForONNXModelInputs(int32_t numFeatures, 
@@ -198,77 +510,83 @@ extern "C" intptr_t CreateInferenceRunnerForONNXModelInputs(int32_t numFeatures,
     const int64_t *targetClassIds, const int64_t *targetClassTreeId,
     const int64_t *targetClassNodeId, const float *targetWeights,
     int64_t numWeights, int64_t batchSize, intptr_t options) {
-
-  auto modelGlobalsJSONPath = std::filesystem::temp_directory_path() / "modelGlobals.json";
-
-  TreeBeard::CompilerOptions *optionsPtr =
-      reinterpret_cast<TreeBeard::CompilerOptions *>(options);
-  TreeBeard::TreebeardContext tbContext("",
-                                        modelGlobalsJSONPath,
-                                        *optionsPtr,
-                                        mlir::decisionforest::ConstructRepresentation(),
-                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath),
-                                        nullptr  /*TODO_ForestCreator*/);
-
-  auto& context = tbContext.context;
-  mlir::ModuleOp module;
-
-  if (inputAndThresholdSize == 8) {
-    auto onnxModelConverter = TreeBeard::ONNXModelConverter<double>(
-    tbContext.serializer,
-    context,
-    numFeatures,
-    baseValue,
-    GetPredictionTransformation(predTransform),
-    mlir::arith::CmpFPredicate::ULE, // TODO - Hardcoded for now
-    numNodes,
-    treeIds,
-    nodeIds,
-    featureIds,
-    (double *)thresholds,
-    leftChildIds,
-    rightChildIds,
-    numberOfClasses,
-    targetClassTreeId,
-    targetClassNodeId,
-    targetClassIds,
-    targetWeights,
-    numWeights,
-    batchSize);
-
-    module = TreeBeard::ConstructLLVMDialectModuleFromForestCreator(tbContext, onnxModelConverter);
-
-  }
-  else if (inputAndThresholdSize == 4) {
-    auto onnxModelConverter = TreeBeard::ONNXModelConverter<float>(
-    tbContext.serializer,
-    context,
-    numFeatures,
-    baseValue,
-    GetPredictionTransformation(predTransform),
-    mlir::arith::CmpFPredicate::ULE, // TODO - Hardcoded for now
-    numNodes,
-    treeIds,
-    nodeIds,
-    featureIds,
-    (float *)thresholds,
-    leftChildIds,
-    rightChildIds,
-    numberOfClasses,
-    targetClassTreeId,
-    targetClassNodeId,
-    targetClassIds,
-    targetWeights,
-    numWeights,
-    batchSize);
-
-    module = TreeBeard::ConstructLLVMDialectModuleFromForestCreator(tbContext, onnxModelConverter);
-  }
+  return CallAndRecordError<intptr_t>([&]() -> intptr_t {
+    auto modelGlobalsJSONPath = TreeBeard::TemporaryModelGlobalsFilePath();
+
+    TreeBeard::CompilerOptions *optionsPtr =
+        reinterpret_cast<TreeBeard::CompilerOptions *>(options);
+    TreeBeard::TreebeardContext tbContext("",
+                                          modelGlobalsJSONPath,
+                                          *optionsPtr,
+                                          mlir::decisionforest::ConstructRepresentation(optionsPtr->sparseRepresentation),
+                                          mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath, optionsPtr->sparseRepresentation),
+                                          nullptr  /*TODO_ForestCreator*/);
+
+    auto& context = tbContext.context;
+    mlir::ModuleOp module;
+
+    if (inputAndThresholdSize == 8) {
+      auto onnxModelConverter = TreeBeard::ONNXModelConverter<double>(
+      tbContext.serializer,
+      context,
+      numFeatures,
+      baseValue,
+      GetPredictionTransformation(predTransform),
+      mlir::arith::CmpFPredicate::ULE, // TODO - Hardcoded for now
+      numNodes,
+      treeIds,
+      nodeIds,
+      featureIds,
+      (double *)thresholds,
+      leftChildIds,
+      rightChildIds,
+      numberOfClasses,
+      targetClassTreeId,
+      targetClassNodeId,
+      targetClassIds,
+      targetWeights,
+      numWeights,
+      batchSize);
+
+      module = TreeBeard::ConstructLLVMDialectModuleFromForestCreator(tbContext, onnxModelConverter);
+
+    }
+    else if (inputAndThresholdSize == 4) {
+      auto onnxModelConverter = TreeBeard::ONNXModelConverter<float>(
+      tbContext.serializer,
+      context,
+      numFeatures,
+      baseValue,
+      GetPredictionTransformation(predTransform),
+      mlir::arith::CmpFPredicate::ULE, // TODO - Hardcoded for now
+      numNodes,
+      treeIds,
+      nodeIds,
+      featureIds,
+      (float *)thresholds,
+      leftChildIds,
+      rightChildIds,
+      numberOfClasses,
+      targetClassTreeId,
+      targetClassNodeId,
+      targetClassIds,
+      targetWeights,
+      numWeights,
+      batchSize);
+
+      module = TreeBeard::ConstructLLVMDialectModuleFromForestCreator(tbContext, onnxModelConverter);
+    }
   
-  auto *inferenceRunner = new mlir::decisionforest::InferenceRunner(tbContext.serializer, module, 
-                                                                   optionsPtr->tileSize, optionsPtr->thresholdTypeWidth,
-                                                                   optionsPtr->featureIndexTypeWidth);
-  return reinterpret_cast<intptr_t>(inferenceRunner);
+    auto *inferenceRunner = new mlir::decisionforest::InferenceRunner(tbContext.serializer, module, 
+                                                                     optionsPtr->tileSize, optionsPtr->thresholdTypeWidth,
+                                                                     optionsPtr->featureIndexTypeWidth,
+                                                                     optionsPtr->GetLLVMCodeGenOptions());
+    SetRuntimeThreadsFromOptions(inferenceRunner, *optionsPtr);
+    // CPU models embed their buffers in the generated code and don't read the globals back
+    std::error_code errorCode;
+    std::filesystem::remove(modelGlobalsJSONPath, errorCode);
+    return reinterpret_cast<intptr_t>(inferenceRunner);
+  });
 }
 
 extern "C" void SetEnableSparseRepresentation(int32_t val) {
@@ -287,6 +605,12 @@ extern "C" int32_t IsPeeledCodeGenForProbabilityBasedTilingEnabled() {
   return mlir::decisionforest::PeeledCodeGenForProbabiltyBasedTiling;
 }
 
+// Log the time spent in each compilation phase to stdout
+extern "C" void SetEnableCompileTimeLogging(int32_t val) {
+  TreeBeard::Logging::loggingOptions.logCompileTimes = val;
+  TreeBeard::Logging::loggingEnabled = TreeBeard::Logging::loggingOptions.ShouldEnableLogging();
+}
+
 // ===-------------------------------------------------------------=== //
 // Representation API
 // ===-------------------------------------------------------------=== //
@@ -335,8 +659,10 @@ extern "C" void DestroyTreebeardContext(intptr_t tbContext) {
 }
 
 extern "C" void SetForestCreatorType(intptr_t tbContext, const char* creatorType) {
-  TreeBeard::TreebeardContext* tbContextPtr = reinterpret_cast<TreeBeard::TreebeardContext*>(tbContext);
-  tbContextPtr->SetForestCreatorType(creatorType);
+  return CallAndRecordError<void>([&]() -> void {
+    TreeBeard::TreebeardContext* tbContextPtr = reinterpret_cast<TreeBeard::TreebeardContext*>(tbContext);
+    tbContextPtr->SetForestCreatorType(creatorType);
+  });
 }
 
 extern "C" void SetRepresentationAndSerializer(intptr_t tbContext, const char* repType) {
@@ -354,8 +680,34 @@ extern "C" void* GetScheduleFromTBContext(intptr_t tbContext) {
 // ===-------------------------------------------------------------=== //
 
 extern "C" void BuildHIRRepresentation(void* tbContext) {
+  return CallAndRecordError<void>([&]() -> void {
+    TreeBeard::TreebeardContext* tbContextPtr = reinterpret_cast<TreeBeard::TreebeardContext*>(tbContext);
+    TreeBeard::BuildHIRModule(*tbContextPtr, *tbContextPtr->forestConstructor);
+  });
+}
+
+// Fills stats with the number of trees, the number of features, the number of classes, the maximum and 
+// average depth of the trees and the average number of nodes per tree. Must be called after 
+// BuildHIRRepresentation (and before the model is lowered).
+extern "C" void GetForestStatistics(void* tbContext, double *stats) {
   TreeBeard::TreebeardContext* tbContextPtr = reinterpret_cast<TreeBeard::TreebeardContext*>(tbContext);
-  TreeBeard::BuildHIRModule(*tbContextPtr, *tbContextPtr->forestConstructor);
+  auto& forest = *tbContextPtr->forestConstructor->GetForest();
+  auto numTrees = forest.NumTrees();
+  int32_t maxDepth = 0;
+  double totalDepth = 0.0, totalNodes = 0.0;
+  for (size_t i=0 ; i<numTrees ; ++i) {
+    auto& tree = forest.GetTree(i);
+    auto depth = tree.GetTreeDepth();
+    maxDepth = std::max(maxDepth, depth);
+    totalDepth += depth;
+    totalNodes += tree.GetNodes().size();
+  }
+  stats[0] = static_cast<double>(numTrees);
+  stats[1] = static_cast<double>(forest.GetFeatures().size());
+  stats[2] = static_cast<double>(forest.GetNumClasses());
+  stats[3] = static_cast<double>(maxDepth);
+  stats[4] = numTrees == 0 ? 0.0 : totalDepth / numTrees;
+  stats[5] = numTrees == 0 ? 0.0 : totalNodes / numTrees;
 }
 
 inline mlir::ModuleOp LowerToLLVM(void* tbContext) {
@@ -368,19 +720,50 @@ inline mlir::ModuleOp LowerToLLVM(void* tbContext) {
 }
 
 extern "C" bool LowerToLLVMAndDumpIR(void* tbContext, const char* fileName) {
-  auto module = LowerToLLVM(tbContext);
-  return mlir::decisionforest::dumpLLVMIRToFile(module, fileName) == 0;
+  return CallAndRecordError<bool>([&]() -> bool {
+    auto module = LowerToLLVM(tbContext);
+    return mlir::decisionforest::dumpLLVMIRToFile(module, fileName) == 0;
+  });
 }
 
 extern "C" void* ConstructInferenceRunnerFromHIR(void *tbContext) {
-  TreeBeard::TreebeardContext* tbContextPtr = reinterpret_cast<TreeBeard::TreebeardContext*>(tbContext);
-  auto module = LowerToLLVM(tbContext);
-  auto *inferenceRunner = new mlir::decisionforest::InferenceRunner(tbContextPtr->serializer,
-                                                                   module, 
-                                                                   tbContextPtr->options.tileSize,
-                                                                   tbContextPtr->options.thresholdTypeWidth,
-                                                                   tbContextPtr->options.featureIndexTypeWidth);
-  return reinterpret_cast<void*>(inferenceRunner);  
+  return CallAndRecordError<void*>([&]() -> void* {
+    TreeBeard::TreebeardContext* tbContextPtr = reinterpret_cast<TreeBeard::TreebeardContext*>(tbContext);
+    std::unique_ptr<TreeBeard::CompilationCache> cache;
+    std::string key;
+    if (!tbContextPtr->options.compilationCacheDirectory.empty()) {
+      cache = std::make_unique<TreeBeard::CompilationCache>(tbContextPtr->options.compilationCacheDirectory);
+      key = cache->ComputeKey(*tbContextPtr);
+      if (key.empty()) {
+        cache.reset();
+      }
+      else {
+        auto serializer = mlir::decisionforest::ModelSerializerFactory::Get().GetModelSerializer(tbContextPtr->representationName,
+                                                                                                cache->ModelGlobalsFilePath(key));
+        if (auto inferenceRunner = cache->Load(key, tbContextPtr->options, serializer)) {
+          SetRuntimeThreadsFromOptions(inferenceRunner, tbContextPtr->options);
+          return reinterpret_cast<void*>(inferenceRunner);
+        }
+      }
+    }
+    auto module = LowerToLLVM(tbContext);
+    auto *inferenceRunner = new mlir::decisionforest::InferenceRunner(tbContextPtr->serializer,
+                                                                     module, 
+                                                                     tbContextPtr->options.tileSize,
+                                                                     tbContextPtr->options.thresholdTypeWidth,
+                                                                     tbContextPtr->options.featureIndexTypeWidth,
+                                                                     tbContextPtr->options.GetLLVMCodeGenOptions(),
+                                                                     cache != nullptr /*enableObjectDump*/);
+    if (cache) {
+      // The globals path belongs to the caller, so the entry gets a private copy of this compilation's globals
+      auto compileModelGlobalsFilePath = cache->CompileModelGlobalsFilePath(key);
+      if (std::filesystem::exists(tbContextPtr->modelGlobalsJSONPath))
+        std::filesystem::copy_file(tbContextPtr->modelGlobalsJSONPath, compileModelGlobalsFilePath);
+      cache->Store(key, *inferenceRunner, compileModelGlobalsFilePath);
+    }
+    SetRuntimeThreadsFromOptions(inferenceRunner, tbContextPtr->options);
+    return reinterpret_cast<void*>(inferenceRunner);  
+  });
 }
 
 // ===-------------------------------------------------------------=== //
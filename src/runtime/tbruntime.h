@@ -8,6 +8,9 @@
 
 extern "C"
 {
+    // Calls that construct runners or compile models return 0 (or nothing) on failure and record a message
+    TREEBEARD_RUNTIME_EXPORT const char* GetLastErrorMessage();
+
     TREEBEARD_RUNTIME_EXPORT intptr_t CreateInferenceRunnerForONNXModelInputs(
     int32_t numFeatures, int64_t inputAndThresholdSize, int64_t numNodes, const char *predTransform,
     double baseValue, const int64_t *treeIds, const int64_t *nodeIds,
@@ -18,9 +21,36 @@ extern "C"
     int64_t numWeights, int64_t batchSize, intptr_t options);
     
     TREEBEARD_RUNTIME_EXPORT void RunInference(intptr_t inferenceRunnerInt, void *inputs, void *results);
+    TREEBEARD_RUNTIME_EXPORT void RunInferenceOnMultipleBatches(intptr_t inferenceRunnerInt, void *inputs, void *results, int32_t numRows);
+    TREEBEARD_RUNTIME_EXPORT void RunInferenceOnPartialBatch(intptr_t inferenceRunnerInt, void *inputs, void *results, int32_t numRows);
+    TREEBEARD_RUNTIME_EXPORT void RunInferenceOnStridedInput(intptr_t inferenceRunnerInt, void *inputs, void *results, int32_t numRows,
+                                                             int64_t rowStride, int64_t columnStride);
+    TREEBEARD_RUNTIME_EXPORT int32_t IsDynamicBatch(intptr_t inferenceRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT int32_t GetInputLayout(intptr_t inferenceRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT int32_t IsEarlyExitEnabled(intptr_t inferenceRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT int32_t GetNumberOfOutputs(intptr_t inferenceRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT void GetModelResults(intptr_t inferenceRunnerInt, void *results, int32_t numRows, int32_t modelIndex, void *modelResults);
+    TREEBEARD_RUNTIME_EXPORT int32_t GetNumberOfTrees(intptr_t inferenceRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT double GetAverageTreesWalkedPerRow(intptr_t inferenceRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT void ResetEarlyExitStatistics(intptr_t inferenceRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT void SetNumberOfRuntimeThreads(intptr_t inferenceRunnerInt, int32_t numThreads, int32_t pinToCores);
+    TREEBEARD_RUNTIME_EXPORT int32_t GetNumberOfRuntimeThreads(intptr_t inferenceRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT int32_t ProfileInference(intptr_t inferenceRunnerInt, void *inputs, void *results, int32_t numRows,
+                                                      int32_t numRepeats, double *profile);
 
     TREEBEARD_RUNTIME_EXPORT void DeleteInferenceRunner(intptr_t inferenceRunnerInt);
+
+    TREEBEARD_RUNTIME_EXPORT intptr_t CreateVersionedInferenceRunner(intptr_t inferenceRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT void VersionedInferenceRunner_RunInferenceOnMultipleBatches(intptr_t versionedRunnerInt, void *inputs, void *results, int32_t numRows);
+    TREEBEARD_RUNTIME_EXPORT void VersionedInferenceRunner_RunInferenceOnStridedInput(intptr_t versionedRunnerInt, void *inputs, void *results, int32_t numRows,
+                                                                                      int64_t rowStride, int64_t columnStride);
+    TREEBEARD_RUNTIME_EXPORT int32_t VersionedInferenceRunner_GetNumberOfOutputs(intptr_t versionedRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT int32_t VersionedInferenceRunner_GetInputLayout(intptr_t versionedRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT int64_t SwapModel(intptr_t versionedRunnerInt, intptr_t inferenceRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT int64_t GetModelVersion(intptr_t versionedRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT void DeleteVersionedInferenceRunner(intptr_t versionedRunnerInt);
     TREEBEARD_RUNTIME_EXPORT intptr_t CreateCompilerOptions();
+    TREEBEARD_RUNTIME_EXPORT intptr_t CreateCompilerOptionsFromConfigJSON(const char *configJSONPath);
     TREEBEARD_RUNTIME_EXPORT void DeleteCompilerOptions(intptr_t options);
 
     COMPILER_OPTION_SETTER_DECLARATION(batchSize, int32_t)
@@ -39,13 +69,44 @@ extern "C"
     COMPILER_OPTION_SETTER_DECLARATION(statsProfileCSVPath,  const char*)
     COMPILER_OPTION_SETTER_DECLARATION(pipelineSize, int32_t)
     COMPILER_OPTION_SETTER_DECLARATION(numberOfCores, int32_t)
+    COMPILER_OPTION_SETTER_DECLARATION(dynamicBatch, int32_t)
+    COMPILER_OPTION_SETTER_DECLARATION(quantizeInputs, int32_t)
+    COMPILER_OPTION_SETTER_DECLARATION(peeledCodeGenForProbabilityBasedTiling, int32_t)
+    COMPILER_OPTION_SETTER_DECLARATION(sparseRepresentation, int32_t)
+    COMPILER_OPTION_SETTER_DECLARATION(returnAllOutputs, int32_t)
+    COMPILER_OPTION_SETTER_DECLARATION(profileLeafHits, int32_t)
+    COMPILER_OPTION_SETTER_DECLARATION(featureGroupBatchTileSize, int32_t)
+    COMPILER_OPTION_SETTER_DECLARATION(optimizationLevel, int32_t)
+    COMPILER_OPTION_SETTER_DECLARATION(targetCPU, const char*)
+    COMPILER_OPTION_SETTER_DECLARATION(targetFeatures, const char*)
+    COMPILER_OPTION_SETTER_DECLARATION(compilationCacheDirectory, const char*)
+
+    TREEBEARD_RUNTIME_EXPORT int64_t GetCompilationCacheHits();
+    TREEBEARD_RUNTIME_EXPORT int64_t GetCompilationCacheMisses();
+    TREEBEARD_RUNTIME_EXPORT void ResetCompilationCacheStatistics();
+    TREEBEARD_RUNTIME_EXPORT void ComputeProbabilityProfile(const char* modelJSONPath, const char* csvPath, const char* profileCSVPath,
+                                                            int32_t numRows, int32_t batchSize);
 
+    TREEBEARD_RUNTIME_EXPORT intptr_t CreateOnlineRetilingRunner(const char* modelJSONPath, const char* profileCSVPath, intptr_t options,
+                                                                 double samplingFraction, double driftThreshold, int64_t minSampledRows);
+    TREEBEARD_RUNTIME_EXPORT void OnlineRetilingRunner_RunInferenceOnMultipleBatches(intptr_t onlineRunnerInt, void *inputs, void *results, int32_t numRows);
+    TREEBEARD_RUNTIME_EXPORT int32_t OnlineRetilingRunner_GetNumberOfOutputs(intptr_t onlineRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT int32_t OnlineRetilingRunner_GetInputLayout(intptr_t onlineRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT double OnlineRetilingRunner_GetDrift(intptr_t onlineRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT int64_t OnlineRetilingRunner_GetRecompileCount(intptr_t onlineRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT int64_t OnlineRetilingRunner_GetSampledRowCount(intptr_t onlineRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT const char* OnlineRetilingRunner_GetRetilingError(intptr_t onlineRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT void OnlineRetilingRunner_WaitForRecompilation(intptr_t onlineRunnerInt);
+    TREEBEARD_RUNTIME_EXPORT void DeleteOnlineRetilingRunner(intptr_t onlineRunnerInt);
 
     TREEBEARD_RUNTIME_EXPORT void Set_tilingType(intptr_t options, int32_t val);
+    TREEBEARD_RUNTIME_EXPORT void Set_inputLayout(intptr_t options, int32_t val);
+    TREEBEARD_RUNTIME_EXPORT void Set_earlyExitThreshold(intptr_t options, double val);
     TREEBEARD_RUNTIME_EXPORT void SetEnableSparseRepresentation(int32_t val);
     TREEBEARD_RUNTIME_EXPORT int32_t IsSparseRepresentationEnabled();
     TREEBEARD_RUNTIME_EXPORT void SetPeeledCodeGenForProbabilityBasedTiling(int32_t val);
     TREEBEARD_RUNTIME_EXPORT int32_t IsPeeledCodeGenForProbabilityBasedTilingEnabled();
+    TREEBEARD_RUNTIME_EXPORT void SetEnableCompileTimeLogging(int32_t val);
 }
 
 #endif // RUNTIME_H
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <cassert>
 #include <algorithm>
 #include <set>
+#include <sstream>
 #include "schedule.h"
 
 namespace mlir
@@ -242,6 +243,14 @@ Schedule& Schedule::Cache(IndexVariable& index) {
   return *this;
 }
 
+Schedule& Schedule::EarlyExit(IndexVariable& index, double threshold) {
+  assert (index.m_type == IndexVariable::IndexVariableType::kTree && "Early exit must be called on a tree loop");
+  assert (index.m_containedLoops.size() == 0 && "Early exit must be called on an innermost loop");
+  index.m_earlyExit = true;
+  index.m_earlyExitThreshold = threshold;
+  return *this;
+}
+
 Schedule& Schedule::Pipeline(IndexVariable& index, int32_t stepSize) {
   assert (index.m_containedLoops.size() == 0 && "Pipeline must be called on an innermost loop");
   assert ((index.m_range.m_stop - index.m_range.m_start) >= stepSize && "Step size must be smaller than the range");
@@ -266,8 +275,29 @@ bool Schedule::IsDefaultSchedule() {
   return true;
 }
 
+void Schedule::WriteIndexToStream(IndexVariable* index, std::ostream& out, int32_t depth) {
+  out << std::string(2*depth, ' ') << index->m_name << " [" << index->m_range.m_start << ", " 
+      << index->m_range.m_stop << ", " << index->m_range.m_step << "]";
+  if (index->m_pipelined) out << " pipelined";
+  if (index->m_simdized) out << " simd";
+  if (index->m_parallel) out << " parallel";
+  if (index->m_unrolled) out << " unrolled";
+  if (index->m_treeWalkUnrollFactor > 0) out << " unroll_walk(" << index->m_treeWalkUnrollFactor << ")";
+  if (index->m_peelWalk) out << " peel_walk(" << index->m_iterationsToPeel << ")";
+  if (index->m_cache) out << " cache";
+  if (index->m_earlyExit) out << " early_exit(" << index->m_earlyExitThreshold << ")";
+  if (index->m_gpuConstruct != IndexVariable::GPUConstruct::None)
+    out << " gpu(" << static_cast<int32_t>(index->m_gpuConstruct) << ", " << static_cast<int32_t>(index->m_dimension) << ")";
+  out << "\n";
+  for (auto child : index->m_containedLoops)
+    WriteIndexToStream(child, out, depth + 1);
+}
+
+// Prints the loop nest, one index variable per line, with its range and optimizations
 std::string Schedule::PrintToString() {
-  return std::string("");
+  std::ostringstream out;
+  WriteIndexToStream(&m_rootIndex, out, 0);
+  return out.str();
 }
 
 void Schedule::Finalize() {
@@ -118,6 +118,10 @@ protected:
   
   bool m_cache = false;
 
+  // Stop iterating over the trees of a row once the prediction is known to be on one side of the threshold
+  bool m_earlyExit = false;
+  double m_earlyExitThreshold = 0.0;
+
   // Index variables can only be constructed through the Schedule object
   IndexVariable(const std::string& name)
     :m_name(name), m_containingLoop(nullptr), m_parentModifier(nullptr), m_modifier(nullptr), m_treeWalkUnrollFactor(-1)
@@ -143,6 +147,9 @@ public:
   int32_t IterationsToPeel() const { return m_iterationsToPeel; }
 
   bool Cache() const { return m_cache; }
+
+  bool EarlyExit() const { return m_earlyExit; }
+  double EarlyExitThreshold() const { return m_earlyExitThreshold; }
   
   void Visit(IndexDerivationTreeVisitor& visitor) override;
   void Validate() override;
@@ -175,6 +182,7 @@ class Schedule {
   Schedule(const Schedule&) = delete;
   void DuplicateIndexVariables(IndexVariable& index, std::map<IndexVariable*, std::pair<IndexVariable*, IndexVariable*>>& indexMap);
   void WriteIndexToDOTFile(IndexVariable* index, std::ofstream& fout);
+  void WriteIndexToStream(IndexVariable* index, std::ostream& out, int32_t depth);
 
 public:
   typedef std::map<IndexVariable*, std::pair<IndexVariable*, IndexVariable*>> IndexVariableMapType;
@@ -196,6 +204,8 @@ public:
   Schedule& Unroll(IndexVariable& index);
   Schedule& PeelWalk(IndexVariable& index, int32_t numberOfIterations);
   Schedule& Cache(IndexVariable& index);
+  // threshold is on the untransformed prediction (the sum of the tree predictions and the initial offset)
+  Schedule& EarlyExit(IndexVariable& index, double threshold);
 
   const IndexVariable* GetRootIndex() const { return &m_rootIndex; }
   IndexVariable& GetBatchIndex() { return m_batchIndex; }
@@ -1,5 +1,6 @@
 #include <vector>
 #include <sstream>
+#include <limits>
 #include "Dialect.h"
 #include "TestUtilsCommon.h"
 
@@ -415,7 +416,7 @@ public:
   // Add a function that takes a memref of appropriate type and copies the threshold values
   // from the model into the argument memref.
   void AddThresholdGetter() {
-    int64_t length = decisionforest::ForestJSONReader::GetInstance().GetTotalNumberOfTiles();
+    int64_t length = this->m_serializer->GetForestJSONReader().GetTotalNumberOfTiles();
     int64_t shape[] = { length };
     int32_t tileSize = m_tilingDescriptors.at(0).MaxTileSize();
     assert (tileSize > 1);
@@ -486,12 +487,15 @@ public:
 
 // Defined in TestMain.cpp
 std::vector<std::vector<double>> GetBatchSize1Data();
+std::vector<std::vector<double>> GetMissingValuesBatchSize1Data();
+std::vector<std::vector<double>> GetCategoricalBatchSize1Data();
 
 template<typename ThresholdType=double, typename ReturnType=double, typename FeatureIndexType=int32_t,
          typename NodeIndexType=int32_t, typename InputElementType=double, typename TileShapeType=int32_t>
 bool Test_TiledCodeGeneration_SingleTreeModels_BatchSize1(TestArgs_t& args, ForestConstructor_t forestConstructor, 
                                                           int32_t tileSize, const std::vector<std::vector<int32_t>>& tileIDsVec, int32_t childIndexBitWidth,
-                                                          ScheduleManipulator_t scheduleManipulator=nullptr, bool probabilisticTiling=false, int32_t levelsToUnroll=-1) {
+                                                          ScheduleManipulator_t scheduleManipulator=nullptr, bool probabilisticTiling=false, int32_t levelsToUnroll=-1,
+                                                          const std::vector<std::vector<double>>& inputData=GetBatchSize1Data()) {
   std::vector<decisionforest::TreeTilingDescriptor> tilingDescriptors;
   for (auto& tileIDs : tileIDsVec) {
     decisionforest::TreeTilingDescriptor tilingDescriptor(tileSize, 5, tileIDs, decisionforest::TilingType::kRegular);
@@ -526,7 +530,6 @@ bool Test_TiledCodeGeneration_SingleTreeModels_BatchSize1(TestArgs_t& args, Fore
   // decisionforest::dumpLLVMIR(module);
   decisionforest::InferenceRunner inferenceRunner(serializer, module, tileSize, sizeof(ThresholdType)*8, sizeof(FeatureIndexType)*8);
   
-  auto inputData = GetBatchSize1Data();
   for(auto& row : inputData) {
     ThresholdType result = -1;
     std::vector<InputElementType> inputRow(row.begin(), row.end());
@@ -587,6 +590,58 @@ bool Test_TiledCodeGeneration_BalancedTree_BatchSize1(TestArgs_t& args) {
   return true;
 }
 
+// Tiles mix nodes that send missing values left with nodes that send them right
+template<typename FPType, typename IntType>
+bool Test_TiledCodeGeneration_MissingValues_BatchSize1(TestArgs_t& args, int32_t childIndexBitWidth) {
+  auto forestConstructor = AddBalancedTreeWithDefaultDirections<DoubleInt32Tile>;
+  auto data = GetMissingValuesBatchSize1Data();
+  std::vector<int32_t> tileIDs = { 0, 0, 1, 2, 0, 3, 4 };
+  std::vector<int32_t> tileIDs_TileSize2 = { 0, 0, 1, 2, 5, 3, 4 };
+  Test_ASSERT((Test_TiledCodeGeneration_SingleTreeModels_BatchSize1<FPType, FPType, IntType, IntType, FPType>(args, forestConstructor, 2, { tileIDs_TileSize2 }, childIndexBitWidth, nullptr, false, -1, data)));
+  Test_ASSERT((Test_TiledCodeGeneration_SingleTreeModels_BatchSize1<FPType, FPType, IntType, IntType, FPType>(args, forestConstructor, 3, { tileIDs }, childIndexBitWidth, nullptr, false, -1, data)));
+  Test_ASSERT((Test_TiledCodeGeneration_SingleTreeModels_BatchSize1<FPType, FPType, IntType, IntType, FPType>(args, forestConstructor, 4, { tileIDs }, childIndexBitWidth, nullptr, false, -1, data)));
+  return true;
+}
+
+bool Test_TiledCodeGeneration_MissingValues_BatchSize1(TestArgs_t& args) {
+  Test_ASSERT((Test_TiledCodeGeneration_MissingValues_BatchSize1<double, int32_t>(args, 1)));
+  Test_ASSERT((Test_TiledCodeGeneration_MissingValues_BatchSize1<float, int8_t>(args, 1)));
+  return true;
+}
+
+bool Test_SparseTiledCodeGeneration_MissingValues_BatchSize1(TestArgs_t& args) {
+  decisionforest::UseSparseTreeRepresentation = true;
+  Test_ASSERT((Test_TiledCodeGeneration_MissingValues_BatchSize1<double, int32_t>(args, 32)));
+  Test_ASSERT((Test_TiledCodeGeneration_MissingValues_BatchSize1<float, int8_t>(args, 32)));
+  return true;
+}
+
+// Tiles mix numerical and categorical nodes
+template<typename FPType, typename IntType>
+bool Test_TiledCodeGeneration_CategoricalSplits_BatchSize1(TestArgs_t& args, int32_t childIndexBitWidth) {
+  auto forestConstructor = AddBalancedTreeWithCategoricalSplits<DoubleInt32Tile>;
+  auto data = GetCategoricalBatchSize1Data();
+  std::vector<int32_t> tileIDs = { 0, 0, 1, 2, 0, 3, 4 };
+  std::vector<int32_t> tileIDs_TileSize2 = { 0, 0, 1, 2, 5, 3, 4 };
+  Test_ASSERT((Test_TiledCodeGeneration_SingleTreeModels_BatchSize1<FPType, FPType, IntType, IntType, FPType>(args, forestConstructor, 2, { tileIDs_TileSize2 }, childIndexBitWidth, nullptr, false, -1, data)));
+  Test_ASSERT((Test_TiledCodeGeneration_SingleTreeModels_BatchSize1<FPType, FPType, IntType, IntType, FPType>(args, forestConstructor, 3, { tileIDs }, childIndexBitWidth, nullptr, false, -1, data)));
+  Test_ASSERT((Test_TiledCodeGeneration_SingleTreeModels_BatchSize1<FPType, FPType, IntType, IntType, FPType>(args, forestConstructor, 4, { tileIDs }, childIndexBitWidth, nullptr, false, -1, data)));
+  return true;
+}
+
+bool Test_TiledCodeGeneration_CategoricalSplits_BatchSize1(TestArgs_t& args) {
+  Test_ASSERT((Test_TiledCodeGeneration_CategoricalSplits_BatchSize1<double, int32_t>(args, 1)));
+  Test_ASSERT((Test_TiledCodeGeneration_CategoricalSplits_BatchSize1<float, int8_t>(args, 1)));
+  return true;
+}
+
+bool Test_SparseTiledCodeGeneration_CategoricalSplits_BatchSize1(TestArgs_t& args) {
+  decisionforest::UseSparseTreeRepresentation = true;
+  Test_ASSERT((Test_TiledCodeGeneration_CategoricalSplits_BatchSize1<double, int32_t>(args, 32)));
+  Test_ASSERT((Test_TiledCodeGeneration_CategoricalSplits_BatchSize1<float, int8_t>(args, 32)));
+  return true;
+}
+
 template<typename TileShapeType>
 bool Test_TiledCodeGeneration_ForestConstructor_BatchSize1(TestArgs_t& args, ForestConstructor_t forestConstructor, 
                                                            const std::vector<std::vector<int32_t>>& tileIDs, int32_t childIndexBitWidth=1,
@@ -802,7 +857,7 @@ bool Test_ModelInitialization(TestArgs_t& args, ForestConstructor_t forestConstr
   std::vector<ThresholdType> thresholds;
   std::vector<FeatureIndexType> featureIndices;
   std::vector<TileShapeType> tileShapeIDs;
-  mlir::decisionforest::ForestJSONReader::GetInstance().GetModelValues(tileSize, thresholdSize, featureIndexSize, thresholds, featureIndices, tileShapeIDs);
+  serializer->GetForestJSONReader().GetModelValues(tileSize, thresholdSize, featureIndexSize, thresholds, featureIndices, tileShapeIDs);
 
   decisionforest::Memref<ThresholdType, 1> modelMemref;
   {
@@ -1363,5 +1418,97 @@ bool Test_WalkPeeling_BalancedTree_TileSize2(TestArgs_t& args) {
   return true;
 }
 
+// A tree whose nodes each have a leaf as their left child. Node d (at depth d) compares feature 0 with d. 
+// There are numLevels levels of nodes and two leaves at the deepest level.
+void InitializeCaterpillarTree(decisionforest::DecisionTree& tree, int32_t numLevels) {
+  auto parent = tree.NewNode(0, 0);
+  tree.SetNodeParent(parent, -1);
+  for (int32_t depth = 1 ; depth < numLevels ; ++depth) {
+    auto leaf = tree.NewNode(depth - 1, -1);
+    tree.SetNodeParent(leaf, parent);
+    tree.SetNodeLeftChild(parent, leaf);
+    auto node = depth == numLevels - 1 ? tree.NewNode(depth, -1) : tree.NewNode(depth, 0);
+    tree.SetNodeParent(node, parent);
+    tree.SetNodeRightChild(parent, node);
+    parent = node;
+  }
+}
+
+bool Test_HybridLayout_ArrayLevelChoice(TestArgs_t& args) {
+  const int64_t kUnboundedLength = std::numeric_limits<int32_t>::max();
+  // Every level of a perfect tree is full, so all of them are stored as a perfect tree
+  decisionforest::DecisionTree balancedTree;
+  InitializeBalancedTree(balancedTree);
+  auto balancedTiles = GetHybridLayoutTiles(balancedTree, 1, false);
+  Test_ASSERT(balancedTiles.size() == 7);
+  Test_ASSERT(ChooseHybridArrayLevels(balancedTiles, 1, kUnboundedLength) == 3);
+
+  // Costs of the 10 level caterpillar tree (19 tiles, one leaf at each depth from 1 to 8 and two at depth 9) 
+  // for 1 to 6 levels : 5.4, 4.4, 3.5+2/19, 2.7+8/19, 2.0+22/19, 1.4+52/19. Adding the 7th level wastes more 
+  // than the best cost.
+  decisionforest::DecisionTree caterpillarTree;
+  InitializeCaterpillarTree(caterpillarTree, 10);
+  auto tiles = GetHybridLayoutTiles(caterpillarTree, 1, false);
+  Test_ASSERT(tiles.size() == 19);
+  Test_ASSERT(ChooseHybridArrayLevels(tiles, 1, kUnboundedLength) == 4);
+  // With 4 levels the tree needs 15 + 2*6 slots and with 3 levels it needs 7 + 2*7
+  Test_ASSERT(ChooseHybridArrayLevels(tiles, 1, 21) == 3);
+
+  // Profiled leaves are weighted by their hit counts. Walks that mostly end at the shallowest leaf need 
+  // few levels and walks that mostly reach the deepest leaves need more.
+  auto setLeafHitCounts = [&tiles](int32_t frequentDepth) {
+    for (auto& tile : tiles)
+      if (tile.children.empty())
+        tile.hitCount = tile.depth == frequentDepth ? 100 : 1;
+  };
+  setLeafHitCounts(1);
+  Test_ASSERT(ChooseHybridArrayLevels(tiles, 1, kUnboundedLength) == 2);
+  setLeafHitCounts(9);
+  Test_ASSERT(ChooseHybridArrayLevels(tiles, 1, kUnboundedLength) == 5);
+  return true;
+}
+
+// Checks that every tile of a deep unbalanced tree is placed in exactly one slot and that its children are 
+// found by index arithmetic in the first arrayLevels-1 levels and through the child index below them.
+bool Test_HybridLayout_DeepUnbalancedTree(TestArgs_t& args) {
+  const int32_t numLevels = 12;
+  decisionforest::DecisionTree tree;
+  InitializeCaterpillarTree(tree, numLevels);
+  auto tiles = GetHybridLayoutTiles(tree, 1, false);
+  auto arrayLevels = ChooseHybridArrayLevels(tiles, 1, std::numeric_limits<int32_t>::max());
+  Test_ASSERT(arrayLevels == 5);
+  auto layout = LayOutHybridTree(tiles, 1, arrayLevels);
+  // 31 slots for the perfect tree and two slots for the children of each of the 7 nodes at depths 4 to 10
+  Test_ASSERT(layout.arrayLength == 15);
+  Test_ASSERT(layout.tileInSlot.size() == 31 + 2*7);
+  Test_ASSERT(layout.childIndices.size() == layout.tileInSlot.size());
+
+  std::vector<int64_t> slotOfTile(tiles.size(), -1);
+  for (int64_t slot=0 ; slot<static_cast<int64_t>(layout.tileInSlot.size()) ; ++slot) {
+    auto tileIndex = layout.tileInSlot.at(slot);
+    if (tileIndex == -1)
+      continue;
+    Test_ASSERT(slotOfTile.at(tileIndex) == -1);
+    slotOfTile.at(tileIndex) = slot;
+    // Tiles in the first arrayLevels levels are in the perfect tree
+    Test_ASSERT((slot < 31) == (tiles.at(tileIndex).depth < arrayLevels));
+  }
+  Test_ASSERT(slotOfTile.at(0) == 0);
+  for (size_t i=0 ; i<tiles.size() ; ++i) {
+    auto slot = slotOfTile.at(i);
+    Test_ASSERT(slot != -1);
+    auto& tile = tiles.at(i);
+    if (tile.children.empty()) {
+      Test_ASSERT(layout.childIndices.at(slot) == -1);
+      continue;
+    }
+    auto firstChildSlot = slot < layout.arrayLength ? 2*slot + 1 : layout.childIndices.at(slot);
+    Test_ASSERT(layout.childIndices.at(slot) == firstChildSlot);
+    for (size_t j=0 ; j<tile.children.size() ; ++j)
+      Test_ASSERT(layout.tileInSlot.at(firstChildSlot + j) == tile.children.at(j));
+  }
+  return true;
+}
+
 } // test
-} // TreeBeard
\ No newline at end of file
+} // TreeBeard
@@ -163,6 +163,31 @@ std::vector<TileType> AddBalancedTree(mlir::decisionforest::DecisionForest& fore
   return expectedArray;
 }
 
+// A balanced tree whose nodes disagree on the direction missing values go in
+template<typename TileType>
+std::vector<TileType> AddBalancedTreeWithDefaultDirections(mlir::decisionforest::DecisionForest& forest) {
+  auto expectedArray = AddBalancedTree<TileType>(forest);
+  auto& tree = forest.GetTree(forest.NumTrees() - 1);
+  tree.SetNodeDefaultLeft(0, true); // root (feature 2)
+  tree.SetNodeDefaultLeft(1, true); // right child (feature 4)
+  tree.SetNodeDefaultLeft(4, false); // left child (feature 1)
+  assert (forest.GetMissingValueRouting() == mlir::decisionforest::MissingValueRouting::kPerNode);
+  return expectedArray;
+}
+
+// A balanced tree with a numerical root (feature 2) and categorical splits on features 4 and 1. 
+// The categories of the left child need more than one bitset word.
+template<typename TileType>
+std::vector<TileType> AddBalancedTreeWithCategoricalSplits(mlir::decisionforest::DecisionForest& forest) {
+  auto expectedArray = AddBalancedTree<TileType>(forest);
+  auto& tree = forest.GetTree(forest.NumTrees() - 1);
+  tree.SetNodeCategoricalSplit(1, forest.AddCategoricalBitset({0, 2, 3})); // right child (feature 4)
+  tree.SetNodeCategoricalSplit(4, forest.AddCategoricalBitset({1, 33, 70})); // left child (feature 1)
+  tree.SetNodeDefaultLeft(1, true);
+  assert (forest.HasCategoricalSplits());
+  return expectedArray;
+}
+
 template<typename TileType>
 std::vector<TileType> AddRightAndLeftHeavyTrees(decisionforest::DecisionForest& forest) {
   auto expectedArray = AddRightHeavyTree<TileType>(forest);
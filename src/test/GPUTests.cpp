@@ -260,15 +260,16 @@ bool CheckGPUModelInitialization_Scalar(TestArgs_t& args, ForestConstructor_t fo
   
   // TODO this is a hack. We are kind of breaking the abstraction to get hold of
   // information that would otherwise be hard to get.
-  auto numModelElements = decisionforest::ForestJSONReader::GetInstance().GetTotalNumberOfTiles();
+  auto& forestJSONReader = serializer->GetForestJSONReader();
+  auto numModelElements = forestJSONReader.GetTotalNumberOfTiles();
   std::vector<ThresholdType> actualThresholds;
   std::vector<IndexType> actualFeatureIndices, actualTileShapes;
-  decisionforest::ForestJSONReader::GetInstance().GetModelValues(1 /*tileSize*/,
-                                                                 sizeof(ThresholdType)*8,
-                                                                 sizeof(IndexType)*8,
-                                                                 actualThresholds,
-                                                                 actualFeatureIndices,
-                                                                 actualTileShapes);
+  forestJSONReader.GetModelValues(1 /*tileSize*/,
+                                  sizeof(ThresholdType)*8,
+                                  sizeof(IndexType)*8,
+                                  actualThresholds,
+                                  actualFeatureIndices,
+                                  actualTileShapes);
 
   std::vector<ThresholdType> thresholds(numModelElements, -42);
   std::vector<IndexType> featureIndices(numModelElements, -42);
@@ -462,7 +463,8 @@ bool Test_GPUCodeGeneration_XGBoostModel_VariableBatchSize(TestArgs_t& args,
                                                      const int32_t batchSize,
                                                      const std::string& xgboostModelFile,
                                                      const std::string& representation,
-                                                     int32_t childIndexBitWidth=1) {
+                                                     int32_t childIndexBitWidth=1,
+                                                     bool binaryModelGlobals=false) {
   using NodeIndexType = int32_t;
   int32_t floatTypeBitWidth = sizeof(FloatType)*8;
   TreeBeard::CompilerOptions options(floatTypeBitWidth, sizeof(ThresholdType)*8, IsFloatType(ThresholdType()), 32 /*feature index type*/, sizeof(NodeIndexType)*8,
@@ -471,6 +473,8 @@ bool Test_GPUCodeGeneration_XGBoostModel_VariableBatchSize(TestArgs_t& args,
 
   auto xgboostModelPath = GetXGBoostModelPath(xgboostModelFile);
   auto modelGlobalsJSONPath = TreeBeard::ForestCreator::ModelGlobalJSONFilePathFromJSONFilePath(xgboostModelPath);
+  if (binaryModelGlobals)
+    modelGlobalsJSONPath = TreeBeard::test::GetTempFilePath() + decisionforest::BinaryModelGlobalsFileExtension;
   auto csvPath = xgboostModelPath + ".csv";
 
   MLIRContext context;
@@ -994,6 +998,16 @@ bool Test_GPUCodeGeneration_Covtype_SparseRep_DoubleInt32_BatchSize32(TestArgs_t
   return Test_GPUCodeGeneration_XGBoostModel_VariableBatchSize<float, int8_t, int32_t>(args, 32, "covtype_xgb_model_save.json", "gpu_sparse", 16);
 }
 
+// The model buffers are passed to the generated code straight from the mapped globals file
+bool Test_GPUCodeGeneration_Covtype_ArrayRep_BinaryGlobals_BatchSize32(TestArgs_t& args) {
+  return Test_GPUCodeGeneration_XGBoostModel_VariableBatchSize<float, int8_t, int32_t>(args, 32, "covtype_xgb_model_save.json", "gpu_array", 1, true);
+}
+
+bool Test_GPUCodeGeneration_Covtype_SparseRep_BinaryGlobals_BatchSize32(TestArgs_t& args) {
+  mlir::decisionforest::UseSparseTreeRepresentation = true;
+  return Test_GPUCodeGeneration_XGBoostModel_VariableBatchSize<float, int8_t, int32_t>(args, 32, "covtype_xgb_model_save.json", "gpu_sparse", 16, true);
+}
+
 bool Test_GPUCodeGeneration_Covtype_ReorgRep_DoubleInt32_BatchSize32(TestArgs_t& args) {
   return Test_GPUCodeGeneration_XGBoostModel_VariableBatchSize<float, int8_t, int32_t>(args, 32, "covtype_xgb_model_save.json", "gpu_reorg");
 }
@@ -0,0 +1,124 @@
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+#include "Dialect.h"
+#include "TestUtilsCommon.h"
+
+#include "mlir/IR/MLIRContext.h"
+
+#include "lightgbmparser.h"
+#include "ExecutionHelpers.h"
+#include "CompileUtils.h"
+#include "CompilationCache.h"
+#include "ModelSerializers.h"
+#include "Representations.h"
+using namespace mlir;
+using namespace mlir::decisionforest;
+
+namespace TreeBeard
+{
+namespace test
+{
+
+// ===--------------------------------------------------------=== //
+// LightGBM Text Model Tests
+// ===--------------------------------------------------------=== //
+
+// The test model is a binary classifier (sigmoid:2) with a categorical split and nodes with each missing
+// value type. The last column of its CSV is the expected probability, computed independently of Treebeard.
+template<typename FloatType>
+bool Test_LightGBMTextModel(TestArgs_t& args, int32_t tileSize, bool sparseRepresentation) {
+  const int32_t batchSize = 4;
+  using FeatureIndexType = int16_t;
+  auto modelPath = GetTreeBeardRepoPath() + "/xgb_models/test/binary_categorical_lightgbm_model.txt";
+  int32_t floatTypeBitWidth = sizeof(FloatType)*8;
+  TreeBeard::CompilerOptions options(floatTypeBitWidth, floatTypeBitWidth, true, sizeof(FeatureIndexType)*8, 32, floatTypeBitWidth,
+                                     batchSize, tileSize, 16, 1, TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.sparseRepresentation = sparseRepresentation;
+  auto modelGlobalsJSONPath = TreeBeard::TemporaryModelGlobalsFilePath();
+  TreeBeard::TreebeardContext tbContext(modelPath, modelGlobalsJSONPath, options,
+                                        mlir::decisionforest::ConstructRepresentation(sparseRepresentation),
+                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath, sparseRepresentation));
+  TreeBeard::LightGBMTextParser<FloatType, FloatType, FeatureIndexType, int32_t, FloatType> parser(tbContext.context, modelPath,
+                                                                                                   tbContext.serializer, batchSize);
+  auto module = TreeBeard::ConstructLLVMDialectModuleFromForestCreator(tbContext, parser);
+  decisionforest::InferenceRunner inferenceRunner(tbContext.serializer, module, tileSize, floatTypeBitWidth, sizeof(FeatureIndexType)*8);
+  std::filesystem::remove(modelGlobalsJSONPath);
+
+  TestCSVReader csvReader(modelPath + ".csv");
+  int64_t numRows = csvReader.NumberOfRows() - 1;
+  std::vector<FloatType> inputs, expectedResults;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<FloatType>(i);
+    expectedResults.push_back(row.back());
+    row.pop_back();
+    inputs.insert(inputs.end(), row.begin(), row.end());
+  }
+  std::vector<FloatType> results(numRows, -1);
+  inferenceRunner.RunInferenceOnMultipleBatches(inputs.data(), results.data(), numRows);
+  for (int64_t i=0 ; i<numRows ; ++i)
+    Test_ASSERT(FPEqual<FloatType>(results[i], expectedResults[i]));
+  return true;
+}
+
+bool Test_LightGBMTextModel_Float_Scalar(TestArgs_t &args) {
+  return Test_LightGBMTextModel<float>(args, 1, false);
+}
+
+bool Test_LightGBMTextModel_Double_TileSize4_Sparse(TestArgs_t &args) {
+  return Test_LightGBMTextModel<double>(args, 4, true);
+}
+
+bool LightGBMModelIsRejected(const std::string& modelText) {
+  auto modelPath = (std::filesystem::temp_directory_path() /
+                    ("treebeard-invalid-lightgbm-" + std::to_string(getpid()) + ".txt")).string();
+  {
+    std::ofstream fout(modelPath);
+    fout << modelText;
+  }
+  bool rejected = false;
+  try {
+    mlir::MLIRContext context;
+    TreeBeard::InitializeMLIRContext(context);
+    TreeBeard::LightGBMTextParser<> parser(context, modelPath, decisionforest::ConstructModelSerializer(""), 4);
+    parser.ConstructForest();
+  }
+  catch (const std::runtime_error&) {
+    rejected = true;
+  }
+  std::filesystem::remove(modelPath);
+  return rejected;
+}
+
+// Models the parser can't represent must be rejected with an error rather than compiled incorrectly
+bool Test_LightGBMTextModel_UnsupportedModelsAreRejected(TestArgs_t &args) {
+  const std::string header = "tree\nversion=v4\nnum_class=1\nnum_tree_per_iteration=1\nmax_feature_idx=1\n";
+  const std::string tree = "Tree=0\nnum_leaves=2\nnum_cat=0\nsplit_feature=0\nthreshold=0.5\ndecision_type=2\n"
+                           "left_child=-1\nright_child=-2\nleaf_value=0.25 -0.5\n";
+  // The valid model must be accepted, otherwise the checks below prove nothing
+  Test_ASSERT(!LightGBMModelIsRejected(header + "objective=regression\n\n" + tree + "\nend of trees\n"));
+
+  Test_ASSERT(LightGBMModelIsRejected(header + "objective=regression sqrt\n\n" + tree + "\nend of trees\n"));
+  // Multi-class models must have one tree per class in each iteration
+  const std::string multiClassHeader = "tree\nversion=v4\nnum_class=3\nmax_feature_idx=1\nobjective=multiclass num_class:3\n";
+  Test_ASSERT(LightGBMModelIsRejected(multiClassHeader + "num_tree_per_iteration=1\n\n" + tree + "\nend of trees\n"));
+  Test_ASSERT(LightGBMModelIsRejected(multiClassHeader + "num_tree_per_iteration=3\n\n" + tree + "\nend of trees\n"));
+  Test_ASSERT(LightGBMModelIsRejected(header + "objective=cross_entropy_lambda\n\n" + tree + "\nend of trees\n"));
+  Test_ASSERT(LightGBMModelIsRejected(header + "objective=regression\n\n" + tree + "is_linear=1\n\nend of trees\n"));
+  Test_ASSERT(LightGBMModelIsRejected(header + "objective=regression\nfeature_names=a b c\n\n" + tree + "\nend of trees\n"));
+  // Zero is treated as missing and sent right (default_left is not set) even though it is less than the threshold
+  std::string zeroMissingTree = tree;
+  zeroMissingTree.replace(zeroMissingTree.find("decision_type=2"), std::string("decision_type=2").size(), "decision_type=4");
+  Test_ASSERT(LightGBMModelIsRejected(header + "objective=regression\n\n" + zeroMissingTree + "\nend of trees\n"));
+  std::string truncatedTree = tree;
+  truncatedTree.replace(truncatedTree.find("leaf_value=0.25 -0.5"), std::string("leaf_value=0.25 -0.5").size(), "leaf_value=0.25");
+  Test_ASSERT(LightGBMModelIsRejected(header + "objective=regression\n\n" + truncatedTree + "\nend of trees\n"));
+  Test_ASSERT(LightGBMModelIsRejected("{ \"learner\" : {} }\n"));
+  return true;
+}
+
+} // namespace test
+} // namespace TreeBeard
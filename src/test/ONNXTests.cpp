@@ -1,6 +1,10 @@
 #include <vector>
 #include <sstream>
 #include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <unistd.h>
 #include "Dialect.h"
 #include "TestUtilsCommon.h"
 
@@ -61,5 +65,161 @@ namespace test
             &options);
         return ValidateModuleOutputAgainstCSVdata<float, float>(*inferenceRunner, csvPath, 1024);
     }
+
+    void AddONNXAttribute(onnx::NodeProto& node, const std::string& name, const std::vector<int64_t>& values) {
+        auto* attribute = node.add_attribute();
+        attribute->set_name(name);
+        for (auto value : values)
+            attribute->add_ints(value);
+    }
+
+    void AddONNXAttribute(onnx::NodeProto& node, const std::string& name, const std::vector<float>& values) {
+        auto* attribute = node.add_attribute();
+        attribute->set_name(name);
+        for (auto value : values)
+            attribute->add_floats(value);
+    }
+
+    void AddONNXAttribute(onnx::NodeProto& node, const std::string& name, const std::vector<std::string>& values) {
+        auto* attribute = node.add_attribute();
+        attribute->set_name(name);
+        for (auto& value : values)
+            attribute->add_strings(value);
+    }
+
+    // A single tree regressor whose root is a BRANCH_EQ node (feature 1 == 2). Its true child splits
+    // with BRANCH_LT on feature 0 and its false child is a BRANCH_NEQ node (feature 2 != 3).
+    void WriteCategoricalONNXModel(const std::string& modelPath) {
+        onnx::ModelProto model;
+        auto* node = model.mutable_graph()->add_node();
+        node->set_op_type("TreeEnsembleRegressor");
+        AddONNXAttribute(*node, "nodes_treeids", std::vector<int64_t>{ 0, 0, 0, 0, 0, 0, 0 });
+        AddONNXAttribute(*node, "nodes_nodeids", std::vector<int64_t>{ 0, 1, 2, 3, 4, 5, 6 });
+        AddONNXAttribute(*node, "nodes_featureids", std::vector<int64_t>{ 1, 0, 2, 0, 0, 0, 0 });
+        AddONNXAttribute(*node, "nodes_values", std::vector<float>{ 2, 0.5, 3, 0, 0, 0, 0 });
+        AddONNXAttribute(*node, "nodes_modes", std::vector<std::string>{ "BRANCH_EQ", "BRANCH_LT", "BRANCH_NEQ", "LEAF", "LEAF", "LEAF", "LEAF" });
+        AddONNXAttribute(*node, "nodes_truenodeids", std::vector<int64_t>{ 1, 3, 5, 0, 0, 0, 0 });
+        AddONNXAttribute(*node, "nodes_falsenodeids", std::vector<int64_t>{ 2, 4, 6, 0, 0, 0, 0 });
+        AddONNXAttribute(*node, "nodes_missing_value_tracks_true", std::vector<int64_t>{ 0, 0, 0, 0, 0, 0, 0 });
+        AddONNXAttribute(*node, "target_treeids", std::vector<int64_t>{ 0, 0, 0, 0 });
+        AddONNXAttribute(*node, "target_nodeids", std::vector<int64_t>{ 3, 4, 5, 6 });
+        AddONNXAttribute(*node, "target_ids", std::vector<int64_t>{ 0, 0, 0, 0 });
+        AddONNXAttribute(*node, "target_weights", std::vector<float>{ 1, 2, 3, 4 });
+        AddONNXAttribute(*node, "base_values", std::vector<float>{ 0.5 });
+        auto* postTransform = node->add_attribute();
+        postTransform->set_name("post_transform");
+        postTransform->set_s("NONE");
+        std::ofstream fout(modelPath, std::ios::binary);
+        model.SerializeToOstream(&fout);
+    }
+
+    // Missing values follow the true branch of every node
+    bool Test_ONNX_CategoricalBranches(TestArgs_t &args)
+    {
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        auto modelPath = (std::filesystem::temp_directory_path() / ("treebeard-categorical-" + std::to_string(getpid()) + ".onnx")).string();
+        auto modelGlobalsJSONPath = modelPath + ".treebeard-globals.json";
+        WriteCategoricalONNXModel(modelPath);
+
+        TreeBeard::CompilerOptions options;
+        options.tileSize = 1;
+        options.thresholdTypeWidth = 32;
+        options.featureIndexTypeWidth = 32;
+        options.inputElementTypeWidth = 32;
+        options.batchSize = 1;
+        options.returnTypeWidth = 32;
+        options.tilingType = TilingType::kUniform;
+        options.numberOfFeatures = 3;
+        std::unique_ptr<mlir::decisionforest::InferenceRunnerBase> inferenceRunner(
+            CreateInferenceRunnerForONNXModel<float>(modelPath.c_str(), modelGlobalsJSONPath.c_str(), &options));
+
+        std::vector<std::pair<std::vector<float>, float>> rowsAndPredictions = {
+            { {0.2, 2, 0}, 1.5 }, { {0.7, 2, 0}, 2.5 }, { {nan, 2, 0}, 1.5 },
+            { {0.2, 1, 3}, 4.5 }, { {0.2, 1, 5}, 3.5 }, { {0.2, -1, 3}, 4.5 }, { {0.2, 2.5, 7}, 3.5 },
+            { {0.2, nan, 3}, 1.5 }, { {0.2, 0, nan}, 3.5 }
+        };
+        for (auto& rowAndPrediction : rowsAndPredictions) {
+            float result = -1;
+            inferenceRunner->RunInference<float, float>(rowAndPrediction.first.data(), &result);
+            Test_ASSERT(FPEqual<float>(result, rowAndPrediction.second));
+        }
+        std::filesystem::remove(modelPath);
+        std::filesystem::remove(modelGlobalsJSONPath);
+        return true;
+    }
+
+    // Two stumps on features 0 (x0 <= 1) and 1 (x1 <= 2) whose predictions are averaged and added to the base value
+    void WriteAveragingONNXModel(const std::string& modelPath, const std::string& aggregateFunctionName = "AVERAGE") {
+        onnx::ModelProto model;
+        auto* node = model.mutable_graph()->add_node();
+        node->set_op_type("TreeEnsembleRegressor");
+        AddONNXAttribute(*node, "nodes_treeids", std::vector<int64_t>{ 0, 0, 0, 1, 1, 1 });
+        AddONNXAttribute(*node, "nodes_nodeids", std::vector<int64_t>{ 0, 1, 2, 0, 1, 2 });
+        AddONNXAttribute(*node, "nodes_featureids", std::vector<int64_t>{ 0, 0, 0, 1, 0, 0 });
+        AddONNXAttribute(*node, "nodes_values", std::vector<float>{ 1, 0, 0, 2, 0, 0 });
+        AddONNXAttribute(*node, "nodes_modes", std::vector<std::string>{ "BRANCH_LEQ", "LEAF", "LEAF", "BRANCH_LEQ", "LEAF", "LEAF" });
+        AddONNXAttribute(*node, "nodes_truenodeids", std::vector<int64_t>{ 1, 0, 0, 1, 0, 0 });
+        AddONNXAttribute(*node, "nodes_falsenodeids", std::vector<int64_t>{ 2, 0, 0, 2, 0, 0 });
+        AddONNXAttribute(*node, "nodes_missing_value_tracks_true", std::vector<int64_t>{ 0, 0, 0, 0, 0, 0 });
+        AddONNXAttribute(*node, "target_treeids", std::vector<int64_t>{ 0, 0, 1, 1 });
+        AddONNXAttribute(*node, "target_nodeids", std::vector<int64_t>{ 1, 2, 1, 2 });
+        AddONNXAttribute(*node, "target_ids", std::vector<int64_t>{ 0, 0, 0, 0 });
+        AddONNXAttribute(*node, "target_weights", std::vector<float>{ 1, 3, 2, -2 });
+        AddONNXAttribute(*node, "base_values", std::vector<float>{ 0.5 });
+        auto* postTransform = node->add_attribute();
+        postTransform->set_name("post_transform");
+        postTransform->set_s("NONE");
+        auto* aggregateFunction = node->add_attribute();
+        aggregateFunction->set_name("aggregate_function");
+        aggregateFunction->set_s(aggregateFunctionName);
+        std::ofstream fout(modelPath, std::ios::binary);
+        model.SerializeToOstream(&fout);
+    }
+
+    // The prediction is the average of the trees plus the base value (as ONNX Runtime computes it). Rows on a 
+    // threshold check that the BRANCH_LEQ mode of the model is used rather than the default BRANCH_LT.
+    bool Test_ONNX_AverageAggregation(TestArgs_t &args)
+    {
+        auto modelPath = (std::filesystem::temp_directory_path() / ("treebeard-average-" + std::to_string(getpid()) + ".onnx")).string();
+        auto modelGlobalsJSONPath = modelPath + ".treebeard-globals.json";
+        WriteAveragingONNXModel(modelPath);
+
+        for (int32_t tileSize : { 1, 2 }) {
+            TreeBeard::CompilerOptions options;
+            options.tileSize = tileSize;
+            options.thresholdTypeWidth = 32;
+            options.featureIndexTypeWidth = 32;
+            options.inputElementTypeWidth = 32;
+            options.batchSize = 1;
+            options.returnTypeWidth = 32;
+            options.tilingType = TilingType::kUniform;
+            options.numberOfFeatures = 2;
+            std::unique_ptr<mlir::decisionforest::InferenceRunnerBase> inferenceRunner(
+                CreateInferenceRunnerForONNXModel<float>(modelPath.c_str(), modelGlobalsJSONPath.c_str(), &options));
+
+            std::vector<std::pair<std::vector<float>, float>> rowsAndPredictions = {
+                { {1, 2}, 2.0 }, { {0, 0}, 2.0 }, { {2, 0}, 3.0 }, { {0, 3}, 0.0 }, { {1.5, 2.5}, 1.0 }, { {1, 2.5}, 0.0 }
+            };
+            for (auto& rowAndPrediction : rowsAndPredictions) {
+                float result = -1;
+                inferenceRunner->RunInference<float, float>(rowAndPrediction.first.data(), &result);
+                Test_ASSERT(FPEqual<float>(result, rowAndPrediction.second));
+            }
+        }
+
+        // Other aggregate functions (MIN, MAX) can't be expressed as a Treebeard reduction
+        WriteAveragingONNXModel(modelPath, "MAX");
+        bool rejected = false;
+        try {
+            TreeBeard::ONNXModelParseResult::parseModel(modelPath);
+        }
+        catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        Test_ASSERT(rejected);
+        std::filesystem::remove(modelPath);
+        std::filesystem::remove(modelGlobalsJSONPath);
+        return true;
+    }
 }
 }
@@ -0,0 +1,194 @@
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <type_traits>
+#include "Dialect.h"
+#include "TestUtilsCommon.h"
+
+#include "mlir/IR/MLIRContext.h"
+
+#include "sklearnparser.h"
+#include "ExecutionHelpers.h"
+#include "CompileUtils.h"
+#include "CompilationCache.h"
+#include "ModelSerializers.h"
+#include "Representations.h"
+using namespace mlir;
+using namespace mlir::decisionforest;
+
+namespace TreeBeard
+{
+namespace test
+{
+
+// ===--------------------------------------------------------=== //
+// scikit-learn Model Tests
+// ===--------------------------------------------------------=== //
+
+// Three regression trees that are averaged: x0 <= 1 ? 1 : 3, x1 <= 1 ? 2 : -2 and x0 <= 0.5 ? 0 : 6. The model
+// has no missing_go_to_left arrays (as older versions of scikit-learn write it) so NaN goes right.
+const std::string kAveragingRegressorJSON = R"({
+  "n_features" : 2, "n_classes" : 0, "reduction" : "average",
+  "trees" : [
+    { "children_left" : [1, -1, -1], "children_right" : [2, -1, -1], "feature" : [0, -2, -2],
+      "threshold" : [1.0, -2.0, -2.0], "value" : [0.0, 1.0, 3.0] },
+    { "children_left" : [1, -1, -1], "children_right" : [2, -1, -1], "feature" : [1, -2, -2],
+      "threshold" : [1.0, -2.0, -2.0], "value" : [0.0, 2.0, -2.0] },
+    { "children_left" : [1, -1, -1], "children_right" : [2, -1, -1], "feature" : [0, -2, -2],
+      "threshold" : [0.5, -2.0, -2.0], "value" : [0.0, 0.0, 6.0] }
+  ]
+})";
+
+// Three estimators that vote for one of three classes :
+//   x0 <= 0.5 ? 0 : (x1 <= 0.5 ? 1 : 2) (NaN goes left at the root), x1 <= 1.5 ? 0 : 2 and x0 <= 1.5 ? 1 : 2
+const std::string kVotingClassifierJSON = R"({
+  "n_features" : 2, "n_classes" : 3, "reduction" : "voting",
+  "trees" : [
+    { "class_id" : 0, "children_left" : [1, -1, 3, -1, -1], "children_right" : [2, -1, 4, -1, -1],
+      "feature" : [0, -2, 1, -2, -2], "threshold" : [0.5, -2.0, 0.5, -2.0, -2.0], "value" : [0.0, 0.0, 0.0, 1.0, 2.0],
+      "missing_go_to_left" : [1, 0, 0, 0, 0] },
+    { "class_id" : 0, "children_left" : [1, -1, -1], "children_right" : [2, -1, -1], "feature" : [1, -2, -2],
+      "threshold" : [1.5, -2.0, -2.0], "value" : [0.0, 0.0, 2.0], "missing_go_to_left" : [0, 0, 0] },
+    { "class_id" : 0, "children_left" : [1, -1, -1], "children_right" : [2, -1, -1], "feature" : [0, -2, -2],
+      "threshold" : [1.5, -2.0, -2.0], "value" : [0.0, 1.0, 2.0], "missing_go_to_left" : [0, 0, 0] }
+  ]
+})";
+
+template<typename ReturnType>
+std::vector<ReturnType> RunSKLearnModel(const std::string& modelJSON, std::vector<float>& inputs, int64_t numRows,
+                                        int64_t numOutputs, int32_t tileSize, bool returnAllOutputs) {
+  using FeatureIndexType = int16_t;
+  const int32_t batchSize = 4;
+  auto modelPath = GetTempFilePath() + ".json";
+  {
+    std::ofstream fout(modelPath);
+    fout << modelJSON;
+  }
+  bool returnIsFloat = std::is_floating_point<ReturnType>::value;
+  TreeBeard::CompilerOptions options(32, sizeof(ReturnType)*8, returnIsFloat, sizeof(FeatureIndexType)*8, 32, 32,
+                                     batchSize, tileSize, 16, 1, TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.returnAllOutputs = returnAllOutputs;
+  auto modelGlobalsJSONPath = TreeBeard::TemporaryModelGlobalsFilePath();
+  TreeBeard::TreebeardContext tbContext(modelPath, modelGlobalsJSONPath, options,
+                                        mlir::decisionforest::ConstructRepresentation(),
+                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath));
+  TreeBeard::SKLearnJSONParser<float, ReturnType, FeatureIndexType, int32_t, float> parser(tbContext.context, modelPath,
+                                                                                           tbContext.serializer, batchSize);
+  auto module = TreeBeard::ConstructLLVMDialectModuleFromForestCreator(tbContext, parser);
+  decisionforest::InferenceRunner inferenceRunner(tbContext.serializer, module, tileSize, 32, sizeof(FeatureIndexType)*8);
+  std::filesystem::remove(modelGlobalsJSONPath);
+  std::filesystem::remove(modelPath);
+
+  std::vector<ReturnType> results(numRows*numOutputs, -1);
+  inferenceRunner.RunInferenceOnMultipleBatches(inputs.data(), results.data(), numRows);
+  return results;
+}
+
+// The prediction is the mean of the trees (scikit-learn's RandomForestRegressor.predict)
+bool Test_SKLearnAveragingRegressor(TestArgs_t& args, int32_t tileSize) {
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  std::vector<float> inputs = { 0, 0,   1, 1,   2, 2,   0.5, 3,   nan, 0 };
+  std::vector<float> expectedResults = { 1.0f, 3.0f, 7.0f/3, -1.0f/3, 11.0f/3 };
+  int64_t numRows = expectedResults.size();
+  auto results = RunSKLearnModel<float>(kAveragingRegressorJSON, inputs, numRows, 1, tileSize, false);
+  for (int64_t i=0 ; i<numRows ; ++i)
+    Test_ASSERT(FPEqual<float>(results[i], expectedResults[i]));
+  return true;
+}
+
+bool Test_SKLearnAveragingRegressor_Scalar(TestArgs_t &args) {
+  return Test_SKLearnAveragingRegressor(args, 1);
+}
+
+bool Test_SKLearnAveragingRegressor_TileSize4(TestArgs_t &args) {
+  return Test_SKLearnAveragingRegressor(args, 4);
+}
+
+// All outputs are the fractions of the estimators that vote for each class. Otherwise, the class with the most
+// votes is returned (none of the rows are ties). Rows on a threshold check that they are sent left.
+bool Test_SKLearnVotingClassifier(TestArgs_t& args, int32_t tileSize) {
+  const int64_t numClasses = 3;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  std::vector<float> inputs = { 0, 0,   1, 0,   2, 2,   0.5, 0.5,   1, 2,   1.5, 0.5,   nan, 0 };
+  std::vector<std::vector<int32_t>> expectedVotes = { {2, 1, 0}, {1, 2, 0}, {0, 0, 3}, {2, 1, 0}, {0, 1, 2}, {1, 2, 0}, {2, 0, 1} };
+  std::vector<int8_t> expectedClasses = { 0, 1, 2, 0, 2, 1, 0 };
+  int64_t numRows = expectedClasses.size();
+
+  auto voteFractions = RunSKLearnModel<float>(kVotingClassifierJSON, inputs, numRows, numClasses, tileSize, true);
+  for (int64_t i=0 ; i<numRows ; ++i)
+    for (int64_t j=0 ; j<numClasses ; ++j)
+      Test_ASSERT(FPEqual<float>(voteFractions[i*numClasses + j], static_cast<float>(expectedVotes[i][j])/3.0f));
+
+  auto classes = RunSKLearnModel<int8_t>(kVotingClassifierJSON, inputs, numRows, 1, tileSize, false);
+  for (int64_t i=0 ; i<numRows ; ++i)
+    Test_ASSERT(classes[i] == expectedClasses[i]);
+  return true;
+}
+
+bool Test_SKLearnVotingClassifier_Scalar(TestArgs_t &args) {
+  return Test_SKLearnVotingClassifier(args, 1);
+}
+
+bool Test_SKLearnVotingClassifier_TileSize4(TestArgs_t &args) {
+  return Test_SKLearnVotingClassifier(args, 4);
+}
+
+bool SKLearnModelIsRejected(const std::string& modelJSON) {
+  auto modelPath = GetTempFilePath() + ".json";
+  {
+    std::ofstream fout(modelPath);
+    fout << modelJSON;
+  }
+  bool rejected = false;
+  try {
+    mlir::MLIRContext context;
+    TreeBeard::InitializeMLIRContext(context);
+    TreeBeard::SKLearnJSONParser<> parser(context, modelPath, decisionforest::ConstructModelSerializer(""), 4);
+    parser.ConstructForest();
+  }
+  catch (const std::runtime_error&) {
+    rejected = true;
+  }
+  std::filesystem::remove(modelPath);
+  return rejected;
+}
+
+std::string ReplaceInModel(std::string modelJSON, const std::string& from, const std::string& to) {
+  modelJSON.replace(modelJSON.find(from), from.size(), to);
+  return modelJSON;
+}
+
+// Malformed models must be rejected with an error rather than compiled incorrectly
+bool Test_SKLearnMalformedModelsAreRejected(TestArgs_t &args) {
+  // The valid models must be accepted, otherwise the checks below prove nothing
+  Test_ASSERT(!SKLearnModelIsRejected(kAveragingRegressorJSON));
+  Test_ASSERT(!SKLearnModelIsRejected(kVotingClassifierJSON));
+
+  Test_ASSERT(SKLearnModelIsRejected(ReplaceInModel(kAveragingRegressorJSON, "\"reduction\" : \"average\"",
+                                                    "\"reduction\" : \"voting\"")));
+  Test_ASSERT(SKLearnModelIsRejected(ReplaceInModel(kAveragingRegressorJSON, "\"reduction\" : \"average\"",
+                                                    "\"reduction\" : \"median\"")));
+  Test_ASSERT(SKLearnModelIsRejected(ReplaceInModel(kAveragingRegressorJSON, "\"value\" : [0.0, 1.0, 3.0]",
+                                                    "\"value\" : [0.0, 1.0]")));
+  Test_ASSERT(SKLearnModelIsRejected(ReplaceInModel(kVotingClassifierJSON, "\"missing_go_to_left\" : [0, 0, 0]",
+                                                    "\"missing_go_to_left\" : [0, 0]")));
+  Test_ASSERT(SKLearnModelIsRejected(R"({ "n_features" : 2, "n_classes" : 0, "reduction" : "average", "trees" : [
+    { "children_left" : [], "children_right" : [], "feature" : [], "threshold" : [], "value" : [] } ] })"));
+  auto missingModelPath = GetTempFilePath() + "-missing.json";
+  bool rejected = false;
+  try {
+    mlir::MLIRContext context;
+    TreeBeard::InitializeMLIRContext(context);
+    TreeBeard::SKLearnJSONParser<> parser(context, missingModelPath, decisionforest::ConstructModelSerializer(""), 4);
+  }
+  catch (const std::runtime_error&) {
+    rejected = true;
+  }
+  Test_ASSERT(rejected);
+  return true;
+}
+
+} // namespace test
+} // namespace TreeBeard
@@ -74,6 +74,52 @@ bool Test_XGBoostModel_StatGenerationAndReading(const std::string& modelJSON, co
   return true;
 }
 
+// The counts of the compiled model must match the interpreter's exactly (inputs and thresholds are doubles in both)
+bool Test_XGBoostModel_CompiledStatGeneration(const std::string& modelJSON, const std::string& inputCSV, const std::string& statsCSV) {
+  // A batch size that doesn't divide the number of rows so that the last batch is partial
+  TreeBeard::Profile::ComputeForestProbabilityProfileCompiled(modelJSON, inputCSV, statsCSV, -1, 37);
+
+  mlir::MLIRContext context;
+  TreeBeard::XGBoostJSONParser<> xgBoostParser(context, modelJSON, decisionforest::ConstructModelSerializer(""), 1);
+  xgBoostParser.ConstructForest();
+  auto decisionForest = xgBoostParser.GetForest();
+
+  TreeBeard::Profile::ReadProbabilityProfile(*decisionForest, statsCSV);
+
+  auto computedForest = ConstructForestAndRunInference(modelJSON, inputCSV, -1);
+  for (size_t i=0 ; i<decisionForest->NumTrees() ; ++i) {
+    auto& nodes1 = decisionForest->GetTree(i).GetNodes();
+    auto& nodes2 = computedForest.GetTree(i).GetNodes();
+    Test_ASSERT(nodes1.size() == nodes2.size());
+    for (size_t j=0 ; j<nodes1.size() ; ++j) {
+      if (nodes1.at(j).hitCount != nodes2.at(j).hitCount) {
+        std::cerr << "Tree : " << i << " Node : " << j << " " << nodes1.at(j).hitCount << " " << nodes2.at(j).hitCount << std::endl;
+        Test_ASSERT(false);
+      }
+      Test_ASSERT(nodes1.at(j).depth == nodes2.at(j).depth);
+    }
+  }
+  return true;
+}
+
+bool Test_AbaloneCompiledStatGeneration(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto testModelsDir = repoPath + "/xgb_models";
+  auto modelJSONPath = testModelsDir + "/abalone_xgb_model_save.json";
+  auto csvPath = modelJSONPath  + ".test.sampled.csv";
+  auto statsCSVPath = modelJSONPath  + ".test.sampled.compiled.stats.csv";
+  return Test_XGBoostModel_CompiledStatGeneration(modelJSONPath, csvPath, statsCSVPath);
+}
+
+bool Test_AirlineCompiledStatGeneration(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto testModelsDir = repoPath + "/xgb_models";
+  auto modelJSONPath = testModelsDir + "/airline_xgb_model_save.json";
+  auto csvPath = modelJSONPath  + ".test.sampled.csv";
+  auto statsCSVPath = modelJSONPath  + ".test.sampled.compiled.stats.csv";
+  return Test_XGBoostModel_CompiledStatGeneration(modelJSONPath, csvPath, statsCSVPath);
+}
+
 bool Test_AbaloneStatGenerationAndReading(TestArgs_t &args) {
   auto repoPath = GetTreeBeardRepoPath();
   auto testModelsDir = repoPath + "/xgb_models";
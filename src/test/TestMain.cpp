@@ -1,6 +1,13 @@
 #include <vector>
 #include <sstream>
 #include <chrono>
+#include <limits>
+#include <filesystem>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
 #include "TreeTilingUtils.h"
 #include "ExecutionHelpers.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
@@ -61,6 +68,10 @@ bool Test_TiledCodeGeneration_LeftHeavy_BatchSize1_Int8TileShape(TestArgs_t& arg
 bool Test_TiledCodeGeneration_RightHeavy_BatchSize1_Int16TileShape(TestArgs_t& args);
 bool Test_TiledCodeGeneration_LeftHeavy_BatchSize1_Int16TileShape(TestArgs_t& args);
 bool Test_TiledCodeGeneration_BalancedTree_BatchSize1(TestArgs_t& args);
+bool Test_TiledCodeGeneration_MissingValues_BatchSize1(TestArgs_t& args);
+bool Test_SparseTiledCodeGeneration_MissingValues_BatchSize1(TestArgs_t& args);
+bool Test_TiledCodeGeneration_CategoricalSplits_BatchSize1(TestArgs_t& args);
+bool Test_SparseTiledCodeGeneration_CategoricalSplits_BatchSize1(TestArgs_t& args);
 bool Test_TiledCodeGeneration_LeftAndRightHeavy_BatchSize1(TestArgs_t& args);
 bool Test_TiledCodeGeneration_LeftAndRightHeavy_BatchSize1_Int8TileSize(TestArgs_t& args);
 bool Test_TiledCodeGeneration_LeftAndRightHeavy_BatchSize1_Int16TileSize(TestArgs_t& args);
@@ -299,6 +310,65 @@ bool Test_TileSize8_Year_TestInputs(TestArgs_t &args);
 bool Test_TileSize8_CovType_TestInputs(TestArgs_t &args);
 bool Test_TileSize8_CovType_4Pipelined_TestInputs(TestArgs_t &args);
 
+// Dynamic batch tests
+bool Test_DynamicBatch_Abalone_TestInputs(TestArgs_t &args);
+bool Test_DynamicBatch_Airline_TestInputs(TestArgs_t &args);
+bool Test_DynamicBatch_CovType_TestInputs(TestArgs_t &args);
+bool Test_DynamicBatch_Higgs_TestInputs_TiledSchedule(TestArgs_t &args);
+
+// Strided input tests
+bool Test_CategoricalXGBoostModel(TestArgs_t &args);
+bool Test_CategoricalXGBoostModel_InvalidSplitTypes(TestArgs_t &args);
+bool Test_StridedInput_Abalone_TestInputs(TestArgs_t &args);
+bool Test_StridedInput_Airline_TestInputs_CacheInputSchedule(TestArgs_t &args);
+bool Test_ColumnMajorInput_Abalone_TestInputs(TestArgs_t &args);
+bool Test_ColumnMajorInput_CovType_TestInputs_DynamicBatch(TestArgs_t &args);
+
+// Early exit tests
+bool Test_EarlyExit_Airline_TestInputs(TestArgs_t &args);
+bool Test_EarlyExit_Higgs_TestInputs_Tile1(TestArgs_t &args);
+bool Test_EarlyExit_BoundaryRows_Float(TestArgs_t &args);
+bool Test_EarlyExit_BoundaryRows_Double_Tile4(TestArgs_t &args);
+bool Test_EarlyExit_InvalidOptionsAreRejected(TestArgs_t &args);
+bool Test_QuantizedInputs_Abalone_TestInputs(TestArgs_t &args);
+bool Test_QuantizedInputs_Airline_TestInputs_DoubleInputs(TestArgs_t &args);
+bool Test_AllOutputs_CovType_TestInputs(TestArgs_t &args);
+bool Test_AllOutputs_Letters_TestInputs_DynamicBatch(TestArgs_t &args);
+bool Test_MultiTarget_TestInputs_Float_Tile1(TestArgs_t &args);
+bool Test_MultiTarget_TestInputs_Double_Tile4_DynamicBatch(TestArgs_t &args);
+bool Test_MultiTarget_UnsupportedModelsAreRejected(TestArgs_t &args);
+bool Test_SingleOutputObjectives_Float_Scalar(TestArgs_t &args);
+bool Test_SingleOutputObjectives_Double_TileSize4(TestArgs_t &args);
+bool Test_SoftProbObjective_AllOutputs(TestArgs_t &args);
+bool Test_MultiModelManifest_Higgs_Abalone(TestArgs_t &args);
+bool Test_MultiModelManifest_InvalidManifestsAreRejected(TestArgs_t &args);
+
+// UBJSON model tests
+bool Test_UBJSONModel_Abalone(TestArgs_t &args);
+bool Test_UBJSONModel_Letters(TestArgs_t &args);
+bool Test_XGBoostUBJModel_Random4Tree(TestArgs_t &args);
+bool Test_XGBoostUBJModel_Categorical(TestArgs_t &args);
+bool Test_MalformedXGBoostModelsAreRejected(TestArgs_t &args);
+
+// Compilation cache tests
+bool Test_CompilationCache_Abalone(TestArgs_t &args);
+bool Test_CompilationCache_CovType(TestArgs_t &args);
+
+// Concurrent compilation tests
+bool Test_ConcurrentCompilation_Scalar(TestArgs_t &args);
+bool Test_ConcurrentCompilation_TileSize4(TestArgs_t &args);
+bool Test_SerialAndParallelCompilationMatch_Airline_Array_TileSize4(TestArgs_t &args);
+bool Test_SerialAndParallelCompilationMatch_Airline_Sparse_TileSize8(TestArgs_t &args);
+
+// Model hot swap tests
+bool Test_ModelHotSwap_Abalone(TestArgs_t &args);
+bool Test_FeatureGroupedTrees_Higgs_TileSize4(TestArgs_t &args);
+bool Test_FeatureGroupedTrees_GroupsByCacheLines(TestArgs_t &args);
+bool Test_LLVMCodeGenOptions_Airline_O2(TestArgs_t &args);
+bool Test_LLVMCodeGenOptions_Airline_O3_HostCPU(TestArgs_t &args);
+bool Test_LLVMCodeGenOptions_Airline_O3_GenericCPU(TestArgs_t &args);
+bool Test_LLVMCodeGenOptions_InvalidTargetsAreRejected(TestArgs_t &args);
+
 // Tiled schedule test
 bool Test_TileSize8_Abalone_TestInputs_TiledSchedule(TestArgs_t &args);
 bool Test_TileSize8_AirlineOHE_TestInputs_TiledSchedule(TestArgs_t &args);
@@ -347,6 +417,8 @@ bool Test_CovtypeStatGenerationAndReading(TestArgs_t &args);
 bool Test_EpsilonStatGenerationAndReading(TestArgs_t &args);
 bool Test_HiggsStatGenerationAndReading(TestArgs_t &args);
 bool Test_YearStatGenerationAndReading(TestArgs_t &args);
+bool Test_AbaloneCompiledStatGeneration(TestArgs_t &args);
+bool Test_AirlineCompiledStatGeneration(TestArgs_t &args);
 
 // Probability Based Tiling Tests
 bool Test_ProbabilisticTiling_TileSize8_Abalone(TestArgs_t &args);
@@ -409,6 +481,8 @@ bool Test_TileSize8_Year_TestInputs_ParallelBatch(TestArgs_t &args);
 
 // Peeling
 bool Test_WalkPeeling_BalancedTree_TileSize2(TestArgs_t& args);
+bool Test_HybridLayout_ArrayLevelChoice(TestArgs_t& args);
+bool Test_HybridLayout_DeepUnbalancedTree(TestArgs_t& args);
 bool Test_HybridTilingAndPeeling_RandomXGBoostJSONs_1Tree_FloatBatchSize4(TestArgs_t& args);
 bool Test_HybridTilingAndPeeling_RandomXGBoostJSONs_2Tree_FloatBatchSize4(TestArgs_t& args);
 bool Test_HybridTilingAndPeeling_RandomXGBoostJSONs_4Tree_FloatBatchSize4(TestArgs_t& args);
@@ -422,9 +496,26 @@ bool Test_PeeledHybridProbabilisticTiling_TileSize8_Letters(TestArgs_t &args);
 bool Test_PeeledHybridProbabilisticTiling_TileSize8_Epsilon(TestArgs_t &args);
 bool Test_PeeledHybridProbabilisticTiling_TileSize8_Higgs(TestArgs_t &args);
 bool Test_PeeledHybridProbabilisticTiling_TileSize8_Year(TestArgs_t &args);
+bool Test_OnlineRetiling_TileSize8_Abalone(TestArgs_t &args);
+bool Test_OnlineRetiling_DriftBelowThreshold_Abalone(TestArgs_t &args);
+bool Test_OnlineRetiling_FailedRetilingKeepsRunner_Abalone(TestArgs_t &args);
 
 // ONNXTests
 bool Test_ONNX_TileSize8_Abalone(TestArgs_t &args);
+bool Test_ONNX_CategoricalBranches(TestArgs_t &args);
+bool Test_ONNX_AverageAggregation(TestArgs_t &args);
+
+// LightGBM tests
+bool Test_LightGBMTextModel_Float_Scalar(TestArgs_t &args);
+bool Test_LightGBMTextModel_Double_TileSize4_Sparse(TestArgs_t &args);
+bool Test_LightGBMTextModel_UnsupportedModelsAreRejected(TestArgs_t &args);
+
+// scikit-learn tests
+bool Test_SKLearnAveragingRegressor_Scalar(TestArgs_t &args);
+bool Test_SKLearnAveragingRegressor_TileSize4(TestArgs_t &args);
+bool Test_SKLearnVotingClassifier_Scalar(TestArgs_t &args);
+bool Test_SKLearnVotingClassifier_TileSize4(TestArgs_t &args);
+bool Test_SKLearnMalformedModelsAreRejected(TestArgs_t &args);
 
 // GPU model initialization tests
 bool Test_GPUModelInit_LeftHeavy_Scalar_DoubleInt(TestArgs_t& args);
@@ -489,6 +580,8 @@ bool Test_SimpleSharedMem_LeftRightAndBalanced_Reorg(TestArgs_t& args);
 bool Test_GPUCodeGeneration_Covtype_ArrayRep_DoubleInt32_BatchSize32(TestArgs_t& args);
 bool Test_GPUCodeGeneration_Covtype_SparseRep_DoubleInt32_BatchSize32(TestArgs_t& args);
 bool Test_GPUCodeGeneration_Covtype_ReorgRep_DoubleInt32_BatchSize32(TestArgs_t& args);
+bool Test_GPUCodeGeneration_Covtype_ArrayRep_BinaryGlobals_BatchSize32(TestArgs_t& args);
+bool Test_GPUCodeGeneration_Covtype_SparseRep_BinaryGlobals_BatchSize32(TestArgs_t& args);
 
 bool Test_InputSharedMem_LeftRightAndBalanced(TestArgs_t& args);
 bool Test_InputSharedMem_LeftHeavy(TestArgs_t& args);
@@ -529,26 +622,27 @@ bool Test_BufferInit_RightHeavy(TestArgs_t& args) {
   auto forestType = mlir::decisionforest::TreeEnsembleType::get(thresholdType, 1, thresholdType /*HACK type doesn't matter for this test*/,
                                                                 mlir::decisionforest::ReductionType::kAdd, treeType);
   
-  mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath(GetGlobalJSONNameForTests());
-  decisionforest::ConstructModelSerializer(GetGlobalJSONNameForTests())->Persist(forest, forestType);
-  mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath(GetGlobalJSONNameForTests());
-  mlir::decisionforest::ForestJSONReader::GetInstance().ParseJSONFile();
+  auto serializer = decisionforest::ConstructModelSerializer(GetGlobalJSONNameForTests());
+  serializer->Persist(forest, forestType);
+  auto& forestJSONReader = serializer->GetForestJSONReader();
+  forestJSONReader.SetFilePath(GetGlobalJSONNameForTests());
+  forestJSONReader.ParseJSONFile();
 
   std::vector<TileType> serializedTree(std::pow(2, 3) - 1); //Depth of the tree is 3, so this is the size of the dense array
   // InitializeBuffer(void* bufPtr, int32_t tileSize, int32_t thresholdBitWidth, int32_t indexBitWidth, std::vector<int32_t>& treeOffsets)
   std::vector<int32_t> offsets(1, -1);
   int32_t thresholdSize = sizeof(ThresholdType)*8;
   int32_t indexSize = sizeof(IndexType)*8;
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeBuffer(serializedTree.data(), 1, thresholdSize, indexSize, offsets);
+  forestJSONReader.InitializeBuffer(serializedTree.data(), 1, thresholdSize, indexSize, offsets);
   Test_ASSERT(expectedArray == serializedTree);
   Test_ASSERT(offsets[0] == 0);
   
   std::vector<int64_t> offsetVec(1, -1);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeOffsetBuffer(offsetVec.data(), 1, thresholdSize, indexSize);
+  forestJSONReader.InitializeOffsetBuffer(offsetVec.data(), 1, thresholdSize, indexSize);
   Test_ASSERT(offsetVec[0] == 0);
   
   std::vector<int64_t> lengthVec(1, -1);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeLengthBuffer(lengthVec.data(), 1, thresholdSize, indexSize);
+  forestJSONReader.InitializeLengthBuffer(lengthVec.data(), 1, thresholdSize, indexSize);
   Test_ASSERT(lengthVec[0] == 7);
 
   return true;
@@ -600,28 +694,29 @@ bool Test_BufferInitialization_TwoTrees(TestArgs_t& args) {
   auto forestType = mlir::decisionforest::TreeEnsembleType::get(thresholdType, 1, thresholdType /*HACK type doesn't matter for this test*/,
                                                                 mlir::decisionforest::ReductionType::kAdd, treeType);
   
-  mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath(GetGlobalJSONNameForTests());
-  decisionforest::ConstructModelSerializer(GetGlobalJSONNameForTests())->Persist(forest, forestType);
-  mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath(GetGlobalJSONNameForTests());
-  mlir::decisionforest::ForestJSONReader::GetInstance().ParseJSONFile();
+  auto serializer = decisionforest::ConstructModelSerializer(GetGlobalJSONNameForTests());
+  serializer->Persist(forest, forestType);
+  auto& forestJSONReader = serializer->GetForestJSONReader();
+  forestJSONReader.SetFilePath(GetGlobalJSONNameForTests());
+  forestJSONReader.ParseJSONFile();
 
   std::vector<TileType> serializedTree(2*(std::pow(2, 3) - 1)); //Depth of the tree is 3, so this is the size of the dense array
   // InitializeBuffer(void* bufPtr, int32_t tileSize, int32_t thresholdBitWidth, int32_t indexBitWidth, std::vector<int32_t>& treeOffsets)
   int32_t thresholdSize = sizeof(ThresholdType)*8;
   int32_t indexSize = sizeof(IndexType)*8;
   std::vector<int32_t> offsets(2, -1);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeBuffer(serializedTree.data(), 1, thresholdSize, indexSize, offsets);
+  forestJSONReader.InitializeBuffer(serializedTree.data(), 1, thresholdSize, indexSize, offsets);
   Test_ASSERT(expectedArray == serializedTree);
   Test_ASSERT(offsets[0] == 0);
   Test_ASSERT(offsets[1] == 7);
 
   std::vector<int64_t> offsetVec(2, -1);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeOffsetBuffer(offsetVec.data(), 1, thresholdSize, indexSize);
+  forestJSONReader.InitializeOffsetBuffer(offsetVec.data(), 1, thresholdSize, indexSize);
   Test_ASSERT(offsetVec[0] == 0);
   Test_ASSERT(offsetVec[1] == 7);
 
   std::vector<int64_t> lengthVec(2, -1);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeLengthBuffer(lengthVec.data(), 1, thresholdSize, indexSize);
+  forestJSONReader.InitializeLengthBuffer(lengthVec.data(), 1, thresholdSize, indexSize);
   Test_ASSERT(lengthVec[0] == 7);
   Test_ASSERT(lengthVec[1] == 7);
 
@@ -646,25 +741,26 @@ bool Test_BufferInitializationWithOneTree_LeftHeavy(TestArgs_t& args) {
   auto forestType = mlir::decisionforest::TreeEnsembleType::get(doubleType, 1, doubleType /*HACK type doesn't matter for this test*/,
                                                                 mlir::decisionforest::ReductionType::kAdd, treeType);
   
-  mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath(GetGlobalJSONNameForTests());
-  decisionforest::ConstructModelSerializer(GetGlobalJSONNameForTests())->Persist(forest, forestType);
-  mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath(GetGlobalJSONNameForTests());
-  mlir::decisionforest::ForestJSONReader::GetInstance().ParseJSONFile();
+  auto serializer = decisionforest::ConstructModelSerializer(GetGlobalJSONNameForTests());
+  serializer->Persist(forest, forestType);
+  auto& forestJSONReader = serializer->GetForestJSONReader();
+  forestJSONReader.SetFilePath(GetGlobalJSONNameForTests());
+  forestJSONReader.ParseJSONFile();
   
   std::vector<DoubleInt32Tile> serializedTree(std::pow(2, 3) - 1); //Depth of the tree is 3, so this is the size of the dense array
 
   // InitializeBuffer(void* bufPtr, int32_t tileSize, int32_t thresholdBitWidth, int32_t indexBitWidth, std::vector<int32_t>& treeOffsets)
   std::vector<int32_t> offsets(1, -1);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeBuffer(serializedTree.data(), 1, 64, 32, offsets);
+  forestJSONReader.InitializeBuffer(serializedTree.data(), 1, 64, 32, offsets);
   Test_ASSERT(expectedArray == serializedTree);
   Test_ASSERT(offsets[0] == 0);
 
   std::vector<int64_t> offsetVec(1, -1);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeOffsetBuffer(offsetVec.data(), 1, 64, 32);
+  forestJSONReader.InitializeOffsetBuffer(offsetVec.data(), 1, 64, 32);
   Test_ASSERT(offsetVec[0] == 0);
 
   std::vector<int64_t> lengthVec(1, -1);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeLengthBuffer(lengthVec.data(), 1, 64, 32);
+  forestJSONReader.InitializeLengthBuffer(lengthVec.data(), 1, 64, 32);
   Test_ASSERT(lengthVec[0] == 7);
 
   return true;
@@ -839,6 +935,121 @@ bool Test_CodeGeneration_AddRightAndLeftHeavyTrees_BatchSize2(TestArgs_t& args)
   return Test_ForestCodeGen_VariableBatchSize(args, AddRightAndLeftHeavyTrees<DoubleInt32Tile>, 2, data);
 }
 
+// ===----------------------------------------=== //
+// Missing value code gen tests
+// ===----------------------------------------=== //
+
+std::vector<std::vector<double>> GetMissingValuesBatchSize1Data() {
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  auto data = GetBatchSize1Data();
+  data.push_back({0.1, 0.2, nan, 0.3, 0.25});
+  data.push_back({0.1, nan, nan, 0.3, 0.25});
+  data.push_back({0.1, 0.2, 0.6, 0.3, nan});
+  data.push_back({nan, nan, nan, nan, nan});
+  return data;
+}
+
+bool Test_CodeGeneration_MissingValues_BatchSize1(TestArgs_t& args) {
+  auto data = GetMissingValuesBatchSize1Data();
+  return Test_ForestCodeGen_BatchSize1(args, AddBalancedTreeWithDefaultDirections<DoubleInt32Tile>, data);
+}
+
+// Trees that don't set missing value directions send missing values where the default ULT predicate does
+bool Test_CodeGeneration_MissingValues_UnsetDirections_BatchSize1(TestArgs_t& args) {
+  {
+    auto serializer = decisionforest::ConstructModelSerializer(TreeBeard::test::GetGlobalJSONNameForTests());
+    MLIRContext context;
+    TreeBeard::InitializeMLIRContext(context);
+    FixedTreeIRConstructor<> irConstructor(context, serializer, 1, AddRightAndLeftHeavyTrees<DoubleInt32Tile>);
+    irConstructor.ConstructForest();
+    auto module = irConstructor.GetEvaluationFunction();
+    Test_ASSERT(irConstructor.GetForest().GetMissingValueRouting() == decisionforest::MissingValueRouting::kAllLeft);
+    bool foundPredictOp = false;
+    module.walk([&](decisionforest::PredictForestOp predictOp) {
+      foundPredictOp = predictOp.getPredicate() == arith::CmpFPredicate::ULT;
+    });
+    Test_ASSERT(foundPredictOp);
+  }
+  auto data = GetMissingValuesBatchSize1Data();
+  return Test_ForestCodeGen_BatchSize1(args, AddRightAndLeftHeavyTrees<DoubleInt32Tile>, data);
+}
+
+// A tree that splits on feature 127 and whose nodes disagree on the direction of missing values
+std::vector<DoubleInt32Tile> AddTreeWithWideFeatureIndexAndDefaultDirections(decisionforest::DecisionForest& forest) {
+  auto& tree = forest.NewTree();
+  auto root = tree.NewNode(0.5, 127);
+  auto left = tree.NewNode(0.3, 0);
+  tree.SetNodeParent(left, root);
+  tree.SetNodeLeftChild(root, left);
+  std::vector<int64_t> leaves = { tree.NewNode(0.1, -1), tree.NewNode(0.2, -1), tree.NewNode(0.8, -1) };
+  for (auto leaf : leaves)
+    tree.SetNodeParent(leaf, leaf == leaves[2] ? root : left);
+  tree.SetNodeLeftChild(left, leaves[0]);
+  tree.SetNodeRightChild(left, leaves[1]);
+  tree.SetNodeRightChild(root, leaves[2]);
+  tree.SetNodeDefaultLeft(root, true);
+  tree.SetNodeDefaultLeft(left, false);
+  return { {0.5, 127}, {0.3, 0}, {0.8, -1}, {0.1, -1}, {0.2, -1} };
+}
+
+// -(127 + 2) doesn't fit in an 8 bit feature index, so per node routing must be rejected
+bool Test_MissingValues_FeatureIndexEncodingOverflow(TestArgs_t& args) {
+  auto serializer = decisionforest::ConstructModelSerializer(TreeBeard::test::GetGlobalJSONNameForTests());
+  MLIRContext context;
+  TreeBeard::InitializeMLIRContext(context);
+  FixedTreeIRConstructor<double, double, int8_t> irConstructor(context, serializer, 1, AddTreeWithWideFeatureIndexAndDefaultDirections);
+  irConstructor.ConstructForest();
+  bool threw = false;
+  try {
+    irConstructor.GetEvaluationFunction();
+  }
+  catch (const std::runtime_error&) {
+    threw = true;
+  }
+  Test_ASSERT(threw);
+  return true;
+}
+
+bool Test_SparseCodeGeneration_MissingValues_BatchSize1_I32ChildIdx(TestArgs_t& args) {
+  decisionforest::UseSparseTreeRepresentation = true;
+  auto data = GetMissingValuesBatchSize1Data();
+  return Test_ForestCodeGen_BatchSize1(args, AddBalancedTreeWithDefaultDirections<DoubleInt32Tile>, data, 32);
+}
+
+// ===----------------------------------------=== //
+// Categorical split code gen tests
+// ===----------------------------------------=== //
+
+std::vector<std::vector<double>> GetCategoricalBatchSize1Data() {
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<std::vector<double>> data = {
+    {0.1, 1, 0.4, 0.3, 2},
+    {0.1, 33, 0.4, 0.3, 0},
+    {0.1, 70, 0.4, 0.3, 0},
+    {0.1, 2, 0.4, 0.3, 0},
+    {0.1, 71, 0.4, 0.3, 0},
+    {0.1, 1000, 0.6, 0.3, 3},
+    {0.1, -1, 0.6, 0.3, 1},
+    {0.1, 1, 0.6, 0.3, 2.5},
+    {0.1, 1, 0.6, 0.3, 96},
+    {0.1, 1, 0.6, 0.3, -2},
+    {0.1, nan, 0.4, 0.3, nan},
+    {0.1, 1, 0.6, 0.3, nan},
+  };
+  return data;
+}
+
+bool Test_CodeGeneration_CategoricalSplits_BatchSize1(TestArgs_t& args) {
+  auto data = GetCategoricalBatchSize1Data();
+  return Test_ForestCodeGen_BatchSize1(args, AddBalancedTreeWithCategoricalSplits<DoubleInt32Tile>, data);
+}
+
+bool Test_SparseCodeGeneration_CategoricalSplits_BatchSize1_I32ChildIdx(TestArgs_t& args) {
+  decisionforest::UseSparseTreeRepresentation = true;
+  auto data = GetCategoricalBatchSize1Data();
+  return Test_ForestCodeGen_BatchSize1(args, AddBalancedTreeWithCategoricalSplits<DoubleInt32Tile>, data, 32);
+}
+
 // ===----------------------------------------=== //
 // Basic non-trivial schedule code gen tests
 // ===----------------------------------------=== //
@@ -972,10 +1183,11 @@ bool Test_BufferInit_SingleTree_Tiled(TestArgs_t& args, ForestConstructor_t fore
   std::vector<Type> treeTypes = {treeType};
   auto forestType = mlir::decisionforest::TreeEnsembleType::get(thresholdType, 1, thresholdType /*HACK type doesn't matter for this test*/,
                                                                 mlir::decisionforest::ReductionType::kAdd, treeTypes);
-  mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath(GetGlobalJSONNameForTests());
-  decisionforest::ConstructModelSerializer(GetGlobalJSONNameForTests())->Persist(forest, forestType);
-  mlir::decisionforest::ForestJSONReader::GetInstance().SetFilePath(GetGlobalJSONNameForTests());
-  mlir::decisionforest::ForestJSONReader::GetInstance().ParseJSONFile();
+  auto serializer = decisionforest::ConstructModelSerializer(GetGlobalJSONNameForTests());
+  serializer->Persist(forest, forestType);
+  auto& forestJSONReader = serializer->GetForestJSONReader();
+  forestJSONReader.SetFilePath(GetGlobalJSONNameForTests());
+  forestJSONReader.ParseJSONFile();
 
   mlir::decisionforest::TiledTree tiledTree(forest.GetTree(0));
   auto numTiles = tiledTree.GetNumberOfTiles();
@@ -987,7 +1199,7 @@ bool Test_BufferInit_SingleTree_Tiled(TestArgs_t& args, ForestConstructor_t fore
   std::vector<int32_t> offsets(1, -1);
   int32_t thresholdSize = sizeof(ThresholdType)*8;
   int32_t indexSize = sizeof(IndexType)*8;
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeBuffer(serializedTree.data(), tileSize, thresholdSize, indexSize, offsets);
+  forestJSONReader.InitializeBuffer(serializedTree.data(), tileSize, thresholdSize, indexSize, offsets);
   for(int32_t i=0 ; i<numTiles ; ++i) {
     for (int32_t j=0 ; j<tileSize ; ++j) {
       Test_ASSERT(FPEqual(serializedTree[i].threshold[j], thresholds[i*tileSize + j]));
@@ -999,11 +1211,11 @@ bool Test_BufferInit_SingleTree_Tiled(TestArgs_t& args, ForestConstructor_t fore
   Test_ASSERT(offsets[0] == 0);
   
   std::vector<int64_t> offsetVec(1, -1);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeOffsetBuffer(offsetVec.data(), tileSize, thresholdSize, indexSize);
+  forestJSONReader.InitializeOffsetBuffer(offsetVec.data(), tileSize, thresholdSize, indexSize);
   Test_ASSERT(offsetVec[0] == 0);
   
   std::vector<int64_t> lengthVec(1, -1);
-  mlir::decisionforest::ForestJSONReader::GetInstance().InitializeLengthBuffer(lengthVec.data(), tileSize, thresholdSize, indexSize);
+  forestJSONReader.InitializeLengthBuffer(lengthVec.data(), tileSize, thresholdSize, indexSize);
   Test_ASSERT(lengthVec[0] == numTiles);
 
   return true;
@@ -1027,6 +1239,250 @@ bool Test_BufferInitializationWithOneTree_Balanced_Tiled(TestArgs_t& args) {
   return Test_BufferInit_SingleTree_Tiled<double, int32_t>(args, AddBalancedTree<TileType>, tileIDs);
 }
 
+// ===-------------------------------------------------------------=== //
+// Binary Model Globals Tests
+// ===-------------------------------------------------------------=== //
+
+void AddTreesToForestJSONReader(mlir::decisionforest::ForestJSONReader& reader, bool sparse, int32_t tileSize, int32_t thresholdSize, int32_t indexSize) {
+  reader.ClearAllData();
+  reader.SetNumberOfTrees(2);
+  reader.SetNumberOfClasses(2);
+  reader.SetInputElementBitWidth(64);
+  reader.SetReturnTypeBitWidth(64);
+  reader.SetRowSize(4);
+  reader.SetBatchSize(8);
+  reader.SetTileShapeBitWidth(16);
+  if (sparse)
+    reader.SetChildIndexBitWidth(32);
+
+  // Threshold values are exactly representable as floats so that both formats read back the same values
+  std::vector<double> thresholds0 = { 0.5, 1.25, -2.0, 3.5, 4.0, -0.75, 6.5, 7.0 }, thresholds1 = { 8.5, -9.25, 10.0, 11.5 };
+  std::vector<int32_t> featureIndices0 = { 0, 1, 2, 3, 3, 2, 1, 0 }, featureIndices1 = { 1, 1, 2, 2 };
+  std::vector<int32_t> tileShapeIDs0 = { 3, 1 }, tileShapeIDs1 = { 2 };
+  std::vector<int32_t> childIndices0 = { 1, -1 }, childIndices1 = { -1 };
+  std::vector<double> leaves0 = { 0.25, 0.5, 0.75, 1.0, 1.25 }, leaves1 = { -0.5, 0.125, 2.0, 4.0, 8.0 };
+  // Add the trees out of order so that tree offsets differ from the serialization order
+  if (sparse) {
+    reader.AddSingleSparseTree(1, 1, thresholds1, featureIndices1, tileShapeIDs1, childIndices1, leaves1, tileSize, thresholdSize, indexSize, 1);
+    reader.AddSingleSparseTree(0, 2, thresholds0, featureIndices0, tileShapeIDs0, childIndices0, leaves0, tileSize, thresholdSize, indexSize, 0);
+  }
+  else {
+    reader.AddSingleTree(1, 1, thresholds1, featureIndices1, tileShapeIDs1, tileSize, thresholdSize, indexSize, 1);
+    reader.AddSingleTree(0, 2, thresholds0, featureIndices0, tileShapeIDs0, tileSize, thresholdSize, indexSize, 0);
+  }
+}
+
+template<typename ThresholdType, typename IndexType>
+struct ModelGlobalsValues {
+  std::vector<ThresholdType> thresholds, leaves;
+  std::vector<IndexType> featureIndices;
+  std::vector<int16_t> tileShapeIDs;
+  std::vector<int32_t> childIndices;
+  std::vector<int64_t> offsets, lengths, leavesOffsets, leavesLengths;
+  std::vector<int8_t> classIDs;
+
+  bool operator==(const ModelGlobalsValues& that) const {
+    return thresholds==that.thresholds && leaves==that.leaves && featureIndices==that.featureIndices &&
+           tileShapeIDs==that.tileShapeIDs && childIndices==that.childIndices && offsets==that.offsets &&
+           lengths==that.lengths && leavesOffsets==that.leavesOffsets && leavesLengths==that.leavesLengths &&
+           classIDs==that.classIDs;
+  }
+};
+
+template<typename ThresholdType, typename IndexType>
+ModelGlobalsValues<ThresholdType, IndexType> ReadModelGlobalsValues(mlir::decisionforest::ForestJSONReader& reader, bool sparse, int32_t tileSize) {
+  int32_t thresholdSize = sizeof(ThresholdType)*8, indexSize = sizeof(IndexType)*8;
+  ModelGlobalsValues<ThresholdType, IndexType> values;
+  if (sparse) {
+    reader.GetModelValues(tileSize, thresholdSize, indexSize, values.thresholds, values.featureIndices, values.tileShapeIDs, values.childIndices);
+    values.leaves.resize(reader.GetTotalNumberOfLeaves());
+    reader.InitializeLeaves(values.leaves.data(), tileSize, thresholdSize, indexSize);
+    values.leavesOffsets.resize(reader.GetNumberOfTrees());
+    reader.InitializeLeavesOffsetBuffer(values.leavesOffsets.data(), tileSize, thresholdSize, indexSize);
+    values.leavesLengths.resize(reader.GetNumberOfTrees());
+    reader.InitializeLeavesLengthBuffer(values.leavesLengths.data(), tileSize, thresholdSize, indexSize);
+  }
+  else {
+    reader.GetModelValues(tileSize, thresholdSize, indexSize, values.thresholds, values.featureIndices, values.tileShapeIDs);
+  }
+  values.offsets.resize(reader.GetNumberOfTrees());
+  reader.InitializeOffsetBuffer(values.offsets.data(), tileSize, thresholdSize, indexSize);
+  values.lengths.resize(reader.GetNumberOfTrees());
+  reader.InitializeLengthBuffer(values.lengths.data(), tileSize, thresholdSize, indexSize);
+  values.classIDs.resize(reader.GetNumberOfTrees());
+  reader.InitializeClassInformation(values.classIDs.data(), tileSize, thresholdSize, indexSize);
+  return values;
+}
+
+template<typename T>
+bool MappedSectionEquals(mlir::decisionforest::MappedBinaryModelGlobals& mappedGlobals, const mlir::decisionforest::BinaryModelGlobalsEntry& entry,
+                         mlir::decisionforest::BinaryModelGlobalsSectionKind kind, const std::vector<T>& expectedValues) {
+  auto elements = mappedGlobals.GetSection<T>(entry, kind);
+  if (reinterpret_cast<uintptr_t>(elements) % mlir::decisionforest::BinaryModelGlobalsAlignment != 0)
+    return false;
+  auto numElements = mlir::decisionforest::MappedBinaryModelGlobals::GetNumberOfElements(entry, kind);
+  return std::vector<T>(elements, elements + numElements) == expectedValues;
+}
+
+template<typename ThresholdType, typename IndexType>
+bool Test_BinaryModelGlobals_RoundTrip(TestArgs_t& args, bool sparse) {
+  using namespace mlir::decisionforest;
+  const int32_t tileSize = 4;
+  int32_t thresholdSize = sizeof(ThresholdType)*8, indexSize = sizeof(IndexType)*8;
+  ForestJSONReader reader;
+  auto jsonFilePath = TreeBeard::test::GetTempFilePath() + ".json";
+  auto binaryFilePath = TreeBeard::test::GetTempFilePath() + BinaryModelGlobalsFileExtension;
+
+  AddTreesToForestJSONReader(reader, sparse, tileSize, thresholdSize, indexSize);
+  reader.SetFilePath(jsonFilePath);
+  reader.WriteJSONFile();
+  reader.SetFilePath(binaryFilePath);
+  reader.WriteJSONFile();
+  Test_ASSERT(!MappedBinaryModelGlobals::IsBinaryModelGlobalsFile(jsonFilePath));
+  Test_ASSERT(MappedBinaryModelGlobals::IsBinaryModelGlobalsFile(binaryFilePath));
+
+  reader.SetFilePath(jsonFilePath);
+  reader.ParseJSONFile();
+  Test_ASSERT(reader.GetMappedModelGlobals() == nullptr);
+  auto expectedValues = ReadModelGlobalsValues<ThresholdType, IndexType>(reader, sparse, tileSize);
+
+  // The binary file is detected from its contents, so the usual entry point reads it
+  reader.SetFilePath(binaryFilePath);
+  reader.ParseJSONFile();
+  auto mappedGlobals = reader.GetMappedModelGlobals();
+  Test_ASSERT(mappedGlobals != nullptr);
+  Test_ASSERT(reader.GetNumberOfTrees() == 2);
+  Test_ASSERT(reader.GetNumberOfClasses() == 2);
+  Test_ASSERT(reader.GetTileShapeBitWidth() == 16);
+  Test_ASSERT(reader.GetRowSize() == 4);
+  Test_ASSERT(reader.GetBatchSize() == 8);
+
+  // The buffers handed to the generated code must be usable straight from the mapping
+  auto entry = mappedGlobals->FindEntry(tileSize, thresholdSize, indexSize);
+  Test_ASSERT(entry != nullptr);
+  Test_ASSERT(MappedSectionEquals(*mappedGlobals, *entry, BinaryModelGlobalsSectionKind::kThresholds, expectedValues.thresholds));
+  Test_ASSERT(MappedSectionEquals(*mappedGlobals, *entry, BinaryModelGlobalsSectionKind::kFeatureIndices, expectedValues.featureIndices));
+  Test_ASSERT(MappedSectionEquals(*mappedGlobals, *entry, BinaryModelGlobalsSectionKind::kTileShapeIDs, expectedValues.tileShapeIDs));
+  Test_ASSERT(MappedSectionEquals(*mappedGlobals, *entry, BinaryModelGlobalsSectionKind::kTreeOffsets, expectedValues.offsets));
+  Test_ASSERT(MappedSectionEquals(*mappedGlobals, *entry, BinaryModelGlobalsSectionKind::kTreeLengths, expectedValues.lengths));
+  Test_ASSERT(MappedSectionEquals(*mappedGlobals, *entry, BinaryModelGlobalsSectionKind::kClassIDs, expectedValues.classIDs));
+  if (sparse) {
+    Test_ASSERT(MappedSectionEquals(*mappedGlobals, *entry, BinaryModelGlobalsSectionKind::kChildIndices, expectedValues.childIndices));
+    Test_ASSERT(MappedSectionEquals(*mappedGlobals, *entry, BinaryModelGlobalsSectionKind::kLeaves, expectedValues.leaves));
+    Test_ASSERT(MappedSectionEquals(*mappedGlobals, *entry, BinaryModelGlobalsSectionKind::kLeavesOffsets, expectedValues.leavesOffsets));
+    Test_ASSERT(MappedSectionEquals(*mappedGlobals, *entry, BinaryModelGlobalsSectionKind::kLeavesLengths, expectedValues.leavesLengths));
+  }
+
+  // Routines that need the per tree values materialize them from the mapping
+  auto binaryValues = ReadModelGlobalsValues<ThresholdType, IndexType>(reader, sparse, tileSize);
+  Test_ASSERT(binaryValues == expectedValues);
+
+  reader.ClearAllData();
+  std::filesystem::remove(jsonFilePath);
+  std::filesystem::remove(binaryFilePath);
+  return true;
+}
+
+bool Test_BinaryModelGlobals_Array_DoubleInt32(TestArgs_t& args) {
+  return Test_BinaryModelGlobals_RoundTrip<double, int32_t>(args, false);
+}
+
+bool Test_BinaryModelGlobals_Array_FloatInt16(TestArgs_t& args) {
+  return Test_BinaryModelGlobals_RoundTrip<float, int16_t>(args, false);
+}
+
+bool Test_BinaryModelGlobals_Sparse_DoubleInt32(TestArgs_t& args) {
+  return Test_BinaryModelGlobals_RoundTrip<double, int32_t>(args, true);
+}
+
+bool Test_BinaryModelGlobals_Sparse_FloatInt8(TestArgs_t& args) {
+  return Test_BinaryModelGlobals_RoundTrip<float, int8_t>(args, true);
+}
+
+bool MappingModelGlobalsFails(const std::string& filename) {
+  try {
+    mlir::decisionforest::MappedBinaryModelGlobals mappedGlobals(filename);
+  }
+  catch (const std::runtime_error&) {
+    return true;
+  }
+  return false;
+}
+
+bool Test_BinaryModelGlobals_InvalidFiles(TestArgs_t& args) {
+  using namespace mlir::decisionforest;
+  ForestJSONReader reader;
+  auto binaryFilePath = TreeBeard::test::GetTempFilePath() + BinaryModelGlobalsFileExtension;
+  AddTreesToForestJSONReader(reader, false, 4, 32, 16);
+  reader.SetFilePath(binaryFilePath);
+  reader.WriteJSONFile();
+  reader.ClearAllData();
+  Test_ASSERT(!MappingModelGlobalsFails(binaryFilePath));
+  Test_ASSERT(MappingModelGlobalsFails(binaryFilePath + ".missing"));
+
+  std::ifstream fin(binaryFilePath, std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+  fin.close();
+  auto writeFile = [&](const std::string& fileContents) {
+    std::ofstream fout(binaryFilePath, std::ios::binary | std::ios::trunc);
+    fout.write(fileContents.data(), fileContents.size());
+  };
+
+  // Truncated
+  writeFile(contents.substr(0, contents.size() - BinaryModelGlobalsAlignment));
+  Test_ASSERT(MappingModelGlobalsFails(binaryFilePath));
+  // Smaller than the header
+  writeFile(contents.substr(0, sizeof(BinaryModelGlobalsHeader) - 1));
+  Test_ASSERT(MappingModelGlobalsFails(binaryFilePath));
+  // Wrong magic number
+  auto badMagic = contents;
+  badMagic[0] = 'X';
+  writeFile(badMagic);
+  Test_ASSERT(MappingModelGlobalsFails(binaryFilePath));
+  // Wrong version
+  auto badVersion = contents;
+  auto version = BinaryModelGlobalsVersion + 1;
+  std::memcpy(&badVersion[offsetof(BinaryModelGlobalsHeader, version)], &version, sizeof(version));
+  writeFile(badVersion);
+  Test_ASSERT(MappingModelGlobalsFails(binaryFilePath));
+  // A section that runs past the end of the file
+  auto badSection = contents;
+  auto sectionOffset = sizeof(BinaryModelGlobalsHeader) + offsetof(BinaryModelGlobalsEntry, sections) + 
+                       offsetof(BinaryModelGlobalsSection, numberOfElements);
+  uint64_t numberOfElements = contents.size();
+  std::memcpy(&badSection[sectionOffset], &numberOfElements, sizeof(numberOfElements));
+  writeFile(badSection);
+  Test_ASSERT(MappingModelGlobalsFails(binaryFilePath));
+
+  std::filesystem::remove(binaryFilePath);
+  return true;
+}
+
+// ===-------------------------------------------------------------=== //
+// Compiler Thread Pool Tests
+// ===-------------------------------------------------------------=== //
+
+// Per tree compilation stages may run inside loops that are already parallel (for example,
+// a tiled tree constructed while serializing). Nested loops must run every iteration exactly once.
+bool Test_CompilerThreadPool_NestedParallelFor(TestArgs_t& args) {
+  const int64_t numOuterIterations = 37, numInnerIterations = 11;
+  std::vector<std::atomic<int32_t>> visitCounts(numOuterIterations*numInnerIterations);
+  for (auto& count : visitCounts)
+    count = 0;
+  auto& threadPool = TreeBeard::GetCompilerThreadPool();
+  threadPool.ParallelFor(numOuterIterations, [&](int64_t outerBegin, int64_t outerEnd) {
+    for (int64_t i=outerBegin ; i<outerEnd ; ++i) {
+      threadPool.ParallelFor(numInnerIterations, [&](int64_t innerBegin, int64_t innerEnd) {
+        for (int64_t j=innerBegin ; j<innerEnd ; ++j)
+          ++visitCounts[i*numInnerIterations + j];
+      });
+    }
+  });
+  for (auto& count : visitCounts)
+    Test_ASSERT(count == 1);
+  return true;
+}
+
 // ===-------------------------------------------------------------=== //
 // Tiled Tree Tests
 // ===-------------------------------------------------------------=== //
@@ -1117,6 +1573,16 @@ bool Test_SplitSchedule(TestArgs_t& args) {
 #ifdef RUN_ALL_TESTS
 TestDescriptor testList[] = {
   TEST_LIST_ENTRY(Test_ONNX_TileSize8_Abalone),
+  TEST_LIST_ENTRY(Test_ONNX_CategoricalBranches),
+  TEST_LIST_ENTRY(Test_ONNX_AverageAggregation),
+  TEST_LIST_ENTRY(Test_LightGBMTextModel_Float_Scalar),
+  TEST_LIST_ENTRY(Test_LightGBMTextModel_Double_TileSize4_Sparse),
+  TEST_LIST_ENTRY(Test_LightGBMTextModel_UnsupportedModelsAreRejected),
+  TEST_LIST_ENTRY(Test_SKLearnAveragingRegressor_Scalar),
+  TEST_LIST_ENTRY(Test_SKLearnAveragingRegressor_TileSize4),
+  TEST_LIST_ENTRY(Test_SKLearnVotingClassifier_Scalar),
+  TEST_LIST_ENTRY(Test_SKLearnVotingClassifier_TileSize4),
+  TEST_LIST_ENTRY(Test_SKLearnMalformedModelsAreRejected),
   
   // [Ashwin] These tests are exercising a part of the code that 
   // we intend to remove. Commenting them out to allow assertions 
@@ -1141,6 +1607,10 @@ TestDescriptor testList[] = {
   TEST_LIST_ENTRY(Test_CodeGeneration_LeftHeavy_BatchSize2),
   TEST_LIST_ENTRY(Test_CodeGeneration_RightHeavy_BatchSize2),
   TEST_LIST_ENTRY(Test_CodeGeneration_AddRightAndLeftHeavyTrees_BatchSize2),
+  TEST_LIST_ENTRY(Test_CodeGeneration_MissingValues_BatchSize1),
+  TEST_LIST_ENTRY(Test_CodeGeneration_MissingValues_UnsetDirections_BatchSize1),
+  TEST_LIST_ENTRY(Test_MissingValues_FeatureIndexEncodingOverflow),
+  TEST_LIST_ENTRY(Test_CodeGeneration_CategoricalSplits_BatchSize1),
   TEST_LIST_ENTRY(Test_LoadTileFeatureIndicesOp_DoubleInt32_TileSize1),
   TEST_LIST_ENTRY(Test_LoadTileThresholdOp_DoubleInt32_TileSize1),
   TEST_LIST_ENTRY(Test_LoadTileThresholdOp_Subview_DoubleInt32_TileSize1),
@@ -1172,6 +1642,8 @@ TestDescriptor testList[] = {
   TEST_LIST_ENTRY(Test_TiledCodeGeneration_LeftHeavy_BatchSize1),
   TEST_LIST_ENTRY(Test_TiledCodeGeneration_RightHeavy_BatchSize1),
   TEST_LIST_ENTRY(Test_TiledCodeGeneration_BalancedTree_BatchSize1),
+  TEST_LIST_ENTRY(Test_TiledCodeGeneration_MissingValues_BatchSize1),
+  TEST_LIST_ENTRY(Test_TiledCodeGeneration_CategoricalSplits_BatchSize1),
   TEST_LIST_ENTRY(Test_TiledCodeGeneration_LeftAndRightHeavy_BatchSize1),
   TEST_LIST_ENTRY(Test_TiledCodeGeneration_RightHeavy_BatchSize1_Int8TileShape),
   TEST_LIST_ENTRY(Test_TiledCodeGeneration_LeftHeavy_BatchSize1_Int8TileShape),
@@ -1272,6 +1744,8 @@ TestDescriptor testList[] = {
   TEST_LIST_ENTRY(Test_SparseCodeGeneration_LeftHeavy_BatchSize1_I32ChildIdx),
   TEST_LIST_ENTRY(Test_SparseCodeGeneration_RightHeavy_BatchSize1_I32ChildIdx),
   TEST_LIST_ENTRY(Test_SparseCodeGeneration_RightAndLeftHeavy_BatchSize1_I32ChildIdx),
+  TEST_LIST_ENTRY(Test_SparseCodeGeneration_MissingValues_BatchSize1_I32ChildIdx),
+  TEST_LIST_ENTRY(Test_SparseCodeGeneration_CategoricalSplits_BatchSize1_I32ChildIdx),
   TEST_LIST_ENTRY(Test_SparseCodeGeneration_LeftHeavy_BatchSize2_I32ChildIdx),
   TEST_LIST_ENTRY(Test_SparseCodeGeneration_RightHeavy_BatchSize2_I32ChildIdx),
   TEST_LIST_ENTRY(Test_SparseCodeGeneration_RightAndLeftHeavy_BatchSize2_I32ChildIdx),
@@ -1302,6 +1776,8 @@ TestDescriptor testList[] = {
   TEST_LIST_ENTRY(Test_SparseTiledCodeGeneration_RightHeavy_BatchSize1),
   TEST_LIST_ENTRY(Test_SparseTiledCodeGeneration_RightHeavy_BatchSize1_Int16TileShape),
   TEST_LIST_ENTRY(Test_SparseTiledCodeGeneration_RightHeavy_BatchSize1_Int8TileShape),
+  TEST_LIST_ENTRY(Test_SparseTiledCodeGeneration_MissingValues_BatchSize1),
+  TEST_LIST_ENTRY(Test_SparseTiledCodeGeneration_CategoricalSplits_BatchSize1),
   TEST_LIST_ENTRY(Test_SparseUniformTiling_RandomXGBoostJSONs_2Trees_BatchSize4),
   TEST_LIST_ENTRY(Test_SparseUniformTiling_RandomXGBoostJSONs_4Trees_BatchSize4),
   // XGBoost Benchmarks Sparse Tests
@@ -1442,6 +1918,8 @@ TestDescriptor testList[] = {
   TEST_LIST_ENTRY(Test_EpsilonStatGenerationAndReading),
   TEST_LIST_ENTRY(Test_HiggsStatGenerationAndReading),
   TEST_LIST_ENTRY(Test_YearStatGenerationAndReading),
+  TEST_LIST_ENTRY(Test_AbaloneCompiledStatGeneration),
+  TEST_LIST_ENTRY(Test_AirlineCompiledStatGeneration),
 
   // Sparse Probabilistic Tiling Tests
   TEST_LIST_ENTRY(Test_SparseProbabilisticTiling_TileSize8_Abalone),
@@ -1503,6 +1981,78 @@ TestDescriptor testList[] = {
   TEST_LIST_ENTRY(Test_SparseTileSize8_4Pipelined_Bosch),
   TEST_LIST_ENTRY(Test_TileSize8_Abalone_4Pipelined_TestInputs),
   TEST_LIST_ENTRY(Test_TileSize8_CovType_4Pipelined_TestInputs),
+
+  // Dynamic batch tests
+  TEST_LIST_ENTRY(Test_DynamicBatch_Abalone_TestInputs),
+  TEST_LIST_ENTRY(Test_DynamicBatch_Airline_TestInputs),
+  TEST_LIST_ENTRY(Test_DynamicBatch_CovType_TestInputs),
+  TEST_LIST_ENTRY(Test_DynamicBatch_Higgs_TestInputs_TiledSchedule),
+  TEST_LIST_ENTRY(Test_CategoricalXGBoostModel),
+  TEST_LIST_ENTRY(Test_CategoricalXGBoostModel_InvalidSplitTypes),
+  TEST_LIST_ENTRY(Test_StridedInput_Abalone_TestInputs),
+  TEST_LIST_ENTRY(Test_StridedInput_Airline_TestInputs_CacheInputSchedule),
+  TEST_LIST_ENTRY(Test_ColumnMajorInput_Abalone_TestInputs),
+  TEST_LIST_ENTRY(Test_ColumnMajorInput_CovType_TestInputs_DynamicBatch),
+
+  // Early exit tests
+  TEST_LIST_ENTRY(Test_EarlyExit_Airline_TestInputs),
+  TEST_LIST_ENTRY(Test_EarlyExit_Higgs_TestInputs_Tile1),
+  TEST_LIST_ENTRY(Test_EarlyExit_BoundaryRows_Float),
+  TEST_LIST_ENTRY(Test_EarlyExit_BoundaryRows_Double_Tile4),
+  TEST_LIST_ENTRY(Test_EarlyExit_InvalidOptionsAreRejected),
+
+  // Quantized input tests
+  TEST_LIST_ENTRY(Test_QuantizedInputs_Abalone_TestInputs),
+  TEST_LIST_ENTRY(Test_QuantizedInputs_Airline_TestInputs_DoubleInputs),
+
+  // All outputs tests
+  TEST_LIST_ENTRY(Test_AllOutputs_CovType_TestInputs),
+  TEST_LIST_ENTRY(Test_AllOutputs_Letters_TestInputs_DynamicBatch),
+  TEST_LIST_ENTRY(Test_MultiTarget_TestInputs_Float_Tile1),
+  TEST_LIST_ENTRY(Test_MultiTarget_TestInputs_Double_Tile4_DynamicBatch),
+  TEST_LIST_ENTRY(Test_MultiTarget_UnsupportedModelsAreRejected),
+
+  // Objective tests
+  TEST_LIST_ENTRY(Test_SingleOutputObjectives_Float_Scalar),
+  TEST_LIST_ENTRY(Test_SingleOutputObjectives_Double_TileSize4),
+  TEST_LIST_ENTRY(Test_SoftProbObjective_AllOutputs),
+  TEST_LIST_ENTRY(Test_MultiModelManifest_Higgs_Abalone),
+  TEST_LIST_ENTRY(Test_MultiModelManifest_InvalidManifestsAreRejected),
+
+  // UBJSON model tests
+  TEST_LIST_ENTRY(Test_UBJSONModel_Abalone),
+  TEST_LIST_ENTRY(Test_UBJSONModel_Letters),
+  TEST_LIST_ENTRY(Test_XGBoostUBJModel_Random4Tree),
+  TEST_LIST_ENTRY(Test_XGBoostUBJModel_Categorical),
+  TEST_LIST_ENTRY(Test_MalformedXGBoostModelsAreRejected),
+
+  // Compilation cache tests
+  TEST_LIST_ENTRY(Test_CompilationCache_Abalone),
+  TEST_LIST_ENTRY(Test_CompilationCache_CovType),
+
+  // Concurrent compilation tests
+  TEST_LIST_ENTRY(Test_ConcurrentCompilation_Scalar),
+  TEST_LIST_ENTRY(Test_ConcurrentCompilation_TileSize4),
+  TEST_LIST_ENTRY(Test_SerialAndParallelCompilationMatch_Airline_Array_TileSize4),
+  TEST_LIST_ENTRY(Test_SerialAndParallelCompilationMatch_Airline_Sparse_TileSize8),
+  TEST_LIST_ENTRY(Test_ModelHotSwap_Abalone),
+  TEST_LIST_ENTRY(Test_FeatureGroupedTrees_Higgs_TileSize4),
+  TEST_LIST_ENTRY(Test_FeatureGroupedTrees_GroupsByCacheLines),
+  TEST_LIST_ENTRY(Test_LLVMCodeGenOptions_Airline_O2),
+  TEST_LIST_ENTRY(Test_LLVMCodeGenOptions_Airline_O3_HostCPU),
+  TEST_LIST_ENTRY(Test_LLVMCodeGenOptions_Airline_O3_GenericCPU),
+  TEST_LIST_ENTRY(Test_LLVMCodeGenOptions_InvalidTargetsAreRejected),
+
+  // Binary model globals tests
+  TEST_LIST_ENTRY(Test_BinaryModelGlobals_Array_DoubleInt32),
+  TEST_LIST_ENTRY(Test_BinaryModelGlobals_Array_FloatInt16),
+  TEST_LIST_ENTRY(Test_BinaryModelGlobals_Sparse_DoubleInt32),
+  TEST_LIST_ENTRY(Test_BinaryModelGlobals_Sparse_FloatInt8),
+  TEST_LIST_ENTRY(Test_BinaryModelGlobals_InvalidFiles),
+
+  // Compiler thread pool tests
+  TEST_LIST_ENTRY(Test_CompilerThreadPool_NestedParallelFor),
+
   TEST_LIST_ENTRY(Test_SparseTileSize8_Pipeline4_Airline),
   TEST_LIST_ENTRY(Test_SparseTileSize8_Pipelined4_AirlineOHE),
   TEST_LIST_ENTRY(Test_SparseTileSize8_Pipelined_Year),
@@ -1511,6 +2061,8 @@ TestDescriptor testList[] = {
 
   // Hybrid Tiling
   TEST_LIST_ENTRY(Test_WalkPeeling_BalancedTree_TileSize2),
+  TEST_LIST_ENTRY(Test_HybridLayout_ArrayLevelChoice),
+  TEST_LIST_ENTRY(Test_HybridLayout_DeepUnbalancedTree),
   TEST_LIST_ENTRY(Test_HybridTilingAndPeeling_RandomXGBoostJSONs_4Tree_FloatBatchSize4),
   TEST_LIST_ENTRY(Test_HybridTilingAndPeeling_RandomXGBoostJSONs_1Tree_FloatBatchSize4),
   TEST_LIST_ENTRY(Test_HybridTilingAndPeeling_RandomXGBoostJSONs_2Tree_FloatBatchSize4),
@@ -1524,6 +2076,9 @@ TestDescriptor testList[] = {
   TEST_LIST_ENTRY(Test_PeeledHybridProbabilisticTiling_TileSize8_Covtype),
   TEST_LIST_ENTRY(Test_PeeledHybridProbabilisticTiling_TileSize8_Airline),
   TEST_LIST_ENTRY(Test_PeeledHybridProbabilisticTiling_TileSize8_Abalone),
+  TEST_LIST_ENTRY(Test_OnlineRetiling_TileSize8_Abalone),
+  TEST_LIST_ENTRY(Test_OnlineRetiling_DriftBelowThreshold_Abalone),
+  TEST_LIST_ENTRY(Test_OnlineRetiling_FailedRetilingKeepsRunner_Abalone),
 
 #ifdef TREEBEARD_GPU_SUPPORT
   // GPU model buffer initialization tests (scalar)
@@ -1596,6 +2151,8 @@ TestDescriptor testList[] = {
   TEST_LIST_ENTRY(Test_GPUCodeGeneration_Covtype_ArrayRep_DoubleInt32_BatchSize32),
   TEST_LIST_ENTRY(Test_GPUCodeGeneration_Covtype_SparseRep_DoubleInt32_BatchSize32),
   // TEST_LIST_ENTRY(Test_GPUCodeGeneration_Covtype_ReorgRep_DoubleInt32_BatchSize32), - Currently not supported
+  TEST_LIST_ENTRY(Test_GPUCodeGeneration_Covtype_ArrayRep_BinaryGlobals_BatchSize32),
+  TEST_LIST_ENTRY(Test_GPUCodeGeneration_Covtype_SparseRep_BinaryGlobals_BatchSize32),
 
   // Simple GPU Tiling tests
   TEST_LIST_ENTRY(Test_TiledSparseGPU_LeftHeavy_DblI32_B32_TSz2),
@@ -1836,7 +2393,6 @@ void RunTestsImpl(TestDescriptor *testsToRun, size_t numberOfTests) {
     
     // Disable sparse code generation by default
     decisionforest::UseSparseTreeRepresentation = false;
-    mlir::decisionforest::ForestJSONReader::GetInstance().SetChildIndexBitWidth(-1);
     
     bool pass = RunTest(testsToRun[i], args, i+1);
     numPassed += pass ? 1 : 0;
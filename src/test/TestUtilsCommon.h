@@ -142,6 +142,8 @@ void RunTests();
 void RunSanityTests();
 void RunXGBoostBenchmarks();
 void RunXGBoostParallelBenchmarks();
+void RunXGBoostOptimizationLevelBenchmarks();
+void RunXGBoostFeatureLocalityBenchmarks();
 
 // ===---------------------------------------------=== //
 // Configuration for tests
@@ -19,6 +19,7 @@
 #include "llvm/ADT/STLExtras.h"
 
 #include "CompileUtils.h"
+#include "CompilationCache.h"
 #include "ExecutionHelpers.h"
 #include "TreeTilingDescriptor.h"
 #include "TreeTilingUtils.h"
@@ -60,7 +61,7 @@ double Test_CodeGenForJSON_ProbabilityBasedTiling(int64_t batchSize, const std::
                                               int32_t tileSize, int32_t tileShapeBitWidth, 
                                               int32_t childIndexBitWidth, mlir::decisionforest::ScheduleManipulator *scheduleManipulator, 
                                               bool probTiling, int32_t numberOfCores,
-                                              int32_t pipelineSize) {
+                                              int32_t pipelineSize, int32_t optLevel=0) {
   // TODO consider changing this so that you use the smallest possible type possible (need to make it a parameter)
   using FeatureIndexType = int16_t;
   using NodeIndexType = int16_t;
@@ -79,6 +80,7 @@ double Test_CodeGenForJSON_ProbabilityBasedTiling(int64_t batchSize, const std::
 
   if (numberOfCores != -1)
     options.numberOfCores = numberOfCores;
+  options.optimizationLevel = optLevel;
   auto modelGlobalsJSONFilePath = TreeBeard::ForestCreator::ModelGlobalJSONFilePathFromJSONFilePath(modelJsonPath);
   
   TreeBeard::TreebeardContext tbContext(modelJsonPath, modelGlobalsJSONFilePath, options, 
@@ -87,7 +89,8 @@ double Test_CodeGenForJSON_ProbabilityBasedTiling(int64_t batchSize, const std::
                                         nullptr  /*TODO_ForestCreator*/);
   auto module = TreeBeard::ConstructLLVMDialectModuleFromXGBoostJSON<FloatType, ReturnType, FeatureIndexType, int32_t, FloatType>(tbContext);
 
-  decisionforest::InferenceRunner inferenceRunner(tbContext.serializer, module, tileSize, floatTypeBitWidth, sizeof(FeatureIndexType)*8);
+  decisionforest::InferenceRunner inferenceRunner(tbContext.serializer, module, tileSize, floatTypeBitWidth, sizeof(FeatureIndexType)*8,
+                                                  options.GetLLVMCodeGenOptions());
   
   TestCSVReader csvReader(modelJsonPath + ".test.sampled.csv", 2000 /*num lines*/);
   assert (csvReader.NumberOfRows() == 2000);
@@ -132,30 +135,32 @@ double Test_CodeGenForJSON_ProbabilityBasedTiling(int64_t batchSize, const std::
 
 template<typename FPType, typename ReturnType, int32_t TileSize>
 double RunSingleBenchmark_SingleConfig(const std::string& modelName, mlir::decisionforest::ScheduleManipulator *scheduleManipulator,
-                                        bool probTiling, int32_t numCores, int32_t pipelineSize, int32_t BatchSize) {
+                                        bool probTiling, int32_t numCores, int32_t pipelineSize, int32_t BatchSize,
+                                        int32_t optLevel=0) {
   auto repoPath = GetTreeBeardRepoPath();
   auto testModelsDir = repoPath + "/xgb_models";
   auto modelJSONPath = testModelsDir + "/" + modelName + "_xgb_model_save.json";
   std::string statsProfileCSV = testModelsDir + "/profiles/" + modelName + ".test.csv";
   auto time = Test_CodeGenForJSON_ProbabilityBasedTiling<FPType, ReturnType>(BatchSize, modelJSONPath, statsProfileCSV, 
                                                                             TileSize, 16, 16, scheduleManipulator,
-                                                                            probTiling, numCores, pipelineSize);
+                                                                            probTiling, numCores, pipelineSize, optLevel);
   return time;
 }
 
 template<typename FPType, int32_t TileSize>
 void RunBenchmark_SingleConfig(mlir::decisionforest::ScheduleManipulator *scheduleManipulator, bool probTiling,
-                               const std::string& config, int32_t numCores, int32_t pipelineSize, int32_t BatchSize) {
+                               const std::string& config, int32_t numCores, int32_t pipelineSize, int32_t BatchSize,
+                               int32_t optLevel=0) {
   std::cout << config << ", ";
   std::cout << GetTypeName(FPType()) << ", " << BatchSize << " , " << TileSize;
-  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, FPType, TileSize>("abalone", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize) << std::flush;
-  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, FPType, TileSize>("airline", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize) << std::flush;
-  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, FPType, TileSize>("airline-ohe", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize) << std::flush;
-  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, int8_t, TileSize>("covtype", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize) << std::flush;
-  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, FPType, TileSize>("epsilon", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize) << std::flush;
-  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, int8_t, TileSize>("letters", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize) << std::flush;
-  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, FPType, TileSize>("higgs", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize) << std::flush;
-  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, FPType, TileSize>("year_prediction_msd", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize) << std::flush;
+  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, FPType, TileSize>("abalone", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize, optLevel) << std::flush;
+  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, FPType, TileSize>("airline", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize, optLevel) << std::flush;
+  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, FPType, TileSize>("airline-ohe", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize, optLevel) << std::flush;
+  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, int8_t, TileSize>("covtype", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize, optLevel) << std::flush;
+  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, FPType, TileSize>("epsilon", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize, optLevel) << std::flush;
+  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, int8_t, TileSize>("letters", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize, optLevel) << std::flush;
+  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, FPType, TileSize>("higgs", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize, optLevel) << std::flush;
+  std::cout << ", " << RunSingleBenchmark_SingleConfig<FPType, FPType, TileSize>("year_prediction_msd", scheduleManipulator, probTiling, numCores, pipelineSize, BatchSize, optLevel) << std::flush;
   std::cout << std::endl;
 }
 
@@ -257,6 +262,24 @@ void RunXGBoostBenchmarks() {
   }
 }
 
+// Compare the JIT's LLVM optimization levels (O0, O2 and O3) on the one tree at a time schedule
+void RunOptimizationLevelXGBoostBenchmarks(int32_t batchSize) {
+  using FPType = float;
+  mlir::decisionforest::ScheduleManipulationFunctionWrapper scheduleManipulator(OneTreeAtATimeSchedule);
+  std::vector<int32_t> optLevels{0, 2, 3};
+  for (auto optLevel : optLevels) {
+    auto config = std::string("array-one_tree-O") + std::to_string(optLevel);
+    RunBenchmark_SingleConfig<FPType, 8>(&scheduleManipulator, false, config, -1, -1, batchSize, optLevel);
+  }
+}
+
+void RunXGBoostOptimizationLevelBenchmarks() {
+  std::vector<int32_t> batchSizes{64, 256, 1024};
+  for (auto batchSize : batchSizes) {
+    RunOptimizationLevelXGBoostBenchmarks(batchSize);
+  }
+}
+
 void RunXGBoostParallelBenchmarks() {
   std::vector<int32_t> batchSizes{64, 128, 256, 512, 1024, 2000};
   for (auto batchSize : batchSizes) {
@@ -264,5 +287,60 @@ void RunXGBoostParallelBenchmarks() {
   }
 }
 
+// Walk the trees of wide models in model order and grouped by the features they read 
+// (CompilerOptions::featureGroupBatchTileSize) and compare L1 data misses and cycles per row
+void RunFeatureLocalityBenchmark_SingleConfig(const std::string& modelName, int32_t batchSize, int32_t batchTileSize) {
+  const int32_t numRepeats = 10;
+  auto modelJSONPath = GetTreeBeardRepoPath() + "/xgb_models/" + modelName + "_xgb_model_save.json";
+  TestCSVReader csvReader(modelJSONPath + ".test.sampled.csv", 2000 /*num lines*/);
+  int32_t numRows = static_cast<int32_t>(csvReader.NumberOfRows());
+  std::vector<float> inputs;
+  for (int32_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<float>(i);
+    row.pop_back();
+    inputs.insert(inputs.end(), row.begin(), row.end());
+  }
+
+  std::cout << modelName << ", " << batchSize << ", " << batchTileSize;
+  std::vector<std::vector<float>> results;
+  for (auto groupTrees : { false, true }) {
+    TreeBeard::CompilerOptions options(32, 32, true, 16, 32, 32, batchSize, 8, 16, 1,
+                                       TreeBeard::TilingType::kUniform, false, false, nullptr);
+    options.optimizationLevel = 3;
+    if (groupTrees)
+      options.featureGroupBatchTileSize = batchTileSize;
+    std::unique_ptr<InferenceRunnerBase> inferenceRunner(ConstructInferenceRunnerForXGBoostJSON(modelJSONPath, options));
+    std::vector<float> modelResults(numRows, -1);
+    InferenceProfile profile;
+    if (inferenceRunner->ProfileInference(inputs.data(), modelResults.data(), numRows, numRepeats, profile)) {
+      std::cout << ", " << profile.l1DataMissesPerRow << ", " << profile.cyclesPerRow << std::flush;
+    }
+    else {
+      // The predictions are still compared
+      inferenceRunner->RunInferenceOnMultipleBatches(inputs.data(), modelResults.data(), numRows);
+      std::cout << ", n/a, n/a" << std::flush;
+    }
+    results.push_back(modelResults);
+  }
+  // Reported in the output (rather than asserted) so that release builds report them too
+  int32_t numMismatches = 0;
+  for (int32_t i=0 ; i<numRows ; ++i)
+    if (!FPEqual<float>(results[0][i], results[1][i]))
+      ++numMismatches;
+  std::cout << ", " << numMismatches << std::endl;
+  if (numMismatches != 0)
+    std::cout << "ERROR : Grouping trees changed the predictions of " << numMismatches << " of " << numRows << " rows" << std::endl;
+}
+
+void RunXGBoostFeatureLocalityBenchmarks() {
+  std::cout << "model, batch size, batch tile size, model order L1 misses/row, model order cycles/row, grouped L1 misses/row, grouped cycles/row, mismatched predictions" << std::endl;
+  std::vector<int32_t> batchSizes{64, 256, 1024};
+  std::vector<int32_t> batchTileSizes{4, 16};
+  for (auto& modelName : { "epsilon", "bosch" })
+    for (auto batchSize : batchSizes)
+      for (auto batchTileSize : batchTileSizes)
+        RunFeatureLocalityBenchmark_SingleConfig(modelName, batchSize, batchTileSize);
+}
+
 } // test
 } // TreeBeard
@@ -1,5 +1,6 @@
 #include <vector>
 #include <sstream>
+#include <filesystem>
 #include "Dialect.h"
 #include "TestUtilsCommon.h"
 
@@ -23,6 +24,7 @@
 #include "TiledTree.h"
 #include "ModelSerializers.h"
 #include "Representations.h"
+#include "OnlineRetilingRunner.h"
 
 using namespace mlir;
 using namespace mlir::decisionforest;
@@ -412,5 +414,113 @@ bool Test_PeeledHybridProbabilisticTiling_TileSize8_Year(TestArgs_t &args) {
   return TestXGBoostBenchmark_CodeGenForJSON_VariableBatchSize<float, int16_t>(args, 1, modelJSONPath, csvPath, statsProfileCSV, tileSize, 16, 16);
 }
 
+// ===---------------------------------------------------=== //
+// Online Re-tiling Tests
+// ===---------------------------------------------------=== //
+
+bool RunOnlineRetilingRunnerAndCheckResults(TreeBeard::OnlineRetilingRunner& onlineRunner, TestCSVReader& csvReader, int32_t rowsPerCall) {
+  for (size_t i=0 ; i<csvReader.NumberOfRows() ; i+=rowsPerCall) {
+    auto numRows = std::min(static_cast<size_t>(rowsPerCall), csvReader.NumberOfRows() - i);
+    std::vector<float> inputs, expectedResults;
+    for (size_t j=0 ; j<numRows ; ++j) {
+      auto row = csvReader.GetRowOfType<float>(i + j);
+      expectedResults.push_back(row.back());
+      row.pop_back();
+      inputs.insert(inputs.end(), row.begin(), row.end());
+    }
+    std::vector<float> results(numRows, -1);
+    onlineRunner.RunInferenceOnMultipleBatches(inputs.data(), results.data(), static_cast<int32_t>(numRows));
+    for (size_t j=0 ; j<numRows ; ++j)
+      Test_ASSERT(FPEqual<float>(expectedResults[j], results[j]));
+  }
+  return true;
+}
+
+bool Test_OnlineRetiling_TileSize8_Abalone(TestArgs_t &args) {
+  SetAndResetPeelTreeWalk setPeelWalk;
+  auto repoPath = GetTreeBeardRepoPath();
+  auto testModelsDir = repoPath + "/xgb_models";
+  auto modelJSONPath = testModelsDir + "/abalone_xgb_model_save.json";
+  auto csvPath = modelJSONPath + ".test.sampled.csv";
+  auto statsProfileCSV = testModelsDir + "/profiles/abalone.test.csv";
+  
+  TreeBeard::CompilerOptions options(32, 32, true, 32, 32, 32, 32, 8, 16, 16, 
+                                     TreeBeard::TilingType::kHybrid, false /*makeAllLeavesSameDepth*/, true, nullptr);
+  // Sample every call and re-tile at every drift check (the drift is never negative)
+  TreeBeard::OnlineRetilingOptions retilingOptions{1.0, -1.0, 100};
+  TreeBeard::OnlineRetilingRunner onlineRunner(modelJSONPath, statsProfileCSV, options, retilingOptions);
+  
+  TestCSVReader csvReader(csvPath);
+  Test_ASSERT(RunOnlineRetilingRunnerAndCheckResults(onlineRunner, csvReader, 250));
+  onlineRunner.WaitForRecompilation();
+  // Calls made while the sampling thread is behind aren't sampled, but the first one always is
+  Test_ASSERT(onlineRunner.GetSampledRowCount() >= 250);
+  Test_ASSERT(onlineRunner.GetSampledRowCount() <= static_cast<int64_t>(csvReader.NumberOfRows()));
+  Test_ASSERT(onlineRunner.GetRecompileCount() >= 1);
+  Test_ASSERT(onlineRunner.GetDrift() >= 0.0 && onlineRunner.GetDrift() <= 1.0);
+  // Results from the re-tiled model
+  Test_ASSERT(RunOnlineRetilingRunnerAndCheckResults(onlineRunner, csvReader, 250));
+  onlineRunner.WaitForRecompilation();
+  return true;
+}
+
+// The drift is a total variation distance, so it is never above a threshold of one and the model must 
+// never be re-tiled
+bool Test_OnlineRetiling_DriftBelowThreshold_Abalone(TestArgs_t &args) {
+  SetAndResetPeelTreeWalk setPeelWalk;
+  auto repoPath = GetTreeBeardRepoPath();
+  auto testModelsDir = repoPath + "/xgb_models";
+  auto modelJSONPath = testModelsDir + "/abalone_xgb_model_save.json";
+  auto csvPath = modelJSONPath + ".test.sampled.csv";
+  auto statsProfileCSV = testModelsDir + "/profiles/abalone.test.csv";
+
+  TreeBeard::CompilerOptions options(32, 32, true, 32, 32, 32, 32, 8, 16, 16, 
+                                     TreeBeard::TilingType::kHybrid, false /*makeAllLeavesSameDepth*/, true, nullptr);
+  TreeBeard::OnlineRetilingOptions retilingOptions{1.0, 1.0, 100};
+  TreeBeard::OnlineRetilingRunner onlineRunner(modelJSONPath, statsProfileCSV, options, retilingOptions);
+  auto initialRunner = onlineRunner.GetInferenceRunner();
+
+  TestCSVReader csvReader(csvPath);
+  Test_ASSERT(RunOnlineRetilingRunnerAndCheckResults(onlineRunner, csvReader, 250));
+  onlineRunner.WaitForRecompilation();
+  Test_ASSERT(onlineRunner.GetSampledRowCount() >= 250);
+  Test_ASSERT(onlineRunner.GetDrift() >= 0.0 && onlineRunner.GetDrift() <= 1.0);
+  Test_ASSERT(onlineRunner.GetRecompileCount() == 0);
+  Test_ASSERT(onlineRunner.GetInferenceRunner() == initialRunner);
+  return true;
+}
+
+// The model is deleted once the runner is constructed so that every drift check fails when it re-reads it. The
+// errors must be recorded and the initial runner must keep serving.
+bool Test_OnlineRetiling_FailedRetilingKeepsRunner_Abalone(TestArgs_t &args) {
+  SetAndResetPeelTreeWalk setPeelWalk;
+  auto repoPath = GetTreeBeardRepoPath();
+  auto testModelsDir = repoPath + "/xgb_models";
+  auto modelJSONPath = testModelsDir + "/abalone_xgb_model_save.json";
+  auto csvPath = modelJSONPath + ".test.sampled.csv";
+  auto statsProfileCSV = testModelsDir + "/profiles/abalone.test.csv";
+  auto modelCopyPath = GetTempFilePath() + ".json";
+  std::filesystem::copy_file(modelJSONPath, modelCopyPath, std::filesystem::copy_options::overwrite_existing);
+
+  TreeBeard::CompilerOptions options(32, 32, true, 32, 32, 32, 32, 8, 16, 16, 
+                                     TreeBeard::TilingType::kHybrid, false /*makeAllLeavesSameDepth*/, true, nullptr);
+  TreeBeard::OnlineRetilingOptions retilingOptions{1.0, -1.0, 100};
+  TreeBeard::OnlineRetilingRunner onlineRunner(modelCopyPath, statsProfileCSV, options, retilingOptions);
+  std::filesystem::remove(modelCopyPath);
+  auto initialRunner = onlineRunner.GetInferenceRunner();
+  Test_ASSERT(onlineRunner.GetRetilingError().empty());
+
+  TestCSVReader csvReader(csvPath);
+  Test_ASSERT(RunOnlineRetilingRunnerAndCheckResults(onlineRunner, csvReader, 250));
+  onlineRunner.WaitForRecompilation();
+  Test_ASSERT(onlineRunner.GetSampledRowCount() >= 250);
+  Test_ASSERT(!onlineRunner.GetRetilingError().empty());
+  Test_ASSERT(onlineRunner.GetRecompileCount() == 0);
+  Test_ASSERT(onlineRunner.GetInferenceRunner() == initialRunner);
+  Test_ASSERT(RunOnlineRetilingRunnerAndCheckResults(onlineRunner, csvReader, 250));
+  onlineRunner.WaitForRecompilation();
+  return true;
+}
+
+}
 }
-}
\ No newline at end of file
@@ -1,5 +1,14 @@
 #include <vector>
 #include <sstream>
+#include <limits>
+#include <cmath>
+#include <filesystem>
+#include <cstring>
+#include <thread>
+#include <future>
+#include <fstream>
+#include <atomic>
+#include <unistd.h>
 #include "Dialect.h"
 #include "TestUtilsCommon.h"
 
@@ -22,6 +31,8 @@
 #include "CompileUtils.h"
 #include "ModelSerializers.h"
 #include "Representations.h"
+#include "CompilationCache.h"
+#include "VersionedInferenceRunner.h"
 
 using namespace mlir;
 using namespace mlir::decisionforest;
@@ -2839,5 +2850,1389 @@ bool Test_TileSize8_Year_TestInputs_ParallelBatch(TestArgs_t &args) {
   return true;
 }
 
+// ===--------------------------------------------------------=== //
+// XGBoost Dynamic Batch Tests
+// ===--------------------------------------------------------=== //
+
+// Compiles the model with a dynamic batch and runs all rows of the CSV through
+// RunInferenceOnPartialBatch in chunks of every size from 1 to batchSize so 
+// that both the full batch and the remainder paths are exercised.
+template<typename FloatType, typename FeatureIndexType=int16_t, typename ResultType=FloatType>
+bool Test_CodeGenForJSON_DynamicBatch(TestArgs_t& args, int64_t batchSize, const std::string& modelJsonPath, const std::string& csvPath, 
+                                      int32_t tileSize, int32_t tileShapeBitWidth, int32_t childIndexBitWidth,
+                                      ScheduleManipulator_t scheduleManipulatorFunc=nullptr) {
+  using NodeIndexType = int32_t;
+  int32_t floatTypeBitWidth = sizeof(FloatType)*8;
+  ScheduleManipulationFunctionWrapper scheduleManipulator(scheduleManipulatorFunc);
+  TreeBeard::CompilerOptions options(floatTypeBitWidth, sizeof(ResultType)*8, IsFloatType(ResultType()), sizeof(FeatureIndexType)*8, sizeof(NodeIndexType)*8,
+                                     floatTypeBitWidth, batchSize, tileSize, tileShapeBitWidth, childIndexBitWidth,
+                                     TreeBeard::TilingType::kUniform, false, false, 
+                                     scheduleManipulatorFunc ? &scheduleManipulator : nullptr);
+  options.dynamicBatch = true;
+  auto modelGlobalsJSONFilePath = TreeBeard::ForestCreator::ModelGlobalJSONFilePathFromJSONFilePath(modelJsonPath);
+  
+  TreeBeard::TreebeardContext tbContext(modelJsonPath, modelGlobalsJSONFilePath, options, 
+                                        mlir::decisionforest::ConstructRepresentation(),
+                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONFilePath),
+                                        nullptr /*TODO_ForestCreator*/);
+  auto module = TreeBeard::ConstructLLVMDialectModuleFromXGBoostJSON<FloatType, ResultType, FeatureIndexType>(tbContext);
+
+  decisionforest::InferenceRunner inferenceRunner(tbContext.serializer, module, tileSize, sizeof(FloatType)*8, sizeof(FeatureIndexType)*8);
+  Test_ASSERT(inferenceRunner.IsDynamicBatch());
+
+  TestCSVReader csvReader(csvPath);
+  size_t numRows = csvReader.NumberOfRows() - 1;
+  size_t currentRow = 0;
+  int32_t chunkSize = 1;
+  while (currentRow < numRows) {
+    int32_t rowsInChunk = std::min(static_cast<size_t>(chunkSize), numRows - currentRow);
+    std::vector<FloatType> inputs;
+    std::vector<ResultType> expectedResults;
+    for (int32_t i=0 ; i<rowsInChunk ; ++i) {
+      auto row = csvReader.GetRowOfType<FloatType>(currentRow + i);
+      expectedResults.push_back(static_cast<ResultType>(row.back()));
+      row.pop_back();
+      inputs.insert(inputs.end(), row.begin(), row.end());
+    }
+    std::vector<ResultType> results(rowsInChunk, -1);
+    inferenceRunner.RunInferenceOnPartialBatch(inputs.data(), results.data(), rowsInChunk);
+    for (int32_t i=0 ; i<rowsInChunk ; ++i)
+      Test_ASSERT(FPEqual<ResultType>(results[i], expectedResults[i]));
+    
+    currentRow += rowsInChunk;
+    chunkSize = chunkSize % batchSize + 1;
+  }
+
+  // More rows than a batch would overrun the generated code's per batch buffers
+  std::vector<FloatType> inputs(static_cast<size_t>(batchSize + 1) * inferenceRunner.GetRowSize(), 0);
+  std::vector<ResultType> results(batchSize + 1, -1);
+  bool rejected = false;
+  try {
+    inferenceRunner.RunInferenceOnPartialBatch(inputs.data(), results.data(), static_cast<int32_t>(batchSize + 1));
+  }
+  catch (const std::runtime_error&) {
+    rejected = true;
+  }
+  Test_ASSERT(rejected);
+  return true;
+}
+
+bool Test_DynamicBatch_Abalone_TestInputs(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto testModelsDir = repoPath + "/xgb_models";
+  auto modelJSONPath = testModelsDir + "/abalone_xgb_model_save.json";
+  auto csvPath = modelJSONPath + ".test.sampled.csv";
+  return Test_CodeGenForJSON_DynamicBatch<float>(args, 8, modelJSONPath, csvPath, 8, 16, 1);
+}
+
+bool Test_DynamicBatch_Airline_TestInputs(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto testModelsDir = repoPath + "/xgb_models";
+  auto modelJSONPath = testModelsDir + "/airline_xgb_model_save.json";
+  auto csvPath = modelJSONPath + ".test.sampled.csv";
+  return Test_CodeGenForJSON_DynamicBatch<float>(args, 8, modelJSONPath, csvPath, 8, 16, 1);
+}
+
+bool Test_DynamicBatch_CovType_TestInputs(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto testModelsDir = repoPath + "/xgb_models";
+  auto modelJSONPath = testModelsDir + "/covtype_xgb_model_save.json";
+  auto csvPath = modelJSONPath + ".test.sampled.csv";
+  return Test_CodeGenForJSON_DynamicBatch<float, int16_t, int8_t>(args, 8, modelJSONPath, csvPath, 8, 16, 1);
+}
+
+bool Test_DynamicBatch_Higgs_TestInputs_TiledSchedule(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto testModelsDir = repoPath + "/xgb_models";
+  auto modelJSONPath = testModelsDir + "/higgs_xgb_model_save.json";
+  auto csvPath = modelJSONPath + ".test.sampled.csv";
+  return Test_CodeGenForJSON_DynamicBatch<float>(args, 8, modelJSONPath, csvPath, 8, 16, 1, TiledSchedule<2, 4>);
+}
+
+// ===--------------------------------------------------------=== //
+// XGBoost Categorical Split Tests
+// ===--------------------------------------------------------=== //
+
+// The model has a numerical split on feature 0 and categorical splits on features 1 and 2. The rows of
+// its CSV cover member and non-member categories, a category past the first bitset word, negative and
+// out of range categories and missing values at both kinds of nodes.
+bool Test_CategoricalXGBoostModel(TestArgs_t &args) {
+  auto modelJSONPath = GetTreeBeardRepoPath() + "/xgb_models/test/categorical_xgb_model.json";
+  auto csvPath = modelJSONPath + ".csv";
+  Test_ASSERT(Test_CodeGenForJSON_VariableBatchSize<double>(args, 1, modelJSONPath, csvPath, 1, 32, 1, false, false));
+  Test_ASSERT(Test_CodeGenForJSON_VariableBatchSize<float>(args, 2, modelJSONPath, csvPath, 4, 16, 1, false, false));
+  decisionforest::UseSparseTreeRepresentation = true;
+  Test_ASSERT(Test_CodeGenForJSON_VariableBatchSize<float>(args, 2, modelJSONPath, csvPath, 4, 16, 32, false, false));
+  return true;
+}
+
+// Writes a copy of the categorical model changed by editTree and checks that parsing it fails
+// Writes an edited copy of the model and returns true if the parser rejects it
+bool EditedXGBoostModelIsRejected(const std::string& modelJSONPath, const std::function<void(json&)>& editModel) {
+  auto invalidModelPath = (std::filesystem::temp_directory_path() / 
+                           ("treebeard-invalid-xgboost-" + std::to_string(getpid()) + ".json")).string();
+  {
+    json modelJSON;
+    std::ifstream fin(modelJSONPath);
+    fin >> modelJSON;
+    editModel(modelJSON);
+    std::ofstream fout(invalidModelPath);
+    fout << modelJSON;
+  }
+  bool rejected = false;
+  try {
+    mlir::MLIRContext context;
+    TreeBeard::XGBoostJSONParser<> parser(context, invalidModelPath, decisionforest::ConstructModelSerializer(""), 1);
+    parser.ConstructForest();
+  }
+  catch (const std::runtime_error&) {
+    rejected = true;
+  }
+  std::filesystem::remove(invalidModelPath);
+  return rejected;
+}
+
+bool CategoricalXGBoostModelIsRejected(const std::function<void(json&)>& editTree) {
+  auto modelJSONPath = GetTreeBeardRepoPath() + "/xgb_models/test/categorical_xgb_model.json";
+  return EditedXGBoostModelIsRejected(modelJSONPath, [&](json& modelJSON) {
+    editTree(modelJSON["learner"]["gradient_booster"]["model"]["trees"][0]);
+  });
+}
+
+bool Test_CategoricalXGBoostModel_InvalidSplitTypes(TestArgs_t &args) {
+  // Unknown split type
+  Test_ASSERT(CategoricalXGBoostModelIsRejected([](json& tree) { tree["split_type"][0] = 2; }));
+  // Categorical split without categories
+  Test_ASSERT(CategoricalXGBoostModelIsRejected([](json& tree) { tree["split_type"][0] = 1; }));
+  // Categories for a numerical split
+  Test_ASSERT(CategoricalXGBoostModelIsRejected([](json& tree) { tree["split_type"][1] = 0; }));
+  // Split types for the wrong number of nodes
+  Test_ASSERT(CategoricalXGBoostModelIsRejected([](json& tree) { tree["split_type"].erase(6); }));
+  // Category segment past the end of the categories
+  Test_ASSERT(CategoricalXGBoostModelIsRejected([](json& tree) { tree["categories_sizes"][1] = 3; }));
+  return true;
+}
+
+// ===--------------------------------------------------------=== //
+// XGBoost Strided Input Tests
+// ===--------------------------------------------------------=== //
+
+void BasicCachedSchedule(mlir::decisionforest::Schedule* schedule);
+
+// Compiles the model for the given input layout and runs all rows of the CSV through RunInferenceOnStridedInput. 
+// Strided inputs have their rows and features spread out with a stride of 2 and column major inputs have
+// a padded leading dimension. The gaps hold NaNs so that reading them changes the predictions.
+template<typename FloatType, typename FeatureIndexType=int16_t, typename ResultType=FloatType>
+bool Test_CodeGenForJSON_InputLayout(TestArgs_t& args, int64_t batchSize, const std::string& modelJsonPath, const std::string& csvPath, 
+                                     int32_t tileSize, InputLayout inputLayout, bool dynamicBatch=false,
+                                     ScheduleManipulator_t scheduleManipulatorFunc=nullptr) {
+  using NodeIndexType = int32_t;
+  int32_t floatTypeBitWidth = sizeof(FloatType)*8;
+  ScheduleManipulationFunctionWrapper scheduleManipulator(scheduleManipulatorFunc);
+  TreeBeard::CompilerOptions options(floatTypeBitWidth, sizeof(ResultType)*8, IsFloatType(ResultType()), sizeof(FeatureIndexType)*8, sizeof(NodeIndexType)*8,
+                                     floatTypeBitWidth, batchSize, tileSize, 16 /*tileShapeBitWidth*/, 1 /*childIndexBitWidth*/,
+                                     TreeBeard::TilingType::kUniform, false, false, 
+                                     scheduleManipulatorFunc ? &scheduleManipulator : nullptr);
+  options.dynamicBatch = dynamicBatch;
+  options.inputLayout = inputLayout;
+  auto modelGlobalsJSONFilePath = TreeBeard::ForestCreator::ModelGlobalJSONFilePathFromJSONFilePath(modelJsonPath);
+  
+  TreeBeard::TreebeardContext tbContext(modelJsonPath, modelGlobalsJSONFilePath, options, 
+                                        mlir::decisionforest::ConstructRepresentation(),
+                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONFilePath),
+                                        nullptr /*TODO_ForestCreator*/);
+  auto module = TreeBeard::ConstructLLVMDialectModuleFromXGBoostJSON<FloatType, ResultType, FeatureIndexType>(tbContext);
+
+  decisionforest::InferenceRunner inferenceRunner(tbContext.serializer, module, tileSize, sizeof(FloatType)*8, sizeof(FeatureIndexType)*8);
+  Test_ASSERT(inferenceRunner.GetInputLayout() == inputLayout);
+
+  TestCSVReader csvReader(csvPath);
+  int64_t numRows = csvReader.NumberOfRows() - 1;
+  int64_t rowSize = inferenceRunner.GetRowSize();
+  int64_t rowStride, columnStride;
+  if (inputLayout == InputLayout::kColumnMajor) {
+    rowStride = 1;
+    columnStride = numRows + 3;
+  }
+  else {
+    rowStride = 2*rowSize + 1;
+    columnStride = 2;
+  }
+  std::vector<FloatType> inputs(numRows*rowStride + rowSize*columnStride, std::numeric_limits<FloatType>::quiet_NaN());
+  std::vector<ResultType> expectedResults;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<FloatType>(i);
+    expectedResults.push_back(static_cast<ResultType>(row.back()));
+    row.pop_back();
+    for (int64_t j=0 ; j<rowSize ; ++j)
+      inputs.at(i*rowStride + j*columnStride) = row.at(j);
+  }
+  std::vector<ResultType> results(numRows, -1);
+  inferenceRunner.RunInferenceOnStridedInput(inputs.data(), results.data(), numRows, rowStride, columnStride);
+  for (int64_t i=0 ; i<numRows ; ++i)
+    Test_ASSERT(FPEqual<ResultType>(results[i], expectedResults[i]));
+
+  // Strides the model can't read are rejected rather than read out of bounds
+  auto stridesAreRejected = [&](int64_t invalidRowStride, int64_t invalidColumnStride) {
+    try {
+      inferenceRunner.RunInferenceOnStridedInput(inputs.data(), results.data(), numRows, invalidRowStride, invalidColumnStride);
+    }
+    catch (const std::runtime_error&) {
+      return true;
+    }
+    return false;
+  };
+  Test_ASSERT(stridesAreRejected(0, columnStride));
+  Test_ASSERT(stridesAreRejected(rowStride, -1));
+  if (inputLayout == InputLayout::kColumnMajor) {
+    Test_ASSERT(stridesAreRejected(2, columnStride));
+    Test_ASSERT(stridesAreRejected(1, numRows - 1));
+  }
+  return true;
+}
+
+bool Test_StridedInput_Abalone_TestInputs(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto modelJSONPath = repoPath + "/xgb_models/abalone_xgb_model_save.json";
+  auto csvPath = modelJSONPath + ".test.sampled.csv";
+  return Test_CodeGenForJSON_InputLayout<float>(args, 8, modelJSONPath, csvPath, 8, InputLayout::kStrided);
+}
+
+bool Test_StridedInput_Airline_TestInputs_CacheInputSchedule(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto modelJSONPath = repoPath + "/xgb_models/airline_xgb_model_save.json";
+  auto csvPath = modelJSONPath + ".test.sampled.csv";
+  return Test_CodeGenForJSON_InputLayout<float>(args, 8, modelJSONPath, csvPath, 4, InputLayout::kStrided, false, BasicCachedSchedule);
+}
+
+bool Test_ColumnMajorInput_Abalone_TestInputs(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto modelJSONPath = repoPath + "/xgb_models/abalone_xgb_model_save.json";
+  auto csvPath = modelJSONPath + ".test.sampled.csv";
+  return Test_CodeGenForJSON_InputLayout<float>(args, 8, modelJSONPath, csvPath, 1, InputLayout::kColumnMajor);
+}
+
+bool Test_ColumnMajorInput_CovType_TestInputs_DynamicBatch(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto modelJSONPath = repoPath + "/xgb_models/covtype_xgb_model_save.json";
+  auto csvPath = modelJSONPath + ".test.sampled.csv";
+  return Test_CodeGenForJSON_InputLayout<float, int16_t, int8_t>(args, 8, modelJSONPath, csvPath, 8, InputLayout::kColumnMajor, true);
+}
+
+// ===--------------------------------------------------------=== //
+// XGBoost Early Exit Tests
+// ===--------------------------------------------------------=== //
+
+// Early exit only preserves the predicted label, so the labels are compared against the expected
+// probabilities. Rows whose expected probability is within float rounding of the threshold are skipped.
+template<typename FloatType>
+bool Test_CodeGenForJSON_EarlyExit(TestArgs_t& args, int64_t batchSize, const std::string& modelJsonPath, 
+                                   int32_t tileSize, double threshold, int64_t numTrees) {
+  using FeatureIndexType = int16_t;
+  using NodeIndexType = int32_t;
+  int32_t floatTypeBitWidth = sizeof(FloatType)*8;
+  TreeBeard::CompilerOptions options(floatTypeBitWidth, floatTypeBitWidth, true, sizeof(FeatureIndexType)*8, sizeof(NodeIndexType)*8,
+                                     floatTypeBitWidth, batchSize, tileSize, 16 /*tileShapeBitWidth*/, 1 /*childIndexBitWidth*/,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.earlyExitThreshold = threshold;
+  auto modelGlobalsJSONFilePath = TreeBeard::ForestCreator::ModelGlobalJSONFilePathFromJSONFilePath(modelJsonPath);
+  
+  TreeBeard::TreebeardContext tbContext(modelJsonPath, modelGlobalsJSONFilePath, options, 
+                                        mlir::decisionforest::ConstructRepresentation(),
+                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONFilePath),
+                                        nullptr /*TODO_ForestCreator*/);
+  auto module = TreeBeard::ConstructLLVMDialectModuleFromXGBoostJSON<FloatType, FloatType, FeatureIndexType>(tbContext);
+
+  decisionforest::InferenceRunner inferenceRunner(tbContext.serializer, module, tileSize, sizeof(FloatType)*8, sizeof(FeatureIndexType)*8);
+  Test_ASSERT(inferenceRunner.IsEarlyExitEnabled());
+  Test_ASSERT(inferenceRunner.GetEarlyExitRowCount() == 0);
+
+  TestCSVReader csvReader(modelJsonPath + ".test.sampled.csv");
+  int64_t numRows = csvReader.NumberOfRows() - 1;
+  std::vector<FloatType> inputs;
+  std::vector<FloatType> expectedResults;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<FloatType>(i);
+    expectedResults.push_back(row.back());
+    row.pop_back();
+    inputs.insert(inputs.end(), row.begin(), row.end());
+  }
+  std::vector<FloatType> results(numRows, -1);
+  inferenceRunner.RunInferenceOnMultipleBatches(inputs.data(), results.data(), numRows);
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    if (std::abs(expectedResults[i] - threshold) < 1e-5)
+      continue;
+    Test_ASSERT((results[i] > threshold) == (expectedResults[i] > threshold));
+  }
+
+  // Partial batches are padded out to a full batch, so at least numRows rows are counted
+  Test_ASSERT(inferenceRunner.GetEarlyExitRowCount() >= numRows);
+  Test_ASSERT(inferenceRunner.GetEarlyExitTreeCount() <= inferenceRunner.GetEarlyExitRowCount()*numTrees);
+  inferenceRunner.ResetEarlyExitStatistics();
+  Test_ASSERT(inferenceRunner.GetEarlyExitRowCount() == 0 && inferenceRunner.GetEarlyExitTreeCount() == 0);
+  return true;
+}
+
+bool Test_EarlyExit_Airline_TestInputs(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto modelJSONPath = repoPath + "/xgb_models/airline_xgb_model_save.json";
+  return Test_CodeGenForJSON_EarlyExit<float>(args, 8, modelJSONPath, 8, 0.5, 100);
+}
+
+bool Test_EarlyExit_Higgs_TestInputs_Tile1(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto modelJSONPath = repoPath + "/xgb_models/higgs_xgb_model_save.json";
+  return Test_CodeGenForJSON_EarlyExit<double>(args, 4, modelJSONPath, 1, 0.3, 100);
+}
+
+// Leaf values and the threshold's logit (0) are exact in both float and double, so some rows of the boundary model 
+// sum to exactly the threshold and others reach partial sums exactly equal to the unpadded bounds. Rows on the 
+// threshold must be labeled negative and no row may exit on the wrong side.
+template<typename FloatType>
+bool Test_EarlyExit_BoundaryRows(TestArgs_t& args, int64_t batchSize, int32_t tileSize) {
+  using FeatureIndexType = int16_t;
+  using NodeIndexType = int32_t;
+  const double threshold = 0.5;
+  const int64_t numTrees = 3;
+  auto modelJsonPath = GetTreeBeardRepoPath() + "/xgb_models/test/early_exit_boundary_xgb_model.json";
+  int32_t floatTypeBitWidth = sizeof(FloatType)*8;
+  TreeBeard::CompilerOptions options(floatTypeBitWidth, floatTypeBitWidth, true, sizeof(FeatureIndexType)*8, sizeof(NodeIndexType)*8,
+                                     floatTypeBitWidth, batchSize, tileSize, 16 /*tileShapeBitWidth*/, 1 /*childIndexBitWidth*/,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.earlyExitThreshold = threshold;
+  auto modelGlobalsJSONFilePath = TreeBeard::ForestCreator::ModelGlobalJSONFilePathFromJSONFilePath(modelJsonPath);
+  TreeBeard::TreebeardContext tbContext(modelJsonPath, modelGlobalsJSONFilePath, options, 
+                                        mlir::decisionforest::ConstructRepresentation(),
+                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONFilePath),
+                                        nullptr /*TODO_ForestCreator*/);
+  auto module = TreeBeard::ConstructLLVMDialectModuleFromXGBoostJSON<FloatType, FloatType, FeatureIndexType>(tbContext);
+  decisionforest::InferenceRunner inferenceRunner(tbContext.serializer, module, tileSize, sizeof(FloatType)*8, sizeof(FeatureIndexType)*8);
+  Test_ASSERT(inferenceRunner.IsEarlyExitEnabled());
+
+  TestCSVReader csvReader(modelJsonPath + ".csv");
+  int64_t numRows = csvReader.NumberOfRows() - 1;
+  Test_ASSERT(numRows % batchSize == 0);
+  std::vector<FloatType> inputs;
+  std::vector<double> expectedResults;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<FloatType>(i);
+    expectedResults.push_back(csvReader.GetRow(i).back());
+    row.pop_back();
+    inputs.insert(inputs.end(), row.begin(), row.end());
+  }
+  std::vector<FloatType> results(numRows, -1);
+  inferenceRunner.RunInferenceOnMultipleBatches(inputs.data(), results.data(), numRows);
+  int64_t rowsOnThreshold = 0;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    Test_ASSERT((results[i] > threshold) == (expectedResults[i] > threshold));
+    if (expectedResults[i] == threshold) {
+      Test_ASSERT(results[i] == static_cast<FloatType>(threshold));
+      ++rowsOnThreshold;
+    }
+  }
+  Test_ASSERT(rowsOnThreshold > 0);
+  // Rows far enough from the threshold must still exit before the last tree
+  Test_ASSERT(inferenceRunner.GetEarlyExitRowCount() == numRows);
+  Test_ASSERT(inferenceRunner.GetEarlyExitTreeCount() < numRows*numTrees);
+  return true;
+}
+
+bool Test_EarlyExit_BoundaryRows_Float(TestArgs_t &args) {
+  return Test_EarlyExit_BoundaryRows<float>(args, 4, 1);
+}
+
+bool Test_EarlyExit_BoundaryRows_Double_Tile4(TestArgs_t &args) {
+  return Test_EarlyExit_BoundaryRows<double>(args, 2, 4);
+}
+
+// Compiles the model with early exit and the options changed by editOptions and checks that compilation fails
+bool EarlyExitCompilationIsRejected(const std::string& modelJsonPath, double threshold, 
+                                    const std::function<void(TreeBeard::CompilerOptions&)>& editOptions) {
+  TreeBeard::CompilerOptions options(32, 32, true, 16, 32, 32, 4 /*batchSize*/, 1 /*tileSize*/, 16 /*tileShapeBitWidth*/, 
+                                     1 /*childIndexBitWidth*/, TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.earlyExitThreshold = threshold;
+  editOptions(options);
+  auto modelGlobalsJSONFilePath = TreeBeard::ForestCreator::ModelGlobalJSONFilePathFromJSONFilePath(modelJsonPath);
+  try {
+    TreeBeard::TreebeardContext tbContext(modelJsonPath, modelGlobalsJSONFilePath, options, 
+                                          mlir::decisionforest::ConstructRepresentation(),
+                                          mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONFilePath),
+                                          nullptr /*TODO_ForestCreator*/);
+    TreeBeard::ConstructLLVMDialectModuleFromXGBoostJSON<float, float, int16_t>(tbContext);
+  }
+  catch (const std::runtime_error&) {
+    return true;
+  }
+  return false;
+}
+
+bool Test_EarlyExit_InvalidOptionsAreRejected(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto boundaryModelPath = repoPath + "/xgb_models/test/early_exit_boundary_xgb_model.json";
+  auto noChange = [](TreeBeard::CompilerOptions&) {};
+  Test_ASSERT(EarlyExitCompilationIsRejected(boundaryModelPath, 0.5, [](TreeBeard::CompilerOptions& options) { options.reorderTreesByDepth = true; }));
+  Test_ASSERT(EarlyExitCompilationIsRejected(boundaryModelPath, 0.5, [](TreeBeard::CompilerOptions& options) { options.featureGroupBatchTileSize = 4; }));
+  Test_ASSERT(EarlyExitCompilationIsRejected(boundaryModelPath, 0.5, [](TreeBeard::CompilerOptions& options) { options.profileLeafHits = true; }));
+  Test_ASSERT(EarlyExitCompilationIsRejected(boundaryModelPath, 1.5, noChange));
+  Test_ASSERT(EarlyExitCompilationIsRejected(boundaryModelPath, 0.0, noChange));
+  // Regression models have no label to decide
+  Test_ASSERT(EarlyExitCompilationIsRejected(repoPath + "/xgb_models/abalone_xgb_model_save.json", 0.5, noChange));
+  return true;
+}
+
+// ===--------------------------------------------------------=== //
+// XGBoost Quantized Input Tests
+// ===--------------------------------------------------------=== //
+
+// Quantizing the inputs must not change any prediction. InputElementType can be wider than 
+// ThresholdType since the trees are walked on bin indices.
+template<typename ThresholdType, typename InputElementType=ThresholdType>
+bool Test_CodeGenForJSON_QuantizedInputs(TestArgs_t& args, int64_t batchSize, const std::string& modelJsonPath, int32_t tileSize) {
+  using FeatureIndexType = int16_t;
+  using NodeIndexType = int32_t;
+  TreeBeard::CompilerOptions options(sizeof(ThresholdType)*8, sizeof(ThresholdType)*8, true, sizeof(FeatureIndexType)*8, sizeof(NodeIndexType)*8,
+                                     sizeof(InputElementType)*8, batchSize, tileSize, 16 /*tileShapeBitWidth*/, 1 /*childIndexBitWidth*/,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.quantizeInputs = true;
+  auto modelGlobalsJSONFilePath = TreeBeard::ForestCreator::ModelGlobalJSONFilePathFromJSONFilePath(modelJsonPath);
+  
+  TreeBeard::TreebeardContext tbContext(modelJsonPath, modelGlobalsJSONFilePath, options, 
+                                        mlir::decisionforest::ConstructRepresentation(),
+                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONFilePath),
+                                        nullptr /*TODO_ForestCreator*/);
+  auto module = TreeBeard::ConstructLLVMDialectModuleFromXGBoostJSON<ThresholdType, ThresholdType, FeatureIndexType, 
+                                                                     NodeIndexType, InputElementType>(tbContext);
+
+  decisionforest::InferenceRunner inferenceRunner(tbContext.serializer, module, tileSize, sizeof(ThresholdType)*8, sizeof(FeatureIndexType)*8);
+
+  TestCSVReader csvReader(modelJsonPath + ".test.sampled.csv");
+  int64_t numRows = csvReader.NumberOfRows() - 1;
+  std::vector<InputElementType> inputs;
+  std::vector<ThresholdType> expectedResults;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<InputElementType>(i);
+    expectedResults.push_back(static_cast<ThresholdType>(row.back()));
+    row.pop_back();
+    inputs.insert(inputs.end(), row.begin(), row.end());
+  }
+  std::vector<ThresholdType> results(numRows, -1);
+  inferenceRunner.RunInferenceOnMultipleBatches(inputs.data(), results.data(), numRows);
+  for (int64_t i=0 ; i<numRows ; ++i)
+    Test_ASSERT(FPEqual<ThresholdType>(results[i], expectedResults[i]));
+  return true;
+}
+
+bool Test_QuantizedInputs_Abalone_TestInputs(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto modelJSONPath = repoPath + "/xgb_models/abalone_xgb_model_save.json";
+  return Test_CodeGenForJSON_QuantizedInputs<float>(args, 8, modelJSONPath, 8);
+}
+
+bool Test_QuantizedInputs_Airline_TestInputs_DoubleInputs(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto modelJSONPath = repoPath + "/xgb_models/airline_xgb_model_save.json";
+  return Test_CodeGenForJSON_QuantizedInputs<float, double>(args, 8, modelJSONPath, 4);
+}
+
+// ===--------------------------------------------------------=== //
+// XGBoost All Outputs Tests
+// ===--------------------------------------------------------=== //
+
+// The outputs of each row are compared with the forest's prediction of all outputs and, for softmax 
+// classifiers, the most likely class with the expected label.
+template<typename FloatType>
+bool Test_CodeGenForJSON_AllOutputs(TestArgs_t& args, int64_t batchSize, const std::string& modelJsonPath, int32_t tileSize, bool dynamicBatch) {
+  using FeatureIndexType = int16_t;
+  using NodeIndexType = int32_t;
+  int32_t floatTypeBitWidth = sizeof(FloatType)*8;
+  TreeBeard::CompilerOptions options(floatTypeBitWidth, floatTypeBitWidth, true, sizeof(FeatureIndexType)*8, sizeof(NodeIndexType)*8,
+                                     floatTypeBitWidth, batchSize, tileSize, 16 /*tileShapeBitWidth*/, 1 /*childIndexBitWidth*/,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.returnAllOutputs = true;
+  options.dynamicBatch = dynamicBatch;
+  auto modelGlobalsJSONFilePath = TreeBeard::ForestCreator::ModelGlobalJSONFilePathFromJSONFilePath(modelJsonPath);
+  
+  TreeBeard::TreebeardContext tbContext(modelJsonPath, modelGlobalsJSONFilePath, options, 
+                                        mlir::decisionforest::ConstructRepresentation(),
+                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONFilePath),
+                                        nullptr /*TODO_ForestCreator*/);
+  auto module = TreeBeard::ConstructLLVMDialectModuleFromXGBoostJSON<FloatType, FloatType, FeatureIndexType>(tbContext);
+  decisionforest::InferenceRunner inferenceRunner(tbContext.serializer, module, tileSize, sizeof(FloatType)*8, sizeof(FeatureIndexType)*8);
+
+  TreeBeard::XGBoostJSONParser<> xgBoostParser(tbContext.context, modelJsonPath, decisionforest::ConstructModelSerializer(""), batchSize);
+  xgBoostParser.ConstructForest();
+  auto& forest = *xgBoostParser.GetForest();
+  int64_t numOutputs = forest.GetNumOutputs();
+  Test_ASSERT(numOutputs > 1 && inferenceRunner.GetNumberOfOutputs() == numOutputs);
+
+  TestCSVReader csvReader(modelJsonPath + ".test.sampled.csv");
+  int64_t numRows = csvReader.NumberOfRows() - 1;
+  std::vector<FloatType> inputs;
+  std::vector<std::vector<double>> expectedOutputs;
+  std::vector<int64_t> expectedLabels;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<double>(i);
+    expectedLabels.push_back(static_cast<int64_t>(row.back()));
+    row.pop_back();
+    expectedOutputs.push_back(forest.PredictAllOutputs(row));
+    inputs.insert(inputs.end(), row.begin(), row.end());
+  }
+  std::vector<FloatType> results(numRows*numOutputs, -1);
+  inferenceRunner.RunInferenceOnMultipleBatches(inputs.data(), results.data(), numRows);
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto rowResults = results.begin() + i*numOutputs;
+    for (int64_t j=0 ; j<numOutputs ; ++j)
+      Test_ASSERT(FPEqual<FloatType>(rowResults[j], static_cast<FloatType>(expectedOutputs[i][j])));
+    if (forest.GetPredictionTransformation() == decisionforest::PredictionTransformation::kSoftMax)
+      Test_ASSERT(std::distance(rowResults, std::max_element(rowResults, rowResults + numOutputs)) == expectedLabels[i]);
+  }
+  return true;
+}
+
+bool Test_AllOutputs_CovType_TestInputs(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto modelJSONPath = repoPath + "/xgb_models/covtype_xgb_model_save.json";
+  return Test_CodeGenForJSON_AllOutputs<float>(args, 8, modelJSONPath, 8, false);
+}
+
+bool Test_AllOutputs_Letters_TestInputs_DynamicBatch(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto modelJSONPath = repoPath + "/xgb_models/letters_xgb_model_save.json";
+  return Test_CodeGenForJSON_AllOutputs<double>(args, 16, modelJSONPath, 1, true);
+}
+
+// The test CSV of the multi-target model holds the features of each row followed by the expected 
+// prediction of every target (computed independently of Treebeard).
+template<typename FloatType>
+bool Test_MultiTarget_TestInputs(TestArgs_t& args, int64_t batchSize, int32_t tileSize, bool dynamicBatch) {
+  using FeatureIndexType = int16_t;
+  using NodeIndexType = int32_t;
+  const int64_t numTargets = 3;
+  auto modelJsonPath = GetTreeBeardRepoPath() + "/xgb_models/test/multi_target_xgb_model.json";
+  int32_t floatTypeBitWidth = sizeof(FloatType)*8;
+  TreeBeard::CompilerOptions options(floatTypeBitWidth, floatTypeBitWidth, true, sizeof(FeatureIndexType)*8, sizeof(NodeIndexType)*8,
+                                     floatTypeBitWidth, batchSize, tileSize, 16 /*tileShapeBitWidth*/, 1 /*childIndexBitWidth*/,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.returnAllOutputs = true;
+  options.dynamicBatch = dynamicBatch;
+  auto modelGlobalsJSONFilePath = TreeBeard::ForestCreator::ModelGlobalJSONFilePathFromJSONFilePath(modelJsonPath);
+  
+  TreeBeard::TreebeardContext tbContext(modelJsonPath, modelGlobalsJSONFilePath, options, 
+                                        mlir::decisionforest::ConstructRepresentation(),
+                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONFilePath),
+                                        nullptr /*TODO_ForestCreator*/);
+  auto module = TreeBeard::ConstructLLVMDialectModuleFromXGBoostJSON<FloatType, FloatType, FeatureIndexType>(tbContext);
+  decisionforest::InferenceRunner inferenceRunner(tbContext.serializer, module, tileSize, sizeof(FloatType)*8, sizeof(FeatureIndexType)*8);
+  Test_ASSERT(inferenceRunner.GetNumberOfOutputs() == numTargets);
+
+  TreeBeard::XGBoostJSONParser<> xgBoostParser(tbContext.context, modelJsonPath, decisionforest::ConstructModelSerializer(""), batchSize);
+  xgBoostParser.ConstructForest();
+  auto& forest = *xgBoostParser.GetForest();
+  Test_ASSERT(forest.GetNumOutputs() == numTargets);
+
+  TestCSVReader csvReader(modelJsonPath + ".csv");
+  int64_t numRows = csvReader.NumberOfRows() - 1;
+  std::vector<FloatType> inputs;
+  std::vector<std::vector<double>> expectedOutputs;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<double>(i);
+    std::vector<double> features(row.begin(), row.end() - numTargets);
+    expectedOutputs.push_back(std::vector<double>(row.end() - numTargets, row.end()));
+    Test_ASSERT(forest.PredictAllOutputs(features) == expectedOutputs.back());
+    inputs.insert(inputs.end(), features.begin(), features.end());
+  }
+  std::vector<FloatType> results(numRows*numTargets, -1);
+  inferenceRunner.RunInferenceOnMultipleBatches(inputs.data(), results.data(), numRows);
+  for (int64_t i=0 ; i<numRows ; ++i)
+    for (int64_t j=0 ; j<numTargets ; ++j)
+      Test_ASSERT(FPEqual<FloatType>(results[i*numTargets + j], static_cast<FloatType>(expectedOutputs[i][j])));
+  return true;
+}
+
+bool Test_MultiTarget_TestInputs_Float_Tile1(TestArgs_t &args) {
+  return Test_MultiTarget_TestInputs<float>(args, 4, 1, false);
+}
+
+bool Test_MultiTarget_TestInputs_Double_Tile4_DynamicBatch(TestArgs_t &args) {
+  return Test_MultiTarget_TestInputs<double>(args, 8, 4, true);
+}
+
+// Models and options that can't be compiled correctly must be rejected with an error
+bool Test_MultiTarget_UnsupportedModelsAreRejected(TestArgs_t &args) {
+  auto testModelDir = GetTreeBeardRepoPath() + "/xgb_models/test/";
+  auto modelJSONPath = testModelDir + "multi_target_xgb_model.json";
+  // The unedited model must be accepted, otherwise the checks below prove nothing
+  Test_ASSERT(!EditedXGBoostModelIsRejected(modelJSONPath, [](json& modelJSON) { }));
+  Test_ASSERT(EditedXGBoostModelIsRejected(modelJSONPath, [](json& modelJSON) {
+    modelJSON["learner"]["learner_model_param"]["num_class"] = "3";
+  }));
+  Test_ASSERT(EditedXGBoostModelIsRejected(modelJSONPath, [](json& modelJSON) {
+    modelJSON["learner"]["gradient_booster"]["model"]["trees"][0]["tree_param"]["size_leaf_vector"] = "3";
+  }));
+  Test_ASSERT(EditedXGBoostModelIsRejected(modelJSONPath, [](json& modelJSON) {
+    modelJSON["learner"]["objective"]["name"] = "reg:unknown";
+  }));
+
+  auto compilationIsRejected = [](const std::string& modelPath, int32_t returnTypeWidth, bool returnIsFloat) {
+    TreeBeard::CompilerOptions options(32, returnTypeWidth, returnIsFloat, 16, 32, 32, 4, 1, 16, 1,
+                                       TreeBeard::TilingType::kUniform, false, false, nullptr);
+    options.returnAllOutputs = true;
+    try {
+      std::unique_ptr<InferenceRunnerBase> inferenceRunner(ConstructInferenceRunnerForXGBoostJSON(modelPath, options));
+    }
+    catch (const std::runtime_error&) {
+      return true;
+    }
+    return false;
+  };
+  // Only models with several outputs can return all of them, and only as floating point values
+  Test_ASSERT(compilationIsRejected(testModelDir + "early_exit_boundary_xgb_model.json", 32, true));
+  Test_ASSERT(compilationIsRejected(modelJSONPath, 8, false));
+  return true;
+}
+
+// ===--------------------------------------------------------=== //
+// XGBoost Objective Tests
+// ===--------------------------------------------------------=== //
+
+// Writes a copy of the model with the given objective and base score into modelDir. If numClasses is 
+// non-zero, the targets of the model are made classes.
+std::string WriteModelWithObjective(const std::string& modelJsonPath, const std::filesystem::path& modelDir, 
+                                    const std::string& objectiveName, const std::string& baseScore, int32_t numClasses=0) {
+  nlohmann::json modelJSON;
+  {
+    std::ifstream fin(modelJsonPath);
+    fin >> modelJSON;
+  }
+  auto& learnerJSON = modelJSON["learner"];
+  learnerJSON["objective"]["name"] = objectiveName;
+  learnerJSON["learner_model_param"]["base_score"] = baseScore;
+  if (numClasses != 0) {
+    learnerJSON["learner_model_param"]["num_class"] = std::to_string(numClasses);
+    learnerJSON["learner_model_param"]["num_target"] = "1";
+  }
+  auto objectiveModelPath = (modelDir / (objectiveName.substr(objectiveName.find(':') + 1) + "_xgb_model.json")).string();
+  std::ofstream fout(objectiveModelPath);
+  fout << modelJSON;
+  return objectiveModelPath;
+}
+
+template<typename FloatType>
+std::vector<FloatType> CompileAndPredictWithSchedule(const std::string& modelJsonPath, std::vector<FloatType>& inputs, 
+                                                     int64_t numRows, int32_t tileSize, bool returnAllOutputs, 
+                                                     ScheduleManipulator_t scheduleManipulatorFunc) {
+  const int32_t batchSize = 4;
+  int32_t floatTypeBitWidth = sizeof(FloatType)*8;
+  ScheduleManipulationFunctionWrapper scheduleManipulator(scheduleManipulatorFunc);
+  TreeBeard::CompilerOptions options(floatTypeBitWidth, floatTypeBitWidth, true, 16, 32, floatTypeBitWidth, batchSize, tileSize, 16, 1,
+                                     TreeBeard::TilingType::kUniform, false, false, 
+                                     scheduleManipulatorFunc ? &scheduleManipulator : nullptr);
+  options.returnAllOutputs = returnAllOutputs;
+  std::unique_ptr<InferenceRunnerBase> inferenceRunner(ConstructInferenceRunnerForXGBoostJSON(modelJsonPath, options));
+  std::vector<FloatType> results(numRows*inferenceRunner->GetNumberOfOutputs(), -1);
+  inferenceRunner->RunInferenceOnMultipleBatches(inputs.data(), results.data(), numRows);
+  return results;
+}
+
+// Sets the objective of the single output test model and compares its predictions with the inverse link 
+// of the objective applied to the sum of the tree predictions and the base margin. The prediction 
+// transformation is fused into the result store with the default schedule but not when the trees are 
+// walked one at a time, so both schedules are checked and must give bit identical results.
+template<typename FloatType>
+bool Test_SingleOutputObjectives(TestArgs_t& args, int32_t tileSize) {
+  struct ObjectiveTest {
+    std::string objectiveName;
+    std::string baseScore;
+    double baseMargin;
+    std::function<double(double)> inverseLink;
+  };
+  auto identity = [](double margin) { return margin; };
+  auto sigmoid = [](double margin) { return 1.0/(1.0 + std::exp(-margin)); };
+  auto exponential = [](double margin) { return std::exp(margin); };
+  std::vector<ObjectiveTest> objectiveTests = {
+    { "reg:logistic", "2.5E-1", std::log(0.25/0.75), sigmoid },
+    { "binary:logitraw", "2.5E-1", std::log(0.25/0.75), identity },
+    { "count:poisson", "2E0", std::log(2.0), exponential },
+    { "reg:gamma", "2E0", std::log(2.0), exponential },
+    { "reg:tweedie", "2E0", std::log(2.0), exponential },
+    { "survival:cox", "2E0", std::log(2.0), exponential },
+    { "rank:pairwise", "5E-1", 0.5, identity },
+    { "rank:ndcg", "5E-1", 0.5, identity },
+  };
+
+  auto modelJsonPath = GetTreeBeardRepoPath() + "/xgb_models/test/early_exit_boundary_xgb_model.json";
+  auto modelDir = std::filesystem::temp_directory_path() / ("treebeard-objective-test-" + std::to_string(getpid()));
+  std::filesystem::create_directories(modelDir);
+
+  // The sum of the tree predictions of each row is the prediction of the model as a regressor with no base score
+  mlir::MLIRContext context;
+  TreeBeard::XGBoostJSONParser<> rawSumParser(context, WriteModelWithObjective(modelJsonPath, modelDir, "reg:squarederror", "0E0"), 
+                                              decisionforest::ConstructModelSerializer(""), 4);
+  rawSumParser.ConstructForest();
+  auto& rawSumForest = *rawSumParser.GetForest();
+
+  TestCSVReader csvReader(modelJsonPath + ".csv");
+  int64_t numRows = csvReader.NumberOfRows() - 1;
+  std::vector<FloatType> inputs;
+  std::vector<double> treeSums;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<double>(i);
+    row.pop_back();
+    treeSums.push_back(rawSumForest.Predict(row));
+    inputs.insert(inputs.end(), row.begin(), row.end());
+  }
+
+  for (auto& objectiveTest : objectiveTests) {
+    auto objectiveModelPath = WriteModelWithObjective(modelJsonPath, modelDir, objectiveTest.objectiveName, objectiveTest.baseScore);
+    auto fusedResults = CompileAndPredictWithSchedule<FloatType>(objectiveModelPath, inputs, numRows, tileSize, false, nullptr);
+    auto unfusedResults = CompileAndPredictWithSchedule<FloatType>(objectiveModelPath, inputs, numRows, tileSize, false, OneTreeAtATimeSchedule);
+    Test_ASSERT(fusedResults.size() == static_cast<size_t>(numRows) && unfusedResults.size() == fusedResults.size());
+    for (int64_t i=0 ; i<numRows ; ++i) {
+      auto expectedResult = objectiveTest.inverseLink(treeSums[i] + objectiveTest.baseMargin);
+      Test_ASSERT(FPEqual<FloatType>(fusedResults[i], static_cast<FloatType>(expectedResult)));
+      Test_ASSERT(fusedResults[i] == unfusedResults[i]);
+    }
+  }
+  std::filesystem::remove_all(modelDir);
+  return true;
+}
+
+bool Test_SingleOutputObjectives_Float_Scalar(TestArgs_t &args) {
+  return Test_SingleOutputObjectives<float>(args, 1);
+}
+
+bool Test_SingleOutputObjectives_Double_TileSize4(TestArgs_t &args) {
+  return Test_SingleOutputObjectives<double>(args, 4);
+}
+
+// Makes the targets of the multi-target test model classes of a multi:softprob classifier and checks the 
+// class probabilities against the softmax of the expected per target predictions.
+bool Test_SoftProbObjective_AllOutputs(TestArgs_t &args) {
+  const int32_t numClasses = 3;
+  auto modelJsonPath = GetTreeBeardRepoPath() + "/xgb_models/test/multi_target_xgb_model.json";
+  auto modelDir = std::filesystem::temp_directory_path() / ("treebeard-objective-test-" + std::to_string(getpid()));
+  std::filesystem::create_directories(modelDir);
+  auto softProbModelPath = WriteModelWithObjective(modelJsonPath, modelDir, "multi:softprob", "5E-1", numClasses);
+
+  TestCSVReader csvReader(modelJsonPath + ".csv");
+  int64_t numRows = csvReader.NumberOfRows() - 1;
+  std::vector<float> inputs;
+  std::vector<std::vector<double>> classSums;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<double>(i);
+    inputs.insert(inputs.end(), row.begin(), row.end() - numClasses);
+    classSums.push_back(std::vector<double>(row.end() - numClasses, row.end()));
+  }
+  auto results = CompileAndPredictWithSchedule<float>(softProbModelPath, inputs, numRows, 4, true, nullptr);
+  Test_ASSERT(results.size() == static_cast<size_t>(numRows*numClasses));
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    double sum = 0.0;
+    for (auto classSum : classSums[i])
+      sum += std::exp(classSum);
+    for (int32_t j=0 ; j<numClasses ; ++j)
+      Test_ASSERT(FPEqual<float>(results[i*numClasses + j], static_cast<float>(std::exp(classSums[i][j])/sum)));
+  }
+  std::filesystem::remove_all(modelDir);
+  return true;
+}
+
+// Compiles the models listed in a manifest into one model and compares each of its outputs with the 
+// prediction of the corresponding model on its own. The rows are those of csvPath, which must hold 
+// (at least) the features of every model.
+bool Test_MultiModelManifest(TestArgs_t& args, const std::vector<std::string>& modelJsonPaths, const std::string& csvPath, int32_t tileSize) {
+  const int32_t batchSize = 8;
+  auto modelDir = std::filesystem::temp_directory_path() / ("treebeard-multimodel-test-" + std::to_string(getpid()));
+  std::filesystem::create_directories(modelDir);
+  auto manifestPath = (modelDir / "combined.models.json").string();
+  {
+    nlohmann::json manifestJSON;
+    manifestJSON["models"] = modelJsonPaths;
+    std::ofstream fout(manifestPath);
+    fout << manifestJSON;
+  }
+
+  TreeBeard::CompilerOptions options(32, 32, true, 16, 32, 32, batchSize, tileSize, 16, 1,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.returnAllOutputs = true;
+  std::unique_ptr<InferenceRunnerBase> inferenceRunner(ConstructInferenceRunnerForXGBoostJSON(manifestPath, options));
+  int64_t numModels = modelJsonPaths.size();
+  Test_ASSERT(inferenceRunner->GetNumberOfOutputs() == numModels);
+
+  mlir::MLIRContext context;
+  std::vector<std::shared_ptr<decisionforest::DecisionForest>> forests;
+  for (auto& modelJsonPath : modelJsonPaths) {
+    TreeBeard::XGBoostJSONParser<> xgBoostParser(context, modelJsonPath, decisionforest::ConstructModelSerializer(""), batchSize);
+    xgBoostParser.ConstructForest();
+    forests.push_back(xgBoostParser.GetForest());
+  }
+
+  TestCSVReader csvReader(csvPath);
+  int64_t numRows = csvReader.NumberOfRows() - 1;
+  std::vector<float> inputs;
+  std::vector<std::vector<double>> expectedOutputs;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<double>(i);
+    row.pop_back();
+    std::vector<double> rowOutputs;
+    for (auto& forest : forests)
+      rowOutputs.push_back(forest->Predict(row));
+    expectedOutputs.push_back(rowOutputs);
+    inputs.insert(inputs.end(), row.begin(), row.end());
+  }
+  std::vector<float> results(numRows*numModels, -1);
+  inferenceRunner->RunInferenceOnMultipleBatches(inputs.data(), results.data(), numRows);
+  for (int64_t i=0 ; i<numRows ; ++i)
+    for (int64_t j=0 ; j<numModels ; ++j)
+      Test_ASSERT(FPEqual<float>(results[i*numModels + j], static_cast<float>(expectedOutputs[i][j])));
+
+  std::filesystem::remove_all(modelDir);
+  return true;
+}
+
+bool Test_MultiModelManifest_Higgs_Abalone(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  std::vector<std::string> modelJSONPaths = { repoPath + "/xgb_models/higgs_xgb_model_save.json", 
+                                              repoPath + "/xgb_models/abalone_xgb_model_save.json" };
+  return Test_MultiModelManifest(args, modelJSONPaths, modelJSONPaths.front() + ".test.sampled.csv", 8);
+}
+
+bool MultiModelManifestIsRejected(const std::string& manifestPath, const nlohmann::json& modelPaths) {
+  if (!modelPaths.is_null()) {
+    nlohmann::json manifestJSON;
+    manifestJSON["models"] = modelPaths;
+    std::ofstream fout(manifestPath);
+    fout << manifestJSON;
+  }
+  bool rejected = false;
+  try {
+    mlir::MLIRContext context;
+    TreeBeard::InitializeMLIRContext(context);
+    TreeBeard::XGBoostJSONParser<> xgBoostParser(context, manifestPath, decisionforest::ConstructModelSerializer(""), 4);
+    xgBoostParser.ConstructForest();
+  }
+  catch (const std::runtime_error&) {
+    rejected = true;
+  }
+  std::filesystem::remove(manifestPath);
+  return rejected;
+}
+
+// Models that can't share a row or a result column must be rejected with an error rather than compiled together
+bool Test_MultiModelManifest_InvalidManifestsAreRejected(TestArgs_t &args) {
+  auto testModelDir = GetTreeBeardRepoPath() + "/xgb_models/test/";
+  auto manifestPath = (std::filesystem::temp_directory_path() / 
+                       ("treebeard-invalid-" + std::to_string(getpid()) + ".models.json")).string();
+  // Two features are a prefix of five. The valid manifest must be accepted, otherwise the checks below prove nothing.
+  Test_ASSERT(!MultiModelManifestIsRejected(manifestPath, { testModelDir + "early_exit_boundary_xgb_model.json", 
+                                                            testModelDir + "leftheavy_xgb_model.json" }));
+  // The second and third features of the categorical model are categorical, those of the wider model aren't
+  Test_ASSERT(MultiModelManifestIsRejected(manifestPath, { testModelDir + "categorical_xgb_model.json", 
+                                                           testModelDir + "leftheavy_xgb_model.json" }));
+  Test_ASSERT(MultiModelManifestIsRejected(manifestPath, { testModelDir + "early_exit_boundary_xgb_model.json", 
+                                                           testModelDir + "multi_target_xgb_model.json" }));
+  Test_ASSERT(MultiModelManifestIsRejected(manifestPath, nlohmann::json::array()));
+  // A model per result column means the forest can only be compiled to return all outputs
+  {
+    nlohmann::json manifestJSON;
+    manifestJSON["models"] = { testModelDir + "early_exit_boundary_xgb_model.json", testModelDir + "leftheavy_xgb_model.json" };
+    std::ofstream fout(manifestPath);
+    fout << manifestJSON;
+  }
+  TreeBeard::CompilerOptions options(32, 32, true, 16, 32, 32, 4, 1, 16, 1,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.returnAllOutputs = false;
+  bool rejected = false;
+  try {
+    std::unique_ptr<InferenceRunnerBase> inferenceRunner(ConstructInferenceRunnerForXGBoostJSON(manifestPath, options));
+  }
+  catch (const std::runtime_error&) {
+    rejected = true;
+  }
+  std::filesystem::remove(manifestPath);
+  Test_ASSERT(rejected);
+  // The manifest doesn't exist
+  Test_ASSERT(MultiModelManifestIsRejected(manifestPath, nlohmann::json()));
+  return true;
+}
+
+// ===--------------------------------------------------------=== //
+// XGBoost UBJSON Model Tests
+// ===--------------------------------------------------------=== //
+
+// Writes the JSON model as UBJSON and checks that both files are read into the same forest and that 
+// the model compiled from the UBJSON file predicts the expected values.
+template<typename ResultType=float>
+bool Test_UBJSONModel(TestArgs_t& args, const std::string& modelJsonPath, int32_t returnTypeWidth=32, bool returnTypeFloatType=true) {
+  const int32_t batchSize = 4;
+  auto modelDir = std::filesystem::temp_directory_path() / ("treebeard-ubjson-test-" + std::to_string(getpid()));
+  std::filesystem::create_directories(modelDir);
+  auto ubjsonModelPath = (modelDir / (std::filesystem::path(modelJsonPath).stem().string() + ".ubj")).string();
+  {
+    nlohmann::json modelJSON;
+    std::ifstream fin(modelJsonPath);
+    fin >> modelJSON;
+    auto ubjson = nlohmann::json::to_ubjson(modelJSON, true, true);
+    std::ofstream fout(ubjsonModelPath, std::ios::binary);
+    fout.write(reinterpret_cast<const char*>(ubjson.data()), ubjson.size());
+  }
+
+  mlir::MLIRContext context;
+  TreeBeard::XGBoostJSONParser<> jsonParser(context, modelJsonPath, decisionforest::ConstructModelSerializer(""), batchSize);
+  jsonParser.ConstructForest();
+  TreeBeard::XGBoostJSONParser<> ubjsonParser(context, ubjsonModelPath, decisionforest::ConstructModelSerializer(""), batchSize);
+  ubjsonParser.ConstructForest();
+  auto& jsonForest = *jsonParser.GetForest();
+  auto& ubjsonForest = *ubjsonParser.GetForest();
+  Test_ASSERT(jsonForest == ubjsonForest);
+  Test_ASSERT(jsonForest.GetInitialOffset() == ubjsonForest.GetInitialOffset());
+  Test_ASSERT(jsonForest.GetNumClasses() == ubjsonForest.GetNumClasses());
+  Test_ASSERT(jsonForest.GetPredictionTransformation() == ubjsonForest.GetPredictionTransformation());
+
+  TreeBeard::CompilerOptions options(32, returnTypeWidth, returnTypeFloatType, 16, 32, 32, batchSize, 8, 16, 1,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  std::unique_ptr<InferenceRunnerBase> inferenceRunner(ConstructInferenceRunnerForXGBoostJSON(ubjsonModelPath, options));
+  Test_ASSERT((ValidateModuleOutputAgainstCSVdata<float, ResultType>(*inferenceRunner, modelJsonPath + ".test.sampled.csv", batchSize)));
+
+  std::filesystem::remove_all(modelDir);
+  return true;
+}
+
+bool Test_UBJSONModel_Abalone(TestArgs_t &args) {
+  auto modelJSONPath = GetTreeBeardRepoPath() + "/xgb_models/abalone_xgb_model_save.json";
+  return Test_UBJSONModel(args, modelJSONPath);
+}
+
+bool Test_UBJSONModel_Letters(TestArgs_t &args) {
+  auto modelJSONPath = GetTreeBeardRepoPath() + "/xgb_models/letters_xgb_model_save.json";
+  return Test_UBJSONModel<int8_t>(args, modelJSONPath, 8, false);
+}
+
+// The .ubj models in xgb_models/test are encoded the way XGBoost writes UBJSON (typed and counted float32, 
+// int32, int64 and uint8 arrays, int64 lengths and float32 numbers) rather than the way nlohmann::json does.
+// Their trees must be read the same as those of the JSON model they were saved from.
+bool Test_XGBoostUBJModel(TestArgs_t& args, const std::string& ubjModelPath, const std::string& jsonModelPath, const std::string& csvPath) {
+  mlir::MLIRContext context;
+  TreeBeard::XGBoostJSONParser<float, float, int32_t> jsonParser(context, jsonModelPath, decisionforest::ConstructModelSerializer(""), 4);
+  jsonParser.ConstructForest();
+  TreeBeard::XGBoostJSONParser<float, float, int32_t> ubjParser(context, ubjModelPath, decisionforest::ConstructModelSerializer(""), 4);
+  ubjParser.ConstructForest();
+  auto& jsonForest = *jsonParser.GetForest();
+  auto& ubjForest = *ubjParser.GetForest();
+  // Thresholds are float32 in the UBJSON model and decimal in the JSON model, so only compare them as floats
+  Test_ASSERT(jsonForest.NumTrees() == ubjForest.NumTrees());
+  for (size_t i=0 ; i<jsonForest.NumTrees() ; ++i) {
+    auto& jsonNodes = jsonForest.GetTree(i).GetNodes();
+    auto& ubjNodes = ubjForest.GetTree(i).GetNodes();
+    Test_ASSERT(jsonNodes.size() == ubjNodes.size());
+    for (size_t j=0 ; j<jsonNodes.size() ; ++j) {
+      Test_ASSERT(jsonNodes[j].featureIndex == ubjNodes[j].featureIndex);
+      Test_ASSERT(jsonNodes[j].leftChild == ubjNodes[j].leftChild && jsonNodes[j].rightChild == ubjNodes[j].rightChild);
+      Test_ASSERT(static_cast<float>(jsonNodes[j].threshold) == static_cast<float>(ubjNodes[j].threshold));
+    }
+  }
+  Test_ASSERT(jsonForest.GetInitialOffset() == ubjForest.GetInitialOffset());
+
+  Test_ASSERT(Test_CodeGenForJSON_VariableBatchSize<float>(args, 2, ubjModelPath, csvPath, 1, 32, 1, false, false));
+  Test_ASSERT(Test_CodeGenForJSON_VariableBatchSize<float>(args, 4, ubjModelPath, csvPath, 4, 16, 1, false, false));
+  return true;
+}
+
+bool Test_XGBoostUBJModel_Random4Tree(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto jsonModelPath = repoPath + "/xgb_models/test/Random_4Tree/TestModel_Size4_1.json";
+  return Test_XGBoostUBJModel(args, repoPath + "/xgb_models/test/random_4tree_xgb_model.ubj", jsonModelPath, jsonModelPath + ".csv");
+}
+
+bool Test_XGBoostUBJModel_Categorical(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto jsonModelPath = repoPath + "/xgb_models/test/categorical_xgb_model.json";
+  return Test_XGBoostUBJModel(args, repoPath + "/xgb_models/test/categorical_xgb_model.ubj", jsonModelPath, jsonModelPath + ".csv");
+}
+
+bool XGBoostModelIsRejected(const std::string& modelPath) {
+  try {
+    mlir::MLIRContext context;
+    TreeBeard::XGBoostJSONParser<> parser(context, modelPath, decisionforest::ConstructModelSerializer(""), 4);
+    parser.ConstructForest();
+  }
+  catch (const std::runtime_error&) {
+    return true;
+  }
+  return false;
+}
+
+// Missing and truncated models must be rejected with an error rather than parsed into a partial forest
+bool Test_MalformedXGBoostModelsAreRejected(TestArgs_t &args) {
+  auto repoPath = GetTreeBeardRepoPath();
+  auto modelDir = std::filesystem::temp_directory_path() / ("treebeard-malformed-test-" + std::to_string(getpid()));
+  std::filesystem::create_directories(modelDir);
+  Test_ASSERT(XGBoostModelIsRejected((modelDir / "missing_xgb_model.json").string()));
+  for (auto& modelPath : { repoPath + "/xgb_models/test/categorical_xgb_model.json", repoPath + "/xgb_models/test/categorical_xgb_model.ubj" }) {
+    std::ifstream fin(modelPath, std::ios::binary);
+    std::string modelBytes((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+    auto truncatedModelPath = (modelDir / ("truncated" + std::filesystem::path(modelPath).extension().string())).string();
+    {
+      std::ofstream fout(truncatedModelPath, std::ios::binary);
+      fout.write(modelBytes.data(), modelBytes.size()/2);
+    }
+    Test_ASSERT(XGBoostModelIsRejected(truncatedModelPath));
+  }
+  std::filesystem::remove_all(modelDir);
+  return true;
+}
+
+// ===--------------------------------------------------------=== //
+// XGBoost Compilation Cache Tests
+// ===--------------------------------------------------------=== //
+
+// Constructs the runner twice with the same cache directory. The first construction
+// should compile the model and populate the cache, the second should load the cached
+// object code. Both runners must produce the expected predictions.
+template<typename ResultType=float>
+bool Test_CompilationCache(TestArgs_t& args, const std::string& modelJsonPath, const std::string& csvPath, 
+                           int32_t returnTypeWidth=32, bool returnTypeFloatType=true) {
+  const int32_t batchSize = 4;
+  auto cacheDir = std::filesystem::temp_directory_path() / ("treebeard-cache-test-" + std::to_string(getpid()));
+  std::filesystem::remove_all(cacheDir);
+
+  TreeBeard::CompilerOptions options(32, returnTypeWidth, returnTypeFloatType, 16, 32, 32, batchSize, 8, 16, 1,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.compilationCacheDirectory = cacheDir.string();
+
+  CompilationCache::ResetStatistics();
+  std::unique_ptr<InferenceRunnerBase> compiledRunner(ConstructInferenceRunnerForXGBoostJSON(modelJsonPath, options));
+  Test_ASSERT(CompilationCache::GetStatistics().misses == 1 && CompilationCache::GetStatistics().hits == 0);
+  Test_ASSERT((ValidateModuleOutputAgainstCSVdata<float, ResultType>(*compiledRunner, csvPath, batchSize)));
+
+  std::unique_ptr<InferenceRunnerBase> cachedRunner(ConstructInferenceRunnerForXGBoostJSON(modelJsonPath, options));
+  Test_ASSERT(CompilationCache::GetStatistics().misses == 1 && CompilationCache::GetStatistics().hits == 1);
+  Test_ASSERT((ValidateModuleOutputAgainstCSVdata<float, ResultType>(*cachedRunner, csvPath, batchSize)));
+
+  // A different option must not hit the existing entry
+  options.batchSize = 2*batchSize;
+  std::unique_ptr<InferenceRunnerBase> recompiledRunner(ConstructInferenceRunnerForXGBoostJSON(modelJsonPath, options));
+  Test_ASSERT(CompilationCache::GetStatistics().misses == 2 && CompilationCache::GetStatistics().hits == 1);
+
+  std::filesystem::remove_all(cacheDir);
+  return true;
+}
+
+bool Test_CompilationCache_Abalone(TestArgs_t &args) {
+  auto modelJSONPath = GetTreeBeardRepoPath() + "/xgb_models/abalone_xgb_model_save.json";
+  return Test_CompilationCache(args, modelJSONPath, modelJSONPath + ".test.sampled.csv");
+}
+
+bool Test_CompilationCache_CovType(TestArgs_t &args) {
+  auto modelJSONPath = GetTreeBeardRepoPath() + "/xgb_models/covtype_xgb_model_save.json";
+  return Test_CompilationCache<int8_t>(args, modelJSONPath, modelJSONPath + ".test.sampled.csv", 8, false);
+}
+
+// ===--------------------------------------------------------=== //
+// XGBoost Concurrent Compilation Tests
+// ===--------------------------------------------------------=== //
+
+// Compiles the model in its own TreebeardContext and returns the predictions for the 
+// rows of the test CSV (the expected result column is dropped)
+std::vector<float> CompileModelAndPredict(const std::string& modelJsonPath, int32_t tileSize, bool sparseRepresentation) {
+  const int32_t batchSize = 4;
+  TreeBeard::CompilerOptions options(32, 32, true, 16, 32, 32, batchSize, tileSize, 16, 1,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.sparseRepresentation = sparseRepresentation;
+  std::unique_ptr<InferenceRunnerBase> inferenceRunner(ConstructInferenceRunnerForXGBoostJSON(modelJsonPath, options));
+
+  TestCSVReader csvReader(modelJsonPath + ".test.sampled.csv");
+  int64_t numRows = csvReader.NumberOfRows() - 1;
+  std::vector<float> inputs;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<float>(i);
+    row.pop_back();
+    inputs.insert(inputs.end(), row.begin(), row.end());
+  }
+  std::vector<float> results(numRows, -1);
+  inferenceRunner->RunInferenceOnMultipleBatches(inputs.data(), results.data(), numRows);
+  return results;
+}
+
+// Compiles several models concurrently, each in its own context and in both the array and the sparse 
+// representation (chosen per compilation through CompilerOptions), and checks that the predictions are bit
+// identical to those of the same models compiled one after the other. Both compilations of a model write
+// their model globals at the same time.
+bool Test_ConcurrentCompilation(TestArgs_t& args, int32_t tileSize) {
+  const int32_t numberOfRounds = 3;
+  auto repoPath = GetTreeBeardRepoPath();
+  std::vector<std::string> modelJsonPaths = { repoPath + "/xgb_models/abalone_xgb_model_save.json",
+                                              repoPath + "/xgb_models/airline_xgb_model_save.json",
+                                              repoPath + "/xgb_models/higgs_xgb_model_save.json" };
+  // Compilation i is of model i/2, in the sparse representation if i is odd
+  auto numCompilations = 2*modelJsonPaths.size();
+  std::vector<std::vector<float>> expectedResults;
+  for (size_t i=0 ; i<numCompilations ; ++i)
+    expectedResults.push_back(CompileModelAndPredict(modelJsonPaths[i/2], tileSize, i%2 == 1));
+
+  for (int32_t round=0 ; round<numberOfRounds ; ++round) {
+    std::vector<std::vector<float>> results(numCompilations);
+    std::vector<std::thread> threads;
+    for (size_t i=0 ; i<numCompilations ; ++i)
+      threads.emplace_back([&, i]() { results[i] = CompileModelAndPredict(modelJsonPaths[i/2], tileSize, i%2 == 1); });
+    for (auto& thread : threads)
+      thread.join();
+    for (size_t i=0 ; i<numCompilations ; ++i) {
+      Test_ASSERT(results[i].size() == expectedResults[i].size());
+      Test_ASSERT(std::memcmp(results[i].data(), expectedResults[i].data(), results[i].size()*sizeof(float)) == 0);
+    }
+  }
+  return true;
+}
+
+bool Test_ConcurrentCompilation_Scalar(TestArgs_t &args) {
+  return Test_ConcurrentCompilation(args, 1);
+}
+
+bool Test_ConcurrentCompilation_TileSize4(TestArgs_t &args) {
+  return Test_ConcurrentCompilation(args, 4);
+}
+
+// Compiles the model to LLVM IR and returns the IR text. Both paths are reused across calls
+// so that the generated code doesn't differ only in the names of the files it refers to.
+std::string CompileModelToLLVMIR(const std::string& modelJsonPath, const std::string& modelGlobalsJSONPath,
+                                 const std::string& llvmIRFilePath, int32_t tileSize, bool sparseRepresentation) {
+  TreeBeard::CompilerOptions options(32, 32, true, 16, 32, 32, 4, tileSize, 16, 1,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.sparseRepresentation = sparseRepresentation;
+  TreeBeard::TreebeardContext tbContext(modelJsonPath, modelGlobalsJSONPath, options, 
+                                        mlir::decisionforest::ConstructRepresentation(sparseRepresentation),
+                                        mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath, sparseRepresentation),
+                                        nullptr /*TODO_ForestCreator*/);
+  TreeBeard::ConvertXGBoostJSONToLLVMIR(tbContext, llvmIRFilePath);
+  std::ifstream fin(llvmIRFilePath);
+  std::stringstream llvmIR;
+  llvmIR << fin.rdbuf();
+  return llvmIR.str();
+}
+
+// The per tree stages of compilation run on the compiler thread pool, but run serially when the 
+// compilation is itself started from a pool worker. Checks that both ways generate identical code.
+bool Test_SerialAndParallelCompilationMatch(TestArgs_t& args, const std::string& modelName, 
+                                            int32_t tileSize, bool sparseRepresentation) {
+  auto modelJsonPath = TreeBeard::test::GetXGBoostModelPath(modelName);
+  auto modelGlobalsJSONPath = TreeBeard::TemporaryModelGlobalsFilePath();
+  auto llvmIRFilePath = TreeBeard::test::GetTempFilePath() + ".ll";
+
+  auto parallelIR = CompileModelToLLVMIR(modelJsonPath, modelGlobalsJSONPath, llvmIRFilePath, tileSize, sparseRepresentation);
+
+  std::string serialIR;
+  std::promise<void> serialCompilationDone;
+  {
+    TreeBeard::ThreadPool pool(2);
+    pool.Enqueue([&]() {
+      serialIR = CompileModelToLLVMIR(modelJsonPath, modelGlobalsJSONPath, llvmIRFilePath, tileSize, sparseRepresentation);
+      serialCompilationDone.set_value();
+    });
+    serialCompilationDone.get_future().wait();
+  }
+  std::filesystem::remove(modelGlobalsJSONPath);
+  std::filesystem::remove(llvmIRFilePath);
+
+  Test_ASSERT(!parallelIR.empty());
+  Test_ASSERT(parallelIR == serialIR);
+  return true;
+}
+
+bool Test_SerialAndParallelCompilationMatch_Airline_Array_TileSize4(TestArgs_t &args) {
+  return Test_SerialAndParallelCompilationMatch(args, "airline_xgb_model_save.json", 4, false);
+}
+
+bool Test_SerialAndParallelCompilationMatch_Airline_Sparse_TileSize8(TestArgs_t &args) {
+  return Test_SerialAndParallelCompilationMatch(args, "airline_xgb_model_save.json", 8, true);
+}
+
+// ===--------------------------------------------------------=== //
+// Model Hot Swap Tests
+// ===--------------------------------------------------------=== //
+
+// Swaps differently tiled versions of the model into a versioned handle while other threads 
+// run inference on it. Every call must see a complete, live model.
+bool Test_ModelHotSwap(TestArgs_t& args, const std::string& modelJsonPath) {
+  const int32_t batchSize = 4;
+  const int32_t numberOfReaders = 2;
+  std::vector<int32_t> tileSizes = { 4, 8, 1, 4 };
+  auto compileModel = [&](int32_t tileSize, int32_t returnTypeWidth = 32) {
+    TreeBeard::CompilerOptions options(32, returnTypeWidth, true, 16, 32, 32, batchSize, tileSize, 16, 1,
+                                       TreeBeard::TilingType::kUniform, false, false, nullptr);
+    return ConstructInferenceRunnerForXGBoostJSON(modelJsonPath, options);
+  };
+
+  TestCSVReader csvReader(modelJsonPath + ".test.sampled.csv");
+  int64_t numRows = csvReader.NumberOfRows() - 1;
+  std::vector<float> inputs, expectedResults;
+  for (int64_t i=0 ; i<numRows ; ++i) {
+    auto row = csvReader.GetRowOfType<float>(i);
+    expectedResults.push_back(row.back());
+    row.pop_back();
+    inputs.insert(inputs.end(), row.begin(), row.end());
+  }
+
+  VersionedInferenceRunner versionedRunner(compileModel(1));
+  std::atomic<bool> stop(false), mismatch(false);
+  std::atomic<int64_t> callCount(0);
+  std::vector<std::thread> readers;
+  for (int32_t i=0 ; i<numberOfReaders ; ++i) {
+    readers.emplace_back([&]() {
+      std::vector<float> results(numRows);
+      while (!stop.load()) {
+        std::fill(results.begin(), results.end(), -1.0f);
+        versionedRunner.RunInferenceOnMultipleBatches(inputs.data(), results.data(), static_cast<int32_t>(numRows));
+        for (int64_t j=0 ; j<numRows ; ++j)
+          if (!FPEqual<float>(expectedResults[j], results[j]))
+            mismatch.store(true);
+        ++callCount;
+      }
+    });
+  }
+  for (size_t i=0 ; i<tileSizes.size() ; ++i) {
+    auto version = versionedRunner.SwapModel(compileModel(tileSizes[i]));
+    Test_ASSERT(version == static_cast<int64_t>(i + 1));
+  }
+  // Each reader finishes at most one call that started before the last swap
+  auto callsAfterLastSwap = callCount.load();
+  while (callCount.load() <= callsAfterLastSwap + numberOfReaders)
+    std::this_thread::yield();
+  stop.store(true);
+  for (auto& reader : readers)
+    reader.join();
+
+  Test_ASSERT(!mismatch.load());
+  Test_ASSERT(versionedRunner.GetVersion() == static_cast<int64_t>(tileSizes.size()));
+
+  // Callers' result buffers are sized for 32 bit results, so a model that returns doubles must be rejected
+  bool rejected = false;
+  try {
+    versionedRunner.SwapModel(compileModel(4, 64));
+  }
+  catch (const std::runtime_error&) {
+    rejected = true;
+  }
+  Test_ASSERT(rejected);
+  Test_ASSERT(versionedRunner.GetVersion() == static_cast<int64_t>(tileSizes.size()));
+  std::vector<float> results(numRows, -1.0f);
+  versionedRunner.RunInferenceOnMultipleBatches(inputs.data(), results.data(), static_cast<int32_t>(numRows));
+  for (int64_t j=0 ; j<numRows ; ++j)
+    Test_ASSERT(FPEqual<float>(expectedResults[j], results[j]));
+  return true;
+}
+
+bool Test_ModelHotSwap_Abalone(TestArgs_t &args) {
+  auto modelJSONPath = GetTreeBeardRepoPath() + "/xgb_models/abalone_xgb_model_save.json";
+  return Test_ModelHotSwap(args, modelJSONPath);
+}
+
+// ===--------------------------------------------------------=== //
+// XGBoost Feature Grouped Tree Tests
+// ===--------------------------------------------------------=== //
+
+bool Test_FeatureGroupedTrees(TestArgs_t& args, const std::string& modelJsonPath, int32_t batchSize, int32_t batchTileSize, int32_t tileSize) {
+  TreeBeard::CompilerOptions options(32, 32, true, 16, 32, 32, batchSize, tileSize, 16, 1,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.featureGroupBatchTileSize = batchTileSize;
+  std::unique_ptr<InferenceRunnerBase> inferenceRunner(ConstructInferenceRunnerForXGBoostJSON(modelJsonPath, options));
+  Test_ASSERT((ValidateModuleOutputAgainstCSVdata<float, float>(*inferenceRunner, modelJsonPath + ".test.sampled.csv", batchSize)));
+  return true;
+}
+
+bool Test_FeatureGroupedTrees_Higgs_TileSize4(TestArgs_t &args) {
+  auto modelJSONPath = GetTreeBeardRepoPath() + "/xgb_models/higgs_xgb_model_save.json";
+  return Test_FeatureGroupedTrees(args, modelJSONPath, 16, 4, 4);
+}
+
+// Adds a tree that splits on each of the features in turn (the left child of every split is a leaf)
+void AddTreeSplittingOnFeatures(decisionforest::DecisionForest& forest, const std::vector<int32_t>& features) {
+  auto& tree = forest.NewTree();
+  auto parent = tree.NewNode(0.5, features.front());
+  tree.SetNodeParent(parent, -1);
+  for (size_t i=1 ; i<=features.size() ; ++i) {
+    auto leaf = tree.NewNode(static_cast<double>(i), -1);
+    tree.SetNodeParent(leaf, parent);
+    tree.SetNodeLeftChild(parent, leaf);
+    auto node = i == features.size() ? tree.NewNode(0.0, -1) : tree.NewNode(0.5, features[i]);
+    tree.SetNodeParent(node, parent);
+    tree.SetNodeRightChild(parent, node);
+    parent = node;
+  }
+}
+
+// Trees 0 and 2 read cache lines {0, 1} of a row of floats, trees 1 and 3 read lines {4, 5, 6} and tree 4 
+// reads lines 12 to 16. A tile of 64 rows leaves room for 4 lines per row in the 16KB budget and a tile of 
+// 16 rows for 16 lines.
+bool Test_FeatureGroupedTrees_GroupsByCacheLines(TestArgs_t &args) {
+  decisionforest::DecisionForest forest;
+  AddTreeSplittingOnFeatures(forest, { 0, 16 });
+  AddTreeSplittingOnFeatures(forest, { 64, 80, 96 });
+  AddTreeSplittingOnFeatures(forest, { 1, 17 });
+  AddTreeSplittingOnFeatures(forest, { 65, 81, 97 });
+  AddTreeSplittingOnFeatures(forest, { 200, 216, 232, 248, 264 });
+
+  // Trees that read the same lines are grouped. Groups stop growing at the budget, but a tree that reads 
+  // more lines than the budget still gets its own group.
+  auto groups = GroupTreesByFeatures(forest, 64, 32);
+  std::vector<std::vector<int64_t>> expectedGroups = { { 0, 2 }, { 1, 3 }, { 4 } };
+  Test_ASSERT(groups == expectedGroups);
+
+  // Every tree fits in one group. Among trees that share no lines with the group, the first is taken.
+  groups = GroupTreesByFeatures(forest, 16, 32);
+  expectedGroups = { { 0, 2, 1, 3, 4 } };
+  Test_ASSERT(groups == expectedGroups);
+  return true;
+}
+
+// ===--------------------------------------------------------=== //
+// XGBoost LLVM Code Generation Option Tests
+// ===--------------------------------------------------------=== //
+
+bool Test_LLVMCodeGenOptions(TestArgs_t& args, int32_t optimizationLevel, const std::string& targetCPU, const std::string& targetFeatures) {
+  const int32_t batchSize = 8;
+  auto modelJSONPath = GetTreeBeardRepoPath() + "/xgb_models/airline_xgb_model_save.json";
+  TreeBeard::CompilerOptions options(32, 32, true, 16, 32, 32, batchSize, 4, 16, 1,
+                                     TreeBeard::TilingType::kUniform, false, false, nullptr);
+  options.optimizationLevel = optimizationLevel;
+  options.targetCPU = targetCPU;
+  options.targetFeatures = targetFeatures;
+  std::unique_ptr<InferenceRunnerBase> inferenceRunner(ConstructInferenceRunnerForXGBoostJSON(modelJSONPath, options));
+  Test_ASSERT((ValidateModuleOutputAgainstCSVdata<float, float>(*inferenceRunner, modelJSONPath + ".test.sampled.csv", batchSize)));
+  return true;
+}
+
+bool Test_LLVMCodeGenOptions_Airline_O2(TestArgs_t &args) {
+  return Test_LLVMCodeGenOptions(args, 2, "", "");
+}
+
+bool Test_LLVMCodeGenOptions_Airline_O3_HostCPU(TestArgs_t &args) {
+  return Test_LLVMCodeGenOptions(args, 3, "host", "host");
+}
+
+// A CPU (and features) other than the host's. They must be ones the host can run.
+bool Test_LLVMCodeGenOptions_Airline_O3_GenericCPU(TestArgs_t &args) {
+#if defined(__x86_64__)
+  return Test_LLVMCodeGenOptions(args, 3, "x86-64", "+sse2,+cx16");
+#else
+  return Test_LLVMCodeGenOptions(args, 3, "generic", "");
+#endif
+}
+
+// LLVM ignores CPUs and features it doesn't know (with a warning), which would silently compile for the default target
+bool Test_LLVMCodeGenOptions_InvalidTargetsAreRejected(TestArgs_t &args) {
+  auto isRejected = [&](const std::string& targetCPU, const std::string& targetFeatures) {
+    try {
+      Test_LLVMCodeGenOptions(args, 2, targetCPU, targetFeatures);
+    }
+    catch (const std::runtime_error&) {
+      return true;
+    }
+    return false;
+  };
+  Test_ASSERT(isRejected("not-a-cpu", ""));
+  Test_ASSERT(isRejected("", "+not-a-feature"));
+  return true;
+}
+
 } // test
-} // TreeBeard
\ No newline at end of file
+} // TreeBeard
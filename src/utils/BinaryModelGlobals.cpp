@@ -0,0 +1,174 @@
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "BinaryModelGlobals.h"
+
+namespace
+{
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return ((value + alignment - 1) / alignment) * alignment;
+}
+
+uint64_t GetSectionDataStart(int32_t numberOfEntries) {
+  auto tableSize = sizeof(mlir::decisionforest::BinaryModelGlobalsHeader) +
+                   numberOfEntries*sizeof(mlir::decisionforest::BinaryModelGlobalsEntry);
+  return AlignUp(tableSize, mlir::decisionforest::BinaryModelGlobalsAlignment);
+}
+
+}
+
+namespace mlir
+{
+namespace decisionforest
+{
+
+// ===---------------------------------------------------=== //
+// BinaryModelGlobalsWriter Methods
+// ===---------------------------------------------------=== //
+
+BinaryModelGlobalsWriter::BinaryModelGlobalsWriter(const BinaryModelGlobalsHeader& header)
+  :m_header(header)
+{
+  std::memcpy(m_header.magic, BinaryModelGlobalsMagic, sizeof(m_header.magic));
+  m_header.version = BinaryModelGlobalsVersion;
+  m_header.alignment = BinaryModelGlobalsAlignment;
+  m_header.fileSize = 0;
+  assert (m_header.numberOfEntries >= 0);
+  m_entries.resize(m_header.numberOfEntries);
+  std::memset(m_entries.data(), 0, m_entries.size()*sizeof(BinaryModelGlobalsEntry));
+}
+
+void BinaryModelGlobalsWriter::AddSectionImpl(int32_t entryIndex, BinaryModelGlobalsSectionKind kind, const void* data,
+                                              uint64_t numberOfElements, int32_t elementBitWidth, bool isFloat) {
+  auto& section = m_entries.at(entryIndex).sections[static_cast<int32_t>(kind)];
+  auto sectionStart = AlignUp(m_sectionData.size(), BinaryModelGlobalsAlignment);
+  auto sectionSize = numberOfElements * (elementBitWidth/8);
+  m_sectionData.resize(sectionStart + sectionSize, 0);
+  if (sectionSize != 0)
+    std::memcpy(m_sectionData.data() + sectionStart, data, sectionSize);
+  section.offset = sectionStart;
+  section.numberOfElements = numberOfElements;
+  section.elementBitWidth = elementBitWidth;
+  section.isFloat = isFloat ? 1 : 0;
+}
+
+void BinaryModelGlobalsWriter::Write(const std::string& filename) {
+  std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+  if (!fout)
+    throw std::runtime_error("Failed to open model globals file " + filename + " for writing");
+
+  auto dataStart = GetSectionDataStart(m_header.numberOfEntries);
+  for (auto& entry : m_entries)
+    for (auto& section : entry.sections)
+      section.offset += dataStart;
+  m_header.fileSize = dataStart + AlignUp(m_sectionData.size(), BinaryModelGlobalsAlignment);
+
+  fout.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+  fout.write(reinterpret_cast<const char*>(m_entries.data()), m_entries.size()*sizeof(BinaryModelGlobalsEntry));
+  std::vector<char> padding(dataStart - sizeof(m_header) - m_entries.size()*sizeof(BinaryModelGlobalsEntry), 0);
+  fout.write(padding.data(), padding.size());
+  m_sectionData.resize(m_header.fileSize - dataStart, 0);
+  fout.write(m_sectionData.data(), m_sectionData.size());
+  fout.close();
+
+  // Undo the fix up so that the writer can be written again
+  for (auto& entry : m_entries)
+    for (auto& section : entry.sections)
+      section.offset -= dataStart;
+}
+
+// ===---------------------------------------------------=== //
+// MappedBinaryModelGlobals Methods
+// ===---------------------------------------------------=== //
+
+MappedBinaryModelGlobals::MappedBinaryModelGlobals(const std::string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1)
+    throw std::runtime_error("Failed to open model globals file " + filename);
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0) {
+    close(fd);
+    throw std::runtime_error("Failed to read the size of model globals file " + filename);
+  }
+  m_size = static_cast<size_t>(fileStat.st_size);
+  if (m_size < sizeof(BinaryModelGlobalsHeader)) {
+    close(fd);
+    throw std::runtime_error("Model globals file " + filename + " is too small to be a binary model globals file");
+  }
+  void* base = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    throw std::runtime_error("Failed to map model globals file " + filename);
+  m_base = reinterpret_cast<char*>(base);
+
+  try {
+    Validate(filename);
+  }
+  catch (...) {
+    munmap(m_base, m_size);
+    throw;
+  }
+}
+
+void MappedBinaryModelGlobals::Validate(const std::string& filename) {
+  auto& header = GetHeader();
+  if (std::memcmp(header.magic, BinaryModelGlobalsMagic, sizeof(header.magic)) != 0)
+    throw std::runtime_error(filename + " is not a binary model globals file");
+  if (header.version != BinaryModelGlobalsVersion)
+    throw std::runtime_error("Unsupported binary model globals version " + std::to_string(header.version) + " in " + filename);
+  if (header.fileSize != m_size)
+    throw std::runtime_error("Binary model globals file " + filename + " is truncated");
+  if (header.numberOfEntries < 0 || GetSectionDataStart(header.numberOfEntries) > m_size)
+    throw std::runtime_error("Binary model globals file " + filename + " has a corrupt entry table");
+
+  auto entries = reinterpret_cast<const BinaryModelGlobalsEntry*>(m_base + sizeof(BinaryModelGlobalsHeader));
+  for (int32_t i=0 ; i<header.numberOfEntries ; ++i) {
+    auto& entry = entries[i];
+    for (auto& section : entry.sections) {
+      // Sections hold whole bytes, so the element width bounds the size even for garbage widths
+      uint64_t elementSize = static_cast<uint64_t>(section.elementBitWidth)/8;
+      if (section.elementBitWidth < 0 || section.offset > m_size ||
+          (elementSize != 0 && section.numberOfElements > (m_size - section.offset)/elementSize))
+        throw std::runtime_error("Binary model globals file " + filename + " has a section outside the file");
+    }
+    m_entryIndex[std::make_tuple(entry.tileSize, entry.thresholdBitWidth, entry.indexBitWidth)] = &entry;
+  }
+}
+
+MappedBinaryModelGlobals::~MappedBinaryModelGlobals() {
+  if (m_base)
+    munmap(m_base, m_size);
+}
+
+const BinaryModelGlobalsEntry& MappedBinaryModelGlobals::GetEntry(int32_t entryIndex) const {
+  assert (entryIndex >= 0 && entryIndex < GetHeader().numberOfEntries);
+  auto entries = reinterpret_cast<const BinaryModelGlobalsEntry*>(m_base + sizeof(BinaryModelGlobalsHeader));
+  return entries[entryIndex];
+}
+
+const BinaryModelGlobalsEntry* MappedBinaryModelGlobals::FindEntry(int32_t tileSize, int32_t thresholdBitWidth, int32_t indexBitWidth) const {
+  auto iter = m_entryIndex.find(std::make_tuple(tileSize, thresholdBitWidth, indexBitWidth));
+  return iter == m_entryIndex.end() ? nullptr : iter->second;
+}
+
+bool MappedBinaryModelGlobals::IsBinaryModelGlobalsFile(const std::string& filename) {
+  std::ifstream fin(filename, std::ios::binary);
+  char magic[sizeof(BinaryModelGlobalsMagic)];
+  if (!fin.read(magic, sizeof(magic)))
+    return false;
+  return std::memcmp(magic, BinaryModelGlobalsMagic, sizeof(magic)) == 0;
+}
+
+bool MappedBinaryModelGlobals::IsBinaryModelGlobalsFilePath(const std::string& filename) {
+  auto& extension = BinaryModelGlobalsFileExtension;
+  return filename.size() >= extension.size() &&
+         filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+} // decisionforest
+} // mlir
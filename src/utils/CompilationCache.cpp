@@ -0,0 +1,251 @@
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <unistd.h>
+#include "json.hpp"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/SHA1.h"
+#include "CompilationCache.h"
+#include "CompileUtils.h"
+#include "ModelSerializers.h"
+#include "Representations.h"
+#include "schedule.h"
+
+namespace
+{
+
+// Change this whenever the layout of cached artifacts or the generated code changes
+const std::string CacheFormatVersion = "treebeard-compilation-cache-11";
+
+std::atomic<int64_t> cacheHits(0);
+std::atomic<int64_t> cacheMisses(0);
+std::atomic<int64_t> compileCount(0);
+
+std::string ReadFileContents(const std::string& filename) {
+  std::ifstream fin(filename, std::ios::binary);
+  std::ostringstream contents;
+  contents << fin.rdbuf();
+  return contents.str();
+}
+
+// Write to a temporary file and rename it so that concurrent processes never see a partial entry
+std::string TemporaryPath(const std::string& path) {
+  return path + ".tmp" + std::to_string(getpid());
+}
+
+int32_t GetNumberOfTreesInXGBoostJSON(const std::string& modelJSONPath) {
+  if (TreeBeard::IsXGBoostMultiModelManifestPath(modelJSONPath)) {
+    int32_t numTrees = 0;
+    for (auto& modelPath : TreeBeard::ReadXGBoostMultiModelManifest(modelJSONPath))
+      numTrees += GetNumberOfTreesInXGBoostJSON(modelPath);
+    return numTrees;
+  }
+  auto modelJSON = TreeBeard::ReadXGBoostModel(modelJSONPath, [](nlohmann::json&) { });
+  auto& gbtreeParams = modelJSON["learner"]["gradient_booster"]["model"]["gbtree_model_param"];
+  return std::stoi(gbtreeParams["num_trees"].get<std::string>());
+}
+
+class KeyHasher {
+  llvm::SHA1 m_hasher;
+public:
+  template<typename T>
+  void Add(const std::string& name, const T& value) {
+    std::ostringstream field;
+    field.precision(std::numeric_limits<double>::max_digits10);
+    field << name << "=" << value << ";";
+    m_hasher.update(field.str());
+  }
+  std::string Final() {
+    auto hash = m_hasher.final();
+    return llvm::toHex(hash, /*LowerCase=*/true);
+  }
+};
+
+}
+
+namespace TreeBeard
+{
+
+CompilationCache::CompilationCache(const std::string& directory)
+  :m_directory(directory)
+{
+  std::filesystem::create_directories(m_directory);
+}
+
+static void AddModelAndOptionsToKey(KeyHasher& hasher, const std::string& modelPath, const CompilerOptions& options) {
+  hasher.Add("version", CacheFormatVersion);
+  // Object code is compiled for the host
+  hasher.Add("hostCPU", llvm::sys::getHostCPUName().str());
+  hasher.Add("model", ReadFileContents(modelPath));
+  // The manifest only names the models
+  if (IsXGBoostMultiModelManifestPath(modelPath)) {
+    for (auto& manifestModelPath : ReadXGBoostMultiModelManifest(modelPath))
+      hasher.Add("manifestModel", ReadFileContents(manifestModelPath));
+  }
+
+  hasher.Add("numberOfFeatures", options.numberOfFeatures);
+  hasher.Add("batchSize", options.batchSize);
+  hasher.Add("tileSize", options.tileSize);
+  hasher.Add("thresholdTypeWidth", options.thresholdTypeWidth);
+  hasher.Add("returnTypeWidth", options.returnTypeWidth);
+  hasher.Add("returnTypeFloatType", options.returnTypeFloatType);
+  hasher.Add("featureIndexTypeWidth", options.featureIndexTypeWidth);
+  hasher.Add("nodeIndexTypeWidth", options.nodeIndexTypeWidth);
+  hasher.Add("inputElementTypeWidth", options.inputElementTypeWidth);
+  hasher.Add("tileShapeBitWidth", options.tileShapeBitWidth);
+  hasher.Add("childIndexBitWidth", options.childIndexBitWidth);
+  hasher.Add("tilingType", static_cast<int32_t>(options.tilingType));
+  hasher.Add("makeAllLeavesSameDepth", options.makeAllLeavesSameDepth);
+  hasher.Add("reorderTreesByDepth", options.reorderTreesByDepth);
+  hasher.Add("pipelineSize", options.pipelineSize);
+  hasher.Add("numberOfCores", options.numberOfCores);
+  hasher.Add("dynamicBatch", options.dynamicBatch);
+  hasher.Add("inputLayout", static_cast<int32_t>(options.inputLayout));
+  hasher.Add("earlyExitThreshold", options.earlyExitThreshold);
+  hasher.Add("quantizeInputs", options.quantizeInputs);
+  hasher.Add("peeledCodeGenForProbabilityBasedTiling", options.peeledCodeGenForProbabilityBasedTiling);
+  hasher.Add("sparseRepresentation", options.sparseRepresentation);
+  hasher.Add("returnAllOutputs", options.returnAllOutputs);
+  hasher.Add("profileLeafHits", options.profileLeafHits);
+  hasher.Add("featureGroupBatchTileSize", options.featureGroupBatchTileSize);
+  hasher.Add("optimizationLevel", options.optimizationLevel);
+  hasher.Add("targetCPU", options.targetCPU);
+  hasher.Add("targetFeatures", options.targetFeatures);
+  // The tiling depends on the profile, not on where it is stored
+  if (!options.statsProfileCSVPath.empty())
+    hasher.Add("statsProfile", ReadFileContents(options.statsProfileCSVPath));
+
+  hasher.Add("InsertDebugHelpers", mlir::decisionforest::InsertDebugHelpers);
+  hasher.Add("PrintVectors", mlir::decisionforest::PrintVectors);
+  hasher.Add("UseBitcastForComparisonOutcome", mlir::decisionforest::UseBitcastForComparisonOutcome);
+}
+
+std::string CompilationCache::ComputeKey(const std::string& modelPath, const CompilerOptions& options) {
+  KeyHasher hasher;
+  AddModelAndOptionsToKey(hasher, modelPath, options);
+  if (options.scheduleManipulator) {
+    // Only the number of trees is needed. The trees are skipped as they are streamed, so no model DOM is built.
+    mlir::decisionforest::Schedule schedule(options.batchSize, GetNumberOfTreesInXGBoostJSON(modelPath));
+    options.scheduleManipulator->Run(&schedule);
+    hasher.Add("schedule", schedule.PrintToString());
+  }
+  return hasher.Final();
+}
+
+std::string CompilationCache::ComputeKey(TreebeardContext& tbContext) {
+  if (!std::filesystem::is_regular_file(tbContext.modelPath) ||
+      tbContext.forestCreatorType.empty() || tbContext.representationName.empty() ||
+      !tbContext.forestConstructor || !tbContext.forestConstructor->GetSchedule())
+    return "";
+  KeyHasher hasher;
+  AddModelAndOptionsToKey(hasher, tbContext.modelPath, tbContext.options);
+  hasher.Add("forestCreator", tbContext.forestCreatorType);
+  hasher.Add("representation", tbContext.representationName);
+  // Schedule changes made through the schedule API are already applied to the HIR's schedule
+  hasher.Add("schedule", tbContext.forestConstructor->GetSchedule()->PrintToString());
+  return hasher.Final();
+}
+
+std::string CompilationCache::ObjectFilePath(const std::string& key) {
+  return m_directory + "/" + key + ".o";
+}
+
+std::string CompilationCache::ModelGlobalsFilePath(const std::string& key) {
+  return m_directory + "/" + key + ".treebeard-globals.json";
+}
+
+std::string CompilationCache::CompileModelGlobalsFilePath(const std::string& key) {
+  return TemporaryPath(ModelGlobalsFilePath(key)) + "-" + std::to_string(compileCount++);
+}
+
+std::string TemporaryModelGlobalsFilePath() {
+  auto fileName = "treebeard-globals-" + std::to_string(getpid()) + "-" + std::to_string(compileCount++) + ".json";
+  return (std::filesystem::temp_directory_path() / fileName).string();
+}
+
+mlir::decisionforest::InferenceRunnerBase* CompilationCache::Load(const std::string& key, const CompilerOptions& options,
+                                                                  std::shared_ptr<mlir::decisionforest::IModelSerializer> serializer) {
+  auto objectFilePath = ObjectFilePath(key);
+  if (!std::filesystem::exists(objectFilePath)) {
+    ++cacheMisses;
+    return nullptr;
+  }
+  if (!serializer)
+    serializer = mlir::decisionforest::ConstructModelSerializer(ModelGlobalsFilePath(key), options.sparseRepresentation);
+  auto inferenceRunner = mlir::decisionforest::ObjectFileInferenceRunner::Load(serializer, objectFilePath, options.tileSize,
+                                                                               options.thresholdTypeWidth, options.featureIndexTypeWidth);
+  // Unreadable entries (for example, truncated by a full disk) are recompiled and overwritten
+  if (!inferenceRunner) {
+    ++cacheMisses;
+    return nullptr;
+  }
+  ++cacheHits;
+  return inferenceRunner;
+}
+
+void CompilationCache::Store(const std::string& key, mlir::decisionforest::InferenceRunner& inferenceRunner,
+                             const std::string& compileModelGlobalsFilePath) {
+  // The object file is written last since its presence marks the entry as complete.
+  // CPU models embed their buffers in the generated code, so there may be no globals file.
+  // The globals written by this compilation are moved in so that the entry can't pick up
+  // a file another compilation of the model wrote in the meantime.
+  if (std::filesystem::exists(compileModelGlobalsFilePath))
+    std::filesystem::rename(compileModelGlobalsFilePath, ModelGlobalsFilePath(key));
+
+  auto objectFilePath = ObjectFilePath(key);
+  auto tempObjectFilePath = TemporaryPath(objectFilePath);
+  inferenceRunner.DumpObjectFile(tempObjectFilePath);
+  std::filesystem::rename(tempObjectFilePath, objectFilePath);
+}
+
+CompilationCacheStatistics CompilationCache::GetStatistics() {
+  CompilationCacheStatistics statistics;
+  statistics.hits = cacheHits;
+  statistics.misses = cacheMisses;
+  return statistics;
+}
+
+void CompilationCache::ResetStatistics() {
+  cacheHits = 0;
+  cacheMisses = 0;
+}
+
+mlir::decisionforest::InferenceRunnerBase* ConstructInferenceRunnerForXGBoostJSON(const std::string& modelJSONPath,
+                                                                                 CompilerOptions& options) {
+  std::unique_ptr<CompilationCache> cache;
+  std::string key;
+  if (!options.compilationCacheDirectory.empty()) {
+    cache = std::make_unique<CompilationCache>(options.compilationCacheDirectory);
+    key = cache->ComputeKey(modelJSONPath, options);
+    if (auto inferenceRunner = cache->Load(key, options))
+      return inferenceRunner;
+  }
+
+  auto modelGlobalsJSONPath = cache ? cache->CompileModelGlobalsFilePath(key) : TemporaryModelGlobalsFilePath();
+  TreebeardContext tbContext(modelJSONPath,
+                             modelGlobalsJSONPath,
+                             options,
+                             mlir::decisionforest::ConstructRepresentation(options.sparseRepresentation),
+                             mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath, options.sparseRepresentation),
+                             nullptr  /*TODO_ForestCreator*/);
+  auto module = ConstructLLVMDialectModuleFromXGBoostJSON(tbContext);
+  auto inferenceRunner = new mlir::decisionforest::InferenceRunner(tbContext.serializer, module,
+                                                                   options.tileSize, options.thresholdTypeWidth,
+                                                                   options.featureIndexTypeWidth,
+                                                                   options.GetLLVMCodeGenOptions(),
+                                                                   cache != nullptr /*enableObjectDump*/);
+  if (cache) {
+    cache->Store(key, *inferenceRunner, modelGlobalsJSONPath);
+  }
+  else {
+    // CPU models embed their buffers in the generated code and don't read the globals back
+    std::error_code errorCode;
+    std::filesystem::remove(modelGlobalsJSONPath, errorCode);
+  }
+  return inferenceRunner;
+}
+
+} // TreeBeard
@@ -0,0 +1,60 @@
+#ifndef _COMPILATIONCACHE_H_
+#define _COMPILATIONCACHE_H_
+
+#include <cstdint>
+#include <string>
+#include "TreebeardContext.h"
+#include "ExecutionHelpers.h"
+
+namespace TreeBeard
+{
+
+struct CompilationCacheStatistics {
+  int64_t hits = 0;
+  int64_t misses = 0;
+};
+
+// An on-disk cache of JIT compiled models. Entries hold the object code generated for the
+// model and, when the serializer writes one, the model globals file. They are keyed by a hash of the
+// model file contents, every CompilerOptions field, the schedule and the code generation flags.
+class CompilationCache {
+  std::string m_directory;
+public:
+  CompilationCache(const std::string& directory);
+
+  // Key of an XGBoost JSON model
+  std::string ComputeKey(const std::string& modelPath, const CompilerOptions& options);
+  // Key of a model whose HIR has been built by any forest creator, using the HIR's schedule. Empty if
+  // the model wasn't read from a file or the creator and representation weren't set by name (so it can't be cached).
+  std::string ComputeKey(TreebeardContext& tbContext);
+  std::string ObjectFilePath(const std::string& key);
+  std::string ModelGlobalsFilePath(const std::string& key);
+  // A path, unique to this compilation, for the model globals of a model that will be stored under key
+  std::string CompileModelGlobalsFilePath(const std::string& key);
+
+  // Returns a runner for the cached entry or nullptr if there is no usable entry for the key. The
+  // runner uses serializer if it is given and the default serializer for the entry otherwise.
+  mlir::decisionforest::InferenceRunnerBase* Load(const std::string& key, const CompilerOptions& options,
+                                                  std::shared_ptr<mlir::decisionforest::IModelSerializer> serializer=nullptr);
+  // The runner must have been constructed with enableObjectDump set. The globals file the compilation
+  // wrote (at CompileModelGlobalsFilePath(key)), if any, is moved into the entry.
+  void Store(const std::string& key, mlir::decisionforest::InferenceRunner& inferenceRunner,
+             const std::string& compileModelGlobalsFilePath);
+
+  // Hit and miss counts over all caches in this process
+  static CompilationCacheStatistics GetStatistics();
+  static void ResetStatistics();
+};
+
+// A path in the temporary directory, unique to this compilation, for the model globals of a model that isn't
+// cached. Concurrent compilations of the same model would otherwise write the same file.
+std::string TemporaryModelGlobalsFilePath();
+
+// Construct an inference runner for an XGBoost JSON model. If options.compilationCacheDirectory
+// is set, cached artifacts are reused when present and stored after compilation otherwise.
+mlir::decisionforest::InferenceRunnerBase* ConstructInferenceRunnerForXGBoostJSON(const std::string& modelJSONPath,
+                                                                                 CompilerOptions& options);
+
+} // TreeBeard
+
+#endif // _COMPILATIONCACHE_H_
@@ -2,6 +2,7 @@
 #include <sstream>
 #include <chrono>
 #include <iostream>
+#include <stdexcept>
 #include "Dialect.h"
 #include "TestUtilsCommon.h"
 
@@ -40,11 +41,11 @@ namespace Logging
 {
 
 LoggingOptions::LoggingOptions() 
-  : logGenCodeStats(false), logTreeStats(false)
+  : logGenCodeStats(false), logTreeStats(false), logCompileTimes(false)
 { }
 
 bool LoggingOptions::ShouldEnableLogging() {
-  return logGenCodeStats || logTreeStats;
+  return logGenCodeStats || logTreeStats || logCompileTimes;
 }
 
 LoggingOptions loggingOptions;
@@ -52,6 +53,7 @@ LoggingOptions loggingOptions;
 bool InitLoggingOptions() {
   loggingOptions.logGenCodeStats = false;
   loggingOptions.logTreeStats = false;
+  loggingOptions.logCompileTimes = false;
   return loggingOptions.ShouldEnableLogging();
 }
 
@@ -181,15 +183,16 @@ void ConvertONNXModelToLLVMIR(TreebeardContext& tbContext, const std::string& ll
       parsedModel.trueNodeIds, parsedModel.falseNodeIds,
       parsedModel.numberOfClasses, parsedModel.targetClassTreeId,
       parsedModel.targetClassNodeId, parsedModel.targetClassIds,
-      parsedModel.targetWeights, parsedModel.numWeights, tbContext.options.batchSize);
+      parsedModel.targetWeights, parsedModel.numWeights, tbContext.options.batchSize,
+      parsedModel.nodeModes.empty() ? nullptr : parsedModel.nodeModes.data(), parsedModel.reductionType);
 
   mlir::ModuleOp module = TreeBeard::ConstructLLVMDialectModuleFromForestCreator(tbContext, onnxModelConverter);
-  mlir::decisionforest::dumpLLVMIRToFile(module, llvmIRFilePath);
+  mlir::decisionforest::dumpLLVMIRToFile(module, llvmIRFilePath, tbContext.options.GetLLVMCodeGenOptions());
 }
 
 void ConvertXGBoostJSONToLLVMIR(TreebeardContext& tbContext, const std::string& llvmIRFilePath) {
   auto module = ConstructLLVMDialectModuleFromXGBoostJSON(tbContext);
-  mlir::decisionforest::dumpLLVMIRToFile(module, llvmIRFilePath);
+  mlir::decisionforest::dumpLLVMIRToFile(module, llvmIRFilePath, tbContext.options.GetLLVMCodeGenOptions());
 }
 
 template<typename FloatType, typename ReturnType=FloatType>
@@ -233,7 +236,7 @@ int64_t RunXGBoostInferenceOnCSVInput(const std::string& csvPath, mlir::decision
 
 void RunInferenceUsingSO(const std::string& soPath, const std::string& modelGlobalsJSONPath, 
                          const std::string& csvPath, const CompilerOptions& options) {
-  auto serializer = mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath);
+  auto serializer = mlir::decisionforest::ConstructModelSerializer(modelGlobalsJSONPath, options.sparseRepresentation);
   mlir::decisionforest::SharedObjectInferenceRunner inferenceRunner(serializer, soPath, options.tileSize, options.thresholdTypeWidth, options.featureIndexTypeWidth);
   int64_t time;
   if (options.returnTypeFloatType){ 
@@ -278,6 +281,20 @@ void SetTilingTypeFromConfigJSON(json& configJSON, TreeBeard::TilingType& field)
   }
 }
 
+void SetInputLayoutFromConfigJSON(json& configJSON, mlir::decisionforest::InputLayout& field) {
+  if (configJSON.contains("inputLayout")) {
+    auto inputLayoutStr = configJSON["inputLayout"].get<std::string>();
+    if (inputLayoutStr == "RowMajor")
+      field = mlir::decisionforest::InputLayout::kRowMajor;
+    else if (inputLayoutStr == "Strided")
+      field = mlir::decisionforest::InputLayout::kStrided;
+    else if (inputLayoutStr == "ColumnMajor")
+      field = mlir::decisionforest::InputLayout::kColumnMajor;
+    else
+      throw std::runtime_error("Invalid input layout " + inputLayoutStr);
+  }
+}
+
 CompilerOptions::CompilerOptions(const std::string& configJSONFilePath) 
   :CompilerOptions()
 {
@@ -301,6 +318,19 @@ CompilerOptions::CompilerOptions(const std::string& configJSONFilePath)
   SetFieldFromJSONIfPresent(configJSON, "pipelineSize", pipelineSize);
   SetFieldFromJSONIfPresent(configJSON, "statsProfileCSVPath", statsProfileCSVPath);
   SetFieldFromJSONIfPresent(configJSON, "numberOfCores", numberOfCores);
+  SetFieldFromJSONIfPresent(configJSON, "dynamicBatch", dynamicBatch);
+  SetInputLayoutFromConfigJSON(configJSON, inputLayout);
+  SetFieldFromJSONIfPresent(configJSON, "earlyExitThreshold", earlyExitThreshold);
+  SetFieldFromJSONIfPresent(configJSON, "featureGroupBatchTileSize", featureGroupBatchTileSize);
+  SetFieldFromJSONIfPresent(configJSON, "quantizeInputs", quantizeInputs);
+  SetFieldFromJSONIfPresent(configJSON, "peeledCodeGenForProbabilityBasedTiling", peeledCodeGenForProbabilityBasedTiling);
+  SetFieldFromJSONIfPresent(configJSON, "sparseRepresentation", sparseRepresentation);
+  SetFieldFromJSONIfPresent(configJSON, "returnAllOutputs", returnAllOutputs);
+  SetFieldFromJSONIfPresent(configJSON, "profileLeafHits", profileLeafHits);
+  SetFieldFromJSONIfPresent(configJSON, "optimizationLevel", optimizationLevel);
+  SetFieldFromJSONIfPresent(configJSON, "targetCPU", targetCPU);
+  SetFieldFromJSONIfPresent(configJSON, "targetFeatures", targetFeatures);
+  SetFieldFromJSONIfPresent(configJSON, "compilationCacheDirectory", compilationCacheDirectory);
 }
 
 } // TreeBeard
\ No newline at end of file
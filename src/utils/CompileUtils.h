@@ -2,17 +2,60 @@
 #define _COMPILEUTILS_H_
 
 #include "Dialect.h"
+#include "Logger.h"
 #include "forestcreator.h"
 #include "xgboostparser.h"
 #include "TreebeardContext.h"
 
+#include <stdexcept>
+
 namespace TreeBeard
 {
+// Early exit walks the trees of each row in order of their contribution in a tree loop of its own, so it can't be 
+// combined with anything else that orders or schedules the trees
+inline void CheckEarlyExitOptions(const CompilerOptions& options) {
+  if (options.earlyExitThreshold < 0.0)
+    return;
+  if (options.reorderTreesByDepth || options.featureGroupBatchTileSize > 0)
+    throw std::runtime_error("Early exit needs trees to be ordered by their contribution");
+  if (options.scheduleManipulator)
+    throw std::runtime_error("Early exit is only supported with the default schedule");
+  if (options.profileLeafHits)
+    throw std::runtime_error("Leaf hits can only be profiled when trees are walked in model order");
+}
+
+// Schedules can also be changed directly (e.g. through the Python API) between building the HIR and lowering it
+inline void CheckEarlyExitSchedule(mlir::ModuleOp module) {
+  module.walk([](mlir::decisionforest::PredictForestOp predictOp) {
+    auto schedule = predictOp.getSchedule().GetSchedule();
+    auto& treeIndex = schedule->GetTreeIndex();
+    if (!treeIndex.EarlyExit())
+      return;
+    auto range = treeIndex.GetRange();
+    if (!schedule->IsDefaultSchedule() || treeIndex.Unroll() || treeIndex.Pipelined() || range.m_step != 1)
+      throw std::runtime_error("Early exit is only supported with the default schedule");
+  });
+}
+
 inline mlir::ModuleOp BuildHIRModule(TreebeardContext &tbContext, ForestCreator &forestCreator) {
   const CompilerOptions& options=tbContext.options;
+  CheckEarlyExitOptions(options);
   
+  TreeBeard::Logging::PhaseTimer timer("Build HIR");
   forestCreator.ConstructForest();
   forestCreator.SetChildIndexBitWidth(options.childIndexBitWidth);
+  forestCreator.SetDynamicBatch(options.dynamicBatch);
+  forestCreator.SetInputLayout(options.inputLayout);
+  forestCreator.SetEarlyExitThreshold(options.earlyExitThreshold);
+  forestCreator.SetQuantizeInputs(options.quantizeInputs);
+  forestCreator.SetReturnAllOutputs(options.returnAllOutputs);
+  if (options.profileLeafHits) {
+    assert (options.tileSize == 1 && options.tilingType == TilingType::kUniform && !options.makeAllLeavesSameDepth &&
+            "Leaf hits can only be profiled on untiled trees");
+    assert (!options.reorderTreesByDepth && !options.scheduleManipulator &&
+            "Leaf hits can only be profiled when trees are walked in model order");
+  }
+  forestCreator.SetProfileLeafHits(options.profileLeafHits);
   auto module = forestCreator.GetEvaluationFunction();
   
   return module;
@@ -23,13 +66,16 @@ inline void DoTilingTransformation(mlir::ModuleOp module,
   const CompilerOptions& options=tbContext.options;
   auto& context = tbContext.context;
 
+  TreeBeard::Logging::PhaseTimer timer("Tiling");
   // TODO maybe all the manipulation before the lowering to mid-level IR can be a single custom function?
   if (options.tilingType==TilingType::kUniform)
     mlir::decisionforest::DoUniformTiling(context, module, options.tileSize, options.tileShapeBitWidth, options.makeAllLeavesSameDepth);
+  else if (options.tilingType==TilingType::kProbabilistic || options.tilingType==TilingType::kHybrid)
+    mlir::decisionforest::DoProbabilityBasedTiling(context, module, options.tileSize, options.tileShapeBitWidth,
+                                                   options.peeledCodeGenForProbabilityBasedTiling);
   else if (options.tilingType==TilingType::kHybrid)
-    mlir::decisionforest::DoProbabilityBasedTiling(context, module, options.tileSize, options.tileShapeBitWidth);
-  else if (options.tilingType==TilingType::kHybrid)
-    mlir::decisionforest::DoHybridTiling(context, module, options.tileSize, options.tileShapeBitWidth);
+    mlir::decisionforest::DoHybridTiling(context, module, options.tileSize, options.tileShapeBitWidth,
+                                         options.peeledCodeGenForProbabilityBasedTiling);
   else
     assert (false && "Unknown tiling type");
 }
@@ -38,18 +84,41 @@ inline void LowerHIRModuleToLLVM(mlir::ModuleOp module, TreebeardContext &tbCont
   const CompilerOptions& options=tbContext.options;
   auto& context = tbContext.context;
 
-  // TODO this needs to change to something that knows how to do all schedule manipulation
-  if (options.reorderTreesByDepth) {
-    assert(options.pipelineSize == -1 || (options.pipelineSize <= options.batchSize));
-    mlir::decisionforest::DoReorderTreesByDepth(context, module, options.pipelineSize, options.numberOfCores);
-    assert (!options.scheduleManipulator && "Cannot have a custom schedule manipulator and the inbuilt one together");
+  {
+    TreeBeard::Logging::PhaseTimer timer("Reorder trees");
+    // TODO this needs to change to something that knows how to do all schedule manipulation
+    if (options.reorderTreesByDepth) {
+      assert(options.pipelineSize == -1 || (options.pipelineSize <= options.batchSize));
+      mlir::decisionforest::DoReorderTreesByDepth(context, module, options.pipelineSize, options.numberOfCores);
+      assert (!options.scheduleManipulator && "Cannot have a custom schedule manipulator and the inbuilt one together");
+    }
+    if (options.featureGroupBatchTileSize > 0) {
+      assert (!options.reorderTreesByDepth && "Trees can only be ordered one way");
+      assert (!options.scheduleManipulator && "Cannot have a custom schedule manipulator and the inbuilt one together");
+      assert (!options.profileLeafHits && "Leaf hits are counted with trees walked in model order");
+      mlir::decisionforest::DoGroupTreesByFeatures(context, module, options.featureGroupBatchTileSize, options.inputElementTypeWidth);
+    }
+    if (options.earlyExitThreshold >= 0.0) {
+      CheckEarlyExitOptions(options);
+      CheckEarlyExitSchedule(module);
+      mlir::decisionforest::DoReorderTreesByContribution(context, module);
+    }
+  }
+  {
+    TreeBeard::Logging::PhaseTimer timer("Lower to mid level IR");
+    mlir::decisionforest::LowerFromHighLevelToMidLevelIR(context, module);
   }
-  mlir::decisionforest::LowerFromHighLevelToMidLevelIR(context, module);
   // module->dump();
-  mlir::decisionforest::LowerEnsembleToMemrefs(context, module, tbContext.serializer, tbContext.representation);
-  mlir::decisionforest::ConvertNodeTypeToIndexType(context, module);
+  {
+    TreeBeard::Logging::PhaseTimer timer("Lower ensemble to memrefs");
+    mlir::decisionforest::LowerEnsembleToMemrefs(context, module, tbContext.serializer, tbContext.representation);
+    mlir::decisionforest::ConvertNodeTypeToIndexType(context, module);
+  }
   // module->dump();
-  mlir::decisionforest::LowerToLLVM(context, module, tbContext.representation);
+  {
+    TreeBeard::Logging::PhaseTimer timer("Lower to LLVM dialect");
+    mlir::decisionforest::LowerToLLVM(context, module, tbContext.representation);
+  }
   // mlir::decisionforest::dumpLLVMIR(module, false);
 }
 
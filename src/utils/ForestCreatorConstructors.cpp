@@ -0,0 +1,152 @@
+#include "xgboostparser.h"
+#include "lightgbmparser.h"
+#include "sklearnparser.h"
+#include "TreebeardContext.h"
+
+using namespace TreeBeard;
+
+namespace
+{
+
+// The model parsers are templated on the types of the generated code. ParserType is instantiated with the
+// types selected by the compiler options.
+template<template<typename, typename, typename, typename, typename> class ParserType,
+         typename ThresholdType, typename ReturnType, typename FeatureIndexType, typename NodeIndexType>
+std::shared_ptr<ForestCreator> SpecializeInputElementType(mlir::MLIRContext& context, TreebeardContext& tbContext) {
+  auto& options = tbContext.options;
+  auto& modelJsonPath = tbContext.modelPath;
+
+  if (options.inputElementTypeWidth == 32) {
+    auto parser = std::make_shared<ParserType<ThresholdType,
+                                              ReturnType,
+                                              FeatureIndexType,
+                                              NodeIndexType,
+                                              float>>(context,
+                                                      modelJsonPath,
+                                                      tbContext.serializer,
+                                                      options.statsProfileCSVPath,
+                                                      options.batchSize);
+    return parser;
+  }
+  else if (options.inputElementTypeWidth == 64) {
+    auto parser = std::make_shared<ParserType<ThresholdType,
+                                              ReturnType,
+                                              FeatureIndexType,
+                                              NodeIndexType,
+                                              double>>(context,
+                                                       modelJsonPath,
+                                                       tbContext.serializer,
+                                                       options.statsProfileCSVPath,
+                                                       options.batchSize);
+    return parser;
+  }
+  else {
+    assert (false && "Unknown input element type");
+  }
+  return nullptr;
+}
+
+template<template<typename, typename, typename, typename, typename> class ParserType,
+         typename ThresholdType, typename ReturnType, typename FeatureIndexType>
+std::shared_ptr<ForestCreator> SpecializeNodeIndexType(mlir::MLIRContext& context, TreebeardContext& tbContext) {
+  auto& options = tbContext.options;
+  if (options.nodeIndexTypeWidth == 8) {
+    return SpecializeInputElementType<ParserType, ThresholdType, ReturnType, FeatureIndexType, int8_t>(context, tbContext);
+  }
+  else if (options.nodeIndexTypeWidth == 16) {
+    return SpecializeInputElementType<ParserType, ThresholdType, ReturnType, FeatureIndexType, int16_t>(context, tbContext);
+  }
+  else if (options.nodeIndexTypeWidth == 32) {
+    return SpecializeInputElementType<ParserType, ThresholdType, ReturnType, FeatureIndexType, int32_t>(context, tbContext);
+  }
+  else if (options.nodeIndexTypeWidth == 64) {
+    return SpecializeInputElementType<ParserType, ThresholdType, ReturnType, FeatureIndexType, int64_t>(context, tbContext);
+  }
+  else {
+    assert (false && "Unknown feature index type");
+  }
+  return nullptr;
+}
+
+template<template<typename, typename, typename, typename, typename> class ParserType,
+         typename ThresholdType, typename ReturnType>
+std::shared_ptr<ForestCreator> SpecializeFeatureIndexType(mlir::MLIRContext& context, TreebeardContext& tbContext) {
+  auto& options = tbContext.options;
+  if (options.featureIndexTypeWidth == 8) {
+    return SpecializeNodeIndexType<ParserType, ThresholdType, ReturnType, int8_t>(context, tbContext);
+  }
+  else if (options.featureIndexTypeWidth == 16) {
+    return SpecializeNodeIndexType<ParserType, ThresholdType, ReturnType, int16_t>(context, tbContext);
+  }
+  else if (options.featureIndexTypeWidth == 32) {
+    return SpecializeNodeIndexType<ParserType, ThresholdType, ReturnType, int32_t>(context, tbContext);
+  }
+  else if (options.featureIndexTypeWidth == 64) {
+    return SpecializeNodeIndexType<ParserType, ThresholdType, ReturnType, int64_t>(context, tbContext);
+  }
+  else {
+    assert (false && "Unknown feature index type");
+  }
+  return nullptr;
+}
+
+template<template<typename, typename, typename, typename, typename> class ParserType,
+         typename ThresholdType>
+std::shared_ptr<ForestCreator> SpecializeReturnType(mlir::MLIRContext& context, TreebeardContext& tbContext) {
+  auto& options = tbContext.options;
+  if (options.returnTypeFloatType) {
+    if (options.returnTypeWidth == 32) {
+      return SpecializeFeatureIndexType<ParserType, ThresholdType, float>(context, tbContext);
+    }
+    else if (options.returnTypeWidth == 64) {
+      return SpecializeFeatureIndexType<ParserType, ThresholdType, double>(context, tbContext);
+    }
+    else {
+      assert (false && "Unknown return type");
+    }
+  }
+  else {
+    if (options.returnTypeWidth == 8) {
+      return SpecializeFeatureIndexType<ParserType, ThresholdType, int8_t>(context, tbContext);
+    }
+    else {
+      assert (false && "Unknown return type");
+    }
+  }
+  return nullptr;
+}
+
+template<template<typename, typename, typename, typename, typename> class ParserType>
+std::shared_ptr<ForestCreator> SpecializeThresholdType(TreebeardContext& tbContext) {
+  auto& options = tbContext.options;
+  mlir::MLIRContext& context = tbContext.context;
+  if (options.thresholdTypeWidth == 32) {
+    return SpecializeReturnType<ParserType, float>(context, tbContext);
+  }
+  else if (options.thresholdTypeWidth == 64) {
+    return SpecializeReturnType<ParserType, double>(context, tbContext);
+  }
+  else {
+    assert (false && "Unknown threshold type");
+  }
+  return nullptr;
+}
+
+} // anonymous namespace
+
+namespace TreeBeard
+{
+
+std::shared_ptr<ForestCreator> ConstructXGBoostJSONParser(TreebeardContext& tbContext) {
+  return SpecializeThresholdType<XGBoostJSONParser>(tbContext);
+}
+
+std::shared_ptr<ForestCreator> ConstructLightGBMTextParser(TreebeardContext& tbContext) {
+  return SpecializeThresholdType<LightGBMTextParser>(tbContext);
+}
+
+std::shared_ptr<ForestCreator> ConstructSKLearnJSONParser(TreebeardContext& tbContext) {
+  return SpecializeThresholdType<SKLearnJSONParser>(tbContext);
+}
+
+}
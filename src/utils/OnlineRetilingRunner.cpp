@@ -0,0 +1,218 @@
+#include <cassert>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+#include <unistd.h>
+#include "DecisionForest.h"
+#include "xgboostparser.h"
+#include "ModelSerializers.h"
+#include "CompilationCache.h"
+#include "StatsUtils.h"
+#include "OnlineRetilingRunner.h"
+
+namespace
+{
+
+// The probability of each leaf (in node order) of each tree. Trees none of whose leaves were hit get an empty distribution.
+std::vector<std::vector<double>> GetLeafDistributions(mlir::decisionforest::DecisionForest& decisionForest) {
+  std::vector<std::vector<double>> distributions(decisionForest.NumTrees());
+  for (size_t i=0 ; i<decisionForest.NumTrees() ; ++i) {
+    std::vector<double> hitCounts;
+    double totalHitCount = 0.0;
+    for (auto& node : decisionForest.GetTree(i).GetNodes()) {
+      if (!node.IsLeaf())
+        continue;
+      hitCounts.push_back(node.hitCount);
+      totalHitCount += node.hitCount;
+    }
+    if (totalHitCount == 0.0)
+      continue;
+    for (auto& hitCount : hitCounts)
+      hitCount /= totalHitCount;
+    distributions[i] = hitCounts;
+  }
+  return distributions;
+}
+
+double ComputeDrift(const std::vector<std::vector<double>>& baseline, const std::vector<std::vector<double>>& sampled) {
+  assert (baseline.size() == sampled.size());
+  double totalDistance = 0.0;
+  int64_t numTrees = 0;
+  for (size_t i=0 ; i<baseline.size() ; ++i) {
+    if (sampled[i].empty())
+      continue;
+    double distance = 0.0;
+    if (baseline[i].empty()) {
+      // Nothing was known about the tree
+      distance = 1.0;
+    }
+    else {
+      assert (baseline[i].size() == sampled[i].size());
+      for (size_t j=0 ; j<sampled[i].size() ; ++j)
+        distance += std::fabs(sampled[i][j] - baseline[i][j]);
+      distance /= 2.0;
+    }
+    totalDistance += distance;
+    ++numTrees;
+  }
+  return numTrees == 0 ? 0.0 : totalDistance / numTrees;
+}
+
+std::atomic<int64_t> onlineRunnerCount(0);
+
+}
+
+namespace TreeBeard
+{
+
+OnlineRetilingRunner::OnlineRetilingRunner(const std::string& modelJSONPath, const std::string& profileCSVPath,
+                                           const CompilerOptions& options, const OnlineRetilingOptions& retilingOptions)
+  : m_modelJSONPath(modelJSONPath), m_profileCSVPath(profileCSVPath), m_options(options), m_retilingOptions(retilingOptions),
+    m_sampledRowsSinceCheck(0), m_samplingThreadBusy(false), m_stopSampling(false), m_callCount(0), m_sampledRowCount(0),
+    m_recompileCount(0), m_drift(0.0)
+{
+  assert (m_options.tilingType != TilingType::kUniform && "Online re-tiling needs a probability based tiling");
+  assert (m_retilingOptions.samplingFraction > 0.0 && m_retilingOptions.samplingFraction <= 1.0);
+  m_samplingInterval = std::max(int64_t(1), static_cast<int64_t>(std::round(1.0 / m_retilingOptions.samplingFraction)));
+  auto profileFileName = "treebeard-online-profile-" + std::to_string(getpid()) + "-" + std::to_string(onlineRunnerCount++) + ".csv";
+  m_onlineProfileCSVPath = (std::filesystem::temp_directory_path() / profileFileName).string();
+
+  m_countingRunner.reset(Profile::ConstructLeafHitCountingRunner(m_modelJSONPath, m_options));
+  m_options.statsProfileCSVPath = m_profileCSVPath;
+  m_inferenceRunner.reset(ConstructInferenceRunnerForXGBoostJSON(m_modelJSONPath, m_options));
+  if (m_options.numberOfCores > 1 && !m_options.reorderTreesByDepth)
+    m_inferenceRunner->SetNumberOfThreads(m_options.numberOfCores);
+
+  mlir::MLIRContext context;
+  TreeBeard::XGBoostJSONParser<> xgBoostParser(context, m_modelJSONPath, mlir::decisionforest::ConstructModelSerializer(""), 1);
+  xgBoostParser.ConstructForest();
+  auto decisionForest = xgBoostParser.GetForest();
+  Profile::ReadProbabilityProfile(*decisionForest, m_profileCSVPath);
+  m_baselineDistributions = GetLeafDistributions(*decisionForest);
+
+  m_samplingThread = std::thread([this]() { RunSamplingThread(); });
+}
+
+OnlineRetilingRunner::~OnlineRetilingRunner() {
+  {
+    std::lock_guard<std::mutex> lock(m_sampleQueueMutex);
+    m_stopSampling = true;
+  }
+  m_sampleQueueChanged.notify_all();
+  m_samplingThread.join();
+  std::error_code ec;
+  std::filesystem::remove(m_onlineProfileCSVPath, ec);
+}
+
+int32_t OnlineRetilingRunner::RunInferenceOnMultipleBatches(void *input, void *returnValue, int32_t numRows) {
+  // Hold a reference so that a concurrent swap can't free the runner while it is in use
+  auto inferenceRunner = std::atomic_load(&m_inferenceRunner);
+  auto retVal = inferenceRunner->RunInferenceOnMultipleBatches(input, returnValue, numRows);
+  if (m_callCount.fetch_add(1) % m_samplingInterval == 0)
+    SampleRows(input, numRows);
+  return retVal;
+}
+
+// Copies the rows for the sampling thread. Both models are compiled with the same options, so the rows are 
+// dense in the input layout the counting model expects.
+void OnlineRetilingRunner::SampleRows(void *input, int32_t numRows) {
+  {
+    std::lock_guard<std::mutex> lock(m_sampleQueueMutex);
+    if (m_sampleQueue.size() >= kMaxQueuedSamples)
+      return;
+  }
+  auto inputBytes = static_cast<size_t>(numRows) * m_countingRunner->GetRowSize() * (m_countingRunner->GetInputElementBitWidth()/8);
+  SampledRows sample{ std::vector<char>(inputBytes), numRows };
+  std::memcpy(sample.inputs.data(), input, inputBytes);
+  {
+    std::lock_guard<std::mutex> lock(m_sampleQueueMutex);
+    // Other calls may have filled the queue meanwhile
+    if (m_sampleQueue.size() >= kMaxQueuedSamples)
+      return;
+    m_sampleQueue.push_back(std::move(sample));
+  }
+  m_sampleQueueChanged.notify_all();
+}
+
+void OnlineRetilingRunner::RunSamplingThread() {
+  while (true) {
+    SampledRows sample;
+    {
+      std::unique_lock<std::mutex> lock(m_sampleQueueMutex);
+      m_sampleQueueChanged.wait(lock, [this]() { return m_stopSampling || !m_sampleQueue.empty(); });
+      if (m_stopSampling)
+        return;
+      sample = std::move(m_sampleQueue.front());
+      m_sampleQueue.pop_front();
+      m_samplingThreadBusy = true;
+    }
+    CountLeafHits(sample);
+    if (m_sampledRowsSinceCheck >= m_retilingOptions.minSampledRows) {
+      // An exception would terminate the process from this thread. The current runner is still valid, so
+      // record the error and keep serving with it.
+      try {
+        CheckDriftAndRetile();
+      }
+      catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(m_sampleQueueMutex);
+        m_retilingError = e.what();
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_sampleQueueMutex);
+      m_samplingThreadBusy = false;
+    }
+    m_sampleQueueChanged.notify_all();
+  }
+}
+
+void OnlineRetilingRunner::CountLeafHits(SampledRows& sample) {
+  auto resultBytes = static_cast<size_t>(sample.numRows) * m_countingRunner->GetNumberOfOutputs() * (m_countingRunner->GetReturnTypeBitWidth()/8);
+  std::vector<int8_t> results(resultBytes);
+  m_countingRunner->RunInferenceOnMultipleBatches(sample.inputs.data(), results.data(), sample.numRows);
+  m_sampledRowCount += sample.numRows;
+  m_sampledRowsSinceCheck += sample.numRows;
+}
+
+void OnlineRetilingRunner::CheckDriftAndRetile() {
+  auto counters = m_countingRunner->GetLeafHitCounts();
+  std::vector<int64_t> leafHitCounts(counters, counters + m_countingRunner->GetNumberOfLeafHitCounters());
+  auto sampledRows = m_sampledRowsSinceCheck;
+  m_countingRunner->ResetLeafHitCounts();
+  m_sampledRowsSinceCheck = 0;
+
+  mlir::MLIRContext context;
+  TreeBeard::XGBoostJSONParser<> xgBoostParser(context, m_modelJSONPath, mlir::decisionforest::ConstructModelSerializer(""), 1);
+  xgBoostParser.ConstructForest();
+  auto decisionForest = xgBoostParser.GetForest();
+  Profile::SetLeafHitCounts(*decisionForest, leafHitCounts.data());
+  auto sampledDistributions = GetLeafDistributions(*decisionForest);
+  auto drift = ComputeDrift(m_baselineDistributions, sampledDistributions);
+  m_drift.store(drift);
+
+  if (drift > m_retilingOptions.driftThreshold) {
+    Profile::WriteProbabilityProfile(*decisionForest, sampledRows, m_onlineProfileCSVPath);
+    m_options.statsProfileCSVPath = m_onlineProfileCSVPath;
+    std::shared_ptr<mlir::decisionforest::InferenceRunnerBase> inferenceRunner(ConstructInferenceRunnerForXGBoostJSON(m_modelJSONPath, m_options));
+    auto numThreads = std::atomic_load(&m_inferenceRunner)->GetNumberOfThreads();
+    if (numThreads > 1)
+      inferenceRunner->SetNumberOfThreads(numThreads);
+    std::atomic_store(&m_inferenceRunner, inferenceRunner);
+    m_baselineDistributions = sampledDistributions;
+    ++m_recompileCount;
+  }
+}
+
+std::string OnlineRetilingRunner::GetRetilingError() {
+  std::lock_guard<std::mutex> lock(m_sampleQueueMutex);
+  return m_retilingError;
+}
+
+void OnlineRetilingRunner::WaitForRecompilation() {
+  std::unique_lock<std::mutex> lock(m_sampleQueueMutex);
+  m_sampleQueueChanged.wait(lock, [this]() { return m_sampleQueue.empty() && !m_samplingThreadBusy; });
+}
+
+} // TreeBeard
@@ -0,0 +1,109 @@
+#ifndef _ONLINERETILINGRUNNER_H_
+#define _ONLINERETILINGRUNNER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TreebeardContext.h"
+#include "ExecutionHelpers.h"
+
+namespace TreeBeard
+{
+
+struct OnlineRetilingOptions {
+  // Fraction of RunInferenceOnMultipleBatches calls whose rows are also run through the leaf hit counting model.
+  // Calls made while the sampling thread is behind are skipped.
+  double samplingFraction = 0.01;
+  // The model is re-tiled when the leaf distribution of the sampled rows has drifted from the one it was
+  // tiled for by more than this (see OnlineRetilingRunner::GetDrift)
+  double driftThreshold = 0.1;
+  // Number of sampled rows between drift checks
+  int64_t minSampledRows = 10000;
+};
+
+// Runs a probabilistically tiled XGBoost model and re-tiles it when the inputs it sees stop matching the
+// profile it was tiled with. The rows of a sample of the calls are copied and run through an untiled copy of 
+// the model that counts leaf hits (see CompilerOptions::profileLeafHits) on a background sampling thread, so 
+// the calling threads only pay for the copy. Once enough rows have been sampled, the sampling thread computes 
+// the drift between the sampled leaf distributions and the profile's and, if it is above the threshold, writes 
+// the sampled counts out as a new profile and recompiles the model with it. The recompiled runner is swapped in
+// atomically. Calls that are already running finish on the runner they started with. If a drift check or
+// recompilation fails, the error is recorded (see GetRetilingError) and the current runner keeps serving.
+class OnlineRetilingRunner {
+  // Calls aren't sampled while this many samples are waiting for the sampling thread
+  static constexpr size_t kMaxQueuedSamples = 8;
+
+  struct SampledRows {
+    std::vector<char> inputs;
+    int32_t numRows;
+  };
+
+  std::string m_modelJSONPath;
+  std::string m_profileCSVPath;
+  // The profile written when the model is re-tiled. Every runner has its own.
+  std::string m_onlineProfileCSVPath;
+  CompilerOptions m_options;
+  OnlineRetilingOptions m_retilingOptions;
+  int64_t m_samplingInterval;
+
+  std::shared_ptr<mlir::decisionforest::InferenceRunnerBase> m_inferenceRunner;
+  // The counting runner, m_sampledRowsSinceCheck and m_baselineDistributions are only used on the sampling thread
+  std::unique_ptr<mlir::decisionforest::InferenceRunnerBase> m_countingRunner;
+  int64_t m_sampledRowsSinceCheck;
+  // Leaf probabilities of each tree (leaves in node order) that the current model was tiled for
+  std::vector<std::vector<double>> m_baselineDistributions;
+
+  // Guards the sample queue, the state of the sampling thread and the retiling error
+  std::mutex m_sampleQueueMutex;
+  std::condition_variable m_sampleQueueChanged;
+  std::deque<SampledRows> m_sampleQueue;
+  bool m_samplingThreadBusy;
+  bool m_stopSampling;
+  // Message of the last failed drift check or recompilation
+  std::string m_retilingError;
+  std::thread m_samplingThread;
+
+  std::atomic<int64_t> m_callCount;
+  std::atomic<int64_t> m_sampledRowCount;
+  std::atomic<int64_t> m_recompileCount;
+  std::atomic<double> m_drift;
+
+  void SampleRows(void *input, int32_t numRows);
+  void RunSamplingThread();
+  void CountLeafHits(SampledRows& sample);
+  void CheckDriftAndRetile();
+public:
+  // options must use a probability based tiling type. The model is first compiled with the profile at profileCSVPath.
+  OnlineRetilingRunner(const std::string& modelJSONPath, const std::string& profileCSVPath,
+                       const CompilerOptions& options, const OnlineRetilingOptions& retilingOptions);
+  ~OnlineRetilingRunner();
+
+  OnlineRetilingRunner(const OnlineRetilingRunner&) = delete;
+  OnlineRetilingRunner& operator=(const OnlineRetilingRunner&) = delete;
+
+  // Same as InferenceRunnerBase::RunInferenceOnMultipleBatches. May be called concurrently.
+  int32_t RunInferenceOnMultipleBatches(void *input, void *returnValue, int32_t numRows);
+
+  std::shared_ptr<mlir::decisionforest::InferenceRunnerBase> GetInferenceRunner() { return std::atomic_load(&m_inferenceRunner); }
+  // Mean over the sampled trees of the total variation distance between the sampled leaf distribution
+  // and the one the model was tiled for, as of the last drift check
+  double GetDrift() { return m_drift.load(); }
+  int64_t GetRecompileCount() { return m_recompileCount.load(); }
+  // Number of rows run through the leaf hit counting model
+  int64_t GetSampledRowCount() { return m_sampledRowCount.load(); }
+  // Message of the last drift check or recompilation that failed. Empty if none has.
+  std::string GetRetilingError();
+  // Wait for the rows sampled by earlier calls to be counted (and for the drift checks and recompilations 
+  // they start to finish)
+  void WaitForRecompilation();
+};
+
+} // TreeBeard
+
+#endif // _ONLINERETILINGRUNNER_H_
@@ -0,0 +1,114 @@
+#include <cassert>
+#include <cstring>
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
+namespace
+{
+
+const int32_t kNumCounters = static_cast<int32_t>(TreeBeard::PerfCounter::kNumCounters);
+
+#ifdef __linux__
+
+int OpenCounter(uint32_t type, uint64_t config) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // Calling thread on any CPU
+  return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+int OpenCounter(TreeBeard::PerfCounter counter) {
+  switch (counter) {
+    case TreeBeard::PerfCounter::kCycles:
+      return OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    case TreeBeard::PerfCounter::kInstructions:
+      return OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    case TreeBeard::PerfCounter::kL1DataReadMisses:
+      return OpenCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                                             (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    case TreeBeard::PerfCounter::kLLCMisses:
+      return OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    case TreeBeard::PerfCounter::kBranchMisses:
+      return OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    default:
+      assert (false && "Unknown performance counter");
+  }
+  return -1;
+}
+
+#endif // __linux__
+
+}
+
+namespace TreeBeard
+{
+
+PerfCounterGroup::PerfCounterGroup()
+  : m_fds(kNumCounters, -1), m_values(kNumCounters, -1)
+{
+#ifdef __linux__
+  for (int32_t i=0 ; i<kNumCounters ; ++i)
+    m_fds[i] = OpenCounter(static_cast<PerfCounter>(i));
+#endif // __linux__
+}
+
+PerfCounterGroup::~PerfCounterGroup() {
+#ifdef __linux__
+  for (auto fd : m_fds)
+    if (fd >= 0)
+      close(fd);
+#endif // __linux__
+}
+
+bool PerfCounterGroup::IsAnyCounterAvailable() {
+  for (auto fd : m_fds)
+    if (fd >= 0)
+      return true;
+  return false;
+}
+
+void PerfCounterGroup::Start() {
+#ifdef __linux__
+  for (auto fd : m_fds) {
+    if (fd < 0)
+      continue;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif // __linux__
+}
+
+void PerfCounterGroup::Stop() {
+#ifdef __linux__
+  for (auto fd : m_fds)
+    if (fd >= 0)
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+  for (int32_t i=0 ; i<kNumCounters ; ++i) {
+    m_values[i] = -1;
+    if (m_fds[i] < 0)
+      continue;
+    // value, time enabled, time running
+    uint64_t readValues[3];
+    if (read(m_fds[i], readValues, sizeof(readValues)) != sizeof(readValues) || readValues[2] == 0)
+      continue;
+    auto scale = static_cast<double>(readValues[1]) / readValues[2];
+    m_values[i] = static_cast<int64_t>(readValues[0] * scale);
+  }
+#endif // __linux__
+}
+
+}
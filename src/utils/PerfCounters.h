@@ -0,0 +1,39 @@
+#ifndef _PERFCOUNTERS_H_
+#define _PERFCOUNTERS_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace TreeBeard
+{
+
+enum class PerfCounter : int32_t { kCycles = 0, kInstructions, kL1DataReadMisses, kLLCMisses, kBranchMisses, kNumCounters };
+
+// Hardware performance counters (read through perf_event_open) for the calling thread. Each counter is
+// opened independently so that counters the CPU or the kernel (perf_event_paranoid, containers, VMs)
+// doesn't provide are reported as unavailable rather than failing the whole group. Counters are only
+// available on Linux.
+class PerfCounterGroup {
+  std::vector<int> m_fds;
+  std::vector<int64_t> m_values;
+public:
+  PerfCounterGroup();
+  ~PerfCounterGroup();
+
+  PerfCounterGroup(const PerfCounterGroup&) = delete;
+  PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+  bool IsAvailable(PerfCounter counter) { return m_fds[static_cast<int32_t>(counter)] >= 0; }
+  bool IsAnyCounterAvailable();
+
+  // Zero and start all available counters
+  void Start();
+  // Stop the counters and read their values
+  void Stop();
+  // -1 if the counter is unavailable. Counts are scaled up if the kernel multiplexed the counter.
+  int64_t GetValue(PerfCounter counter) { return m_values[static_cast<int32_t>(counter)]; }
+};
+
+}
+
+#endif // _PERFCOUNTERS_H_
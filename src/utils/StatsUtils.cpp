@@ -1,12 +1,39 @@
 #include <string>
+#include <algorithm>
+#include <memory>
+#include <filesystem>
 #include "DecisionForest.h"
 #include "xgboostparser.h"
 #include "TestUtilsCommon.h"
 #include "ModelSerializers.h"
+#include "CompileUtils.h"
+#include "ExecutionHelpers.h"
+#include "CompilationCache.h"
 
 namespace
 {
 
+void WriteForestInferenceStats(mlir::decisionforest::DecisionForest* decisionForest, int64_t numRows, std::ostream& outputStream, bool sortLeaves) {
+  outputStream << decisionForest->NumTrees() << ", " << numRows <<  std::endl;
+  for (size_t i=0 ; i<decisionForest->NumTrees() ; ++i) {
+    auto& tree = decisionForest->GetTree(i);
+    std::vector<mlir::decisionforest::DecisionTree::Node> leaves;
+    for (auto& node : tree.GetNodes()) {
+      if (node.IsLeaf())
+        leaves.push_back(node);
+    }
+    if (sortLeaves)
+      std::sort(leaves.begin(), leaves.end(), [](mlir::decisionforest::DecisionTree::Node& n1, mlir::decisionforest::DecisionTree::Node& n2) {
+        return n1.hitCount > n2.hitCount;
+      });
+    outputStream << leaves[0].hitCount << ", "  << leaves[0].depth;
+    for (size_t j=1 ; j<leaves.size() ; ++j) {
+      outputStream << ", " << leaves[j].hitCount << ", "  << leaves[j].depth;
+    }
+    outputStream << std::endl;
+  }
+}
+
 void ComputeForestInferenceStatsImpl(const std::string& modelJSONPath, const std::string& csvPath, int32_t numRows, std::ostream& outputStream, bool sortLeaves) {
   // std::string csvPath = "/home/ashwin/ML/scikit-learn_bench/xgb_models/airline_xgb_model_save.json.test.csv";
   mlir::MLIRContext context;
@@ -24,24 +51,22 @@ void ComputeForestInferenceStatsImpl(const std::string& modelJSONPath, const std
     // if (i % (csvReader.NumberOfRows()/25) == 0)
     //   std::cerr << "-" << std::flush;
   }
-  outputStream << decisionForest->NumTrees() << ", " << csvReader.NumberOfRows() <<  std::endl;
-  for (size_t i=0 ; i<decisionForest->NumTrees() ; ++i) {
-    auto& tree = decisionForest->GetTree(i);
-    std::vector<mlir::decisionforest::DecisionTree::Node> leaves;
-    for (auto& node : tree.GetNodes()) {
-      if (node.IsLeaf())
-        leaves.push_back(node);
-    }
-    if (sortLeaves)
-      std::sort(leaves.begin(), leaves.end(), [](mlir::decisionforest::DecisionTree::Node& n1, mlir::decisionforest::DecisionTree::Node& n2) {
-        return n1.hitCount > n2.hitCount;
-      });
-    outputStream << leaves[0].hitCount << ", "  << leaves[0].depth;
-    for (size_t j=1 ; j<leaves.size() ; ++j) {
-      outputStream << ", " << leaves[j].hitCount << ", "  << leaves[j].depth;
-    }
-    outputStream << std::endl;
+  WriteForestInferenceStats(decisionForest, csvReader.NumberOfRows(), outputStream, sortLeaves);
+}
+
+// Walk the nodes of a tree alongside its array representation layout (children of i at 2i+1 and 2i+2) 
+// and set the hit counts of its leaves from the counters of the tree
+void SetTreeLeafHitCounts(std::vector<mlir::decisionforest::DecisionTree::Node>& nodes, int64_t nodeIndex, int64_t arrayIndex,
+                          int32_t depth, const int64_t *treeCounters) {
+  auto& node = nodes.at(nodeIndex);
+  if (node.IsLeaf()) {
+    node.hitCount = static_cast<int32_t>(treeCounters[arrayIndex]);
+    // DecisionForest::Predict only sets the depth of leaves that are reached
+    node.depth = node.hitCount > 0 ? depth : -1;
+    return;
   }
+  SetTreeLeafHitCounts(nodes, node.leftChild, 2*arrayIndex + 1, depth + 1, treeCounters);
+  SetTreeLeafHitCounts(nodes, node.rightChild, 2*arrayIndex + 2, depth + 1, treeCounters);
 }
 
 }
@@ -83,6 +108,83 @@ void ComputeForestProbabilityProfileForXGBoostModel(const std::string& modelName
   ComputeForestInferenceStatsImpl(modelJSONPath, csvPath, numRows, fout, false);
 }
 
+mlir::decisionforest::InferenceRunnerBase* ConstructLeafHitCountingRunner(const std::string& modelJSONPath, const CompilerOptions& options) {
+  CompilerOptions countingOptions(options.thresholdTypeWidth, options.returnTypeWidth, options.returnTypeFloatType, 
+                                  options.featureIndexTypeWidth, options.nodeIndexTypeWidth, options.inputElementTypeWidth, 
+                                  options.batchSize, 1, options.tileShapeBitWidth, options.childIndexBitWidth, 
+                                  TilingType::kUniform, false, false, nullptr);
+  countingOptions.returnAllOutputs = options.returnAllOutputs;
+  countingOptions.inputLayout = options.inputLayout;
+  countingOptions.optimizationLevel = options.optimizationLevel;
+  // The rows that would pad out partial batches must not be counted
+  countingOptions.dynamicBatch = true;
+  countingOptions.profileLeafHits = true;
+
+  // The counting runner is built while the caller's runner for the same model may be serving, so it must not
+  // share (and overwrite) that model's globals file
+  auto modelGlobalsJSONPath = TemporaryModelGlobalsFilePath();
+  TreebeardContext tbContext(modelJSONPath, modelGlobalsJSONPath, countingOptions);
+  tbContext.SetRepresentationAndSerializer("array");
+  auto module = ConstructLLVMDialectModuleFromXGBoostJSON(tbContext);
+  auto inferenceRunner = new mlir::decisionforest::InferenceRunner(tbContext.serializer, module, countingOptions.tileSize, 
+                                                                   countingOptions.thresholdTypeWidth, countingOptions.featureIndexTypeWidth,
+                                                                   countingOptions.GetLLVMCodeGenOptions());
+  // CPU models embed their buffers in the generated code and don't read the globals back
+  std::error_code errorCode;
+  std::filesystem::remove(modelGlobalsJSONPath, errorCode);
+  assert (inferenceRunner->IsLeafHitProfilingEnabled());
+  return inferenceRunner;
+}
+
+void SetLeafHitCounts(mlir::decisionforest::DecisionForest& decisionForest, const int64_t *leafHitCounts) {
+  const int64_t *treeCounters = leafHitCounts;
+  for (size_t i=0 ; i<decisionForest.NumTrees() ; ++i) {
+    auto& tree = decisionForest.GetTree(i);
+    auto nodes = tree.GetNodes();
+    SetTreeLeafHitCounts(nodes, 0, 0, 0, treeCounters);
+    tree.SetNodes(nodes);
+    treeCounters += tree.GetNumberOfTiles();
+  }
+}
+
+void WriteProbabilityProfile(mlir::decisionforest::DecisionForest& decisionForest, int64_t numRows, const std::string& statsCSVPath) {
+  std::ofstream fout(statsCSVPath);
+  WriteForestInferenceStats(&decisionForest, numRows, fout, false);
+}
+
+void ComputeForestProbabilityProfileCompiled(const std::string& modelJSONPath, const std::string& csvPath, const std::string& statsCSVPath,
+                                             int32_t numRows, int32_t batchSize) {
+  // Thresholds and inputs are doubles so that rows take the same paths as they do through DecisionForest::Predict
+  CompilerOptions options(64, 64, true, 32, 32, 64, batchSize, 1, 16, 16, TilingType::kUniform, false, false, nullptr);
+  std::unique_ptr<mlir::decisionforest::InferenceRunnerBase> inferenceRunner(ConstructLeafHitCountingRunner(modelJSONPath, options));
+
+  TreeBeard::test::TestCSVReader csvReader(csvPath);
+  size_t rowsToRun = numRows < 0 ? csvReader.NumberOfRows() : std::min(csvReader.NumberOfRows(), static_cast<size_t>(numRows));
+  auto rowSize = static_cast<size_t>(inferenceRunner->GetRowSize());
+  // Rows are copied into a dense buffer a chunk at a time
+  const size_t rowsPerChunk = static_cast<size_t>(batchSize) * 64;
+  std::vector<double> inputs, results;
+  for (size_t chunkBegin=0 ; chunkBegin<rowsToRun ; chunkBegin+=rowsPerChunk) {
+    auto chunkRows = std::min(rowsPerChunk, rowsToRun - chunkBegin);
+    inputs.assign(chunkRows * rowSize, 0.0);
+    for (size_t i=0 ; i<chunkRows ; ++i) {
+      auto& row = csvReader.GetRow(chunkBegin + i);
+      // The last column is the expected prediction
+      assert (row.size() == rowSize + 1);
+      std::copy(row.begin(), row.begin() + rowSize, inputs.begin() + i*rowSize);
+    }
+    results.resize(chunkRows * inferenceRunner->GetNumberOfOutputs());
+    inferenceRunner->RunInferenceOnMultipleBatches(inputs.data(), results.data(), static_cast<int32_t>(chunkRows));
+  }
+
+  mlir::MLIRContext context;
+  TreeBeard::XGBoostJSONParser<> xgBoostParser(context, modelJSONPath, mlir::decisionforest::ConstructModelSerializer(""), 1);
+  xgBoostParser.ConstructForest();
+  auto decisionForest = xgBoostParser.GetForest();
+  SetLeafHitCounts(*decisionForest, inferenceRunner->GetLeafHitCounts());
+  WriteProbabilityProfile(*decisionForest, rowsToRun, statsCSVPath);
+}
+
 void ReadProbabilityProfile(mlir::decisionforest::DecisionForest& decisionForest, const std::string& statsCSVFile) {
   TreeBeard::test::TestCSVReader csvReader(statsCSVFile);
   // std::cerr << "Done reading stats file..\n";
@@ -2,6 +2,7 @@
 #define _STATSUTILS_H_
 
 #include <string>
+#include "TreebeardContext.h"
 
 namespace TreeBeard
 {
@@ -13,6 +14,20 @@ void ComputeForestInferenceStatsOnSampledTestInput(const std::string& model, int
 void ComputeForestInferenceStatsOnModel(const std::string& model, const std::string& csvPath, int32_t numRows);
 void ComputeForestProbabilityProfile(const std::string& modelJSONPath, const std::string& csvPath, const std::string& statsCSVPath, int32_t numRows);
 void ComputeForestProbabilityProfileForXGBoostModel(const std::string& modelName, const std::string& csvPath, const std::string& statsCSVPath, int32_t numRows);
+// Writes the same profile as ComputeForestProbabilityProfile, but counts leaf hits in a JIT compiled 
+// model (see CompilerOptions::profileLeafHits) rather than walking the trees in the interpreter. 
+// Only the first numRows rows of the CSV are run (all rows if numRows is negative).
+void ComputeForestProbabilityProfileCompiled(const std::string& modelJSONPath, const std::string& csvPath, const std::string& statsCSVPath,
+                                             int32_t numRows, int32_t batchSize=200);
+
+// Compile the model to count leaf hits (see CompilerOptions::profileLeafHits). The type widths, batch size 
+// and input layout are taken from options. The trees are untiled and the batch is dynamic.
+mlir::decisionforest::InferenceRunnerBase* ConstructLeafHitCountingRunner(const std::string& modelJSONPath, const CompilerOptions& options);
+// Set the hit counts (and the depths of hit leaves) of the leaves of the forest from the leaf hit 
+// counters of a model compiled from it (see InferenceRunnerBase::GetLeafHitCounts)
+void SetLeafHitCounts(mlir::decisionforest::DecisionForest& decisionForest, const int64_t *leafHitCounts);
+// Write the leaf hit counts of the forest in the format ReadProbabilityProfile reads
+void WriteProbabilityProfile(mlir::decisionforest::DecisionForest& decisionForest, int64_t numRows, const std::string& statsCSVPath);
 
 void ReadProbabilityProfile(mlir::decisionforest::DecisionForest& decisionForest, const std::string& statsCSVFile);
 }
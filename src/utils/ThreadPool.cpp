@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cassert>
+#include <pthread.h>
+#include <sched.h>
+#include "ThreadPool.h"
+
+namespace
+{
+
+thread_local bool isPoolWorker = false;
+
+void PinCurrentThreadToCore(int32_t core) {
+#ifdef __linux__
+  auto numCores = std::thread::hardware_concurrency();
+  if (numCores == 0)
+    return;
+  cpu_set_t cpuSet;
+  CPU_ZERO(&cpuSet);
+  CPU_SET(core % numCores, &cpuSet);
+  // Pinning is only a performance hint. Ignore failures (for example, when
+  // the process is restricted to a subset of the cores).
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+#endif // __linux__
+}
+
+}
+
+namespace TreeBeard
+{
+
+ThreadPool::ThreadPool(int32_t numThreads, bool pinToCores)
+  :m_shutdown(false)
+{
+  assert (numThreads > 0);
+  for (int32_t i=1 ; i<numThreads ; ++i)
+    m_workers.emplace_back(&ThreadPool::WorkerLoop, this, i, pinToCores);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_shutdown = true;
+  }
+  m_taskAvailable.notify_all();
+  for (auto& worker : m_workers)
+    worker.join();
+}
+
+void ThreadPool::WorkerLoop(int32_t workerIndex, bool pinToCore) {
+  isPoolWorker = true;
+  if (pinToCore)
+    PinCurrentThreadToCore(workerIndex);
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_taskAvailable.wait(lock, [this]() { return m_shutdown || !m_tasks.empty(); });
+      if (m_tasks.empty())
+        return; // Shutting down and there is nothing left to run
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    task();
+  }
+}
+
+void ThreadPool::Enqueue(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back(std::move(task));
+  }
+  m_taskAvailable.notify_one();
+}
+
+void ThreadPool::ParallelFor(int64_t numIterations, const std::function<void(int64_t, int64_t)>& func) {
+  if (numIterations <= 0)
+    return;
+  int64_t numChunks = std::min(static_cast<int64_t>(GetNumberOfThreads()), numIterations);
+  if (numChunks == 1 || isPoolWorker) {
+    func(0, numIterations);
+    return;
+  }
+  int64_t chunkSize = numIterations / numChunks;
+  int64_t numLargerChunks = numIterations % numChunks;
+  auto chunkBegin = [&](int64_t chunk) {
+    return chunk*chunkSize + std::min(chunk, numLargerChunks);
+  };
+
+  std::mutex doneMutex;
+  std::condition_variable doneCondition;
+  int64_t pendingChunks = numChunks - 1;
+  for (int64_t chunk=1 ; chunk<numChunks ; ++chunk) {
+    auto begin = chunkBegin(chunk), end = chunkBegin(chunk + 1);
+    Enqueue([&, begin, end]() {
+      func(begin, end);
+      std::lock_guard<std::mutex> lock(doneMutex);
+      if (--pendingChunks == 0)
+        doneCondition.notify_one();
+    });
+  }
+  // The calling thread processes the first chunk instead of idling
+  func(chunkBegin(0), chunkBegin(1));
+  std::unique_lock<std::mutex> lock(doneMutex);
+  doneCondition.wait(lock, [&]() { return pendingChunks == 0; });
+}
+
+ThreadPool& GetCompilerThreadPool() {
+  static ThreadPool compilerThreadPool(std::max(1u, std::thread::hardware_concurrency()), false /*pinToCores*/);
+  return compilerThreadPool;
+}
+
+} // TreeBeard
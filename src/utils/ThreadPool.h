@@ -0,0 +1,55 @@
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace TreeBeard
+{
+
+// A fixed size pool of persistent worker threads. Workers are created once
+// and reused across calls so that per call dispatch only costs a queue push
+// and a wake up rather than a thread creation.
+class ThreadPool {
+  std::vector<std::thread> m_workers;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_taskAvailable;
+  bool m_shutdown;
+
+  void WorkerLoop(int32_t workerIndex, bool pinToCore);
+public:
+  // Creates numThreads-1 workers. The thread that calls ParallelFor is used
+  // as the remaining thread. If pinToCores is true, worker i is pinned to
+  // core i (modulo the number of available cores). Pools that pin their workers
+  // all use the same cores, so only one of them should pin per process.
+  ThreadPool(int32_t numThreads, bool pinToCores=false);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int32_t GetNumberOfThreads() { return static_cast<int32_t>(m_workers.size()) + 1; }
+
+  void Enqueue(std::function<void()> task);
+
+  // Splits [0, numIterations) into contiguous, disjoint ranges (at most one per thread)
+  // and calls func(begin, end) on each of them. Blocks until all ranges are processed.
+  // Calls made from a worker of any pool run func(0, numIterations) on the calling thread
+  // so that nested loops can't leave every worker waiting on queued work.
+  void ParallelFor(int64_t numIterations, const std::function<void(int64_t, int64_t)>& func);
+};
+
+// A process wide pool with one thread per hardware thread that runs the per tree stages
+// of compilation (tiling and serialization). Workers are not pinned to cores since the pool
+// is shared by all models being compiled in the process.
+ThreadPool& GetCompilerThreadPool();
+
+} // TreeBeard
+
+#endif // _THREADPOOL_H_
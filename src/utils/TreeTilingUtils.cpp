@@ -1,5 +1,6 @@
 #include <queue>
 #include <iostream>
+#include <mutex>
 #include "TreeTilingDescriptor.h"
 #include "TreeTilingUtils.h"
 #include "TiledTree.h"
@@ -13,8 +14,6 @@ namespace mlir
 namespace decisionforest
 {
 
-ForestJSONReader ForestJSONReader::m_instance;
-
 // TODO How does this work for the last tree? We need to also know the length of the full serialization to compute the length
 // of the last tree
 int32_t ForestJSONReader::GetLengthOfTree(std::vector<int32_t>& offsets, int32_t treeIndex) {
@@ -93,8 +92,12 @@ void ForestJSONReader::ParseSingleTileSizeEntry(json& tileSizeEntryJSON, ForestJ
 }
 
 void ForestJSONReader::ParseJSONFile() {
-    ClearAllData();
     assert (!m_jsonFilePath.empty());
+    if (MappedBinaryModelGlobals::IsBinaryModelGlobalsFile(m_jsonFilePath)) {
+        ParseBinaryFile();
+        return;
+    }
+    ClearAllData();
     m_json.clear();
     std::ifstream fin(m_jsonFilePath);
     fin >> m_json;
@@ -145,6 +148,10 @@ void ForestJSONReader::WriteSingleTileSizeEntryToJSON(json& tileSizeEntryJSON, F
 void ForestJSONReader::WriteJSONFile() {
     // m_jsonFilePath = "/home/ashwin/temp/modelValues.json";
     assert (m_jsonFilePath != "");
+    if (MappedBinaryModelGlobals::IsBinaryModelGlobalsFilePath(m_jsonFilePath)) {
+        WriteBinaryFile();
+        return;
+    }
     m_json.clear();
 
     m_json["InputElementBitWidth"] = m_inputElementBitwidth;
@@ -154,7 +161,7 @@ void ForestJSONReader::WriteJSONFile() {
     m_json["NumberOfTrees"] = m_numberOfTrees;
     m_json["ChildIndexBitWidth"] = m_childIndexBitWidth;
     m_json["TileShapeBitWidth"] = m_tileShapeBitWidth;
-    m_json["SparseRepresentation"] = decisionforest::UseSparseTreeRepresentation;
+    m_json["SparseRepresentation"] = m_sparseRepresentation;
     m_json["NumberOfClasses"] = m_numberOfClasses;
 
     for (auto& tileSizeEntry : m_tileSizeEntries) {
@@ -169,6 +176,228 @@ void ForestJSONReader::WriteJSONFile() {
     fout.close();
 }
 
+// ===---------------------------------------------------=== //
+// Binary model globals
+// ===---------------------------------------------------=== //
+
+namespace
+{
+
+using SectionKind = BinaryModelGlobalsSectionKind;
+
+template<typename DestType, typename SourceType>
+std::vector<DestType> FlattenAndConvert(const std::list<std::vector<SourceType>>& values) {
+    std::vector<DestType> flattened;
+    for (auto& vec : values)
+        flattened.insert(flattened.end(), vec.begin(), vec.end());
+    return flattened;
+}
+
+void AddFloatSection(BinaryModelGlobalsWriter& writer, int32_t entryIndex, SectionKind kind, int32_t bitWidth,
+                     const std::list<std::vector<ThresholdType>>& values) {
+    if (bitWidth == 32)
+        writer.AddSection(entryIndex, kind, FlattenAndConvert<float>(values));
+    else if (bitWidth == 64)
+        writer.AddSection(entryIndex, kind, FlattenAndConvert<double>(values));
+    else
+        assert (false && "Unsupported floating point bitwidth");
+}
+
+// A non-positive bitwidth means the width was never set (for example, child indices of
+// array based models). These sections are empty and are written as i32.
+void AddIntegerSection(BinaryModelGlobalsWriter& writer, int32_t entryIndex, SectionKind kind, int32_t bitWidth,
+                       const std::list<std::vector<int32_t>>& values) {
+    if (bitWidth == 8)
+        writer.AddSection(entryIndex, kind, FlattenAndConvert<int8_t>(values));
+    else if (bitWidth == 16)
+        writer.AddSection(entryIndex, kind, FlattenAndConvert<int16_t>(values));
+    else if (bitWidth == 32 || bitWidth <= 0)
+        writer.AddSection(entryIndex, kind, FlattenAndConvert<int32_t>(values));
+    else
+        assert (false && "Unsupported integer bitwidth");
+}
+
+// The per tree vectors of some lists are optional (array based models have no child indices 
+// or leaves). Their lengths are written as -1 so that the list is read back as empty.
+template<typename T>
+void AppendPerTreeLengths(std::vector<int32_t>& lengths, const std::list<std::vector<T>>& values, size_t numTrees, size_t field) {
+    assert (values.empty() || values.size() == numTrees);
+    auto iter = values.begin();
+    for (size_t i=0 ; i<numTrees ; ++i) {
+        lengths.at(4*i + field) = values.empty() ? -1 : static_cast<int32_t>(iter->size());
+        if (!values.empty())
+            ++iter;
+    }
+}
+
+template<typename DestType, typename ElementType>
+void SplitSection(const ElementType* elements, const int32_t* treeElementCounts, int32_t numTrees, size_t field,
+                  std::list<std::vector<DestType>>& values) {
+    for (int32_t i=0 ; i<numTrees ; ++i) {
+        auto length = treeElementCounts[4*i + field];
+        if (length == -1)
+            continue;
+        values.push_back(std::vector<DestType>(elements, elements + length));
+        elements += length;
+    }
+}
+
+template<typename DestType>
+void ReadSection(const MappedBinaryModelGlobals& mappedGlobals, const BinaryModelGlobalsEntry& entry, SectionKind kind,
+                 size_t field, std::list<std::vector<DestType>>& values) {
+    auto treeElementCounts = mappedGlobals.GetSection<int32_t>(entry, SectionKind::kTreeElementCounts);
+    auto& section = entry.GetSection(kind);
+    if (section.isFloat) {
+        if (section.elementBitWidth == 32)
+            SplitSection(mappedGlobals.GetSection<float>(entry, kind), treeElementCounts, entry.numberOfTrees, field, values);
+        else if (section.elementBitWidth == 64)
+            SplitSection(mappedGlobals.GetSection<double>(entry, kind), treeElementCounts, entry.numberOfTrees, field, values);
+        else
+            assert (false && "Unsupported floating point bitwidth");
+    }
+    else {
+        if (section.elementBitWidth == 8)
+            SplitSection(mappedGlobals.GetSection<int8_t>(entry, kind), treeElementCounts, entry.numberOfTrees, field, values);
+        else if (section.elementBitWidth == 16)
+            SplitSection(mappedGlobals.GetSection<int16_t>(entry, kind), treeElementCounts, entry.numberOfTrees, field, values);
+        else if (section.elementBitWidth == 32)
+            SplitSection(mappedGlobals.GetSection<int32_t>(entry, kind), treeElementCounts, entry.numberOfTrees, field, values);
+        else
+            assert (false && "Unsupported integer bitwidth");
+    }
+}
+
+template<typename T>
+std::list<T> ReadListSection(const MappedBinaryModelGlobals& mappedGlobals, const BinaryModelGlobalsEntry& entry, SectionKind kind) {
+    auto elements = mappedGlobals.GetSection<T>(entry, kind);
+    return std::list<T>(elements, elements + MappedBinaryModelGlobals::GetNumberOfElements(entry, kind));
+}
+
+// Fields of the kTreeElementCounts section
+const size_t kThresholdCountField = 0;
+const size_t kTileShapeIDCountField = 1;
+const size_t kChildIndexCountField = 2;
+const size_t kLeafCountField = 3;
+
+}
+
+void ForestJSONReader::WriteSingleTileSizeEntryToBinary(BinaryModelGlobalsWriter& writer, int32_t entryIndex, 
+                                                        ForestJSONReader::SingleTileSizeEntry& tileSizeEntry) {
+    auto numTrees = tileSizeEntry.treeIndices.size();
+    auto& binaryEntry = writer.GetEntry(entryIndex);
+    binaryEntry.tileSize = tileSizeEntry.tileSize;
+    binaryEntry.thresholdBitWidth = tileSizeEntry.thresholdBitWidth;
+    binaryEntry.indexBitWidth = tileSizeEntry.indexBitWidth;
+    binaryEntry.numberOfTrees = static_cast<int32_t>(numTrees);
+
+    writer.AddSection(entryIndex, SectionKind::kTreeIndices, std::vector<int32_t>(tileSizeEntry.treeIndices.begin(), tileSizeEntry.treeIndices.end()));
+    writer.AddSection(entryIndex, SectionKind::kNumberOfTiles, std::vector<int32_t>(tileSizeEntry.numberOfTiles.begin(), tileSizeEntry.numberOfTiles.end()));
+    writer.AddSection(entryIndex, SectionKind::kClassIDs, std::vector<int8_t>(tileSizeEntry.classIDs.begin(), tileSizeEntry.classIDs.end()));
+
+    std::vector<int32_t> treeElementCounts(4*numTrees);
+    assert (tileSizeEntry.serializedThresholds.size() == numTrees);
+    AppendPerTreeLengths(treeElementCounts, tileSizeEntry.serializedThresholds, numTrees, kThresholdCountField);
+    AppendPerTreeLengths(treeElementCounts, tileSizeEntry.serializedTileShapeIDs, numTrees, kTileShapeIDCountField);
+    AppendPerTreeLengths(treeElementCounts, tileSizeEntry.serializedChildIndices, numTrees, kChildIndexCountField);
+    AppendPerTreeLengths(treeElementCounts, tileSizeEntry.serializedLeaves, numTrees, kLeafCountField);
+    writer.AddSection(entryIndex, SectionKind::kTreeElementCounts, treeElementCounts);
+
+    AddFloatSection(writer, entryIndex, SectionKind::kThresholds, tileSizeEntry.thresholdBitWidth, tileSizeEntry.serializedThresholds);
+    AddIntegerSection(writer, entryIndex, SectionKind::kFeatureIndices, tileSizeEntry.indexBitWidth, tileSizeEntry.serializedFetureIndices);
+    AddIntegerSection(writer, entryIndex, SectionKind::kTileShapeIDs, m_tileShapeBitWidth, tileSizeEntry.serializedTileShapeIDs);
+    AddIntegerSection(writer, entryIndex, SectionKind::kChildIndices, m_childIndexBitWidth, tileSizeEntry.serializedChildIndices);
+    AddFloatSection(writer, entryIndex, SectionKind::kLeaves, tileSizeEntry.thresholdBitWidth, tileSizeEntry.serializedLeaves);
+
+    // Precompute the per tree buffers that would otherwise be built by the Initialize* routines
+    std::vector<int64_t> offsets(m_numberOfTrees, -1), lengths(m_numberOfTrees, 0);
+    std::vector<int64_t> leavesOffsets(m_numberOfTrees, -1), leavesLengths(m_numberOfTrees, 0);
+    int64_t currentOffset = 0, currentLeavesOffset = 0;
+    auto numTilesIter = tileSizeEntry.numberOfTiles.begin();
+    auto leavesIter = tileSizeEntry.serializedLeaves.begin();
+    for (auto treeIndex : tileSizeEntry.treeIndices) {
+        offsets.at(treeIndex) = currentOffset;
+        lengths.at(treeIndex) = *numTilesIter;
+        currentOffset += *numTilesIter;
+        ++numTilesIter;
+        if (leavesIter != tileSizeEntry.serializedLeaves.end()) {
+            leavesOffsets.at(treeIndex) = currentLeavesOffset;
+            leavesLengths.at(treeIndex) = leavesIter->size();
+            currentLeavesOffset += leavesIter->size();
+            ++leavesIter;
+        }
+    }
+    writer.AddSection(entryIndex, SectionKind::kTreeOffsets, offsets);
+    writer.AddSection(entryIndex, SectionKind::kTreeLengths, lengths);
+    writer.AddSection(entryIndex, SectionKind::kLeavesOffsets, leavesOffsets);
+    writer.AddSection(entryIndex, SectionKind::kLeavesLengths, leavesLengths);
+}
+
+void ForestJSONReader::WriteBinaryFile() {
+    assert (m_jsonFilePath != "");
+    BinaryModelGlobalsHeader header = {};
+    header.inputElementBitWidth = m_inputElementBitwidth;
+    header.returnTypeBitWidth = m_returnTypeBitWidth;
+    header.rowSize = m_rowSize;
+    header.batchSize = m_batchSize;
+    header.numberOfTrees = m_numberOfTrees;
+    header.childIndexBitWidth = m_childIndexBitWidth;
+    header.tileShapeBitWidth = m_tileShapeBitWidth;
+    header.numberOfClasses = m_numberOfClasses;
+    header.sparseRepresentation = m_sparseRepresentation;
+    header.numberOfEntries = static_cast<int32_t>(m_tileSizeEntries.size());
+
+    BinaryModelGlobalsWriter writer(header);
+    int32_t entryIndex = 0;
+    for (auto& tileSizeEntry : m_tileSizeEntries) {
+        WriteSingleTileSizeEntryToBinary(writer, entryIndex, tileSizeEntry);
+        ++entryIndex;
+    }
+    writer.Write(m_jsonFilePath);
+}
+
+void ForestJSONReader::ParseSingleTileSizeEntryFromBinary(const BinaryModelGlobalsEntry& binaryEntry, 
+                                                          ForestJSONReader::SingleTileSizeEntry& tileSizeEntry) {
+    auto& mappedGlobals = *m_mappedGlobals;
+    tileSizeEntry.tileSize = binaryEntry.tileSize;
+    tileSizeEntry.thresholdBitWidth = binaryEntry.thresholdBitWidth;
+    tileSizeEntry.indexBitWidth = binaryEntry.indexBitWidth;
+    tileSizeEntry.treeIndices = ReadListSection<int32_t>(mappedGlobals, binaryEntry, SectionKind::kTreeIndices);
+    tileSizeEntry.numberOfTiles = ReadListSection<int32_t>(mappedGlobals, binaryEntry, SectionKind::kNumberOfTiles);
+    tileSizeEntry.classIDs = ReadListSection<int8_t>(mappedGlobals, binaryEntry, SectionKind::kClassIDs);
+    // Feature indices have one entry per threshold
+    ReadSection(mappedGlobals, binaryEntry, SectionKind::kThresholds, kThresholdCountField, tileSizeEntry.serializedThresholds);
+    ReadSection(mappedGlobals, binaryEntry, SectionKind::kFeatureIndices, kThresholdCountField, tileSizeEntry.serializedFetureIndices);
+    ReadSection(mappedGlobals, binaryEntry, SectionKind::kTileShapeIDs, kTileShapeIDCountField, tileSizeEntry.serializedTileShapeIDs);
+    ReadSection(mappedGlobals, binaryEntry, SectionKind::kChildIndices, kChildIndexCountField, tileSizeEntry.serializedChildIndices);
+    ReadSection(mappedGlobals, binaryEntry, SectionKind::kLeaves, kLeafCountField, tileSizeEntry.serializedLeaves);
+}
+
+void ForestJSONReader::ParseBinaryFile() {
+    ClearAllData();
+    assert (!m_jsonFilePath.empty());
+    m_mappedGlobals = std::make_shared<MappedBinaryModelGlobals>(m_jsonFilePath);
+
+    auto& header = m_mappedGlobals->GetHeader();
+    m_inputElementBitwidth = header.inputElementBitWidth;
+    m_returnTypeBitWidth = header.returnTypeBitWidth;
+    m_rowSize = header.rowSize;
+    m_batchSize = header.batchSize;
+    m_numberOfTrees = header.numberOfTrees;
+    m_childIndexBitWidth = header.childIndexBitWidth;
+    m_tileShapeBitWidth = header.tileShapeBitWidth;
+    m_numberOfClasses = header.numberOfClasses;
+}
+
+void ForestJSONReader::MaterializeMappedEntries() {
+    if (!m_mappedGlobals || !m_tileSizeEntries.empty())
+        return;
+    for (int32_t i=0 ; i<m_mappedGlobals->GetHeader().numberOfEntries ; ++i) {
+        SingleTileSizeEntry tileSizeEntry;
+        ParseSingleTileSizeEntryFromBinary(m_mappedGlobals->GetEntry(i), tileSizeEntry);
+        m_tileSizeEntries.push_back(tileSizeEntry);
+    }
+}
+
 template<typename T>
 void AppendAtEndOfList(std::list<T>& l, std::list<T>& newElements) {
     l.insert(std::end(l), std::begin(newElements), std::end(newElements));
@@ -242,6 +471,7 @@ void ForestJSONReader::AddSingleSparseTree(int32_t treeIndex, int32_t numTiles,
 
 void ForestJSONReader::ClearAllData() {
     m_tileSizeEntries.clear();
+    m_mappedGlobals.reset();
     // Can't clear the json path here because PersistForest calls Clear!
     // m_jsonFilePath.clear();
     m_tileShapeBitWidth = -1;
@@ -413,6 +643,7 @@ CopyModelValuesIntoBufferInterface* GetModelCopier(int32_t tileSize, int32_t thr
 }
 
 std::list<ForestJSONReader::SingleTileSizeEntry>::iterator ForestJSONReader::FindEntry(int32_t tileSize, int32_t thresholdBitWidth, int32_t indexBitWidth) {
+    MaterializeMappedEntries();
     // Find if there is already an entry with the given tileSize, thresholdWidth and indexWidth.
     auto listIter = this->m_tileSizeEntries.begin();
     while (listIter != m_tileSizeEntries.end()) {
@@ -557,6 +788,11 @@ void ForestJSONReader::InitializeLeavesLengthBuffer(void* bufPtr, int32_t tileSi
 
 
 int32_t ForestJSONReader::GetTotalNumberOfTiles() {
+    // There is one tile shape ID per tile, so the count is read off the mapping without materializing it
+    if (m_mappedGlobals && m_tileSizeEntries.empty()) {
+        assert (m_mappedGlobals->GetHeader().numberOfEntries == 1 && "Only a single (tile size, threshold type, feature index type) configuration is supported");
+        return static_cast<int32_t>(MappedBinaryModelGlobals::GetNumberOfElements(m_mappedGlobals->GetEntry(0), SectionKind::kTileShapeIDs));
+    }
     assert (this->m_tileSizeEntries.size() == 1 && "Only a single (tile size, threshold type, feature index type) configuration is supported");
     auto& tileSizeEntry = m_tileSizeEntries.front();
     int32_t numTiles = 0;
@@ -566,6 +802,10 @@ int32_t ForestJSONReader::GetTotalNumberOfTiles() {
 }
 
 int32_t ForestJSONReader::GetTotalNumberOfLeaves() {
+    if (m_mappedGlobals && m_tileSizeEntries.empty()) {
+        assert (m_mappedGlobals->GetHeader().numberOfEntries == 1 && "Only a single (tile size, threshold type, feature index type) configuration is supported");
+        return static_cast<int32_t>(MappedBinaryModelGlobals::GetNumberOfElements(m_mappedGlobals->GetEntry(0), SectionKind::kLeaves));
+    }
     assert (this->m_tileSizeEntries.size() == 1 && "Only a single (tile size, threshold type, feature index type) configuration is supported");
     auto& tileSizeEntry = m_tileSizeEntries.front();
     int32_t numLeaves = 0;
@@ -574,14 +814,6 @@ int32_t ForestJSONReader::GetTotalNumberOfLeaves() {
     return numLeaves;
 }
 
-int32_t GetTotalNumberOfTiles() {
-    return mlir::decisionforest::ForestJSONReader::GetInstance().GetTotalNumberOfTiles();
-}
-
-int32_t GetTotalNumberOfLeaves() {
-    return mlir::decisionforest::ForestJSONReader::GetInstance().GetTotalNumberOfLeaves();
-}
-
 // -----------------------------------------------
 // Construction of Tiled Tree
 // -----------------------------------------------
@@ -781,7 +1013,7 @@ void TiledTreeNode::GetThresholds(std::vector<double>::iterator beginIter) {
     }
 }
 
-void TiledTreeNode::GetFeatureIndices(std::vector<int32_t>::iterator beginIter) {
+void TiledTreeNode::GetFeatureIndices(std::vector<int32_t>::iterator beginIter, bool encodeDefaultLeft) {
     if (m_nodeIndices.size() == 1) {
         // This is a leaf tile
         auto& node = GetNode(m_nodeIndices.front());
@@ -796,7 +1028,7 @@ void TiledTreeNode::GetFeatureIndices(std::vector<int32_t>::iterator beginIter)
     }
     assert (static_cast<int32_t>(m_nodeIndices.size()) == m_tiledTree.m_modifiedTree.TilingDescriptor().MaxTileSize());
     for (auto nodeIndex : m_nodeIndices) {
-        auto featureIndex = GetNode(nodeIndex).featureIndex;
+        auto featureIndex = GetSerializedFeatureIndex(GetNode(nodeIndex), encodeDefaultLeft);
         *beginIter = featureIndex;
         ++beginIter;
     }
@@ -1092,13 +1324,13 @@ std::vector<double> TiledTree::SerializeThresholds() {
     return thresholds;
 }
 
-std::vector<int32_t> TiledTree::SerializeFeatureIndices() {
+std::vector<int32_t> TiledTree::SerializeFeatureIndices(bool encodeDefaultLeft) {
     int32_t tiledTreeDepth = GetTreeDepth();
     int32_t numChildrenPerTile = m_owningTree.TilingDescriptor().MaxTileSize() + 1;
     int32_t numberOfTiles = (std::pow(numChildrenPerTile, tiledTreeDepth) - 1)/(numChildrenPerTile - 1);
     int32_t vectorLength = numberOfTiles * m_owningTree.TilingDescriptor().MaxTileSize();
     std::vector<int32_t> featureIndices(vectorLength, -1);
-    GetTileAttributeArray(featureIndices, 0, 0, [&](TiledTreeNode& t, std::vector<int32_t>::iterator iter){ t.GetFeatureIndices(iter); }, false /*singleAttribute*/ );
+    GetTileAttributeArray(featureIndices, 0, 0, [&](TiledTreeNode& t, std::vector<int32_t>::iterator iter){ t.GetFeatureIndices(iter, encodeDefaultLeft); }, false /*singleAttribute*/ );
     return featureIndices;
 }
 
@@ -1255,9 +1487,9 @@ void TiledTree::ExploreTreeSplits() {
 
 void TiledTree::GetSparseSerialization(std::vector<double>& thresholds, std::vector<int32_t>& featureIndices, 
                                        std::vector<int32_t>& tileShapeIDs, std::vector<int32_t>& childIndices,
-                                       std::vector<double>& leaves) {
+                                       std::vector<double>& leaves, bool encodeDefaultLeft) {
     if (m_probabilisticallyTiled) {
-        GetSparseSerializationPeeled(thresholds, featureIndices, tileShapeIDs, childIndices, leaves);
+        GetSparseSerializationPeeled(thresholds, featureIndices, tileShapeIDs, childIndices, leaves, encodeDefaultLeft);
         return;
     }
     thresholds.clear(); featureIndices.clear(); tileShapeIDs.clear(); childIndices.clear(); leaves.clear();
@@ -1281,7 +1513,7 @@ void TiledTree::GetSparseSerialization(std::vector<double>& thresholds, std::vec
             if (!tile.IsLeafTile()) {
                 tile.GetThresholds(tileThresholds.begin());
                 thresholds.insert(thresholds.end(), tileThresholds.begin(), tileThresholds.end());
-                tile.GetFeatureIndices(tileFeatureIndices.begin());
+                tile.GetFeatureIndices(tileFeatureIndices.begin(), encodeDefaultLeft);
                 featureIndices.insert(featureIndices.end(), tileFeatureIndices.begin(), tileFeatureIndices.end());
                 tileShapeIDs.push_back(tile.GetTileShapeID());
                 childIndices.push_back(tile.GetChildren().front());
@@ -1367,7 +1599,7 @@ int32_t TiledTree::GetChildrenBitMask(TiledTreeNode& tile, std::vector<TiledTree
 
 void TiledTree::GetSparseSerializationPeeled(std::vector<double>& thresholds, std::vector<int32_t>& featureIndices,
                                              std::vector<int32_t>& tileShapeIDs, std::vector<int32_t>& childIndices,
-                                             std::vector<double>& leaves) {
+                                             std::vector<double>& leaves, bool encodeDefaultLeft) {
     assert (this->IsProbabilisticallyTiled() && this->GetLevelsToUnroll()!=-1);
     
     thresholds.clear(); featureIndices.clear(); tileShapeIDs.clear(); childIndices.clear(); 
@@ -1400,7 +1632,7 @@ void TiledTree::GetSparseSerializationPeeled(std::vector<double>& thresholds, st
             if (tileDepth <= m_levelsToUnroll) {
                 tile.GetThresholds(tileThresholds.begin());
                 thresholds.insert(thresholds.end(), tileThresholds.begin(), tileThresholds.end());
-                tile.GetFeatureIndices(tileFeatureIndices.begin());
+                tile.GetFeatureIndices(tileFeatureIndices.begin(), encodeDefaultLeft);
                 featureIndices.insert(featureIndices.end(), tileFeatureIndices.begin(), tileFeatureIndices.end());
                 tileShapeIDs.push_back(tile.GetTileShapeID());
                 childIndices.push_back(-1);
@@ -1444,7 +1676,7 @@ void TiledTree::GetSparseSerializationPeeled(std::vector<double>& thresholds, st
             // Push non-leaf tiles only into the tiles array
             tile.GetThresholds(tileThresholds.begin());
             thresholds.insert(thresholds.end(), tileThresholds.begin(), tileThresholds.end());
-            tile.GetFeatureIndices(tileFeatureIndices.begin());
+            tile.GetFeatureIndices(tileFeatureIndices.begin(), encodeDefaultLeft);
             featureIndices.insert(featureIndices.end(), tileFeatureIndices.begin(), tileFeatureIndices.end());
             tileShapeIDs.push_back(tile.GetTileShapeID());
             childIndices.push_back(tile.GetChildren().front());
@@ -1858,12 +2090,17 @@ void TileShapeToTileIDMap::TileStringGenerator(int32_t numNodes) {
 
 std::map<int32_t, int32_t> TileShapeToTileIDMap::tileSizeToNumberOfShapesMap;
 std::map<int32_t, TileShapeToTileIDMap*> TileShapeToTileIDMap::tileSizeToTileShapeMapMap;
+// The caches are shared by all models, which may be compiled on different threads.
+// NumberOfTileShapes is recursive, hence the recursive mutex.
+static std::recursive_mutex numberOfShapesMapMutex;
+static std::mutex tileShapeMapMapMutex;
 
 int32_t TileShapeToTileIDMap::NumberOfTileShapes(int32_t tileSize) {
     assert(tileSize >= 0);
     if (tileSize==0 || tileSize == 1) return 1;
     if (tileSize == 2) return 2;
     
+    std::lock_guard<std::recursive_mutex> lock(numberOfShapesMapMutex);
     auto iter = tileSizeToNumberOfShapesMap.find(tileSize);
     if (iter != tileSizeToNumberOfShapesMap.end())
         return iter->second;
@@ -1877,6 +2114,7 @@ int32_t TileShapeToTileIDMap::NumberOfTileShapes(int32_t tileSize) {
 }
 
 TileShapeToTileIDMap* TileShapeToTileIDMap::Get(int32_t tileSize) {
+    std::lock_guard<std::mutex> lock(tileShapeMapMapMutex);
     auto iter = tileSizeToTileShapeMapMap.find(tileSize);
     if (iter == tileSizeToTileShapeMapMap.end()) {
         tileSizeToTileShapeMapMap[tileSize] = new TileShapeToTileIDMap(tileSize);
@@ -6,11 +6,13 @@ namespace TreeBeard
 {
 
 void TreebeardContext::SetForestCreatorType(const std::string& creatorName) {
+  this->forestCreatorType = creatorName;
   this->forestConstructor = ForestCreatorFactory::Get().GetForestCreator(creatorName, *this);
 }
 
 void TreebeardContext::SetRepresentationAndSerializer(const std::string& repName) {
   using namespace mlir::decisionforest;
+  this->representationName = repName;
   this->serializer = ModelSerializerFactory::Get().GetModelSerializer(repName, this->modelGlobalsJSONPath);
   this->representation = RepresentationFactory::Get().GetRepresentation(repName);
 }
@@ -0,0 +1,74 @@
+#include <thread>
+#include <string>
+#include <stdexcept>
+#include "VersionedInferenceRunner.h"
+
+namespace TreeBeard
+{
+
+VersionedInferenceRunner::VersionedInferenceRunner(mlir::decisionforest::InferenceRunnerBase *inferenceRunner)
+  : m_epoch(0), m_inferenceRunner(inferenceRunner), m_version(0)
+{ }
+
+VersionedInferenceRunner::~VersionedInferenceRunner() {
+  delete m_inferenceRunner.load();
+}
+
+VersionedInferenceRunner::ReadGuard::ReadGuard(VersionedInferenceRunner& versionedRunner)
+  : m_versionedRunner(versionedRunner)
+{
+  m_epochParity = m_versionedRunner.m_epoch.load() & 1;
+  m_versionedRunner.m_readerCounts[m_epochParity].count.fetch_add(1);
+  // Loaded after the call is counted so that a swap that doesn't see the count can't have retired this runner
+  m_inferenceRunner = m_versionedRunner.m_inferenceRunner.load();
+}
+
+VersionedInferenceRunner::ReadGuard::~ReadGuard() {
+  m_versionedRunner.m_readerCounts[m_epochParity].count.fetch_sub(1);
+}
+
+void VersionedInferenceRunner::WaitForReaders(int64_t epochParity) {
+  // Calls that start after the flip are counted against the other parity
+  while (m_readerCounts[epochParity].count.load() != 0)
+    std::this_thread::yield();
+}
+
+// Callers size their buffers with the properties of the runner they read them from. Runners that would read 
+// or write those buffers differently can't be swapped in.
+void VersionedInferenceRunner::CheckCompatibility(mlir::decisionforest::InferenceRunnerBase *currentRunner,
+                                                  mlir::decisionforest::InferenceRunnerBase *newRunner) {
+  auto checkEqual = [](int32_t currentValue, int32_t newValue, const std::string& property) {
+    if (currentValue != newValue)
+      throw std::runtime_error("Can't swap in a model with a different " + property + " (" + std::to_string(newValue) + 
+                               " instead of " + std::to_string(currentValue) + ")");
+  };
+  checkEqual(currentRunner->GetRowSize(), newRunner->GetRowSize(), "row size");
+  checkEqual(currentRunner->GetInputElementBitWidth(), newRunner->GetInputElementBitWidth(), "input element width");
+  checkEqual(static_cast<int32_t>(currentRunner->GetInputLayout()), static_cast<int32_t>(newRunner->GetInputLayout()), "input layout");
+  checkEqual(currentRunner->GetNumberOfOutputs(), newRunner->GetNumberOfOutputs(), "number of outputs");
+  checkEqual(currentRunner->GetReturnTypeBitWidth(), newRunner->GetReturnTypeBitWidth(), "return type width");
+}
+
+int64_t VersionedInferenceRunner::SwapModel(mlir::decisionforest::InferenceRunnerBase *inferenceRunner) {
+  std::lock_guard<std::mutex> lock(m_swapMutex);
+  // Only swaps retire runners, so the current runner stays live while the lock is held
+  try {
+    CheckCompatibility(m_inferenceRunner.load(), inferenceRunner);
+  }
+  catch (...) {
+    delete inferenceRunner;
+    throw;
+  }
+  auto oldInferenceRunner = m_inferenceRunner.exchange(inferenceRunner);
+  auto version = ++m_version;
+  // A call that read the epoch before an earlier flip may only have been counted after it, against the
+  // parity that is now current. Flipping twice waits out the calls counted against both parities.
+  for (int32_t i=0 ; i<2 ; ++i) {
+    auto epoch = m_epoch.fetch_add(1);
+    WaitForReaders(epoch & 1);
+  }
+  delete oldInferenceRunner;
+  return version;
+}
+
+} // TreeBeard
@@ -0,0 +1,75 @@
+#ifndef _VERSIONEDINFERENCERUNNER_H_
+#define _VERSIONEDINFERENCERUNNER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "ExecutionHelpers.h"
+
+namespace TreeBeard
+{
+
+// A handle to the current version of a model that can be replaced while inference is running on it.
+// Calls pin the epoch they start in (a counter increment per call, no locks) and run on the runner
+// published at that point. SwapModel publishes the new runner, then waits out a grace period (every
+// call that could have seen the old runner has returned) before deleting the old runner, along with
+// its JIT engine and buffers. Only SwapModel waits. Swaps are serialized.
+class VersionedInferenceRunner {
+  // Calls in flight, indexed by the parity of the epoch they started in. Kept on separate cache lines.
+  struct alignas(64) ReaderCount {
+    std::atomic<int64_t> count{0};
+  };
+  ReaderCount m_readerCounts[2];
+  std::atomic<int64_t> m_epoch;
+  std::atomic<mlir::decisionforest::InferenceRunnerBase*> m_inferenceRunner;
+  std::atomic<int64_t> m_version;
+  std::mutex m_swapMutex;
+
+  void WaitForReaders(int64_t epochParity);
+  static void CheckCompatibility(mlir::decisionforest::InferenceRunnerBase *currentRunner,
+                                 mlir::decisionforest::InferenceRunnerBase *newRunner);
+public:
+  // Takes ownership of the runner
+  VersionedInferenceRunner(mlir::decisionforest::InferenceRunnerBase *inferenceRunner);
+  // Must not be called while inference is running
+  ~VersionedInferenceRunner();
+
+  VersionedInferenceRunner(const VersionedInferenceRunner&) = delete;
+  VersionedInferenceRunner& operator=(const VersionedInferenceRunner&) = delete;
+
+  // Pins the runner that was current when it was constructed until it is destroyed
+  class ReadGuard {
+    VersionedInferenceRunner& m_versionedRunner;
+    int64_t m_epochParity;
+    mlir::decisionforest::InferenceRunnerBase *m_inferenceRunner;
+  public:
+    ReadGuard(VersionedInferenceRunner& versionedRunner);
+    ~ReadGuard();
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+    mlir::decisionforest::InferenceRunnerBase* operator->() { return m_inferenceRunner; }
+    mlir::decisionforest::InferenceRunnerBase& operator*() { return *m_inferenceRunner; }
+  };
+
+  int32_t RunInferenceOnMultipleBatches(void *input, void *returnValue, int32_t numRows) {
+    ReadGuard inferenceRunner(*this);
+    return inferenceRunner->RunInferenceOnMultipleBatches(input, returnValue, numRows);
+  }
+  int32_t RunInferenceOnStridedInput(void *input, void *returnValue, int32_t numRows, int64_t rowStride, int64_t columnStride) {
+    ReadGuard inferenceRunner(*this);
+    return inferenceRunner->RunInferenceOnStridedInput(input, returnValue, numRows, rowStride, columnStride);
+  }
+
+  // Takes ownership of the new runner and returns its version. Blocks until the calls running on
+  // the old runner have returned and then deletes it. Must not be called from inside a ReadGuard.
+  // The row size, input element width, input layout, number of outputs and return type width are 
+  // fixed for the lifetime of the handle, so they can be read through separate ReadGuards. A runner 
+  // that differs in any of them is deleted and std::runtime_error is thrown (the model isn't swapped).
+  int64_t SwapModel(mlir::decisionforest::InferenceRunnerBase *inferenceRunner);
+  // Starts at 0 and is incremented by every swap
+  int64_t GetVersion() { return m_version.load(); }
+};
+
+} // TreeBeard
+
+#endif // _VERSIONEDINFERENCERUNNER_H_
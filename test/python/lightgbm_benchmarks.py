@@ -0,0 +1,151 @@
+import os
+import sys
+import argparse
+import tempfile
+import numpy
+import pandas
+import time
+import math
+from scipy.stats.mstats import gmean
+
+filepath = os.path.abspath(__file__)
+treebeard_repo_dir = os.path.dirname(os.path.dirname(os.path.dirname(filepath)))
+
+import treebeard
+import lightgbm as lgb
+
+num_repeats = 20
+num_tiles = 4
+batchSize = 200
+num_boost_round = 100
+
+# LightGBM models are trained on the inputs of the XGBoost test data with the XGBoost predictions as the labels
+# (classes for the multi-class models). "synthetic-categorical" has categorical features and missing values.
+modelConfigs = {
+  "abalone" : { "objective" : "regression" },
+  "airline" : { "objective" : "binary" },
+  "covtype" : { "objective" : "multiclass" },
+  "higgs" : { "objective" : "binary" },
+  "letters" : { "objective" : "multiclass" },
+  "year_prediction_msd" : { "objective" : "regression" },
+  "synthetic-categorical" : { "objective" : "poisson" },
+}
+
+def LoadXGBoostTestData(modelName):
+  csvPath = os.path.join(os.path.join(treebeard_repo_dir, "xgb_models"), modelName + "_xgb_model_save.json.test.sampled.csv")
+  data = numpy.array(pandas.read_csv(csvPath, header=None), order='C')
+  return numpy.array(data[:, :-1], numpy.float32, order='C'), data[:, -1]
+
+def ConstructSyntheticCategoricalData(numRows=5000, numFeatures=8, numCategories=40):
+  rng = numpy.random.default_rng(0)
+  inputs = rng.normal(size=(numRows, numFeatures)).astype(numpy.float32)
+  inputs[:, 0] = rng.integers(0, numCategories, size=numRows)
+  inputs[:, 1] = rng.integers(0, numCategories//4, size=numRows)
+  inputs[rng.random(size=(numRows, numFeatures)) < 0.05] = numpy.nan
+  labels = rng.poisson(numpy.exp(numpy.sin(numpy.nan_to_num(inputs[:, 0])) + 0.5*numpy.nan_to_num(inputs[:, 2])))
+  return inputs, labels
+
+def TrainLightGBMModel(modelName, modelPath):
+  config = modelConfigs[modelName]
+  params = { "objective" : config["objective"], "verbose" : -1, "num_threads" : 1 }
+  categoricalFeatures = "auto"
+  if modelName == "synthetic-categorical":
+    inputs, labels = ConstructSyntheticCategoricalData()
+    categoricalFeatures = [0, 1]
+  else:
+    inputs, labels = LoadXGBoostTestData(modelName)
+  if config["objective"] == "binary":
+    labels = labels > numpy.median(labels)
+  elif config["objective"] == "multiclass":
+    params["num_class"] = int(numpy.max(labels)) + 1
+  trainSet = lgb.Dataset(inputs, label=labels, categorical_feature=categoricalFeatures)
+  booster = lgb.train(params, trainSet, num_boost_round=num_boost_round)
+  booster.save_model(modelPath)
+  return booster, inputs
+
+def ConstructTreebeardRunner(modelPath, options):
+  globalsPath = modelPath + ".treebeard-globals.json"
+  tbContext = treebeard.TreebeardContext(modelPath, globalsPath, options)
+  tbContext.SetRepresentationType("array")
+  tbContext.SetInputFiletype("lightgbm_text")
+  return treebeard.TreebeardInferenceRunner.FromTBContext(tbContext)
+
+def GetBatches(inputs):
+  inputs = numpy.tile(inputs, (num_tiles, 1))
+  num_batches = int(math.floor(inputs.shape[0]/batchSize))
+  return [numpy.array(inputs[j*batchSize:(j+1)*batchSize, :], numpy.float32, order='C') for j in range(num_batches)]
+
+def CheckPredictions(modelName, booster, inferenceRunner, inputs, returnType) -> bool:
+  for batch in GetBatches(inputs)[:num_tiles]:
+    expected = booster.predict(batch)
+    if modelConfigs[modelName]["objective"] == "multiclass":
+      expected = numpy.argmax(expected, axis=1)
+    results = inferenceRunner.RunInference(batch, returnType)
+    if not numpy.allclose(results, expected, rtol=1e-4, atol=1e-5):
+      return False
+  return True
+
+def TimePredictions(predict, batches) -> float:
+  start = time.time()
+  for i in range(num_repeats):
+    for batch in batches:
+      predict(batch)
+  end = time.time()
+  return (end - start)/(batchSize * len(batches) * num_repeats)
+
+# Trains the model, checks Treebeard's predictions against LightGBM's and, if timed, returns the time per 
+# row of both. Returns None if the predictions don't match.
+def RunSingleBenchmark(modelName, tileSize, timed=True):
+  with tempfile.TemporaryDirectory() as modelDir:
+    modelPath = os.path.join(modelDir, modelName + "_lightgbm_model.txt")
+    booster, inputs = TrainLightGBMModel(modelName, modelPath)
+
+    isMultiClass = modelConfigs[modelName]["objective"] == "multiclass"
+    returnType = numpy.int8 if isMultiClass else numpy.float32
+    options = treebeard.CompilerOptions(batchSize, tileSize)
+    options.SetOneTreeAtATimeSchedule()
+    if isMultiClass:
+      options.SetReturnTypeWidth(8)
+      options.SetReturnTypeIsFloatType(False)
+    inferenceRunner = ConstructTreebeardRunner(modelPath, options)
+    if not CheckPredictions(modelName, booster, inferenceRunner, inputs, returnType):
+      print(modelName, "Failed")
+      return None
+    if not timed:
+      print(modelName, "Passed")
+      return ()
+
+    batches = GetBatches(inputs)
+    lightgbmTime = TimePredictions(lambda batch : booster.predict(batch, num_threads=1), batches)
+    treebeardTime = TimePredictions(lambda batch : inferenceRunner.RunInference(batch, returnType), batches)
+    return lightgbmTime, treebeardTime
+
+# Checks the predictions of every model without timing them. Returns False if any of them is wrong.
+def CheckModels(tileSize) -> bool:
+  results = [RunSingleBenchmark(modelName, tileSize, timed=False) for modelName in modelConfigs]
+  return all(result is not None for result in results)
+
+# Returns False if the predictions of any model are wrong
+def RunBenchmarks(tileSize) -> bool:
+  speedups = []
+  failedModels = []
+  for modelName in modelConfigs:
+    times = RunSingleBenchmark(modelName, tileSize)
+    if times is None:
+      failedModels.append(modelName)
+      continue
+    lightgbmTime, treebeardTime = times
+    speedups.append(lightgbmTime/treebeardTime)
+    print(modelName, "Passed", "LightGBM:", lightgbmTime, "Treebeard:", treebeardTime, "Speedup:", speedups[-1])
+  if speedups:
+    print("Geomean speedup:", gmean(speedups))
+  if failedModels:
+    print("Failed models:", ", ".join(failedModels))
+  return not failedModels
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description="Check and time Treebeard against lightgbm.Booster.predict on LightGBM models")
+  parser.add_argument("--tile_size", type=int, default=8)
+  args = parser.parse_args()
+  if not RunBenchmarks(args.tile_size):
+    sys.exit(1)
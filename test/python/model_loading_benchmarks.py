@@ -0,0 +1,64 @@
+import os
+import sys
+import json
+import argparse
+import resource
+import subprocess
+import tempfile
+import time
+
+filepath = os.path.abspath(__file__)
+treebeard_repo_dir = os.path.dirname(os.path.dirname(os.path.dirname(filepath)))
+
+# Reports the time taken to parse each shipped XGBoost model and build its HIR, and the peak RSS of the
+# process while doing so, for the JSON model and for the same model saved as UBJSON. Each measurement runs
+# in a separate process so that the peak RSS of one model doesn't hide that of the next.
+
+def MeasureModelLoading(modelPath):
+  import treebeard
+  baselineRSS = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+  options = treebeard.CompilerOptions(200, 8)
+  # The globals are written to a temporary directory so that the shipped model directory is left untouched
+  with tempfile.TemporaryDirectory() as globalsDir:
+    tbContext = treebeard.TreebeardContext(modelPath, os.path.join(globalsDir, "treebeard-globals.json"), options)
+    tbContext.SetRepresentationType("array")
+    tbContext.SetInputFiletype("xgboost_json")
+    start = time.time()
+    tbContext.BuildHIRRepresentation()
+    end = time.time()
+    del tbContext
+  peakRSS = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+  # ru_maxrss is in KB on Linux
+  print(json.dumps({ "time" : end - start, "peakRSSMB" : peakRSS/1024, "parseRSSMB" : (peakRSS - baselineRSS)/1024 }))
+
+def RunMeasurementProcess(modelPath):
+  output = subprocess.check_output([sys.executable, filepath, "--measure", modelPath])
+  return json.loads(output.decode().strip().splitlines()[-1])
+
+def ConvertToUBJSON(modelPath, ubjsonPath):
+  import xgboost as xgb
+  booster = xgb.Booster(model_file=modelPath)
+  booster.save_model(ubjsonPath)
+
+def RunBenchmarks():
+  modelsDir = os.path.join(treebeard_repo_dir, "xgb_models")
+  modelPaths = sorted(os.path.join(modelsDir, f) for f in os.listdir(modelsDir) if f.endswith("_xgb_model_save.json"))
+  print("model", "format", "size(MB)", "time(s)", "peakRSS(MB)", "parseRSS(MB)", sep="\t")
+  with tempfile.TemporaryDirectory() as ubjsonDir:
+    for modelPath in modelPaths:
+      modelName = os.path.basename(modelPath).replace("_xgb_model_save.json", "")
+      ubjsonPath = os.path.join(ubjsonDir, modelName + "_xgb_model_save.ubj")
+      ConvertToUBJSON(modelPath, ubjsonPath)
+      for format, path in [("json", modelPath), ("ubj", ubjsonPath)]:
+        result = RunMeasurementProcess(path)
+        sizeMB = os.path.getsize(path)/(1024*1024)
+        print(modelName, format, "%.2f" % sizeMB, "%.3f" % result["time"], "%.1f" % result["peakRSSMB"], "%.1f" % result["parseRSSMB"], sep="\t")
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description="Measure the time and memory taken to load XGBoost models")
+  parser.add_argument("--measure", type=str, default=None, help="Measure loading a single model (used internally)")
+  args = parser.parse_args()
+  if args.measure is not None:
+    MeasureModelLoading(args.measure)
+  else:
+    RunBenchmarks()
@@ -137,12 +137,12 @@ def RunSingleTestJIT_Multibatch(modelJSONPath, csvPath, options, returnType) ->
   return (end - start)/(batchSize * num_batches * num_repeats)
 
 def RunTestOnSingleModelTestInputsJIT_Multibatch(modelName : str, sparse, options, returnType=numpy.float32) -> float:
-  treebeard.SetEnableSparseRepresentation(1 if sparse else 0)
+  options.SetSparseRepresentation(sparse)
   # print("TreeBeard ",  modelName, "...", end=" ")
   modelJSON = os.path.join(os.path.join(treebeard_repo_dir, "xgb_models"), modelName + "_xgb_model_save.json")
   csvPath = os.path.join(os.path.join(treebeard_repo_dir, "xgb_models"), modelName + "_xgb_model_save.json.test.sampled.csv")
   execTime = RunSingleTestJIT_Multibatch(modelJSON, csvPath, options, returnType)
-  treebeard.SetEnableSparseRepresentation(0)
+  options.SetSparseRepresentation(False)
   return execTime
 
 def RunSingleTest_Treelite(modelJSONPath, csvPath, modelName) -> float:
@@ -2,6 +2,8 @@ import os
 import numpy
 import pandas
 import time
+import tempfile
+import threading
 import treebeard
 from functools import partial
 
@@ -102,6 +104,125 @@ def RunSingleTestJIT_ScheduleManipulation(modelJSONPath,
   print("Passed (", end - start, "s )")
   return True
 
+def RunSingleTestJIT_MultipleBatches(modelJSONPath, csvPath, options, returnType) -> bool:
+  data_df = pandas.read_csv(csvPath, header=None)
+  data = numpy.array(data_df, order='C')
+  inputs = numpy.array(data[:, :-1], numpy.float32, order='C')
+  expectedOutputs = data[:, data.shape[1]-1]
+  
+  inferenceRunner = treebeard.TreebeardInferenceRunner.FromModelFile(modelJSONPath, "", options)
+  start = time.time()
+  results = inferenceRunner.RunInferenceOnMultipleBatches(inputs, returnType)
+  if not CheckArraysEqual(results, expectedOutputs):
+    print("Failed")
+    return False
+  end = time.time()
+  print("Passed (", end - start, "s ,", inferenceRunner.GetNumberOfThreads(), "threads )")
+  return True
+
+# Runs a Fortran ordered copy of the inputs if columnMajor is set and a view of every other column of a 
+# wider array otherwise. Models compiled for these layouts read the inputs in place.
+def RunSingleTestJIT_InputLayout(modelJSONPath, csvPath, options, returnType, columnMajor) -> bool:
+  data_df = pandas.read_csv(csvPath, header=None)
+  data = numpy.array(data_df, order='C')
+  numFeatures = data.shape[1] - 1
+  if columnMajor:
+    inputs = numpy.array(data[:, :-1], numpy.float32, order='F')
+  else:
+    paddedInputs = numpy.full((data.shape[0], 2*numFeatures), numpy.nan, numpy.float32)
+    paddedInputs[:, ::2] = data[:, :-1]
+    inputs = paddedInputs[:, ::2]
+  expectedOutputs = data[:, data.shape[1]-1]
+  
+  inferenceRunner = treebeard.TreebeardInferenceRunner.FromModelFile(modelJSONPath, "", options)
+  start = time.time()
+  results = inferenceRunner.RunInferenceOnMultipleBatches(inputs, returnType)
+  if not CheckArraysEqual(results, expectedOutputs):
+    print("Failed")
+    return False
+  end = time.time()
+  print("Passed (", end - start, "s )")
+  return True
+
+# Early exit only guarantees the predicted label, so compare labels and skip rows whose expected 
+# probability is too close to the threshold for float rounding to be ignored.
+def RunSingleTestJIT_EarlyExit(modelJSONPath, csvPath, options, returnType, threshold) -> bool:
+  data_df = pandas.read_csv(csvPath, header=None)
+  data = numpy.array(data_df, order='C')
+  inputs = numpy.array(data[:, :-1], numpy.float32, order='C')
+  expectedOutputs = data[:, data.shape[1]-1]
+  
+  inferenceRunner = treebeard.TreebeardInferenceRunner.FromModelFile(modelJSONPath, "", options)
+  assert inferenceRunner.IsEarlyExitEnabled()
+  start = time.time()
+  results = inferenceRunner.RunInferenceOnMultipleBatches(inputs, returnType)
+  end = time.time()
+  checkedRows = numpy.abs(expectedOutputs - threshold) > 1e-5
+  if not numpy.array_equal((results > threshold)[checkedRows], (expectedOutputs > threshold)[checkedRows]):
+    print("Failed")
+    return False
+  print("Passed (", end - start, "s ,", inferenceRunner.GetAverageTreesWalkedPerRow(), "trees per row )")
+  return True
+
+# Hardware counters may not be available (e.g. in containers). The profile checks are then skipped (and 
+# reported as skipped) but the results are still checked. The runner is multi-threaded and another thread 
+# runs inference with it while it is profiled.
+def RunSingleTestJIT_Profile(modelJSONPath, csvPath, options, returnType) -> bool:
+  data_df = pandas.read_csv(csvPath, header=None)
+  data = numpy.array(data_df, order='C')
+  inputs = numpy.array(data[:, :-1], numpy.float32, order='C')
+  expectedOutputs = data[:, data.shape[1]-1]
+
+  inferenceRunner = treebeard.TreebeardInferenceRunner.FromModelFile(modelJSONPath, "", options)
+  assert inferenceRunner.GetNumberOfTrees() > 0
+  inferenceRunner.SetNumberOfThreads(2)
+  concurrentResults = []
+  concurrentInference = threading.Thread(target=lambda: concurrentResults.append(inferenceRunner.RunInferenceOnMultipleBatches(inputs, returnType)))
+  concurrentInference.start()
+  numRepeats = 2
+  profile = inferenceRunner.ProfileInference(inputs, numRepeats, returnType)
+  concurrentInference.join()
+  if profile is None:
+    print("Skipped profile checks (hardware counters are unavailable) ...", end=" ")
+  elif profile["rows"] != numRepeats * inputs.shape[0] or profile["cycles_per_row"] <= 0:
+    print("Failed")
+    return False
+  if inferenceRunner.GetNumberOfThreads() != 2 or len(concurrentResults) != 1 or not CheckArraysEqual(concurrentResults[0], expectedOutputs):
+    print("Failed")
+    return False
+  results = inferenceRunner.RunInferenceOnMultipleBatches(inputs, returnType)
+  if not CheckArraysEqual(results, expectedOutputs):
+    print("Failed")
+    return False
+  print("Passed (", profile, ")")
+  return True
+
+# The expected outputs are labels, so check that the most likely class is the label and that the 
+# probabilities of each row add up to one.
+def RunSingleTestJIT_AllOutputs(modelJSONPath, csvPath, options, returnType) -> bool:
+  data_df = pandas.read_csv(csvPath, header=None)
+  data = numpy.array(data_df, order='C')
+  inputs = numpy.array(data[:, :-1], numpy.float32, order='C')
+  expectedOutputs = data[:, data.shape[1]-1]
+  
+  inferenceRunner = treebeard.TreebeardInferenceRunner.FromModelFile(modelJSONPath, "", options)
+  start = time.time()
+  results = inferenceRunner.RunInferenceOnMultipleBatches(inputs, returnType)
+  end = time.time()
+  if results.shape != (inputs.shape[0], inferenceRunner.GetNumberOfOutputs()) or \
+     not numpy.allclose(results.sum(axis=1), 1.0, atol=1e-4) or \
+     not numpy.array_equal(numpy.argmax(results, axis=1), expectedOutputs):
+    print("Failed")
+    return False
+  print("Passed (", end - start, "s )")
+  return True
+
+def RunSingleTestJIT_StridedInput(modelJSONPath, csvPath, options, returnType) -> bool:
+  return RunSingleTestJIT_InputLayout(modelJSONPath, csvPath, options, returnType, False)
+
+def RunSingleTestJIT_ColumnMajorInput(modelJSONPath, csvPath, options, returnType) -> bool:
+  return RunSingleTestJIT_InputLayout(modelJSONPath, csvPath, options, returnType, True)
+
 def RunTestOnSingleModelTestInputsJIT(modelName : str, options, testName : str, returnType=numpy.float32, testFunc=RunSingleTestJIT) -> bool:
   print("JIT ", testName, modelName, "...", end=" ")
   modelJSONPath = os.path.join(os.path.join(treebeard_repo_dir, "xgb_models"), modelName + "_xgb_model_save.json")
@@ -163,6 +284,21 @@ def RunParallelTests():
 
   RunAllTests("one-tree-par-4cores", invertLoopsTileSize8Options, invertLoopsTileSize8MulticlassOptions, RunSingleTestJIT)
 
+# Models compiled without a parallel schedule. numberOfCores is used for runtime threads.
+def RunRuntimeThreadingTests():
+  batchSize = 16
+  num_cores = 4
+  tile_size = 8
+  tileSize8Options = treebeard.CompilerOptions(batchSize, tile_size)
+  tileSize8Options.SetNumberOfCores(num_cores)
+
+  tileSize8MulticlassOptions = treebeard.CompilerOptions(batchSize, tile_size)
+  tileSize8MulticlassOptions.SetReturnTypeWidth(8)
+  tileSize8MulticlassOptions.SetReturnTypeIsFloatType(False)
+  tileSize8MulticlassOptions.SetNumberOfCores(num_cores)
+
+  RunAllTests("runtime-threads-4cores", tileSize8Options, tileSize8MulticlassOptions, RunSingleTestJIT_MultipleBatches)
+
 def RunProbBasedTilingTests():
   probTilingOptions = treebeard.CompilerOptions(200, 8)
   probTilingOptions.SetTilingType(2) # prob tiling
@@ -206,6 +342,204 @@ def RunBasicTests():
   
   treebeard.SetEnableSparseRepresentation(0)
 
+def RunInputLayoutTests():
+  for inputLayout, testName, singleTestRunner in [(treebeard.CompilerOptions.StridedInput, "strided-input", RunSingleTestJIT_StridedInput),
+                                                  (treebeard.CompilerOptions.ColumnMajorInput, "column-major-input", RunSingleTestJIT_ColumnMajorInput)]:
+    tileSize8Options = treebeard.CompilerOptions(16, 8)
+    tileSize8Options.SetInputLayout(inputLayout)
+
+    tileSize8MulticlassOptions = treebeard.CompilerOptions(16, 8)
+    tileSize8MulticlassOptions.SetReturnTypeWidth(8)
+    tileSize8MulticlassOptions.SetReturnTypeIsFloatType(False)
+    tileSize8MulticlassOptions.SetInputLayout(inputLayout)
+
+    RunAllTests(testName, tileSize8Options, tileSize8MulticlassOptions, singleTestRunner)
+
+def RunEarlyExitTests():
+  threshold = 0.5
+  tileSize8Options = treebeard.CompilerOptions(16, 8)
+  tileSize8Options.SetEarlyExitThreshold(threshold)
+  singleTestRunner = partial(RunSingleTestJIT_EarlyExit, threshold=threshold)
+  for modelName in ["airline", "epsilon", "higgs"]:
+    assert RunTestOnSingleModelTestInputsJIT(modelName, tileSize8Options, "early-exit", numpy.float32, singleTestRunner)
+
+  # Thresholds that aren't probabilities are rejected when they are set
+  invalidThresholdRejected = False
+  try:
+    treebeard.CompilerOptions(16, 8).SetEarlyExitThreshold(1.5)
+  except RuntimeError:
+    invalidThresholdRejected = True
+  assert invalidThresholdRejected
+
+def RunProfileInferenceTests():
+  tileSize8Options = treebeard.CompilerOptions(16, 8)
+  for modelName in ["abalone", "higgs"]:
+    assert RunTestOnSingleModelTestInputsJIT(modelName, tileSize8Options, "profile-inference", numpy.float32, RunSingleTestJIT_Profile)
+
+def RunQuantizedInputTests():
+  tileSize8Options = treebeard.CompilerOptions(16, 8)
+  tileSize8Options.SetQuantizeInputs(True)
+  tileSize8MulticlassOptions = treebeard.CompilerOptions(16, 8)
+  tileSize8MulticlassOptions.SetReturnTypeWidth(8)
+  tileSize8MulticlassOptions.SetReturnTypeIsFloatType(False)
+  tileSize8MulticlassOptions.SetQuantizeInputs(True)
+  RunAllTests("quantized-input", tileSize8Options, tileSize8MulticlassOptions, RunSingleTestJIT)
+
+def RunAllOutputsTests():
+  tileSize8Options = treebeard.CompilerOptions(16, 8)
+  tileSize8Options.SetReturnAllOutputs(True)
+  for modelName in ["covtype", "letters"]:
+    assert RunTestOnSingleModelTestInputsJIT(modelName, tileSize8Options, "all-outputs", numpy.float32, RunSingleTestJIT_AllOutputs)
+
+  # The CSV of the multi-target model holds the features of each row followed by the prediction of each target
+  print("JIT all-outputs multi_target ...", end=" ")
+  numTargets = 3
+  modelJSONPath = os.path.join(treebeard_repo_dir, "xgb_models", "test", "multi_target_xgb_model.json")
+  data = numpy.array(pandas.read_csv(modelJSONPath + ".csv", header=None), order='C')
+  inputs = numpy.array(data[:, :-numTargets], numpy.float32, order='C')
+  options = treebeard.CompilerOptions(4, 4)
+  options.SetReturnAllOutputs(True)
+  inferenceRunner = treebeard.TreebeardInferenceRunner.FromModelFile(modelJSONPath, "", options)
+  results = inferenceRunner.RunInferenceOnMultipleBatches(inputs, numpy.float32)
+  assert results.shape == (inputs.shape[0], numTargets)
+  assert numpy.allclose(results, data[:, -numTargets:], atol=1e-6)
+  print("Passed")
+
+# Swaps a differently tiled version of the model into a versioned handle. Models whose results don't fit the
+# handle's result arrays are rejected and the handle keeps running the current model.
+def RunModelHotSwapTests():
+  print("JIT hot-swap abalone ...", end=" ")
+  modelJSONPath = os.path.join(treebeard_repo_dir, "xgb_models", "abalone_xgb_model_save.json")
+  data = numpy.array(pandas.read_csv(modelJSONPath + ".test.sampled.csv", header=None), order='C')
+  inputs = numpy.array(data[:, :-1], numpy.float32, order='C')
+  expectedOutputs = data[:, data.shape[1]-1]
+
+  versionedRunner = treebeard.VersionedInferenceRunner(
+    treebeard.TreebeardInferenceRunner.FromModelFile(modelJSONPath, "", treebeard.CompilerOptions(200, 4)))
+  assert CheckArraysEqual(versionedRunner.RunInferenceOnMultipleBatches(inputs), expectedOutputs)
+  assert versionedRunner.SwapModel(treebeard.TreebeardInferenceRunner.FromModelFile(modelJSONPath, "", treebeard.CompilerOptions(200, 8))) == 1
+  assert versionedRunner.GetVersion() == 1
+  assert CheckArraysEqual(versionedRunner.RunInferenceOnMultipleBatches(inputs), expectedOutputs)
+
+  doubleResultOptions = treebeard.CompilerOptions(200, 8)
+  doubleResultOptions.SetReturnTypeWidth(64)
+  incompatibleRunner = treebeard.TreebeardInferenceRunner.FromModelFile(modelJSONPath, "", doubleResultOptions)
+  try:
+    versionedRunner.SwapModel(incompatibleRunner)
+    assert False, "A model that returns doubles was swapped into a handle whose results are floats"
+  except RuntimeError:
+    pass
+  assert versionedRunner.GetVersion() == 1
+  assert CheckArraysEqual(versionedRunner.RunInferenceOnMultipleBatches(inputs), expectedOutputs)
+  print("Passed")
+
+def RunSKLearnModelTest(model, modelName, inputs, voting, returnAllOutputs, representation="array") -> bool:
+  print("JIT sklearn", type(model).__name__, voting, "all-outputs" if returnAllOutputs else "", representation, modelName, "...", end=" ")
+  modelJSONPath = os.path.join(os.path.join(treebeard_repo_dir, "xgb_models"), modelName + "_sklearn_" + voting + ".json")
+  treebeard.ExportSKLearnModel(model, modelJSONPath, voting)
+  isClassifier = hasattr(model, "classes_")
+  options = treebeard.CompilerOptions(200, 8)
+  returnType = numpy.float32
+  if returnAllOutputs:
+    options.SetReturnAllOutputs(True)
+  elif isClassifier:
+    options.SetReturnTypeWidth(8)
+    options.SetReturnTypeIsFloatType(False)
+    returnType = numpy.int8
+  tbContext = treebeard.TreebeardContext(modelJSONPath, modelJSONPath + ".treebeard-globals.json", options)
+  tbContext.SetRepresentationType(representation)
+  tbContext.SetInputFiletype("sklearn_json")
+  inferenceRunner = treebeard.TreebeardInferenceRunner.FromTBContext(tbContext)
+  results = inferenceRunner.RunInferenceOnMultipleBatches(inputs, returnType)
+  os.remove(modelJSONPath)
+
+  if not isClassifier:
+    passed = numpy.allclose(results, model.predict(inputs), rtol=1e-5, atol=1e-5)
+  else:
+    if voting == "soft":
+      expectedOutputs = model.predict_proba(inputs)
+    else:
+      votes = numpy.stack([estimator.predict(inputs) for estimator in model.estimators_]).astype(int)
+      expectedOutputs = numpy.stack([(votes == c).mean(axis=0) for c in range(len(model.classes_))], axis=1)
+    if returnAllOutputs:
+      passed = numpy.allclose(results, expectedOutputs, atol=1e-5)
+    else:
+      # Classes whose outputs are (almost) tied may be picked differently in single precision
+      sortedOutputs = numpy.sort(expectedOutputs, axis=1)
+      checkedRows = sortedOutputs[:, -1] - sortedOutputs[:, -2] > 1e-5
+      passed = numpy.array_equal(results[checkedRows], numpy.argmax(expectedOutputs, axis=1)[checkedRows])
+  print("Passed" if passed else "Failed")
+  return passed
+
+# Random forests are trained on the inputs of the XGBoost test data with the XGBoost predictions as the labels
+def RunSKLearnTests():
+  from sklearn.ensemble import RandomForestClassifier, RandomForestRegressor, ExtraTreesClassifier
+  def LoadData(modelName):
+    csvPath = os.path.join(os.path.join(treebeard_repo_dir, "xgb_models"), modelName + "_xgb_model_save.json.test.sampled.csv")
+    data = numpy.array(pandas.read_csv(csvPath, header=None), order='C')
+    return numpy.array(data[:, :-1], numpy.float32, order='C'), data[:, -1]
+
+  inputs, labels = LoadData("abalone")
+  regressor = RandomForestRegressor(n_estimators=20, max_depth=10, random_state=0).fit(inputs, labels)
+  assert RunSKLearnModelTest(regressor, "abalone", inputs, "soft", False)
+
+  inputs, labels = LoadData("letters")
+  for model in [RandomForestClassifier(n_estimators=20, max_depth=10, random_state=0), 
+                ExtraTreesClassifier(n_estimators=20, max_depth=10, random_state=0)]:
+    model.fit(inputs, labels.astype(int))
+    for voting in ["soft", "hard"]:
+      for returnAllOutputs in [False, True]:
+        assert RunSKLearnModelTest(model, "letters", inputs, voting, returnAllOutputs)
+
+  # scikit-learn grows trees until their leaves are pure by default, so these trees are much deeper and
+  # less balanced than the ones above (too deep to store as perfect trees in the array representation). 
+  # The hybrid representation stores only their top levels as perfect trees.
+  inputs, labels = LoadData("abalone")
+  regressor = RandomForestRegressor(n_estimators=5, max_depth=None, random_state=0).fit(inputs, labels)
+  for representation in ["sparse", "hybrid"]:
+    assert RunSKLearnModelTest(regressor, "abalone", inputs, "soft", False, representation)
+  inputs, labels = LoadData("letters")
+  classifier = RandomForestClassifier(n_estimators=5, max_depth=None, random_state=0).fit(inputs, labels.astype(int))
+  for voting in ["soft", "hard"]:
+    for representation in ["sparse", "hybrid"]:
+      assert RunSKLearnModelTest(classifier, "letters", inputs, voting, True, representation)
+
+# The expected outputs of the checked in LightGBM model were computed independently of LightGBM and Treebeard. 
+# Models trained with LightGBM are checked against Booster.predict if lightgbm is installed.
+def RunLightGBMTests():
+  print("JIT lightgbm binary_categorical ...", end=" ")
+  modelPath = os.path.join(treebeard_repo_dir, "xgb_models", "test", "binary_categorical_lightgbm_model.txt")
+  data = numpy.array(pandas.read_csv(modelPath + ".csv", header=None), order='C')
+  inputs = numpy.array(data[:, :-1], numpy.float32, order='C')
+  with tempfile.TemporaryDirectory() as globalsDir:
+    options = treebeard.CompilerOptions(4, 4)
+    tbContext = treebeard.TreebeardContext(modelPath, os.path.join(globalsDir, "globals.json"), options)
+    tbContext.SetRepresentationType("array")
+    tbContext.SetInputFiletype("lightgbm_text")
+    inferenceRunner = treebeard.TreebeardInferenceRunner.FromTBContext(tbContext)
+    results = inferenceRunner.RunInferenceOnMultipleBatches(inputs, numpy.float32)
+    assert numpy.allclose(results, data[:, -1], rtol=1e-5, atol=1e-6)
+
+    # Unsupported models are rejected when the forest creator reads or constructs them
+    invalidModelPath = os.path.join(globalsDir, "sqrt_lightgbm_model.txt")
+    with open(modelPath) as fin, open(invalidModelPath, "w") as fout:
+      fout.write(fin.read().replace("objective=binary sigmoid:2", "objective=regression sqrt"))
+    tbContext = treebeard.TreebeardContext(invalidModelPath, os.path.join(globalsDir, "globals.json"), options)
+    try:
+      tbContext.SetInputFiletype("lightgbm_text")
+      tbContext.BuildHIRRepresentation()
+      assert False, "A regression model trained on the square root of the label was accepted"
+    except RuntimeError:
+      pass
+  print("Passed")
+
+  try:
+    import lightgbm_benchmarks
+  except ImportError:
+    print("Skipping LightGBM benchmark checks (lightgbm is not installed)")
+    return
+  assert lightgbm_benchmarks.CheckModels(8)
+
 def RunTBContextTests():
   defaultTileSize8Options = treebeard.CompilerOptions(200, 8)
   defaultTileSize8MulticlassOptions = treebeard.CompilerOptions(200, 8)
@@ -214,11 +548,14 @@ def RunTBContextTests():
 
   arrayRepSingleTestRunner = partial(RunSingleTestJIT_TBContext, representation="array", inputType="xgboost_json")
   sparseRepSingleTestRunner = partial(RunSingleTestJIT_TBContext, representation="sparse", inputType="xgboost_json")
+  hybridRepSingleTestRunner = partial(RunSingleTestJIT_TBContext, representation="hybrid", inputType="xgboost_json")
 
   RunAllTests("default-array-tbcontext", defaultTileSize8Options, defaultTileSize8MulticlassOptions, arrayRepSingleTestRunner)
 
   RunAllTests("default-sparse-tbcontext", defaultTileSize8Options, defaultTileSize8MulticlassOptions, sparseRepSingleTestRunner)
 
+  RunAllTests("default-hybrid-tbcontext", defaultTileSize8Options, defaultTileSize8MulticlassOptions, hybridRepSingleTestRunner)
+
   invertLoopsTileSize8Options = treebeard.CompilerOptions(200, 8)
   invertLoopsTileSize8Options.SetOneTreeAtATimeSchedule()
 
@@ -231,6 +568,14 @@ def RunTBContextTests():
 
   RunAllTests("one-tree-sparse-tbcontext", invertLoopsTileSize8Options, invertLoopsTileSize8MulticlassOptions, sparseRepSingleTestRunner)
 
+  RunAllTests("one-tree-hybrid-tbcontext", invertLoopsTileSize8Options, invertLoopsTileSize8MulticlassOptions, hybridRepSingleTestRunner)
+
+  scalarOptions = treebeard.CompilerOptions(200, 1)
+  scalarMulticlassOptions = treebeard.CompilerOptions(200, 1)
+  scalarMulticlassOptions.SetReturnTypeWidth(8)
+  scalarMulticlassOptions.SetReturnTypeIsFloatType(False)
+  RunAllTests("scalar-hybrid-tbcontext", scalarOptions, scalarMulticlassOptions, hybridRepSingleTestRunner)
+
 def TileBatchLoopSchedule(schedule: treebeard.Schedule):
   batchIndex = schedule.GetBatchIndex()
   outerIndex = schedule.NewIndexVariable("b0")
@@ -262,6 +607,41 @@ def run_custom_schedule(test_name, rep, schedule_manipulator):
 
   RunAllTests(test_name, defaultTileSize8Options, defaultTileSize8MulticlassOptions, arrayRepSingleTestRunner_TileBatch)
 
+# Tunes over a small search space and checks the predictions of the model compiled with the configuration 
+# the autotuner writes. The second tuning run must come from the tuning database.
+def RunAutotunerTests():
+  import tempfile
+  import treebeard_autotuner
+  modelName = "abalone"
+  print("Autotuner", modelName, "...", end=" ")
+  modelJSONPath = os.path.join(os.path.join(treebeard_repo_dir, "xgb_models"), modelName + "_xgb_model_save.json")
+  csvPath = os.path.join(os.path.join(treebeard_repo_dir, "xgb_models"), modelName + "_xgb_model_save.json.test.sampled.csv")
+  with tempfile.TemporaryDirectory() as workDir:
+    databasePath = os.path.join(workDir, "tuning.json")
+    configJSONPath = os.path.join(workDir, "tuned.json")
+    for i in range(2):
+      autotuner = treebeard_autotuner.Autotuner(modelJSONPath, "xgboost_json", csvPath, databasePath=databasePath)
+      autotuner.verbose = False
+      autotuner.representations = ["array", "sparse"]
+      autotuner.tileSizes = [4, 8]
+      autotuner.batchSizes = [64, 256]
+      autotuner.pipelineSizes = [-1]
+      autotuner.numRepeats = 2
+      config, rowsPerSecond = autotuner.Tune()
+      assert rowsPerSecond > 0
+      assert (len(autotuner.measurements) > 0) == (i == 0)
+    treebeard_autotuner.WriteConfigJSON(config, configJSONPath)
+
+    options, representation = treebeard_autotuner.LoadConfiguration(configJSONPath)
+    tbContext = treebeard.TreebeardContext(modelJSONPath, os.path.join(workDir, "globals.json"), options)
+    tbContext.SetRepresentationType(representation)
+    tbContext.SetInputFiletype("xgboost_json")
+    inferenceRunner = treebeard.TreebeardInferenceRunner.FromTBContext(tbContext)
+    data = numpy.array(pandas.read_csv(csvPath, header=None), order='C')
+    inputs = numpy.array(data[:, :-1], numpy.float32, order='C')
+    assert CheckArraysEqual(inferenceRunner.RunInferenceOnMultipleBatches(inputs), data[:, -1])
+  print("Passed (", config, ")")
+
 def RunTileBatchLoopTests():
   run_custom_schedule("tiled_batch-array-tbcontext", "array", TileBatchLoopSchedule)
 
@@ -279,6 +659,16 @@ def ScheduleTest():
 ScheduleTest()
 RunTBContextTests()
 RunBasicTests()
+RunRuntimeThreadingTests()
+RunInputLayoutTests()
+RunEarlyExitTests()
+RunProfileInferenceTests()
+RunAutotunerTests()
+RunQuantizedInputTests()
+RunAllOutputsTests()
+RunModelHotSwapTests()
+RunSKLearnTests()
+RunLightGBMTests()
 
 treebeard.SetEnableSparseRepresentation(1)
 